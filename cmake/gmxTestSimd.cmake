@@ -249,6 +249,30 @@ elseif(${GMX_SIMD} STREQUAL "AVX2_256")
     set(GMX_SIMD_X86_AVX2_256 1)
     set(SIMD_STATUS_MESSAGE "Enabling 256-bit AVX2 SIMD instructions")
 
+elseif(${GMX_SIMD} STREQUAL "AVX_512F")
+
+    gmx_use_clang_as_with_gnu_compilers_on_osx()
+
+    # The SIMD4 and double-precision integer parts use AVX2 and FMA,
+    # which all AVX-512F hardware supports, so require those too.
+    gmx_find_cflag_for_source(CFLAGS_AVX_512F "C compiler AVX-512F flag"
+                              "#include<immintrin.h>
+                              int main(){__m512 y,x=_mm512_set1_ps(0.5);__m256i i=_mm256_set1_epi32(1);__m128 z=_mm_set1_ps(0.5);y=_mm512_fmadd_ps(x,x,x);z=_mm_fmadd_ps(z,z,z);i=_mm256_add_epi32(i,i);return (int)_mm512_cmp_ps_mask(x,y,_CMP_LT_OQ)+_mm256_movemask_epi8(i)+_mm_movemask_ps(z);}"
+                              SIMD_C_FLAGS
+                              "-xCOMMON-AVX512" "-mavx512f -mfma" "/arch:AVX" "-hgnu") # no AVX-512F-specific flag for MSVC yet
+    gmx_find_cxxflag_for_source(CXXFLAGS_AVX_512F "C++ compiler AVX-512F flag"
+                                "#include<immintrin.h>
+                                int main(){__m512 y,x=_mm512_set1_ps(0.5);__m256i i=_mm256_set1_epi32(1);__m128 z=_mm_set1_ps(0.5);y=_mm512_fmadd_ps(x,x,x);z=_mm_fmadd_ps(z,z,z);i=_mm256_add_epi32(i,i);return (int)_mm512_cmp_ps_mask(x,y,_CMP_LT_OQ)+_mm256_movemask_epi8(i)+_mm_movemask_ps(z);}"
+                                SIMD_CXX_FLAGS
+                                "-xCOMMON-AVX512" "-mavx512f -mfma" "/arch:AVX" "-hgnu") # no AVX-512F-specific flag for MSVC yet
+
+    if(NOT CFLAGS_AVX_512F OR NOT CXXFLAGS_AVX_512F)
+        message(FATAL_ERROR "Cannot find AVX-512F compiler flag. Use a newer compiler, or choose AVX2 SIMD (slower).")
+    endif()
+
+    set(GMX_SIMD_X86_AVX_512F 1)
+    set(SIMD_STATUS_MESSAGE "Enabling 512-bit AVX-512F SIMD instructions")
+
 elseif(${GMX_SIMD} STREQUAL "MIC")
 
     # No flags needed. Not testing.
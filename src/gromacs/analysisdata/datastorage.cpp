@@ -56,6 +56,8 @@
 #include "gromacs/utility/gmxassert.h"
 #include "gromacs/utility/uniqueptr.h"
 
+#include "thread_mpi/mutex.h"
+
 namespace gmx
 {
 
@@ -270,6 +272,16 @@ class AnalysisDataStorageImpl
          * frame (see \a frames_).
          */
         int                     nextIndex_;
+        /*! \brief
+         * Protects the frame state for concurrent access.
+         *
+         * Locked for all operations that start, add data to, or finish
+         * frames, which allows multiple threads to produce different frames
+         * concurrently.  All notifications to attached modules are also made
+         * with the mutex locked, so the modules see a serialized sequence of
+         * calls.
+         */
+        tMPI::mutex             mutex_;
 };
 
 /********************************************************************
@@ -497,6 +509,7 @@ AnalysisDataStorageImpl::getFrameBuilder()
 void
 AnalysisDataStorageImpl::finishFrame(int index)
 {
+    tMPI::lock_guard<tMPI::mutex> lock(mutex_);
     const int storageIndex = computeStorageLocation(index);
     GMX_RELEASE_ASSERT(storageIndex >= 0, "Out of bounds frame index");
 
@@ -755,6 +768,7 @@ AnalysisDataStorageFrame::finishPointSet()
         {
             firstColumn = 0;
         }
+        tMPI::lock_guard<tMPI::mutex> lock(data_->storageImpl().mutex_);
         data_->addPointSet(currentDataSet_, firstColumn, begin, end);
     }
     clearValues();
@@ -867,6 +881,7 @@ AnalysisDataStorageFrame &
 AnalysisDataStorage::startFrame(const AnalysisDataFrameHeader &header)
 {
     GMX_ASSERT(header.isValid(), "Invalid header");
+    tMPI::lock_guard<tMPI::mutex> lock(impl_->mutex_);
     internal::AnalysisDataStorageFrameData *storedFrame;
     if (impl_->storeAll())
     {
@@ -910,6 +925,7 @@ AnalysisDataStorage::startFrame(int index, real x, real dx)
 AnalysisDataStorageFrame &
 AnalysisDataStorage::currentFrame(int index)
 {
+    tMPI::lock_guard<tMPI::mutex> lock(impl_->mutex_);
     const int storageIndex = impl_->computeStorageLocation(index);
     GMX_RELEASE_ASSERT(storageIndex >= 0, "Out of bounds frame index");
 
@@ -935,6 +951,7 @@ AnalysisDataStorage::finishFrameSerial(int index)
 {
     if (impl_->pendingLimit_ > 1)
     {
+        tMPI::lock_guard<tMPI::mutex> lock(impl_->mutex_);
         impl_->finishFrameSerial(index);
     }
 }
@@ -257,8 +257,10 @@ class AnalysisDataStorageFrame
  * AnalysisDataStorageFrame::finishPointSet()) take the responsibility of
  * calling all the notification methods in AnalysisDataModuleManager,
  *
- * \todo
- * Proper multi-threaded implementation.
+ * If startParallelDataStorage() is used, different frames can be started,
+ * filled, and finished concurrently from multiple threads; finishFrameSerial()
+ * still needs to be called in order from a single thread.
+ * The notifications to the attached modules are serialized internally.
  *
  * \inlibraryapi
  * \ingroup module_analysisdata
@@ -59,12 +59,17 @@
 #include "gromacs/math/vec.h"
 #include "gromacs/utility/fatalerror.h"
 #include "gromacs/utility/futil.h"
+#include "gromacs/utility/gmxomp.h"
 #include "gromacs/utility/real.h"
 #include "gromacs/utility/smalloc.h"
 
 /*! \brief Shortcut macro to select modes. */
 #define MODE(x) ((mode & (x)) == (x))
 
+/*! \brief Maximum number of reals buffered for correlation functions
+ * that are computed together in one call to many_auto_correl(). */
+#define ACF_FOUR_BATCH_REALS (1 << 24)
+
 typedef struct {
     unsigned long mode;
     int           nrestart, nout, P, fitfn;
@@ -82,43 +87,6 @@ enum {
     enNorm, enCos, enSin
 };
 
-/*! \brief Routine to compute ACF using FFT. */
-static void low_do_four_core(int nfour, int nframes, real c1[], real cfour[],
-                             int nCos)
-{
-    int  i = 0;
-    int  fftcode;
-    real aver, *ans;
-
-    aver = 0.0;
-    switch (nCos)
-    {
-        case enNorm:
-            for (i = 0; (i < nframes); i++)
-            {
-                aver    += c1[i];
-                cfour[i] = c1[i];
-            }
-            break;
-        case enCos:
-            for (i = 0; (i < nframes); i++)
-            {
-                cfour[i] = cos(c1[i]);
-            }
-            break;
-        case enSin:
-            for (i = 0; (i < nframes); i++)
-            {
-                cfour[i] = sin(c1[i]);
-            }
-            break;
-        default:
-            gmx_fatal(FARGS, "nCos = %d, %s %d", nCos, __FILE__, __LINE__);
-    }
-
-    fftcode = many_auto_correl(1, nframes, nfour, &cfour);
-}
-
 /*! \brief Routine to comput ACF without FFT. */
 static void do_ac_core(int nframes, int nout,
                        real corr[], real c1[], int nrestart,
@@ -317,209 +285,188 @@ void norm_and_scale_vectors(int nframes, real c1[], real scale)
     }
 }
 
-/*! \brief Debugging */
-static void dump_tmp(char *s, int n, real c[])
+/*! \brief Returns the number of FFT correlations per item that do_four_core() needs. */
+static int four_core_nfunc(unsigned long mode)
 {
-    FILE *fp;
-    int   i;
-
-    fp = gmx_ffopen(s, "w");
-    for (i = 0; (i < n); i++)
+    if (MODE(eacNormal))
     {
-        fprintf(fp, "%10d  %10g\n", i, c[i]);
+        return 1;
     }
-    gmx_ffclose(fp);
+    else if (MODE(eacCos))
+    {
+        return 2;
+    }
+    else if (MODE(eacP2))
+    {
+        return 2*DIM;
+    }
+    else if (MODE(eacP1) || MODE(eacVector))
+    {
+        return DIM;
+    }
+    gmx_fatal(FARGS, "\nUnknown mode in do_autocorr (%d)", mode);
+
+    return 0;
 }
 
-/*! \brief High level ACF routine. */
-void do_four_core(unsigned long mode, int nfour, int nf2, int nframes,
-                  real c1[], real csum[], real ctmp[])
+/*! \brief Computes the ACFs of items i0 to i1 with FFTs.
+ *
+ * All the correlations needed for the items are set up first and computed
+ * together by many_auto_correl(), which distributes them over threads
+ * and creates the FFT plans only once per thread.
+ * cfunc should contain (i1-i0)*four_core_nfunc(mode) arrays of length nfour.
+ */
+static void do_four_core(unsigned long mode, int nfour, int nframes,
+                         int i0, int i1, real **c1, real **cfunc)
 {
-    real   *cfour;
-    char    buf[32];
-    real    fac;
-    int     j, m, m1;
+    int   nfunc, i, j, m, m1, f;
+    real *c, *csum, fac;
 
-    snew(cfour, nfour);
+    nfunc = four_core_nfunc(mode);
 
-    if (MODE(eacNormal))
-    {
-        /********************************************
-         *  N O R M A L
-         ********************************************/
-        low_do_four_core(nfour, nf2, c1, csum, enNorm);
-    }
-    else if (MODE(eacCos))
+    /* Fill the data to correlate */
+    for (i = i0; i < i1; i++)
     {
-        /***************************************************
-         * C O S I N E
-         ***************************************************/
-        /* Copy the data to temp array. Since we need it twice
-         * we can't overwrite original.
-         */
-        for (j = 0; (j < nf2); j++)
+        c = c1[i];
+        f = (i - i0)*nfunc;
+        if (MODE(eacNormal))
         {
-            ctmp[j] = c1[j];
-        }
-
-        /* Cosine term of AC function */
-        low_do_four_core(nfour, nf2, ctmp, cfour, enCos);
-        for (j = 0; (j < nf2); j++)
-        {
-            c1[j]  = cfour[j];
-        }
-
-        /* Sine term of AC function */
-        low_do_four_core(nfour, nf2, ctmp, cfour, enSin);
-        for (j = 0; (j < nf2); j++)
-        {
-            c1[j]  += cfour[j];
-            csum[j] = c1[j];
+            for (j = 0; j < nframes; j++)
+            {
+                cfunc[f][j] = c[j];
+            }
         }
-    }
-    else if (MODE(eacP2))
-    {
-        /***************************************************
-         * Legendre polynomials
-         ***************************************************/
-        /* First normalize the vectors */
-        norm_and_scale_vectors(nframes, c1, 1.0);
-
-        /* For P2 thingies we have to do six FFT based correls
-         * First for XX^2, then for YY^2, then for ZZ^2
-         * Then we have to do XY, YZ and XZ (counting these twice)
-         * After that we sum them and normalise
-         * P2(x) = (3 * cos^2 (x) - 1)/2
-         * for unit vectors u and v we compute the cosine as the inner product
-         * cos(u,v) = uX vX + uY vY + uZ vZ
-         *
-         *        oo
-         *        /
-         * C(t) = |  (3 cos^2(u(t'),u(t'+t)) - 1)/2 dt'
-         *        /
-         *        0
-         *
-         * For ACF we need:
-         * P2(u(0),u(t)) = [3 * (uX(0) uX(t) +
-         *                       uY(0) uY(t) +
-         *                       uZ(0) uZ(t))^2 - 1]/2
-         *               = [3 * ((uX(0) uX(t))^2 +
-         *                       (uY(0) uY(t))^2 +
-         *                       (uZ(0) uZ(t))^2 +
-         *                 2(uX(0) uY(0) uX(t) uY(t)) +
-         *                 2(uX(0) uZ(0) uX(t) uZ(t)) +
-         *                 2(uY(0) uZ(0) uY(t) uZ(t))) - 1]/2
-         *
-         *               = [(3/2) * (<uX^2> + <uY^2> + <uZ^2> +
-         *                         2<uXuY> + 2<uXuZ> + 2<uYuZ>) - 0.5]
-         *
-         */
-
-        /* Because of normalization the number of -0.5 to subtract
-         * depends on the number of data points!
-         */
-        for (j = 0; (j < nf2); j++)
+        else if (MODE(eacCos))
         {
-            csum[j]  = -0.5*(nf2-j);
+            for (j = 0; j < nframes; j++)
+            {
+                cfunc[f][j]   = cos(c[j]);
+                cfunc[f+1][j] = sin(c[j]);
+            }
         }
-
-        /***** DIAGONAL ELEMENTS ************/
-        for (m = 0; (m < DIM); m++)
+        else
         {
-            /* Copy the vector data in a linear array */
-            for (j = 0; (j < nf2); j++)
+            if (MODE(eacP1) || MODE(eacP2))
             {
-                ctmp[j]  = sqr(c1[DIM*j+m]);
+                /* First normalize the vectors */
+                norm_and_scale_vectors(nframes, c, 1.0);
             }
-            if (debug)
+            for (m = 0; m < DIM; m++)
             {
-                sprintf(buf, "c1diag%d.xvg", m);
-                dump_tmp(buf, nf2, ctmp);
+                m1 = (m+1) % DIM;
+                for (j = 0; j < nframes; j++)
+                {
+                    if (MODE(eacP2))
+                    {
+                        /* Diagonal and off-diagonal elements */
+                        cfunc[f+m][j]     = sqr(c[DIM*j+m]);
+                        cfunc[f+DIM+m][j] = c[DIM*j+m]*c[DIM*j+m1];
+                    }
+                    else
+                    {
+                        cfunc[f+m][j] = c[DIM*j+m];
+                    }
+                }
             }
+        }
+    }
 
-            low_do_four_core(nfour, nf2, ctmp, cfour, enNorm);
+    many_auto_correl((i1 - i0)*nfunc, nframes, nfour, cfunc);
 
-            if (debug)
-            {
-                sprintf(buf, "c1dfout%d.xvg", m);
-                dump_tmp(buf, nf2, cfour);
-            }
-            fac = 1.5;
-            for (j = 0; (j < nf2); j++)
+    /* Combine the correlations, csum can use the storage of the input data */
+    for (i = i0; i < i1; i++)
+    {
+        csum = c1[i];
+        f    = (i - i0)*nfunc;
+        if (MODE(eacNormal))
+        {
+            for (j = 0; j < nframes; j++)
             {
-                csum[j] += fac*(cfour[j]);
+                csum[j] = cfunc[f][j];
             }
         }
-        /******* OFF-DIAGONAL ELEMENTS **********/
-        for (m = 0; (m < DIM); m++)
+        else if (MODE(eacCos))
         {
-            /* Copy the vector data in a linear array */
-            m1 = (m+1) % DIM;
-            for (j = 0; (j < nf2); j++)
+            for (j = 0; j < nframes; j++)
             {
-                ctmp[j] = c1[DIM*j+m]*c1[DIM*j+m1];
+                csum[j]  = cfunc[f][j];
+                csum[j] += cfunc[f+1][j];
             }
+        }
+        else if (MODE(eacP2))
+        {
+            /* For P2 thingies we have to do six FFT based correls
+             * First for XX^2, then for YY^2, then for ZZ^2
+             * Then we have to do XY, YZ and XZ (counting these twice)
+             * After that we sum them and normalise
+             * P2(x) = (3 * cos^2 (x) - 1)/2
+             * for unit vectors u and v we compute the cosine as the inner product
+             * cos(u,v) = uX vX + uY vY + uZ vZ
+             *
+             *        oo
+             *        /
+             * C(t) = |  (3 cos^2(u(t'),u(t'+t)) - 1)/2 dt'
+             *        /
+             *        0
+             *
+             * For ACF we need:
+             * P2(u(0),u(t)) = [3 * (uX(0) uX(t) +
+             *                       uY(0) uY(t) +
+             *                       uZ(0) uZ(t))^2 - 1]/2
+             *               = [3 * ((uX(0) uX(t))^2 +
+             *                       (uY(0) uY(t))^2 +
+             *                       (uZ(0) uZ(t))^2 +
+             *                 2(uX(0) uY(0) uX(t) uY(t)) +
+             *                 2(uX(0) uZ(0) uX(t) uZ(t)) +
+             *                 2(uY(0) uZ(0) uY(t) uZ(t))) - 1]/2
+             *
+             *               = [(3/2) * (<uX^2> + <uY^2> + <uZ^2> +
+             *                         2<uXuY> + 2<uXuZ> + 2<uYuZ>) - 0.5]
+             *
+             */
 
-            if (debug)
+            /* Because of normalization the number of -0.5 to subtract
+             * depends on the number of data points!
+             */
+            for (j = 0; j < nframes; j++)
             {
-                sprintf(buf, "c1off%d.xvg", m);
-                dump_tmp(buf, nf2, ctmp);
+                csum[j] = -0.5*(nframes-j);
             }
-            low_do_four_core(nfour, nf2, ctmp, cfour, enNorm);
-            if (debug)
+            fac = 1.5;
+            for (m = 0; m < DIM; m++)
             {
-                sprintf(buf, "c1ofout%d.xvg", m);
-                dump_tmp(buf, nf2, cfour);
+                for (j = 0; j < nframes; j++)
+                {
+                    csum[j] += fac*cfunc[f+m][j];
+                }
             }
             fac = 3.0;
-            for (j = 0; (j < nf2); j++)
+            for (m = 0; m < DIM; m++)
             {
-                csum[j] += fac*cfour[j];
+                for (j = 0; j < nframes; j++)
+                {
+                    csum[j] += fac*cfunc[f+DIM+m][j];
+                }
             }
         }
-    }
-    else if (MODE(eacP1) || MODE(eacVector))
-    {
-        /***************************************************
-         * V E C T O R & P1
-         ***************************************************/
-        if (MODE(eacP1))
-        {
-            /* First normalize the vectors */
-            norm_and_scale_vectors(nframes, c1, 1.0);
-        }
-
-        /* For vector thingies we have to do three FFT based correls
-         * First for XX, then for YY, then for ZZ
-         * After that we sum them and normalise
-         */
-        for (j = 0; (j < nf2); j++)
-        {
-            csum[j] = 0.0;
-        }
-        for (m = 0; (m < DIM); m++)
+        else
         {
-            /* Copy the vector data in a linear array */
-            for (j = 0; (j < nf2); j++)
+            for (j = 0; j < nframes; j++)
             {
-                ctmp[j] = c1[DIM*j+m];
+                csum[j] = 0.0;
             }
-            low_do_four_core(nfour, nf2, ctmp, cfour, enNorm);
-            for (j = 0; (j < nf2); j++)
+            for (m = 0; m < DIM; m++)
             {
-                csum[j] += cfour[j];
+                for (j = 0; j < nframes; j++)
+                {
+                    csum[j] += cfunc[f+m][j];
+                }
             }
         }
-    }
-    else
-    {
-        gmx_fatal(FARGS, "\nUnknown mode in do_autocorr (%d)", mode);
-    }
-
-    sfree(cfour);
-    for (j = 0; (j < nf2); j++)
-    {
-        c1[j] = csum[j]/(real)(nframes-j);
+        for (j = 0; j < nframes; j++)
+        {
+            csum[j] = csum[j]/(real)(nframes-j);
+        }
     }
 }
 
@@ -531,9 +478,9 @@ void low_do_autocorr(const char *fn, const output_env_t oenv, const char *title,
                      int eFitFn)
 {
     FILE       *fp, *gp = NULL;
-    int         i, k, nfour;
-    real       *csum;
-    real       *ctmp, *fit;
+    int         i, k, nfour, nfunc, nbatch, i1;
+    real      **cfunc;
+    real       *fit;
     real        c0, sum, Ct2av, Ctav;
     gmx_bool    bFour = acf.bFour;
 
@@ -591,44 +538,55 @@ void low_do_autocorr(const char *fn, const output_env_t oenv, const char *title,
                     title, nfour);
         }
 
-        /* Allocate temp arrays */
-        snew(csum, nfour);
-        snew(ctmp, nfour);
-    }
-    else
-    {
-        nfour = 0; /* To keep the compiler happy */
-        snew(csum, nframes);
-        snew(ctmp, nframes);
-    }
-
-    /* Loop over items (e.g. molecules or dihedrals)
-     * In this loop the actual correlation functions are computed, but without
-     * normalizing them.
-     */
-    k = max(1, pow(10, (int)(log(nitem)/log(100))));
-    for (i = 0; i < nitem; i++)
-    {
-        if (bVerbose && ((i%k == 0 || i == nitem-1)))
+        /* Compute the ACFs of batches of items together, limiting
+         * the buffer size for the correlations of a batch.
+         */
+        nfunc  = four_core_nfunc(mode);
+        nbatch = max(1, min(nitem, ACF_FOUR_BATCH_REALS/(nfunc*nfour)));
+        snew(cfunc, nbatch*nfunc);
+        for (i = 0; i < nbatch*nfunc; i++)
         {
-            fprintf(stderr, "\rThingie %d", i+1);
+            snew(cfunc[i], nfour);
         }
-
-        if (bFour)
+        for (i = 0; i < nitem; i += nbatch)
         {
-            do_four_core(mode, nfour, nframes, nframes, c1[i], csum, ctmp);
+            i1 = min(nitem, i + nbatch);
+            if (bVerbose)
+            {
+                fprintf(stderr, "\rThingie %d", i1);
+            }
+            do_four_core(mode, nfour, nframes, i, i1, c1, cfunc);
         }
-        else
+        for (i = 0; i < nbatch*nfunc; i++)
         {
-            do_ac_core(nframes, nout, ctmp, c1[i], nrestart, mode);
+            sfree(cfunc[i]);
+        }
+        sfree(cfunc);
+    }
+    else
+    {
+        /* Loop over items (e.g. molecules or dihedrals)
+         * In this loop the actual correlation functions are computed, but without
+         * normalizing them.
+         */
+#pragma omp parallel
+        {
+            real *ctmp;
+            int   item;
+
+            snew(ctmp, nframes);
+#pragma omp for schedule(dynamic)
+            for (item = 0; item < nitem; item++)
+            {
+                do_ac_core(nframes, nout, ctmp, c1[item], nrestart, mode);
+            }
+            sfree(ctmp);
         }
     }
     if (bVerbose)
     {
         fprintf(stderr, "\n");
     }
-    sfree(ctmp);
-    sfree(csum);
 
     if (fn)
     {
@@ -54,29 +54,25 @@
 
 int many_auto_correl(int nfunc, int ndata, int nfft, real **c)
 {
-    #pragma omp parallel
+    int nthreads;
+
+    /* Each thread sets up its own FFT plan and buffers once and reuses them
+     * for all its functions, so there is no use in more threads than functions.
+     */
+    nthreads = max(1, min(gmx_omp_get_max_threads(), nfunc));
+    #pragma omp parallel num_threads(nthreads)
     {
         typedef real complex[2];
-        int          i, t, j, fftcode;
+        int          i, j, fftcode;
         gmx_fft_t    fft1;
         complex     *in, *out;
-        int          i0, i1;
-        int          nthreads, thread_id;
-
-        nthreads  = gmx_omp_get_max_threads();
-        thread_id = gmx_omp_get_thread_num();
-        if ((0 == thread_id))
-        {
-            // fprintf(stderr, "There are %d threads for correlation functions\n", nthreads);
-        }
-        i0 = thread_id*nfunc/nthreads;
-        i1 = min(nfunc, (thread_id+1)*nfunc/nthreads);
 
         fftcode = gmx_fft_init_1d(&fft1, nfft, GMX_FFT_FLAG_CONSERVATIVE);
         /* Allocate temporary arrays */
         snew(in, nfft);
         snew(out, nfft);
-        for (i = i0; (i < i1); i++)
+        #pragma omp for schedule(static)
+        for (i = 0; i < nfunc; i++)
         {
             for (j = 0; j < ndata; j++)
             {
@@ -94,10 +90,6 @@ int many_auto_correl(int nfunc, int ndata, int nfft, real **c)
                 in[j][0] = (out[j][0]*out[j][0] + out[j][1]*out[j][1])/nfft;
                 in[j][1] = 0;
             }
-            for (; (j < nfft); j++)
-            {
-                in[j][0] = in[j][1] = 0;
-            }
 
             fftcode = gmx_fft_1d(fft1, GMX_FFT_FORWARD, (void *)in, (void *)out);
             for (j = 0; (j < nfft); j++)
@@ -119,12 +119,13 @@ typedef struct gmx_domdec_master
     /* The cell boundaries */
     real **cell_x;
     /* The global charge group division */
-    int   *ncg;    /* Number of home charge groups for each node */
-    int   *index;  /* Index of nnodes+1 into cg */
-    int   *cg;     /* Global charge group index */
-    int   *nat;    /* Number of home atoms for each node. */
-    int   *ibuf;   /* Buffer for communication */
-    rvec  *vbuf;   /* Buffer for state scattering and gathering */
+    int   *ncg;     /* Number of home charge groups for each node */
+    int   *index;   /* Index of nnodes+1 into cg */
+    int   *cg;      /* Global charge group index */
+    int   *nat;     /* Number of home atoms for each node. */
+    int   *nat_off; /* Atom offset of each node in vbuf for collecting */
+    int   *ibuf;    /* Buffer for communication */
+    rvec  *vbuf;    /* Buffer for state scattering and gathering */
 } gmx_domdec_master_t;
 
 typedef struct
@@ -253,6 +254,30 @@ typedef struct
     int              nsend_zone;
 } dd_comm_setup_work_t;
 
+/* Setup for collecting vectors on the master in two levels:
+ * first over the DD ranks within each physical node onto a leader rank,
+ * then over the node leaders. This reduces the number of messages,
+ * and the load, on the master with many ranks per node.
+ */
+typedef struct
+{
+    gmx_bool  bLeader;         /* Do we collect for our physical node?      */
+    int       nrank_node;      /* The number of DD ranks on our node        */
+    int      *node_count;      /* Byte counts per node rank, leader only    */
+    int      *node_disp;       /* Byte displacements, leader only           */
+    rvec     *node_buf;        /* Vector buffer, non-master leaders only    */
+    int       node_buf_nalloc; /* Allocation size of node_buf               */
+    int       nleader;         /* The number of leaders, master only        */
+    int      *leader_nrank;    /* The number of ranks per leader, master only */
+    int      *leader_count;    /* Byte counts per leader, master only       */
+    int      *leader_disp;     /* Byte displacements, master only           */
+    int      *order;           /* DD ranks in collection order, master only */
+#ifdef GMX_MPI
+    MPI_Comm  mpi_comm_node;    /* The DD ranks on our physical node         */
+    MPI_Comm  mpi_comm_leaders; /* The node leaders, the master is rank 0    */
+#endif
+} gmx_domdec_collect_t;
+
 typedef struct gmx_domdec_comm
 {
     /* All arrays are indexed with 0 to dd->ndim (not Cartesian indexing),
@@ -374,6 +399,11 @@ typedef struct gmx_domdec_comm
     /* Communication buffer for general use */
     vec_rvec_t vbuf;
 
+    /* Two-level vector collection: -1 automatic, 0 off, 1 always */
+    int                   eCollectHier;
+    gmx_bool              bCollectSetup;
+    gmx_domdec_collect_t *collect;
+
     /* Temporary storage for thread parallel communication setup */
     int                   nth;
     dd_comm_setup_work_t *dth;
@@ -1442,6 +1472,52 @@ static void dd_collect_cg(gmx_domdec_t *dd,
     dd->comm->master_cg_ddp_count = state_local->ddp_count;
 }
 
+int dd_get_home_atom_indices(gmx_domdec_t *dd, t_state *state_local,
+                             int **index, int *index_nalloc)
+{
+    t_block *cgs_gl;
+    int      ncg_home = 0, *cg = NULL, nat_home, i, c;
+
+    cgs_gl = &dd->comm->cgs_gl;
+
+    /* Use the same sources for the distribution as dd_collect_cg */
+    if (state_local->ddp_count == dd->ddp_count)
+    {
+        ncg_home = dd->ncg_home;
+        cg       = dd->index_gl;
+    }
+    else if (state_local->ddp_count_cg_gl == state_local->ddp_count)
+    {
+        ncg_home = state_local->ncg_gl;
+        cg       = state_local->cg_gl;
+    }
+    else
+    {
+        gmx_incons("Attempted to get the atom indices for a state for which the charge group distribution is unknown");
+    }
+
+    nat_home = 0;
+    for (i = 0; i < ncg_home; i++)
+    {
+        nat_home += cgs_gl->index[cg[i]+1] - cgs_gl->index[cg[i]];
+    }
+    if (nat_home > *index_nalloc)
+    {
+        *index_nalloc = over_alloc_dd(nat_home);
+        srenew(*index, *index_nalloc);
+    }
+    nat_home = 0;
+    for (i = 0; i < ncg_home; i++)
+    {
+        for (c = cgs_gl->index[cg[i]]; c < cgs_gl->index[cg[i]+1]; c++)
+        {
+            (*index)[nat_home++] = c;
+        }
+    }
+
+    return nat_home;
+}
+
 static void dd_collect_vec_sendrecv(gmx_domdec_t *dd,
                                     rvec *lv, rvec *v)
 {
@@ -1519,14 +1595,44 @@ static void get_commbuffer_counts(gmx_domdec_t *dd,
     }
 }
 
+/* Copies the vectors in buf, stored consecutively per DD rank
+ * starting at atom offsets ma->nat_off, to global atom order in v.
+ * The ranks write disjoint parts of v, so we can use threads.
+ */
+static void dd_collect_vec_reorder(gmx_domdec_t *dd, const rvec *buf, rvec *v)
+{
+    gmx_domdec_master_t *ma;
+    t_block             *cgs_gl;
+    int                  nthread, n;
+
+    ma     = dd->ma;
+    cgs_gl = &dd->comm->cgs_gl;
+
+    nthread = gmx_omp_nthreads_get(emntDomdec);
+
+#pragma omp parallel for num_threads(nthread) schedule(static)
+    for (n = 0; n < dd->nnodes; n++)
+    {
+        int i, c, a;
+
+        a = ma->nat_off[n];
+        for (i = ma->index[n]; i < ma->index[n+1]; i++)
+        {
+            for (c = cgs_gl->index[ma->cg[i]]; c < cgs_gl->index[ma->cg[i]+1]; c++)
+            {
+                copy_rvec(buf[a++], v[c]);
+            }
+        }
+    }
+}
+
 static void dd_collect_vec_gatherv(gmx_domdec_t *dd,
                                    rvec *lv, rvec *v)
 {
     gmx_domdec_master_t *ma;
     int                 *rcounts = NULL, *disps = NULL;
-    int                  n, i, c, a;
+    int                  n;
     rvec                *buf = NULL;
-    t_block             *cgs_gl;
 
     ma = dd->ma;
 
@@ -1541,20 +1647,211 @@ static void dd_collect_vec_gatherv(gmx_domdec_t *dd,
 
     if (DDMASTER(dd))
     {
-        cgs_gl = &dd->comm->cgs_gl;
+        for (n = 0; n < dd->nnodes; n++)
+        {
+            ma->nat_off[n] = disps[n]/sizeof(rvec);
+        }
 
+        dd_collect_vec_reorder(dd, buf, v);
+    }
+}
+
+/* Sets up the communicators for two-level collection, when useful.
+ * Has to be called collectively by all DD ranks.
+ */
+static void setup_collect_hierarchical(gmx_domdec_t *dd)
+{
+#ifdef GMX_MPI
+    gmx_domdec_comm_t    *comm;
+    gmx_domdec_collect_t *col;
+    int                   key, rank_node, nrank_node, bLeader, nleader, l;
+    int                  *rank_buf = NULL;
+    MPI_Comm              mpi_comm_node, mpi_comm_leaders;
+
+    comm = dd->comm;
+
+    comm->bCollectSetup = TRUE;
+
+    if (comm->eCollectHier == 0 || dd->nnodes <= GMX_DD_NNODES_SENDRECV)
+    {
+        return;
+    }
+
+    /* Split over the physical nodes. With key 0 for the master,
+     * the master is the leader of its node and rank 0 of the leaders.
+     */
+    key = (DDMASTER(dd) ? 0 : 1 + dd->rank);
+    MPI_Comm_split(dd->mpi_comm_all, gmx_physicalnode_id_hash(), key,
+                   &mpi_comm_node);
+    MPI_Comm_rank(mpi_comm_node, &rank_node);
+    MPI_Comm_size(mpi_comm_node, &nrank_node);
+    bLeader = (rank_node == 0);
+
+    MPI_Allreduce(&bLeader, &nleader, 1, MPI_INT, MPI_SUM, dd->mpi_comm_all);
+
+    /* Only with multiple nodes with multiple ranks each do we gain */
+    if (!(comm->eCollectHier > 0 || (nleader > 1 && nleader < dd->nnodes)))
+    {
+        MPI_Comm_free(&mpi_comm_node);
+
+        return;
+    }
+
+    MPI_Comm_split(dd->mpi_comm_all, bLeader ? 0 : MPI_UNDEFINED, key,
+                   &mpi_comm_leaders);
+
+    snew(col, 1);
+    col->bLeader          = bLeader;
+    col->nrank_node       = nrank_node;
+    col->mpi_comm_node    = mpi_comm_node;
+    col->mpi_comm_leaders = mpi_comm_leaders;
+
+    if (col->bLeader)
+    {
+        snew(col->node_count, nrank_node);
+        snew(col->node_disp, nrank_node);
+        snew(rank_buf, nrank_node);
+    }
+    /* Collect the DD ranks of each node on its leader */
+    MPI_Gather(&dd->rank, 1, MPI_INT, rank_buf, 1, MPI_INT,
+               0, mpi_comm_node);
+
+    if (col->bLeader)
+    {
+        if (DDMASTER(dd))
+        {
+            col->nleader = nleader;
+            snew(col->leader_nrank, nleader);
+            snew(col->leader_count, nleader);
+            snew(col->leader_disp, nleader);
+            snew(col->order, dd->nnodes);
+        }
+        /* Collect the DD ranks of all nodes, in leader order, on the master */
+        MPI_Gather(&nrank_node, 1, MPI_INT, col->leader_nrank, 1, MPI_INT,
+                   0, mpi_comm_leaders);
+        if (DDMASTER(dd))
+        {
+            for (l = 0; l < nleader; l++)
+            {
+                col->leader_disp[l] = (l == 0 ? 0 : col->leader_disp[l-1] + col->leader_nrank[l-1]);
+            }
+        }
+        MPI_Gatherv(rank_buf, nrank_node, MPI_INT,
+                    col->order, col->leader_nrank, col->leader_disp, MPI_INT,
+                    0, mpi_comm_leaders);
+        sfree(rank_buf);
+    }
+
+    if (debug)
+    {
+        fprintf(debug, "Collecting vectors over %d nodes, %d ranks on this node\n",
+                nleader, nrank_node);
+    }
+
+    comm->collect = col;
+#else
+    dd->comm->bCollectSetup = TRUE;
+#endif
+}
+
+static void dd_collect_vec_hierarchical(gmx_domdec_t gmx_unused *dd,
+                                        rvec gmx_unused *lv, rvec gmx_unused *v)
+{
+#ifdef GMX_MPI
+    gmx_domdec_master_t  *ma;
+    gmx_domdec_collect_t *col;
+    int                   nbytes, nat_node, i, l, n, a;
+    rvec                 *buf;
+
+    ma  = dd->ma;
+    col = dd->comm->collect;
+
+    /* Collect the vectors of the ranks on our node on the node leader */
+    nbytes = dd->nat_home*sizeof(rvec);
+    MPI_Gather(&nbytes, 1, MPI_INT, col->node_count, 1, MPI_INT,
+               0, col->mpi_comm_node);
+
+    buf      = NULL;
+    nat_node = 0;
+    if (col->bLeader)
+    {
+        for (i = 0; i < col->nrank_node; i++)
+        {
+            col->node_disp[i] = nat_node*sizeof(rvec);
+            nat_node         += col->node_count[i]/sizeof(rvec);
+        }
+        if (DDMASTER(dd))
+        {
+            /* The master node comes first, so we can use vbuf directly */
+            buf = ma->vbuf;
+        }
+        else
+        {
+            if (nat_node > col->node_buf_nalloc)
+            {
+                col->node_buf_nalloc = over_alloc_dd(nat_node);
+                srenew(col->node_buf, col->node_buf_nalloc);
+            }
+            buf = col->node_buf;
+        }
+    }
+    MPI_Gatherv(lv, nbytes, MPI_BYTE,
+                buf, col->node_count, col->node_disp, MPI_BYTE,
+                0, col->mpi_comm_node);
+
+    if (!col->bLeader)
+    {
+        return;
+    }
+
+    /* Collect the vectors of all nodes on the master */
+    if (DDMASTER(dd))
+    {
         a = 0;
-        for (n = 0; n < dd->nnodes; n++)
+        i = 0;
+        for (l = 0; l < col->nleader; l++)
         {
-            for (i = ma->index[n]; i < ma->index[n+1]; i++)
+            col->leader_disp[l] = a*sizeof(rvec);
+            for (n = 0; n < col->leader_nrank[l]; n++)
             {
-                for (c = cgs_gl->index[ma->cg[i]]; c < cgs_gl->index[ma->cg[i]+1]; c++)
-                {
-                    copy_rvec(buf[a++], v[c]);
-                }
+                ma->nat_off[col->order[i]] = a;
+                a += ma->nat[col->order[i]];
+                i++;
             }
+            col->leader_count[l] = a*sizeof(rvec) - col->leader_disp[l];
+        }
+
+#if defined(MPI_IN_PLACE_EXISTS)
+        MPI_Gatherv(MPI_IN_PLACE, nat_node*sizeof(rvec), MPI_BYTE,
+                    ma->vbuf, col->leader_count, col->leader_disp, MPI_BYTE,
+                    0, col->mpi_comm_leaders);
+#else
+        /* The send buffer may not overlap with the receive buffer,
+         * node_buf is not used on the master, so we copy to it.
+         */
+        if (nat_node > col->node_buf_nalloc)
+        {
+            col->node_buf_nalloc = over_alloc_dd(nat_node);
+            srenew(col->node_buf, col->node_buf_nalloc);
+        }
+        for (i = 0; i < nat_node; i++)
+        {
+            copy_rvec(ma->vbuf[i], col->node_buf[i]);
         }
+        MPI_Gatherv(col->node_buf, nat_node*sizeof(rvec), MPI_BYTE,
+                    ma->vbuf, col->leader_count, col->leader_disp, MPI_BYTE,
+                    0, col->mpi_comm_leaders);
+#endif
+
+        dd_collect_vec_reorder(dd, ma->vbuf, v);
     }
+    else
+    {
+        MPI_Gatherv(buf, nat_node*sizeof(rvec), MPI_BYTE,
+                    NULL, NULL, NULL, MPI_BYTE,
+                    0, col->mpi_comm_leaders);
+    }
+#endif
 }
 
 void dd_collect_vec(gmx_domdec_t *dd,
@@ -1562,21 +1859,29 @@ void dd_collect_vec(gmx_domdec_t *dd,
 {
     dd_collect_cg(dd, state_local);
 
+    if (!dd->comm->bCollectSetup)
+    {
+        setup_collect_hierarchical(dd);
+    }
+
     if (dd->nnodes <= GMX_DD_NNODES_SENDRECV)
     {
         dd_collect_vec_sendrecv(dd, lv, v);
     }
+    else if (dd->comm->collect != NULL)
+    {
+        dd_collect_vec_hierarchical(dd, lv, v);
+    }
     else
     {
         dd_collect_vec_gatherv(dd, lv, v);
     }
 }
 
-
-void dd_collect_state(gmx_domdec_t *dd,
-                      t_state *state_local, t_state *state)
+void dd_collect_state_nondistr(gmx_domdec_t *dd,
+                               t_state *state_local, t_state *state)
 {
-    int est, i, j, nh;
+    int i, j, nh;
 
     nh = state->nhchainlength;
 
@@ -1613,6 +1918,15 @@ void dd_collect_state(gmx_domdec_t *dd,
             }
         }
     }
+}
+
+void dd_collect_state(gmx_domdec_t *dd,
+                      t_state *state_local, t_state *state)
+{
+    int est;
+
+    dd_collect_state_nondistr(dd, state_local, state);
+
     for (est = 0; est < estNR; est++)
     {
         if (EST_DISTR(est) && (state_local->flags & (1<<est)))
@@ -6085,6 +6399,7 @@ static gmx_domdec_master_t *init_gmx_domdec_master_t(gmx_domdec_t *dd,
     snew(ma->index, dd->nnodes+1);
     snew(ma->cg, ncg);
     snew(ma->nat, dd->nnodes);
+    snew(ma->nat_off, dd->nnodes);
     snew(ma->ibuf, dd->nnodes*2);
     snew(ma->cell_x, DIM);
     for (i = 0; i < DIM; i++)
@@ -6659,6 +6974,7 @@ gmx_domdec_t *init_domain_decomposition(FILE *fplog, t_commrec *cr,
     comm->nstDDDump     = dd_getenv(fplog, "GMX_DD_NST_DUMP", 0);
     comm->nstDDDumpGrid = dd_getenv(fplog, "GMX_DD_NST_DUMP_GRID", 0);
     comm->DD_debug      = dd_getenv(fplog, "GMX_DD_DEBUG", 0);
+    comm->eCollectHier  = dd_getenv(fplog, "GMX_DD_COLLECT_HIERARCHICAL", -1);
 
     dd->pme_recv_f_alloc = 0;
     dd->pme_recv_f_buf   = NULL;
@@ -206,6 +206,21 @@ void dd_collect_vec(gmx_domdec_t *dd,
 void dd_collect_state(gmx_domdec_t *dd,
                       t_state *state_local, t_state *state);
 
+/*! \brief Copies the non-distributed entries of \p state_local to \p state on the master rank
+ *
+ * This is the part of dd_collect_state() that involves no communication.
+ */
+void dd_collect_state_nondistr(gmx_domdec_t *dd,
+                               t_state *state_local, t_state *state);
+
+/*! \brief Returns the number of home atoms of \p state_local and their global indices
+ *
+ * The indices are returned in \p *index, which is (re)allocated
+ * with allocation size \p *index_nalloc.
+ */
+int dd_get_home_atom_indices(gmx_domdec_t *dd, t_state *state_local,
+                             int **index, int *index_nalloc);
+
 /*! \brief Cycle counter indices used internally in the domain decomposition */
 enum {
     ddCyclStep, ddCyclPPduringPME, ddCyclF, ddCyclWaitGPU, ddCyclPME, ddCyclNr
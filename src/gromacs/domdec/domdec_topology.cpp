@@ -45,6 +45,7 @@
 
 #include "gmxpre.h"
 
+#include <stdlib.h>
 #include <string.h>
 
 #include "gromacs/domdec/domdec.h"
@@ -2378,7 +2379,8 @@ void dd_bonded_cg_distance(FILE *fplog,
 
     bExclRequired = IR_EXCL_FORCES(*ir);
 
-    vsite = init_vsite(mtop, NULL, TRUE);
+    vsite = init_vsite(mtop, NULL, TRUE,
+                       getenv("GMX_DISABLE_SIMD_KERNELS") == NULL);
 
     *r_2b     = 0;
     *r_mb     = 0;
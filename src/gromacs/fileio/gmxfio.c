@@ -347,6 +347,8 @@ static t_fileio *gmx_fio_get_first(void)
     {
         /* after this, the open_file pointer should never change */
         ret = NULL;
+        /* There is no file to get next, so we release the lock here */
+        tMPI_Thread_mutex_unlock(&open_file_mutex);
     }
     else
     {
@@ -449,6 +451,8 @@ t_fileio *gmx_fio_open(const char *fn, const char *mode)
     bReadWrite = (newmode[1] == '+');
     fio->fp    = NULL;
     fio->xdr   = NULL;
+    fio->tail  = NULL;
+    xdr3dfcoord_data_init(&fio->xdr3dfcoord_data);
     if (fn)
     {
         fio->iFTP   = fn2ftp(fn);
@@ -523,6 +527,156 @@ t_fileio *gmx_fio_open(const char *fn, const char *mode)
     return fio;
 }
 
+/*1MB: large size important to catch almost identical files */
+#define CPT_CHK_LEN  1048576
+
+/* For the checkpoint md5 sums we keep a copy of the last CPT_CHK_LEN
+ * bytes of each output file in a ring buffer. Data written through
+ * the XDR layer is copied into the ring as it is written. Anything
+ * else, e.g. text written directly to the FILE pointer, is read back
+ * from the file, but only the part that was appended since the previous
+ * checksum. The byte at file position p is stored at p % CPT_CHK_LEN.
+ */
+struct t_fio_tail
+{
+    unsigned char  *buf;      /* the ring buffer of CPT_CHK_LEN bytes */
+    gmx_off_t       offset;   /* file position just after the last valid
+                                 byte in buf, -1 when invalid */
+    gmx_off_t       ncaptured; /* bytes captured from XDR since the last
+                                  checksum */
+#ifdef GMX_INTERNAL_XDR
+    struct xdr_ops  ops;      /* the XDR ops with our capturing writers */
+    struct xdr_ops *ops_orig; /* the original XDR ops */
+#endif
+};
+
+static void fio_tail_append(t_fio_tail *tail, const unsigned char *data,
+                            gmx_off_t len)
+{
+    gmx_off_t pos, n;
+
+    if (tail->offset < 0)
+    {
+        return;
+    }
+    if (len > CPT_CHK_LEN)
+    {
+        data         += len - CPT_CHK_LEN;
+        tail->offset += len - CPT_CHK_LEN;
+        len           = CPT_CHK_LEN;
+    }
+    while (len > 0)
+    {
+        pos = tail->offset % CPT_CHK_LEN;
+        n   = min(len, CPT_CHK_LEN - pos);
+        memcpy(tail->buf + pos, data, n);
+        data            += n;
+        len             -= n;
+        tail->offset    += n;
+        tail->ncaptured += n;
+    }
+}
+
+#ifdef GMX_INTERNAL_XDR
+static bool_t fio_tail_putbytes(XDR *xdrs, char *addr, unsigned int len)
+{
+    t_fileio *fio = (t_fileio *)xdrs->x_public;
+    bool_t    ret;
+
+    ret = fio->tail->ops_orig->x_putbytes(xdrs, addr, len);
+    if (ret)
+    {
+        fio_tail_append(fio->tail, (const unsigned char *)addr, len);
+    }
+    return ret;
+}
+
+static void fio_tail_append_uint32(t_fio_tail *tail, xdr_uint32_t u)
+{
+    unsigned char b[4];
+
+    /* XDR stores integers big-endian */
+    b[0] = (u >> 24) & 0xff;
+    b[1] = (u >> 16) & 0xff;
+    b[2] = (u >>  8) & 0xff;
+    b[3] = u & 0xff;
+    fio_tail_append(tail, b, 4);
+}
+
+static bool_t fio_tail_putint32(XDR *xdrs, xdr_int32_t *ip)
+{
+    t_fileio *fio = (t_fileio *)xdrs->x_public;
+    bool_t    ret;
+
+    ret = fio->tail->ops_orig->x_putint32(xdrs, ip);
+    if (ret)
+    {
+        fio_tail_append_uint32(fio->tail, (xdr_uint32_t)*ip);
+    }
+    return ret;
+}
+
+static bool_t fio_tail_putuint32(XDR *xdrs, xdr_uint32_t *ip)
+{
+    t_fileio *fio = (t_fileio *)xdrs->x_public;
+    bool_t    ret;
+
+    ret = fio->tail->ops_orig->x_putuint32(xdrs, ip);
+    if (ret)
+    {
+        fio_tail_append_uint32(fio->tail, *ip);
+    }
+    return ret;
+}
+
+static bool_t fio_tail_setpos(XDR *xdrs, unsigned int pos)
+{
+    t_fileio *fio = (t_fileio *)xdrs->x_public;
+
+    /* we don't know what will be overwritten, start over */
+    fio->tail->offset = -1;
+
+    return fio->tail->ops_orig->x_setpostn(xdrs, pos);
+}
+
+/* Let the XDR stream of fio copy all data it writes into the tail */
+static void fio_tail_hook_xdr(t_fileio *fio)
+{
+    t_fio_tail *tail = fio->tail;
+
+    if (fio->xdr == NULL || fio->xdrmode != XDR_ENCODE ||
+        fio->xdr->x_ops == &tail->ops)
+    {
+        return;
+    }
+    tail->ops_orig        = fio->xdr->x_ops;
+    tail->ops             = *tail->ops_orig;
+    tail->ops.x_putbytes  = fio_tail_putbytes;
+    tail->ops.x_putint32  = fio_tail_putint32;
+    tail->ops.x_putuint32 = fio_tail_putuint32;
+    tail->ops.x_setpostn  = fio_tail_setpos;
+    fio->xdr->x_ops       = &tail->ops;
+    fio->xdr->x_public    = (char *)fio;
+}
+#endif
+
+static void fio_tail_invalidate(t_fileio *fio)
+{
+    if (fio->tail)
+    {
+        fio->tail->offset = -1;
+    }
+}
+
+static void fio_tail_done(t_fileio *fio)
+{
+    if (fio->tail)
+    {
+        sfree(fio->tail->buf);
+        sfree(fio->tail);
+    }
+}
+
 static int gmx_fio_close_locked(t_fileio *fio)
 {
     int rc = 0;
@@ -537,6 +691,8 @@ static int gmx_fio_close_locked(t_fileio *fio)
         xdr_destroy(fio->xdr);
         sfree(fio->xdr);
     }
+    xdr3dfcoord_data_done(&fio->xdr3dfcoord_data);
+    fio_tail_done(fio);
 
     /* Don't close stdin and stdout! */
     if (!fio->bStdio && fio->fp != NULL)
@@ -627,29 +783,18 @@ int gmx_fio_fclose(FILE *fp)
     return rc;
 }
 
-/* internal variant of get_file_md5 that operates on a locked file */
-static int gmx_fio_int_get_file_md5(t_fileio *fio, gmx_off_t offset,
-                                    unsigned char digest[])
+/* Reads [tail->offset, offset) from the file into the ring buffer.
+ * Returns 0 on success, -1 on failure.
+ */
+static int fio_tail_read(t_fileio *fio, gmx_off_t offset)
 {
-    /*1MB: large size important to catch almost identical files */
-#define CPT_CHK_LEN  1048576
-    md5_state_t    state;
-    unsigned char *buf;
-    gmx_off_t      read_len;
-    gmx_off_t      seek_offset;
-    int            ret = -1;
-
-    seek_offset = offset - CPT_CHK_LEN;
-    if (seek_offset < 0)
-    {
-        seek_offset = 0;
-    }
-    read_len = offset - seek_offset;
-
+    t_fio_tail *tail = fio->tail;
+    gmx_off_t   pos, n;
+    int         ret = -1;
 
     if (fio->fp && fio->bReadWrite)
     {
-        ret = gmx_fseek(fio->fp, seek_offset, SEEK_SET);
+        ret = gmx_fseek(fio->fp, tail->offset, SEEK_SET);
         if (ret)
         {
             gmx_fseek(fio->fp, 0, SEEK_END);
@@ -660,59 +805,109 @@ static int gmx_fio_int_get_file_md5(t_fileio *fio, gmx_off_t offset,
         return -1;
     }
 
-    snew(buf, CPT_CHK_LEN);
     /* the read puts the file position back to offset */
-    if ((gmx_off_t)fread(buf, 1, read_len, fio->fp) != read_len)
+    while (tail->offset < offset)
     {
-        /* not fatal: md5sum check to prevent overwriting files
-         * works (less safe) without
-         * */
-        if (ferror(fio->fp))
+        pos = tail->offset % CPT_CHK_LEN;
+        n   = min(offset - tail->offset, CPT_CHK_LEN - pos);
+        if ((gmx_off_t)fread(tail->buf + pos, 1, n, fio->fp) != n)
         {
-            fprintf(stderr, "\nTrying to get md5sum: %s: %s\n", fio->fn,
-                    strerror(errno));
-        }
-        else if (feof(fio->fp))
-        {
-            /*
-             * For long runs that checkpoint frequently but write e.g. logs
-             * infrequently we don't want to issue lots of warnings before we
-             * have written anything to the log.
-             */
-            if (0)
+            /* not fatal: md5sum check to prevent overwriting files
+             * works (less safe) without
+             * */
+            if (ferror(fio->fp))
             {
-                fprintf(stderr, "\nTrying to get md5sum: EOF: %s\n", fio->fn);
+                fprintf(stderr, "\nTrying to get md5sum: %s: %s\n", fio->fn,
+                        strerror(errno));
+            }
+            else if (feof(fio->fp))
+            {
+                /*
+                 * For long runs that checkpoint frequently but write e.g. logs
+                 * infrequently we don't want to issue lots of warnings before we
+                 * have written anything to the log.
+                 */
+                if (0)
+                {
+                    fprintf(stderr, "\nTrying to get md5sum: EOF: %s\n", fio->fn);
+                }
+            }
+            else
+            {
+                fprintf(
+                        stderr,
+                        "\nTrying to get md5sum: Unknown reason for short read: %s\n",
+                        fio->fn);
             }
-        }
-        else
-        {
-            fprintf(
-                    stderr,
-                    "\nTrying to get md5sum: Unknown reason for short read: %s\n",
-                    fio->fn);
-        }
-
-        gmx_fseek(fio->fp, 0, SEEK_END);
 
-        ret = -1;
+            tail->offset = -1;
+            ret          = -1;
+            break;
+        }
+        tail->offset += n;
     }
     gmx_fseek(fio->fp, 0, SEEK_END); /*is already at end, but under windows
                                         it gives problems otherwise*/
 
-    if (debug)
+    return ret;
+}
+
+/* internal variant of get_file_md5 that operates on a locked file */
+static int gmx_fio_int_get_file_md5(t_fileio *fio, gmx_off_t offset,
+                                    unsigned char digest[])
+{
+    md5_state_t    state;
+    t_fio_tail    *tail;
+    gmx_off_t      read_len;
+    gmx_off_t      seek_offset;
+    gmx_off_t      pos, n;
+
+    seek_offset = offset - CPT_CHK_LEN;
+    if (seek_offset < 0)
     {
-        fprintf(debug, "chksum %s readlen %ld\n", fio->fn, (long int)read_len);
+        seek_offset = 0;
     }
+    read_len = offset - seek_offset;
 
-    if (!ret)
+    if (fio->tail == NULL)
     {
-        gmx_md5_init(&state);
-        gmx_md5_append(&state, buf, read_len);
-        gmx_md5_finish(&state, digest);
-        ret = read_len;
+        snew(fio->tail, 1);
+        snew(fio->tail->buf, CPT_CHK_LEN);
+        fio->tail->offset = -1;
     }
-    sfree(buf);
-    return ret;
+    tail = fio->tail;
+
+    /* The ring contents can only be used when they end at offset, or
+     * when they end earlier and everything after that was written
+     * without going through XDR, so we can read the missing part.
+     */
+    if (tail->offset < seek_offset || tail->offset > offset ||
+        (tail->ncaptured > 0 && tail->offset != offset))
+    {
+        tail->offset = seek_offset;
+    }
+    tail->ncaptured = 0;
+    if (tail->offset < offset && fio_tail_read(fio, offset) != 0)
+    {
+        return -1;
+    }
+#ifdef GMX_INTERNAL_XDR
+    fio_tail_hook_xdr(fio);
+#endif
+
+    if (debug)
+    {
+        fprintf(debug, "chksum %s readlen %ld\n", fio->fn, (long int)read_len);
+    }
+
+    gmx_md5_init(&state);
+    pos = seek_offset % CPT_CHK_LEN;
+    n   = min(read_len, CPT_CHK_LEN - pos);
+    gmx_md5_append(&state, tail->buf + pos, n);
+    gmx_md5_append(&state, tail->buf, read_len - n);
+    gmx_md5_finish(&state, digest);
+
+    return read_len;
 }
 
 
@@ -897,6 +1092,8 @@ void gmx_fio_rewind(t_fileio* fio)
 {
     gmx_fio_lock(fio);
 
+    fio_tail_invalidate(fio);
+
     if (fio->xdr)
     {
         xdr_destroy(fio->xdr);
@@ -1014,6 +1211,7 @@ int gmx_fio_seek(t_fileio* fio, gmx_off_t fpos)
     int rc;
 
     gmx_fio_lock(fio);
+    fio_tail_invalidate(fio);
     if (fio->fp)
     {
         rc = gmx_fseek(fio->fp, fpos, SEEK_SET);
@@ -1054,6 +1252,17 @@ XDR *gmx_fio_getxdr(t_fileio* fio)
     return ret;
 }
 
+t_xdr3dfcoord_data *gmx_fio_getxdr3dfcoord_data(t_fileio* fio)
+{
+    t_xdr3dfcoord_data *ret;
+
+    gmx_fio_lock(fio);
+    ret = &fio->xdr3dfcoord_data;
+    gmx_fio_unlock(fio);
+
+    return ret;
+}
+
 gmx_bool gmx_fio_getread(t_fileio* fio)
 {
     gmx_bool ret;
@@ -74,6 +74,8 @@ typedef struct
     write_func *nwrite;
 } t_iotype;
 
+/* running copy of the tail of an output file, used for checksumming */
+typedef struct t_fio_tail t_fio_tail;
 
 
 struct t_fileio
@@ -88,6 +90,8 @@ struct t_fileio
                     bReadWrite;        /* the file is open for reading and writing */
     char        *fn;                   /* the file name */
     XDR         *xdr;                  /* the xdr data pointer */
+    t_xdr3dfcoord_data xdr3dfcoord_data; /* work arrays for reading
+                                            compressed coordinates */
     enum xdr_op  xdrmode;              /* the xdr mode */
     int          iFTP;                 /* the file type identifier */
 
@@ -99,6 +103,9 @@ struct t_fileio
                                           for performance reasons: in some cases every
                                           single byte that gets read/written requires
                                           a lock */
+    t_fio_tail  *tail;                 /* copy of the last written bytes for the
+                                          checkpoint md5 sums, NULL until the
+                                          first checksum is requested */
 };
 
 
@@ -44,7 +44,9 @@
 
 #include "gromacs/fileio/xdr_datatype.h"
 #include "gromacs/fileio/xdrf.h"
+#include "gromacs/simd/simd.h"
 #include "gromacs/utility/futil.h"
+#include "gromacs/utility/gmxomp.h"
 
 /* This is just for clarity - it can never be anything but 4! */
 #define XDR_INT_SIZE 4
@@ -371,6 +373,422 @@ static void receiveints(int buf[], const int num_of_ints, int num_of_bits,
     nums[0] = bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | (bytes[3] << 24);
 }
 
+/*____________________________________________________________________________
+ |
+ | Multi-threaded compression.
+ |
+ | The compressed stream is a single sequence of bits, and the size of the
+ | small integers (smallidx) as well as the run lengths are adapted along
+ | the way, so the stream can not be split into independent parts without
+ | changing the format. However, the decisions on how each atom is stored
+ | only need cheap comparisons of the integer coordinates. So for large
+ | systems we first make all decisions serially, recording them as a list
+ | of blocks that each start with an atom stored with full precision.
+ | As the number of bits of each block is then known, the expensive packing
+ | of the integers with sendints() can be done for ranges of blocks in
+ | parallel, after which the bit streams of the threads are shifted into
+ | place in the output buffer. The result is identical to the serial code.
+ |
+ */
+
+/* Minimum number of atoms per thread for compressing with multiple threads */
+#define XTC_MIN_ATOMS_PER_THREAD 10000
+
+/* The storage decisions for an atom stored with full precision,
+ * followed by a run of atoms stored as small differences.
+ */
+typedef struct
+{
+    int atom;     /* Index of the first atom                                */
+    int nsmall;   /* Number of following atoms stored as small differences  */
+    int runflag;  /* Value stored for a changed run length, -1 if unchanged */
+    int smallidx; /* Index into magicints for the small differences         */
+    int nbits;    /* Total number of bits for this block                    */
+} t_xtc_block;
+
+/* Returns the number of threads to use for compressing size atoms,
+ * at most nthreads, or the OpenMP default when nthreads <= 0.
+ */
+static int xtc_compress_nthreads(int size, int nthreads)
+{
+    int nth;
+
+    nth = (nthreads > 0 ? nthreads : gmx_omp_get_max_threads());
+    /* The per-thread work arrays are sized for this many threads */
+    nth = MIN(nth, GMX_OPENMP_MAX_THREADS);
+    nth = MIN(nth, size/XTC_MIN_ATOMS_PER_THREAD);
+
+    return MAX(nth, 1);
+}
+
+/* Converts a coordinate to an integer, sets *errval to 0 on overflow */
+static gmx_inline int xtc_float_to_int(float x, float precision, int *errval)
+{
+    float lf;
+
+    /* find nearest integer */
+    if (x >= 0.0)
+    {
+        lf = x * precision + 0.5;
+    }
+    else
+    {
+        lf = x * precision - 0.5;
+    }
+    if (fabs(lf) > MAXABS)
+    {
+        /* scaling would cause overflow */
+        *errval = 0;
+    }
+    return lf;
+}
+
+/* Converts the size coordinate triplets in fp to integers in ip using nth
+ * threads, and determines their range and the minimum difference between
+ * successive atoms.
+ */
+static void xtc_convert_parallel(const float *fp, int size, float precision,
+                                 int *ip, int minint[], int maxint[],
+                                 int *mindiff, int *errval, int nth)
+{
+    int thminint[GMX_OPENMP_MAX_THREADS][3], thmaxint[GMX_OPENMP_MAX_THREADS][3];
+    int thmindiff[GMX_OPENMP_MAX_THREADS], therrval[GMX_OPENMP_MAX_THREADS];
+    int t, d;
+
+#pragma omp parallel num_threads(nth)
+    {
+        int th, i, i0, i1, m, diff, lint;
+
+        th = gmx_omp_get_thread_num();
+        i0 = (th*size)/nth;
+        i1 = ((th + 1)*size)/nth;
+        for (m = 0; m < 3; m++)
+        {
+            thminint[th][m] = INT_MAX;
+            thmaxint[th][m] = INT_MIN;
+        }
+        therrval[th] = 1;
+        for (i = i0*3; i < i1*3; i += 3)
+        {
+            for (m = 0; m < 3; m++)
+            {
+                lint            = xtc_float_to_int(fp[i + m], precision, &therrval[th]);
+                thminint[th][m] = MIN(thminint[th][m], lint);
+                thmaxint[th][m] = MAX(thmaxint[th][m], lint);
+                ip[i + m]       = lint;
+            }
+        }
+#pragma omp barrier
+        thmindiff[th] = INT_MAX;
+        for (i = MAX(i0, 1)*3; i < i1*3; i += 3)
+        {
+            diff = abs(ip[i - 3] - ip[i]) + abs(ip[i - 2] - ip[i + 1]) + abs(ip[i - 1] - ip[i + 2]);
+            thmindiff[th] = MIN(thmindiff[th], diff);
+        }
+    }
+
+    for (t = 0; t < nth; t++)
+    {
+        for (d = 0; d < 3; d++)
+        {
+            minint[d] = MIN(minint[d], thminint[t][d]);
+            maxint[d] = MAX(maxint[d], thmaxint[t][d]);
+        }
+        *mindiff = MIN(*mindiff, thmindiff[t]);
+        *errval  = MIN(*errval, therrval[t]);
+    }
+}
+
+/* Makes the same decisions on how to store the atoms as the serial loop
+ * in xdr3dfcoord(), including the interchanges of atoms in ip, and stores
+ * them in *blocks. Returns the number of blocks.
+ */
+static int xtc_plan_blocks(int *ip, int size, int smallidx, int bigbits,
+                           t_xtc_block **blocks)
+{
+    int          maxidx, minidx, larger, smaller, smallnum;
+    int          is_small, is_smaller, run, prevrun, i, nblock, tmp;
+    int         *thiscoord, *prevcoord;
+    t_xtc_block *b;
+
+    *blocks = (t_xtc_block *)malloc((size_t)(size * sizeof(**blocks)));
+    if (*blocks == NULL)
+    {
+        fprintf(stderr, "malloc failed\n");
+        exit(1);
+    }
+
+    maxidx    = MIN(LASTIDX, smallidx + 8);
+    minidx    = maxidx - 8; /* often this equal smallidx */
+    smaller   = magicints[MAX(FIRSTIDX, smallidx-1)] / 2;
+    smallnum  = magicints[smallidx] / 2;
+    larger    = magicints[maxidx] / 2;
+    prevrun   = -1;
+    prevcoord = NULL;
+    nblock    = 0;
+    i         = 0;
+    while (i < size)
+    {
+        is_small  = 0;
+        thiscoord = ip + i * 3;
+        if (smallidx < maxidx && i >= 1 &&
+            abs(thiscoord[0] - prevcoord[0]) < larger &&
+            abs(thiscoord[1] - prevcoord[1]) < larger &&
+            abs(thiscoord[2] - prevcoord[2]) < larger)
+        {
+            is_smaller = 1;
+        }
+        else if (smallidx > minidx)
+        {
+            is_smaller = -1;
+        }
+        else
+        {
+            is_smaller = 0;
+        }
+        if (i + 1 < size)
+        {
+            if (abs(thiscoord[0] - thiscoord[3]) < smallnum &&
+                abs(thiscoord[1] - thiscoord[4]) < smallnum &&
+                abs(thiscoord[2] - thiscoord[5]) < smallnum)
+            {
+                /* interchange first with second atom for better
+                 * compression of water molecules
+                 */
+                tmp          = thiscoord[0]; thiscoord[0] = thiscoord[3];
+                thiscoord[3] = tmp;
+                tmp          = thiscoord[1]; thiscoord[1] = thiscoord[4];
+                thiscoord[4] = tmp;
+                tmp          = thiscoord[2]; thiscoord[2] = thiscoord[5];
+                thiscoord[5] = tmp;
+                is_small     = 1;
+            }
+        }
+        b         = &(*blocks)[nblock++];
+        b->atom   = i;
+        prevcoord = thiscoord;
+        thiscoord = thiscoord + 3;
+        i++;
+
+        run = 0;
+        if (is_small == 0 && is_smaller == -1)
+        {
+            is_smaller = 0;
+        }
+        while (is_small && run < 8*3)
+        {
+            if (is_smaller == -1 && (
+                    SQR(thiscoord[0] - prevcoord[0]) +
+                    SQR(thiscoord[1] - prevcoord[1]) +
+                    SQR(thiscoord[2] - prevcoord[2]) >= smaller * smaller))
+            {
+                is_smaller = 0;
+            }
+            run      += 3;
+            prevcoord = thiscoord;
+            i++;
+            thiscoord = thiscoord + 3;
+            is_small  = 0;
+            if (i < size &&
+                abs(thiscoord[0] - prevcoord[0]) < smallnum &&
+                abs(thiscoord[1] - prevcoord[1]) < smallnum &&
+                abs(thiscoord[2] - prevcoord[2]) < smallnum)
+            {
+                is_small = 1;
+            }
+        }
+        if (run != prevrun || is_smaller != 0)
+        {
+            prevrun    = run;
+            b->runflag = run + is_smaller + 1;
+        }
+        else
+        {
+            b->runflag = -1;
+        }
+        b->nsmall   = run/3;
+        b->smallidx = smallidx;
+        b->nbits    = bigbits + (b->runflag >= 0 ? 6 : 1) + b->nsmall*smallidx;
+        if (is_smaller != 0)
+        {
+            smallidx += is_smaller;
+            if (is_smaller < 0)
+            {
+                smallnum = smaller;
+                smaller  = magicints[smallidx-1] / 2;
+            }
+            else
+            {
+                smaller  = smallnum;
+                smallnum = magicints[smallidx] / 2;
+            }
+        }
+    }
+
+    return nblock;
+}
+
+/* Compresses the integer coordinates in ip, interchanged as planned by
+ * xtc_plan_blocks(), with nth threads into the bytes of buf, in the same
+ * format as sendbits() uses. Returns the number of bytes.
+ */
+static int xtc_encode_parallel(const int *ip, const t_xtc_block *blocks, int nblock,
+                               const int minint[], unsigned int sizeint[],
+                               const unsigned int bitsizeint[], unsigned int bitsize,
+                               int buf[], int nth)
+{
+    int            blockstart[GMX_OPENMP_MAX_THREADS + 1];
+    gmx_int64_t    bitstart[GMX_OPENMP_MAX_THREADS + 1];
+    int            g0[GMX_OPENMP_MAX_THREADS], g1[GMX_OPENMP_MAX_THREADS];
+    unsigned char  first[GMX_OPENMP_MAX_THREADS], last[GMX_OPENMP_MAX_THREADS];
+    unsigned char *cbuf;
+    gmx_int64_t    nbits, target, start;
+    int            b, t;
+
+    /* Divide the blocks over the threads, with equal numbers of bits */
+    nbits = 0;
+    for (b = 0; b < nblock; b++)
+    {
+        nbits += blocks[b].nbits;
+    }
+    blockstart[0] = 0;
+    bitstart[0]   = 0;
+    b             = 0;
+    start         = 0;
+    for (t = 1; t < nth; t++)
+    {
+        target = (nbits*t)/nth;
+        while (b < nblock && start + blocks[b].nbits <= target)
+        {
+            start += blocks[b].nbits;
+            b++;
+        }
+        blockstart[t] = b;
+        bitstart[t]   = start;
+    }
+    blockstart[nth] = nblock;
+    bitstart[nth]   = nbits;
+
+    cbuf = (unsigned char *)&buf[3];
+
+#pragma omp parallel num_threads(nth)
+    {
+        int            th, bl, lbuf_nalloc, k, s, g, nb, lnbytes;
+        int           *lbuf;
+        unsigned char *lcbuf, val;
+        unsigned int   tmpcoord[3], sizesmall[3];
+        const int     *coord;
+
+        th = gmx_omp_get_thread_num();
+        nb = bitstart[th + 1] - bitstart[th];
+        g0[th] = 0;
+        g1[th] = -1;
+        if (nb > 0)
+        {
+            /* Encode our blocks in a local buffer, with some zero padding */
+            lbuf_nalloc = 3 + nb/32 + 2;
+            lbuf        = (int *)calloc((size_t)lbuf_nalloc, sizeof(*lbuf));
+            if (lbuf == NULL)
+            {
+                fprintf(stderr, "malloc failed\n");
+                exit(1);
+            }
+            for (bl = blockstart[th]; bl < blockstart[th + 1]; bl++)
+            {
+                coord       = ip + blocks[bl].atom * 3;
+                tmpcoord[0] = coord[0] - minint[0];
+                tmpcoord[1] = coord[1] - minint[1];
+                tmpcoord[2] = coord[2] - minint[2];
+                if (bitsize == 0)
+                {
+                    sendbits(lbuf, bitsizeint[0], tmpcoord[0]);
+                    sendbits(lbuf, bitsizeint[1], tmpcoord[1]);
+                    sendbits(lbuf, bitsizeint[2], tmpcoord[2]);
+                }
+                else
+                {
+                    sendints(lbuf, 3, bitsize, sizeint, tmpcoord);
+                }
+                if (blocks[bl].runflag >= 0)
+                {
+                    sendbits(lbuf, 1, 1); /* flag the change in run-length */
+                    sendbits(lbuf, 5, blocks[bl].runflag);
+                }
+                else
+                {
+                    sendbits(lbuf, 1, 0); /* flag the fact that runlength did not change */
+                }
+                sizesmall[0] = sizesmall[1] = sizesmall[2] = magicints[blocks[bl].smallidx];
+                for (k = 0; k < blocks[bl].nsmall; k++)
+                {
+                    coord      += 3;
+                    tmpcoord[0] = coord[0] - coord[-3] + magicints[blocks[bl].smallidx] / 2;
+                    tmpcoord[1] = coord[1] - coord[-2] + magicints[blocks[bl].smallidx] / 2;
+                    tmpcoord[2] = coord[2] - coord[-1] + magicints[blocks[bl].smallidx] / 2;
+                    sendints(lbuf, 3, blocks[bl].smallidx, sizesmall, tmpcoord);
+                }
+            }
+            lcbuf   = (unsigned char *)&lbuf[3];
+            lnbytes = (nb + 7)/8;
+            lcbuf[lnbytes] = 0;
+
+            /* Shift our bits into place. The first and last byte can be
+             * shared with the neighboring threads, so are combined later.
+             */
+            s      = bitstart[th] % 8;
+            g0[th] = bitstart[th]/8;
+            g1[th] = (bitstart[th + 1] - 1)/8;
+            for (g = g0[th]; g <= g1[th]; g++)
+            {
+                k = g - g0[th];
+                if (s == 0)
+                {
+                    val = lcbuf[k];
+                }
+                else
+                {
+                    val = ((k > 0 ? lcbuf[k - 1] << (8 - s) : 0) | (lcbuf[k] >> s)) & 0xff;
+                }
+                if (g == g0[th])
+                {
+                    first[th] = val;
+                }
+                else if (g == g1[th])
+                {
+                    last[th] = val;
+                }
+                else
+                {
+                    cbuf[g] = val;
+                }
+            }
+            free(lbuf);
+        }
+    }
+
+    for (t = 0; t < nth; t++)
+    {
+        if (g1[t] >= g0[t])
+        {
+            cbuf[g0[t]] = 0;
+            cbuf[g1[t]] = 0;
+        }
+    }
+    for (t = 0; t < nth; t++)
+    {
+        if (g1[t] >= g0[t])
+        {
+            cbuf[g0[t]] |= first[t];
+            if (g1[t] > g0[t])
+            {
+                cbuf[g1[t]] |= last[t];
+            }
+        }
+    }
+
+    return (int)((nbits + 7)/8);
+}
+
 /*____________________________________________________________________________
  |
  | xdr3dfcoord - read or write compressed 3d coordinates to xdr file.
@@ -399,6 +817,12 @@ static void receiveints(int buf[], const int num_of_ints, int num_of_bits,
  */
 
 int xdr3dfcoord(XDR *xdrs, float *fp, int *size, float *precision)
+{
+    return xdr3dfcoord_nthreads(xdrs, fp, size, precision, 0);
+}
+
+int xdr3dfcoord_nthreads(XDR *xdrs, float *fp, int *size, float *precision,
+                         int nthreads)
 {
     int     *ip  = NULL;
     int     *buf = NULL;
@@ -414,17 +838,18 @@ int xdr3dfcoord(XDR *xdrs, float *fp, int *size, float *precision)
     int          lint1, lint2, lint3, oldlint1, oldlint2, oldlint3, smallidx;
     int          minidx, maxidx;
     unsigned     sizeint[3], sizesmall[3], bitsizeint[3], size3, *luip;
-    int          flag, k;
+    int          k;
     int          smallnum, smaller, larger, i, is_small, is_smaller, run, prevrun;
-    float       *lfp, lf;
+    float       *lfp;
     int          tmp, *thiscoord,  prevcoord[3];
     unsigned int tmpcoord[30];
 
-    int          bufsize, xdrid, lsize;
+    int          bufsize;
     unsigned int bitsize;
-    float        inv_precision;
     int          errval = 1;
     int          rc;
+    int          nth, nblock;
+    t_xtc_block *blocks;
 
     bRead         = (xdrs->x_op == XDR_DECODE);
     bitsizeint[0] = bitsizeint[1] = bitsizeint[2] = 0;
@@ -479,89 +904,55 @@ int xdr3dfcoord(XDR *xdrs, float *fp, int *size, float *precision)
         lip       = ip;
         mindiff   = INT_MAX;
         oldlint1  = oldlint2 = oldlint3 = 0;
-        while (lfp < fp + size3)
+        nth       = xtc_compress_nthreads(*size, nthreads);
+        if (nth > 1)
         {
-            /* find nearest integer */
-            if (*lfp >= 0.0)
-            {
-                lf = *lfp * *precision + 0.5;
-            }
-            else
-            {
-                lf = *lfp * *precision - 0.5;
-            }
-            if (fabs(lf) > MAXABS)
-            {
-                /* scaling would cause overflow */
-                errval = 0;
-            }
-            lint1 = lf;
-            if (lint1 < minint[0])
-            {
-                minint[0] = lint1;
-            }
-            if (lint1 > maxint[0])
-            {
-                maxint[0] = lint1;
-            }
-            *lip++ = lint1;
-            lfp++;
-            if (*lfp >= 0.0)
-            {
-                lf = *lfp * *precision + 0.5;
-            }
-            else
-            {
-                lf = *lfp * *precision - 0.5;
-            }
-            if (fabs(lf) > MAXABS)
-            {
-                /* scaling would cause overflow */
-                errval = 0;
-            }
-            lint2 = lf;
-            if (lint2 < minint[1])
-            {
-                minint[1] = lint2;
-            }
-            if (lint2 > maxint[1])
-            {
-                maxint[1] = lint2;
-            }
-            *lip++ = lint2;
-            lfp++;
-            if (*lfp >= 0.0)
-            {
-                lf = *lfp * *precision + 0.5;
-            }
-            else
-            {
-                lf = *lfp * *precision - 0.5;
-            }
-            if (fabs(lf) > MAXABS)
-            {
-                /* scaling would cause overflow */
-                errval = 0;
-            }
-            lint3 = lf;
-            if (lint3 < minint[2])
-            {
-                minint[2] = lint3;
-            }
-            if (lint3 > maxint[2])
-            {
-                maxint[2] = lint3;
-            }
-            *lip++ = lint3;
-            lfp++;
-            diff = abs(oldlint1-lint1)+abs(oldlint2-lint2)+abs(oldlint3-lint3);
-            if (diff < mindiff && lfp > fp + 3)
+            xtc_convert_parallel(fp, *size, *precision, ip, minint, maxint,
+                                 &mindiff, &errval, nth);
+        }
+        else
+        {
+            while (lfp < fp + size3)
             {
-                mindiff = diff;
+                lint1 = xtc_float_to_int(*lfp++, *precision, &errval);
+                if (lint1 < minint[0])
+                {
+                    minint[0] = lint1;
+                }
+                if (lint1 > maxint[0])
+                {
+                    maxint[0] = lint1;
+                }
+                *lip++ = lint1;
+                lint2  = xtc_float_to_int(*lfp++, *precision, &errval);
+                if (lint2 < minint[1])
+                {
+                    minint[1] = lint2;
+                }
+                if (lint2 > maxint[1])
+                {
+                    maxint[1] = lint2;
+                }
+                *lip++ = lint2;
+                lint3  = xtc_float_to_int(*lfp++, *precision, &errval);
+                if (lint3 < minint[2])
+                {
+                    minint[2] = lint3;
+                }
+                if (lint3 > maxint[2])
+                {
+                    maxint[2] = lint3;
+                }
+                *lip++ = lint3;
+                diff   = abs(oldlint1-lint1)+abs(oldlint2-lint2)+abs(oldlint3-lint3);
+                if (diff < mindiff && lfp > fp + 3)
+                {
+                    mindiff = diff;
+                }
+                oldlint1 = lint1;
+                oldlint2 = lint2;
+                oldlint3 = lint3;
             }
-            oldlint1 = lint1;
-            oldlint2 = lint2;
-            oldlint3 = lint3;
         }
         if ( (xdr_int(xdrs, &(minint[0])) == 0) ||
              (xdr_int(xdrs, &(minint[1])) == 0) ||
@@ -626,126 +1017,138 @@ int xdr3dfcoord(XDR *xdrs, float *fp, int *size, float *precision)
         smallnum     = magicints[smallidx] / 2;
         sizesmall[0] = sizesmall[1] = sizesmall[2] = magicints[smallidx];
         larger       = magicints[maxidx] / 2;
-        i            = 0;
-        while (i < *size)
+        if (nth > 1)
         {
-            is_small  = 0;
-            thiscoord = (int *)(luip) + i * 3;
-            if (smallidx < maxidx && i >= 1 &&
-                abs(thiscoord[0] - prevcoord[0]) < larger &&
-                abs(thiscoord[1] - prevcoord[1]) < larger &&
-                abs(thiscoord[2] - prevcoord[2]) < larger)
-            {
-                is_smaller = 1;
-            }
-            else if (smallidx > minidx)
-            {
-                is_smaller = -1;
-            }
-            else
-            {
-                is_smaller = 0;
-            }
-            if (i + 1 < *size)
+            nblock = xtc_plan_blocks(ip, *size, smallidx,
+                                     bitsize != 0 ? bitsize : bitsizeint[0] + bitsizeint[1] + bitsizeint[2],
+                                     &blocks);
+            buf[0] = xtc_encode_parallel(ip, blocks, nblock, minint, sizeint,
+                                         bitsizeint, bitsize, buf, nth);
+            free(blocks);
+        }
+        else
+        {
+            i = 0;
+            while (i < *size)
             {
-                if (abs(thiscoord[0] - thiscoord[3]) < smallnum &&
-                    abs(thiscoord[1] - thiscoord[4]) < smallnum &&
-                    abs(thiscoord[2] - thiscoord[5]) < smallnum)
+                is_small  = 0;
+                thiscoord = (int *)(luip) + i * 3;
+                if (smallidx < maxidx && i >= 1 &&
+                    abs(thiscoord[0] - prevcoord[0]) < larger &&
+                    abs(thiscoord[1] - prevcoord[1]) < larger &&
+                    abs(thiscoord[2] - prevcoord[2]) < larger)
                 {
-                    /* interchange first with second atom for better
-                     * compression of water molecules
-                     */
-                    tmp          = thiscoord[0]; thiscoord[0] = thiscoord[3];
-                    thiscoord[3] = tmp;
-                    tmp          = thiscoord[1]; thiscoord[1] = thiscoord[4];
-                    thiscoord[4] = tmp;
-                    tmp          = thiscoord[2]; thiscoord[2] = thiscoord[5];
-                    thiscoord[5] = tmp;
-                    is_small     = 1;
+                    is_smaller = 1;
                 }
-
-            }
-            tmpcoord[0] = thiscoord[0] - minint[0];
-            tmpcoord[1] = thiscoord[1] - minint[1];
-            tmpcoord[2] = thiscoord[2] - minint[2];
-            if (bitsize == 0)
-            {
-                sendbits(buf, bitsizeint[0], tmpcoord[0]);
-                sendbits(buf, bitsizeint[1], tmpcoord[1]);
-                sendbits(buf, bitsizeint[2], tmpcoord[2]);
-            }
-            else
-            {
-                sendints(buf, 3, bitsize, sizeint, tmpcoord);
-            }
-            prevcoord[0] = thiscoord[0];
-            prevcoord[1] = thiscoord[1];
-            prevcoord[2] = thiscoord[2];
-            thiscoord    = thiscoord + 3;
-            i++;
-
-            run = 0;
-            if (is_small == 0 && is_smaller == -1)
-            {
-                is_smaller = 0;
-            }
-            while (is_small && run < 8*3)
-            {
-                if (is_smaller == -1 && (
-                        SQR(thiscoord[0] - prevcoord[0]) +
-                        SQR(thiscoord[1] - prevcoord[1]) +
-                        SQR(thiscoord[2] - prevcoord[2]) >= smaller * smaller))
+                else if (smallidx > minidx)
                 {
-                    is_smaller = 0;
+                    is_smaller = -1;
                 }
-
-                tmpcoord[run++] = thiscoord[0] - prevcoord[0] + smallnum;
-                tmpcoord[run++] = thiscoord[1] - prevcoord[1] + smallnum;
-                tmpcoord[run++] = thiscoord[2] - prevcoord[2] + smallnum;
-
-                prevcoord[0] = thiscoord[0];
-                prevcoord[1] = thiscoord[1];
-                prevcoord[2] = thiscoord[2];
-
-                i++;
-                thiscoord = thiscoord + 3;
-                is_small  = 0;
-                if (i < *size &&
-                    abs(thiscoord[0] - prevcoord[0]) < smallnum &&
-                    abs(thiscoord[1] - prevcoord[1]) < smallnum &&
-                    abs(thiscoord[2] - prevcoord[2]) < smallnum)
+                else
                 {
-                    is_small = 1;
+                    is_smaller = 0;
                 }
-            }
-            if (run != prevrun || is_smaller != 0)
-            {
-                prevrun = run;
-                sendbits(buf, 1, 1); /* flag the change in run-length */
-                sendbits(buf, 5, run+is_smaller+1);
-            }
-            else
-            {
-                sendbits(buf, 1, 0); /* flag the fact that runlength did not change */
-            }
-            for (k = 0; k < run; k += 3)
-            {
-                sendints(buf, 3, smallidx, sizesmall, &tmpcoord[k]);
-            }
-            if (is_smaller != 0)
-            {
-                smallidx += is_smaller;
-                if (is_smaller < 0)
+                if (i + 1 < *size)
+                {
+                    if (abs(thiscoord[0] - thiscoord[3]) < smallnum &&
+                        abs(thiscoord[1] - thiscoord[4]) < smallnum &&
+                        abs(thiscoord[2] - thiscoord[5]) < smallnum)
+                    {
+                        /* interchange first with second atom for better
+                         * compression of water molecules
+                         */
+                        tmp          = thiscoord[0]; thiscoord[0] = thiscoord[3];
+                        thiscoord[3] = tmp;
+                        tmp          = thiscoord[1]; thiscoord[1] = thiscoord[4];
+                        thiscoord[4] = tmp;
+                        tmp          = thiscoord[2]; thiscoord[2] = thiscoord[5];
+                        thiscoord[5] = tmp;
+                        is_small     = 1;
+                    }
+
+                }
+                tmpcoord[0] = thiscoord[0] - minint[0];
+                tmpcoord[1] = thiscoord[1] - minint[1];
+                tmpcoord[2] = thiscoord[2] - minint[2];
+                if (bitsize == 0)
                 {
-                    smallnum = smaller;
-                    smaller  = magicints[smallidx-1] / 2;
+                    sendbits(buf, bitsizeint[0], tmpcoord[0]);
+                    sendbits(buf, bitsizeint[1], tmpcoord[1]);
+                    sendbits(buf, bitsizeint[2], tmpcoord[2]);
                 }
                 else
                 {
-                    smaller  = smallnum;
-                    smallnum = magicints[smallidx] / 2;
+                    sendints(buf, 3, bitsize, sizeint, tmpcoord);
+                }
+                prevcoord[0] = thiscoord[0];
+                prevcoord[1] = thiscoord[1];
+                prevcoord[2] = thiscoord[2];
+                thiscoord    = thiscoord + 3;
+                i++;
+
+                run = 0;
+                if (is_small == 0 && is_smaller == -1)
+                {
+                    is_smaller = 0;
+                }
+                while (is_small && run < 8*3)
+                {
+                    if (is_smaller == -1 && (
+                            SQR(thiscoord[0] - prevcoord[0]) +
+                            SQR(thiscoord[1] - prevcoord[1]) +
+                            SQR(thiscoord[2] - prevcoord[2]) >= smaller * smaller))
+                    {
+                        is_smaller = 0;
+                    }
+
+                    tmpcoord[run++] = thiscoord[0] - prevcoord[0] + smallnum;
+                    tmpcoord[run++] = thiscoord[1] - prevcoord[1] + smallnum;
+                    tmpcoord[run++] = thiscoord[2] - prevcoord[2] + smallnum;
+
+                    prevcoord[0] = thiscoord[0];
+                    prevcoord[1] = thiscoord[1];
+                    prevcoord[2] = thiscoord[2];
+
+                    i++;
+                    thiscoord = thiscoord + 3;
+                    is_small  = 0;
+                    if (i < *size &&
+                        abs(thiscoord[0] - prevcoord[0]) < smallnum &&
+                        abs(thiscoord[1] - prevcoord[1]) < smallnum &&
+                        abs(thiscoord[2] - prevcoord[2]) < smallnum)
+                    {
+                        is_small = 1;
+                    }
+                }
+                if (run != prevrun || is_smaller != 0)
+                {
+                    prevrun = run;
+                    sendbits(buf, 1, 1); /* flag the change in run-length */
+                    sendbits(buf, 5, run+is_smaller+1);
+                }
+                else
+                {
+                    sendbits(buf, 1, 0); /* flag the fact that runlength did not change */
+                }
+                for (k = 0; k < run; k += 3)
+                {
+                    sendints(buf, 3, smallidx, sizesmall, &tmpcoord[k]);
+                }
+                if (is_smaller != 0)
+                {
+                    smallidx += is_smaller;
+                    if (is_smaller < 0)
+                    {
+                        smallnum = smaller;
+                        smaller  = magicints[smallidx-1] / 2;
+                    }
+                    else
+                    {
+                        smaller  = smallnum;
+                        smallnum = magicints[smallidx] / 2;
+                    }
+                    sizesmall[0] = sizesmall[1] = sizesmall[2] = magicints[smallidx];
                 }
-                sizesmall[0] = sizesmall[1] = sizesmall[2] = magicints[smallidx];
             }
         }
         if (buf[1] != 0)
@@ -775,239 +1178,645 @@ int xdr3dfcoord(XDR *xdrs, float *fp, int *size, float *precision)
     }
     else
     {
-
         /* xdrs is open for reading */
+        t_xdr3dfcoord_data data;
 
-        if (xdr_int(xdrs, &lsize) == 0)
-        {
-            return 0;
-        }
-        if (*size != 0 && lsize != *size)
+        xdr3dfcoord_data_init(&data);
+        rc = xdr3dfcoord_read(xdrs, &data, fp, size, precision);
+        xdr3dfcoord_data_done(&data);
+        return rc;
+    }
+}
+
+int xdr3dfcoord_read(XDR *xdrs, t_xdr3dfcoord_data *data,
+                     float *fp, int *size, float *precision)
+{
+    int rc;
+
+    if (xdr3dfcoord_read_compressed(xdrs, data) == 0)
+    {
+        return 0;
+    }
+    if (*size != 0 && data->size != *size)
+    {
+        fprintf(stderr, "wrong number of coordinates in xdr3dfcoord; "
+                "%d arg vs %d in file", *size, data->size);
+    }
+    *size      = data->size;
+    rc         = xdr3dfcoord_decompress(data, fp);
+    *precision = data->precision;
+    return rc;
+}
+
+void xdr3dfcoord_data_init(t_xdr3dfcoord_data *data)
+{
+    data->size       = 0;
+    data->precision  = 0;
+    data->buf        = NULL;
+    data->buf_nalloc = 0;
+    data->ip         = NULL;
+    data->ip_nalloc  = 0;
+}
+
+void xdr3dfcoord_data_done(t_xdr3dfcoord_data *data)
+{
+    free(data->buf);
+    free(data->ip);
+    xdr3dfcoord_data_init(data);
+}
+
+/* Makes sure that *array can hold at least n ints */
+static void xdr3dfcoord_reserve(int **array, int *nalloc, int n)
+{
+    if (n > *nalloc)
+    {
+        free(*array);
+        *array  = (int *)malloc((size_t)(n * sizeof(**array)));
+        *nalloc = n;
+        if (*array == NULL)
         {
-            fprintf(stderr, "wrong number of coordinates in xdr3dfcoord; "
-                    "%d arg vs %d in file", *size, lsize);
+            fprintf(stderr, "malloc failed\n");
+            exit(1);
         }
-        *size = lsize;
-        size3 = *size * 3;
-        if (*size <= 9)
+    }
+}
+
+/*____________________________________________________________________________
+ |
+ | xdr3dfcoord_read_compressed - read compressed 3d coordinates without
+ | decompressing them.
+ |
+ | This reads exactly the same part of the stream as xdr3dfcoord() does when
+ | reading, but only stores the header values and the compressed bytes in
+ | *data. This separates the (possibly slow) I/O from the decompression done
+ | by xdr3dfcoord_decompress(), so that the two can run on different threads.
+ |
+ */
+
+int xdr3dfcoord_read_compressed(XDR *xdrs, t_xdr3dfcoord_data *data)
+{
+    int nbytes;
+
+    if (xdr_int(xdrs, &data->size) == 0)
+    {
+        return 0;
+    }
+    if (data->size <= 9)
+    {
+        /* Small frames are stored uncompressed as floats;
+         * use the start of buf to store them.
+         */
+        data->precision = -1;
+        xdr3dfcoord_reserve(&data->buf, &data->buf_nalloc, 3*9);
+        return (xdr_vector(xdrs, (char *) data->buf, (unsigned int)(data->size * 3),
+                           (unsigned int)sizeof(float), (xdrproc_t)xdr_float));
+    }
+    if ( (xdr_float(xdrs, &data->precision) == 0) ||
+         (xdr_int(xdrs, &(data->minint[0])) == 0) ||
+         (xdr_int(xdrs, &(data->minint[1])) == 0) ||
+         (xdr_int(xdrs, &(data->minint[2])) == 0) ||
+         (xdr_int(xdrs, &(data->maxint[0])) == 0) ||
+         (xdr_int(xdrs, &(data->maxint[1])) == 0) ||
+         (xdr_int(xdrs, &(data->maxint[2])) == 0) ||
+         (xdr_int(xdrs, &data->smallidx) == 0) ||
+         (xdr_int(xdrs, &nbytes) == 0))
+    {
+        return 0;
+    }
+    if (nbytes < 0)
+    {
+        return 0;
+    }
+    /* buf[0-2] are the bit reading state, followed by the bytes,
+     * plus zeroed padding so that the bit reader in
+     * xdr3dfcoord_decompress() can read ahead by up to 8 bytes.
+     */
+    xdr3dfcoord_reserve(&data->buf, &data->buf_nalloc, 3 + nbytes/XDR_INT_SIZE + 4);
+    data->buf[0] = nbytes;
+    data->buf[1] = 0;
+    data->buf[2] = 0;
+    memset(&data->buf[3 + nbytes/XDR_INT_SIZE], 0, 4*sizeof(*data->buf));
+
+    return xdr_opaque(xdrs, (char *)&(data->buf[3]), (unsigned int)nbytes);
+}
+
+/*____________________________________________________________________________
+ |
+ | xdr3dfcoord_decompress_reference - decompress coordinates read with
+ | xdr3dfcoord_read_compressed() into fp, which should have room for
+ | data->size triplets.
+ |
+ | This is the original decoder, using receivebits() and receiveints().
+ | It is no longer used for reading, but kept as a reference for testing
+ | and benchmarking xdr3dfcoord_decompress().
+ |
+ */
+
+int xdr3dfcoord_decompress_reference(t_xdr3dfcoord_data *data, float *fp)
+{
+    int         *ip, *buf;
+    int          minint[3], maxint[3], *lip;
+    int          smallidx;
+    unsigned     sizeint[3], sizesmall[3], bitsizeint[3];
+    int          flag, k;
+    int          smallnum, smaller, i, is_smaller, run;
+    float       *lfp, precision;
+    int          tmp, *thiscoord,  prevcoord[3];
+    unsigned int bitsize;
+    float        inv_precision;
+    int          lsize;
+
+    lsize = data->size;
+    if (lsize <= 9)
+    {
+        memcpy(fp, data->buf, lsize * 3 * sizeof(*fp));
+        return 1;
+    }
+    xdr3dfcoord_reserve(&data->ip, &data->ip_nalloc, lsize * 3);
+    ip            = data->ip;
+    buf           = data->buf;
+    precision     = data->precision;
+    bitsizeint[0] = bitsizeint[1] = bitsizeint[2] = 0;
+    prevcoord[0]  = prevcoord[1]  = prevcoord[2]  = 0;
+    for (i = 0; i < 3; i++)
+    {
+        minint[i] = data->minint[i];
+        maxint[i] = data->maxint[i];
+    }
+    smallidx = data->smallidx;
+
+    sizeint[0] = maxint[0] - minint[0]+1;
+    sizeint[1] = maxint[1] - minint[1]+1;
+    sizeint[2] = maxint[2] - minint[2]+1;
+
+    /* check if one of the sizes is to big to be multiplied */
+    if ((sizeint[0] | sizeint[1] | sizeint[2] ) > 0xffffff)
+    {
+        bitsizeint[0] = sizeofint(sizeint[0]);
+        bitsizeint[1] = sizeofint(sizeint[1]);
+        bitsizeint[2] = sizeofint(sizeint[2]);
+        bitsize       = 0; /* flag the use of large sizes */
+    }
+    else
+    {
+        bitsize = sizeofints(3, sizeint);
+    }
+
+    smaller      = magicints[MAX(FIRSTIDX, smallidx-1)] / 2;
+    smallnum     = magicints[smallidx] / 2;
+    sizesmall[0] = sizesmall[1] = sizesmall[2] = magicints[smallidx];
+
+    buf[0] = buf[1] = buf[2] = 0;
+
+    lfp           = fp;
+    inv_precision = 1.0 / precision;
+    run           = 0;
+    i             = 0;
+    lip           = ip;
+    while (i < lsize)
+    {
+        thiscoord = (int *)(lip) + i * 3;
+
+        if (bitsize == 0)
         {
-            *precision = -1;
-            return (xdr_vector(xdrs, (char *) fp, (unsigned int)size3,
-                               (unsigned int)sizeof(*fp), (xdrproc_t)xdr_float));
+            thiscoord[0] = receivebits(buf, bitsizeint[0]);
+            thiscoord[1] = receivebits(buf, bitsizeint[1]);
+            thiscoord[2] = receivebits(buf, bitsizeint[2]);
         }
-        if (xdr_float(xdrs, precision) == 0)
+        else
         {
-            return 0;
+            receiveints(buf, 3, bitsize, sizeint, thiscoord);
         }
 
-        if (size3 <= prealloc_size)
+        i++;
+        thiscoord[0] += minint[0];
+        thiscoord[1] += minint[1];
+        thiscoord[2] += minint[2];
+
+        prevcoord[0] = thiscoord[0];
+        prevcoord[1] = thiscoord[1];
+        prevcoord[2] = thiscoord[2];
+
+
+        flag       = receivebits(buf, 1);
+        is_smaller = 0;
+        if (flag == 1)
         {
-            ip  = prealloc_ip;
-            buf = prealloc_buf;
+            run        = receivebits(buf, 5);
+            is_smaller = run % 3;
+            run       -= is_smaller;
+            is_smaller--;
         }
-        else
+        if (run > 0)
         {
-            we_should_free = 1;
-            bufsize        = size3 * 1.2;
-            ip             = (int *)malloc((size_t)(size3 * sizeof(*ip)));
-            buf            = (int *)malloc((size_t)(bufsize * sizeof(*buf)));
-            if (ip == NULL || buf == NULL)
+            thiscoord += 3;
+            for (k = 0; k < run; k += 3)
             {
-                fprintf(stderr, "malloc failed\n");
-                exit(1);
+                receiveints(buf, 3, smallidx, sizesmall, thiscoord);
+                i++;
+                thiscoord[0] += prevcoord[0] - smallnum;
+                thiscoord[1] += prevcoord[1] - smallnum;
+                thiscoord[2] += prevcoord[2] - smallnum;
+                if (k == 0)
+                {
+                    /* interchange first with second atom for better
+                     * compression of water molecules
+                     */
+                    tmp          = thiscoord[0]; thiscoord[0] = prevcoord[0];
+                    prevcoord[0] = tmp;
+                    tmp          = thiscoord[1]; thiscoord[1] = prevcoord[1];
+                    prevcoord[1] = tmp;
+                    tmp          = thiscoord[2]; thiscoord[2] = prevcoord[2];
+                    prevcoord[2] = tmp;
+                    *lfp++       = prevcoord[0] * inv_precision;
+                    *lfp++       = prevcoord[1] * inv_precision;
+                    *lfp++       = prevcoord[2] * inv_precision;
+                }
+                else
+                {
+                    prevcoord[0] = thiscoord[0];
+                    prevcoord[1] = thiscoord[1];
+                    prevcoord[2] = thiscoord[2];
+                }
+                *lfp++ = thiscoord[0] * inv_precision;
+                *lfp++ = thiscoord[1] * inv_precision;
+                *lfp++ = thiscoord[2] * inv_precision;
             }
         }
-
-        buf[0] = buf[1] = buf[2] = 0;
-
-        if ( (xdr_int(xdrs, &(minint[0])) == 0) ||
-             (xdr_int(xdrs, &(minint[1])) == 0) ||
-             (xdr_int(xdrs, &(minint[2])) == 0) ||
-             (xdr_int(xdrs, &(maxint[0])) == 0) ||
-             (xdr_int(xdrs, &(maxint[1])) == 0) ||
-             (xdr_int(xdrs, &(maxint[2])) == 0))
+        else
         {
-            if (we_should_free)
+            *lfp++ = thiscoord[0] * inv_precision;
+            *lfp++ = thiscoord[1] * inv_precision;
+            *lfp++ = thiscoord[2] * inv_precision;
+        }
+        smallidx += is_smaller;
+        if (is_smaller < 0)
+        {
+            smallnum = smaller;
+            if (smallidx > FIRSTIDX)
             {
-                free(ip);
-                free(buf);
+                smaller = magicints[smallidx - 1] /2;
             }
-            return 0;
+            else
+            {
+                smaller = 0;
+            }
+        }
+        else if (is_smaller > 0)
+        {
+            smaller  = smallnum;
+            smallnum = magicints[smallidx] / 2;
         }
+        sizesmall[0] = sizesmall[1] = sizesmall[2] = magicints[smallidx];
+    }
+    return 1;
+}
 
-        sizeint[0] = maxint[0] - minint[0]+1;
-        sizeint[1] = maxint[1] - minint[1]+1;
-        sizeint[2] = maxint[2] - minint[2]+1;
 
-        /* check if one of the sizes is to big to be multiplied */
-        if ((sizeint[0] | sizeint[1] | sizeint[2] ) > 0xffffff)
+/*____________________________________________________________________________
+ |
+ | Fast decoding of compressed coordinates.
+ |
+ | The bit reader below keeps up to 64 bits of the stream in a register and
+ | refills it a byte at a time only when needed, instead of updating the
+ | state in buf[] for each call as receivebits() does. The packed integers
+ | are assembled into a single 64-bit number whenever they fit (which is
+ | always the case for the runs of small integers), and then split with
+ | a multiplication by a tabulated reciprocal and a single correction
+ | step, instead of the byte-by-byte long division in receiveints().
+ | The integer coordinates are first decoded in output order and then
+ | converted to floats in a separate (SIMD) loop.
+ |
+ */
+
+/* Masks for extracting 0-32 bits */
+static const gmx_uint32_t bitmasks[] = {
+    0x00000000U, 0x00000001U, 0x00000003U, 0x00000007U,
+    0x0000000fU, 0x0000001fU, 0x0000003fU, 0x0000007fU,
+    0x000000ffU, 0x000001ffU, 0x000003ffU, 0x000007ffU,
+    0x00000fffU, 0x00001fffU, 0x00003fffU, 0x00007fffU,
+    0x0000ffffU, 0x0001ffffU, 0x0003ffffU, 0x0007ffffU,
+    0x000fffffU, 0x001fffffU, 0x003fffffU, 0x007fffffU,
+    0x00ffffffU, 0x01ffffffU, 0x03ffffffU, 0x07ffffffU,
+    0x0fffffffU, 0x1fffffffU, 0x3fffffffU, 0x7fffffffU,
+    0xffffffffU
+};
+
+typedef struct
+{
+    const unsigned char *ptr;   /* Next byte to load into bits           */
+    gmx_uint64_t         bits;  /* The last loaded bits of the stream    */
+    int                  nbits; /* Number of bits in bits not yet read   */
+} t_bitreader;
+
+/* Reads num_of_bits (at most 32) bits from the stream.
+ * Can read up to 8 bytes beyond the last bit returned.
+ */
+static gmx_inline gmx_uint32_t bitreader_get(t_bitreader *br, int num_of_bits)
+{
+    if (br->nbits < num_of_bits)
+    {
+        do
         {
-            bitsizeint[0] = sizeofint(sizeint[0]);
-            bitsizeint[1] = sizeofint(sizeint[1]);
-            bitsizeint[2] = sizeofint(sizeint[2]);
-            bitsize       = 0; /* flag the use of large sizes */
+            br->bits   = (br->bits << 8) | *br->ptr++;
+            br->nbits += 8;
         }
-        else
+        while (br->nbits <= 56);
+    }
+    br->nbits -= num_of_bits;
+    return (gmx_uint32_t)(br->bits >> br->nbits) & bitmasks[num_of_bits];
+}
+
+/* Returns n/d and stores n%d in *rem, using invd = 1.0/d */
+static gmx_inline gmx_uint64_t divide_uint64(gmx_uint64_t n, gmx_uint32_t d, double invd,
+                                             gmx_uint32_t *rem)
+{
+    gmx_uint64_t q;
+    gmx_int64_t  r;
+
+    if (n < ((gmx_uint64_t)1 << 52))
+    {
+        /* Both n and q are exact in double precision and the relative
+         * error of the product is below 2^-52, so q is off by at most one.
+         */
+        q = (gmx_uint64_t)((double)n * invd);
+        r = (gmx_int64_t)(n - q*d);
+        if (r < 0)
         {
-            bitsize = sizeofints(3, sizeint);
+            q--;
+            r += d;
         }
-
-        if (xdr_int(xdrs, &smallidx) == 0)
+        else if (r >= (gmx_int64_t)d)
         {
-            if (we_should_free)
-            {
-                free(ip);
-                free(buf);
-            }
-            return 0;
+            q++;
+            r -= d;
         }
+    }
+    else
+    {
+        q = n / d;
+        r = (gmx_int64_t)(n - q*d);
+    }
+    *rem = (gmx_uint32_t)r;
+    return q;
+}
 
-        maxidx       = MIN(LASTIDX, smallidx + 8);
-        minidx       = maxidx - 8; /* often this equal smallidx */
-        smaller      = magicints[MAX(FIRSTIDX, smallidx-1)] / 2;
-        smallnum     = magicints[smallidx] / 2;
-        sizesmall[0] = sizesmall[1] = sizesmall[2] = magicints[smallidx];
-        larger       = magicints[maxidx];
+/* Does the same as receiveints() for three integers */
+static gmx_inline void bitreader_get_ints(t_bitreader *br, int num_of_bits,
+                                          const unsigned int sizes[],
+                                          const double invsizes[], int nums[])
+{
+    gmx_uint32_t r;
 
-        /* buf[0] holds the length in bytes */
+    if (num_of_bits <= 64)
+    {
+        gmx_uint64_t n     = 0;
+        int          shift = 0;
 
-        if (xdr_int(xdrs, &(buf[0])) == 0)
+        /* The bytes of the number are stored least significant first */
+        while (num_of_bits > 8)
         {
-            if (we_should_free)
-            {
-                free(ip);
-                free(buf);
-            }
-            return 0;
+            n           |= (gmx_uint64_t)bitreader_get(br, 8) << shift;
+            shift       += 8;
+            num_of_bits -= 8;
         }
+        n      |= (gmx_uint64_t)bitreader_get(br, num_of_bits) << shift;
+        n       = divide_uint64(n, sizes[2], invsizes[2], &r);
+        nums[2] = r;
+        n       = divide_uint64(n, sizes[1], invsizes[1], &r);
+        nums[1] = r;
+        nums[0] = (int)(gmx_uint32_t)n;
+    }
+    else
+    {
+        /* Long division over the bytes, as in receiveints() */
+        int bytes[32];
+        int i, j, num_of_bytes, p, num;
 
-
-        if (xdr_opaque(xdrs, (char *)&(buf[3]), (unsigned int)buf[0]) == 0)
+        bytes[0]     = bytes[1] = bytes[2] = bytes[3] = 0;
+        num_of_bytes = 0;
+        while (num_of_bits > 8)
         {
-            if (we_should_free)
+            bytes[num_of_bytes++] = bitreader_get(br, 8);
+            num_of_bits          -= 8;
+        }
+        bytes[num_of_bytes++] = bitreader_get(br, num_of_bits);
+        for (i = 2; i > 0; i--)
+        {
+            num = 0;
+            for (j = num_of_bytes-1; j >= 0; j--)
             {
-                free(ip);
-                free(buf);
+                num      = (num << 8) | bytes[j];
+                p        = num / sizes[i];
+                bytes[j] = p;
+                num      = num - p * sizes[i];
             }
-            return 0;
+            nums[i] = num;
         }
+        nums[0] = bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | (bytes[3] << 24);
+    }
+}
 
+/* Converts n integer coordinates to floats */
+static void convert_coordinates(const int *ip, int n, float inv_precision, float *fp)
+{
+    int i = 0;
 
+#if (defined GMX_SIMD_HAVE_FLOAT) && (defined GMX_SIMD_HAVE_FINT32) && (defined GMX_SIMD_HAVE_LOADU) && (defined GMX_SIMD_HAVE_STOREU)
+    gmx_simd_float_t inv_precision_S = gmx_simd_set1_f(inv_precision);
 
-        buf[0] = buf[1] = buf[2] = 0;
+    for (; i + GMX_SIMD_FLOAT_WIDTH <= n; i += GMX_SIMD_FLOAT_WIDTH)
+    {
+        gmx_simd_storeu_f(fp + i, gmx_simd_mul_f(gmx_simd_cvt_i2f(gmx_simd_loadu_fi(&ip[i])),
+                                                 inv_precision_S));
+    }
+#endif
+    for (; i < n; i++)
+    {
+        fp[i] = ip[i] * inv_precision;
+    }
+}
 
-        lfp           = fp;
-        inv_precision = 1.0 / *precision;
-        run           = 0;
-        i             = 0;
-        lip           = ip;
-        while (i < lsize)
-        {
-            thiscoord = (int *)(lip) + i * 3;
+/*____________________________________________________________________________
+ |
+ | xdr3dfcoord_decompress - decompress coordinates read with
+ | xdr3dfcoord_read_compressed() into fp, which should have room for
+ | data->size triplets.
+ |
+ | The result is identical to that of xdr3dfcoord_decompress_reference().
+ | Only *data is accessed, so different frames can be decompressed
+ | concurrently.
+ |
+ */
 
-            if (bitsize == 0)
-            {
-                thiscoord[0] = receivebits(buf, bitsizeint[0]);
-                thiscoord[1] = receivebits(buf, bitsizeint[1]);
-                thiscoord[2] = receivebits(buf, bitsizeint[2]);
-            }
-            else
-            {
-                receiveints(buf, 3, bitsize, sizeint, thiscoord);
-            }
+int xdr3dfcoord_decompress(t_xdr3dfcoord_data *data, float *fp)
+{
+    t_bitreader  br;
+    int         *op;
+    int          minint[3];
+    int          smallidx;
+    unsigned int sizeint[3], sizesmall[3], bitsizeint[3];
+    double       invsizeint[3], invsizesmall[3], invmagicints[LASTIDX];
+    int          k, n;
+    int          smallnum, smaller, i, is_smaller, run;
+    int          thiscoord[3], prevcoord[3];
+    unsigned int bitsize;
+    int          lsize;
 
-            i++;
-            thiscoord[0] += minint[0];
-            thiscoord[1] += minint[1];
-            thiscoord[2] += minint[2];
+    lsize = data->size;
+    if (lsize <= 9)
+    {
+        memcpy(fp, data->buf, lsize * 3 * sizeof(*fp));
+        return 1;
+    }
+    xdr3dfcoord_reserve(&data->ip, &data->ip_nalloc, lsize * 3);
+    bitsizeint[0] = bitsizeint[1] = bitsizeint[2] = 0;
 
-            prevcoord[0] = thiscoord[0];
-            prevcoord[1] = thiscoord[1];
-            prevcoord[2] = thiscoord[2];
+    for (i = 0; i < 3; i++)
+    {
+        minint[i]     = data->minint[i];
+        sizeint[i]    = data->maxint[i] - minint[i] + 1;
+        invsizeint[i] = 1.0/sizeint[i];
+    }
+    smallidx = data->smallidx;
+    if (smallidx < FIRSTIDX || smallidx >= (int)LASTIDX)
+    {
+        return 0;
+    }
+    for (i = FIRSTIDX; i < (int)LASTIDX; i++)
+    {
+        invmagicints[i] = 1.0/magicints[i];
+    }
 
+    /* check if one of the sizes is to big to be multiplied */
+    if ((sizeint[0] | sizeint[1] | sizeint[2] ) > 0xffffff)
+    {
+        bitsizeint[0] = sizeofint(sizeint[0]);
+        bitsizeint[1] = sizeofint(sizeint[1]);
+        bitsizeint[2] = sizeofint(sizeint[2]);
+        bitsize       = 0; /* flag the use of large sizes */
+    }
+    else
+    {
+        bitsize = sizeofints(3, sizeint);
+    }
 
-            flag       = receivebits(buf, 1);
-            is_smaller = 0;
-            if (flag == 1)
-            {
-                run        = receivebits(buf, 5);
-                is_smaller = run % 3;
-                run       -= is_smaller;
-                is_smaller--;
-            }
-            if (run > 0)
-            {
-                thiscoord += 3;
-                for (k = 0; k < run; k += 3)
-                {
-                    receiveints(buf, 3, smallidx, sizesmall, thiscoord);
-                    i++;
-                    thiscoord[0] += prevcoord[0] - smallnum;
-                    thiscoord[1] += prevcoord[1] - smallnum;
-                    thiscoord[2] += prevcoord[2] - smallnum;
-                    if (k == 0)
-                    {
-                        /* interchange first with second atom for better
-                         * compression of water molecules
-                         */
-                        tmp          = thiscoord[0]; thiscoord[0] = prevcoord[0];
-                        prevcoord[0] = tmp;
-                        tmp          = thiscoord[1]; thiscoord[1] = prevcoord[1];
-                        prevcoord[1] = tmp;
-                        tmp          = thiscoord[2]; thiscoord[2] = prevcoord[2];
-                        prevcoord[2] = tmp;
-                        *lfp++       = prevcoord[0] * inv_precision;
-                        *lfp++       = prevcoord[1] * inv_precision;
-                        *lfp++       = prevcoord[2] * inv_precision;
-                    }
-                    else
-                    {
-                        prevcoord[0] = thiscoord[0];
-                        prevcoord[1] = thiscoord[1];
-                        prevcoord[2] = thiscoord[2];
-                    }
-                    *lfp++ = thiscoord[0] * inv_precision;
-                    *lfp++ = thiscoord[1] * inv_precision;
-                    *lfp++ = thiscoord[2] * inv_precision;
-                }
-            }
-            else
-            {
-                *lfp++ = thiscoord[0] * inv_precision;
-                *lfp++ = thiscoord[1] * inv_precision;
-                *lfp++ = thiscoord[2] * inv_precision;
-            }
-            smallidx += is_smaller;
-            if (is_smaller < 0)
+    smaller         = magicints[MAX(FIRSTIDX, smallidx-1)] / 2;
+    smallnum        = magicints[smallidx] / 2;
+    sizesmall[0]    = sizesmall[1] = sizesmall[2] = magicints[smallidx];
+    invsizesmall[0] = invsizesmall[1] = invsizesmall[2] = invmagicints[smallidx];
+
+    br.ptr   = (const unsigned char *)&data->buf[3];
+    br.bits  = 0;
+    br.nbits = 0;
+
+    op  = data->ip;
+    run = 0;
+    i   = 0;
+    while (i < lsize)
+    {
+        if (bitsize == 0)
+        {
+            thiscoord[0] = bitreader_get(&br, bitsizeint[0]);
+            thiscoord[1] = bitreader_get(&br, bitsizeint[1]);
+            thiscoord[2] = bitreader_get(&br, bitsizeint[2]);
+        }
+        else
+        {
+            bitreader_get_ints(&br, bitsize, sizeint, invsizeint, thiscoord);
+        }
+        i++;
+        prevcoord[0] = thiscoord[0] + minint[0];
+        prevcoord[1] = thiscoord[1] + minint[1];
+        prevcoord[2] = thiscoord[2] + minint[2];
+
+        is_smaller = 0;
+        if (bitreader_get(&br, 1))
+        {
+            run        = bitreader_get(&br, 5);
+            is_smaller = run % 3;
+            run       -= is_smaller;
+            is_smaller--;
+        }
+        if (i + run/3 > lsize)
+        {
+            /* Corrupted data */
+            return 0;
+        }
+        if (run > 0)
+        {
+            for (k = 0; k < run; k += 3)
             {
-                smallnum = smaller;
-                if (smallidx > FIRSTIDX)
+                bitreader_get_ints(&br, smallidx, sizesmall, invsizesmall, thiscoord);
+                i++;
+                thiscoord[0] += prevcoord[0] - smallnum;
+                thiscoord[1] += prevcoord[1] - smallnum;
+                thiscoord[2] += prevcoord[2] - smallnum;
+                if (k == 0)
                 {
-                    smaller = magicints[smallidx - 1] /2;
+                    /* The first two atoms are interchanged, for better
+                     * compression of water molecules
+                     */
+                    op[0] = thiscoord[0];
+                    op[1] = thiscoord[1];
+                    op[2] = thiscoord[2];
+                    op[3] = prevcoord[0];
+                    op[4] = prevcoord[1];
+                    op[5] = prevcoord[2];
+                    op   += 6;
                 }
                 else
                 {
-                    smaller = 0;
+                    op[0] = thiscoord[0];
+                    op[1] = thiscoord[1];
+                    op[2] = thiscoord[2];
+                    op   += 3;
                 }
+                prevcoord[0] = thiscoord[0];
+                prevcoord[1] = thiscoord[1];
+                prevcoord[2] = thiscoord[2];
             }
-            else if (is_smaller > 0)
+        }
+        else
+        {
+            op[0] = prevcoord[0];
+            op[1] = prevcoord[1];
+            op[2] = prevcoord[2];
+            op   += 3;
+        }
+        smallidx += is_smaller;
+        if (is_smaller < 0)
+        {
+            smallnum = smaller;
+            if (smallidx > FIRSTIDX)
             {
-                smaller  = smallnum;
-                smallnum = magicints[smallidx] / 2;
+                smaller = magicints[smallidx - 1] /2;
+            }
+            else
+            {
+                smaller = 0;
             }
-            sizesmall[0] = sizesmall[1] = sizesmall[2] = magicints[smallidx];
         }
+        else if (is_smaller > 0)
+        {
+            smaller  = smallnum;
+            smallnum = magicints[smallidx] / 2;
+        }
+        if (smallidx < FIRSTIDX || smallidx >= (int)LASTIDX)
+        {
+            return 0;
+        }
+        sizesmall[0]    = sizesmall[1] = sizesmall[2] = magicints[smallidx];
+        invsizesmall[0] = invsizesmall[1] = invsizesmall[2] = invmagicints[smallidx];
     }
-    if (we_should_free)
-    {
-        free(ip);
-        free(buf);
-    }
+
+    n = op - data->ip;
+    convert_coordinates(data->ip, n, 1.0/data->precision, fp);
+
     return 1;
 }
 
 
-
 /******************************************************************
 
    XTC files have a relatively simple structure.
@@ -36,7 +36,11 @@
 
 #include "mdoutf.h"
 
+#include <stdlib.h>
+#include <string.h>
+
 #include "gromacs/domdec/domdec.h"
+#include "gromacs/fileio/outputthread.h"
 #include "gromacs/fileio/tngio.h"
 #include "gromacs/fileio/trajectory_writing.h"
 #include "gromacs/fileio/trnio.h"
@@ -45,12 +49,39 @@
 #include "gromacs/legacyheaders/checkpoint.h"
 #include "gromacs/legacyheaders/copyrite.h"
 #include "gromacs/legacyheaders/mdrun.h"
+#include "gromacs/legacyheaders/network.h"
 #include "gromacs/legacyheaders/types/commrec.h"
 #include "gromacs/math/vec.h"
 #include "gromacs/timing/wallcycle.h"
+#include "gromacs/utility/cstringutil.h"
 #include "gromacs/utility/fatalerror.h"
 #include "gromacs/utility/smalloc.h"
 
+/* Number of frames that can be queued for the output thread */
+#define NOUTPUT_BUF 2
+
+/* The output thread runs alongside the OpenMP threads of the simulation,
+ * so it compresses XTC frames without starting an OpenMP team.
+ */
+#define OUTPUT_THREAD_XTC_NTHREADS 1
+
+/* A copy of the data of one output step, written by the output thread */
+typedef struct
+{
+    int                   mdof_flags;
+    gmx_int64_t           step;
+    double                t;
+    real                  lambda;
+    matrix                box;
+    rvec                 *x;        /* Copy of the global coordinates      */
+    rvec                 *v;        /* Copy of the global velocities       */
+    rvec                 *f;        /* Copy of the global forces           */
+    int                   x_nalloc; /* Allocation size of x                */
+    int                   v_nalloc; /* Allocation size of v                */
+    int                   f_nalloc; /* Allocation size of f                */
+    t_checkpoint_pending *cpt;      /* Checkpoint to finish, can be NULL   */
+} t_output_buf;
+
 struct gmx_mdoutf {
     t_fileio         *fp_trn;
     t_fileio         *fp_xtc;
@@ -60,6 +91,10 @@ struct gmx_mdoutf {
     ener_file_t       fp_ene;
     const char       *fn_cpt;
     gmx_bool          bKeepAndNumCPT;
+    gmx_bool          bShardCPT;          /* Write the state in shards per rank */
+    int              *shard_index;        /* Global atom indices of our shard   */
+    int               shard_index_nalloc; /* Allocation size of shard_index     */
+    int              *shard_natoms;       /* Number of atoms for each shard     */
     int               eIntegrator;
     gmx_bool          bExpanded;
     int               elamstats;
@@ -70,9 +105,243 @@ struct gmx_mdoutf {
     int               natoms_x_compressed;
     gmx_groups_t     *groups; /* for compressed position writing */
     gmx_wallcycle_t   wcycle;
+    /* A thread on the master rank that writes trajectory frames and
+     * completes checkpoints, so the simulation does not wait for the disk.
+     * Can be NULL. I/O errors on the thread are raised on the simulation
+     * thread the next time it waits for the output thread.
+     */
+    t_output_thread  *thread;
+    t_output_buf      outbuf[NOUTPUT_BUF]; /* The buffers for the thread */
 };
 
 
+/* Writes a trajectory frame with the global data x, v and f to the
+ * output files, as selected by mdof_flags. XTC compression uses
+ * at most nthreads_xtc threads, <= 0 means the OpenMP default.
+ * Returns an error message when writing failed, NULL otherwise.
+ */
+static const char *write_frame(gmx_mdoutf_t of, int mdof_flags,
+                        gmx_int64_t step, double t, real lambda, matrix box,
+                        rvec *x, rvec *v, rvec *f, int nthreads_xtc)
+{
+    const char *error = NULL;
+
+    if (mdof_flags & (MDOF_X | MDOF_V | MDOF_F))
+    {
+        if (of->fp_trn)
+        {
+            fwrite_trn(of->fp_trn, step, t, lambda, box, of->natoms_global,
+                       (mdof_flags & MDOF_X) ? x : NULL,
+                       (mdof_flags & MDOF_V) ? v : NULL,
+                       (mdof_flags & MDOF_F) ? f : NULL);
+            if (gmx_fio_flush(of->fp_trn) != 0)
+            {
+                error = "Cannot write trajectory; maybe you are out of disk space?";
+            }
+        }
+
+        if (!gmx_fwrite_tng(of->tng, FALSE, step, t, lambda,
+                            (const rvec *) box,
+                            of->natoms_global,
+                            (mdof_flags & MDOF_X) ? (const rvec *) x : NULL,
+                            (mdof_flags & MDOF_V) ? (const rvec *) v : NULL,
+                            (mdof_flags & MDOF_F) ? (const rvec *) f : NULL))
+        {
+            error = "Cannot write TNG trajectory frame; maybe you are out of disk space?";
+        }
+    }
+    if (mdof_flags & MDOF_X_COMPRESSED)
+    {
+        rvec *xxtc = NULL;
+
+        if (of->natoms_x_compressed == of->natoms_global)
+        {
+            /* We are writing the positions of all of the atoms to
+               the compressed output */
+            xxtc = x;
+        }
+        else
+        {
+            /* We are writing the positions of only a subset of
+               the atoms to the compressed output, so we have to
+               make a copy of the subset of coordinates. */
+            int i, j;
+
+            snew(xxtc, of->natoms_x_compressed);
+            for (i = 0, j = 0; (i < of->natoms_global); i++)
+            {
+                if (ggrpnr(of->groups, egcCompressedX, i) == 0)
+                {
+                    copy_rvec(x[i], xxtc[j++]);
+                }
+            }
+        }
+        if (write_xtc_nthreads(of->fp_xtc, of->natoms_x_compressed, step, t,
+                               box, xxtc, of->x_compression_precision,
+                               nthreads_xtc) == 0)
+        {
+            error = "XTC error - maybe you are out of disk space?";
+        }
+        if (!gmx_fwrite_tng(of->tng_low_prec,
+                            TRUE,
+                            step,
+                            t,
+                            lambda,
+                            (const rvec *) box,
+                            of->natoms_x_compressed,
+                            (const rvec *) xxtc,
+                            NULL,
+                            NULL))
+        {
+            error = "Cannot write TNG trajectory frame; maybe you are out of disk space?";
+        }
+        if (of->natoms_x_compressed != of->natoms_global)
+        {
+            sfree(xxtc);
+        }
+    }
+
+    return error;
+}
+
+/* Returns whether to write output with a separate thread */
+static gmx_bool use_output_thread(void)
+{
+#ifdef GMX_FAHCORE
+    /* Checkpointing is handled differently */
+    return FALSE;
+#else
+    return (getenv("GMX_NO_ASYNC_OUTPUT") == NULL);
+#endif
+}
+
+/* Writes output buffer b of mdoutf of, called on the output thread */
+static int write_output_buf(void *of, int b, char *errmsg)
+{
+    t_output_buf *buf = &((gmx_mdoutf_t)of)->outbuf[b];
+    const char   *error;
+    int           rc = 0;
+
+    if (buf->cpt != NULL)
+    {
+        rc       = write_checkpoint_finish(buf->cpt, errmsg);
+        buf->cpt = NULL;
+    }
+    error = write_frame((gmx_mdoutf_t)of, buf->mdof_flags, buf->step, buf->t,
+                        buf->lambda, buf->box, buf->x, buf->v, buf->f,
+                        OUTPUT_THREAD_XTC_NTHREADS);
+    if (error != NULL && rc == 0)
+    {
+        strcpy(errmsg, error);
+        rc = -1;
+    }
+
+    return rc;
+}
+
+/* Waits until at most npending buffers are queued and raises errors
+ * from the output thread. The time spent waiting is counted as
+ * ewcTRAJWAIT, and is taken out of ewcTRAJ when bInTraj is set.
+ */
+static void mdoutf_output_wait(gmx_mdoutf_t of, int npending, gmx_bool bInTraj)
+{
+    char errmsg[STRLEN];
+    int  rc;
+
+    if (bInTraj)
+    {
+        wallcycle_stop(of->wcycle, ewcTRAJ);
+    }
+    wallcycle_start(of->wcycle, ewcTRAJWAIT);
+    rc = output_thread_wait(of->thread, npending, errmsg);
+    wallcycle_stop(of->wcycle, ewcTRAJWAIT);
+    if (bInTraj)
+    {
+        wallcycle_start_nocount(of->wcycle, ewcTRAJ);
+    }
+
+    if (rc != 0)
+    {
+        gmx_file(errmsg);
+    }
+}
+
+/* Queues a copy of a frame for writing, along with cpt when not NULL.
+ * Waits while all buffers are in use.
+ */
+static void mdoutf_output_queue(gmx_mdoutf_t of, int natoms, int mdof_flags,
+                                gmx_int64_t step, double t, real lambda, matrix box,
+                                const rvec *x, const rvec *v, const rvec *f,
+                                t_checkpoint_pending *cpt)
+{
+    t_output_buf *buf;
+
+    mdoutf_output_wait(of, NOUTPUT_BUF - 1, TRUE);
+
+    /* The buffer is not queued, so the output thread does not access it.
+     * Only the outputs written at some step get a buffer allocated.
+     */
+    buf = &of->outbuf[output_thread_next_buffer(of->thread)];
+    buf->mdof_flags = mdof_flags;
+    buf->step       = step;
+    buf->t          = t;
+    buf->lambda     = lambda;
+    copy_mat(box, buf->box);
+    buf->cpt        = cpt;
+    if (mdof_flags & (MDOF_X | MDOF_X_COMPRESSED))
+    {
+        if (buf->x_nalloc < natoms)
+        {
+            buf->x_nalloc = natoms;
+            srenew(buf->x, buf->x_nalloc);
+        }
+        memcpy(buf->x, x, natoms*sizeof(*x));
+    }
+    if (mdof_flags & MDOF_V)
+    {
+        if (buf->v_nalloc < natoms)
+        {
+            buf->v_nalloc = natoms;
+            srenew(buf->v, buf->v_nalloc);
+        }
+        memcpy(buf->v, v, natoms*sizeof(*v));
+    }
+    if (mdof_flags & MDOF_F)
+    {
+        if (buf->f_nalloc < natoms)
+        {
+            buf->f_nalloc = natoms;
+            srenew(buf->f, buf->f_nalloc);
+        }
+        memcpy(buf->f, f, natoms*sizeof(*f));
+    }
+
+    output_thread_queue(of->thread);
+}
+
+/* Writes all queued data and stops the output thread */
+static void mdoutf_output_done(gmx_mdoutf_t of)
+{
+    char errmsg[STRLEN];
+    int  rc, i;
+
+    wallcycle_start(of->wcycle, ewcTRAJWAIT);
+    rc         = output_thread_done(of->thread, errmsg);
+    of->thread = NULL;
+    wallcycle_stop(of->wcycle, ewcTRAJWAIT);
+    if (rc != 0)
+    {
+        gmx_file(errmsg);
+    }
+
+    for (i = 0; i < NOUTPUT_BUF; i++)
+    {
+        sfree(of->outbuf[i].x);
+        sfree(of->outbuf[i].v);
+        sfree(of->outbuf[i].f);
+    }
+}
+
 gmx_mdoutf_t init_mdoutf(FILE *fplog, int nfile, const t_filenm fnm[],
                          int mdrun_flags, const t_commrec *cr,
                          const t_inputrec *ir, gmx_mtop_t *top_global,
@@ -92,6 +361,7 @@ gmx_mdoutf_t init_mdoutf(FILE *fplog, int nfile, const t_filenm fnm[],
     of->tng_low_prec = NULL;
     of->fp_dhdl      = NULL;
     of->fp_field     = NULL;
+    of->thread       = NULL;
 
     of->eIntegrator             = ir->eI;
     of->bExpanded               = ir->bExpanded;
@@ -100,6 +370,16 @@ gmx_mdoutf_t init_mdoutf(FILE *fplog, int nfile, const t_filenm fnm[],
     of->x_compression_precision = ir->x_compression_precision;
     of->wcycle                  = wcycle;
 
+    /* With domain decomposition, all ranks write their part of the state
+     * in parallel to checkpoint shards, when requested.
+     */
+    of->fn_cpt                  = opt2fn("-cpo", nfile, fnm);
+    of->bShardCPT               = (DOMAINDECOMP(cr) && cr->dd->nnodes > 1 &&
+                                   getenv("GMX_CPT_SHARDED") != NULL);
+    of->shard_index             = NULL;
+    of->shard_index_nalloc      = 0;
+    of->shard_natoms            = NULL;
+
     if (MASTER(cr))
     {
         bAppendFiles = (mdrun_flags & MD_APPENDFILES);
@@ -164,7 +444,6 @@ gmx_mdoutf_t init_mdoutf(FILE *fplog, int nfile, const t_filenm fnm[],
         {
             of->fp_ene = open_enx(ftp2fn(efEDR, nfile, fnm), filemode);
         }
-        of->fn_cpt = opt2fn("-cpo", nfile, fnm);
 
         if ((ir->efep != efepNO || ir->bSimTemp) && ir->fepvals->nstdhdl > 0 &&
             (ir->fepvals->separate_dhdl_file == esepdhdlfileYES ) &&
@@ -210,6 +489,11 @@ gmx_mdoutf_t init_mdoutf(FILE *fplog, int nfile, const t_filenm fnm[],
                 of->natoms_x_compressed++;
             }
         }
+
+        if (use_output_thread())
+        {
+            of->thread = output_thread_init(NOUTPUT_BUF, write_output_buf, of);
+        }
     }
 
     if (bCiteTng)
@@ -240,6 +524,38 @@ gmx_wallcycle_t mdoutf_get_wcycle(gmx_mdoutf_t of)
     return of->wcycle;
 }
 
+/* Writes the home atom part of the distributed state of each rank
+ * to a checkpoint shard and collects the shard sizes on all ranks.
+ */
+static void write_checkpoint_shards(gmx_mdoutf_t of, t_commrec *cr,
+                                    int natoms, gmx_int64_t step,
+                                    t_state *state_local)
+{
+    gmx_domdec_t *dd;
+    int           nat, i;
+
+    dd = cr->dd;
+
+    nat = dd_get_home_atom_indices(dd, state_local,
+                                   &of->shard_index, &of->shard_index_nalloc);
+    write_checkpoint_shard(of->fn_cpt, dd->rank, dd->nnodes, step, natoms,
+                           nat, of->shard_index, state_local);
+
+    if (of->shard_natoms == NULL)
+    {
+        snew(of->shard_natoms, dd->nnodes);
+    }
+    for (i = 0; i < dd->nnodes; i++)
+    {
+        of->shard_natoms[i] = 0;
+    }
+    of->shard_natoms[dd->rank] = nat;
+    /* This also ensures that all shards have been written
+     * before the master writes the checkpoint file listing them.
+     */
+    gmx_sumi(dd->nnodes, of->shard_natoms, cr);
+}
+
 void mdoutf_write_to_trajectory_files(FILE *fplog, t_commrec *cr,
                                       gmx_mdoutf_t of,
                                       int mdof_flags,
@@ -250,6 +566,7 @@ void mdoutf_write_to_trajectory_files(FILE *fplog, t_commrec *cr,
 {
     rvec *local_v;
     rvec *global_v;
+    int   nshard;
 
     /* MRS -- defining these variables is to manage the difference
      * between half step and full step velocities, but there must be a better way . . . */
@@ -257,20 +574,32 @@ void mdoutf_write_to_trajectory_files(FILE *fplog, t_commrec *cr,
     local_v  = state_local->v;
     global_v = state_global->v;
 
+    nshard = 0;
+    if ((mdof_flags & MDOF_CPT) && of->bShardCPT)
+    {
+        nshard = cr->dd->nnodes;
+    }
+
     if (DOMAINDECOMP(cr))
     {
-        if (mdof_flags & MDOF_CPT)
+        if ((mdof_flags & MDOF_CPT) && nshard == 0)
         {
             dd_collect_state(cr->dd, state_local, state_global);
         }
         else
         {
-            if (mdof_flags & (MDOF_X | MDOF_X_COMPRESSED))
+            if (nshard > 0)
+            {
+                write_checkpoint_shards(of, cr, top_global->natoms, step,
+                                        state_local);
+                dd_collect_state_nondistr(cr->dd, state_local, state_global);
+            }
+            if (mdof_flags & (MDOF_X | MDOF_X_COMPRESSED | MDOF_COLLECT_XV))
             {
                 dd_collect_vec(cr->dd, state_local, state_local->x,
                                state_global->x);
             }
-            if (mdof_flags & MDOF_V)
+            if (mdof_flags & (MDOF_V | MDOF_COLLECT_XV))
             {
                 dd_collect_vec(cr->dd, state_local, local_v,
                                global_v);
@@ -301,88 +630,65 @@ void mdoutf_write_to_trajectory_files(FILE *fplog, t_commrec *cr,
 
     if (MASTER(cr))
     {
-        if (mdof_flags & MDOF_CPT)
-        {
-            fflush_tng(of->tng);
-            fflush_tng(of->tng_low_prec);
-            write_checkpoint(of->fn_cpt, of->bKeepAndNumCPT,
-                             fplog, cr, of->eIntegrator, of->simulation_part,
-                             of->bExpanded, of->elamstats, step, t, state_global);
-        }
+        t_checkpoint_pending *cpt = NULL;
 
-        if (mdof_flags & (MDOF_X | MDOF_V | MDOF_F))
-        {
-            if (of->fp_trn)
-            {
-                fwrite_trn(of->fp_trn, step, t, state_local->lambda[efptFEP],
-                           state_local->box, top_global->natoms,
-                           (mdof_flags & MDOF_X) ? state_global->x : NULL,
-                           (mdof_flags & MDOF_V) ? global_v : NULL,
-                           (mdof_flags & MDOF_F) ? f_global : NULL);
-                if (gmx_fio_flush(of->fp_trn) != 0)
-                {
-                    gmx_file("Cannot write trajectory; maybe you are out of disk space?");
-                }
-            }
-
-            gmx_fwrite_tng(of->tng, FALSE, step, t, state_local->lambda[efptFEP],
-                           (const rvec *) state_local->box,
-                           top_global->natoms,
-                           (mdof_flags & MDOF_X) ? (const rvec *) state_global->x : NULL,
-                           (mdof_flags & MDOF_V) ? (const rvec *) global_v : NULL,
-                           (mdof_flags & MDOF_F) ? (const rvec *) f_global : NULL);
-        }
-        if (mdof_flags & MDOF_X_COMPRESSED)
+        if (mdof_flags & MDOF_CPT)
         {
-            rvec *xxtc = NULL;
-
-            if (of->natoms_x_compressed == of->natoms_global)
+            if (of->thread == NULL)
             {
-                /* We are writing the positions of all of the atoms to
-                   the compressed output */
-                xxtc = state_global->x;
+                fflush_tng(of->tng);
+                fflush_tng(of->tng_low_prec);
+                write_checkpoint(of->fn_cpt, of->bKeepAndNumCPT,
+                                 fplog, cr, of->eIntegrator, of->simulation_part,
+                                 of->bExpanded, of->elamstats, step, t, state_global,
+                                 nshard, of->shard_natoms);
             }
             else
             {
-                /* We are writing the positions of only a subset of
-                   the atoms to the compressed output, so we have to
-                   make a copy of the subset of coordinates. */
-                int i, j;
-
-                snew(xxtc, of->natoms_x_compressed);
-                for (i = 0, j = 0; (i < of->natoms_global); i++)
-                {
-                    if (ggrpnr(of->groups, egcCompressedX, i) == 0)
-                    {
-                        copy_rvec(state_global->x[i], xxtc[j++]);
-                    }
-                }
+                /* The checkpoint stores the current sizes of the output
+                 * files, so all earlier frames should be written first.
+                 * The syncing of the files to disk is left to the thread.
+                 */
+                mdoutf_output_wait(of, 0, TRUE);
+                fflush_tng(of->tng);
+                fflush_tng(of->tng_low_prec);
+                cpt = write_checkpoint_start(of->fn_cpt, of->bKeepAndNumCPT,
+                                             fplog, cr, of->eIntegrator, of->simulation_part,
+                                             of->bExpanded, of->elamstats, step, t, state_global,
+                                             nshard, of->shard_natoms);
             }
-            if (write_xtc(of->fp_xtc, of->natoms_x_compressed, step, t,
-                          state_local->box, xxtc, of->x_compression_precision) == 0)
-            {
-                gmx_fatal(FARGS, "XTC error - maybe you are out of disk space?");
-            }
-            gmx_fwrite_tng(of->tng_low_prec,
-                           TRUE,
-                           step,
-                           t,
-                           state_local->lambda[efptFEP],
-                           (const rvec *) state_local->box,
-                           of->natoms_x_compressed,
-                           (const rvec *) xxtc,
-                           NULL,
-                           NULL);
-            if (of->natoms_x_compressed != of->natoms_global)
+        }
+
+        if (of->thread == NULL)
+        {
+            const char *error;
+
+            error = write_frame(of, mdof_flags, step, t, state_local->lambda[efptFEP],
+                                state_local->box, state_global->x, global_v, f_global, 0);
+            if (error != NULL)
             {
-                sfree(xxtc);
+                gmx_file(error);
             }
         }
+        else if (cpt != NULL ||
+                 (mdof_flags & (MDOF_X | MDOF_V | MDOF_F | MDOF_X_COMPRESSED)))
+        {
+            mdoutf_output_queue(of, top_global->natoms, mdof_flags,
+                                step, t, state_local->lambda[efptFEP],
+                                state_local->box,
+                                (const rvec *)state_global->x,
+                                (const rvec *)global_v,
+                                (const rvec *)f_global, cpt);
+        }
     }
 }
 
 void mdoutf_tng_close(gmx_mdoutf_t of)
 {
+    if (of->thread != NULL)
+    {
+        mdoutf_output_wait(of, 0, FALSE);
+    }
     if (of->tng || of->tng_low_prec)
     {
         wallcycle_start(of->wcycle, ewcTRAJ);
@@ -394,6 +700,10 @@ void mdoutf_tng_close(gmx_mdoutf_t of)
 
 void done_mdoutf(gmx_mdoutf_t of)
 {
+    if (of->thread != NULL)
+    {
+        mdoutf_output_done(of);
+    }
     if (of->fp_ene != NULL)
     {
         close_enx(of->fp_ene);
@@ -418,5 +728,7 @@ void done_mdoutf(gmx_mdoutf_t of)
     gmx_tng_close(&of->tng);
     gmx_tng_close(&of->tng_low_prec);
 
+    sfree(of->shard_index);
+    sfree(of->shard_natoms);
     sfree(of);
 }
@@ -97,6 +97,8 @@ void done_mdoutf(gmx_mdoutf_t of);
  * Writes data to trn, xtc and/or checkpoint. What is written is
  * determined by the mdof_flags defined below. Data is collected to
  * the master node only when necessary.
+ * Should be called with the ewcTRAJ cycle counter running; time spent
+ * waiting for the output thread is counted as ewcTRAJWAIT instead.
  */
 void mdoutf_write_to_trajectory_files(FILE *fplog, t_commrec *cr,
                                       gmx_mdoutf_t of,
@@ -112,6 +114,10 @@ void mdoutf_write_to_trajectory_files(FILE *fplog, t_commrec *cr,
 #define MDOF_X_COMPRESSED (1<<3)
 #define MDOF_CPT          (1<<4)
 #define MDOF_IMD          (1<<5)
+/* Only collect x and v on the master, they are always collected with MDOF_CPT
+ * unless the checkpoint is written in shards.
+ */
+#define MDOF_COLLECT_XV   (1<<6)
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,196 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2015, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+#include "gmxpre.h"
+
+#include "outputthread.h"
+
+#include <string.h>
+
+#include "thread_mpi/threads.h"
+
+#include "gromacs/utility/basedefinitions.h"
+#include "gromacs/utility/cstringutil.h"
+#include "gromacs/utility/smalloc.h"
+
+struct t_output_thread
+{
+    tMPI_Thread_t          thread;
+    int                    nbuf;     /* Number of buffers                     */
+    output_thread_write_t  write;    /* Writes one buffer                     */
+    void                  *data;     /* Passed to write                       */
+    int                    nqueued;  /* Number of buffers queued              */
+    int                    nwritten; /* Number of buffers written             */
+    gmx_bool               bStop;    /* Tells the thread to stop              */
+    gmx_bool               bError;   /* Whether an error occurred             */
+    char                   error[STRLEN]; /* The message of the first error   */
+    /* Protects the above counters */
+    tMPI_Thread_mutex_t    mutex;
+    /* Signaled whenever a counter changes */
+    tMPI_Thread_cond_t     cond;
+};
+
+/* Stores the first error that occurred on the output thread */
+static void output_thread_set_error(t_output_thread *ot, const char *error)
+{
+    tMPI_Thread_mutex_lock(&ot->mutex);
+    if (!ot->bError)
+    {
+        ot->bError = TRUE;
+        strncpy(ot->error, error, STRLEN - 1);
+        ot->error[STRLEN - 1] = '\0';
+    }
+    tMPI_Thread_mutex_unlock(&ot->mutex);
+}
+
+static void *output_thread_main(void *arg)
+{
+    t_output_thread *ot = (t_output_thread *)arg;
+    int              buf;
+    char             errmsg[STRLEN];
+
+    tMPI_Thread_mutex_lock(&ot->mutex);
+    while (TRUE)
+    {
+        if (ot->nwritten == ot->nqueued)
+        {
+            if (ot->bStop)
+            {
+                break;
+            }
+            tMPI_Thread_cond_wait(&ot->cond, &ot->mutex);
+            continue;
+        }
+        /* The buffer is queued, so only this thread accesses it */
+        buf = ot->nwritten % ot->nbuf;
+        tMPI_Thread_mutex_unlock(&ot->mutex);
+        if (ot->write(ot->data, buf, errmsg) != 0)
+        {
+            output_thread_set_error(ot, errmsg);
+        }
+        tMPI_Thread_mutex_lock(&ot->mutex);
+        ot->nwritten++;
+        tMPI_Thread_cond_broadcast(&ot->cond);
+    }
+    tMPI_Thread_mutex_unlock(&ot->mutex);
+
+    return NULL;
+}
+
+t_output_thread *output_thread_init(int nbuf, output_thread_write_t write,
+                                    void *data)
+{
+    t_output_thread *ot;
+
+    if (tMPI_Thread_support() != TMPI_THREAD_SUPPORT_YES)
+    {
+        return NULL;
+    }
+
+    snew(ot, 1);
+    ot->nbuf  = nbuf;
+    ot->write = write;
+    ot->data  = data;
+    tMPI_Thread_mutex_init(&ot->mutex);
+    tMPI_Thread_cond_init(&ot->cond);
+    if (tMPI_Thread_create(&ot->thread, output_thread_main, ot) != 0)
+    {
+        tMPI_Thread_cond_destroy(&ot->cond);
+        tMPI_Thread_mutex_destroy(&ot->mutex);
+        sfree(ot);
+        ot = NULL;
+    }
+
+    return ot;
+}
+
+/* Returns the error state, copies the message to errmsg on error */
+static int output_thread_get_error(t_output_thread *ot, char *errmsg)
+{
+    int rc = 0;
+
+    tMPI_Thread_mutex_lock(&ot->mutex);
+    if (ot->bError)
+    {
+        strcpy(errmsg, ot->error);
+        rc = -1;
+    }
+    tMPI_Thread_mutex_unlock(&ot->mutex);
+
+    return rc;
+}
+
+int output_thread_wait(t_output_thread *ot, int npending, char *errmsg)
+{
+    tMPI_Thread_mutex_lock(&ot->mutex);
+    while (ot->nqueued - ot->nwritten > npending)
+    {
+        tMPI_Thread_cond_wait(&ot->cond, &ot->mutex);
+    }
+    tMPI_Thread_mutex_unlock(&ot->mutex);
+
+    return output_thread_get_error(ot, errmsg);
+}
+
+int output_thread_next_buffer(const t_output_thread *ot)
+{
+    /* nqueued is only changed by the calling thread */
+    return ot->nqueued % ot->nbuf;
+}
+
+void output_thread_queue(t_output_thread *ot)
+{
+    tMPI_Thread_mutex_lock(&ot->mutex);
+    ot->nqueued++;
+    tMPI_Thread_cond_broadcast(&ot->cond);
+    tMPI_Thread_mutex_unlock(&ot->mutex);
+}
+
+int output_thread_done(t_output_thread *ot, char *errmsg)
+{
+    int rc;
+
+    tMPI_Thread_mutex_lock(&ot->mutex);
+    ot->bStop = TRUE;
+    tMPI_Thread_cond_broadcast(&ot->cond);
+    tMPI_Thread_mutex_unlock(&ot->mutex);
+    tMPI_Thread_join(ot->thread, NULL);
+    rc = output_thread_get_error(ot, errmsg);
+
+    tMPI_Thread_cond_destroy(&ot->cond);
+    tMPI_Thread_mutex_destroy(&ot->mutex);
+    sfree(ot);
+
+    return rc;
+}
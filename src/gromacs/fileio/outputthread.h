@@ -0,0 +1,88 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2015, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+#ifndef GMX_FILEIO_OUTPUTTHREAD_H
+#define GMX_FILEIO_OUTPUTTHREAD_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* A thread that writes output in the background.
+ *
+ * The caller owns nbuf output buffers, which are used in a ring.
+ * A buffer is filled by the caller, queued, and then written on
+ * the output thread by a write function supplied by the caller.
+ * Errors are not raised on the output thread: the message of the first
+ * error is stored and returned when the caller waits for the thread.
+ */
+typedef struct t_output_thread t_output_thread;
+
+typedef int (*output_thread_write_t)(void *data, int buf, char *errmsg);
+/* Writes buffer buf of data. Called on the output thread, so should not
+ * generate fatal errors. Returns 0 on success. On failure, an error
+ * message should be stored in errmsg, which has room for STRLEN characters.
+ */
+
+t_output_thread *output_thread_init(int nbuf, output_thread_write_t write,
+                                    void *data);
+/* Starts an output thread writing nbuf buffers of data with write.
+ * Returns NULL when threads are not supported or could not be started.
+ */
+
+int output_thread_wait(t_output_thread *ot, int npending, char *errmsg);
+/* Waits until at most npending buffers are queued. Returns 0 when
+ * no error has occurred on the output thread, otherwise the message
+ * of the first error is stored in errmsg, with room for STRLEN characters.
+ * Returns -1 on all calls after the first error.
+ */
+
+int output_thread_next_buffer(const t_output_thread *ot);
+/* Returns the index of the next buffer to fill and queue.
+ * The buffer is free after output_thread_wait() with npending < nbuf.
+ */
+
+void output_thread_queue(t_output_thread *ot);
+/* Queues the buffer returned by output_thread_next_buffer() for writing */
+
+int output_thread_done(t_output_thread *ot, char *errmsg);
+/* Writes all queued buffers, stops the thread and frees ot.
+ * Returns 0 or -1 with an error message as output_thread_wait().
+ */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
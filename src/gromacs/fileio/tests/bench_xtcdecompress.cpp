@@ -0,0 +1,159 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2014, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+/*! \internal \file
+ * \brief Benchmark for decompression of XTC coordinates.
+ *
+ * Reads all frames of an XTC file into memory in compressed form and
+ * times decompressing them with xdr3dfcoord_decompress() and with the
+ * reference decoder, reporting the throughput per core.
+ *
+ * Usage: bench_xtcdecompress file.xtc [repeats]
+ *
+ * \ingroup module_fileio
+ */
+#include "gmxpre.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <vector>
+
+#include "gromacs/fileio/xdrf.h"
+#include "gromacs/fileio/xtcio.h"
+#include "gromacs/timing/walltime_accounting.h"
+#include "gromacs/utility/smalloc.h"
+
+namespace
+{
+
+typedef int (*DecompressFunction)(t_xdr3dfcoord_data *, float *);
+
+/*! \brief
+ * Decompresses all frames \p repeats times with \p decompress and prints
+ * the throughput.
+ */
+double runBenchmark(const char *name, DecompressFunction decompress,
+                    std::vector<t_xdr3dfcoord_data> *frames,
+                    const std::vector<int> &buf0, int repeats,
+                    double nbytes, int natoms)
+{
+    std::vector<float> x(3*natoms);
+    double             start = gmx_gettime();
+    for (int r = 0; r < repeats; ++r)
+    {
+        for (size_t f = 0; f < frames->size(); ++f)
+        {
+            t_xdr3dfcoord_data *data = &(*frames)[f];
+            // The reference decoder overwrites the byte count in buf[0]
+            data->buf[0] = buf0[f];
+            if (decompress(data, &x[0]) == 0)
+            {
+                fprintf(stderr, "Decompression failed for frame %d\n",
+                        static_cast<int>(f));
+                std::exit(1);
+            }
+        }
+    }
+    double elapsed = gmx_gettime() - start;
+    double nframes = static_cast<double>(repeats)*frames->size();
+    printf("%-10s %8.3f s %10.1f MB/s compressed %10.1f Matoms/s\n",
+           name, elapsed, repeats*nbytes/elapsed*1e-6,
+           nframes*natoms/elapsed*1e-6);
+    return elapsed;
+}
+
+}   // namespace
+
+/*! \internal \brief
+ * The main function for the XTC decompression benchmark.
+ */
+int
+main(int argc, char *argv[])
+{
+    if (argc < 2)
+    {
+        fprintf(stderr, "Usage: %s file.xtc [repeats]\n", argv[0]);
+        return 1;
+    }
+    int repeats = (argc > 2 ? std::atoi(argv[2]) : 10);
+
+    t_fileio *fio = open_xtc(argv[1], "r");
+    int       natoms, step;
+    real      time, prec;
+    matrix    box;
+    rvec     *x;
+    gmx_bool  bOK;
+    if (!read_first_xtc(fio, &natoms, &step, &time, box, &x, &prec, &bOK))
+    {
+        fprintf(stderr, "Could not read a frame from %s\n", argv[1]);
+        return 1;
+    }
+    sfree(x);
+    close_xtc(fio);
+
+    std::vector<t_xdr3dfcoord_data> frames;
+    std::vector<int>                 buf0;
+    double                           nbytes = 0;
+    fio = open_xtc(argv[1], "r");
+    while (true)
+    {
+        t_xdr3dfcoord_data data;
+        xdr3dfcoord_data_init(&data);
+        if (!read_next_xtc_compressed(fio, natoms, &step, &time, box, &data, &bOK))
+        {
+            xdr3dfcoord_data_done(&data);
+            break;
+        }
+        buf0.push_back(data.size > 9 ? data.buf[0] : 0);
+        nbytes += buf0.back();
+        frames.push_back(data);
+    }
+    close_xtc(fio);
+    printf("Read %d frames with %d atoms, %.1f MB compressed\n",
+           static_cast<int>(frames.size()), natoms, nbytes*1e-6);
+
+    double tref  = runBenchmark("reference", xdr3dfcoord_decompress_reference,
+                                &frames, buf0, repeats, nbytes, natoms);
+    double tfast = runBenchmark("fast", xdr3dfcoord_decompress,
+                                &frames, buf0, repeats, nbytes, natoms);
+    printf("Speedup %.2f\n", tref/tfast);
+
+    for (size_t f = 0; f < frames.size(); ++f)
+    {
+        xdr3dfcoord_data_done(&frames[f]);
+    }
+    return 0;
+}
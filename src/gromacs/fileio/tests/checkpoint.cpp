@@ -0,0 +1,222 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2015, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+/*! \internal \file
+ * \brief
+ * Tests for writing and reading sharded checkpoints.
+ *
+ * \ingroup module_fileio
+ */
+#include "gmxpre.h"
+
+#include "gromacs/legacyheaders/checkpoint.h"
+
+#include <cstring>
+
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "gromacs/legacyheaders/typedefs.h"
+#include "gromacs/legacyheaders/types/commrec.h"
+#include "gromacs/math/vec.h"
+#include "gromacs/utility/futil.h"
+#include "gromacs/utility/smalloc.h"
+
+#include "testutils/testfilemanager.h"
+
+namespace
+{
+
+//! Number of atoms in the test state
+const int c_natoms = 23;
+//! Number of checkpoint shards
+const int c_nshard = 3;
+
+/*! \brief Test fixture for sharded checkpoints
+ *
+ * The atoms are distributed over the shards in an order that differs
+ * from the global order, as with domain decomposition.
+ */
+class ShardedCheckpointTest : public ::testing::Test
+{
+    public:
+        ShardedCheckpointTest()
+        {
+            snew(cr_, 1);
+            std::memset(&state_, 0, sizeof(state_));
+            init_state(&state_, c_natoms, 0, 0, 0, 0);
+            state_.flags = (1<<estX) | (1<<estV) | (1<<estBOX);
+            for (int d = 0; d < DIM; d++)
+            {
+                state_.box[d][d] = 2.5 + d;
+            }
+            for (int a = 0; a < c_natoms; a++)
+            {
+                for (int d = 0; d < DIM; d++)
+                {
+                    state_.x[a][d] = a + 0.1*d;
+                    state_.v[a][d] = -a - 0.01*d;
+                }
+            }
+            /* Atom a goes to shard (a*7) % c_nshard, in decreasing order */
+            shardIndex_.resize(c_nshard);
+            for (int a = c_natoms - 1; a >= 0; a--)
+            {
+                shardIndex_[(a*7) % c_nshard].push_back(a);
+            }
+            cptFile_ = fileManager_.getTemporaryFilePath("state.cpt");
+            fileManager_.getTemporaryFilePath("state_prev.cpt");
+        }
+
+        ~ShardedCheckpointTest()
+        {
+            done_state(&state_);
+            sfree(cr_);
+        }
+
+        //! Returns the path of shard \p shard of the checkpoint at \p step
+        std::string shardPath(gmx_int64_t step, int shard)
+        {
+            char buf[STRLEN];
+
+            sprintf(buf, "state_step%d_shard%d.cpt", static_cast<int>(step), shard);
+            return fileManager_.getTemporaryFilePath(buf);
+        }
+
+        //! Writes the shards and the checkpoint listing them for \p step
+        void writeShardedCheckpoint(gmx_int64_t step)
+        {
+            int shardNatoms[c_nshard];
+
+            for (int s = 0; s < c_nshard; s++)
+            {
+                t_state           local;
+                std::vector<int> &index = shardIndex_[s];
+
+                /* Register the shard file for clean-up */
+                shardPath(step, s);
+
+                std::memset(&local, 0, sizeof(local));
+                init_state(&local, index.size(), 0, 0, 0, 0);
+                local.flags = state_.flags;
+                for (size_t i = 0; i < index.size(); i++)
+                {
+                    copy_rvec(state_.x[index[i]], local.x[i]);
+                    copy_rvec(state_.v[index[i]], local.v[i]);
+                }
+                write_checkpoint_shard(cptFile_.c_str(), s, c_nshard, step, c_natoms,
+                                       index.size(), &index[0], &local);
+                done_state(&local);
+
+                shardNatoms[s] = index.size();
+            }
+            write_checkpoint(cptFile_.c_str(), FALSE, NULL, cr_, eiMD, 1,
+                             FALSE, elamstatsNO, step, 0.002*step, &state_,
+                             c_nshard, shardNatoms);
+        }
+
+        //! Reads checkpoint \p fn and checks that it matches the state at \p step
+        void checkCheckpoint(const std::string &fn, gmx_int64_t step)
+        {
+            t_state     stateRead;
+            int         simulationPart;
+            gmx_int64_t stepRead;
+            double      t;
+
+            std::memset(&stateRead, 0, sizeof(stateRead));
+            init_state(&stateRead, 0, 0, 0, 0, 0);
+            read_checkpoint_state(fn.c_str(), &simulationPart, &stepRead, &t,
+                                  &stateRead);
+
+            EXPECT_EQ(step, stepRead);
+            ASSERT_EQ(c_natoms, stateRead.natoms);
+            EXPECT_EQ(state_.flags, stateRead.flags);
+            for (int d = 0; d < DIM; d++)
+            {
+                for (int d2 = 0; d2 < DIM; d2++)
+                {
+                    EXPECT_EQ(state_.box[d][d2], stateRead.box[d][d2]);
+                }
+            }
+            for (int a = 0; a < c_natoms; a++)
+            {
+                for (int d = 0; d < DIM; d++)
+                {
+                    EXPECT_EQ(state_.x[a][d], stateRead.x[a][d]) << "atom " << a;
+                    EXPECT_EQ(state_.v[a][d], stateRead.v[a][d]) << "atom " << a;
+                }
+            }
+            done_state(&stateRead);
+        }
+
+        gmx::test::TestFileManager      fileManager_;
+        t_commrec                      *cr_;
+        t_state                         state_;
+        std::vector<std::vector<int> >  shardIndex_;
+        std::string                     cptFile_;
+};
+
+TEST_F(ShardedCheckpointTest, RoundTripsState)
+{
+    writeShardedCheckpoint(10);
+    for (int s = 0; s < c_nshard; s++)
+    {
+        EXPECT_TRUE(gmx_fexist(shardPath(10, s).c_str()));
+    }
+    checkCheckpoint(cptFile_, 10);
+}
+
+TEST_F(ShardedCheckpointTest, RemovesShardsOfReplacedBackup)
+{
+    writeShardedCheckpoint(10);
+    writeShardedCheckpoint(20);
+    /* The backup of step 10 is only replaced now */
+    for (int s = 0; s < c_nshard; s++)
+    {
+        EXPECT_TRUE(gmx_fexist(shardPath(10, s).c_str()));
+    }
+    writeShardedCheckpoint(30);
+    for (int s = 0; s < c_nshard; s++)
+    {
+        EXPECT_FALSE(gmx_fexist(shardPath(10, s).c_str()));
+        EXPECT_TRUE(gmx_fexist(shardPath(20, s).c_str()));
+        EXPECT_TRUE(gmx_fexist(shardPath(30, s).c_str()));
+    }
+    checkCheckpoint(cptFile_, 30);
+    checkCheckpoint(fileManager_.getTemporaryFilePath("state_prev.cpt"), 20);
+}
+
+} // namespace
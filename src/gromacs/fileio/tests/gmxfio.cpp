@@ -0,0 +1,203 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2015, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+/*! \internal \file
+ * \brief
+ * Tests for the md5 sums of output files stored in checkpoints.
+ *
+ * \ingroup module_fileio
+ */
+#include "gmxpre.h"
+
+#include "gromacs/fileio/gmxfio.h"
+
+#include <cstdio>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "gromacs/fileio/md5.h"
+#include "gromacs/fileio/xdrf.h"
+#include "gromacs/utility/futil.h"
+
+#include "testutils/testfilemanager.h"
+
+namespace
+{
+
+//! Length of the file tail used for the md5 sums, as CPT_CHK_LEN in gmxfio.c
+const gmx_off_t c_checksumLength = 1048576;
+
+/*! \brief Test fixture for the md5 sums of output file tails
+ *
+ * gmx_fio keeps a copy of the tail of output files, which is updated
+ * while writing. The md5 sums computed from the copy are compared
+ * against md5 sums computed from reading the file.
+ */
+class FileMd5Test : public ::testing::Test
+{
+    public:
+        FileMd5Test() : fio_(NULL), counter_(0)
+        {
+            fileName_ = fileManager_.getTemporaryFilePath("tail.trr");
+            fio_      = gmx_fio_open(fileName_.c_str(), "w+");
+        }
+
+        ~FileMd5Test()
+        {
+            if (fio_ != NULL)
+            {
+                gmx_fio_close(fio_);
+            }
+        }
+
+        //! Writes \p n integers through XDR
+        void writeXdrInts(int n)
+        {
+            for (int i = 0; i < n; i++)
+            {
+                int value = counter_++;
+                ASSERT_TRUE(xdr_int(gmx_fio_getxdr(fio_), &value));
+            }
+        }
+
+        //! Writes \p n bytes through XDR, in chunks with a length that is not a multiple of 4
+        void writeXdrBytes(int n)
+        {
+            std::vector<char> buf(4099);
+
+            while (n > 0)
+            {
+                int len = std::min(n, static_cast<int>(buf.size()));
+                for (int i = 0; i < len; i++)
+                {
+                    buf[i] = static_cast<char>(counter_++);
+                }
+                ASSERT_TRUE(xdr_opaque(gmx_fio_getxdr(fio_), &buf[0], len));
+                n -= len;
+            }
+        }
+
+        //! Writes \p n lines directly to the file pointer, bypassing XDR
+        void writeLines(int n)
+        {
+            for (int i = 0; i < n; i++)
+            {
+                fprintf(gmx_fio_getfp(fio_), "line %d\n", counter_++);
+            }
+        }
+
+        //! Checks the md5 sum of the tail against the md5 sum of the file contents
+        void checkMd5()
+        {
+            unsigned char digest[16], digestRef[16];
+            md5_state_t   state;
+            gmx_off_t     offset, length;
+            FILE         *fp;
+
+            ASSERT_EQ(0, gmx_fio_flush(fio_));
+            offset = gmx_fio_ftell(fio_);
+            length = std::min(offset, c_checksumLength);
+
+            EXPECT_EQ(length, gmx_fio_get_file_md5(fio_, offset, digest));
+
+            std::vector<unsigned char> contents(length);
+            fp = std::fopen(fileName_.c_str(), "rb");
+            ASSERT_TRUE(fp != NULL);
+            ASSERT_EQ(0, gmx_fseek(fp, offset - length, SEEK_SET));
+            ASSERT_EQ(static_cast<size_t>(length),
+                      std::fread(&contents[0], 1, length, fp));
+            std::fclose(fp);
+            gmx_md5_init(&state);
+            gmx_md5_append(&state, &contents[0], length);
+            gmx_md5_finish(&state, digestRef);
+
+            for (int i = 0; i < 16; i++)
+            {
+                EXPECT_EQ(digestRef[i], digest[i]) << "at offset " << offset;
+            }
+        }
+
+        gmx::test::TestFileManager fileManager_;
+        std::string                fileName_;
+        t_fileio                  *fio_;
+        int                        counter_;
+};
+
+TEST_F(FileMd5Test, MatchesFileForShortFile)
+{
+    writeXdrInts(1000);
+    writeXdrBytes(10001);
+    checkMd5();
+    writeXdrInts(10);
+    checkMd5();
+}
+
+TEST_F(FileMd5Test, MatchesFileAfterWrappingTail)
+{
+    writeXdrBytes(1000003);
+    checkMd5();
+    /* The tail now wraps around the end of the copy */
+    writeXdrBytes(600001);
+    writeXdrInts(1001);
+    checkMd5();
+    writeXdrBytes(2*c_checksumLength + 17);
+    checkMd5();
+}
+
+TEST_F(FileMd5Test, MatchesFileWithWritesBypassingXdr)
+{
+    writeXdrBytes(500001);
+    checkMd5();
+    writeLines(1000);
+    checkMd5();
+    writeXdrInts(100);
+    writeLines(100000);
+    writeXdrBytes(300001);
+    checkMd5();
+}
+
+TEST_F(FileMd5Test, MatchesFileAfterRewind)
+{
+    writeXdrBytes(700001);
+    checkMd5();
+    ASSERT_EQ(0, gmx_fio_seek(fio_, 1000));
+    writeXdrBytes(500001);
+    checkMd5();
+}
+
+} // namespace
@@ -0,0 +1,216 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2015, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+/*! \internal \file
+ * \brief
+ * Tests for the output thread used for asynchronous trajectory writing.
+ *
+ * \ingroup module_fileio
+ */
+#include "gmxpre.h"
+
+#include "gromacs/fileio/outputthread.h"
+
+#include <stdio.h>
+
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "gromacs/utility/cstringutil.h"
+
+namespace
+{
+
+//! Number of output buffers
+const int c_numBuffers = 2;
+//! Number of buffers to queue in each test
+const int c_numQueued  = 10;
+
+/*! \brief Output data with the buffers and the record of the writes
+ *
+ * The written values are only accessed by the output thread,
+ * until the test waited for all queued buffers.
+ */
+struct OutputData
+{
+    OutputData() : failValue0(-1), failValue1(-1) {}
+
+    int              value[c_numBuffers];
+    std::vector<int> written;
+    int              failValue0;
+    int              failValue1;
+};
+
+//! Records the value in buffer \p buf, fails for the fail values
+int writeBuffer(void *data, int buf, char *errmsg)
+{
+    OutputData *od    = static_cast<OutputData *>(data);
+    int         value = od->value[buf];
+
+    od->written.push_back(value);
+    if (value == od->failValue0 || value == od->failValue1)
+    {
+        sprintf(errmsg, "Cannot write value %d", value);
+        return -1;
+    }
+
+    return 0;
+}
+
+/*! \brief Test fixture that starts an output thread
+ *
+ * When threads are not supported, the tests do nothing.
+ */
+class OutputThreadTest : public ::testing::Test
+{
+    public:
+        OutputThreadTest() : ot_(NULL)
+        {
+        }
+
+        void SetUp()
+        {
+            ot_ = output_thread_init(c_numBuffers, writeBuffer, &data_);
+        }
+
+        void TearDown()
+        {
+            if (ot_ != NULL)
+            {
+                char errmsg[STRLEN];
+
+                output_thread_done(ot_, errmsg);
+            }
+        }
+
+        //! Fills and queues buffers with values 0 to \p n-1, returns the last wait code
+        int queueValues(int n)
+        {
+            int  rc = 0;
+            char errmsg[STRLEN];
+
+            for (int i = 0; i < n; i++)
+            {
+                int rcWait = output_thread_wait(ot_, c_numBuffers - 1, errmsg);
+                if (rcWait != 0)
+                {
+                    rc = rcWait;
+                }
+                data_.value[output_thread_next_buffer(ot_)] = i;
+                output_thread_queue(ot_);
+            }
+
+            return rc;
+        }
+
+        //! Checks that the values 0 to \p n-1 have been written in order
+        void checkWritten(int n)
+        {
+            ASSERT_EQ(n, static_cast<int>(data_.written.size()));
+            for (int i = 0; i < n; i++)
+            {
+                EXPECT_EQ(i, data_.written[i]);
+            }
+        }
+
+        t_output_thread *ot_;
+        OutputData       data_;
+};
+
+TEST_F(OutputThreadTest, WritesQueuedBuffersInOrder)
+{
+    char errmsg[STRLEN];
+
+    if (ot_ == NULL)
+    {
+        return;
+    }
+    EXPECT_EQ(0, queueValues(c_numQueued));
+    /* Flush the queue */
+    EXPECT_EQ(0, output_thread_wait(ot_, 0, errmsg));
+    checkWritten(c_numQueued);
+}
+
+TEST_F(OutputThreadTest, DoneWritesAllQueuedBuffers)
+{
+    char errmsg[STRLEN];
+
+    if (ot_ == NULL)
+    {
+        return;
+    }
+    EXPECT_EQ(0, queueValues(c_numBuffers));
+    EXPECT_EQ(0, output_thread_done(ot_, errmsg));
+    ot_ = NULL;
+    checkWritten(c_numBuffers);
+}
+
+TEST_F(OutputThreadTest, ReturnsFirstErrorAndContinuesWriting)
+{
+    char errmsg[STRLEN];
+
+    if (ot_ == NULL)
+    {
+        return;
+    }
+    data_.failValue0 = 3;
+    data_.failValue1 = 5;
+    queueValues(c_numQueued);
+    /* The error is returned on all waits after it occurred */
+    EXPECT_EQ(-1, output_thread_wait(ot_, 0, errmsg));
+    EXPECT_EQ("Cannot write value 3", std::string(errmsg));
+    checkWritten(c_numQueued);
+    EXPECT_EQ(-1, output_thread_wait(ot_, 0, errmsg));
+    EXPECT_EQ("Cannot write value 3", std::string(errmsg));
+}
+
+TEST_F(OutputThreadTest, DoneReturnsError)
+{
+    char errmsg[STRLEN];
+
+    if (ot_ == NULL)
+    {
+        return;
+    }
+    data_.failValue0 = c_numBuffers - 1;
+    queueValues(c_numBuffers);
+    EXPECT_EQ(-1, output_thread_done(ot_, errmsg));
+    ot_ = NULL;
+    EXPECT_EQ("Cannot write value 1", std::string(errmsg));
+    checkWritten(c_numBuffers);
+}
+
+} // namespace
@@ -0,0 +1,372 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2013,2014, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+/*! \internal \file
+ * \brief
+ * Tests for XTC file I/O routines
+ *
+ * \ingroup module_fileio
+ */
+#include "gmxpre.h"
+
+#include "gromacs/fileio/xtcio.h"
+
+#include "config.h"
+
+#include <cstdio>
+#include <cstring>
+
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "gromacs/fileio/trx.h"
+#include "gromacs/fileio/trxindex.h"
+#include "gromacs/fileio/trxio.h"
+#include "gromacs/fileio/xdrf.h"
+#include "gromacs/fileio/xtcreadahead.h"
+#include "gromacs/legacyheaders/oenv.h"
+#include "gromacs/utility/gmxomp.h"
+#include "gromacs/utility/smalloc.h"
+
+#include "testutils/testfilemanager.h"
+
+namespace
+{
+
+//! Number of atoms in the test trajectory.
+const int c_natoms  = 100;
+//! Number of frames in the test trajectory.
+const int c_nframes = 20;
+
+class XtcTest : public ::testing::Test
+{
+    public:
+        XtcTest()
+            : fileName_(fileManager_.getTemporaryFilePath(".xtc"))
+        {
+        }
+
+        //! Writes a trajectory with some atoms moving between frames.
+        void writeTrajectory()
+        {
+            rvec     x[c_natoms];
+            matrix   box = {{3, 0, 0}, {0, 3, 0}, {0, 0, 3}};
+            t_fileio *fio = open_xtc(fileName_.c_str(), "w");
+            for (int frame = 0; frame < c_nframes; ++frame)
+            {
+                for (int i = 0; i < c_natoms; ++i)
+                {
+                    x[i][XX] = 0.01*i + 0.1*frame;
+                    x[i][YY] = 0.02*((i*7 + frame) % 13);
+                    x[i][ZZ] = 1.5 - 0.001*i*frame;
+                }
+                ASSERT_TRUE(write_xtc(fio, c_natoms, frame, 0.5*frame, box,
+                                      x, 1000) != 0);
+            }
+            close_xtc(fio);
+        }
+
+        /*! \brief
+         * Writes frames with small runs (water-like triplets), with
+         * uncorrelated coordinates, and with a range too large for packing
+         * three integers.  At most \p nthreads threads are used for the
+         * compression, 0 uses the OpenMP default.
+         *
+         * Returns the number of frames.
+         */
+        int writeVariedTrajectory(const std::string &fileName, int natoms,
+                                  int nthreads = 0)
+        {
+            const float    scale[]     = { 3.0f, 30.0f, 30000.0f };
+            const float    precision[] = { 1000.0f, 100.0f, 1000.0f };
+            const int      nframes     = sizeof(scale)/sizeof(scale[0]);
+            matrix         box         = {{3, 0, 0}, {0, 3, 0}, {0, 0, 3}};
+            rvec          *x;
+            snew(x, natoms);
+            t_fileio      *fio  = open_xtc(fileName.c_str(), "w");
+            unsigned int   seed = 12345;
+            for (int frame = 0; frame < nframes; ++frame)
+            {
+                for (int i = 0; i < natoms; ++i)
+                {
+                    for (int d = 0; d < DIM; ++d)
+                    {
+                        seed = seed*1103515245 + 12345;
+                        float r = (seed >> 8)/16777216.0f;
+                        if (frame == 0 && i % 3 != 0)
+                        {
+                            x[i][d] = x[i - i % 3][d] + 0.1f*(r - 0.5f);
+                        }
+                        else
+                        {
+                            x[i][d] = scale[frame]*(r - 0.5f);
+                        }
+                    }
+                }
+                EXPECT_TRUE(write_xtc_nthreads(fio, natoms, frame, frame, box, x,
+                                               precision[frame], nthreads) != 0);
+            }
+            close_xtc(fio);
+            sfree(x);
+            return nframes;
+        }
+
+        //! Reads the contents of \p fileName into \p data.
+        static void readFile(const std::string &fileName, std::vector<char> *data)
+        {
+            FILE *fp = std::fopen(fileName.c_str(), "rb");
+            ASSERT_TRUE(fp != NULL);
+            char  buf[4096];
+            size_t n;
+            while ((n = std::fread(buf, 1, sizeof(buf), fp)) > 0)
+            {
+                data->insert(data->end(), buf, buf + n);
+            }
+            std::fclose(fp);
+        }
+
+        gmx::test::TestFileManager fileManager_;
+        std::string                fileName_;
+};
+
+TEST_F(XtcTest, ReadAheadMatchesSerialReading)
+{
+    writeTrajectory();
+
+    t_fileio              *serial    = open_xtc(fileName_.c_str(), "r");
+    t_fileio              *pipelined = open_xtc(fileName_.c_str(), "r");
+    t_xtc_readahead       *ra        = xtc_readahead_init(pipelined, c_natoms, 2);
+    ASSERT_TRUE(ra != NULL);
+    rvec                   x1[c_natoms], x2[c_natoms];
+    int                    nframes = 0;
+    while (true)
+    {
+        int      step1, step2;
+        real     time1, time2, prec1, prec2;
+        matrix   box1, box2;
+        gmx_bool bOK1, bOK2;
+        int      ret1 = read_next_xtc(serial, c_natoms, &step1, &time1, box1,
+                                      x1, &prec1, &bOK1);
+        int      ret2 = xtc_readahead_next(ra, &step2, &time2, box2,
+                                           x2, &prec2, &bOK2);
+        ASSERT_EQ(ret1, ret2);
+        EXPECT_EQ(bOK1, bOK2);
+        if (!ret1)
+        {
+            break;
+        }
+        EXPECT_EQ(step1, step2);
+        EXPECT_EQ(time1, time2);
+        EXPECT_EQ(prec1, prec2);
+        for (int d = 0; d < DIM; ++d)
+        {
+            EXPECT_EQ(box1[d][d], box2[d][d]);
+        }
+        for (int i = 0; i < c_natoms; ++i)
+        {
+            for (int d = 0; d < DIM; ++d)
+            {
+                EXPECT_EQ(x1[i][d], x2[i][d]);
+            }
+        }
+        ++nframes;
+    }
+    EXPECT_EQ(c_nframes, nframes);
+    xtc_readahead_done(ra);
+    close_xtc(serial);
+    close_xtc(pipelined);
+}
+
+TEST_F(XtcTest, ReadAheadRewindsToFirstUnreturnedFrame)
+{
+    writeTrajectory();
+
+    t_fileio              *fio = open_xtc(fileName_.c_str(), "r");
+    t_xtc_readahead       *ra  = xtc_readahead_init(fio, c_natoms, 1);
+    ASSERT_TRUE(ra != NULL);
+    rvec                   x[c_natoms];
+    int                    step;
+    real                   time, prec;
+    matrix                 box;
+    gmx_bool               bOK;
+    for (int frame = 0; frame < 3; ++frame)
+    {
+        ASSERT_TRUE(xtc_readahead_next(ra, &step, &time, box,
+                                       x, &prec, &bOK) != 0);
+        EXPECT_EQ(frame, step);
+    }
+    xtc_readahead_done(ra);
+    ASSERT_TRUE(read_next_xtc(fio, c_natoms, &step, &time, box,
+                              x, &prec, &bOK) != 0);
+    EXPECT_EQ(3, step);
+    close_xtc(fio);
+}
+
+TEST_F(XtcTest, FrameIndexAllowsSeeking)
+{
+    writeTrajectory();
+
+    // Build an index by reading through the file.
+    t_trxindex *index = trxindex_init();
+    t_fileio   *fio   = open_xtc(fileName_.c_str(), "r");
+    rvec        x[c_natoms];
+    int         step;
+    real        time, prec;
+    matrix      box;
+    gmx_bool    bOK;
+    while (true)
+    {
+        gmx_off_t fpos = gmx_fio_ftell(fio);
+        if (!read_next_xtc(fio, c_natoms, &step, &time, box, x, &prec, &bOK))
+        {
+            break;
+        }
+        trxindex_add_frame(index, fpos, step, time);
+    }
+    close_xtc(fio);
+    ASSERT_EQ(c_nframes, index->nframes);
+    ASSERT_TRUE(trxindex_write(index, fileName_.c_str()));
+    trxindex_free(index);
+    std::string indexFileName = fileName_ + ".idx";
+
+    output_env_t oenv;
+    output_env_init_default(&oenv);
+    t_trxstatus *status;
+    t_trxframe   fr;
+    ASSERT_TRUE(read_first_frame(oenv, &status, fileName_.c_str(), &fr, TRX_NEED_X));
+    EXPECT_EQ(c_nframes, trx_get_frame_count(status));
+    EXPECT_EQ(0.5*(c_nframes - 1), trx_get_time_of_final_frame(status));
+    ASSERT_TRUE(trx_seek_frame(status, 15));
+    ASSERT_TRUE(read_next_frame(oenv, status, &fr));
+    EXPECT_EQ(15, fr.step);
+    // A short jump forward can be done within the read-ahead.
+    ASSERT_TRUE(trx_seek_frame(status, 18));
+    ASSERT_TRUE(read_next_frame(oenv, status, &fr));
+    EXPECT_EQ(18, fr.step);
+    ASSERT_TRUE(trx_seek_frame(status, 5));
+    ASSERT_TRUE(read_next_frame(oenv, status, &fr));
+    EXPECT_EQ(5, fr.step);
+    EXPECT_FALSE(trx_seek_frame(status, c_nframes));
+    close_trx(status);
+    sfree(fr.x);
+    output_env_done(oenv);
+    std::remove(indexFileName.c_str());
+}
+
+TEST_F(XtcTest, FrameIndexIsIgnoredWhenStale)
+{
+    writeTrajectory();
+
+    t_trxindex *index = trxindex_init();
+    trxindex_add_frame(index, 0, 0, 0.0);
+    ASSERT_TRUE(trxindex_write(index, fileName_.c_str()));
+    trxindex_free(index);
+    index = trxindex_read(fileName_.c_str());
+    ASSERT_TRUE(index != NULL);
+    EXPECT_EQ(1, index->nframes);
+    trxindex_free(index);
+
+    // Appending to the trajectory makes the index stale.
+    FILE *fp = std::fopen(fileName_.c_str(), "ab");
+    std::fputc(0, fp);
+    std::fclose(fp);
+    EXPECT_TRUE(trxindex_read(fileName_.c_str()) == NULL);
+    std::remove((fileName_ + ".idx").c_str());
+}
+
+TEST_F(XtcTest, DecompressionMatchesReferenceDecoder)
+{
+    const int natoms  = 999;
+    const int nframes = writeVariedTrajectory(fileName_, natoms);
+
+    t_fileio *fio = open_xtc(fileName_.c_str(), "r");
+    matrix    box;
+    t_xdr3dfcoord_data data;
+    xdr3dfcoord_data_init(&data);
+    std::vector<float> x1(3*natoms), x2(3*natoms);
+    for (int frame = 0; frame < nframes; ++frame)
+    {
+        int      step;
+        real     time;
+        gmx_bool bOK;
+        ASSERT_TRUE(read_next_xtc_compressed(fio, natoms, &step, &time, box,
+                                             &data, &bOK) != 0);
+        ASSERT_TRUE(xdr3dfcoord_decompress_reference(&data, &x1[0]) != 0);
+        ASSERT_TRUE(xdr3dfcoord_decompress(&data, &x2[0]) != 0);
+        EXPECT_EQ(0, std::memcmp(&x1[0], &x2[0], 3*natoms*sizeof(float)))
+        << "frame " << frame;
+    }
+    xdr3dfcoord_data_done(&data);
+    close_xtc(fio);
+}
+
+TEST_F(XtcTest, CompressionWithThreadsMatchesSerial)
+{
+    // Large enough for compressing with multiple threads
+    const int         natoms     = 45000;
+    const std::string serialName = fileManager_.getTemporaryFilePath("serial.xtc");
+    const int         nthreads   = gmx_omp_get_max_threads();
+
+    gmx_omp_set_num_threads(1);
+    writeVariedTrajectory(serialName, natoms);
+    gmx_omp_set_num_threads(4);
+    writeVariedTrajectory(fileName_, natoms);
+    gmx_omp_set_num_threads(nthreads);
+
+    std::vector<char> serial, threaded;
+    readFile(serialName, &serial);
+    readFile(fileName_, &threaded);
+    ASSERT_EQ(serial.size(), threaded.size());
+    EXPECT_TRUE(serial == threaded);
+}
+
+TEST_F(XtcTest, CompressionUsesThreadBudget)
+{
+    // Enough atoms for more threads than the compression supports
+    const int         natoms     = 10000*(GMX_OPENMP_MAX_THREADS + 2);
+    const std::string serialName = fileManager_.getTemporaryFilePath("serial.xtc");
+
+    writeVariedTrajectory(serialName, natoms, 1);
+    writeVariedTrajectory(fileName_, natoms, GMX_OPENMP_MAX_THREADS + 2);
+
+    std::vector<char> serial, threaded;
+    readFile(serialName, &serial);
+    readFile(fileName_, &threaded);
+    ASSERT_EQ(serial.size(), threaded.size());
+    EXPECT_TRUE(serial == threaded);
+}
+
+} // namespace
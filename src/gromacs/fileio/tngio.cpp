@@ -724,16 +724,16 @@ void gmx_tng_prepare_low_prec_writing(tng_trajectory_t  tng,
 #endif
 }
 
-void gmx_fwrite_tng(tng_trajectory_t tng,
-                    const gmx_bool   bUseLossyCompression,
-                    int              step,
-                    real             elapsedPicoSeconds,
-                    real             lambda,
-                    const rvec      *box,
-                    int              nAtoms,
-                    const rvec      *x,
-                    const rvec      *v,
-                    const rvec      *f)
+gmx_bool gmx_fwrite_tng(tng_trajectory_t tng,
+                        const gmx_bool   bUseLossyCompression,
+                        int              step,
+                        real             elapsedPicoSeconds,
+                        real             lambda,
+                        const rvec      *box,
+                        int              nAtoms,
+                        const rvec      *x,
+                        const rvec      *v,
+                        const rvec      *f)
 {
 #ifdef GMX_USE_TNG
     typedef tng_function_status (*write_data_func_pointer)(tng_trajectory_t,
@@ -760,7 +760,7 @@ void gmx_fwrite_tng(tng_trajectory_t tng,
         /* This function might get called when the type of the
            compressed trajectory is actually XTC. So we exit and move
            on. */
-        return;
+        return TRUE;
     }
 
     tng_num_particles_get(tng, &nParticles);
@@ -790,7 +790,7 @@ void gmx_fwrite_tng(tng_trajectory_t tng,
                        TNG_PARTICLE_BLOCK_DATA,
                        compression) != TNG_SUCCESS)
         {
-            gmx_file("Cannot write TNG trajectory frame; maybe you are out of disk space?");
+            return FALSE;
         }
         /* TNG-MF1 compression only compresses positions and velocities. Use lossless
          * compression for box shape regardless of output mode */
@@ -800,7 +800,7 @@ void gmx_fwrite_tng(tng_trajectory_t tng,
                        TNG_NON_PARTICLE_BLOCK_DATA,
                        TNG_GZIP_COMPRESSION) != TNG_SUCCESS)
         {
-            gmx_file("Cannot write TNG trajectory frame; maybe you are out of disk space?");
+            return FALSE;
         }
     }
 
@@ -812,7 +812,7 @@ void gmx_fwrite_tng(tng_trajectory_t tng,
                        TNG_PARTICLE_BLOCK_DATA,
                        compression) != TNG_SUCCESS)
         {
-            gmx_file("Cannot write TNG trajectory frame; maybe you are out of disk space?");
+            return FALSE;
         }
     }
 
@@ -826,7 +826,7 @@ void gmx_fwrite_tng(tng_trajectory_t tng,
                        TNG_PARTICLE_BLOCK_DATA,
                        TNG_GZIP_COMPRESSION) != TNG_SUCCESS)
         {
-            gmx_file("Cannot write TNG trajectory frame; maybe you are out of disk space?");
+            return FALSE;
         }
     }
 
@@ -838,8 +838,10 @@ void gmx_fwrite_tng(tng_trajectory_t tng,
                    TNG_NON_PARTICLE_BLOCK_DATA,
                    TNG_GZIP_COMPRESSION) != TNG_SUCCESS)
     {
-        gmx_file("Cannot write TNG trajectory frame; maybe you are out of disk space?");
+        return FALSE;
     }
+
+    return TRUE;
 #else
     GMX_UNUSED_VALUE(tng);
     GMX_UNUSED_VALUE(bUseLossyCompression);
@@ -851,6 +853,8 @@ void gmx_fwrite_tng(tng_trajectory_t tng,
     GMX_UNUSED_VALUE(x);
     GMX_UNUSED_VALUE(v);
     GMX_UNUSED_VALUE(f);
+
+    return TRUE;
 #endif
 }
 
@@ -118,17 +118,19 @@ void gmx_tng_prepare_low_prec_writing(tng_trajectory_t         tng,
  * \param f                    Vector of forces
  *
  * The pointers tng, x, v, f may be NULL, which triggers not writing
- * (that component). box can only be NULL if x is also NULL. */
-void gmx_fwrite_tng(tng_trajectory_t tng,
-                    const gmx_bool   bUseLossyCompression,
-                    int              step,
-                    real             elapsedPicoSeconds,
-                    real             lambda,
-                    const rvec      *box,
-                    int              nAtoms,
-                    const rvec      *x,
-                    const rvec      *v,
-                    const rvec      *f);
+ * (that component). box can only be NULL if x is also NULL.
+ *
+ * Returns FALSE when writing failed, e.g. because the disk is full. */
+gmx_bool gmx_fwrite_tng(tng_trajectory_t tng,
+                        const gmx_bool   bUseLossyCompression,
+                        int              step,
+                        real             elapsedPicoSeconds,
+                        real             lambda,
+                        const rvec      *box,
+                        int              nAtoms,
+                        const rvec      *x,
+                        const rvec      *v,
+                        const rvec      *f);
 
 /*! \brief Write the current frame set to disk. Perform compression
  * etc.
@@ -200,16 +200,19 @@ void gmx_write_tng_from_trxframe(tng_trajectory_t        output,
     {
         natoms = frame->natoms;
     }
-    gmx_fwrite_tng(output,
-                   TRUE,
-                   frame->step,
-                   frame->time,
-                   0,
-                   (const rvec *) frame->box,
-                   natoms,
-                   (const rvec *) frame->x,
-                   (const rvec *) frame->v,
-                   (const rvec *) frame->f);
+    if (!gmx_fwrite_tng(output,
+                        TRUE,
+                        frame->step,
+                        frame->time,
+                        0,
+                        (const rvec *) frame->box,
+                        natoms,
+                        (const rvec *) frame->x,
+                        (const rvec *) frame->v,
+                        (const rvec *) frame->f))
+    {
+        gmx_file("Cannot write TNG trajectory frame; maybe you are out of disk space?");
+    }
 #else
     GMX_UNUSED_VALUE(output);
     GMX_UNUSED_VALUE(frame);
@@ -97,6 +97,14 @@ do_md_trajectory_writing(FILE           *fplog,
     }
     ;
 
+    if (bCPT && bLastStep && step_rel == ir->nsteps && bDoConfOut && !bRerunMD)
+    {
+        /* We write the final coordinates below, with sharded checkpoints
+         * we need to request collecting them.
+         */
+        mdof_flags |= MDOF_COLLECT_XV;
+    }
+
 #if defined(GMX_FAHCORE) || defined(GMX_WRITELASTSTEP)
     if (bLastStep)
     {
@@ -0,0 +1,232 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2014, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+#include "gmxpre.h"
+
+#include "trxindex.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include "gromacs/fileio/xdrf.h"
+#include "gromacs/utility/smalloc.h"
+
+/* Identifies index files, the characters "GIDX" */
+#define TRXINDEX_MAGIC   0x47494458
+/* Increase when changing the file format */
+#define TRXINDEX_VERSION 1
+
+/* Gets the size and modification time of fn, returns FALSE on failure */
+static gmx_bool get_file_stamp(const char *fn, gmx_int64_t *size, gmx_int64_t *mtime)
+{
+    struct stat st;
+
+    if (stat(fn, &st) != 0)
+    {
+        return FALSE;
+    }
+    *size  = st.st_size;
+    *mtime = st.st_mtime;
+
+    return TRUE;
+}
+
+static char *index_file_name(const char *trajfile)
+{
+    char *fn;
+
+    snew(fn, strlen(trajfile) + 5);
+    sprintf(fn, "%s.idx", trajfile);
+
+    return fn;
+}
+
+gmx_bool trxindex_build_enabled(void)
+{
+    return (getenv("GMX_TRX_INDEX") != NULL);
+}
+
+t_trxindex *trxindex_init(void)
+{
+    t_trxindex *index;
+
+    snew(index, 1);
+
+    return index;
+}
+
+void trxindex_add_frame(t_trxindex *index,
+                        gmx_off_t offset, gmx_int64_t step, double time)
+{
+    if (index->nframes == index->nalloc)
+    {
+        index->nalloc = over_alloc_large(index->nframes + 1);
+        srenew(index->offset, index->nalloc);
+        srenew(index->step, index->nalloc);
+        srenew(index->time, index->nalloc);
+    }
+    index->offset[index->nframes] = offset;
+    index->step[index->nframes]   = step;
+    index->time[index->nframes]   = time;
+    index->nframes++;
+}
+
+/* Reads or writes the contents of an index file after the header */
+static gmx_bool do_index_frames(XDR *xd, t_trxindex *index)
+{
+    gmx_int64_t offset;
+    int         i;
+
+    for (i = 0; i < index->nframes; i++)
+    {
+        offset = index->offset[i];
+        if (!xdr_int64(xd, &offset) ||
+            !xdr_int64(xd, &index->step[i]) ||
+            !xdr_double(xd, &index->time[i]))
+        {
+            return FALSE;
+        }
+        index->offset[i] = offset;
+    }
+
+    return TRUE;
+}
+
+t_trxindex *trxindex_read(const char *trajfile)
+{
+    char        *fn;
+    FILE        *fp;
+    XDR          xd;
+    int          magic, version, nframes;
+    gmx_int64_t  size, mtime, trajsize, trajmtime;
+    t_trxindex  *index = NULL;
+
+    if (!get_file_stamp(trajfile, &trajsize, &trajmtime))
+    {
+        return NULL;
+    }
+    fn = index_file_name(trajfile);
+    fp = fopen(fn, "rb");
+    sfree(fn);
+    if (fp == NULL)
+    {
+        return NULL;
+    }
+    xdrstdio_create(&xd, fp, XDR_DECODE);
+    if (xdr_int(&xd, &magic) && magic == TRXINDEX_MAGIC &&
+        xdr_int(&xd, &version) && version == TRXINDEX_VERSION &&
+        xdr_int64(&xd, &size) && size == trajsize &&
+        xdr_int64(&xd, &mtime) && mtime == trajmtime &&
+        xdr_int(&xd, &nframes) && nframes >= 0)
+    {
+        index          = trxindex_init();
+        index->nframes = nframes;
+        index->nalloc  = nframes;
+        snew(index->offset, nframes);
+        snew(index->step, nframes);
+        snew(index->time, nframes);
+        if (!do_index_frames(&xd, index))
+        {
+            trxindex_free(index);
+            index = NULL;
+        }
+    }
+    xdr_destroy(&xd);
+    fclose(fp);
+
+    return index;
+}
+
+gmx_bool trxindex_write(const t_trxindex *index, const char *trajfile)
+{
+    char        *fn;
+    FILE        *fp;
+    XDR          xd;
+    int          magic   = TRXINDEX_MAGIC;
+    int          version = TRXINDEX_VERSION;
+    int          nframes = index->nframes;
+    gmx_int64_t  size, mtime;
+    t_trxindex   frames;
+    gmx_bool     bOK;
+
+    if (!get_file_stamp(trajfile, &size, &mtime))
+    {
+        return FALSE;
+    }
+    fn = index_file_name(trajfile);
+    fp = fopen(fn, "wb");
+    if (fp == NULL)
+    {
+        sfree(fn);
+        return FALSE;
+    }
+    xdrstdio_create(&xd, fp, XDR_ENCODE);
+    /* The XDR routines take non-const pointers, but do not modify
+     * the data when writing.
+     */
+    frames = *index;
+    bOK    = (xdr_int(&xd, &magic) &&
+              xdr_int(&xd, &version) &&
+              xdr_int64(&xd, &size) &&
+              xdr_int64(&xd, &mtime) &&
+              xdr_int(&xd, &nframes) &&
+              do_index_frames(&xd, &frames));
+    xdr_destroy(&xd);
+    if (fclose(fp) != 0)
+    {
+        bOK = FALSE;
+    }
+    if (!bOK)
+    {
+        remove(fn);
+    }
+    sfree(fn);
+
+    return bOK;
+}
+
+void trxindex_free(t_trxindex *index)
+{
+    if (index)
+    {
+        sfree(index->offset);
+        sfree(index->step);
+        sfree(index->time);
+        sfree(index);
+    }
+}
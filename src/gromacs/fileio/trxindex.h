@@ -0,0 +1,91 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2014, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+#ifndef GMX_FILEIO_TRXINDEX_H
+#define GMX_FILEIO_TRXINDEX_H
+
+#include "gromacs/utility/basedefinitions.h"
+#include "gromacs/utility/futil.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Frame index of an XTC or TRR trajectory.
+ *
+ * The index stores the file offset, step and time of each frame,
+ * so that frames can be located without scanning the file.
+ * It is stored in a sidecar file next to the trajectory, with .idx
+ * appended to the trajectory file name, together with the size and
+ * modification time of the trajectory, so that a stale index is
+ * detected and ignored.
+ */
+typedef struct t_trxindex
+{
+    int           nframes; /* Number of frames                 */
+    int           nalloc;  /* Allocation size of the arrays    */
+    gmx_off_t    *offset;  /* File offset of the frame headers */
+    gmx_int64_t  *step;    /* Step of each frame               */
+    double       *time;    /* Time of each frame               */
+} t_trxindex;
+
+gmx_bool trxindex_build_enabled(void);
+/* Returns whether index files should be created when they do not exist,
+ * set with the environment variable GMX_TRX_INDEX.
+ */
+
+t_trxindex *trxindex_init(void);
+/* Returns an empty index */
+
+void trxindex_add_frame(t_trxindex *index,
+                        gmx_off_t offset, gmx_int64_t step, double time);
+/* Appends a frame to index */
+
+t_trxindex *trxindex_read(const char *trajfile);
+/* Reads the index for trajfile.
+ * Returns NULL when there is no index file, or when it does not match
+ * the current size and modification time of trajfile.
+ */
+
+gmx_bool trxindex_write(const t_trxindex *index, const char *trajfile);
+/* Writes the index file for trajfile, returns FALSE on failure */
+
+void trxindex_free(t_trxindex *index);
+/* Frees index, which can be NULL */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
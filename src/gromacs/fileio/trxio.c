@@ -52,8 +52,10 @@
 #include "gromacs/fileio/tpxio.h"
 #include "gromacs/fileio/trnio.h"
 #include "gromacs/fileio/trx.h"
+#include "gromacs/fileio/trxindex.h"
 #include "gromacs/fileio/xdrf.h"
 #include "gromacs/fileio/xtcio.h"
+#include "gromacs/fileio/xtcreadahead.h"
 #include "gromacs/legacyheaders/checkpoint.h"
 #include "gromacs/legacyheaders/names.h"
 #include "gromacs/math/vec.h"
@@ -82,6 +84,11 @@ struct t_trxstatus
     double                  DT, BOX[3];
     gmx_bool                bReadBox;
     char                   *persistent_line; /* Persistent line for reading g96 trajectories */
+    t_xtc_readahead        *readahead;       /* Read-ahead for xtc, NULL when not active */
+    int                     nreadahead;      /* Number of read-ahead threads, -1 if not set */
+    t_trxindex             *index;           /* Frame index of the file, NULL if not available */
+    t_trxindex             *newindex;        /* Frame index being built while reading, or NULL */
+    int                     nextframe;       /* Number of the next frame in the file, -1 if unknown */
 };
 
 /* utility functions */
@@ -159,6 +166,123 @@ static void status_init(t_trxstatus *status)
     status->__frame         = -1;
     status->persistent_line = NULL;
     status->tng             = NULL;
+    status->readahead       = NULL;
+    status->nreadahead      = -1;
+    status->index           = NULL;
+    status->newindex        = NULL;
+    status->nextframe       = -1;
+}
+
+static void stop_readahead(t_trxstatus *status)
+{
+    if (status->readahead)
+    {
+        /* This puts the file at the first frame not yet returned */
+        xtc_readahead_done(status->readahead);
+        status->readahead = NULL;
+    }
+}
+
+/* Reads the frame index for fn, or starts building one */
+static void init_frame_index(t_trxstatus *status, const char *fn, int ftp)
+{
+    if (ftp != efXTC && ftp != efTRR)
+    {
+        return;
+    }
+    status->nextframe = 0;
+    status->index     = trxindex_read(fn);
+    if (status->index == NULL && trxindex_build_enabled())
+    {
+        status->newindex = trxindex_init();
+    }
+}
+
+/* Called when the file position can have been changed by others */
+static void lose_frame_position(t_trxstatus *status)
+{
+    trxindex_free(status->newindex);
+    status->newindex  = NULL;
+    status->nextframe = -1;
+}
+
+/* Registers that the frame in fr has been read from position fpos */
+static void add_frame_to_index(t_trxstatus *status, gmx_off_t fpos, t_trxframe *fr)
+{
+    if (status->nextframe < 0)
+    {
+        return;
+    }
+    /* After a rewind we read frames that are already in the index */
+    if (status->newindex && status->newindex->nframes == status->nextframe)
+    {
+        trxindex_add_frame(status->newindex, fpos, fr->step, fr->time);
+    }
+    status->nextframe++;
+}
+
+/* Called when the end of the file has been reached */
+static void finish_frame_index(t_trxstatus *status)
+{
+    if (status->newindex && status->nextframe >= 0)
+    {
+        /* The index is optional, so ignore failure to write it */
+        trxindex_write(status->newindex, gmx_fio_getname(status->fio));
+        trxindex_free(status->newindex);
+        status->newindex = NULL;
+    }
+}
+
+/* Positions status at frame using the frame index. When the frame is
+ * only a few frames ahead and read-ahead is active, the frames in between
+ * are skipped in the read-ahead pipeline instead of restarting it.
+ */
+static gmx_bool seek_frame_with_index(t_trxstatus *status, int frame)
+{
+    if (frame == status->nextframe)
+    {
+        return TRUE;
+    }
+    if (status->readahead && status->nextframe >= 0 && frame > status->nextframe &&
+        xtc_readahead_skip(status->readahead, frame - status->nextframe))
+    {
+        status->nextframe = frame;
+        return TRUE;
+    }
+    stop_readahead(status);
+    if (gmx_fio_seek(status->fio, status->index->offset[frame]) != 0)
+    {
+        lose_frame_position(status);
+        return FALSE;
+    }
+    status->nextframe = frame;
+
+    return TRUE;
+}
+
+/* Uses the frame index to jump over frames that read_next_frame()
+ * would skip because of the -b and -dt settings.
+ */
+static void skip_frames_with_index(t_trxstatus *status, t_trxframe *fr)
+{
+    int i;
+
+    if (status->index == NULL || status->nextframe < 0 ||
+        (fr->flags & TRX_DONT_SKIP) || !(bTimeSet(TBEGIN) || bTimeSet(TDELTA)))
+    {
+        return;
+    }
+    /* Stop at the last frame, so reading continues to the end of the file */
+    i = status->nextframe;
+    while (i < status->index->nframes - 1 &&
+           check_times2(status->index->time[i], fr->t0, fr->bDouble) < 0)
+    {
+        i++;
+    }
+    if (i > status->nextframe)
+    {
+        seek_frame_with_index(status, i);
+    }
 }
 
 
@@ -223,16 +347,25 @@ real ndec2prec(int ndec)
 
 t_fileio *trx_get_fileio(t_trxstatus *status)
 {
+    /* The caller may access the file directly */
+    stop_readahead(status);
+    lose_frame_position(status);
     return status->fio;
 }
 
 float trx_get_time_of_final_frame(t_trxstatus *status)
 {
-    t_fileio *stfio    = trx_get_fileio(status);
-    int       filetype = gmx_fio_getftp(stfio);
+    t_fileio *stfio;
+    int       filetype;
     int       bOK;
     float     lasttime = -1;
 
+    if (status->index && status->index->nframes > 0)
+    {
+        return status->index->time[status->index->nframes - 1];
+    }
+    stfio    = trx_get_fileio(status);
+    filetype = gmx_fio_getftp(stfio);
     if (filetype == efXTC)
     {
         lasttime =
@@ -260,6 +393,21 @@ float trx_get_time_of_final_frame(t_trxstatus *status)
     return lasttime;
 }
 
+int trx_get_frame_count(t_trxstatus *status)
+{
+    return (status->index ? status->index->nframes : -1);
+}
+
+gmx_bool trx_seek_frame(t_trxstatus *status, int frame)
+{
+    if (status->index == NULL || frame < 0 || frame >= status->index->nframes)
+    {
+        return FALSE;
+    }
+
+    return seek_frame_with_index(status, frame);
+}
+
 void clear_trxframe(t_trxframe *fr, gmx_bool bFirst)
 {
     fr->not_ok    = 0;
@@ -607,6 +755,9 @@ int write_trx(t_trxstatus *status, int nind, const atom_id *ind, t_atoms *atoms,
 
 void close_trx(t_trxstatus *status)
 {
+    stop_readahead(status);
+    trxindex_free(status->index);
+    trxindex_free(status->newindex);
     gmx_tng_close(&status->tng);
     if (status->fio)
     {
@@ -782,9 +933,10 @@ gmx_bool read_next_frame(const output_env_t oenv, t_trxstatus *status, t_trxfram
 {
     real     pt;
     int      ct;
-    gmx_bool bOK, bRet, bMissingData = FALSE, bSkip = FALSE;
-    int      dummy = 0;
-    int      ftp;
+    gmx_bool  bOK, bRet, bMissingData = FALSE, bSkip = FALSE;
+    int       dummy = 0;
+    int       ftp;
+    gmx_off_t fpos  = 0;
 
     bRet = FALSE;
     pt   = fr->tf;
@@ -804,10 +956,26 @@ gmx_bool read_next_frame(const output_env_t oenv, t_trxstatus *status, t_trxfram
         {
             ftp = gmx_fio_getftp(status->fio);
         }
+        if (ftp == efTRR || ftp == efXTC)
+        {
+            skip_frames_with_index(status, fr);
+            if (status->newindex && status->readahead == NULL)
+            {
+                fpos = gmx_fio_ftell(status->fio);
+            }
+        }
         switch (ftp)
         {
             case efTRR:
                 bRet = gmx_next_frame(status, fr);
+                if (bRet)
+                {
+                    add_frame_to_index(status, fpos, fr);
+                }
+                else if (!fr->not_ok)
+                {
+                    finish_frame_index(status);
+                }
                 break;
             case efCPT:
                 /* Checkpoint files can not contain mulitple frames */
@@ -825,8 +993,11 @@ gmx_bool read_next_frame(const output_env_t oenv, t_trxstatus *status, t_trxfram
                 /* DvdS 2005-05-31: this has been fixed along with the increased
                  * accuracy of the control over -b and -e options.
                  */
-                if (bTimeSet(TBEGIN) && (fr->tf < rTimeValue(TBEGIN)))
+                if ((status->index == NULL || status->nextframe < 0) &&
+                    bTimeSet(TBEGIN) && (fr->tf < rTimeValue(TBEGIN)))
                 {
+                    stop_readahead(status);
+                    lose_frame_position(status);
                     if (xtc_seek_time(status->fio, rTimeValue(TBEGIN), fr->natoms, TRUE))
                     {
                         gmx_fatal(FARGS, "Specified frame (time %f) doesn't exist or file corrupt/inconsistent.",
@@ -834,8 +1005,33 @@ gmx_bool read_next_frame(const output_env_t oenv, t_trxstatus *status, t_trxfram
                     }
                     initcount(status);
                 }
-                bRet = read_next_xtc(status->fio, fr->natoms, &fr->step, &fr->time, fr->box,
-                                     fr->x, &fr->prec, &bOK);
+                if (status->nreadahead < 0)
+                {
+                    status->nreadahead = xtc_readahead_nthreads();
+                }
+                if (status->readahead == NULL && status->nreadahead > 0)
+                {
+                    /* Overlap reading and decompressing the next frames
+                     * with the processing of this frame by the caller.
+                     */
+                    status->readahead = xtc_readahead_init(status->fio, fr->natoms,
+                                                           status->nreadahead);
+                    if (status->readahead == NULL)
+                    {
+                        status->nreadahead = 0;
+                    }
+                }
+                if (status->readahead)
+                {
+                    bRet = xtc_readahead_next(status->readahead, &fr->step, &fr->time,
+                                              fr->box, fr->x, &fr->prec, &bOK);
+                    fpos = xtc_readahead_position(status->readahead);
+                }
+                else
+                {
+                    bRet = read_next_xtc(status->fio, fr->natoms, &fr->step, &fr->time, fr->box,
+                                         fr->x, &fr->prec, &bOK);
+                }
                 fr->bPrec = (bRet && fr->prec > 0);
                 fr->bStep = bRet;
                 fr->bTime = bRet;
@@ -847,6 +1043,14 @@ gmx_bool read_next_frame(const output_env_t oenv, t_trxstatus *status, t_trxfram
                        but from bOK from read_next_xtc this can't be distinguished */
                     fr->not_ok = DATA_NOT_OK;
                 }
+                if (bRet)
+                {
+                    add_frame_to_index(status, fpos, fr);
+                }
+                else if (bOK)
+                {
+                    finish_frame_index(status);
+                }
                 break;
             case efTNG:
                 bRet = gmx_read_next_tng_frame(status->tng, fr, NULL, 0);
@@ -936,6 +1140,7 @@ int read_first_frame(const output_env_t oenv, t_trxstatus **status,
     else
     {
         fio = (*status)->fio = gmx_fio_open(fn, "r");
+        init_frame_index(*status, fn, ftp);
     }
     switch (ftp)
     {
@@ -979,6 +1184,8 @@ int read_first_frame(const output_env_t oenv, t_trxstatus **status,
             }
             else
             {
+                /* The first frame is at the start of the file */
+                add_frame_to_index(*status, 0, fr);
                 fr->bPrec = (fr->prec > 0);
                 fr->bStep = TRUE;
                 fr->bTime = TRUE;
@@ -1093,6 +1300,9 @@ gmx_bool read_next_x(const output_env_t oenv, t_trxstatus *status, real *t,
 
 void close_trj(t_trxstatus *status)
 {
+    stop_readahead(status);
+    trxindex_free(status->index);
+    trxindex_free(status->newindex);
     gmx_tng_close(&status->tng);
     if (status->fio)
     {
@@ -1110,7 +1320,12 @@ void rewind_trj(t_trxstatus *status)
 {
     initcount(status);
 
+    stop_readahead(status);
     gmx_fio_rewind(status->fio);
+    if (status->index || status->newindex)
+    {
+        status->nextframe = 0;
+    }
 }
 
 /***** T O P O L O G Y   S T U F F ******/
@@ -148,7 +148,26 @@ t_fileio *trx_get_fileio(t_trxstatus *status);
 /* get a fileio from a trxstatus */
 
 float trx_get_time_of_final_frame(t_trxstatus *status);
-/* get time of final frame. Only supported for TNG and XTC */
+/* get time of final frame. Only supported for TNG and XTC,
+ * and for TRR when a frame index is available.
+ */
+
+int trx_get_frame_count(t_trxstatus *status);
+/* Returns the number of frames in an XTC or TRR file opened with
+ * read_first_frame(), or -1 if there is no frame index for the file.
+ * A frame index is read from the file with .idx appended to the
+ * trajectory file name, when it matches the size and modification
+ * time of the trajectory. When the environment variable GMX_TRX_INDEX
+ * is set, this file is written after the whole trajectory has been
+ * read once.
+ */
+
+gmx_bool trx_seek_frame(t_trxstatus *status, int frame);
+/* Positions status such that the next read_next_frame() call reads
+ * frame number frame (counting from zero) from the file.
+ * Only possible when trx_get_frame_count() >= 0, returns FALSE when
+ * the frame does not exist or when there is no frame index.
+ */
 
 gmx_bool bRmod_fd(double a, double b, double c, gmx_bool bDouble);
 /* Returns TRUE when (a - b) MOD c = 0, using a margin which is slightly
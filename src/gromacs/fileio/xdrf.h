@@ -64,6 +64,60 @@ struct t_fileio;
 /* Read or write reduced precision *float* coordinates */
 int xdr3dfcoord(XDR *xdrs, float *fp, int *size, float *precision);
 
+int xdr3dfcoord_nthreads(XDR *xdrs, float *fp, int *size, float *precision,
+                         int nthreads);
+/* Same as xdr3dfcoord(), but when writing, the compression uses at most
+ * nthreads OpenMP threads. With nthreads <= 0, the OpenMP default is used.
+ */
+
+
+/* Compressed coordinates as stored by xdr3dfcoord(),
+ * read into memory but not yet decompressed.
+ */
+typedef struct t_xdr3dfcoord_data
+{
+    int    size;       /* Number of coordinate triplets                    */
+    float  precision;  /* Precision, -1 for uncompressed small frames      */
+    int    minint[3];  /* Minimum integer coordinates                      */
+    int    maxint[3];  /* Maximum integer coordinates                      */
+    int    smallidx;   /* Initial index into the table of small run sizes  */
+    int   *buf;        /* Bit reader state and the compressed bytes        */
+    int    buf_nalloc; /* Allocation size of buf                           */
+    int   *ip;         /* Integer work array for decompression             */
+    int    ip_nalloc;  /* Allocation size of ip                            */
+} t_xdr3dfcoord_data;
+
+void xdr3dfcoord_data_init(t_xdr3dfcoord_data *data);
+/* Initialize an empty data structure */
+
+void xdr3dfcoord_data_done(t_xdr3dfcoord_data *data);
+/* Free the memory used by data */
+
+int xdr3dfcoord_read_compressed(XDR *xdrs, t_xdr3dfcoord_data *data);
+/* Read compressed coordinates written by xdr3dfcoord() into data,
+ * without decompressing them.
+ * The memory in data is reused (and grown if needed) over calls.
+ */
+
+int xdr3dfcoord_decompress(t_xdr3dfcoord_data *data, float *fp);
+/* Decompress coordinates read with xdr3dfcoord_read_compressed().
+ * fp should have room for data->size triplets.
+ * Only data is accessed, so different data can be decompressed
+ * concurrently from different threads.
+ */
+
+int xdr3dfcoord_decompress_reference(t_xdr3dfcoord_data *data, float *fp);
+/* Same as xdr3dfcoord_decompress(), but using the original, slower,
+ * bit-by-bit decoder. Only meant for testing and benchmarking.
+ */
+
+int xdr3dfcoord_read(XDR *xdrs, t_xdr3dfcoord_data *data,
+                     float *fp, int *size, float *precision);
+/* Same as xdr3dfcoord() for an XDR stream open for reading, but using
+ * the memory in data for the work arrays, so that no memory needs to be
+ * allocated when it is called repeatedly with the same data.
+ */
+
 
 /* Read or write a *real* value (stored as float) */
 int xdr_real(XDR *xdrs, real *r);
@@ -102,6 +156,11 @@ int xdr_xtc_get_last_frame_number(FILE *fp, XDR *xdrs, int natoms, gmx_bool * bO
 XDR *gmx_fio_getxdr(struct t_fileio *fio);
 /* Return the file pointer itself */
 
+t_xdr3dfcoord_data *gmx_fio_getxdr3dfcoord_data(struct t_fileio *fio);
+/* Return the work arrays for reading compressed coordinates from fio,
+ * for use with xdr3dfcoord_read(). They are freed when fio is closed.
+ */
+
 #ifdef __cplusplus
 }
 #endif
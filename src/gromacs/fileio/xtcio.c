@@ -138,7 +138,11 @@ static int xtc_header(XDR *xd, int *magic, int *natoms, int *step, real *time,
     return result;
 }
 
-static int xtc_coord(XDR *xd, int *natoms, matrix box, rvec *x, real *prec, gmx_bool bRead)
+/* When reading, coords provides the work arrays for the decompression,
+ * when writing, at most nthreads threads are used for the compression.
+ */
+static int xtc_coord(XDR *xd, t_xdr3dfcoord_data *coords, int nthreads,
+                     int *natoms, matrix box, rvec *x, real *prec, gmx_bool bRead)
 {
     int    i, j, result;
 #ifdef GMX_DOUBLE
@@ -176,7 +180,14 @@ static int xtc_coord(XDR *xd, int *natoms, matrix box, rvec *x, real *prec, gmx_
         }
         fprec = *prec;
     }
-    result = XTC_CHECK("x", xdr3dfcoord(xd, ftmp, natoms, &fprec));
+    if (bRead)
+    {
+        result = XTC_CHECK("x", xdr3dfcoord_read(xd, coords, ftmp, natoms, &fprec));
+    }
+    else
+    {
+        result = XTC_CHECK("x", xdr3dfcoord_nthreads(xd, ftmp, natoms, &fprec, nthreads));
+    }
 
     /* Copy from temp. array if reading */
     if (bRead)
@@ -191,7 +202,14 @@ static int xtc_coord(XDR *xd, int *natoms, matrix box, rvec *x, real *prec, gmx_
     }
     sfree(ftmp);
 #else
-    result = XTC_CHECK("x", xdr3dfcoord(xd, x[0], natoms, prec));
+    if (bRead)
+    {
+        result = XTC_CHECK("x", xdr3dfcoord_read(xd, coords, x[0], natoms, prec));
+    }
+    else
+    {
+        result = XTC_CHECK("x", xdr3dfcoord_nthreads(xd, x[0], natoms, prec, nthreads));
+    }
 #endif
 
     return result;
@@ -202,6 +220,13 @@ static int xtc_coord(XDR *xd, int *natoms, matrix box, rvec *x, real *prec, gmx_
 int write_xtc(t_fileio *fio,
               int natoms, int step, real time,
               matrix box, rvec *x, real prec)
+{
+    return write_xtc_nthreads(fio, natoms, step, time, box, x, prec, 0);
+}
+
+int write_xtc_nthreads(t_fileio *fio,
+                       int natoms, int step, real time,
+                       matrix box, rvec *x, real prec, int nthreads)
 {
     int      magic_number = XTC_MAGIC;
     XDR     *xd;
@@ -224,7 +249,7 @@ int write_xtc(t_fileio *fio,
     }
 
     /* write data */
-    bOK = xtc_coord(xd, &natoms, box, x, &prec, FALSE); /* bOK will be 1 if writing went well */
+    bOK = xtc_coord(xd, NULL, nthreads, &natoms, box, x, &prec, FALSE); /* bOK will be 1 if writing went well */
 
     if (bOK)
     {
@@ -256,7 +281,7 @@ int read_first_xtc(t_fileio *fio, int *natoms, int *step, real *time,
 
     snew(*x, *natoms);
 
-    *bOK = xtc_coord(xd, natoms, box, *x, prec, TRUE);
+    *bOK = xtc_coord(xd, gmx_fio_getxdr3dfcoord_data(fio), 0, natoms, box, *x, prec, TRUE);
 
     return *bOK;
 }
@@ -287,7 +312,58 @@ int read_next_xtc(t_fileio* fio,
                   n, natoms);
     }
 
-    *bOK = xtc_coord(xd, &natoms, box, x, prec, TRUE);
+    *bOK = xtc_coord(xd, gmx_fio_getxdr3dfcoord_data(fio), 0, &natoms, box, x, prec, TRUE);
+
+    return *bOK;
+}
+
+int read_next_xtc_compressed(t_fileio* fio,
+                             int natoms, int *step, real *time,
+                             matrix box, struct t_xdr3dfcoord_data *coords,
+                             gmx_bool *bOK)
+{
+    int  magic;
+    int  n;
+    int  i, j, result;
+    XDR *xd;
+
+    *bOK = TRUE;
+    xd   = gmx_fio_getxdr(fio);
+
+    /* read header */
+    if (!xtc_header(xd, &magic, &n, step, time, TRUE, bOK))
+    {
+        return 0;
+    }
+
+    /* Check magic number */
+    check_xtc_magic(magic);
+
+    if (n > natoms)
+    {
+        gmx_fatal(FARGS, "Frame contains more atoms (%d) than expected (%d)",
+                  n, natoms);
+    }
+
+    /* box */
+    result = 1;
+    for (i = 0; ((i < DIM) && result); i++)
+    {
+        for (j = 0; ((j < DIM) && result); j++)
+        {
+            result = XTC_CHECK("box", xdr_r2f(xd, &(box[i][j]), TRUE));
+        }
+    }
+    if (result)
+    {
+        result = XTC_CHECK("x", xdr3dfcoord_read_compressed(xd, coords));
+    }
+    if (result && coords->size > natoms)
+    {
+        /* Decompressing would overflow the coordinate buffer */
+        result = XTC_CHECK("x", FALSE);
+    }
+    *bOK = (result != 0);
 
     return *bOK;
 }
@@ -47,6 +47,8 @@
 extern "C" {
 #endif
 
+struct t_xdr3dfcoord_data;
+
 /* All functions return 1 if successful, 0 otherwise
  * bOK tells if a frame is not corrupted
  */
@@ -67,11 +69,26 @@ int read_next_xtc(t_fileio *fio,
                   matrix box, rvec *x, real *prec, gmx_bool *bOK);
 /* Read subsequent frames */
 
+int read_next_xtc_compressed(t_fileio *fio,
+                             int natoms, int *step, real *time,
+                             matrix box, struct t_xdr3dfcoord_data *coords,
+                             gmx_bool *bOK);
+/* Read subsequent frames like read_next_xtc(), but without decompressing
+ * the coordinates; use xdr3dfcoord_decompress() for that.
+ */
+
 int write_xtc(t_fileio *fio,
               int natoms, int step, real time,
               matrix box, rvec *x, real prec);
 /* Write a frame to xtc file */
 
+int write_xtc_nthreads(t_fileio *fio,
+                       int natoms, int step, real time,
+                       matrix box, rvec *x, real prec, int nthreads);
+/* Write a frame to xtc file, using at most nthreads OpenMP threads
+ * for the compression; nthreads <= 0 uses the OpenMP default.
+ */
+
 int xtc_check(const char *str, gmx_bool bResult, const char *file, int line);
 #define XTC_CHECK(s, b) xtc_check(s, b, __FILE__, __LINE__)
 
@@ -0,0 +1,337 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2014, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+#include "gmxpre.h"
+
+#include "xtcreadahead.h"
+
+#include <stdlib.h>
+
+#include "thread_mpi/threads.h"
+
+#include "gromacs/fileio/xdrf.h"
+#include "gromacs/fileio/xtcio.h"
+#include "gromacs/math/vec.h"
+#include "gromacs/utility/futil.h"
+#include "gromacs/utility/smalloc.h"
+
+/* The life cycle of a frame buffer in the ring */
+enum {
+    eframeEMPTY, eframeREAD, eframeDECODING, eframeDECODED
+};
+
+typedef struct
+{
+    int                 state;  /* One of the eframe enum values           */
+    int                 index;  /* Sequence number of the frame            */
+    gmx_off_t           fpos;   /* Position of the frame in the file       */
+    int                 ret;    /* Return value of the read, 0 at the end  */
+    gmx_bool            bOK;    /* Whether the frame was read correctly    */
+    int                 step;
+    real                time;
+    matrix              box;
+    t_xdr3dfcoord_data  coords; /* The compressed coordinates              */
+    float              *x;      /* The decompressed coordinates            */
+} t_readahead_frame;
+
+struct t_xtc_readahead
+{
+    t_fileio            *fio;
+    int                  natoms;
+    int                  nframebuf; /* Size of the ring of frame buffers   */
+    t_readahead_frame   *frame;
+    int                  nread;     /* Number of frames read               */
+    int                  ndecode;   /* Number of frames given to decoders  */
+    int                  nreturned; /* Number of frames returned           */
+    gmx_off_t            lastfpos;  /* Position of the last returned frame */
+    gmx_bool             bEOF;      /* Whether the reader has finished     */
+    gmx_bool             bStop;     /* Tells the threads to stop           */
+    int                  nthreads;  /* Number of decoder threads running   */
+    tMPI_Thread_t        reader;
+    gmx_bool             bReader;   /* Whether the reader thread runs      */
+    tMPI_Thread_t       *decoder;
+    /* Protects all the above counters and the frame states */
+    tMPI_Thread_mutex_t  mutex;
+    /* Signaled whenever a counter or frame state changes */
+    tMPI_Thread_cond_t   cond;
+};
+
+int xtc_readahead_nthreads(void)
+{
+    const char *env;
+    int         nthreads;
+
+    if (tMPI_Thread_support() != TMPI_THREAD_SUPPORT_YES)
+    {
+        return 0;
+    }
+    env = getenv("GMX_XTC_READAHEAD");
+    if (env != NULL)
+    {
+        nthreads = strtol(env, NULL, 10);
+        return (nthreads > 0 ? nthreads : 0);
+    }
+    return (tMPI_Thread_get_hw_number() > 1 ? 1 : 0);
+}
+
+static void *readahead_reader(void *arg)
+{
+    t_xtc_readahead   *ra = (t_xtc_readahead *)arg;
+    t_readahead_frame *fr;
+
+    tMPI_Thread_mutex_lock(&ra->mutex);
+    while (!ra->bStop && !ra->bEOF)
+    {
+        fr = &ra->frame[ra->nread % ra->nframebuf];
+        if (fr->state != eframeEMPTY)
+        {
+            tMPI_Thread_cond_wait(&ra->cond, &ra->mutex);
+            continue;
+        }
+        /* The buffer is empty, so only this thread accesses it */
+        tMPI_Thread_mutex_unlock(&ra->mutex);
+        fr->fpos = gmx_fio_ftell(ra->fio);
+        fr->ret  = read_next_xtc_compressed(ra->fio, ra->natoms,
+                                            &fr->step, &fr->time, fr->box,
+                                            &fr->coords, &fr->bOK);
+        tMPI_Thread_mutex_lock(&ra->mutex);
+        fr->index = ra->nread;
+        fr->state = eframeREAD;
+        ra->nread++;
+        if (!fr->ret)
+        {
+            ra->bEOF = TRUE;
+        }
+        tMPI_Thread_cond_broadcast(&ra->cond);
+    }
+    tMPI_Thread_mutex_unlock(&ra->mutex);
+
+    return NULL;
+}
+
+static void *readahead_decoder(void *arg)
+{
+    t_xtc_readahead   *ra = (t_xtc_readahead *)arg;
+    t_readahead_frame *fr;
+
+    tMPI_Thread_mutex_lock(&ra->mutex);
+    while (!ra->bStop && !(ra->bEOF && ra->ndecode == ra->nread))
+    {
+        if (ra->ndecode == ra->nread)
+        {
+            tMPI_Thread_cond_wait(&ra->cond, &ra->mutex);
+            continue;
+        }
+        fr        = &ra->frame[ra->ndecode % ra->nframebuf];
+        fr->state = eframeDECODING;
+        ra->ndecode++;
+        tMPI_Thread_mutex_unlock(&ra->mutex);
+        if (fr->ret)
+        {
+            xdr3dfcoord_decompress(&fr->coords, fr->x);
+        }
+        tMPI_Thread_mutex_lock(&ra->mutex);
+        fr->state = eframeDECODED;
+        tMPI_Thread_cond_broadcast(&ra->cond);
+    }
+    tMPI_Thread_mutex_unlock(&ra->mutex);
+
+    return NULL;
+}
+
+t_xtc_readahead *xtc_readahead_init(t_fileio *fio, int natoms, int nthreads)
+{
+    t_xtc_readahead *ra;
+    int              i;
+
+    snew(ra, 1);
+    ra->fio       = fio;
+    ra->natoms    = natoms;
+    /* Enough buffers to keep all threads busy while the caller
+     * is processing a frame.
+     */
+    ra->nframebuf = 2*nthreads + 2;
+    snew(ra->frame, ra->nframebuf);
+    for (i = 0; i < ra->nframebuf; i++)
+    {
+        ra->frame[i].state = eframeEMPTY;
+        xdr3dfcoord_data_init(&ra->frame[i].coords);
+        snew(ra->frame[i].x, natoms*DIM);
+    }
+    tMPI_Thread_mutex_init(&ra->mutex);
+    tMPI_Thread_cond_init(&ra->cond);
+
+    snew(ra->decoder, nthreads);
+    ra->bReader = (tMPI_Thread_create(&ra->reader, readahead_reader, ra) == 0);
+    if (ra->bReader)
+    {
+        for (i = 0; i < nthreads; i++)
+        {
+            if (tMPI_Thread_create(&ra->decoder[i], readahead_decoder, ra) != 0)
+            {
+                break;
+            }
+            ra->nthreads++;
+        }
+    }
+    if (ra->nthreads < nthreads)
+    {
+        /* Nothing has been returned yet, so this puts the file back
+         * where we started.
+         */
+        xtc_readahead_done(ra);
+        return NULL;
+    }
+
+    return ra;
+}
+
+int xtc_readahead_next(t_xtc_readahead *ra,
+                       int *step, real *time,
+                       matrix box, rvec *x, real *prec, gmx_bool *bOK)
+{
+    t_readahead_frame *fr;
+    int                ret, i;
+
+    tMPI_Thread_mutex_lock(&ra->mutex);
+    fr = &ra->frame[ra->nreturned % ra->nframebuf];
+    while (!(fr->state == eframeDECODED && fr->index == ra->nreturned))
+    {
+        tMPI_Thread_cond_wait(&ra->cond, &ra->mutex);
+    }
+    tMPI_Thread_mutex_unlock(&ra->mutex);
+
+    ret  = fr->ret;
+    *bOK = fr->bOK;
+    if (!ret)
+    {
+        /* Keep the final frame in place, so we keep returning it */
+        return 0;
+    }
+    *step = fr->step;
+    *time = fr->time;
+    copy_mat(fr->box, box);
+    for (i = 0; i < fr->coords.size; i++)
+    {
+        x[i][XX] = fr->x[DIM*i+XX];
+        x[i][YY] = fr->x[DIM*i+YY];
+        x[i][ZZ] = fr->x[DIM*i+ZZ];
+    }
+    *prec        = fr->coords.precision;
+    ra->lastfpos = fr->fpos;
+
+    tMPI_Thread_mutex_lock(&ra->mutex);
+    fr->state = eframeEMPTY;
+    ra->nreturned++;
+    tMPI_Thread_cond_broadcast(&ra->cond);
+    tMPI_Thread_mutex_unlock(&ra->mutex);
+
+    /* The buffer can be reused right away, so we can not access fr here */
+    return ret;
+}
+
+gmx_bool xtc_readahead_skip(t_xtc_readahead *ra, int nframes)
+{
+    t_readahead_frame *fr;
+    int                i;
+
+    /* Further ahead, restarting at the new position is cheaper */
+    if (nframes > ra->nframebuf)
+    {
+        return FALSE;
+    }
+    tMPI_Thread_mutex_lock(&ra->mutex);
+    for (i = 0; i < nframes; i++)
+    {
+        fr = &ra->frame[ra->nreturned % ra->nframebuf];
+        while (!(fr->state == eframeDECODED && fr->index == ra->nreturned))
+        {
+            tMPI_Thread_cond_wait(&ra->cond, &ra->mutex);
+        }
+        if (!fr->ret)
+        {
+            tMPI_Thread_mutex_unlock(&ra->mutex);
+            return FALSE;
+        }
+        ra->lastfpos = fr->fpos;
+        fr->state    = eframeEMPTY;
+        ra->nreturned++;
+        tMPI_Thread_cond_broadcast(&ra->cond);
+    }
+    tMPI_Thread_mutex_unlock(&ra->mutex);
+
+    return TRUE;
+}
+
+gmx_off_t xtc_readahead_position(const t_xtc_readahead *ra)
+{
+    return ra->lastfpos;
+}
+
+void xtc_readahead_done(t_xtc_readahead *ra)
+{
+    int i;
+
+    tMPI_Thread_mutex_lock(&ra->mutex);
+    ra->bStop = TRUE;
+    tMPI_Thread_cond_broadcast(&ra->cond);
+    tMPI_Thread_mutex_unlock(&ra->mutex);
+    if (ra->bReader)
+    {
+        tMPI_Thread_join(ra->reader, NULL);
+    }
+    for (i = 0; i < ra->nthreads; i++)
+    {
+        tMPI_Thread_join(ra->decoder[i], NULL);
+    }
+
+    /* The reader has read ahead of the caller: rewind to the first frame
+     * that was not returned, which is still in its buffer.
+     */
+    if (ra->nreturned < ra->nread)
+    {
+        gmx_fio_seek(ra->fio, ra->frame[ra->nreturned % ra->nframebuf].fpos);
+    }
+
+    for (i = 0; i < ra->nframebuf; i++)
+    {
+        xdr3dfcoord_data_done(&ra->frame[i].coords);
+        sfree(ra->frame[i].x);
+    }
+    sfree(ra->frame);
+    sfree(ra->decoder);
+    tMPI_Thread_cond_destroy(&ra->cond);
+    tMPI_Thread_mutex_destroy(&ra->mutex);
+    sfree(ra);
+}
@@ -0,0 +1,98 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2014, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+#ifndef GMX_FILEIO_XTCREADAHEAD_H
+#define GMX_FILEIO_XTCREADAHEAD_H
+
+#include "gromacs/fileio/gmxfio.h"
+#include "gromacs/math/vectypes.h"
+#include "gromacs/utility/basedefinitions.h"
+#include "gromacs/utility/futil.h"
+#include "gromacs/utility/real.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Read-ahead pipeline for sequential reading of XTC files.
+ *
+ * A reader thread reads the compressed frames from the file into
+ * a bounded ring of frame buffers, decoder threads decompress them,
+ * and xtc_readahead_next() hands out the decoded frames in file order.
+ * While the pipeline is active, the file should not be accessed
+ * in any other way.
+ */
+typedef struct t_xtc_readahead t_xtc_readahead;
+
+int xtc_readahead_nthreads(void);
+/* Returns the number of decoder threads to use for read-ahead,
+ * 0 means that read-ahead should not be used.
+ * Can be set with the environment variable GMX_XTC_READAHEAD,
+ * the default is to use one decoder thread when more than one
+ * hardware thread is available.
+ */
+
+t_xtc_readahead *xtc_readahead_init(t_fileio *fio, int natoms, int nthreads);
+/* Start reading frames with at most natoms atoms from the current
+ * position in fio, using nthreads decoder threads.
+ * Returns NULL when the threads could not be started.
+ */
+
+int xtc_readahead_next(t_xtc_readahead *ra,
+                       int *step, real *time,
+                       matrix box, rvec *x, real *prec, gmx_bool *bOK);
+/* Return the next frame, with the same semantics as read_next_xtc() */
+
+gmx_bool xtc_readahead_skip(t_xtc_readahead *ra, int nframes);
+/* Skip the next nframes frames, when these are close enough to be
+ * read by the pipeline anyhow. Returns FALSE when the frames are
+ * too far ahead or the end of the file is reached, in which case
+ * the pipeline should be stopped and the file repositioned.
+ */
+
+gmx_off_t xtc_readahead_position(const t_xtc_readahead *ra);
+/* Returns the file position of the frame last returned by
+ * xtc_readahead_next()
+ */
+
+void xtc_readahead_done(t_xtc_readahead *ra);
+/* Stop the pipeline, position the file at the first frame that was
+ * not returned by xtc_readahead_next(), and free ra.
+ */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -38,25 +38,28 @@
 
 #include "cmat.h"
 
+#include <math.h>
+#include <string.h>
+
 #include "gromacs/fileio/matio.h"
 #include "gromacs/fileio/xvgr.h"
 #include "gromacs/legacyheaders/macros.h"
 #include "gromacs/math/vec.h"
+#include "gromacs/simd/simd.h"
 #include "gromacs/utility/futil.h"
 #include "gromacs/utility/smalloc.h"
 
-t_mat *init_mat(int n1, gmx_bool b1D)
+t_mat *init_mat(int n1)
 {
     t_mat *m;
 
     snew(m, 1);
     m->n1     = n1;
     m->nn     = 0;
-    m->b1D    = b1D;
     m->maxrms = 0;
     m->minrms = 1e20;
     m->sumrms = 0;
-    m->mat    = mk_matrix(n1, n1, b1D);
+    snew(m->tri, TRI_INDEX(0, n1));
 
     snew(m->erow, n1);
     snew(m->m_ind, n1);
@@ -67,7 +70,7 @@ t_mat *init_mat(int n1, gmx_bool b1D)
 
 void copy_t_mat(t_mat *dst, t_mat *src)
 {
-    int i, j;
+    int i;
 
     if (dst->nn != src->nn)
     {
@@ -77,12 +80,9 @@ void copy_t_mat(t_mat *dst, t_mat *src)
     dst->maxrms = src->maxrms;
     dst->minrms = src->minrms;
     dst->sumrms = src->sumrms;
+    memcpy(dst->tri, src->tri, TRI_INDEX(0, src->nn)*sizeof(dst->tri[0]));
     for (i = 0; (i < src->nn); i++)
     {
-        for (j = 0; (j < src->nn); j++)
-        {
-            dst->mat[i][j] = src->mat[i][j];
-        }
         dst->erow[i]  = src->erow[i];
         dst->m_ind[i] = src->m_ind[i];
     }
@@ -90,26 +90,22 @@ void copy_t_mat(t_mat *dst, t_mat *src)
 
 void enlarge_mat(t_mat *m, int deltan)
 {
-    int i, j;
+    size_t k;
+    int    i;
 
     srenew(m->erow, m->nn+deltan);
     srenew(m->m_ind, m->nn+deltan);
-    srenew(m->mat, m->nn+deltan);
 
-    /* Reallocate existing rows in the matrix, and set them to zero */
-    for (i = 0; (i < m->nn); i++)
+    /* The existing entries keep their index, set the new ones to zero */
+    srenew(m->tri, TRI_INDEX(0, m->nn+deltan));
+    for (k = TRI_INDEX(0, m->nn); k < TRI_INDEX(0, m->nn+deltan); k++)
     {
-        srenew(m->mat[i], m->nn+deltan);
-        for (j = m->nn; (j < m->nn+deltan); j++)
-        {
-            m->mat[i][j] = 0;
-        }
+        m->tri[k] = 0;
     }
-    /* Allocate new rows of the matrix, set energies to zero */
+    /* Set energies of the new rows to zero */
     for (i = m->nn; (i < m->nn+deltan); i++)
     {
         m->erow[i]  = 0;
-        snew(m->mat[i], m->nn+deltan);
     }
     m->nn += deltan;
 }
@@ -124,21 +120,27 @@ void reset_index(t_mat *m)
     }
 }
 
+/* Returns the index in m->tri of entry i,j with i != j */
+static size_t tri_index(int i, int j)
+{
+    return (i < j) ? TRI_INDEX(i, j) : TRI_INDEX(j, i);
+}
+
 void set_mat_entry(t_mat *m, int i, int j, real val)
 {
-    m->mat[i][j] = m->mat[j][i] = val;
-    m->maxrms    = max(m->maxrms, val);
     if (j != i)
     {
-        m->minrms  = min(m->minrms, val);
+        m->tri[tri_index(i, j)] = val;
+        m->minrms               = min(m->minrms, val);
     }
+    m->maxrms    = max(m->maxrms, val);
     m->sumrms   += val;
     m->nn        = max(m->nn, max(j+1, i+1));
 }
 
 void done_mat(t_mat **m)
 {
-    done_matrix((*m)->n1, &((*m)->mat));
+    sfree((*m)->tri);
     sfree((*m)->m_ind);
     sfree((*m)->erow);
     sfree(*m);
@@ -152,32 +154,30 @@ real mat_energy(t_mat *m)
 
     for (j = 0; (j < m->nn-1); j++)
     {
-        emat += sqr(m->mat[j][j+1]);
+        emat += sqr(mat_entry(m, j, j+1));
     }
     return emat;
 }
 
 void swap_rows(t_mat *m, int iswap, int jswap)
 {
-    real *tmp, ttt;
-    int   i, itmp;
+    real ttt;
+    int  i, itmp;
 
     /* Swap indices */
     itmp            = m->m_ind[iswap];
     m->m_ind[iswap] = m->m_ind[jswap];
     m->m_ind[jswap] = itmp;
 
-    /* Swap rows (since the matrix is an array of pointers) */
-    tmp           = m->mat[iswap];
-    m->mat[iswap] = m->mat[jswap];
-    m->mat[jswap] = tmp;
-
-    /* Swap columns */
+    /* Swap rows and columns, entry iswap,jswap and the diagonal stay */
     for (i = 0; (i < m->nn); i++)
     {
-        ttt              = m->mat[i][iswap];
-        m->mat[i][iswap] = m->mat[i][jswap];
-        m->mat[i][jswap] = ttt;
+        if (i != iswap && i != jswap)
+        {
+            ttt                           = m->tri[tri_index(i, iswap)];
+            m->tri[tri_index(i, iswap)]   = m->tri[tri_index(i, jswap)];
+            m->tri[tri_index(i, jswap)]   = ttt;
+        }
     }
 }
 
@@ -186,29 +186,36 @@ void swap_mat(t_mat *m)
     t_mat *tmp;
     int    i, j;
 
-    tmp = init_mat(m->nn, FALSE);
+    tmp = init_mat(m->nn);
     for (i = 0; (i < m->nn); i++)
     {
-        for (j = 0; (j < m->nn); j++)
+        for (j = i+1; (j < m->nn); j++)
         {
-            tmp->mat[m->m_ind[i]][m->m_ind[j]] = m->mat[i][j];
+            tmp->tri[tri_index(m->m_ind[i], m->m_ind[j])] = mat_entry(m, i, j);
         }
     }
-    /*tmp->mat[i][j] =  m->mat[m->m_ind[i]][m->m_ind[j]]; */
-    for (i = 0; (i < m->nn); i++)
+    memcpy(m->tri, tmp->tri, TRI_INDEX(0, m->nn)*sizeof(m->tri[0]));
+    done_mat(&tmp);
+}
+
+/* Writes the histogram of 101 bins of width 1/fac to fn */
+static void write_rmsd_dist(const char *fn, real fac, int *histo,
+                            const output_env_t oenv)
+{
+    FILE   *fp;
+    int     i;
+
+    fp = xvgropen(fn, "RMS Distribution", "RMS (nm)", "a.u.", oenv);
+    for (i = 0; (i < 101); i++)
     {
-        for (j = 0; (j < m->nn); j++)
-        {
-            m->mat[i][j] = tmp->mat[i][j];
-        }
+        fprintf(fp, "%10g  %10d\n", i/fac, histo[i]);
     }
-    done_mat(&tmp);
+    gmx_ffclose(fp);
 }
 
 void low_rmsd_dist(const char *fn, real maxrms, int nn, real **mat,
                    const output_env_t oenv)
 {
-    FILE   *fp;
     int     i, j, *histo, x;
     real    fac;
 
@@ -226,18 +233,297 @@ void low_rmsd_dist(const char *fn, real maxrms, int nn, real **mat,
         }
     }
 
-    fp = xvgropen(fn, "RMS Distribution", "RMS (nm)", "a.u.", oenv);
-    for (i = 0; (i < 101); i++)
+    write_rmsd_dist(fn, fac, histo, oenv);
+    sfree(histo);
+}
+
+void rmsd_distribution(const char *fn, t_mat *rms, const output_env_t oenv)
+{
+    int     *histo, x;
+    size_t   k;
+    real     fac;
+
+    fac = 100/rms->maxrms;
+    snew(histo, 101);
+    for (k = 0; k < TRI_INDEX(0, rms->nn); k++)
     {
-        fprintf(fp, "%10g  %10d\n", i/fac, histo[i]);
+        x = (int)(fac*rms->tri[k]+0.5);
+        if (x <= 100)
+        {
+            histo[x]++;
+        }
     }
-    gmx_ffclose(fp);
+
+    write_rmsd_dist(fn, fac, histo, oenv);
     sfree(histo);
 }
 
-void rmsd_distribution(const char *fn, t_mat *rms, const output_env_t oenv)
+real **mat2real(t_mat *m, gmx_bool b1D)
 {
-    low_rmsd_dist(fn, rms->maxrms, rms->nn, rms->mat, oenv);
+    real **mat;
+    int    i, j;
+
+    mat = mk_matrix(m->n1, m->n1, b1D);
+    for (i = 0; (i < m->n1); i++)
+    {
+        for (j = 0; (j < m->n1); j++)
+        {
+            mat[i][j] = mat_entry(m, i, j);
+        }
+    }
+
+    return mat;
+}
+
+/* The RMSD matrix is computed in square tiles of this many frames,
+ * such that the coordinates of two tiles stay in cache.
+ */
+#define RMSD_TILE  16
+
+/* Returns the RMSD after optimal superposition of two structures that are
+ * centered on their weighted centers, using the quaternion characteristic
+ * polynomial method (Theobald, Acta Cryst. A61, 478 (2005)).
+ * s is the weighted correlation matrix sum_i w_i x_i y_i^T,
+ * ga and gb are the weighted sums of squares and wtot the total weight.
+ */
+static real rmsd_qcp(double s[DIM][DIM], double ga, double gb, double wtot)
+{
+    double Sxx = s[XX][XX], Sxy = s[XX][YY], Sxz = s[XX][ZZ];
+    double Syx = s[YY][XX], Syy = s[YY][YY], Syz = s[YY][ZZ];
+    double Szx = s[ZZ][XX], Szy = s[ZZ][YY], Szz = s[ZZ][ZZ];
+    double Sxx2, Syy2, Szz2, Sxy2, Syz2, Sxz2, Syx2, Szy2, Szx2;
+    double SyzSzymSyySzz2, Sxx2Syy2Szz2Syz2Szy2, Sxy2Sxz2Syx2Szx2;
+    double SxzpSzx, SyzpSzy, SxypSyx, SyzmSzy, SxzmSzx, SxymSyx, SxxpSyy, SxxmSyy;
+    double C0, C1, C2, e0, lambda, lambda_old, x2, a, b;
+    int    iter;
+
+    Sxx2 = Sxx*Sxx; Syy2 = Syy*Syy; Szz2 = Szz*Szz;
+    Sxy2 = Sxy*Sxy; Syz2 = Syz*Syz; Sxz2 = Sxz*Sxz;
+    Syx2 = Syx*Syx; Szy2 = Szy*Szy; Szx2 = Szx*Szx;
+
+    SyzSzymSyySzz2       = 2.0*(Syz*Szy - Syy*Szz);
+    Sxx2Syy2Szz2Syz2Szy2 = Syy2 + Szz2 - Sxx2 + Syz2 + Szy2;
+
+    C2 = -2.0*(Sxx2 + Syy2 + Szz2 + Sxy2 + Syx2 + Sxz2 + Szx2 + Syz2 + Szy2);
+    C1 =  8.0*(Sxx*Syz*Szy + Syy*Szx*Sxz + Szz*Sxy*Syx -
+               Sxx*Syy*Szz - Syz*Szx*Sxy - Szy*Syx*Sxz);
+
+    SxzpSzx = Sxz + Szx; SyzpSzy = Syz + Szy; SxypSyx = Sxy + Syx;
+    SyzmSzy = Syz - Szy; SxzmSzx = Sxz - Szx; SxymSyx = Sxy - Syx;
+    SxxpSyy = Sxx + Syy; SxxmSyy = Sxx - Syy;
+    Sxy2Sxz2Syx2Szx2 = Sxy2 + Sxz2 - Syx2 - Szx2;
+
+    C0 = Sxy2Sxz2Syx2Szx2*Sxy2Sxz2Syx2Szx2
+        + (Sxx2Syy2Szz2Syz2Szy2 + SyzSzymSyySzz2)*(Sxx2Syy2Szz2Syz2Szy2 - SyzSzymSyySzz2)
+        + (-SxzpSzx*SyzmSzy + SxymSyx*(SxxmSyy - Szz))*(-SxzmSzx*SyzpSzy + SxymSyx*(SxxmSyy + Szz))
+        + (-SxzpSzx*SyzpSzy - SxypSyx*(SxxpSyy - Szz))*(-SxzmSzx*SyzmSzy - SxypSyx*(SxxpSyy + Szz))
+        + ( SxypSyx*SyzpSzy + SxzpSzx*(SxxmSyy + Szz))*(-SxymSyx*SyzmSzy + SxzpSzx*(SxxpSyy + Szz))
+        + ( SxypSyx*SyzmSzy + SxzmSzx*(SxxmSyy - Szz))*(-SxymSyx*SyzpSzy + SxzmSzx*(SxxpSyy - Szz));
+
+    /* Newton iterations for the largest root, starting from its upper bound */
+    e0     = 0.5*(ga + gb);
+    lambda = e0;
+    for (iter = 0; iter < 50; iter++)
+    {
+        lambda_old = lambda;
+        x2         = lambda*lambda;
+        b          = (x2 + C2)*lambda;
+        a          = b + C1;
+        lambda    -= (a*lambda + C0)/(2.0*x2*lambda + b + a);
+        if (fabs(lambda - lambda_old) < fabs(1e-11*lambda))
+        {
+            break;
+        }
+    }
+
+    return sqrt(fabs(2.0*(e0 - lambda)/wtot));
+}
+
+/* Computes the weighted correlation matrix s = sum_i w_i xa_i xb_i^T of two
+ * frames stored as x, y and z blocks of npad elements each.
+ */
+static void rmsd_corr(int npad, const real *w, const real *xa, const real *xb,
+                      double s[DIM][DIM])
+{
+    int d1, d2;
+#ifdef GMX_SIMD_HAVE_REAL
+    gmx_simd_real_t sum[DIM][DIM];
+    gmx_simd_real_t wa[DIM], b[DIM], wv;
+    int             i;
+
+    for (d1 = 0; d1 < DIM; d1++)
+    {
+        for (d2 = 0; d2 < DIM; d2++)
+        {
+            sum[d1][d2] = gmx_simd_setzero_r();
+        }
+    }
+    for (i = 0; i < npad; i += GMX_SIMD_REAL_WIDTH)
+    {
+        wv = gmx_simd_load_r(w + i);
+        for (d1 = 0; d1 < DIM; d1++)
+        {
+            wa[d1] = gmx_simd_mul_r(wv, gmx_simd_load_r(xa + d1*npad + i));
+            b[d1]  = gmx_simd_load_r(xb + d1*npad + i);
+        }
+        for (d1 = 0; d1 < DIM; d1++)
+        {
+            for (d2 = 0; d2 < DIM; d2++)
+            {
+                sum[d1][d2] = gmx_simd_fmadd_r(wa[d1], b[d2], sum[d1][d2]);
+            }
+        }
+    }
+    for (d1 = 0; d1 < DIM; d1++)
+    {
+        for (d2 = 0; d2 < DIM; d2++)
+        {
+            s[d1][d2] = gmx_simd_reduce_r(sum[d1][d2]);
+        }
+    }
+#else
+    int i;
+
+    for (d1 = 0; d1 < DIM; d1++)
+    {
+        for (d2 = 0; d2 < DIM; d2++)
+        {
+            s[d1][d2] = 0;
+            for (i = 0; i < npad; i++)
+            {
+                s[d1][d2] += w[i]*xa[d1*npad + i]*xb[d2*npad + i];
+            }
+        }
+    }
+#endif
+}
+
+/* Returns the weighted sum of squared differences of two frames, stored as
+ * for rmsd_corr.
+ */
+static double rmsd_sumsq(int npad, const real *w, const real *xa, const real *xb)
+{
+    int    i;
+#ifdef GMX_SIMD_HAVE_REAL
+    gmx_simd_real_t sum = gmx_simd_setzero_r();
+    gmx_simd_real_t dx;
+    int             d;
+
+    for (i = 0; i < npad; i += GMX_SIMD_REAL_WIDTH)
+    {
+        gmx_simd_real_t wv  = gmx_simd_load_r(w + i);
+        gmx_simd_real_t dsq = gmx_simd_setzero_r();
+        for (d = 0; d < DIM; d++)
+        {
+            dx  = gmx_simd_sub_r(gmx_simd_load_r(xa + d*npad + i),
+                                 gmx_simd_load_r(xb + d*npad + i));
+            dsq = gmx_simd_fmadd_r(dx, dx, dsq);
+        }
+        sum = gmx_simd_fmadd_r(wv, dsq, sum);
+    }
+    return gmx_simd_reduce_r(sum);
+#else
+    double sum = 0;
+    real   dx, dy, dz;
+
+    for (i = 0; i < npad; i++)
+    {
+        dx   = xa[i] - xb[i];
+        dy   = xa[npad + i] - xb[npad + i];
+        dz   = xa[2*npad + i] - xb[2*npad + i];
+        sum += w[i]*(dx*dx + dy*dy + dz*dz);
+    }
+    return sum;
+#endif
+}
+
+/* Pairs are computed in tiles of frames, distributed over OpenMP threads */
+void calc_rmsd_matrix(int nf, int isize, rvec **xx, real *mass,
+                             gmx_bool bFit, t_mat *rms)
+{
+    int     npad, nfpad, ntile, f, i, d;
+    real   *w, *xs;
+    double *g, wtot;
+
+#ifdef GMX_SIMD_HAVE_REAL
+    npad = ((isize + GMX_SIMD_REAL_WIDTH - 1)/GMX_SIMD_REAL_WIDTH)*GMX_SIMD_REAL_WIDTH;
+#else
+    npad = isize;
+#endif
+    /* Copy the frames into x, y and z blocks, padded with zero weight */
+    snew_aligned(w, npad, 64);
+    wtot = 0;
+    for (i = 0; i < isize; i++)
+    {
+        w[i]  = mass[i];
+        wtot += mass[i];
+    }
+    nfpad = DIM*npad;
+    snew_aligned(xs, (size_t)nf*nfpad, 64);
+    snew(g, nf);
+#pragma omp parallel for private(i, d) schedule(static)
+    for (f = 0; f < nf; f++)
+    {
+        for (d = 0; d < DIM; d++)
+        {
+            for (i = 0; i < isize; i++)
+            {
+                xs[(size_t)f*nfpad + d*npad + i] = xx[f][i][d];
+                g[f] += mass[i]*xx[f][i][d]*xx[f][i][d];
+            }
+        }
+    }
+
+    ntile = (nf + RMSD_TILE - 1)/RMSD_TILE;
+#pragma omp parallel for schedule(dynamic)
+    for (f = 0; f < ntile; f++)
+    {
+        int    tj, i1, i2, i2start, i1end, i2end;
+        double s[DIM][DIM];
+        real   rmsd;
+
+        i1end = min(nf, (f + 1)*RMSD_TILE);
+        for (tj = f; tj < ntile; tj++)
+        {
+            i2end = min(nf, (tj + 1)*RMSD_TILE);
+            for (i1 = f*RMSD_TILE; i1 < i1end; i1++)
+            {
+                const real *x1 = xs + (size_t)i1*nfpad;
+
+                i2start = (tj == f) ? i1 + 1 : tj*RMSD_TILE;
+                for (i2 = i2start; i2 < i2end; i2++)
+                {
+                    const real *x2 = xs + (size_t)i2*nfpad;
+
+                    if (bFit)
+                    {
+                        rmsd_corr(npad, w, x1, x2, s);
+                        rmsd = rmsd_qcp(s, g[i1], g[i2], wtot);
+                    }
+                    else
+                    {
+                        rmsd = sqrt(rmsd_sumsq(npad, w, x1, x2)/wtot);
+                    }
+                    rms->tri[TRI_INDEX(i1, i2)] = rmsd;
+                }
+            }
+        }
+    }
+
+    /* Set the entries in order, so the statistics do not depend on the
+     * number of threads.
+     */
+    for (i = 0; i < nf; i++)
+    {
+        for (f = i + 1; f < nf; f++)
+        {
+            set_mat_entry(rms, i, f, mat_entry(rms, i, f));
+        }
+    }
+
+    sfree_aligned(w);
+    sfree_aligned(xs);
+    sfree(g);
 }
 
 t_clustid *new_clustid(int n1)
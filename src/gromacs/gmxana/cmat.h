@@ -40,6 +40,10 @@
 
 #include "gromacs/legacyheaders/typedefs.h"
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 typedef struct {
     int  i, j;
     real dist;
@@ -52,16 +56,37 @@ typedef struct {
 typedef struct {
     int      n1, nn;
     int     *m_ind;
-    gmx_bool b1D;
     real     minrms, maxrms, sumrms;
     real    *erow;
-    real   **mat;
+    real    *tri;
 } t_mat;
+/* The symmetric matrix with zero diagonal is stored as the compact upper
+ * triangle in tri, which should be accessed with mat_entry().
+ */
 
 /* The matrix is indexed using the matrix index */
 #define EROW(m, i)  m->erow[i]
 
-extern t_mat *init_mat(int n1, gmx_bool b1D);
+/* The index in tri of entry i,j with i < j. The triangle is stored column
+ * by column, so the index does not depend on the size of the matrix.
+ */
+#define TRI_INDEX(i, j)  ((size_t)(j)*((j)-1)/2 + (i))
+
+static gmx_inline real mat_entry(const t_mat *m, int i, int j)
+{
+    if (i < j)
+    {
+        return m->tri[TRI_INDEX(i, j)];
+    }
+    else if (i > j)
+    {
+        return m->tri[TRI_INDEX(j, i)];
+    }
+    return 0;
+}
+/* Returns entry i,j of matrix m */
+
+extern t_mat *init_mat(int n1);
 
 extern void copy_t_mat(t_mat *dst, t_mat *src);
 
@@ -84,6 +109,22 @@ extern void low_rmsd_dist(const char *fn, real maxrms, int nn, real **mat,
 
 extern void rmsd_distribution(const char *fn, t_mat *m, const output_env_t oenv);
 
+extern real **mat2real(t_mat *m, gmx_bool b1D);
+/* Returns a newly allocated n1 x n1 matrix with the entries of m.
+ * The rows are stored contiguously when b1D is set.
+ */
+
+extern void calc_rmsd_matrix(int nf, int isize, rvec **xx, real *mass,
+                             gmx_bool bFit, t_mat *rms);
+/* Computes the weighted RMSD between all pairs of the nf frames in xx,
+ * with a least-squares fit when bFit is set, and stores them in rms.
+ * The frames should have been centered when bFit is set.
+ */
+
 extern t_clustid *new_clustid(int n1);
 
+#ifdef __cplusplus
+}
+#endif
+
 #endif
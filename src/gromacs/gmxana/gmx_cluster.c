@@ -172,14 +172,14 @@ void mc_optimize(FILE *log, t_mat *m, real *time,
     printf("that have the largest pairwise RMSD.\n");
 
     iswap = jswap = -1;
-    enorm = m->mat[0][0];
+    enorm = 0;
     for (i = 0; (i < m->n1); i++)
     {
         for (j = 0; (j < m->nn); j++)
         {
-            if (m->mat[i][j] > enorm)
+            if (mat_entry(m, i, j) > enorm)
             {
-                enorm   = m->mat[i][j];
+                enorm   = mat_entry(m, i, j);
                 iswap   = i;
                 jswap   = j;
             }
@@ -200,7 +200,7 @@ void mc_optimize(FILE *log, t_mat *m, real *time,
     nn  = m->nn;
 
     /* Initiate and store global minimum */
-    minimum     = init_mat(nn, m->b1D);
+    minimum     = init_mat(nn);
     minimum->nn = nn;
     copy_t_mat(minimum, m);
 
@@ -275,7 +275,7 @@ void mc_optimize(FILE *log, t_mat *m, real *time,
         fprintf(log, "%10g  %5d  %10g\n",
                 time[m->m_ind[i]],
                 m->m_ind[i],
-                (i < m->nn-1) ? m->mat[m->m_ind[i]][m->m_ind[i+1]] : 0);
+                (i < m->nn-1) ? mat_entry(m, m->m_ind[i], m->m_ind[i+1]) : 0);
     }
 
     if (NULL != fp)
@@ -379,7 +379,7 @@ void gather(t_mat *m, real cutoff, t_clusters *clust)
         {
             d[k].i    = i;
             d[k].j    = j;
-            d[k].dist = m->mat[i][j];
+            d[k].dist = mat_entry(m, i, j);
         }
     }
     if (k != nn)
@@ -492,16 +492,18 @@ gmx_bool jp_same(int **nnb, int i, int j, int P)
     return (pp >= P);
 }
 
-static void jarvis_patrick(int n1, real **mat, int M, int P,
+static void jarvis_patrick(t_mat *m, int M, int P,
                            real rmsdcut, t_clusters *clust)
 {
     t_dist     *row;
     t_clustid  *c;
     int       **nnb;
-    int         i, j, k, cid, diff, max;
+    int         n1, i, j, k, cid, diff, max;
     gmx_bool    bChange;
     real      **mcpy = NULL;
 
+    n1 = m->nn;
+
     if (rmsdcut < 0)
     {
         rmsdcut = 10000;
@@ -517,14 +519,14 @@ static void jarvis_patrick(int n1, real **mat, int M, int P,
         for (j = 0; (j < n1); j++)
         {
             row[j].j    = j;
-            row[j].dist = mat[i][j];
+            row[j].dist = mat_entry(m, i, j);
         }
         qsort(row, n1, sizeof(row[0]), rms_dist_comp);
         if (M > 0)
         {
             /* Put the M nearest neighbors in the list */
             snew(nnb[i], M+1);
-            for (j = k = 0; (k < M) && (j < n1) && (mat[i][row[j].j] < rmsdcut); j++)
+            for (j = k = 0; (k < M) && (j < n1) && (mat_entry(m, i, row[j].j) < rmsdcut); j++)
             {
                 if (row[j].j  != i)
                 {
@@ -539,7 +541,7 @@ static void jarvis_patrick(int n1, real **mat, int M, int P,
             /* Put all neighbors nearer than rmsdcut in the list */
             max = 0;
             k   = 0;
-            for (j = 0; (j < n1) && (mat[i][row[j].j] < rmsdcut); j++)
+            for (j = 0; (j < n1) && (mat_entry(m, i, row[j].j) < rmsdcut); j++)
             {
                 if (row[j].j != i)
                 {
@@ -568,7 +570,7 @@ static void jarvis_patrick(int n1, real **mat, int M, int P,
             fprintf(debug, "i:%5d nbs:", i);
             for (j = 0; nnb[i][j] >= 0; j++)
             {
-                fprintf(debug, "%5d[%5.3f]", nnb[i][j], mat[i][nnb[i][j]]);
+                fprintf(debug, "%5d[%5.3f]", nnb[i][j], mat_entry(m, i, nnb[i][j]));
             }
             fprintf(debug, "\n");
         }
@@ -683,11 +685,13 @@ static void dump_nnb (FILE *fp, const char *title, int n1, t_nnb *nnb)
     }
 }
 
-static void gromos(int n1, real **mat, real rmsdcut, t_clusters *clust)
+static void gromos(t_mat *m, real rmsdcut, t_clusters *clust)
 {
     t_dist *row;
     t_nnb  *nnb;
-    int     i, j, k, j1, max;
+    int     n1, i, j, k, j1, max;
+
+    n1 = m->nn;
 
     /* Put all neighbors nearer than rmsdcut in the list */
     fprintf(stderr, "Making list of neighbors within cutoff ");
@@ -700,7 +704,7 @@ static void gromos(int n1, real **mat, real rmsdcut, t_clusters *clust)
         /* put all neighbors within cut-off in list */
         for (j = 0; j < n1; j++)
         {
-            if (mat[i][j] < rmsdcut)
+            if (mat_entry(m, i, j) < rmsdcut)
             {
                 if (k >= max)
                 {
@@ -1006,7 +1010,7 @@ static void ana_trans(t_clusters *clust, int nf,
     sfree(axis);
 }
 
-static void analyze_clusters(int nf, t_clusters *clust, real **rmsd,
+static void analyze_clusters(int nf, t_clusters *clust, t_mat *rmsd,
                              int natom, t_atoms *atoms, rvec *xtps,
                              real *mass, rvec **xx, real *time,
                              int ifsize, atom_id *fitidx,
@@ -1172,14 +1176,7 @@ static void analyze_clusters(int nf, t_clusters *clust, real **rmsd,
             {
                 for (i = 0; i < nstr; i++)
                 {
-                    if (i < i1)
-                    {
-                        r += rmsd[structure[i]][structure[i1]];
-                    }
-                    else
-                    {
-                        r += rmsd[structure[i1]][structure[i]];
-                    }
+                    r += mat_entry(rmsd, structure[i], structure[i1]);
                 }
                 r /= (nstr - 1);
             }
@@ -1252,7 +1249,7 @@ static void analyze_clusters(int nf, t_clusters *clust, real **rmsd,
                         {
                             if (bWrite[i1])
                             {
-                                bWrite[i] = rmsd[structure[i1]][structure[i]] > rmsmin;
+                                bWrite[i] = mat_entry(rmsd, structure[i1], structure[i]) > rmsmin;
                             }
                         }
                     }
@@ -1310,10 +1307,11 @@ static void analyze_clusters(int nf, t_clusters *clust, real **rmsd,
 
 static void convert_mat(t_matrix *mat, t_mat *rms)
 {
-    int i, j;
+    int    i, j;
+    real **full;
 
     rms->n1 = mat->nx;
-    matrix2real(mat, rms->mat);
+    full    = matrix2real(mat, NULL);
     /* free input xpm matrix data */
     for (i = 0; i < mat->nx; i++)
     {
@@ -1325,15 +1323,17 @@ static void convert_mat(t_matrix *mat, t_mat *rms)
     {
         for (j = i; j < mat->nx; j++)
         {
-            rms->sumrms += rms->mat[i][j];
-            rms->maxrms  = max(rms->maxrms, rms->mat[i][j]);
+            rms->sumrms += full[i][j];
+            rms->maxrms  = max(rms->maxrms, full[i][j]);
             if (j != i)
             {
-                rms->minrms = min(rms->minrms, rms->mat[i][j]);
+                rms->tri[TRI_INDEX(i, j)] = full[i][j];
+                rms->minrms               = min(rms->minrms, full[i][j]);
             }
         }
     }
     rms->nn = mat->nx;
+    done_matrix(mat->nx, &full);
 }
 
 int gmx_cluster(int argc, char *argv[])
@@ -1415,10 +1415,11 @@ int gmx_cluster(int argc, char *argv[])
     gmx_int64_t        nrms = 0;
 
     matrix             box;
-    rvec              *xtps, *usextps, *x1, **xx = NULL;
+    rvec              *xtps, *usextps, **xx = NULL;
     const char        *fn, *trx_out_fn;
     t_clusters         clust;
     t_mat             *rms, *orig = NULL;
+    real             **outmat = NULL, **origmat;
     real              *eigenvalues;
     t_topology         top;
     int                ePBC;
@@ -1429,7 +1430,7 @@ int gmx_cluster(int argc, char *argv[])
     int                isize = 0, ifsize = 0, iosize = 0;
     atom_id           *index = NULL, *fitidx, *outidx;
     char              *grpname;
-    real               rmsd, **d1, **d2, *time = NULL, time_invfac, *mass = NULL;
+    real             **d1, **d2, *time = NULL, time_invfac, *mass = NULL;
     char               buf[STRLEN], buf1[80], title[STRLEN];
     gmx_bool           bAnalyze, bUseRmsdCut, bJP_RMSD = FALSE, bReadMat, bReadTraj, bPBC = TRUE;
 
@@ -1739,39 +1740,19 @@ int gmx_cluster(int argc, char *argv[])
             time[i] *= time_invfac;
         }
 
-        rms = init_mat(readmat[0].nx, method == m_diagonalize);
+        rms = init_mat(readmat[0].nx);
         convert_mat(&(readmat[0]), rms);
 
         nlevels = readmat[0].nmap;
     }
     else   /* !bReadMat */
     {
-        rms  = init_mat(nf, method == m_diagonalize);
+        rms  = init_mat(nf);
         nrms = ((gmx_int64_t)nf*((gmx_int64_t)nf-1))/2;
         if (!bRMSdist)
         {
             fprintf(stderr, "Computing %dx%d RMS deviation matrix\n", nf, nf);
-            /* Initialize work array */
-            snew(x1, isize);
-            for (i1 = 0; i1 < nf; i1++)
-            {
-                for (i2 = i1+1; i2 < nf; i2++)
-                {
-                    for (i = 0; i < isize; i++)
-                    {
-                        copy_rvec(xx[i1][i], x1[i]);
-                    }
-                    if (bFit)
-                    {
-                        do_fit(isize, mass, xx[i2], x1);
-                    }
-                    rmsd = rmsdev(isize, mass, xx[i2], x1);
-                    set_mat_entry(rms, i1, i2, rmsd);
-                }
-                nrms -= (gmx_int64_t) (nf-i1-1);
-                fprintf(stderr, "\r# RMSD calculations left: " "%"GMX_PRId64 "   ", nrms);
-            }
-            sfree(x1);
+            calc_rmsd_matrix(nf, isize, xx, mass, bFit, rms);
         }
         else /* bRMSdist */
         {
@@ -1833,17 +1814,17 @@ int gmx_cluster(int argc, char *argv[])
 
     if (bBinary)
     {
-        for (i1 = 0; (i1 < nf); i1++)
+        for (i2 = 0; (i2 < nf); i2++)
         {
-            for (i2 = 0; (i2 < nf); i2++)
+            for (i1 = 0; (i1 < i2); i1++)
             {
-                if (rms->mat[i1][i2] < rmsdcut)
+                if (rms->tri[TRI_INDEX(i1, i2)] < rmsdcut)
                 {
-                    rms->mat[i1][i2] = 0;
+                    rms->tri[TRI_INDEX(i1, i2)] = 0;
                 }
                 else
                 {
-                    rms->mat[i1][i2] = 1;
+                    rms->tri[TRI_INDEX(i1, i2)] = 1;
                 }
             }
         }
@@ -1860,8 +1841,10 @@ int gmx_cluster(int argc, char *argv[])
             /* Do a diagonalization */
             snew(eigenvalues, nf);
             snew(eigenvectors, nf*nf);
-            memcpy(eigenvectors, rms->mat[0], nf*nf*sizeof(real));
-            eigensolver(eigenvectors, nf, 0, nf, eigenvalues, rms->mat[0]);
+            /* The eigenvectors are stored in the output matrix */
+            outmat = mat2real(rms, TRUE);
+            memcpy(eigenvectors, outmat[0], nf*nf*sizeof(real));
+            eigensolver(eigenvectors, nf, 0, nf, eigenvalues, outmat[0]);
             sfree(eigenvectors);
 
             fp = xvgropen(opt2fn("-ev", NFILE, fnm), "RMSD matrix Eigenvalues",
@@ -1873,37 +1856,45 @@ int gmx_cluster(int argc, char *argv[])
             gmx_ffclose(fp);
             break;
         case m_monte_carlo:
-            orig     = init_mat(rms->nn, FALSE);
+            orig     = init_mat(rms->nn);
             orig->nn = rms->nn;
             copy_t_mat(orig, rms);
             mc_optimize(log, rms, time, niter, nrandom, seed, kT,
                         opt2fn_null("-conv", NFILE, fnm), oenv);
             break;
         case m_jarvis_patrick:
-            jarvis_patrick(rms->nn, rms->mat, M, P, bJP_RMSD ? rmsdcut : -1, &clust);
+            jarvis_patrick(rms, M, P, bJP_RMSD ? rmsdcut : -1, &clust);
             break;
         case m_gromos:
-            gromos(rms->nn, rms->mat, rmsdcut, &clust);
+            gromos(rms, rmsdcut, &clust);
             break;
         default:
             gmx_fatal(FARGS, "DEATH HORROR unknown method \"%s\"", methodname[0]);
     }
 
-    if (method == m_monte_carlo || method == m_diagonalize)
+    if (method == m_monte_carlo)
     {
         fprintf(stderr, "Energy of the matrix after clustering is %g.\n",
                 mat_energy(rms));
     }
 
+    /* The output matrix has the RMSD in the upper triangle
+     * and the clusters in the lower triangle.
+     */
+    if (outmat == NULL)
+    {
+        outmat = mat2real(rms, FALSE);
+    }
+
     if (bAnalyze)
     {
         if (minstruct > 1)
         {
-            ncluster = plot_clusters(nf, rms->mat, &clust, minstruct);
+            ncluster = plot_clusters(nf, outmat, &clust, minstruct);
         }
         else
         {
-            mark_clusters(nf, rms->mat, rms->maxrms, &clust);
+            mark_clusters(nf, outmat, rms->maxrms, &clust);
         }
         init_t_atoms(&useatoms, isize, FALSE);
         snew(usextps, isize);
@@ -1916,7 +1907,7 @@ int gmx_cluster(int argc, char *argv[])
             copy_rvec(xtps[index[i]], usextps[i]);
         }
         useatoms.nr = isize;
-        analyze_clusters(nf, &clust, rms->mat, isize, &useatoms, usextps, mass, xx, time,
+        analyze_clusters(nf, &clust, rms, isize, &useatoms, usextps, mass, xx, time,
                          ifsize, fitidx, iosize, outidx,
                          bReadTraj ? trx_out_fn : NULL,
                          opt2fn_null("-sz", NFILE, fnm),
@@ -1935,9 +1926,9 @@ int gmx_cluster(int argc, char *argv[])
         {
             for (i1 = i2+1; (i1 < nf); i1++)
             {
-                if (rms->mat[i1][i2])
+                if (outmat[i1][i2])
                 {
-                    rms->mat[i1][i2] = rms->maxrms;
+                    outmat[i1][i2] = rms->maxrms;
                 }
             }
         }
@@ -1949,7 +1940,7 @@ int gmx_cluster(int argc, char *argv[])
     {
         write_xpm(fp, 0, readmat[0].title, readmat[0].legend, readmat[0].label_x,
                   readmat[0].label_y, nf, nf, readmat[0].axis_x, readmat[0].axis_y,
-                  rms->mat, 0.0, rms->maxrms, rlo_top, rhi_top, &nlevels);
+                  outmat, 0.0, rms->maxrms, rlo_top, rhi_top, &nlevels);
     }
     else
     {
@@ -1959,14 +1950,14 @@ int gmx_cluster(int argc, char *argv[])
         if (minstruct > 1)
         {
             write_xpm_split(fp, 0, title, "RMSD (nm)", buf, buf,
-                            nf, nf, time, time, rms->mat, 0.0, rms->maxrms, &nlevels,
+                            nf, nf, time, time, outmat, 0.0, rms->maxrms, &nlevels,
                             rlo_top, rhi_top, 0.0, (real) ncluster,
                             &ncluster, TRUE, rlo_bot, rhi_bot);
         }
         else
         {
             write_xpm(fp, 0, title, "RMSD (nm)", buf, buf,
-                      nf, nf, time, time, rms->mat, 0.0, rms->maxrms,
+                      nf, nf, time, time, outmat, 0.0, rms->maxrms,
                       rlo_top, rhi_top, &nlevels);
         }
     }
@@ -1974,16 +1965,29 @@ int gmx_cluster(int argc, char *argv[])
     gmx_ffclose(fp);
     if (NULL != orig)
     {
-        fp = opt2FILE("-om", NFILE, fnm, "w");
+        origmat = mat2real(orig, FALSE);
+        fp      = opt2FILE("-om", NFILE, fnm, "w");
         sprintf(buf, "Time (%s)", output_env_get_time_unit(oenv));
         sprintf(title, "RMS%sDeviation", bRMSdist ? " Distance " : " ");
         write_xpm(fp, 0, title, "RMSD (nm)", buf, buf,
-                  nf, nf, time, time, orig->mat, 0.0, orig->maxrms,
+                  nf, nf, time, time, origmat, 0.0, orig->maxrms,
                   rlo_top, rhi_top, &nlevels);
         gmx_ffclose(fp);
+        done_matrix(nf, &origmat);
         done_mat(&orig);
         sfree(orig);
     }
+    if (method == m_diagonalize)
+    {
+        /* The rows are stored contiguously */
+        sfree(outmat[0]);
+        sfree(outmat);
+    }
+    else
+    {
+        done_matrix(nf, &outmat);
+    }
+    done_mat(&rms);
     /* now show what we've done */
     do_view(oenv, opt2fn("-o", NFILE, fnm), "-nxy");
     do_view(oenv, opt2fn_null("-sz", NFILE, fnm), "-nxy");
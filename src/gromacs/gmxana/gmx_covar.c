@@ -54,13 +54,377 @@
 #include "gromacs/math/do_fit.h"
 #include "gromacs/math/vec.h"
 #include "gromacs/pbcutil/rmpbc.h"
+#include "gromacs/random/random.h"
+#include "gromacs/simd/simd.h"
 #include "gromacs/topology/index.h"
 #include "gromacs/utility/cstringutil.h"
 #include "gromacs/utility/fatalerror.h"
 #include "gromacs/utility/futil.h"
+#include "gromacs/utility/gmxomp.h"
 #include "gromacs/utility/smalloc.h"
 #include "gromacs/utility/sysinfo.h"
 
+/* Number of frames that are buffered and added to the covariance matrix
+ * together as one symmetric rank-k update.
+ */
+#define COVAR_BATCH  64
+/* Number of matrix elements of a row updated as one block, small enough
+ * for the block to stay in L1 cache while a whole batch is added to it.
+ */
+#define COVAR_BLOCK  512
+/* Extra vectors and number of iterations for the subspace iteration
+ * used with -ntop.
+ */
+#define COVAR_OVERSAMPLE     10
+#define COVAR_SUBSPACE_ITER  6
+
+#ifdef GMX_SIMD_HAVE_REAL
+#define COVAR_PADDING  GMX_SIMD_REAL_WIDTH
+#else
+#define COVAR_PADDING  1
+#endif
+
+/* Everything needed to read the trajectory and to turn each frame into
+ * the mass-weighted deviation vector of the analysis group.
+ */
+typedef struct {
+    const char   *trxfile;
+    output_env_t  oenv;
+    gmx_rmpbc_t   gpbc;      /* NULL without PBC treatment */
+    int           nfit;      /* 0 without fitting */
+    atom_id      *ifit;
+    real         *w_rls;
+    rvec         *xref;
+    int           natoms;
+    atom_id      *index;
+    rvec         *xdref;     /* Deviations are taken from this structure */
+    real         *sqrtm;
+    int           nframes_max;
+    int           ldim;      /* Padded row length of the frame buffer */
+    real         *xbuf;      /* COVAR_BATCH x ldim frame buffer */
+} t_covar_traj;
+
+/* Adds the outer products of the nb frames in xbuf to the upper triangle
+ * of mat, which has row length ldim. The rows are distributed over threads
+ * and each row is updated in blocks, so each element of mat is loaded and
+ * stored once per batch instead of once per frame.
+ */
+static void covar_rank_k_update(int nb, const real *xbuf, int ndim, int ldim,
+                                real *mat)
+{
+    int j;
+
+#pragma omp parallel for schedule(dynamic, COVAR_PADDING)
+    for (j = 0; j < ndim; j++)
+    {
+        real *row = mat + (gmx_int64_t)ldim*j;
+        int   ib, ie, b, i;
+
+        /* Start at the aligned element at or before the diagonal,
+         * the few elements below the diagonal are overwritten later.
+         */
+        for (ib = j - j % COVAR_PADDING; ib < ldim; ib += COVAR_BLOCK)
+        {
+            ie = min(ib + COVAR_BLOCK, ldim);
+            for (b = 0; b < nb; b++)
+            {
+                const real     *xb = xbuf + (gmx_int64_t)ldim*b;
+#ifdef GMX_SIMD_HAVE_REAL
+                gmx_simd_real_t xj = gmx_simd_set1_r(xb[j]);
+
+                for (i = ib; i < ie; i += GMX_SIMD_REAL_WIDTH)
+                {
+                    gmx_simd_store_r(row + i,
+                                     gmx_simd_fmadd_r(xj, gmx_simd_load_r(xb + i),
+                                                      gmx_simd_load_r(row + i)));
+                }
+#else
+                real            xj = xb[j];
+
+                for (i = ib; i < ie; i++)
+                {
+                    row[i] += xj*xb[i];
+                }
+#endif
+            }
+        }
+    }
+}
+
+/* Adds the product of the covariance (without normalization) of the nb
+ * frames in xbuf with the nvec column vectors of q to y.
+ */
+static void covar_subspace_product(int nb, const real *xbuf, int ndim, int ldim,
+                                   int nvec, const double *q, double *y)
+{
+    int c;
+
+#pragma omp parallel for schedule(static)
+    for (c = 0; c < nvec; c++)
+    {
+        const double *qc = q + (gmx_int64_t)ndim*c;
+        double       *yc = y + (gmx_int64_t)ndim*c;
+        double        p[COVAR_BATCH];
+        const real   *xb;
+        int           b, i;
+
+        for (b = 0; b < nb; b++)
+        {
+            xb   = xbuf + (gmx_int64_t)ldim*b;
+            p[b] = 0;
+            for (i = 0; i < ndim; i++)
+            {
+                p[b] += xb[i]*qc[i];
+            }
+        }
+        for (b = 0; b < nb; b++)
+        {
+            xb = xbuf + (gmx_int64_t)ldim*b;
+            for (i = 0; i < ndim; i++)
+            {
+                yc[i] += p[b]*xb[i];
+            }
+        }
+    }
+}
+
+/* Reads the whole trajectory once, buffers the deviation vectors and
+ * either adds them to the upper triangle of mat, when mat!=NULL, or
+ * adds the covariance times the nvec vectors q to y, when q!=NULL.
+ * The sum of squared deviations is added to *sumsq.
+ * Returns the number of frames read.
+ */
+static int covar_read_pass(t_covar_traj *ct, real *mat,
+                           int nvec, const double *q, double *y,
+                           double *sumsq, real *tstart, real *tend)
+{
+    t_trxstatus *status;
+    rvec        *xread;
+    matrix       box;
+    real         t, *xb;
+    int          ndim, nframes, nb, nat, i, d;
+    gmx_bool     bMore;
+
+    ndim    = ct->natoms*DIM;
+    nframes = 0;
+    nb      = 0;
+    nat     = read_first_x(ct->oenv, &status, ct->trxfile, &t, &xread, box);
+    *tstart = t;
+    do
+    {
+        nframes++;
+        *tend = t;
+        /* calculate x: a (fitted) structure of the selected atoms */
+        if (ct->gpbc)
+        {
+            gmx_rmpbc(ct->gpbc, nat, box, xread);
+        }
+        if (ct->nfit > 0)
+        {
+            reset_x(ct->nfit, ct->ifit, nat, NULL, xread, ct->w_rls);
+            do_fit(nat, ct->w_rls, ct->xref, xread);
+        }
+        xb = ct->xbuf + (gmx_int64_t)ct->ldim*nb;
+        for (i = 0; i < ct->natoms; i++)
+        {
+            for (d = 0; d < DIM; d++)
+            {
+                xb[DIM*i+d] = ct->sqrtm[i]*(xread[ct->index[i]][d] - ct->xdref[i][d]);
+                *sumsq     += xb[DIM*i+d]*xb[DIM*i+d];
+            }
+        }
+        nb++;
+
+        bMore = (read_next_x(ct->oenv, status, &t, xread, box) &&
+                 (ct->nframes_max < 0 || nframes < ct->nframes_max));
+        if (nb == COVAR_BATCH || !bMore)
+        {
+            if (mat)
+            {
+                covar_rank_k_update(nb, ct->xbuf, ndim, ct->ldim, mat);
+            }
+            if (q)
+            {
+                covar_subspace_product(nb, ct->xbuf, ndim, ct->ldim, nvec, q, y);
+            }
+            nb = 0;
+        }
+    }
+    while (bMore);
+    close_trj(status);
+    sfree(xread);
+
+    return nframes;
+}
+
+/* Fills v with n Gaussian random numbers. The numbers only depend on
+ * the seed and the counter ctr, so each call should use a new counter.
+ */
+static void covar_gaussian(int seed, gmx_int64_t ctr, gmx_int64_t n, double *v)
+{
+    real        rnd[6];
+    gmx_int64_t i, j;
+
+    for (i = 0; i < n; i += 6)
+    {
+        gmx_rng_cycle_6gaussian_table(ctr, i/6, seed, RND_SEED_COVAR, rnd);
+        for (j = 0; j < 6 && i + j < n; j++)
+        {
+            v[i+j] = rnd[j];
+        }
+    }
+}
+
+/* Orthonormalizes the nvec column vectors in q with two passes of modified
+ * Gram-Schmidt. Vectors that are (numerically) linearly dependent on the
+ * previous ones are replaced by random vectors, using and increasing
+ * the random counter *nrand.
+ */
+static void covar_orthonormalize(int ndim, int nvec, double *q,
+                                 int seed, gmx_int64_t *nrand)
+{
+    double *qc, *qp, dot, norm, norm0;
+    int     c, cp, pass, i;
+
+    for (c = 0; c < nvec; c++)
+    {
+        qc    = q + (gmx_int64_t)ndim*c;
+        norm0 = 0;
+        for (i = 0; i < ndim; i++)
+        {
+            norm0 += qc[i]*qc[i];
+        }
+        for (pass = 0; pass < 2; pass++)
+        {
+            for (cp = 0; cp < c; cp++)
+            {
+                qp  = q + (gmx_int64_t)ndim*cp;
+                dot = 0;
+                for (i = 0; i < ndim; i++)
+                {
+                    dot += qp[i]*qc[i];
+                }
+                for (i = 0; i < ndim; i++)
+                {
+                    qc[i] -= dot*qp[i];
+                }
+            }
+        }
+        norm = 0;
+        for (i = 0; i < ndim; i++)
+        {
+            norm += qc[i]*qc[i];
+        }
+        if (norm <= 1e-20*norm0 || norm == 0)
+        {
+            covar_gaussian(seed, (*nrand)++, ndim, qc);
+            /* Redo this vector */
+            c--;
+            continue;
+        }
+        norm = 1/sqrt(norm);
+        for (i = 0; i < ndim; i++)
+        {
+            qc[i] *= norm;
+        }
+    }
+}
+
+/* Determines the ntop largest eigenvalues and eigenvectors of the
+ * covariance matrix by randomized subspace iteration with Rayleigh-Ritz
+ * projection. The matrix is never formed: every iteration streams the
+ * trajectory once and only needs memory for nvec vectors of length ndim.
+ * The eigenvalues and eigenvectors are returned in decreasing order.
+ */
+static int covar_top_eigen(t_covar_traj *ct, int ntop, int nvec, int seed,
+                           real *eigenvalues, real *eigenvectors,
+                           real *trace, real *tstart, real *tend)
+{
+    gmx_int64_t nrand;
+    double     *q, *y, sumsq, inv_nframes, *qa, *yb;
+    real       *tmat, *teval, *tevec, *v;
+    int         ndim, nframes, iter, a, b, m, i;
+
+    ndim  = ct->natoms*DIM;
+    nrand = 0;
+    snew(q, (gmx_int64_t)ndim*nvec);
+    snew(y, (gmx_int64_t)ndim*nvec);
+    covar_gaussian(seed, nrand++, (gmx_int64_t)ndim*nvec, q);
+    covar_orthonormalize(ndim, nvec, q, seed, &nrand);
+
+    nframes = 0;
+    for (iter = 0; iter <= COVAR_SUBSPACE_ITER; iter++)
+    {
+        fprintf(stderr, "\rSubspace iteration %d of %d", iter + 1, COVAR_SUBSPACE_ITER + 1);
+        for (i = 0; i < ndim*nvec; i++)
+        {
+            y[i] = 0;
+        }
+        sumsq   = 0;
+        nframes = covar_read_pass(ct, NULL, nvec, q, y, &sumsq, tstart, tend);
+        if (iter < COVAR_SUBSPACE_ITER)
+        {
+            /* The next basis spans the product of the matrix with this one */
+            covar_orthonormalize(ndim, nvec, y, seed, &nrand);
+            for (i = 0; i < ndim*nvec; i++)
+            {
+                q[i] = y[i];
+            }
+        }
+    }
+    fprintf(stderr, "\n");
+    inv_nframes = 1.0/nframes;
+    *trace      = sumsq*inv_nframes;
+
+    /* Rayleigh-Ritz: diagonalize the projection of the matrix on q */
+    snew(tmat, nvec*nvec);
+    snew(teval, nvec);
+    snew(tevec, nvec*nvec);
+    for (a = 0; a < nvec; a++)
+    {
+        qa = q + (gmx_int64_t)ndim*a;
+        for (b = a; b < nvec; b++)
+        {
+            yb = y + (gmx_int64_t)ndim*b;
+            sumsq = 0;
+            for (i = 0; i < ndim; i++)
+            {
+                sumsq += qa[i]*yb[i];
+            }
+            tmat[a*nvec+b] = sumsq*inv_nframes;
+            tmat[b*nvec+a] = tmat[a*nvec+b];
+        }
+    }
+    eigensolver(tmat, nvec, 0, nvec, teval, tevec);
+
+    for (m = 0; m < ntop; m++)
+    {
+        eigenvalues[m] = teval[nvec-1-m];
+        v              = eigenvectors + (gmx_int64_t)ndim*m;
+        for (i = 0; i < ndim; i++)
+        {
+            v[i] = 0;
+        }
+        for (a = 0; a < nvec; a++)
+        {
+            qa    = q + (gmx_int64_t)ndim*a;
+            sumsq = tevec[(nvec-1-m)*nvec+a];
+            for (i = 0; i < ndim; i++)
+            {
+                v[i] += sumsq*qa[i];
+            }
+        }
+    }
+
+    sfree(tevec);
+    sfree(teval);
+    sfree(tmat);
+    sfree(y);
+    sfree(q);
+
+    return nframes;
+}
+
 int gmx_covar(int argc, char *argv[])
 {
     const char     *desc[] = {
@@ -94,10 +458,19 @@ int gmx_covar(int argc, char *argv[])
         "of atoms involved. It is easy to run out of memory, in which",
         "case this tool will probably exit with a 'Segmentation fault'. You",
         "should consider carefully whether a reduced set of atoms will meet",
-        "your needs for lower costs."
+        "your needs for lower costs.",
+        "[PAR]",
+        "With [TT]-ntop[tt] only the given number of largest eigenvalues and",
+        "their eigenvectors are computed, with randomized subspace iteration.",
+        "The covariance matrix is then never constructed: memory use is linear",
+        "in the number of atoms and the trajectory is read once per iteration",
+        "instead. The random start vectors are generated from [TT]-seed[tt],",
+        "so a run can be reproduced by giving the seed that was printed.",
+        "The options [TT]-ascii[tt], [TT]-xpm[tt] and [TT]-xpma[tt]",
+        "can not be used with [TT]-ntop[tt]."
     };
     static gmx_bool bFit = TRUE, bRef = FALSE, bM = FALSE, bPBC = TRUE;
-    static int      end  = -1;
+    static int      end  = -1, ntop = 0, seed = -1;
     t_pargs         pa[] = {
         { "-fit",  FALSE, etBOOL, {&bFit},
           "Fit to a reference structure"},
@@ -107,12 +480,16 @@ int gmx_covar(int argc, char *argv[])
           "Mass-weighted covariance analysis"},
         { "-last",  FALSE, etINT, {&end},
           "Last eigenvector to write away (-1 is till the last)" },
+        { "-ntop", FALSE, etINT, {&ntop},
+          "Only compute this many of the largest eigenvalues and eigenvectors, without constructing the covariance matrix (0 is all)" },
+        { "-seed", FALSE, etINT, {&seed},
+          "Random seed for [TT]-ntop[tt], -1 generates a seed from time and pid" },
         { "-pbc",  FALSE,  etBOOL, {&bPBC},
           "Apply corrections for periodic boundary conditions" }
     };
     FILE           *out = NULL; /* initialization makes all compilers happy */
     t_trxstatus    *status;
-    t_trxstatus    *trjout;
+    t_covar_traj    ct;
     t_topology      top;
     int             ePBC;
     t_atoms        *atoms;
@@ -120,19 +497,20 @@ int gmx_covar(int argc, char *argv[])
     matrix          box, zerobox;
     real           *sqrtm, *mat, *eigenvalues, sum, trace, inv_nframes;
     real            t, tstart, tend, **mat2;
-    real            xj, *w_rls = NULL;
+    real           *w_rls = NULL;
+    double          sumsq;
     real            min, max, *axis;
     int             ntopatoms, step;
     int             natoms, nat, count, nframes0, nframes, nlevels;
-    gmx_int64_t     ndim, i, j, k, l;
+    gmx_int64_t     ndim, ldim, nvec, i, j;
     int             WriteXref;
     const char     *fitfile, *trxfile, *ndxfile;
     const char     *eigvalfile, *eigvecfile, *averfile, *logfile;
     const char     *asciifile, *xpmfile, *xpmafile;
     char            str[STRLEN], *fitname, *ananame, *pcwd;
-    int             d, dj, nfit;
+    int             d, nfit;
     atom_id        *index, *ifit;
-    gmx_bool        bDiffMass1, bDiffMass2;
+    gmx_bool        bDiffMass1, bDiffMass2, bTop;
     char            timebuf[STRLEN];
     t_rgb           rlo, rmi, rhi;
     real           *eigenvectors;
@@ -171,6 +549,11 @@ int gmx_covar(int argc, char *argv[])
     asciifile  = opt2fn_null("-ascii", NFILE, fnm);
     xpmfile    = opt2fn_null("-xpm", NFILE, fnm);
     xpmafile   = opt2fn_null("-xpma", NFILE, fnm);
+    bTop       = (ntop > 0);
+    if (bTop && (asciifile || xpmfile || xpmafile))
+    {
+        gmx_fatal(FARGS, "Options -ascii, -xpm and -xpma require the full covariance matrix and can not be used with -ntop");
+    }
 
     read_tps_conf(fitfile, str, &top, &ePBC, &xref, NULL, box, TRUE);
     atoms = &top.atoms;
@@ -257,11 +640,17 @@ int gmx_covar(int argc, char *argv[])
     snew(x, natoms);
     snew(xav, natoms);
     ndim = natoms*DIM;
-    if (sqrt(GMX_INT64_MAX) < ndim)
+    if (!bTop && sqrt(GMX_INT64_MAX) < ndim)
     {
         gmx_fatal(FARGS, "Number of degrees of freedoms to large for matrix.\n");
     }
-    snew(mat, ndim*ndim);
+    /* Pad the rows for aligned SIMD access, the padding is removed after accumulation */
+    ldim = ((ndim + COVAR_PADDING - 1)/COVAR_PADDING)*COVAR_PADDING;
+    mat  = NULL;
+    if (!bTop)
+    {
+        snew_aligned(mat, ldim*ndim, 64);
+    }
 
     fprintf(stderr, "Calculating the average structure ...\n");
     nframes0 = 0;
@@ -304,59 +693,53 @@ int gmx_covar(int argc, char *argv[])
                            atoms, xread, NULL, epbcNONE, zerobox, natoms, index);
     sfree(xread);
 
-    fprintf(stderr, "Constructing covariance matrix (%dx%d) ...\n", (int)ndim, (int)ndim);
-    nframes = 0;
-    nat     = read_first_x(oenv, &status, trxfile, &t, &xread, box);
-    tstart  = t;
-    do
+    ct.trxfile     = trxfile;
+    ct.oenv        = oenv;
+    ct.gpbc        = gpbc;
+    ct.nfit        = nfit;
+    ct.ifit        = ifit;
+    ct.w_rls       = w_rls;
+    ct.xref        = xref;
+    ct.natoms      = natoms;
+    ct.index       = index;
+    ct.sqrtm       = sqrtm;
+    ct.nframes_max = bRef ? -1 : nframes0;
+    ct.ldim        = ldim;
+    snew(ct.xdref, natoms);
+    for (i = 0; i < natoms; i++)
     {
-        nframes++;
-        tend = t;
-        /* calculate x: a (fitted) structure of the selected atoms */
-        if (bPBC)
-        {
-            gmx_rmpbc(gpbc, nat, box, xread);
-        }
-        if (bFit)
-        {
-            reset_x(nfit, ifit, nat, NULL, xread, w_rls);
-            do_fit(nat, w_rls, xref, xread);
-        }
-        if (bRef)
-        {
-            for (i = 0; i < natoms; i++)
-            {
-                rvec_sub(xread[index[i]], xref[index[i]], x[i]);
-            }
-        }
-        else
-        {
-            for (i = 0; i < natoms; i++)
-            {
-                rvec_sub(xread[index[i]], xav[i], x[i]);
-            }
-        }
+        copy_rvec(bRef ? xref[index[i]] : xav[i], ct.xdref[i]);
+    }
+    snew_aligned(ct.xbuf, COVAR_BATCH*ldim, 64);
 
-        for (j = 0; j < natoms; j++)
+    nvec        = 0;
+    trace       = 0;
+    eigenvalues = NULL;
+    if (bTop)
+    {
+        /* The rank of the covariance matrix is at most the number of frames */
+        nvec = min(min(ntop + COVAR_OVERSAMPLE, ndim), nframes0);
+        ntop = min(ntop, nvec);
+        fprintf(stderr, "Computing the %d largest eigenvalues of the covariance matrix (%dx%d) ...\n",
+                ntop, (int)ndim, (int)ndim);
+        if (seed == -1)
         {
-            for (dj = 0; dj < DIM; dj++)
-            {
-                k  = ndim*(DIM*j+dj);
-                xj = x[j][dj];
-                for (i = j; i < natoms; i++)
-                {
-                    l = k+DIM*i;
-                    for (d = 0; d < DIM; d++)
-                    {
-                        mat[l+d] += x[i][d]*xj;
-                    }
-                }
-            }
+            seed = (int)gmx_rng_make_seed();
         }
+        fprintf(stderr, "Using random seed %d\n", seed);
+        snew(eigenvalues, ntop);
+        snew(mat, ntop*ndim);
+        nframes = covar_top_eigen(&ct, ntop, nvec, seed, eigenvalues, mat,
+                                  &trace, &tstart, &tend);
     }
-    while (read_next_x(oenv, status, &t, xread, box) &&
-           (bRef || nframes < nframes0));
-    close_trj(status);
+    else
+    {
+        fprintf(stderr, "Constructing covariance matrix (%dx%d) ...\n", (int)ndim, (int)ndim);
+        sumsq   = 0;
+        nframes = covar_read_pass(&ct, mat, 0, NULL, NULL, &sumsq, &tstart, &tend);
+    }
+    sfree_aligned(ct.xbuf);
+    sfree(ct.xdref);
     gmx_rmpbc_done(gpbc);
 
     fprintf(stderr, "Read %d frames\n", nframes);
@@ -375,36 +758,36 @@ int gmx_covar(int argc, char *argv[])
         xproj = xav;
     }
 
-    /* correct the covariance matrix for the mass */
-    inv_nframes = 1.0/nframes;
-    for (j = 0; j < natoms; j++)
+    if (!bTop)
     {
-        for (dj = 0; dj < DIM; dj++)
+        /* Remove the row padding, normalize and symmetrize the matrix.
+         * The deviations were already mass weighted.
+         */
+        inv_nframes = 1.0/nframes;
+        for (j = 0; j < ndim; j++)
         {
-            for (i = j; i < natoms; i++)
+            if (ldim != ndim && j > 0)
             {
-                k = ndim*(DIM*j+dj)+DIM*i;
-                for (d = 0; d < DIM; d++)
-                {
-                    mat[k+d] = mat[k+d]*inv_nframes*sqrtm[i]*sqrtm[j];
-                }
+                memmove(mat + ndim*j, mat + ldim*j, ndim*sizeof(real));
+            }
+            for (i = j; i < ndim; i++)
+            {
+                mat[ndim*j+i] *= inv_nframes;
             }
         }
-    }
-
-    /* symmetrize the matrix */
-    for (j = 0; j < ndim; j++)
-    {
-        for (i = j; i < ndim; i++)
+        for (j = 0; j < ndim; j++)
         {
-            mat[ndim*i+j] = mat[ndim*j+i];
+            for (i = j; i < ndim; i++)
+            {
+                mat[ndim*i+j] = mat[ndim*j+i];
+            }
         }
-    }
 
-    trace = 0;
-    for (i = 0; i < ndim; i++)
-    {
-        trace += mat[i*ndim+i];
+        trace = 0;
+        for (i = 0; i < ndim; i++)
+        {
+            trace += mat[i*ndim+i];
+        }
     }
     fprintf(stderr, "\nTrace of the covariance matrix: %g (%snm^2)\n",
             trace, bM ? "u " : "");
@@ -513,40 +896,50 @@ int gmx_covar(int argc, char *argv[])
     }
 
 
-    /* call diagonalization routine */
+    if (!bTop)
+    {
+        /* call diagonalization routine */
 
-    snew(eigenvalues, ndim);
-    snew(eigenvectors, ndim*ndim);
+        snew(eigenvalues, ndim);
+        snew(eigenvectors, ndim*ndim);
 
-    memcpy(eigenvectors, mat, ndim*ndim*sizeof(real));
-    fprintf(stderr, "\nDiagonalizing ...\n");
-    fflush(stderr);
-    eigensolver(eigenvectors, ndim, 0, ndim, eigenvalues, mat);
-    sfree(eigenvectors);
+        memcpy(eigenvectors, mat, ndim*ndim*sizeof(real));
+        fprintf(stderr, "\nDiagonalizing ...\n");
+        fflush(stderr);
+        eigensolver(eigenvectors, ndim, 0, ndim, eigenvalues, mat);
+        sfree(eigenvectors);
+    }
 
     /* now write the output */
 
     sum = 0;
-    for (i = 0; i < ndim; i++)
+    for (i = 0; i < (bTop ? ntop : ndim); i++)
     {
         sum += eigenvalues[i];
     }
-    fprintf(stderr, "\nSum of the eigenvalues: %g (%snm^2)\n",
-            sum, bM ? "u " : "");
-    if (fabs(trace-sum) > 0.01*trace)
+    fprintf(stderr, "\nSum of the %seigenvalues: %g (%snm^2)\n",
+            bTop ? "computed " : "", sum, bM ? "u " : "");
+    if (!bTop && fabs(trace-sum) > 0.01*trace)
     {
         fprintf(stderr, "\nWARNING: eigenvalue sum deviates from the trace of the covariance matrix\n");
     }
 
     /* Set 'end', the maximum eigenvector and -value index used for output */
-    if (end == -1)
+    if (bTop)
+    {
+        if (end == -1 || end > ntop)
+        {
+            end = ntop;
+        }
+    }
+    else if (end == -1)
     {
         if (nframes-1 < ndim)
         {
             end = nframes-1;
-            fprintf(out, "WARNING: there are fewer frames in your trajectory than there are\n");
-            fprintf(out, "degrees of freedom in your system. Only generating the first\n");
-            fprintf(out, "%d out of %d eigenvectors and eigenvalues.\n", end, (int)ndim);
+            fprintf(stderr, "WARNING: there are fewer frames in your trajectory than there are\n");
+            fprintf(stderr, "degrees of freedom in your system. Only generating the first\n");
+            fprintf(stderr, "%d out of %d eigenvectors and eigenvalues.\n", end, (int)ndim);
         }
         else
         {
@@ -562,7 +955,7 @@ int gmx_covar(int argc, char *argv[])
                    "Eigenvector index", str, oenv);
     for (i = 0; (i < end); i++)
     {
-        fprintf (out, "%10d %g\n", (int)i+1, eigenvalues[ndim-1-i]);
+        fprintf (out, "%10d %g\n", (int)i+1, bTop ? eigenvalues[i] : eigenvalues[ndim-1-i]);
     }
     gmx_ffclose(out);
 
@@ -588,7 +981,8 @@ int gmx_covar(int argc, char *argv[])
         WriteXref = eWXR_NOFIT;
     }
 
-    write_eigenvectors(eigvecfile, natoms, mat, TRUE, 1, end,
+    /* With -ntop the eigenvectors are stored in decreasing order */
+    write_eigenvectors(eigvecfile, natoms, mat, !bTop, 1, end,
                        WriteXref, x, bDiffMass1, xproj, bM, eigenvalues);
 
     out = gmx_ffopen(logfile, "w");
@@ -627,11 +1021,23 @@ int gmx_covar(int argc, char *argv[])
     {
         fprintf(out, "Fit is %smass weighted\n", bDiffMass1 ? "" : "non-");
     }
-    fprintf(out, "Diagonalized the %dx%d covariance matrix\n", (int)ndim, (int)ndim);
-    fprintf(out, "Trace of the covariance matrix before diagonalizing: %g\n",
-            trace);
-    fprintf(out, "Trace of the covariance matrix after diagonalizing: %g\n\n",
-            sum);
+    if (bTop)
+    {
+        fprintf(out, "Computed the %d largest eigenvalues of the %dx%d covariance matrix\n"
+                "with %d iterations of a %d-dimensional subspace, random seed %d\n",
+                ntop, (int)ndim, (int)ndim, COVAR_SUBSPACE_ITER + 1, (int)nvec, seed);
+        fprintf(out, "Trace of the covariance matrix: %g\n", trace);
+        fprintf(out, "Sum of the computed eigenvalues: %g (%.1f%% of the trace)\n\n",
+                sum, trace > 0 ? 100*sum/trace : 0);
+    }
+    else
+    {
+        fprintf(out, "Diagonalized the %dx%d covariance matrix\n", (int)ndim, (int)ndim);
+        fprintf(out, "Trace of the covariance matrix before diagonalizing: %g\n",
+                trace);
+        fprintf(out, "Trace of the covariance matrix after diagonalizing: %g\n\n",
+                sum);
+    }
 
     fprintf(out, "Wrote %d eigenvalues to %s\n", (int)end, eigvalfile);
     if (WriteXref == eWXR_YES)
@@ -40,6 +40,7 @@
 #include <string.h>
 
 #include "gromacs/commandline/pargs.h"
+#include "gromacs/correlationfunctions/manyautocorrelation.h"
 #include "gromacs/fileio/confio.h"
 #include "gromacs/fileio/tpxio.h"
 #include "gromacs/fileio/trxio.h"
@@ -56,6 +57,7 @@
 #include "gromacs/topology/index.h"
 #include "gromacs/utility/fatalerror.h"
 #include "gromacs/utility/futil.h"
+#include "gromacs/utility/gmxomp.h"
 #include "gromacs/utility/smalloc.h"
 
 #define FACTOR  1000.0  /* Convert nm^2/ps to 10e-5 cm^2/s */
@@ -872,12 +874,339 @@ static void index_atom2mol(int *n, int *index, t_block *mols)
     *n = nmol;
 }
 
+/* Maximum number of reals in the FFT work arrays of msd_fft_block,
+ * the particles are processed in chunks to stay below this.
+ */
+#define MSD_FFT_MAXREALS  (1<<24)
+
+/* Adds the squared displacements summed over the time origins in the first
+ * nh frames of the buffer xbuf to msd[m], for lags m = 0..nlag-1.
+ * xbuf holds nb frames of nx particles, frame after frame.
+ * Uses |x(k+m) - x(k)|^2 = x(k)^2 + x(k+m)^2 - 2 x(k).x(k+m).
+ * The sums of x(k)^2 are taken from prefix sums. The sums of x(k).x(k+m)
+ * are the autocorrelation over the whole buffer minus the autocorrelation
+ * of the frames after the origins, both computed with FFTs.
+ */
+static void msd_fft_block(t_corr *curr, int nx, atom_id index[], gmx_bool bMW,
+                          int nb, int nh, int nlag, const rvec xbuf[],
+                          double msd[])
+{
+    int      dims[DIM], ndim, m, nfft, nchunk, i0, f, nthreads;
+    real   **cbuf, **ctail;
+    double  *mean, *acc;
+
+    ndim = 0;
+    for (m = 0; m < DIM; m++)
+    {
+        if ((curr->type == NORMAL) ||
+            (curr->type == LATERAL && m != curr->axis) ||
+            (curr->type - X == m))
+        {
+            dims[ndim++] = m;
+        }
+    }
+
+    /* Avoid wrap-around for the lags we use */
+    nfft = 1;
+    while (nfft < nb + nlag)
+    {
+        nfft *= 2;
+    }
+    nthreads = gmx_omp_get_max_threads();
+    nchunk   = max(nthreads, MSD_FFT_MAXREALS/(2*ndim*nfft));
+    nchunk   = min(nchunk, nx);
+
+    snew(cbuf, nchunk*ndim);
+    snew(ctail, nchunk*ndim);
+    for (i0 = 0; i0 < nchunk*ndim; i0++)
+    {
+        snew(cbuf[i0], nfft);
+        snew(ctail[i0], nfft);
+    }
+    snew(mean, nchunk*ndim);
+    snew(acc, nthreads*nlag);
+
+    for (i0 = 0; i0 < nx; i0 += nchunk)
+    {
+        int nc = min(nchunk, nx - i0);
+
+        /* Subtract the mean position in the buffer, which reduces the
+         * cancellation in x(k)^2 + x(k+m)^2 - 2 x(k).x(k+m).
+         */
+#pragma omp parallel for num_threads(nthreads) schedule(static)
+        for (f = 0; f < nc*ndim; f++)
+        {
+            int    i = i0 + f/ndim, d = dims[f % ndim], k;
+            double sum = 0;
+
+            for (k = 0; k < nb; k++)
+            {
+                sum += xbuf[k*nx + i][d];
+            }
+            mean[f] = sum/nb;
+            for (k = 0; k < nb; k++)
+            {
+                cbuf[f][k] = xbuf[k*nx + i][d] - mean[f];
+            }
+            for (k = nh; k < nb; k++)
+            {
+                ctail[f][k - nh] = cbuf[f][k];
+            }
+        }
+        many_auto_correl(nc*ndim, nb, nfft, cbuf);
+        if (nb > nh)
+        {
+            many_auto_correl(nc*ndim, nb - nh, nfft, ctail);
+        }
+
+#pragma omp parallel num_threads(nthreads)
+        {
+            double *tacc = acc + gmx_omp_get_thread_num()*nlag;
+            double *psum;
+            int     ii;
+
+            snew(psum, nb + 1);
+#pragma omp for schedule(static)
+            for (ii = 0; ii < nc; ii++)
+            {
+                int    i = i0 + ii, dd, k, mm;
+                double w, s1, s2;
+
+                w = bMW ? curr->mass[index[i]] : 1;
+                if (w == 0)
+                {
+                    continue;
+                }
+                /* Prefix sums of the squared positions */
+                psum[0] = 0;
+                for (k = 0; k < nb; k++)
+                {
+                    double r2 = 0;
+                    for (dd = 0; dd < ndim; dd++)
+                    {
+                        double r = xbuf[k*nx + i][dims[dd]] - mean[ii*ndim + dd];
+                        r2 += r*r;
+                    }
+                    psum[k + 1] = psum[k] + r2;
+                }
+                for (mm = 0; mm < nlag; mm++)
+                {
+                    /* Number of origins with lag mm in this buffer */
+                    int norig = min(nh, nb - mm);
+
+                    s1 = psum[norig] + psum[mm + norig] - psum[mm];
+                    s2 = 0;
+                    for (dd = 0; dd < ndim; dd++)
+                    {
+                        /* many_auto_correl normalizes by the data length */
+                        s2 += (double)cbuf[ii*ndim + dd][mm]*nb;
+                        if (mm < nb - nh)
+                        {
+                            s2 -= (double)ctail[ii*ndim + dd][mm]*(nb - nh);
+                        }
+                    }
+                    tacc[mm] += w*(s1 - 2*s2);
+                }
+            }
+            sfree(psum);
+        }
+    }
+
+    for (i0 = 0; i0 < nthreads; i0++)
+    {
+        for (m = 0; m < nlag; m++)
+        {
+            msd[m] += acc[i0*nlag + m];
+        }
+    }
+    for (i0 = 0; i0 < nchunk*ndim; i0++)
+    {
+        sfree(cbuf[i0]);
+        sfree(ctail[i0]);
+    }
+    sfree(cbuf);
+    sfree(ctail);
+    sfree(mean);
+    sfree(acc);
+}
+
+/* The FFT-based counterpart of corr_loop: the MSD is computed for all time
+ * origins. The frames are kept in a buffer of two windows of maxlag; each
+ * time the buffer is full, the origins in the first window are processed
+ * and the buffer is shifted by one window. With maxlag <= 0 the whole
+ * trajectory is kept in memory.
+ */
+static int corr_loop_fft(t_corr *curr, const char *fn, t_topology *top,
+                         int gnx[], atom_id *index[], gmx_bool bMW,
+                         int *gnx_com, atom_id *index_com[], real maxlag,
+                         const output_env_t oenv)
+{
+    rvec         *x[2];
+    rvec          com = {0};
+    real          t;
+    int           natoms, g, i, m, cur = 0, maxframes = 0;
+    int           nwindow = 0, nb = 0, nb_alloc = 0, nlag_alloc = 0, nlag, nh;
+    t_trxstatus  *status;
+    matrix        box;
+    rvec        **xbuf;
+    double      **msd, *wtot;
+    int          *norigin = NULL;
+    gmx_bool      bEOF;
+
+    natoms = read_first_x(oenv, &status, fn, &curr->t0, &(x[cur]), box);
+    if ((gnx_com != NULL) && natoms < top->atoms.nr)
+    {
+        fprintf(stderr, "WARNING: The trajectory only contains part of the system (%d of %d atoms) and therefore the COM motion of only this part of the system will be removed\n", natoms, top->atoms.nr);
+    }
+    snew(x[prev], natoms);
+    /* for the first frame, the previous frame is a copy of the first frame */
+    memcpy(x[prev], x[cur], natoms*sizeof(x[prev][0]));
+    curr->ncoords = natoms;
+
+    snew(xbuf, curr->ngrp);
+    snew(msd, curr->ngrp);
+    snew(wtot, curr->ngrp);
+    for (g = 0; g < curr->ngrp; g++)
+    {
+        for (i = 0; i < gnx[g]; i++)
+        {
+            wtot[g] += bMW ? curr->mass[index[g][i]] : 1;
+        }
+    }
+
+    t    = curr->t0;
+    bEOF = FALSE;
+    do
+    {
+        if (!bEOF)
+        {
+            if (curr->nframes >= maxframes)
+            {
+                maxframes += 100;
+                srenew(curr->time, maxframes);
+            }
+            curr->time[curr->nframes] = t - curr->t0;
+            if (maxlag > 0 && nwindow == 0 && curr->nframes == 1)
+            {
+                if (curr->time[1] <= 0)
+                {
+                    gmx_fatal(FARGS, "With -maxlag the frame times should increase, but the first two frames have times %g and %g", curr->t0, t);
+                }
+                nwindow = max(2, (int)(maxlag/curr->time[1] + 0.5) + 1);
+            }
+
+            /* remove the periodic boundary condition crossings */
+            for (g = 0; g < curr->ngrp; g++)
+            {
+                prep_data(FALSE, gnx[g], index[g], x[cur], x[prev], box);
+            }
+            if (gnx_com)
+            {
+                prep_data(FALSE, gnx_com[0], index_com[0], x[cur], x[prev], box);
+                calc_com(FALSE, gnx_com[0], index_com[0], x[cur], x[prev], box,
+                         &top->atoms, com);
+            }
+
+            if (nb >= nb_alloc)
+            {
+                nb_alloc = max(nb_alloc + 100, nwindow > 0 ? 2*nwindow : 0);
+                for (g = 0; g < curr->ngrp; g++)
+                {
+                    srenew(xbuf[g], nb_alloc*gnx[g]);
+                }
+            }
+            for (g = 0; g < curr->ngrp; g++)
+            {
+                for (i = 0; i < gnx[g]; i++)
+                {
+                    rvec_sub(x[cur][index[g][i]], com, xbuf[g][nb*gnx[g] + i]);
+                }
+            }
+            nb++;
+            cur = prev;
+            curr->nframes++;
+
+            bEOF = !read_next_x(oenv, status, &t, x[cur], box);
+        }
+
+        /* Process the first window when the buffer is full,
+         * at the end process everything that is left.
+         */
+        if ((nwindow > 0 && nb == 2*nwindow) || (bEOF && nb > 0))
+        {
+            nh   = (nwindow > 0) ? min(nwindow, nb) : nb;
+            nlag = (nwindow > 0) ? min(nwindow, nb) : nb;
+            if (nlag > nlag_alloc)
+            {
+                srenew(norigin, nlag);
+                for (m = nlag_alloc; m < nlag; m++)
+                {
+                    norigin[m] = 0;
+                }
+                for (g = 0; g < curr->ngrp; g++)
+                {
+                    srenew(msd[g], nlag);
+                    for (m = nlag_alloc; m < nlag; m++)
+                    {
+                        msd[g][m] = 0;
+                    }
+                }
+                nlag_alloc = nlag;
+            }
+            for (m = 0; m < nlag; m++)
+            {
+                norigin[m] += min(nh, nb - m);
+            }
+            for (g = 0; g < curr->ngrp; g++)
+            {
+                msd_fft_block(curr, gnx[g], index[g], bMW, nb, nh, nlag,
+                              xbuf[g], msd[g]);
+                memmove(xbuf[g], xbuf[g] + nh*gnx[g],
+                        (nb - nh)*gnx[g]*sizeof(xbuf[g][0]));
+            }
+            nb -= nh;
+        }
+    }
+    while (!bEOF || nb > 0);
+    close_trj(status);
+
+    fprintf(stderr, "\nUsed all %d frames as time origins, for lags up to %g %s\n\n",
+            curr->nframes,
+            output_env_conv_time(oenv, curr->time[nlag_alloc-1]),
+            output_env_get_time_unit(oenv));
+
+    /* Store the sums and counts, do_corr divides them */
+    curr->nrestart = curr->nframes;
+    curr->nframes  = nlag_alloc;
+    for (g = 0; g < curr->ngrp; g++)
+    {
+        snew(curr->data[g], nlag_alloc);
+        snew(curr->ndata[g], nlag_alloc);
+        for (m = 0; m < nlag_alloc; m++)
+        {
+            curr->data[g][m]  = msd[g][m]/wtot[g];
+            curr->ndata[g][m] = norigin[m];
+        }
+        sfree(msd[g]);
+        sfree(xbuf[g]);
+    }
+    sfree(msd);
+    sfree(xbuf);
+    sfree(wtot);
+    sfree(norigin);
+    sfree(x[0]);
+    sfree(x[1]);
+
+    return natoms;
+}
+
 void do_corr(const char *trx_file, const char *ndx_file, const char *msd_file,
              const char *mol_file, const char *pdb_file, real t_pdb,
              int nrgrp, t_topology *top, int ePBC,
              gmx_bool bTen, gmx_bool bMW, gmx_bool bRmCOMM,
              int type, real dim_factor, int axis,
-             real dt, real beginfit, real endfit, const output_env_t oenv)
+             real dt, gmx_bool bFFT, real maxlag,
+             real beginfit, real endfit, const output_env_t oenv)
 {
     t_corr        *msd;
     int           *gnx;   /* the selected groups' sizes */
@@ -917,11 +1246,19 @@ void do_corr(const char *trx_file, const char *ndx_file, const char *msd_file,
                     mol_file == NULL ? 0 : gnx[0], bTen, bMW, dt, top,
                     beginfit, endfit);
 
-    nat_trx =
-        corr_loop(msd, trx_file, top, ePBC, mol_file ? gnx[0] : 0, gnx, index,
-                  (mol_file != NULL) ? calc1_mol : (bMW ? calc1_mw : calc1_norm),
-                  bTen, gnx_com, index_com, dt, t_pdb,
-                  pdb_file ? &x : NULL, box, oenv);
+    if (bFFT)
+    {
+        nat_trx = corr_loop_fft(msd, trx_file, top, gnx, index, bMW,
+                                gnx_com, index_com, maxlag, oenv);
+    }
+    else
+    {
+        nat_trx =
+            corr_loop(msd, trx_file, top, ePBC, mol_file ? gnx[0] : 0, gnx, index,
+                      (mol_file != NULL) ? calc1_mol : (bMW ? calc1_mw : calc1_norm),
+                      bTen, gnx_com, index_com, dt, t_pdb,
+                      pdb_file ? &x : NULL, box, oenv);
+    }
 
     /* Correct for the number of points */
     for (j = 0; (j < msd->ngrp); j++)
@@ -1068,7 +1405,14 @@ int gmx_msd(int argc, char *argv[])
         "Option [TT]-pdb[tt] writes a [TT].pdb[tt] file with the coordinates of the frame",
         "at time [TT]-tpdb[tt] with in the B-factor field the square root of",
         "the diffusion coefficient of the molecule.",
-        "This option implies option [TT]-mol[tt]."
+        "This option implies option [TT]-mol[tt].[PAR]",
+        "With [TT]-fft[tt], the MSD is computed for all time origins,",
+        "independent of [TT]-trestart[tt], from autocorrelations computed with",
+        "FFTs. The cost then scales as N log N with the number of frames",
+        "instead of with frames times restarts. [TT]-maxlag[tt] sets the",
+        "longest lag time; only two windows of this length are kept in memory,",
+        "otherwise the whole trajectory is. This option does not support",
+        "[TT]-ten[tt] or [TT]-mol[tt], and assumes equidistant frames."
     };
     static const char *normtype[] = { NULL, "no", "x", "y", "z", NULL };
     static const char *axtitle[]  = { NULL, "no", "x", "y", "z", NULL };
@@ -1080,6 +1424,8 @@ int gmx_msd(int argc, char *argv[])
     static gmx_bool    bTen       = FALSE;
     static gmx_bool    bMW        = TRUE;
     static gmx_bool    bRmCOMM    = FALSE;
+    static gmx_bool    bFFT       = FALSE;
+    static real        maxlag     = -1;
     t_pargs            pa[]       = {
         { "-type",    FALSE, etENUM, {normtype},
           "Compute diffusion coefficient in one direction" },
@@ -1097,6 +1443,10 @@ int gmx_msd(int argc, char *argv[])
           "The frame to use for option [TT]-pdb[tt] (%t)" },
         { "-trestart", FALSE, etTIME, {&dt},
           "Time between restarting points in trajectory (%t)" },
+        { "-fft", FALSE, etBOOL, {&bFFT},
+          "Use FFTs to compute the MSD over all time origins" },
+        { "-maxlag", FALSE, etTIME, {&maxlag},
+          "Maximum lag time with [TT]-fft[tt] (%t), -1 is the whole trajectory" },
         { "-beginfit", FALSE, etTIME, {&beginfit},
           "Start time for fitting the MSD (%t), -1 is 10%" },
         { "-endfit", FALSE, etTIME, {&endfit},
@@ -1186,6 +1536,10 @@ int gmx_msd(int argc, char *argv[])
     {
         gmx_fatal(FARGS, "Can only calculate the full tensor for 3D msd");
     }
+    if (bFFT && (bTen || mol_file))
+    {
+        gmx_fatal(FARGS, "Options -ten and -mol are not supported with -fft");
+    }
 
     bTop = read_tps_conf(tps_file, title, &top, &ePBC, &xdum, NULL, box, bMW || bRmCOMM);
     if (mol_file && !bTop)
@@ -1196,8 +1550,8 @@ int gmx_msd(int argc, char *argv[])
     }
 
     do_corr(trx_file, ndx_file, msd_file, mol_file, pdb_file, t_pdb, ngroup,
-            &top, ePBC, bTen, bMW, bRmCOMM, type, dim_factor, axis, dt, beginfit, endfit,
-            oenv);
+            &top, ePBC, bTen, bMW, bRmCOMM, type, dim_factor, axis, dt,
+            bFFT, maxlag, beginfit, endfit, oenv);
 
     view_all(oenv, NFILE, fnm);
 
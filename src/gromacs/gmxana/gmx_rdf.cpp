@@ -39,6 +39,8 @@
 
 #include <math.h>
 
+#include <algorithm>
+
 #include "gromacs/commandline/pargs.h"
 #include "gromacs/correlationfunctions/integrate.h"
 #include "gromacs/fileio/tpxio.h"
@@ -54,9 +56,14 @@
 #include "gromacs/math/vec.h"
 #include "gromacs/pbcutil/pbc.h"
 #include "gromacs/pbcutil/rmpbc.h"
+#include "gromacs/selection/nbsearch.h"
 #include "gromacs/topology/index.h"
+#include "gromacs/utility/arrayref.h"
+#include "gromacs/utility/exceptions.h"
 #include "gromacs/utility/fatalerror.h"
 #include "gromacs/utility/futil.h"
+#include "gromacs/utility/gmxomp.h"
+#include "gromacs/utility/real.h"
 #include "gromacs/utility/smalloc.h"
 
 static void check_box_c(matrix box)
@@ -171,39 +178,137 @@ static void split_group(int isize, int *index, char *grpname,
     *coi_out = coi;
 }
 
+/* Number of test positions handled per pair search */
+#define RDF_BLOCKSIZE 256
+
+/* Histograms the distances between the n positions in x and the reference
+ * positions of search, counting the distances in (cut2, rmax2].
+ * The positions are divided in blocks over the threads, each thread
+ * adds to its own histogram tcount[thread].
+ * ids are the atom numbers for the topology exclusions, can be NULL.
+ * When refmol!=NULL, only the shortest distance to each reference
+ * molecule/residue refmol[refIndex] is used. This uses tmind2 and tmol
+ * as per-thread work arrays of length nrefmol, tmind2 should be
+ * initialized to GMX_REAL_MAX.
+ */
+static void rdf_count_pairs(const gmx::AnalysisNeighborhoodSearch &search,
+                            int n, rvec x[], const atom_id *ids,
+                            const int *refmol, real **tmind2, int **tmol,
+                            real cut2, real rmax2, real invhbinw,
+                            int nthreads, int **tcount)
+{
+    int nblock, b;
+
+    nblock = (n + RDF_BLOCKSIZE - 1)/RDF_BLOCKSIZE;
+#pragma omp parallel for num_threads(nthreads) schedule(dynamic)
+    for (b = 0; b < nblock; b++)
+    {
+        try
+        {
+            int  *count, *mol;
+            int   thread, j0, j1, jcur, nmol, m, k;
+            real *mind2, r2;
+            bool  bFound;
+
+            thread = gmx_omp_get_thread_num();
+            count  = tcount[thread];
+            j0     = b*RDF_BLOCKSIZE;
+            j1     = std::min(n, j0 + RDF_BLOCKSIZE);
+
+            gmx::AnalysisNeighborhoodPositions pos(x + j0, j1 - j0);
+            if (ids != NULL)
+            {
+                pos.exclusionIds(gmx::ConstArrayRef<int>(ids + j0, ids + j1));
+            }
+            gmx::AnalysisNeighborhoodPairSearch pairSearch = search.startPairSearch(pos);
+            gmx::AnalysisNeighborhoodPair       pair;
+
+            if (refmol == NULL)
+            {
+                while (pairSearch.findNextPair(&pair))
+                {
+                    r2 = pair.distance2();
+                    if (r2 > cut2 && r2 <= rmax2)
+                    {
+                        count[(int)(sqrt(r2)*invhbinw)]++;
+                    }
+                }
+            }
+            else
+            {
+                /* The pairs are returned ordered by test position,
+                 * so we can histogram the minimum distances to the
+                 * reference molecules when the test position changes.
+                 */
+                mind2 = tmind2[thread];
+                mol   = tmol[thread];
+                nmol  = 0;
+                jcur  = -1;
+                do
+                {
+                    bFound = pairSearch.findNextPair(&pair);
+                    if (!bFound || pair.testIndex() != jcur)
+                    {
+                        for (k = 0; k < nmol; k++)
+                        {
+                            r2 = mind2[mol[k]];
+                            if (r2 > cut2 && r2 <= rmax2)
+                            {
+                                count[(int)(sqrt(r2)*invhbinw)]++;
+                            }
+                            mind2[mol[k]] = GMX_REAL_MAX;
+                        }
+                        nmol = 0;
+                        jcur = pair.testIndex();
+                    }
+                    if (bFound)
+                    {
+                        m = refmol[pair.refIndex()];
+                        if (mind2[m] == GMX_REAL_MAX)
+                        {
+                            mol[nmol++] = m;
+                        }
+                        mind2[m] = std::min(mind2[m], pair.distance2());
+                    }
+                }
+                while (bFound);
+            }
+        }
+        GMX_CATCH_ALL_AND_EXIT_WITH_FATAL_ERROR;
+    }
+}
+
 static void do_rdf(const char *fnNDX, const char *fnTPS, const char *fnTRX,
                    const char *fnRDF, const char *fnCNRDF, const char *fnHQ,
                    gmx_bool bCM, const char *close,
                    const char **rdft, gmx_bool bXY, gmx_bool bPBC, gmx_bool bNormalize,
-                   real cutoff, real binwidth, real fade, int ng,
+                   real cutoff, real rmax, real binwidth, real fade, int ng,
                    const output_env_t oenv)
 {
     FILE          *fp;
     t_trxstatus   *status;
-    char           outf1[STRLEN], outf2[STRLEN];
     char           title[STRLEN], gtitle[STRLEN], refgt[30];
-    int            g, natoms, i, ii, j, k, nbin, j0, j1, n, nframes;
-    int          **count;
+    int            g, natoms, i, ii, j, nbin, nframes, nthreads;
+    int          **count, ***tcount;
     char         **grpname;
-    int           *isize, isize_cm = 0, nrdf = 0, max_i, isize0, isize_g;
-    atom_id      **index, *index_cm = NULL;
+    int           *isize, nrdf = 0, max_i, isize0, isize_g;
+    atom_id      **index, *refindex;
     gmx_int64_t   *sum;
-    real           t, rmax2, cut2, r, r2, r2ii, invhbinw, normfac;
+    real           t, rmax2, cut2, r, invhbinw, normfac;
     real           segvol, spherevol, prev_spherevol, **rdf;
-    rvec          *x, dx, *x0 = NULL, *x_i1, xi;
+    rvec          *x, *x0 = NULL, *x_i1;
     real          *inv_segvol, invvol, invvol_sum, rho;
-    gmx_bool       bClose, *bExcl, bTop, bNonSelfExcl;
+    gmx_bool       bClose, bExcl, bTop;
     matrix         box, box_pbc;
-    int          **npairs;
-    atom_id        ix, jx, ***pairs;
     t_topology    *top  = NULL;
     int            ePBC = -1, ePBCrdf = -1;
-    t_block       *mols = NULL;
     t_blocka      *excl;
     t_atom        *atom = NULL;
     t_pbc          pbc;
     gmx_rmpbc_t    gpbc = NULL;
-    int           *is   = NULL, **coi = NULL, cur, mol, i1, res, a;
+    int           *is   = NULL, **coi = NULL;
+    int           *refmol = NULL, **tmol = NULL;
+    real         **tmind2 = NULL;
 
     excl = NULL;
 
@@ -261,12 +366,10 @@ static void do_rdf(const char *fnNDX, const char *fnTPS, const char *fnTRX,
         coi[0][0] = 0;
         coi[0][1] = isize[0];
         isize0    = is[0];
-        snew(x0, isize0);
     }
     else if (bClose || rdft[0][0] != 'a')
     {
         isize0 = is[0];
-        snew(x0, isize0);
     }
     else
     {
@@ -321,7 +424,7 @@ static void do_rdf(const char *fnNDX, const char *fnTPS, const char *fnTRX,
                 break;
         }
         /* Make sure the z-height does not influence the cut-off */
-        box_pbc[ZZ][ZZ] = 2*max(box[XX][XX], box[YY][YY]);
+        box_pbc[ZZ][ZZ] = 2*std::max(box[XX][XX], box[YY][YY]);
     }
     else
     {
@@ -333,7 +436,11 @@ static void do_rdf(const char *fnNDX, const char *fnTPS, const char *fnTRX,
     }
     else
     {
-        rmax2   = sqr(3*max(box[XX][XX], max(box[YY][YY], box[ZZ][ZZ])));
+        rmax2   = sqr(3*std::max(box[XX][XX], std::max(box[YY][YY], box[ZZ][ZZ])));
+    }
+    if (rmax > 0)
+    {
+        rmax2   = std::min(rmax2, sqr(rmax));
     }
     if (debug)
     {
@@ -347,11 +454,9 @@ static void do_rdf(const char *fnNDX, const char *fnTPS, const char *fnTRX,
     invhbinw = 2.0 / binwidth;
     cut2     = sqr(cutoff);
 
+    nthreads = gmx_omp_get_max_threads();
     snew(count, ng);
-    snew(pairs, ng);
-    snew(npairs, ng);
-
-    snew(bExcl, natoms);
+    snew(tcount, ng);
     max_i = 0;
     for (g = 0; g < ng; g++)
     {
@@ -362,63 +467,61 @@ static void do_rdf(const char *fnNDX, const char *fnTPS, const char *fnTRX,
 
         /* this is THE array */
         snew(count[g], nbin+1);
+        /* and these are the thread-local copies of it */
+        snew(tcount[g], nthreads);
+        for (i = 0; i < nthreads; i++)
+        {
+            snew(tcount[g][i], nbin+1);
+        }
+    }
 
-        /* make pairlist array for groups and exclusions */
-        snew(pairs[g], isize[0]);
-        snew(npairs[g], isize[0]);
-        for (i = 0; i < isize[0]; i++)
+    /* The reference positions are searched on a grid with cut-off rmax.
+     * For -surf all atoms of the reference group are put on the grid,
+     * refmol gives the molecule or residue for each of them.
+     */
+    gmx::AnalysisNeighborhood nb;
+    nb.setCutoff(sqrt(rmax2));
+    nb.setXYMode(bXY);
+    /* We can only have exclusions with atomic rdfs */
+    bExcl = (excl != NULL && !(bCM || bClose || rdft[0][0] != 'a'));
+    if (bExcl)
+    {
+        nb.setTopologyExclusions(excl);
+    }
+    /* The exclusion IDs of the reference positions should be ascending.
+     * The order of the reference atoms does not matter for atomic rdfs,
+     * so we sort a copy of the index.
+     */
+    refindex = index[0];
+    if (bExcl)
+    {
+        snew(refindex, isize0);
+        std::copy(index[0], index[0] + isize0, refindex);
+        std::sort(refindex, refindex + isize0);
+    }
+    snew(x0, bClose ? isize[0] : isize0);
+    if (bClose)
+    {
+        snew(refmol, isize[0]);
+        for (i = 0; i < isize0; i++)
         {
-            /* We can only have exclusions with atomic rdfs */
-            if (!(bCM || bClose || rdft[0][0] != 'a'))
+            for (ii = coi[0][i]; ii < coi[0][i+1]; ii++)
             {
-                ix = index[0][i];
-                for (j = 0; j < natoms; j++)
-                {
-                    bExcl[j] = FALSE;
-                }
-                /* exclusions? */
-                if (excl)
-                {
-                    for (j = excl->index[ix]; j < excl->index[ix+1]; j++)
-                    {
-                        bExcl[excl->a[j]] = TRUE;
-                    }
-                }
-                k = 0;
-                snew(pairs[g][i], isize[g+1]);
-                bNonSelfExcl = FALSE;
-                for (j = 0; j < isize[g+1]; j++)
-                {
-                    jx = index[g+1][j];
-                    if (!bExcl[jx])
-                    {
-                        pairs[g][i][k++] = jx;
-                    }
-                    else if (ix != jx)
-                    {
-                        /* Check if we have exclusions other than self exclusions */
-                        bNonSelfExcl = TRUE;
-                    }
-                }
-                if (bNonSelfExcl)
-                {
-                    npairs[g][i] = k;
-                    srenew(pairs[g][i], npairs[g][i]);
-                }
-                else
-                {
-                    /* Save a LOT of memory and some cpu cycles */
-                    npairs[g][i] = -1;
-                    sfree(pairs[g][i]);
-                }
+                refmol[ii] = i;
             }
-            else
+        }
+        snew(tmind2, nthreads);
+        snew(tmol, nthreads);
+        for (i = 0; i < nthreads; i++)
+        {
+            snew(tmind2[i], isize0);
+            snew(tmol[i], isize0);
+            for (j = 0; j < isize0; j++)
             {
-                npairs[g][i] = -1;
+                tmind2[i][j] = GMX_REAL_MAX;
             }
         }
     }
-    sfree(bExcl);
 
     snew(x_i1, max_i);
     nframes    = 0;
@@ -463,6 +566,21 @@ static void do_rdf(const char *fnNDX, const char *fnTPS, const char *fnTRX,
         {
             calc_comg(is[0], coi[0], index[0], rdft[0][6] == 'm', atom, x, x0);
         }
+        else
+        {
+            /* Copy the indexed coordinates to a continuous array */
+            for (i = 0; i < isize[0]; i++)
+            {
+                copy_rvec(x[refindex[i]], x0[i]);
+            }
+        }
+
+        gmx::AnalysisNeighborhoodPositions refPos(x0, bClose ? isize[0] : isize0);
+        if (bExcl)
+        {
+            refPos.exclusionIds(gmx::ConstArrayRef<int>(refindex, refindex + isize0));
+        }
+        gmx::AnalysisNeighborhoodSearch    nbsearch = nb.initSearch(bPBC ? &pbc : NULL, refPos);
 
         for (g = 0; g < ng; g++)
         {
@@ -473,138 +591,18 @@ static void do_rdf(const char *fnNDX, const char *fnTPS, const char *fnTRX,
                 {
                     copy_rvec(x[index[g+1][i]], x_i1[i]);
                 }
+                isize_g = isize[g+1];
             }
             else
             {
                 /* Calculate the COMs/COGs and store in x_i1 */
                 calc_comg(is[g+1], coi[g+1], index[g+1], rdft[0][6] == 'm', atom, x, x_i1);
+                isize_g = is[g+1];
             }
 
-            for (i = 0; i < isize0; i++)
-            {
-                if (bClose)
-                {
-                    /* Special loop, since we need to determine the minimum distance
-                     * over all selected atoms in the reference molecule/residue.
-                     */
-                    if (rdft[0][0] == 'a')
-                    {
-                        isize_g = isize[g+1];
-                    }
-                    else
-                    {
-                        isize_g = is[g+1];
-                    }
-                    for (j = 0; j < isize_g; j++)
-                    {
-                        r2 = 1e30;
-                        /* Loop over the selected atoms in the reference molecule */
-                        for (ii = coi[0][i]; ii < coi[0][i+1]; ii++)
-                        {
-                            if (bPBC)
-                            {
-                                pbc_dx(&pbc, x[index[0][ii]], x_i1[j], dx);
-                            }
-                            else
-                            {
-                                rvec_sub(x[index[0][ii]], x_i1[j], dx);
-                            }
-                            if (bXY)
-                            {
-                                r2ii = dx[XX]*dx[XX] + dx[YY]*dx[YY];
-                            }
-                            else
-                            {
-                                r2ii = iprod(dx, dx);
-                            }
-                            if (r2ii < r2)
-                            {
-                                r2 = r2ii;
-                            }
-                        }
-                        if (r2 > cut2 && r2 <= rmax2)
-                        {
-                            count[g][(int)(sqrt(r2)*invhbinw)]++;
-                        }
-                    }
-                }
-                else
-                {
-                    /* Real rdf between points in space */
-                    if (bCM || rdft[0][0] != 'a')
-                    {
-                        copy_rvec(x0[i], xi);
-                    }
-                    else
-                    {
-                        copy_rvec(x[index[0][i]], xi);
-                    }
-                    if (rdft[0][0] == 'a' && npairs[g][i] >= 0)
-                    {
-                        /* Expensive loop, because of indexing */
-                        for (j = 0; j < npairs[g][i]; j++)
-                        {
-                            jx = pairs[g][i][j];
-                            if (bPBC)
-                            {
-                                pbc_dx(&pbc, xi, x[jx], dx);
-                            }
-                            else
-                            {
-                                rvec_sub(xi, x[jx], dx);
-                            }
-
-                            if (bXY)
-                            {
-                                r2 = dx[XX]*dx[XX] + dx[YY]*dx[YY];
-                            }
-                            else
-                            {
-                                r2 = iprod(dx, dx);
-                            }
-                            if (r2 > cut2 && r2 <= rmax2)
-                            {
-                                count[g][(int)(sqrt(r2)*invhbinw)]++;
-                            }
-                        }
-                    }
-                    else
-                    {
-                        /* Cheaper loop, no exclusions */
-                        if (rdft[0][0] == 'a')
-                        {
-                            isize_g = isize[g+1];
-                        }
-                        else
-                        {
-                            isize_g = is[g+1];
-                        }
-                        for (j = 0; j < isize_g; j++)
-                        {
-                            if (bPBC)
-                            {
-                                pbc_dx(&pbc, xi, x_i1[j], dx);
-                            }
-                            else
-                            {
-                                rvec_sub(xi, x_i1[j], dx);
-                            }
-                            if (bXY)
-                            {
-                                r2 = dx[XX]*dx[XX] + dx[YY]*dx[YY];
-                            }
-                            else
-                            {
-                                r2 = iprod(dx, dx);
-                            }
-                            if (r2 > cut2 && r2 <= rmax2)
-                            {
-                                count[g][(int)(sqrt(r2)*invhbinw)]++;
-                            }
-                        }
-                    }
-                }
-            }
+            rdf_count_pairs(nbsearch, isize_g, x_i1, bExcl ? index[g+1] : NULL,
+                            refmol, tmind2, tmol, cut2, rmax2, invhbinw,
+                            nthreads, tcount[g]);
         }
         nframes++;
     }
@@ -619,6 +617,38 @@ static void do_rdf(const char *fnNDX, const char *fnTPS, const char *fnTRX,
     close_trj(status);
 
     sfree(x);
+    sfree(x0);
+    sfree(x_i1);
+    if (refindex != index[0])
+    {
+        sfree(refindex);
+    }
+
+    /* Sum the thread-local histograms */
+    for (g = 0; g < ng; g++)
+    {
+        for (i = 0; i < nthreads; i++)
+        {
+            for (j = 0; j < nbin+1; j++)
+            {
+                count[g][j] += tcount[g][i][j];
+            }
+            sfree(tcount[g][i]);
+        }
+        sfree(tcount[g]);
+    }
+    sfree(tcount);
+    if (bClose)
+    {
+        for (i = 0; i < nthreads; i++)
+        {
+            sfree(tmind2[i]);
+            sfree(tmol[i]);
+        }
+        sfree(tmind2);
+        sfree(tmol);
+        sfree(refmol);
+    }
 
     /* Average volume */
     invvol = invvol_sum/nframes;
@@ -656,7 +686,7 @@ static void do_rdf(const char *fnNDX, const char *fnTPS, const char *fnTRX,
         }
 
         /* Do the normalization */
-        nrdf = max((nbin+1)/2, 1+2*fade/binwidth);
+        nrdf = static_cast<int>(std::max(static_cast<real>((nbin+1)/2), 1+2*fade/binwidth));
         snew(rdf[g], nrdf);
         for (i = 0; i < (nbin+1)/2; i++)
         {
@@ -857,10 +887,13 @@ int gmx_rdf(int argc, char *argv[])
         "Note that all atoms in the selected groups are used, also the ones",
         "that don't have Lennard-Jones interactions.[PAR]",
         "Option [TT]-cn[tt] produces the cumulative number RDF,",
-        "i.e. the average number of particles within a distance r.[PAR]"
+        "i.e. the average number of particles within a distance r.[PAR]",
+        "The pairs are found with a grid search with cut-off [TT]-rmax[tt],",
+        "so setting [TT]-rmax[tt] to the range of interest is much faster",
+        "than the default maximum range allowed by the box for large systems."
     };
     static gmx_bool    bCM     = FALSE, bXY = FALSE, bPBC = TRUE, bNormalize = TRUE;
-    static real        cutoff  = 0, binwidth = 0.002, fade = 0.0;
+    static real        cutoff  = 0, rmax = 0, binwidth = 0.002, fade = 0.0;
     static int         ngroups = 1;
 
     static const char *closet[] = { NULL, "no", "mol", "res", NULL };
@@ -883,6 +916,8 @@ int gmx_rdf(int argc, char *argv[])
           "Use only the x and y components of the distance" },
         { "-cut",      FALSE, etREAL, {&cutoff},
           "Shortest distance (nm) to be considered"},
+        { "-rmax",     FALSE, etREAL, {&rmax},
+          "Largest distance (nm) to calculate, 0 uses the largest distance allowed by the box" },
         { "-ng",       FALSE, etINT, {&ngroups},
           "Number of secondary groups to compute RDFs around a central group" },
         { "-fade",     FALSE, etREAL, {&fade},
@@ -939,7 +974,7 @@ int gmx_rdf(int argc, char *argv[])
     do_rdf(fnNDX, fnTPS, ftp2fn(efTRX, NFILE, fnm),
            opt2fn("-o", NFILE, fnm), opt2fn_null("-cn", NFILE, fnm),
            opt2fn_null("-hq", NFILE, fnm),
-           bCM, closet[0], rdft, bXY, bPBC, bNormalize, cutoff, binwidth, fade, ngroups,
+           bCM, closet[0], rdft, bXY, bPBC, bNormalize, cutoff, rmax, binwidth, fade, ngroups,
            oenv);
 
     return 0;
@@ -54,14 +54,10 @@
 #include "gromacs/math/vec.h"
 #include "gromacs/utility/fatalerror.h"
 #include "gromacs/utility/futil.h"
+#include "gromacs/utility/gmxomp.h"
 #include "gromacs/utility/smalloc.h"
 
 
-static int index2(int *ibox, int x, int y)
-{
-    return (ibox[1]*x+y);
-}
-
 static int index3(int *ibox, int x, int y, int z)
 {
     return (ibox[2]*(ibox[1]*x+y)+z);
@@ -86,6 +82,148 @@ static gmx_int64_t indexn(int ndim, const int *ibox, const int *nxyz)
     return d;
 }
 
+/* Sparse N-dimensional grid: only the bins that contain data are stored,
+ * sorted on their flat grid index. A hash table with open addressing maps
+ * flat grid indices back to bin numbers, so memory usage scales with the
+ * number of data points instead of with the number of grid points.
+ */
+typedef struct {
+    int          nbin;  /* Number of occupied bins */
+    gmx_int64_t *index; /* Flat grid index of each occupied bin, ascending */
+    int          mask;  /* Hash table size minus one */
+    int         *hash;  /* Bin number for each hash slot, -1 when empty */
+} t_sparse_grid;
+
+static int comp_int64(const void *a, const void *b)
+{
+    gmx_int64_t ia = *(const gmx_int64_t *)a;
+    gmx_int64_t ib = *(const gmx_int64_t *)b;
+
+    return (ia < ib) ? -1 : ((ia > ib) ? 1 : 0);
+}
+
+static gmx_inline
+int sparse_grid_slot(const t_sparse_grid *grid, gmx_int64_t index)
+{
+    gmx_uint64_t h;
+
+    /* Multiplicative hashing, folded so that the regular strides of
+     * the higher dimensions also end up in the low bits.
+     */
+    h  = (gmx_uint64_t)index*2654435761U;
+    h ^= h >> 29;
+
+    return (int)(h & grid->mask);
+}
+
+/* Sets up grid for the n flat grid indices in index, negative
+ * indices are ignored. Duplicate indices end up in the same bin.
+ */
+static void init_sparse_grid(t_sparse_grid *grid, int n, const gmx_int64_t *index)
+{
+    int i, nbin, size, h;
+
+    snew(grid->index, n);
+    nbin = 0;
+    for (i = 0; i < n; i++)
+    {
+        if (index[i] >= 0)
+        {
+            grid->index[nbin++] = index[i];
+        }
+    }
+    qsort(grid->index, nbin, sizeof(grid->index[0]), comp_int64);
+    grid->nbin = 0;
+    for (i = 0; i < nbin; i++)
+    {
+        if (grid->nbin == 0 || grid->index[i] != grid->index[grid->nbin-1])
+        {
+            grid->index[grid->nbin++] = grid->index[i];
+        }
+    }
+    srenew(grid->index, max(1, grid->nbin));
+
+    /* Keep the table at most half full */
+    size = 4;
+    while (size < 2*grid->nbin)
+    {
+        size *= 2;
+    }
+    grid->mask = size - 1;
+    snew(grid->hash, size);
+    for (h = 0; h < size; h++)
+    {
+        grid->hash[h] = -1;
+    }
+    for (i = 0; i < grid->nbin; i++)
+    {
+        h = sparse_grid_slot(grid, grid->index[i]);
+        while (grid->hash[h] >= 0)
+        {
+            h = (h + 1) & grid->mask;
+        }
+        grid->hash[h] = i;
+    }
+}
+
+static void done_sparse_grid(t_sparse_grid *grid)
+{
+    sfree(grid->index);
+    sfree(grid->hash);
+}
+
+/* Returns the bin number for flat grid index, -1 when the bin is empty */
+static gmx_inline
+int sparse_grid_find(const t_sparse_grid *grid, gmx_int64_t index)
+{
+    int h, b;
+
+    h = sparse_grid_slot(grid, index);
+    while ((b = grid->hash[h]) >= 0)
+    {
+        if (grid->index[b] == index)
+        {
+            return b;
+        }
+        h = (h + 1) & grid->mask;
+    }
+
+    return -1;
+}
+
+/* Returns val for the bin at flat grid index, empty when there is no data */
+static gmx_inline
+real sparse_grid_value(const t_sparse_grid *grid, gmx_int64_t index,
+                       const real *val, real empty)
+{
+    int b;
+
+    b = sparse_grid_find(grid, index);
+
+    return (b >= 0) ? val[b] : empty;
+}
+
+/* Returns a dense copy of the len grid points of val */
+static real *sparse_grid_to_dense(const t_sparse_grid *grid, gmx_int64_t len,
+                                  const real *val, real empty)
+{
+    real        *dense;
+    gmx_int64_t  i;
+    int          b;
+
+    snew(dense, len);
+    for (i = 0; i < len; i++)
+    {
+        dense[i] = empty;
+    }
+    for (b = 0; b < grid->nbin; b++)
+    {
+        dense[grid->index[b]] = val[b];
+    }
+
+    return dense;
+}
+
 typedef struct {
     int    Nx;      /* x grid points in unit cell */
     int    Ny;      /* y grid points in unit cell */
@@ -241,164 +379,72 @@ void add_minimum(FILE *fp, int num, const t_minimum *min, t_minimum *mm)
     mm[num].ener  = min->ener;
 }
 
-static gmx_inline
-gmx_bool is_local_minimum_from_below(const t_minimum *this_min,
-                                     int              dimension_index,
-                                     int              dimension_min,
-                                     int              neighbour_index,
-                                     real            *W)
+static void pick_minima(const char *logfile, const int *ibox, int ndim,
+                        const t_sparse_grid *grid, const real W[], real Winf)
 {
-    return ((dimension_index == dimension_min) ||
-            ((dimension_index > dimension_min) &&
-             (this_min->ener < W[neighbour_index])));
-    /* Note over/underflow within W cannot occur. */
-}
-
-static gmx_inline
-gmx_bool is_local_minimum_from_above(const t_minimum *this_min,
-                                     int              dimension_index,
-                                     int              dimension_max,
-                                     int              neighbour_index,
-                                     real            *W)
-{
-    return ((dimension_index == dimension_max) ||
-            ((dimension_index < dimension_max) &&
-             (this_min->ener < W[neighbour_index])));
-    /* Note over/underflow within W cannot occur. */
-}
+    FILE        *fp;
+    int          i, b, d, nmin;
+    t_minimum   *mm, this_min;
+    gmx_int64_t *stride;
+    gmx_bool    *bMin;
 
-static void pick_minima(const char *logfile, int *ibox, int ndim, int len, real W[])
-{
-    FILE      *fp;
-    int        i, j, k, nmin;
-    t_minimum *mm, this_min;
-    int       *this_point;
-    int        loopmax, loopcounter;
+    /* Strides of the dimensions in the flat grid index */
+    snew(stride, ndim);
+    stride[ndim-1] = 1;
+    for (d = ndim-1; d > 0; d--)
+    {
+        stride[d-1] = stride[d]*ibox[d];
+    }
 
-    snew(mm, len);
-    nmin = 0;
-    fp   = gmx_ffopen(logfile, "w");
-    /* Loop over each element in the array of dimenion ndim seeking
-     * minima with respect to every dimension. Specialized loops for
-     * speed with ndim == 2 and ndim == 3. */
-    switch (ndim)
+    /* A bin is a minimum when its free energy is lower than that of all
+     * its neighbours along each dimension, empty neighbours have Winf.
+     * Empty bins themselves are not considered. The grid is only read
+     * here, so the bins can be checked in parallel.
+     */
+    snew(bMin, grid->nbin);
+#pragma omp parallel for schedule(static) private(d)
+    for (b = 0; b < grid->nbin; b++)
     {
-        case 0:
-            /* This is probably impossible to reach anyway. */
-            break;
-        case 2:
-            for (i = 0; (i < ibox[0]); i++)
-            {
-                for (j = 0; (j < ibox[1]); j++)
-                {
-                    /* Get the index of this point in the flat array */
-                    this_min.index = index2(ibox, i, j);
-                    this_min.ener  = W[this_min.index];
-                    if (is_local_minimum_from_below(&this_min, i, 0,         index2(ibox, i-1, j  ), W) &&
-                        is_local_minimum_from_above(&this_min, i, ibox[0]-1, index2(ibox, i+1, j  ), W) &&
-                        is_local_minimum_from_below(&this_min, j, 0,         index2(ibox, i, j-1), W) &&
-                        is_local_minimum_from_above(&this_min, j, ibox[1]-1, index2(ibox, i, j+1), W))
-                    {
-                        add_minimum(fp, nmin, &this_min, mm);
-                        nmin++;
-                    }
-                }
-            }
-            break;
-        case 3:
-            for (i = 0; (i < ibox[0]); i++)
-            {
-                for (j = 0; (j < ibox[1]); j++)
-                {
-                    for (k = 0; (k < ibox[2]); k++)
-                    {
-                        /* Get the index of this point in the flat array */
-                        this_min.index = index3(ibox, i, j, k);
-                        this_min.ener  = W[this_min.index];
-                        if (is_local_minimum_from_below(&this_min, i, 0,         index3(ibox, i-1, j, k  ), W) &&
-                            is_local_minimum_from_above(&this_min, i, ibox[0]-1, index3(ibox, i+1, j, k  ), W) &&
-                            is_local_minimum_from_below(&this_min, j, 0,         index3(ibox, i, j-1, k  ), W) &&
-                            is_local_minimum_from_above(&this_min, j, ibox[1]-1, index3(ibox, i, j+1, k  ), W) &&
-                            is_local_minimum_from_below(&this_min, k, 0,         index3(ibox, i, j, k-1), W) &&
-                            is_local_minimum_from_above(&this_min, k, ibox[2]-1, index3(ibox, i, j, k+1), W))
-                        {
-                            add_minimum(fp, nmin, &this_min, mm);
-                            nmin++;
-                        }
-                    }
-                }
-            }
-            break;
-        default:
-            /* Note this treats ndim == 1 and ndim > 3 */
-
-            /* Set up an ndim-dimensional vector to loop over the points
-             * on the grid. (0,0,0, ... 0) is an acceptable place to
-             * start. */
-            snew(this_point, ndim);
-
-            /* Determine the number of points of the ndim-dimensional
-             * grid. */
-            loopmax = ibox[0];
-            for (i = 1; i < ndim; i++)
+        gmx_int64_t index, rest;
+        int         x;
+        real        ener;
+        gmx_bool    bIsMin;
+
+        index  = grid->index[b];
+        rest   = index;
+        ener   = W[b];
+        bIsMin = TRUE;
+        for (d = 0; bIsMin && d < ndim; d++)
+        {
+            x     = rest/stride[d];
+            rest -= x*stride[d];
+            if (x > 0)
             {
-                loopmax *= ibox[i];
+                bIsMin = (ener < sparse_grid_value(grid, index - stride[d], W, Winf));
             }
-
-            loopcounter = 0;
-            while (loopmax > loopcounter)
+            if (bIsMin && x < ibox[d]-1)
             {
-                gmx_bool bMin = TRUE;
-
-                /* Get the index of this_point in the flat array */
-                this_min.index = indexn(ndim, ibox, this_point);
-                this_min.ener  = W[this_min.index];
-
-                /* Is this_point a minimum from above and below in each
-                 * dimension? */
-                for (i = 0; bMin && (i < ndim); i++)
-                {
-                    /* Save the index of this_point within the curent
-                     * dimension so we can change that index in the
-                     * this_point array for use with indexn(). */
-                    int index = this_point[i];
-                    this_point[i]--;
-                    bMin = bMin &&
-                        is_local_minimum_from_below(&this_min, index, 0,         indexn(ndim, ibox, this_point), W);
-                    this_point[i] += 2;
-                    bMin           = bMin &&
-                        is_local_minimum_from_above(&this_min, index, ibox[i]-1, indexn(ndim, ibox, this_point), W);
-                    this_point[i]--;
-                }
-                if (bMin)
-                {
-                    add_minimum(fp, nmin, &this_min, mm);
-                    nmin++;
-                }
-
-                /* update global loop counter */
-                loopcounter++;
-
-                /* Avoid underflow of this_point[i] */
-                if (loopmax > loopcounter)
-                {
-                    /* update this_point non-recursively */
-                    i = ndim-1;
-                    this_point[i]++;
-                    while (ibox[i] == this_point[i])
-                    {
-                        this_point[i] = 0;
-                        i--;
-                        /* this_point[i] cannot underflow because
-                         * loopmax > loopcounter. */
-                        this_point[i]++;
-                    }
-                }
+                bIsMin = (ener < sparse_grid_value(grid, index + stride[d], W, Winf));
             }
+        }
+        bMin[b] = bIsMin;
+    }
+    sfree(stride);
 
-            sfree(this_point);
-            break;
+    snew(mm, grid->nbin);
+    nmin = 0;
+    fp   = gmx_ffopen(logfile, "w");
+    for (b = 0; b < grid->nbin; b++)
+    {
+        if (bMin[b])
+        {
+            this_min.index = grid->index[b];
+            this_min.ener  = W[b];
+            add_minimum(fp, nmin, &this_min, mm);
+            nmin++;
+        }
     }
+    sfree(bMin);
     qsort(mm, nmin, sizeof(mm[0]), comp_minima);
     fprintf(fp, "Minima sorted after energy\n");
     for (i = 0; (i < nmin); i++)
@@ -425,13 +471,15 @@ static void do_sham(const char *fn, const char *ndx,
     real        *min_eig, *max_eig;
     real        *axis_x, *axis_y, *axis_z, *axis = NULL;
     double      *P;
-    real       **PP, *W, *E, **WW, **EE, *S, **SS, *M, *bE;
+    real       **PP, *W, *E, **WW, **EE, *S, **SS, *bE, *Wd;
     rvec         xxx;
     char        *buf;
-    double      *bfac, efac, bref, Pmax, Wmin, Wmax, Winf, Emin, Emax, Einf, Smin, Smax, Sinf, Mmin, Mmax;
+    double      *bfac, efac, bref, Pmax, Wmin, Wmax, Winf, Emin, Emax, Einf, Smin, Smax, Sinf;
     real        *delta;
-    int          i, j, k, imin, len, index, d, *nbin, *bindex, bi;
+    int          i, j, k, index, *nbin, *bindex, bi;
     int         *nxyz, maxbox;
+    gmx_int64_t  len, imin, *gindex;
+    t_sparse_grid grid;
     t_blocka    *b;
     gmx_bool     bOutside;
     unsigned int flags;
@@ -513,18 +561,11 @@ static void do_sham(const char *fn, const char *ndx,
     {
         len = len*ibox[i];
     }
-    printf("There are %d bins in the %d-dimensional histogram. Beta-Emin = %g\n",
+    printf("There are %"GMX_PRId64 " bins in the %d-dimensional histogram. Beta-Emin = %g\n",
            len, neig, Emin);
-    snew(P, len);
-    snew(W, len);
-    snew(E, len);
-    snew(S, len);
-    snew(M, len);
-    snew(nbin, len);
-    snew(bindex, n);
 
-
-    /* Loop over projections */
+    /* Determine the grid index of each projection, -1 when outside */
+    snew(gindex, n);
     for (j = 0; (j < n); j++)
     {
         /* Loop over dimensions */
@@ -537,10 +578,27 @@ static void do_sham(const char *fn, const char *ndx,
                 bOutside = TRUE;
             }
         }
-        if (!bOutside)
+        gindex[j] = bOutside ? -1 : indexn(neig, ibox, nxyz);
+    }
+    /* Only store the bins that are occupied, so the memory use does
+     * not grow with the number of grid points.
+     */
+    init_sparse_grid(&grid, n, gindex);
+    printf("%d bins contain data\n", grid.nbin);
+    snew(P, grid.nbin);
+    snew(W, grid.nbin);
+    snew(E, grid.nbin);
+    snew(S, grid.nbin);
+    snew(nbin, grid.nbin);
+    snew(bindex, n);
+
+    /* Loop over projections */
+    for (j = 0; (j < n); j++)
+    {
+        bindex[j] = -1;
+        if (gindex[j] >= 0)
         {
-            index = indexn(neig, ibox, nxyz);
-            range_check(index, 0, len);
+            index = sparse_grid_find(&grid, gindex[j]);
             /* Compute the exponential factor */
             if (enerT)
             {
@@ -578,8 +636,9 @@ static void do_sham(const char *fn, const char *ndx,
             bindex[j] = index;
         }
     }
+    sfree(gindex);
     /* Normalize probability */
-    normalize_p_e(len, P, nbin, E, pmin);
+    normalize_p_e(grid.nbin, P, nbin, E, pmin);
     Pmax = 0;
     /* Compute boundaries for the Free energy */
     Wmin = 1e8;
@@ -588,7 +647,7 @@ static void do_sham(const char *fn, const char *ndx,
     /* Recompute Emin: it may have changed due to averaging */
     Emin = 1e8;
     Emax = -1e8;
-    for (i = 0; (i < len); i++)
+    for (i = 0; (i < grid.nbin); i++)
     {
         if (P[i] != 0)
         {
@@ -597,7 +656,7 @@ static void do_sham(const char *fn, const char *ndx,
             if (W[i] < Wmin)
             {
                 Wmin = W[i];
-                imin = i;
+                imin = grid.index[i];
             }
             Emin = min(E[i], Emin);
             Emax = max(E[i], Emax);
@@ -623,13 +682,13 @@ static void do_sham(const char *fn, const char *ndx,
     Sinf = Smax+1;
     /* Write out the free energy as a function of bin index */
     fp = gmx_ffopen(fn, "w");
-    for (i = 0; (i < len); i++)
+    for (i = 0; (i < grid.nbin); i++)
     {
         if (P[i] != 0)
         {
             W[i] -= Wmin;
             S[i]  = E[i]-W[i]-Smin;
-            fprintf(fp, "%5d  %10.5e  %10.5e  %10.5e\n", i, W[i], E[i], S[i]);
+            fprintf(fp, "%5"GMX_PRId64 "  %10.5e  %10.5e  %10.5e\n", grid.index[i], W[i], E[i], S[i]);
         }
         else
         {
@@ -641,36 +700,31 @@ static void do_sham(const char *fn, const char *ndx,
     gmx_ffclose(fp);
     /* Organize the structures in the bins */
     snew(b, 1);
-    snew(b->index, len+1);
+    snew(b->index, grid.nbin+1);
     snew(b->a, n);
     b->index[0] = 0;
-    for (i = 0; (i < len); i++)
+    for (i = 0; (i < grid.nbin); i++)
     {
         b->index[i+1] = b->index[i]+nbin[i];
         nbin[i]       = 0;
     }
+    /* Structures outside the plot range are not in any bin */
     for (i = 0; (i < n); i++)
     {
         bi = bindex[i];
-        b->a[b->index[bi]+nbin[bi]] = i;
-        nbin[bi]++;
+        if (bi >= 0)
+        {
+            b->a[b->index[bi]+nbin[bi]] = i;
+            nbin[bi]++;
+        }
     }
-    /* Consistency check */
-    /* This no longer applies when we allow the plot to be smaller
-       than the sampled space.
-       for(i=0; (i<len); i++) {
-       if (nbin[i] != (b->index[i+1] - b->index[i]))
-        gmx_fatal(FARGS,"nbin[%d] = %d, should be %d",i,nbin[i],
-          b->index[i+1] - b->index[i]);
-       }
-     */
     /* Write the index file */
     fp = gmx_ffopen(ndx, "w");
-    for (i = 0; (i < len); i++)
+    for (i = 0; (i < grid.nbin); i++)
     {
         if (nbin[i] > 0)
         {
-            fprintf(fp, "[ %d ]\n", i);
+            fprintf(fp, "[ %"GMX_PRId64 " ]\n", grid.index[i]);
             for (j = b->index[i]; (j < b->index[i+1]); j++)
             {
                 fprintf(fp, "%d\n", b->a[j]+1);
@@ -701,7 +755,7 @@ static void do_sham(const char *fn, const char *ndx,
         }
     }
 
-    pick_minima(logf, ibox, neig, len, W);
+    pick_minima(logf, ibox, neig, &grid, W, Winf);
     if (gmax <= 0)
     {
         gmax = Winf;
@@ -714,13 +768,17 @@ static void do_sham(const char *fn, const char *ndx,
         for (i = 0; (i < ibox[0]); i++)
         {
             snew(PP[i], ibox[1]);
+            snew(WW[i], ibox[1]);
+            snew(EE[i], ibox[1]);
+            snew(SS[i], ibox[1]);
             for (j = 0; j < ibox[1]; j++)
             {
-                PP[i][j] = P[i*ibox[1]+j];
+                bi       = sparse_grid_find(&grid, i*ibox[1]+j);
+                PP[i][j] = (bi >= 0) ? P[bi] : 0;
+                WW[i][j] = (bi >= 0) ? W[bi] : Winf;
+                EE[i][j] = (bi >= 0) ? E[bi] : Einf;
+                SS[i][j] = (bi >= 0) ? S[bi] : Sinf;
             }
-            WW[i] = &(W[i*ibox[1]]);
-            EE[i] = &(E[i*ibox[1]]);
-            SS[i] = &(S[i*ibox[1]]);
         }
         fp = gmx_ffopen(xpmP, "w");
         write_xpm(fp, flags, "Probability Distribution", "", "PC1", "PC2",
@@ -742,6 +800,8 @@ static void do_sham(const char *fn, const char *ndx,
     }
     else if (neig == 3)
     {
+        /* The 3D output is written from a dense grid */
+        Wd = sparse_grid_to_dense(&grid, len, W, Winf);
         /* Dump to PDB file */
         fp = gmx_ffopen(pdb, "w");
         for (i = 0; (i < ibox[0]); i++)
@@ -754,17 +814,18 @@ static void do_sham(const char *fn, const char *ndx,
                 {
                     xxx[ZZ] = 3*(k+0.5-ibox[2]/2);
                     index   = index3(ibox, i, j, k);
-                    if (P[index] > 0)
+                    bi      = sparse_grid_find(&grid, index);
+                    if (bi >= 0 && P[bi] > 0)
                     {
                         fprintf(fp, "%-6s%5d  %-4.4s%3.3s  %4d    %8.3f%8.3f%8.3f%6.2f%6.2f\n",
                                 "ATOM", (index+1) %10000, "H", "H", (index+1)%10000,
-                                xxx[XX], xxx[YY], xxx[ZZ], 1.0, W[index]);
+                                xxx[XX], xxx[YY], xxx[ZZ], 1.0, W[bi]);
                     }
                 }
             }
         }
         gmx_ffclose(fp);
-        write_xplor("out.xplor", W, ibox, min_eig, max_eig);
+        write_xplor("out.xplor", Wd, ibox, min_eig, max_eig);
         nxyz[XX] = imin/(ibox[1]*ibox[2]);
         nxyz[YY] = (imin-nxyz[XX]*ibox[1]*ibox[2])/ibox[2];
         nxyz[ZZ] = imin % ibox[2];
@@ -773,7 +834,7 @@ static void do_sham(const char *fn, const char *ndx,
             snew(WW[i], maxbox);
             for (j = 0; (j < ibox[1]); j++)
             {
-                WW[i][j] = W[index3(ibox, i, j, nxyz[ZZ])];
+                WW[i][j] = Wd[index3(ibox, i, j, nxyz[ZZ])];
             }
         }
         snew(buf, strlen(xpm)+4);
@@ -787,7 +848,7 @@ static void do_sham(const char *fn, const char *ndx,
         {
             for (j = 0; (j < ibox[2]); j++)
             {
-                WW[i][j] = W[index3(ibox, i, nxyz[YY], j)];
+                WW[i][j] = Wd[index3(ibox, i, nxyz[YY], j)];
             }
         }
         sprintf(&buf[strlen(xpm)-4], "13.xpm");
@@ -799,7 +860,7 @@ static void do_sham(const char *fn, const char *ndx,
         {
             for (j = 0; (j < ibox[2]); j++)
             {
-                WW[i][j] = W[index3(ibox, nxyz[XX], i, j)];
+                WW[i][j] = Wd[index3(ibox, nxyz[XX], i, j)];
             }
         }
         sprintf(&buf[strlen(xpm)-4], "23.xpm");
@@ -808,7 +869,9 @@ static void do_sham(const char *fn, const char *ndx,
                   ibox[1], ibox[2], axis_y, axis_z, WW, 0, gmax, rlo, rhi, &nlevels);
         gmx_ffclose(fp);
         sfree(buf);
+        sfree(Wd);
     }
+    done_sparse_grid(&grid);
 }
 
 static void ehisto(const char *fh, int n, real **enerT, const output_env_t oenv)
@@ -737,7 +737,8 @@ int gmx_trjcat(int argc, char *argv[])
                               searchtime, fr.time);
                 }
                 lasttime = fr.time;
-                fpos     = gmx_fio_ftell(stfio);
+                /* Get the file again, to stop any read-ahead */
+                fpos     = gmx_fio_ftell(trx_get_fileio(status));
                 close_trj(status);
                 trxout = open_trx(out_file, "r+");
                 if (gmx_fio_seek(trx_get_fileio(trxout), fpos))
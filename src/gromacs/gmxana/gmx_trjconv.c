@@ -44,6 +44,7 @@
 #include "gromacs/fileio/confio.h"
 #include "gromacs/fileio/gmxfio.h"
 #include "gromacs/fileio/pdbio.h"
+#include "gromacs/fileio/timecontrol.h"
 #include "gromacs/fileio/tngio_for_tools.h"
 #include "gromacs/fileio/tpxio.h"
 #include "gromacs/fileio/trnio.h"
@@ -581,6 +582,30 @@ static gmx_mtop_t *read_mtop_for_tng(const char *tps_file,
     return mtop;
 }
 
+/* Returns the first frame after frame that will be written, either from
+ * the frame index group frindex or as every skip_nr-th frame,
+ * -1 when no more frames will be written.
+ */
+static int next_frame_to_write(int frame, int skip_nr, int nrfri, const int *frindex)
+{
+    int i, next;
+
+    if (frindex == NULL)
+    {
+        return frame + skip_nr - frame % skip_nr;
+    }
+    next = -1;
+    for (i = 0; i < nrfri; i++)
+    {
+        if (frindex[i] > frame && (next < 0 || frindex[i] < next))
+        {
+            next = frindex[i];
+        }
+    }
+
+    return next;
+}
+
 int gmx_trjconv(int argc, char *argv[])
 {
     const char *desc[] = {
@@ -603,6 +628,12 @@ int gmx_trjconv(int argc, char *argv[])
         "* select frames within a certain range of a quantity given",
         "in an [TT].xvg[tt] file.[PAR]",
 
+        "When an [TT].xtc[tt] or [TT].trr[tt] file has a frame index",
+        "([TT].idx[tt] file written when the environment variable",
+        "[TT]GMX_TRX_INDEX[tt] is set), the frames that are not written",
+        "with [TT]-skip[tt] or [TT]-fr[tt] are not read, unless [TT]-b[tt],",
+        "[TT]-dt[tt] or an option that needs every frame is used.[PAR]",
+
         "[gmx-trjcat] is better suited for concatenating multiple trajectory files.",
         "[PAR]",
 
@@ -870,7 +901,7 @@ int gmx_trjconv(int argc, char *argv[])
     matrix           top_box;
     atom_id         *index, *cindex;
     char            *grpnm;
-    int             *frindex, nrfri;
+    int             *frindex, nrfri = 0;
     char            *frname;
     int              ifit, irms, my_clust = -1;
     atom_id         *ind_fit, *ind_rms;
@@ -891,7 +922,8 @@ int gmx_trjconv(int argc, char *argv[])
     gmx_bool         bExec, bTimeStep = FALSE, bDumpFrame = FALSE, bSetPrec, bNeedPrec;
     gmx_bool         bHaveFirstFrame, bHaveNextFrame, bSetBox, bSetUR, bSplit = FALSE;
     gmx_bool         bSubTraj = FALSE, bDropUnder = FALSE, bDropOver = FALSE, bTrans = FALSE;
-    gmx_bool         bWriteFrame, bSplitHere;
+    gmx_bool         bWriteFrame, bSplitHere, bSeekFrames;
+    int              nextframe;
     const char      *top_file, *in_file, *out_file = NULL;
     char             out_file2[256], *charpt;
     char            *outf_base = NULL;
@@ -1371,6 +1403,16 @@ int gmx_trjconv(int argc, char *argv[])
                 }
             }
 
+            /* With a frame index for the input, we can jump directly
+             * to the frames that will be written, as long as the frame
+             * numbers are those in the file and no option needs the
+             * frames in between.
+             */
+            bSeekFrames = (trx_get_frame_count(trxin) >= 0 &&
+                           (frindex != NULL || skip_nr > 1) &&
+                           !bTimeSet(TBEGIN) && !bTimeSet(TDELTA) &&
+                           !bTDump && !bSubTraj && !bNoJump && !bPFit);
+
             /* Start the big loop over frames */
             file_nr  =  0;
             frame    =  0;
@@ -1875,6 +1917,21 @@ int gmx_trjconv(int argc, char *argv[])
                     }
                 }
                 frame++;
+                if (bSeekFrames)
+                {
+                    nextframe = next_frame_to_write(frame - 1, skip_nr, nrfri, frindex);
+                    if (nextframe < 0 || nextframe >= trx_get_frame_count(trxin))
+                    {
+                        /* There are no more frames to write */
+                        break;
+                    }
+                    if (!trx_seek_frame(trxin, nextframe))
+                    {
+                        gmx_fatal(FARGS, "Could not position %s at frame %d",
+                                  in_file, nextframe);
+                    }
+                    frame = nextframe;
+                }
                 bHaveNextFrame = read_next_frame(oenv, trxin, &fr);
             }
             while (!(bTDump && bDumpFrame) && bHaveNextFrame);
@@ -50,6 +50,7 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include <algorithm>
 #include <sstream>
 
 #include "gromacs/commandline/pargs.h"
@@ -63,7 +64,9 @@
 #include "gromacs/math/vec.h"
 #include "gromacs/random/random.h"
 #include "gromacs/utility/cstringutil.h"
+#include "gromacs/utility/exceptions.h"
 #include "gromacs/utility/fatalerror.h"
+#include "gromacs/utility/gmxomp.h"
 #include "gromacs/utility/smalloc.h"
 
 //! longest file names allowed in input files
@@ -170,6 +173,14 @@ typedef struct
 
     /*! \brief TRUE, if any data point of the histogram is within min and max, otherwise FALSE */
     gmx_bool **bContrib;
+    /*! \brief Boltzmann factors exp(-U/kT + boltzShift) of the umbrella potential at each bin.
+     *
+     * These only depend on the umbrella position and force constant,
+     * so they are computed once before the WHAM iterations.
+     */
+    double  **boltz;
+    double  **boltzContrib; //!< boltz, but zero where bContrib is FALSE
+    double   *boltzShift;   //!< minimum of U/kT over the bins, avoids underflow of boltz
     real     **ztime;     //!< input data z(t) as a function of time. Required to compute ACTs
 
     /*! \brief average force estimated from average displacement, fAv=dzAv*k
@@ -190,6 +201,9 @@ typedef struct
     gmx_bool *bUse;      //!< boolean array of size n. =1 if used, =0 if not
 } t_groupselection;
 
+//! Number of bins per block of work in calc_profile()
+static const int c_whamBinBlockSize = 64;
+
 //! Parameters of WHAM
 typedef struct
 {
@@ -300,7 +314,6 @@ typedef struct
     double   *tabX, *tabY, tabMin, tabMax, tabDz;
     int       tabNbins;
     /*!\}*/
-    gmx_rng_t rng;                  //!< gromacs random number generator
 } t_UmbrellaOptions;
 
 //! Make an umbrella window (may contain several histograms)
@@ -316,6 +329,8 @@ t_UmbrellaWindow * initUmbrellaWindows(int nwin)
         win[i].N        = win[i].Ntot = 0;
         win[i].g        = win[i].tau  = win[i].tausmooth = 0;
         win[i].bContrib = 0;
+        win[i].boltz    = win[i].boltzContrib = 0;
+        win[i].boltzShift = 0;
         win[i].ztime    = 0;
         win[i].forceAv  = 0;
         win[i].aver     = win[i].sigma = 0;
@@ -351,6 +366,20 @@ void freeUmbrellaWindows(t_UmbrellaWindow *win, int nwin)
                 sfree(win[i].bContrib[j]);
             }
         }
+        if (win[i].boltz)
+        {
+            for (j = 0; j < win[i].nPull; j++)
+            {
+                sfree(win[i].boltz[j]);
+            }
+        }
+        if (win[i].boltzContrib)
+        {
+            for (j = 0; j < win[i].nPull; j++)
+            {
+                sfree(win[i].boltzContrib[j]);
+            }
+        }
         sfree(win[i].Histo);
         sfree(win[i].cum);
         sfree(win[i].k);
@@ -362,6 +391,9 @@ void freeUmbrellaWindows(t_UmbrellaWindow *win, int nwin)
         sfree(win[i].tau);
         sfree(win[i].tausmooth);
         sfree(win[i].bContrib);
+        sfree(win[i].boltz);
+        sfree(win[i].boltzContrib);
+        sfree(win[i].boltzShift);
         sfree(win[i].ztime);
         sfree(win[i].forceAv);
         sfree(win[i].aver);
@@ -807,6 +839,78 @@ double tabulated_pot(double dist, t_UmbrellaOptions *opt)
 }
 
 
+/*! \brief Compute the Boltzmann factors exp(-U/kT) of the umbrella potentials
+ *
+ * The umbrella potential of each histogram at each bin does not change during
+ * the WHAM iterations (nor during bootstrapping), so we compute the expensive
+ * exponentials only once here. The factors are scaled such that the largest
+ * is 1, the scaling is compensated when they are combined with z.
+ */
+void setup_boltzmann_factors(t_UmbrellaWindow * window, int nWindows,
+                             t_UmbrellaOptions *opt)
+{
+    int    i;
+    double min = opt->min, dz = opt->dz, ztot_half, ztot;
+
+    ztot      = opt->max-opt->min;
+    ztot_half = ztot/2;
+
+#pragma omp parallel for schedule(static)
+    for (i = 0; i < nWindows; ++i)
+    {
+        try
+        {
+            int    j, k;
+            double U, temp, distance, Umin;
+
+            snew(window[i].boltz, window[i].nPull);
+            snew(window[i].boltzShift, window[i].nPull);
+            for (j = 0; j < window[i].nPull; ++j)
+            {
+                snew(window[i].boltz[j], opt->bins);
+                Umin = 0;
+                for (k = 0; k < opt->bins; ++k)
+                {
+                    temp     = (1.0*k+0.5)*dz+min;
+                    distance = temp - window[i].pos[j];   /* distance to umbrella center */
+                    if (opt->bCycl)
+                    {                                     /* in cyclic wham:             */
+                        if (distance > ztot_half)         /*    |distance| < ztot_half   */
+                        {
+                            distance -= ztot;
+                        }
+                        else if (distance < -ztot_half)
+                        {
+                            distance += ztot;
+                        }
+                    }
+
+                    if (!opt->bTab)
+                    {
+                        U = 0.5*window[i].k[j]*sqr(distance);       /* harmonic potential assumed. */
+                    }
+                    else
+                    {
+                        U = tabulated_pot(distance, opt);            /* Use tabulated potential     */
+                    }
+                    /* Store U/kT for now */
+                    window[i].boltz[j][k] = U/(8.314e-3*opt->Temperature);
+                    if (k == 0 || window[i].boltz[j][k] < Umin)
+                    {
+                        Umin = window[i].boltz[j][k];
+                    }
+                }
+                for (k = 0; k < opt->bins; ++k)
+                {
+                    window[i].boltz[j][k] = exp(-window[i].boltz[j][k] + Umin);
+                }
+                window[i].boltzShift[j] = Umin;
+            }
+        }
+        GMX_CATCH_ALL_AND_EXIT_WITH_FATAL_ERROR;
+    }
+}
+
 /*! \brief
  * Check which bins substiantially contribute (accelerates WHAM)
  *
@@ -817,9 +921,7 @@ double tabulated_pot(double dist, t_UmbrellaOptions *opt)
 void setup_acc_wham(double *profile, t_UmbrellaWindow * window, int nWindows,
                     t_UmbrellaOptions *opt)
 {
-    int           i, j, k, nGrptot = 0, nContrib = 0, nTot = 0;
-    double        U, min = opt->min, dz = opt->dz, temp, ztot_half, distance, ztot, contrib1, contrib2;
-    gmx_bool      bAnyContrib;
+    int           i, nGrptot = 0, nContrib = 0, nTot = 0;
     static int    bFirst = 1;
     static double wham_contrib_lim;
 
@@ -832,55 +934,44 @@ void setup_acc_wham(double *profile, t_UmbrellaWindow * window, int nWindows,
         wham_contrib_lim = opt->Tolerance/nGrptot;
     }
 
-    ztot      = opt->max-opt->min;
-    ztot_half = ztot/2;
-
+#pragma omp parallel for reduction(+:nContrib, nTot) schedule(static)
     for (i = 0; i < nWindows; ++i)
     {
+        int      j, k;
+        double   contrib1, contrib2, fac1, fac2;
+        gmx_bool bAnyContrib;
+
         if (!window[i].bContrib)
         {
             snew(window[i].bContrib, window[i].nPull);
         }
+        if (!window[i].boltzContrib)
+        {
+            snew(window[i].boltzContrib, window[i].nPull);
+        }
         for (j = 0; j < window[i].nPull; ++j)
         {
             if (!window[i].bContrib[j])
             {
                 snew(window[i].bContrib[j], opt->bins);
             }
+            if (!window[i].boltzContrib[j])
+            {
+                snew(window[i].boltzContrib[j], opt->bins);
+            }
+            fac1        = exp(-window[i].boltzShift[j]);
+            fac2        = window[i].N[j]*exp(window[i].z[j] - window[i].boltzShift[j]);
             bAnyContrib = FALSE;
             for (k = 0; k < opt->bins; ++k)
             {
-                temp     = (1.0*k+0.5)*dz+min;
-                distance = temp - window[i].pos[j];   /* distance to umbrella center */
-                if (opt->bCycl)
-                {                                     /* in cyclic wham:             */
-                    if (distance > ztot_half)         /*    |distance| < ztot_half   */
-                    {
-                        distance -= ztot;
-                    }
-                    else if (distance < -ztot_half)
-                    {
-                        distance += ztot;
-                    }
-                }
                 /* Note: there are two contributions to bin k in the wham equations:
                    i)  N[j]*exp(- U/(8.314e-3*opt->Temperature) + window[i].z[j])
                    ii) exp(- U/(8.314e-3*opt->Temperature))
                    where U is the umbrella potential
                    If any of these number is larger wham_contrib_lim, I set contrib=TRUE
                  */
-
-                if (!opt->bTab)
-                {
-                    U = 0.5*window[i].k[j]*sqr(distance);       /* harmonic potential assumed. */
-                }
-                else
-                {
-                    U = tabulated_pot(distance, opt);            /* Use tabulated potential     */
-
-                }
-                contrib1                 = profile[k]*exp(-U/(8.314e-3*opt->Temperature));
-                contrib2                 = window[i].N[j]*exp(-U/(8.314e-3*opt->Temperature) + window[i].z[j]);
+                contrib1                 = profile[k]*window[i].boltz[j][k]*fac1;
+                contrib2                 = window[i].boltz[j][k]*fac2;
                 window[i].bContrib[j][k] = (contrib1 > wham_contrib_lim || contrib2 > wham_contrib_lim);
                 bAnyContrib              = (bAnyContrib | window[i].bContrib[j][k]);
                 if (window[i].bContrib[j][k])
@@ -899,12 +990,18 @@ void setup_acc_wham(double *profile, t_UmbrellaWindow * window, int nWindows,
                     window[i].bContrib[j][k] = TRUE;
                 }
             }
+            for (k = 0; k < opt->bins; ++k)
+            {
+                window[i].boltzContrib[j][k] = window[i].bContrib[j][k] ? window[i].boltz[j][k] : 0;
+            }
         }
     }
     if (bFirst)
     {
         printf("Initialized rapid wham stuff (contrib tolerance %g)\n"
                "Evaluating only %d of %d expressions.\n\n", wham_contrib_lim, nContrib, nTot);
+        /* Only written here, so later calls from parallel bootstraps only read */
+        bFirst = 0;
     }
 
     if (opt->verbose)
@@ -912,127 +1009,106 @@ void setup_acc_wham(double *profile, t_UmbrellaWindow * window, int nWindows,
         printf("Updated rapid wham stuff. (evaluating only %d of %d contributions)\n",
                nContrib, nTot);
     }
-    bFirst = 0;
 }
 
-//! Compute the PMF (one of the two main WHAM routines)
+/*! \brief Compute the PMF (one of the two main WHAM routines)
+ *
+ * The bins are divided in blocks over the threads. For each block we loop
+ * over the histograms and update the contiguous range of bins, using the
+ * precomputed Boltzmann factors, so the inner loops vectorize.
+ */
 void calc_profile(double *profile, t_UmbrellaWindow * window, int nWindows,
                   t_UmbrellaOptions *opt, gmx_bool bExact)
 {
-    int    i, k, j;
-    double num, ztot_half, ztot, distance, min = opt->min, dz = opt->dz;
-    double denom, U = 0, temp = 0, invg;
+    int nblocks, b;
 
-    ztot      = opt->max-opt->min;
-    ztot_half = ztot/2;
-
-    for (i = 0; i < opt->bins; ++i)
+    nblocks = (opt->bins + c_whamBinBlockSize - 1)/c_whamBinBlockSize;
+#pragma omp parallel for schedule(static)
+    for (b = 0; b < nblocks; b++)
     {
-        num = denom = 0.;
+        int           i, k, j, ibStart, ibEnd;
+        double        invg, fac, denom[c_whamBinBlockSize];
+        const double *histo, *boltz;
+
+        ibStart = b*c_whamBinBlockSize;
+        ibEnd   = std::min(ibStart + c_whamBinBlockSize, opt->bins);
+
+        for (i = ibStart; i < ibEnd; ++i)
+        {
+            profile[i]         = 0;
+            denom[i - ibStart] = 0;
+        }
         for (j = 0; j < nWindows; ++j)
         {
             for (k = 0; k < window[j].nPull; ++k)
             {
-                invg = 1.0/window[j].g[k] * window[j].bsWeight[k];
-                temp = (1.0*i+0.5)*dz+min;
-                num += invg*window[j].Histo[k][i];
-
-                if (!(bExact || window[j].bContrib[k][i]))
+                invg  = 1.0/window[j].g[k] * window[j].bsWeight[k];
+                fac   = invg*window[j].N[k]*exp(window[j].z[k] - window[j].boltzShift[k]);
+                histo = window[j].Histo[k];
+                boltz = bExact ? window[j].boltz[k] : window[j].boltzContrib[k];
+                for (i = ibStart; i < ibEnd; ++i)
                 {
-                    continue;
+                    profile[i]         += invg*histo[i];
+                    denom[i - ibStart] += fac*boltz[i];
                 }
-                distance = temp - window[j].pos[k];   /* distance to umbrella center */
-                if (opt->bCycl)
-                {                                     /* in cyclic wham:             */
-                    if (distance > ztot_half)         /*    |distance| < ztot_half   */
-                    {
-                        distance -= ztot;
-                    }
-                    else if (distance < -ztot_half)
-                    {
-                        distance += ztot;
-                    }
-                }
-
-                if (!opt->bTab)
-                {
-                    U = 0.5*window[j].k[k]*sqr(distance);       /* harmonic potential assumed. */
-                }
-                else
-                {
-                    U = tabulated_pot(distance, opt);            /* Use tabulated potential     */
-                }
-                denom += invg*window[j].N[k]*exp(-U/(8.314e-3*opt->Temperature) + window[j].z[k]);
             }
         }
-        profile[i] = num/denom;
+        for (i = ibStart; i < ibEnd; ++i)
+        {
+            profile[i] /= denom[i - ibStart];
+        }
     }
 }
 
 //! Compute the free energy offsets z (one of the two main WHAM routines)
 double calc_z(double * profile, t_UmbrellaWindow * window, int nWindows,
-              t_UmbrellaOptions *opt, gmx_bool bExact)
+              gmx_bool bExact)
 {
-    int    i, j, k;
-    double U   = 0, min = opt->min, dz = opt->dz, temp, ztot_half, distance, ztot;
-    double MAX = -1e20, total = 0;
-
-    ztot      = opt->max-opt->min;
-    ztot_half = ztot/2;
+    int     i;
+    double  MAX = -1e20, *change;
 
+    snew(change, nWindows);
+#pragma omp parallel for schedule(static)
     for (i = 0; i < nWindows; ++i)
     {
+        int           j, k;
+        double        total, temp;
+        const double *boltz;
+
         for (j = 0; j < window[i].nPull; ++j)
         {
+            boltz = bExact ? window[i].boltz[j] : window[i].boltzContrib[j];
             total = 0;
             for (k = 0; k < window[i].nBin; ++k)
             {
-                if (!(bExact || window[i].bContrib[j][k]))
-                {
-                    continue;
-                }
-                temp     = (1.0*k+0.5)*dz+min;
-                distance = temp - window[i].pos[j];   /* distance to umbrella center */
-                if (opt->bCycl)
-                {                                     /* in cyclic wham:             */
-                    if (distance > ztot_half)         /*    |distance| < ztot_half   */
-                    {
-                        distance -= ztot;
-                    }
-                    else if (distance < -ztot_half)
-                    {
-                        distance += ztot;
-                    }
-                }
-
-                if (!opt->bTab)
-                {
-                    U = 0.5*window[i].k[j]*sqr(distance);       /* harmonic potential assumed. */
-                }
-                else
-                {
-                    U = tabulated_pot(distance, opt);            /* Use tabulated potential     */
-
-                }
-                total += profile[k]*exp(-U/(8.314e-3*opt->Temperature));
+                total += profile[k]*boltz[k];
             }
             /* Avoid floating point exception if window is far outside min and max */
             if (total != 0.0)
             {
-                total = -log(total);
+                total = window[i].boltzShift[j] - log(total);
             }
             else
             {
                 total = 1000.0;
             }
             temp = fabs(total - window[i].z[j]);
-            if (temp > MAX)
+            if (temp > change[i])
             {
-                MAX = temp;
+                change[i] = temp;
             }
             window[i].z[j] = total;
         }
     }
+    for (i = 0; i < nWindows; ++i)
+    {
+        if (change[i] > MAX)
+        {
+            MAX = change[i];
+        }
+    }
+    sfree(change);
+
     return MAX;
 }
 
@@ -1188,10 +1264,11 @@ void copy_pullgrp_to_synthwindow(t_UmbrellaWindow *synthWindow,
     synthWindow->Histo   [0] = thisWindow->Histo    [pullid];
     synthWindow->pos     [0] = thisWindow->pos      [pullid];
     synthWindow->z       [0] = thisWindow->z        [pullid];
-    synthWindow->k       [0] = thisWindow->k        [pullid];
-    synthWindow->bContrib[0] = thisWindow->bContrib [pullid];
-    synthWindow->g       [0] = thisWindow->g        [pullid];
-    synthWindow->bsWeight[0] = thisWindow->bsWeight [pullid];
+    synthWindow->k         [0] = thisWindow->k          [pullid];
+    synthWindow->boltz     [0] = thisWindow->boltz      [pullid];
+    synthWindow->boltzShift[0] = thisWindow->boltzShift [pullid];
+    synthWindow->g         [0] = thisWindow->g          [pullid];
+    synthWindow->bsWeight  [0] = thisWindow->bsWeight   [pullid];
 }
 
 /*! \brief Calculate cumulative distribution function of of all histograms.
@@ -1299,7 +1376,7 @@ void searchCumulative(double xx[], int n, double x, int *j)
 
 //! Bootstrap new trajectories and thereby generate new (bootstrapped) histograms
 void create_synthetic_histo(t_UmbrellaWindow *synthWindow, t_UmbrellaWindow *thisWindow,
-                            int pullid, t_UmbrellaOptions *opt)
+                            int pullid, t_UmbrellaOptions *opt, gmx_rng_t rng)
 {
     int    N, i, nbins, r_index, ibin;
     double r, tausteps = 0.0, a, ap, dt, x, invsqrt2, g, y, sig = 0., z, mu = 0.;
@@ -1336,13 +1413,14 @@ void create_synthetic_histo(t_UmbrellaWindow *synthWindow, t_UmbrellaWindow *thi
         gmx_fatal(FARGS, errstr);
     }
 
-    synthWindow->N       [0] = N;
-    synthWindow->pos     [0] = thisWindow->pos[pullid];
-    synthWindow->z       [0] = thisWindow->z[pullid];
-    synthWindow->k       [0] = thisWindow->k[pullid];
-    synthWindow->bContrib[0] = thisWindow->bContrib[pullid];
-    synthWindow->g       [0] = thisWindow->g       [pullid];
-    synthWindow->bsWeight[0] = thisWindow->bsWeight[pullid];
+    synthWindow->N         [0] = N;
+    synthWindow->pos       [0] = thisWindow->pos[pullid];
+    synthWindow->z         [0] = thisWindow->z[pullid];
+    synthWindow->k         [0] = thisWindow->k[pullid];
+    synthWindow->boltz     [0] = thisWindow->boltz     [pullid];
+    synthWindow->boltzShift[0] = thisWindow->boltzShift[pullid];
+    synthWindow->g         [0] = thisWindow->g         [pullid];
+    synthWindow->bsWeight  [0] = thisWindow->bsWeight  [pullid];
 
     for (i = 0; i < nbins; i++)
     {
@@ -1376,14 +1454,14 @@ void create_synthetic_histo(t_UmbrellaWindow *synthWindow, t_UmbrellaWindow *thi
     invsqrt2 = 1./sqrt(2.0);
 
     /* init random sequence */
-    x = gmx_rng_gaussian_table(opt->rng);
+    x = gmx_rng_gaussian_table(rng);
 
     if (opt->bsMethod == bsMethod_traj)
     {
         /* bootstrap points from the umbrella histograms */
         for (i = 0; i < N; i++)
         {
-            y = gmx_rng_gaussian_table(opt->rng);
+            y = gmx_rng_gaussian_table(rng);
             x = a*x+ap*y;
             /* get flat distribution in [0,1] using cumulative distribution function of Gauusian
                Note: CDF(Gaussian) = 0.5*{1+erf[x/sqrt(2)]}
@@ -1403,7 +1481,7 @@ void create_synthetic_histo(t_UmbrellaWindow *synthWindow, t_UmbrellaWindow *thi
         i = 0;
         while (i < N)
         {
-            y    = gmx_rng_gaussian_table(opt->rng);
+            y    = gmx_rng_gaussian_table(rng);
             x    = a*x+ap*y;
             z    = x*sig+mu;
             ibin = static_cast<int> (floor((z-opt->min)/opt->dz));
@@ -1510,7 +1588,7 @@ int func_wham_is_larger(const void *a, const void *b)
 }
 
 //! Make random weights for histograms for the Bayesian bootstrap of complete histograms)
-void setRandomBsWeights(t_UmbrellaWindow *synthwin, int nAllPull, t_UmbrellaOptions *opt)
+void setRandomBsWeights(t_UmbrellaWindow *synthwin, int nAllPull, gmx_rng_t rng)
 {
     int     i;
     double *r;
@@ -1520,7 +1598,7 @@ void setRandomBsWeights(t_UmbrellaWindow *synthwin, int nAllPull, t_UmbrellaOpti
     /* generate ordered random numbers between 0 and nAllPull  */
     for (i = 0; i < nAllPull-1; i++)
     {
-        r[i] = gmx_rng_uniform_real(opt->rng) * nAllPull;
+        r[i] = gmx_rng_uniform_real(rng) * nAllPull;
     }
     qsort((void *)r, nAllPull-1, sizeof(double), &func_wham_is_larger);
     r[nAllPull-1] = 1.0*nAllPull;
@@ -1543,29 +1621,66 @@ void setRandomBsWeights(t_UmbrellaWindow *synthwin, int nAllPull, t_UmbrellaOpti
     sfree(r);
 }
 
-//! The main bootstrapping routine
+/*! \brief Allocate the synthetic windows of one bootstrap replicate
+ *
+ * Each synthetic window contains one histogram. Everything that is modified
+ * during a bootstrap gets its own storage, so replicates can run concurrently.
+ */
+t_UmbrellaWindow *initSynthWindows(int nAllPull, t_UmbrellaOptions *opt)
+{
+    t_UmbrellaWindow *synthWindow;
+    int               i;
+
+    synthWindow = initUmbrellaWindows(nAllPull);
+    for (i = 0; i < nAllPull; i++)
+    {
+        synthWindow[i].nPull = 1;
+        synthWindow[i].nBin  = opt->bins;
+        snew(synthWindow[i].Histo, 1);
+        if (opt->bsMethod == bsMethod_traj || opt->bsMethod == bsMethod_trajGauss)
+        {
+            snew(synthWindow[i].Histo[0], opt->bins);
+        }
+        snew(synthWindow[i].N, 1);
+        snew(synthWindow[i].pos, 1);
+        snew(synthWindow[i].z, 1);
+        snew(synthWindow[i].k, 1);
+        snew(synthWindow[i].boltz, 1);
+        snew(synthWindow[i].boltzShift, 1);
+        snew(synthWindow[i].g, 1);
+        snew(synthWindow[i].bsWeight, 1);
+    }
+    return synthWindow;
+}
+
+/*! \brief The main bootstrapping routine
+ *
+ * The bootstrap replicates are distributed over the threads. Each replicate
+ * draws its random numbers from its own generator, seeded with the bootstrap
+ * seed and the replicate index, so the results do not depend on the number
+ * of threads.
+ */
 void do_bootstrapping(const char *fnres, const char* fnprof, const char *fnhist,
                       char* ylabel, double *profile,
                       t_UmbrellaWindow * window, int nWindows, t_UmbrellaOptions *opt)
 {
-    t_UmbrellaWindow * synthWindow;
-    double            *bsProfile, *bsProfiles_av, *bsProfiles_av2, maxchange = 1e20, tmp, stddev;
-    int                i, j, *randomArray = 0, winid, pullid, ib;
+    double            *bsProfiles, *bsProfiles_av, *bsProfiles_av2, tmp, stddev;
+    int                i, j, ib;
     int                iAllPull, nAllPull, *allPull_winId, *allPull_pullId;
+    unsigned int       seed;
     FILE              *fp;
-    gmx_bool           bExact = FALSE;
 
     /* init random generator */
     if (opt->bsSeed == -1)
     {
-        opt->rng = gmx_rng_init(gmx_rng_make_seed());
+        seed = gmx_rng_make_seed();
     }
     else
     {
-        opt->rng = gmx_rng_init(opt->bsSeed);
+        seed = opt->bsSeed;
     }
 
-    snew(bsProfile,     opt->bins);
+    snew(bsProfiles, opt->nBootStrap*opt->bins);
     snew(bsProfiles_av, opt->bins);
     snew(bsProfiles_av2, opt->bins);
 
@@ -1591,41 +1706,13 @@ void do_bootstrapping(const char *fnres, const char* fnprof, const char *fnhist,
         }
     }
 
-    /* setup stuff for synthetic windows */
-    snew(synthWindow, nAllPull);
-    for (i = 0; i < nAllPull; i++)
-    {
-        synthWindow[i].nPull = 1;
-        synthWindow[i].nBin  = opt->bins;
-        snew(synthWindow[i].Histo, 1);
-        if (opt->bsMethod == bsMethod_traj || opt->bsMethod == bsMethod_trajGauss)
-        {
-            snew(synthWindow[i].Histo[0], opt->bins);
-        }
-        snew(synthWindow[i].N, 1);
-        snew(synthWindow[i].pos, 1);
-        snew(synthWindow[i].z, 1);
-        snew(synthWindow[i].k, 1);
-        snew(synthWindow[i].bContrib, 1);
-        snew(synthWindow[i].g, 1);
-        snew(synthWindow[i].bsWeight, 1);
-    }
-
     switch (opt->bsMethod)
     {
         case bsMethod_hist:
-            snew(randomArray, nAllPull);
             printf("\n\nWhen computing statistical errors by bootstrapping entire histograms:\n");
             please_cite(stdout, "Hub2006");
             break;
         case bsMethod_BayesianHist:
-            /* just copy all histogams into synthWindow array */
-            for (i = 0; i < nAllPull; i++)
-            {
-                winid  = allPull_winId [i];
-                pullid = allPull_pullId[i];
-                copy_pullgrp_to_synthwindow(synthWindow+i, window+winid, pullid);
-            }
             break;
         case bsMethod_traj:
         case bsMethod_trajGauss:
@@ -1636,88 +1723,140 @@ void do_bootstrapping(const char *fnres, const char* fnprof, const char *fnhist,
     }
 
     /* do bootstrapping */
-    fp = xvgropen(fnprof, "Boot strap profiles", xlabel, ylabel, opt->oenv);
-    for (ib = 0; ib < opt->nBootStrap; ib++)
+#pragma omp parallel
     {
-        printf("  *******************************************\n"
-               "  ******** Start bootstrap nr %d ************\n"
-               "  *******************************************\n", ib+1);
-
-        switch (opt->bsMethod)
+        try
         {
-            case bsMethod_hist:
-                /* bootstrap complete histograms from given histograms */
-                getRandomIntArray(nAllPull, opt->histBootStrapBlockLength, randomArray, opt->rng);
-                for (i = 0; i < nAllPull; i++)
+            t_UmbrellaWindow *synthWindow;
+            double           *bsProfile, maxchange;
+            int              *randomArray = 0, winid, pullid, iter, ipull;
+            unsigned int      bsSeed[2];
+            gmx_rng_t         rng;
+            gmx_bool          bExact;
+
+            /* setup stuff for synthetic windows */
+            synthWindow = initSynthWindows(nAllPull, opt);
+            if (opt->bsMethod == bsMethod_hist)
+            {
+                snew(randomArray, nAllPull);
+            }
+
+#pragma omp for schedule(dynamic)
+            for (ib = 0; ib < opt->nBootStrap; ib++)
+            {
+                printf("  *******************************************\n"
+                       "  ******** Start bootstrap nr %d ************\n"
+                       "  *******************************************\n", ib+1);
+
+                bsSeed[0] = seed;
+                bsSeed[1] = ib;
+                rng       = gmx_rng_init_array(bsSeed, 2);
+
+                switch (opt->bsMethod)
                 {
-                    winid  = allPull_winId [randomArray[i]];
-                    pullid = allPull_pullId[randomArray[i]];
-                    copy_pullgrp_to_synthwindow(synthWindow+i, window+winid, pullid);
+                    case bsMethod_hist:
+                        /* bootstrap complete histograms from given histograms */
+                        getRandomIntArray(nAllPull, opt->histBootStrapBlockLength, randomArray, rng);
+                        for (ipull = 0; ipull < nAllPull; ipull++)
+                        {
+                            winid  = allPull_winId [randomArray[ipull]];
+                            pullid = allPull_pullId[randomArray[ipull]];
+                            copy_pullgrp_to_synthwindow(synthWindow+ipull, window+winid, pullid);
+                        }
+                        break;
+                    case bsMethod_BayesianHist:
+                        /* keep histos, but assign random weights ("Bayesian bootstrap").
+                           The copy also resets z, so each bootstrap starts from the same guess. */
+                        for (ipull = 0; ipull < nAllPull; ipull++)
+                        {
+                            winid  = allPull_winId [ipull];
+                            pullid = allPull_pullId[ipull];
+                            copy_pullgrp_to_synthwindow(synthWindow+ipull, window+winid, pullid);
+                        }
+                        setRandomBsWeights(synthWindow, nAllPull, rng);
+                        break;
+                    case bsMethod_traj:
+                    case bsMethod_trajGauss:
+                        /* create new histos from given histos, that is generate new hypothetical
+                           trajectories */
+                        for (ipull = 0; ipull < nAllPull; ipull++)
+                        {
+                            winid  = allPull_winId[ipull];
+                            pullid = allPull_pullId[ipull];
+                            create_synthetic_histo(synthWindow+ipull, window+winid, pullid, opt, rng);
+                        }
+                        break;
                 }
-                break;
-            case bsMethod_BayesianHist:
-                /* keep histos, but assign random weights ("Bayesian bootstrap") */
-                setRandomBsWeights(synthWindow, nAllPull, opt);
-                break;
-            case bsMethod_traj:
-            case bsMethod_trajGauss:
-                /* create new histos from given histos, that is generate new hypothetical
-                   trajectories */
-                for (i = 0; i < nAllPull; i++)
+                gmx_rng_destroy(rng);
+
+                /* write histos in case of verbose output */
+                if (opt->bs_verbose)
                 {
-                    winid  = allPull_winId[i];
-                    pullid = allPull_pullId[i];
-                    create_synthetic_histo(synthWindow+i, window+winid, pullid, opt);
+#pragma omp critical
+                    print_histograms(fnhist, synthWindow, nAllPull, ib, opt);
                 }
-                break;
-        }
 
-        /* write histos in case of verbose output */
-        if (opt->bs_verbose)
-        {
-            print_histograms(fnhist, synthWindow, nAllPull, ib, opt);
-        }
+                /* do wham */
+                iter      = 0;
+                bExact    = FALSE;
+                maxchange = 1e20;
+                bsProfile = bsProfiles + ib*opt->bins;
+                memcpy(bsProfile, profile, opt->bins*sizeof(double)); /* use profile as guess */
+                do
+                {
+                    if ( (iter%opt->stepUpdateContrib) == 0)
+                    {
+                        setup_acc_wham(bsProfile, synthWindow, nAllPull, opt);
+                    }
+                    if (maxchange < opt->Tolerance)
+                    {
+                        bExact = TRUE;
+                    }
+                    if (((iter%opt->stepchange) == 0 || iter == 1) && iter != 0)
+                    {
+                        printf("\t%4d) Maximum change %e\n", iter, maxchange);
+                    }
+                    calc_profile(bsProfile, synthWindow, nAllPull, opt, bExact);
+                    iter++;
+                }
+                while ( (maxchange = calc_z(bsProfile, synthWindow, nAllPull, bExact)) > opt->Tolerance || !bExact);
+                printf("\tConverged bootstrap nr %d in %d iterations. Final maximum change %g\n",
+                       ib+1, iter, maxchange);
 
-        /* do wham */
-        i         = 0;
-        bExact    = FALSE;
-        maxchange = 1e20;
-        memcpy(bsProfile, profile, opt->bins*sizeof(double)); /* use profile as guess */
-        do
-        {
-            if ( (i%opt->stepUpdateContrib) == 0)
-            {
-                setup_acc_wham(bsProfile, synthWindow, nAllPull, opt);
-            }
-            if (maxchange < opt->Tolerance)
-            {
-                bExact = TRUE;
+                if (opt->bLog)
+                {
+                    prof_normalization_and_unit(bsProfile, opt);
+                }
+
+                /* symmetrize profile around z=0 */
+                if (opt->bSym)
+                {
+                    symmetrizeProfile(bsProfile, opt);
+                }
             }
-            if (((i%opt->stepchange) == 0 || i == 1) && i != 0)
+
+            /* The histograms and Boltzmann factors are owned by the real windows */
+            for (ipull = 0; ipull < nAllPull; ipull++)
             {
-                printf("\t%4d) Maximum change %e\n", i, maxchange);
+                if (opt->bsMethod == bsMethod_hist || opt->bsMethod == bsMethod_BayesianHist)
+                {
+                    synthWindow[ipull].Histo[0] = 0;
+                }
+                synthWindow[ipull].boltz[0] = 0;
             }
-            calc_profile(bsProfile, synthWindow, nAllPull, opt, bExact);
-            i++;
-        }
-        while ( (maxchange = calc_z(bsProfile, synthWindow, nAllPull, opt, bExact)) > opt->Tolerance || !bExact);
-        printf("\tConverged in %d iterations. Final maximum change %g\n", i, maxchange);
-
-        if (opt->bLog)
-        {
-            prof_normalization_and_unit(bsProfile, opt);
-        }
-
-        /* symmetrize profile around z=0 */
-        if (opt->bSym)
-        {
-            symmetrizeProfile(bsProfile, opt);
+            freeUmbrellaWindows(synthWindow, nAllPull);
+            sfree(randomArray);
         }
+        GMX_CATCH_ALL_AND_EXIT_WITH_FATAL_ERROR;
+    }
 
-        /* save stuff to get average and stddev */
+    /* save stuff to get average and stddev */
+    fp = xvgropen(fnprof, "Boot strap profiles", xlabel, ylabel, opt->oenv);
+    for (ib = 0; ib < opt->nBootStrap; ib++)
+    {
         for (i = 0; i < opt->bins; i++)
         {
-            tmp                = bsProfile[i];
+            tmp                = bsProfiles[ib*opt->bins + i];
             bsProfiles_av[i]  += tmp;
             bsProfiles_av2[i] += tmp*tmp;
             fprintf(fp, "%e\t%e\n", (i+0.5)*opt->dz+opt->min, tmp);
@@ -1742,6 +1881,12 @@ void do_bootstrapping(const char *fnres, const char* fnprof, const char *fnhist,
     }
     gmx_ffclose(fp);
     printf("Wrote boot strap result to %s\n", fnres);
+
+    sfree(bsProfiles);
+    sfree(bsProfiles_av);
+    sfree(bsProfiles_av2);
+    sfree(allPull_winId);
+    sfree(allPull_pullId);
 }
 
 //! Return type of input file based on file extension (xvg, pdo, or tpr)
@@ -3012,7 +3157,7 @@ void guessPotByIntegration(t_UmbrellaWindow *window, int nWindows, t_UmbrellaOpt
     {
         pot[j] = exp(-pot[j]/(8.314e-3*opt->Temperature));
     }
-    calc_z(pot, window, nWindows, opt, TRUE);
+    calc_z(pot, window, nWindows, TRUE);
 
     sfree(pot);
     sfree(f);
@@ -3247,6 +3392,9 @@ int gmx_wham(int argc, char *argv[])
         "not bootstrapped from the umbrella histograms but from Gaussians with the average ",
         "and width of the umbrella histograms. That method yields similar error estimates ",
         "like method [TT]traj[tt].[PAR]"
+        "The bootstraps are distributed over the available OpenMP threads. Each bootstrap ",
+        "uses its own random number sequence, derived from [TT]-bs-seed[tt] and the ",
+        "bootstrap index, so the results do not depend on the number of threads.[PAR]",
         "Bootstrapping output:[BR]",
         "  [TT]-bsres[tt]   Average profile and standard deviations[BR]",
         "  [TT]-bsprof[tt]  All bootstrapping profiles[BR]",
@@ -3552,6 +3700,9 @@ int gmx_wham(int argc, char *argv[])
         averageSigma(window, nwins);
     }
 
+    /* Umbrella potentials do not change during WHAM, compute their Boltzmann factors once */
+    setup_boltzmann_factors(window, nwins, &opt);
+
     /* Get initial potential by simple integration */
     if (opt.bInitPotByIntegration)
     {
@@ -3587,7 +3738,7 @@ int gmx_wham(int argc, char *argv[])
         }
         i++;
     }
-    while ( (maxchange = calc_z(profile, window, nwins, &opt, bExact)) > opt.Tolerance || !bExact);
+    while ( (maxchange = calc_z(profile, window, nwins, bExact)) > opt.Tolerance || !bExact);
     printf("Converged in %d iterations. Final maximum change %g\n", i, maxchange);
 
     /* calc error from Kumar's formula */
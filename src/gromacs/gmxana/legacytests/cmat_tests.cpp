@@ -0,0 +1,230 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2013,2014, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+/*! \internal \file
+ * \brief
+ * Tests for the RMSD matrix used by gmx cluster
+ */
+
+#include "gmxpre.h"
+
+#include "gromacs/gmxana/cmat.h"
+
+#include <cmath>
+
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "gromacs/math/do_fit.h"
+#include "gromacs/math/vec.h"
+#include "gromacs/random/random.h"
+#include "gromacs/utility/smalloc.h"
+
+namespace
+{
+
+//! Number of frames, sufficient to span several RMSD tiles
+const int c_numFrames = 40;
+//! Number of atoms, not a multiple of the SIMD width
+const int c_numAtoms  = 23;
+
+/*! \brief Test fixture with randomly rotated and perturbed frames
+ *
+ * All frames are centered on their center of mass.
+ */
+class RmsdMatrixTest : public ::testing::Test
+{
+    public:
+        RmsdMatrixTest() : rms_(NULL)
+        {
+            gmx_rng_t rng = gmx_rng_init(1234);
+            rvec      x0[c_numAtoms];
+
+            mass_.resize(c_numAtoms);
+            for (int a = 0; a < c_numAtoms; a++)
+            {
+                mass_[a] = 1 + 15*gmx_rng_uniform_real(rng);
+                for (int d = 0; d < DIM; d++)
+                {
+                    x0[a][d] = 2*gmx_rng_uniform_real(rng);
+                }
+            }
+            snew(xx_, c_numFrames);
+            for (int f = 0; f < c_numFrames; f++)
+            {
+                real  phi   = 2*M_PI*gmx_rng_uniform_real(rng);
+                real  theta = M_PI*gmx_rng_uniform_real(rng);
+                real  psi   = 2*M_PI*gmx_rng_uniform_real(rng);
+                rvec  xp;
+
+                snew(xx_[f], c_numAtoms);
+                for (int a = 0; a < c_numAtoms; a++)
+                {
+                    /* Perturb and rotate around z, y and z */
+                    for (int d = 0; d < DIM; d++)
+                    {
+                        xp[d] = x0[a][d] + 0.2*(gmx_rng_uniform_real(rng) - 0.5);
+                    }
+                    rotateZ(xp, phi);
+                    rotateY(xp, theta);
+                    rotateZ(xp, psi);
+                    copy_rvec(xp, xx_[f][a]);
+                }
+                reset_x(c_numAtoms, NULL, c_numAtoms, NULL, xx_[f], &mass_[0]);
+            }
+            gmx_rng_destroy(rng);
+        }
+
+        ~RmsdMatrixTest()
+        {
+            for (int f = 0; f < c_numFrames; f++)
+            {
+                sfree(xx_[f]);
+            }
+            sfree(xx_);
+            if (rms_ != NULL)
+            {
+                done_mat(&rms_);
+            }
+        }
+
+        //! Rotates x by angle around the z-axis
+        static void rotateZ(rvec x, real angle)
+        {
+            real x0 = x[XX];
+
+            x[XX] = std::cos(angle)*x0 - std::sin(angle)*x[YY];
+            x[YY] = std::sin(angle)*x0 + std::cos(angle)*x[YY];
+        }
+
+        //! Rotates x by angle around the y-axis
+        static void rotateY(rvec x, real angle)
+        {
+            real x0 = x[XX];
+
+            x[XX] = std::cos(angle)*x0 + std::sin(angle)*x[ZZ];
+            x[ZZ] = -std::sin(angle)*x0 + std::cos(angle)*x[ZZ];
+        }
+
+        //! Computes the RMSD matrix
+        void calcMatrix(gmx_bool bFit)
+        {
+            rms_ = init_mat(c_numFrames);
+            calc_rmsd_matrix(c_numFrames, c_numAtoms, xx_, &mass_[0], bFit, rms_);
+        }
+
+        //! Returns the RMSD between frames f1 and f2 after do_fit
+        real fitRmsd(int f1, int f2)
+        {
+            rvec x2[c_numAtoms];
+
+            for (int a = 0; a < c_numAtoms; a++)
+            {
+                copy_rvec(xx_[f2][a], x2[a]);
+            }
+            do_fit(c_numAtoms, &mass_[0], xx_[f1], x2);
+
+            return rmsdev(c_numAtoms, &mass_[0], xx_[f1], x2);
+        }
+
+        std::vector<real>  mass_;
+        rvec             **xx_;
+        t_mat             *rms_;
+};
+
+TEST_F(RmsdMatrixTest, QcpMatchesFitRmsd)
+{
+    calcMatrix(TRUE);
+    ASSERT_EQ(c_numFrames, rms_->nn);
+    for (int f1 = 0; f1 < c_numFrames; f1++)
+    {
+        EXPECT_EQ(0, mat_entry(rms_, f1, f1));
+        for (int f2 = f1 + 1; f2 < c_numFrames; f2++)
+        {
+            real ref = fitRmsd(f1, f2);
+
+            EXPECT_NEAR(ref, mat_entry(rms_, f1, f2), 1e-4*ref)
+            << "frames " << f1 << " " << f2;
+            EXPECT_EQ(mat_entry(rms_, f1, f2), mat_entry(rms_, f2, f1));
+        }
+    }
+}
+
+TEST_F(RmsdMatrixTest, NoFitMatchesRmsdev)
+{
+    calcMatrix(FALSE);
+    for (int f1 = 0; f1 < c_numFrames; f1++)
+    {
+        for (int f2 = f1 + 1; f2 < c_numFrames; f2++)
+        {
+            real ref = rmsdev(c_numAtoms, &mass_[0], xx_[f1], xx_[f2]);
+
+            EXPECT_NEAR(ref, mat_entry(rms_, f1, f2), 1e-5*ref)
+            << "frames " << f1 << " " << f2;
+            EXPECT_EQ(mat_entry(rms_, f1, f2), mat_entry(rms_, f2, f1));
+        }
+    }
+}
+
+TEST_F(RmsdMatrixTest, SwapRowsPermutesMatrix)
+{
+    const int iswap = 3;
+    const int jswap = 17;
+
+    calcMatrix(TRUE);
+    t_mat *orig = init_mat(c_numFrames);
+    orig->nn = c_numFrames;
+    copy_t_mat(orig, rms_);
+    swap_rows(rms_, iswap, jswap);
+
+    std::vector<int> perm(c_numFrames);
+    for (int f = 0; f < c_numFrames; f++)
+    {
+        perm[f] = f;
+    }
+    perm[iswap] = jswap;
+    perm[jswap] = iswap;
+    for (int f1 = 0; f1 < c_numFrames; f1++)
+    {
+        EXPECT_EQ(perm[f1], rms_->m_ind[f1]);
+        for (int f2 = 0; f2 < c_numFrames; f2++)
+        {
+            EXPECT_EQ(mat_entry(orig, perm[f1], perm[f2]), mat_entry(rms_, f1, f2));
+        }
+    }
+    done_mat(&orig);
+}
+
+} // namespace
@@ -0,0 +1,144 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2013,2014, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+/*! \internal \file
+ * \brief
+ * Tests for gmx rdf
+ */
+
+#include "gmxpre.h"
+
+#include <sstream>
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include "gromacs/gmxana/gmx_ana.h"
+#include "gromacs/gmxpreprocess/grompp.h"
+#include "gromacs/utility/file.h"
+
+#include "testutils/cmdlinetest.h"
+#include "testutils/integrationtests.h"
+
+namespace
+{
+
+/*! \brief Test fixture for the atomic rdf of two SPC waters
+ *
+ * The run input file provides the intra-molecular exclusions,
+ * so each atom has three atoms of the other water as neighbors.
+ */
+class GmxRdfExclusions : public gmx::test::IntegrationTestFixture
+{
+    public:
+        GmxRdfExclusions()
+            : tprFileName_(fileManager_.getTemporaryFilePath(".tpr")),
+              ndxFileName_(fileManager_.getTemporaryFilePath(".ndx"))
+        {
+        }
+
+        //! Generates the run input file and the index groups
+        void SetUp()
+        {
+            std::string mdpFileName = fileManager_.getTemporaryFilePath("input.mdp");
+            gmx::File::writeFileFromString(mdpFileName, "cutoff-scheme = Group\n");
+            /* The second group is not ordered by atom index */
+            gmx::File::writeFileFromString(ndxFileName_,
+                                           "[ Ordered ]\n1 2 3 4 5 6\n"
+                                           "[ Shuffled ]\n5 1 6 3 4 2\n");
+
+            gmx::test::CommandLine caller;
+            caller.append("grompp");
+            caller.addOption("-f", mdpFileName);
+            caller.addOption("-p", fileManager_.getInputFilePath("spc2.top"));
+            caller.addOption("-c", fileManager_.getInputFilePath("spc2.gro"));
+            caller.addOption("-po", fileManager_.getTemporaryFilePath("output.mdp"));
+            caller.addOption("-o", tprFileName_);
+            ASSERT_EQ(0, gmx_grompp(caller.argc(), caller.argv()));
+        }
+
+        /*! \brief Runs gmx rdf with group \p group as reference and selection
+         *
+         * Returns the cumulative number rdf, without the header.
+         */
+        std::string runRdf(const char *group)
+        {
+            std::string cnFileName = fileManager_.getTemporaryFilePath(
+                        std::string(group) + "_cn.xvg");
+
+            gmx::test::CommandLine caller;
+            caller.append("rdf");
+            caller.addOption("-s", tprFileName_);
+            caller.addOption("-f", fileManager_.getInputFilePath("spc2.gro"));
+            caller.addOption("-n", ndxFileName_);
+            caller.addOption("-o", fileManager_.getTemporaryFilePath(
+                                     std::string(group) + ".xvg"));
+            caller.addOption("-cn", cnFileName);
+
+            redirectStringToStdin((std::string(group) + "\n" + group + "\n").c_str());
+            EXPECT_EQ(0, gmx_rdf(caller.argc(), caller.argv()));
+
+            std::istringstream cn(gmx::File::readToString(cnFileName));
+            std::string        line, data;
+            while (std::getline(cn, line))
+            {
+                if (!line.empty() && line[0] != '#' && line[0] != '@')
+                {
+                    data += line + "\n";
+                }
+            }
+            return data;
+        }
+
+        std::string tprFileName_;
+        std::string ndxFileName_;
+};
+
+TEST_F(GmxRdfExclusions, ExcludesIntraMolecularPairs)
+{
+    std::string        data = runRdf("Ordered");
+    std::istringstream lastLine(data.substr(data.rfind('\n', data.size() - 2) + 1));
+    double             r, cn;
+
+    lastLine >> r >> cn;
+    ASSERT_FALSE(lastLine.fail());
+    EXPECT_NEAR(3.0, cn, 1e-4);
+}
+
+TEST_F(GmxRdfExclusions, HandlesUnorderedIndexGroup)
+{
+    EXPECT_EQ(runRdf("Ordered"), runRdf("Shuffled"));
+}
+
+} // namespace
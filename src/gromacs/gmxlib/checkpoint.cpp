@@ -76,6 +76,7 @@
 
 #define CPT_MAGIC1 171817
 #define CPT_MAGIC2 171819
+#define CPT_MAGIC_SHARD 171820
 #define CPTSTRLEN 1024
 
 #ifdef GMX_DOUBLE
@@ -90,7 +91,7 @@
  * But old code can not read a new entry that is present in the file
  * (but can read a new format when new entries are not present).
  */
-static const int cpt_version = 16;
+static const int cpt_version = 17;
 
 
 const char *est_names[estNR] =
@@ -152,6 +153,18 @@ enum {
     ecprREAL, ecprRVEC, ecprMATRIX
 };
 
+/* The distributed state entries that are stored in the shards
+ * of a sharded checkpoint, instead of in the checkpoint file itself.
+ */
+#define CPT_SHARD_FLAGS ((1<<estX) | (1<<estV) | (1<<estSDX))
+
+/* A shard of the distributed state, as listed in a sharded checkpoint */
+typedef struct
+{
+    char *name;   /* The shard file name, without directory */
+    int   natoms; /* The number of atoms in the shard */
+} t_cpt_shard;
+
 enum {
     cptpEST, cptpEEKS, cptpEENH, cptpEDFH
 };
@@ -772,7 +785,7 @@ static void do_cpt_header(XDR *xd, gmx_bool bRead, int *file_version,
                           int *natoms, int *ngtc, int *nnhpres, int *nhchainlength,
                           int *nlambda, int *flags_state,
                           int *flags_eks, int *flags_enh, int *flags_dfh,
-                          int *nED, int *eSwapCoords,
+                          int *nED, int *eSwapCoords, int *nshard,
                           FILE *list)
 {
     bool_t res = 0;
@@ -918,6 +931,14 @@ static void do_cpt_header(XDR *xd, gmx_bool bRead, int *file_version,
     {
         do_cpt_int_err(xd, "swap", eSwapCoords, list);
     }
+    if (*file_version >= 17)
+    {
+        do_cpt_int_err(xd, "#state shards", nshard, list);
+    }
+    else
+    {
+        *nshard = 0;
+    }
 }
 
 static int do_cpt_footer(XDR *xd, int file_version)
@@ -1451,29 +1472,407 @@ static int do_cpt_files(XDR *xd, gmx_bool bRead,
 }
 
 
-void write_checkpoint(const char *fn, gmx_bool bNumberAndKeep,
-                      FILE *fplog, t_commrec *cr,
-                      int eIntegrator, int simulation_part,
-                      gmx_bool bExpanded, int elamstats,
-                      gmx_int64_t step, double t, t_state *state)
+static int do_cpt_shards(XDR *xd, gmx_bool bRead,
+                         int nshard, t_cpt_shard **shards, FILE *list)
 {
-    t_fileio            *fp;
-    int                  file_version;
-    char                *version;
-    char                *btime;
-    char                *buser;
-    char                *bhost;
-    int                  double_prec;
-    char                *fprog;
-    char                *fntemp; /* the temporary checkpoint file name */
-    char                 timebuf[STRLEN];
-    int                  nppnodes, npmenodes;
-    char                 buf[1024], suffix[5+STEPSTRSIZE], sbuf[STEPSTRSIZE];
-    gmx_file_position_t *outputfiles;
-    int                  noutputfiles;
-    char                *ftime;
-    int                  flags_eks, flags_enh, flags_dfh;
-    t_fileio            *ret;
+    int i;
+
+    if (bRead)
+    {
+        snew(*shards, nshard);
+    }
+    for (i = 0; i < nshard; i++)
+    {
+        do_cpt_string_err(xd, bRead, "shard file", &(*shards)[i].name, list);
+        if (do_cpt_int(xd, "shard #atoms", &(*shards)[i].natoms, list) != 0)
+        {
+            return -1;
+        }
+    }
+    if (list && bRead)
+    {
+        /* The names have been freed by do_cpt_string_err */
+        sfree(*shards);
+        *shards = NULL;
+    }
+
+    return 0;
+}
+
+static void done_cpt_shards(int nshard, t_cpt_shard *shards)
+{
+    int i;
+
+    for (i = 0; i < nshard; i++)
+    {
+        sfree(shards[i].name);
+    }
+    sfree(shards);
+}
+
+/* Returns the name of shard file shard for a checkpoint file fn at step */
+static char *cpt_shard_filename(const char *fn, gmx_int64_t step, int shard)
+{
+    const char *ext;
+    char        sbuf[STEPSTRSIZE];
+    char       *name;
+
+    ext = fn + strlen(fn) - strlen(ftp2ext(fn2ftp(fn))) - 1;
+    snew(name, strlen(fn) + 5 + STEPSTRSIZE + 6 + STEPSTRSIZE);
+    sprintf(name, "%.*s_step%s_shard%d%s",
+            (int)(ext - fn), fn, gmx_step_str(step, sbuf), shard, ext);
+
+    return name;
+}
+
+/* Returns the length of the directory part of fn, including the separator */
+static int cpt_dirname_length(const char *fn)
+{
+    int len;
+
+    len = strlen(fn);
+    while (len > 0 && fn[len-1] != '/' && fn[len-1] != DIR_SEPARATOR)
+    {
+        len--;
+    }
+
+    return len;
+}
+
+/* Returns the path of shard file name, stored in checkpoint file fn */
+static char *cpt_shard_path(const char *fn, const char *name)
+{
+    char *path;
+    int   len;
+
+    len = cpt_dirname_length(fn);
+    snew(path, len + strlen(name) + 1);
+    sprintf(path, "%.*s%s", len, fn, name);
+
+    return path;
+}
+
+static rvec **cpt_shard_vector(t_state *state, int est)
+{
+    switch (est)
+    {
+        case estX:   return &state->x;
+        case estV:   return &state->v;
+        case estSDX: return &state->sd_X;
+        default:
+            gmx_incons("Unknown shard state entry");
+    }
+
+    return NULL;
+}
+
+static void do_cpt_shard_header(XDR *xd, gmx_bool bRead,
+                                int *file_version, gmx_int64_t *step,
+                                int *shard, int *nshard, int *natoms,
+                                int *flags, int *nat)
+{
+    int magic;
+
+    magic = (bRead ? -1 : CPT_MAGIC_SHARD);
+    if (xdr_int(xd, &magic) == 0 || magic != CPT_MAGIC_SHARD)
+    {
+        gmx_fatal(FARGS, "Start of file magic number mismatch, file has %d, should be %d\n"
+                  "The file is corrupted or not a checkpoint shard",
+                  magic, CPT_MAGIC_SHARD);
+    }
+    *file_version = cpt_version;
+    do_cpt_int_err(xd, "checkpoint file version", file_version, NULL);
+    if (*file_version > cpt_version)
+    {
+        gmx_fatal(FARGS, "Attempting to read a checkpoint shard of version %d with code of version %d\n", *file_version, cpt_version);
+    }
+    do_cpt_step_err(xd, "step", step, NULL);
+    do_cpt_int_err(xd, "shard", shard, NULL);
+    do_cpt_int_err(xd, "#state shards", nshard, NULL);
+    do_cpt_int_err(xd, "#atoms", natoms, NULL);
+    do_cpt_int_err(xd, "state flags", flags, NULL);
+    do_cpt_int_err(xd, "#shard atoms", nat, NULL);
+}
+
+void write_checkpoint_shard(const char *fn, int shard, int nshard,
+                            gmx_int64_t step, int natoms,
+                            int nat, int *index, t_state *state_local)
+{
+    char     *name;
+    t_fileio *fp;
+    XDR      *xd;
+    int       file_version, flags, est;
+
+    name = cpt_shard_filename(fn, step, shard);
+
+    fp = gmx_fio_open(name, "w");
+    xd = gmx_fio_getxdr(fp);
+
+    flags = (state_local->flags & CPT_SHARD_FLAGS);
+    do_cpt_shard_header(xd, FALSE, &file_version, &step,
+                        &shard, &nshard, &natoms, &flags, &nat);
+    if (xdr_vector(xd, (char *)index, nat,
+                   (unsigned int)sizeof(int), (xdrproc_t)xdr_int) == 0)
+    {
+        cp_error();
+    }
+    for (est = 0; est < estNR; est++)
+    {
+        if ((flags & (1<<est)) &&
+            do_cpte_rvecs(xd, cptpEST, est, flags, nat,
+                          cpt_shard_vector(state_local, est), NULL) < 0)
+        {
+            cp_error();
+        }
+    }
+    do_cpt_footer(xd, file_version);
+
+    /* The master only writes the checkpoint that lists the shards
+     * after all shards have been written, so we sync here.
+     */
+    if (gmx_fio_fsync(fp) != 0)
+    {
+        char buf[STRLEN];
+        sprintf(buf,
+                "Cannot fsync '%s'; maybe you are out of disk space?", name);
+
+        if (getenv(GMX_IGNORE_FSYNC_FAILURE_ENV) == NULL)
+        {
+            gmx_file(buf);
+        }
+        else
+        {
+            gmx_warning(buf);
+        }
+    }
+    if (gmx_fio_close(fp) != 0)
+    {
+        gmx_file("Cannot read/write checkpoint; corrupt file, or maybe you are out of disk space?");
+    }
+
+    sfree(name);
+}
+
+/* Reads the distributed state entries of the shards listed in checkpoint
+ * file fn into the global state.
+ */
+static void read_cpt_shards(const char *fn, gmx_int64_t step,
+                            int natoms, int fflags,
+                            int nshard, const t_cpt_shard *shards,
+                            t_state *state)
+{
+    int          s, i, est, file_version;
+    gmx_int64_t  step_f;
+    int          shard_f, nshard_f, natoms_f, flags_f, nat;
+    int         *index = NULL, index_nalloc = 0, nat_tot;
+    rvec        *vbuf  = NULL, **v;
+    gmx_bool    *bRead;
+    char        *path;
+    t_fileio    *fp;
+    XDR         *xd;
+
+    for (est = 0; est < estNR; est++)
+    {
+        if ((fflags & CPT_SHARD_FLAGS & state->flags & (1<<est)) &&
+            *cpt_shard_vector(state, est) == NULL)
+        {
+            snew(*cpt_shard_vector(state, est), natoms);
+        }
+    }
+
+    snew(bRead, natoms);
+    nat_tot = 0;
+    for (s = 0; s < nshard; s++)
+    {
+        path = cpt_shard_path(fn, shards[s].name);
+        if (!gmx_fexist(path))
+        {
+            gmx_fatal(FARGS, "Checkpoint shard file '%s' listed in checkpoint file '%s' is not present", path, fn);
+        }
+        fp = gmx_fio_open(path, "r");
+        xd = gmx_fio_getxdr(fp);
+
+        do_cpt_shard_header(xd, TRUE, &file_version, &step_f,
+                            &shard_f, &nshard_f, &natoms_f, &flags_f, &nat);
+        if (step_f != step || shard_f != s || nshard_f != nshard ||
+            natoms_f != natoms || nat != shards[s].natoms ||
+            flags_f != (fflags & CPT_SHARD_FLAGS))
+        {
+            gmx_fatal(FARGS, "Checkpoint shard file '%s' does not belong to checkpoint file '%s'", path, fn);
+        }
+
+        if (nat > index_nalloc)
+        {
+            index_nalloc = over_alloc_large(nat);
+            srenew(index, index_nalloc);
+            srenew(vbuf, index_nalloc);
+        }
+        if (xdr_vector(xd, (char *)index, nat,
+                       (unsigned int)sizeof(int), (xdrproc_t)xdr_int) == 0)
+        {
+            cp_error();
+        }
+        for (i = 0; i < nat; i++)
+        {
+            if (index[i] < 0 || index[i] >= natoms || bRead[index[i]])
+            {
+                gmx_fatal(FARGS, "Checkpoint shard file '%s' contains invalid or duplicate atom index %d", path, index[i]);
+            }
+            bRead[index[i]] = TRUE;
+        }
+        nat_tot += nat;
+
+        for (est = 0; est < estNR; est++)
+        {
+            if (flags_f & (1<<est))
+            {
+                /* Entries not present in state are read, but not stored */
+                if (do_cpte_rvecs(xd, cptpEST, est, state->flags, nat,
+                                  &vbuf, NULL) < 0)
+                {
+                    cp_error();
+                }
+                if (state->flags & (1<<est))
+                {
+                    v = cpt_shard_vector(state, est);
+                    for (i = 0; i < nat; i++)
+                    {
+                        copy_rvec(vbuf[i], (*v)[index[i]]);
+                    }
+                }
+            }
+        }
+        if (do_cpt_footer(xd, file_version) != 0)
+        {
+            cp_error();
+        }
+        if (gmx_fio_close(fp) != 0)
+        {
+            gmx_file("Cannot read/write checkpoint; corrupt file, or maybe you are out of disk space?");
+        }
+        sfree(path);
+    }
+    if (nat_tot != natoms)
+    {
+        gmx_fatal(FARGS, "The shards of checkpoint file '%s' contain %d atoms, while the system has %d atoms", fn, nat_tot, natoms);
+    }
+
+    sfree(bRead);
+    sfree(vbuf);
+    sfree(index);
+}
+
+/* Returns the shards listed in checkpoint file fn, when present */
+static void read_cpt_shard_list(const char *fn, int *nshard, t_cpt_shard **shards)
+{
+    t_fileio    *fp;
+    int          file_version;
+    char        *version, *btime, *buser, *bhost, *fprog, *ftime;
+    int          double_prec, eIntegrator, simulation_part, nppnodes, npme;
+    gmx_int64_t  step;
+    double       t;
+    ivec         dd_nc;
+    int          natoms, ngtc, nnhpres, nhchainlength, nlambda;
+    int          flags_state, flags_eks, flags_enh, flags_dfh, nED, eSwapCoords;
+
+    fp = gmx_fio_open(fn, "r");
+    do_cpt_header(gmx_fio_getxdr(fp), TRUE, &file_version,
+                  &version, &btime, &buser, &bhost, &double_prec, &fprog, &ftime,
+                  &eIntegrator, &simulation_part, &step, &t, &nppnodes, dd_nc, &npme,
+                  &natoms, &ngtc, &nnhpres, &nhchainlength, &nlambda,
+                  &flags_state, &flags_eks, &flags_enh, &flags_dfh,
+                  &nED, &eSwapCoords, nshard, NULL);
+    if (do_cpt_shards(gmx_fio_getxdr(fp), TRUE, *nshard, shards, NULL) != 0)
+    {
+        cp_error();
+    }
+    gmx_fio_close(fp);
+
+    sfree(version);
+    sfree(btime);
+    sfree(buser);
+    sfree(bhost);
+    sfree(fprog);
+    sfree(ftime);
+}
+
+/* Removes the shard files listed in checkpoint file fn,
+ * except for those that are also listed in shards_new.
+ */
+static void remove_cpt_shards(const char *fn, int nshard, const t_cpt_shard *shards,
+                              int nshard_new, const t_cpt_shard *shards_new)
+{
+    int       s, n;
+    gmx_bool  bUsed;
+    char     *path;
+
+    for (s = 0; s < nshard; s++)
+    {
+        bUsed = FALSE;
+        for (n = 0; n < nshard_new; n++)
+        {
+            bUsed = bUsed || (strcmp(shards[s].name, shards_new[n].name) == 0);
+        }
+        if (!bUsed)
+        {
+            path = cpt_shard_path(fn, shards[s].name);
+            /* We don't care if this fails: the shard is not used anymore */
+            remove(path);
+            sfree(path);
+        }
+    }
+}
+
+/* Stores in buf the name of the backup file of checkpoint file fn */
+static void cpt_prev_filename(const char *fn, char *buf)
+{
+    strcpy(buf, fn);
+    buf[strlen(fn) - strlen(ftp2ext(fn2ftp(fn))) - 1] = '\0';
+    strcat(buf, "_prev");
+    strcat(buf, fn+strlen(fn) - strlen(ftp2ext(fn2ftp(fn))) - 1);
+}
+
+/* A checkpoint file that has been written, but not yet synced to disk */
+struct t_checkpoint_pending
+{
+    t_fileio    *fp;             /* The temporary checkpoint file        */
+    char        *fn;             /* The final checkpoint file name       */
+    char        *fntemp;         /* The temporary checkpoint file name   */
+    gmx_bool     bNumberAndKeep; /* Whether to keep the numbered file    */
+    int          nshard;         /* The number of state shards, 0: none  */
+    t_cpt_shard *shards;         /* The state shards of this checkpoint  */
+    int          nshard_prev;    /* The number of shards of the backup   */
+    t_cpt_shard *shards_prev;    /* The shards of the backup, to remove  */
+};
+
+t_checkpoint_pending *
+write_checkpoint_start(const char *fn, gmx_bool bNumberAndKeep,
+                       FILE *fplog, t_commrec *cr,
+                       int eIntegrator, int simulation_part,
+                       gmx_bool bExpanded, int elamstats,
+                       gmx_int64_t step, double t, t_state *state,
+                       int nshard, const int *shard_natoms)
+{
+    t_checkpoint_pending *cpt;
+    t_fileio             *fp;
+    int                   file_version;
+    char                 *version;
+    char                 *btime;
+    char                 *buser;
+    char                 *bhost;
+    int                   double_prec;
+    char                 *fprog;
+    char                 *fntemp; /* the temporary checkpoint file name */
+    char                  timebuf[STRLEN];
+    int                   nppnodes, npmenodes;
+    char                  buf[1024], suffix[5+STEPSTRSIZE], sbuf[STEPSTRSIZE];
+    gmx_file_position_t  *outputfiles;
+    int                   noutputfiles;
+    char                 *ftime;
+    int                   flags_eks, flags_enh, flags_dfh;
+    t_cpt_shard          *shards;
+    char                 *shard_fn;
+    int                   s;
 
     if (DOMAINDECOMP(cr))
     {
@@ -1590,7 +1989,7 @@ void write_checkpoint(const char *fn, gmx_bool bNumberAndKeep,
                   &state->natoms, &state->ngtc, &state->nnhpres,
                   &state->nhchainlength, &(state->dfhist.nlambda), &state->flags, &flags_eks, &flags_enh, &flags_dfh,
                   &state->edsamstate.nED, &state->swapstate.eSwapCoords,
-                  NULL);
+                  &nshard, NULL);
 
     sfree(version);
     sfree(btime);
@@ -1598,7 +1997,22 @@ void write_checkpoint(const char *fn, gmx_bool bNumberAndKeep,
     sfree(bhost);
     sfree(fprog);
 
-    if ((do_cpt_state(gmx_fio_getxdr(fp), FALSE, state->flags, state, NULL) < 0)        ||
+    /* With shards, the distributed state entries have been written
+     * by the ranks to the shard files, here we only list the shards.
+     */
+    snew(shards, nshard);
+    for (s = 0; s < nshard; s++)
+    {
+        shard_fn          = cpt_shard_filename(fn, step, s);
+        shards[s].name    = gmx_strdup(shard_fn + cpt_dirname_length(shard_fn));
+        shards[s].natoms  = shard_natoms[s];
+        sfree(shard_fn);
+    }
+
+    if ((do_cpt_shards(gmx_fio_getxdr(fp), FALSE, nshard, &shards, NULL) < 0)          ||
+        (do_cpt_state(gmx_fio_getxdr(fp), FALSE,
+                      nshard > 0 ? (state->flags & ~CPT_SHARD_FLAGS) : state->flags,
+                      state, NULL) < 0)                                                 ||
         (do_cpt_ekinstate(gmx_fio_getxdr(fp), flags_eks, &state->ekinstate, NULL) < 0) ||
         (do_cpt_enerhist(gmx_fio_getxdr(fp), FALSE, flags_enh, &state->enerhist, NULL) < 0)  ||
         (do_cpt_df_hist(gmx_fio_getxdr(fp), flags_dfh, &state->dfhist, NULL) < 0)  ||
@@ -1612,6 +2026,39 @@ void write_checkpoint(const char *fn, gmx_bool bNumberAndKeep,
 
     do_cpt_footer(gmx_fio_getxdr(fp), file_version);
 
+    sfree(outputfiles);
+
+    snew(cpt, 1);
+    cpt->fp             = fp;
+    cpt->fn             = gmx_strdup(fn);
+    cpt->fntemp         = fntemp;
+    cpt->bNumberAndKeep = bNumberAndKeep;
+    cpt->nshard         = nshard;
+    cpt->shards         = shards;
+
+#ifndef GMX_NO_RENAME
+    if (!bNumberAndKeep && gmx_fexist(fn))
+    {
+        /* write_checkpoint_finish() overwrites the backup checkpoint file,
+         * after which its shards are not needed anymore. We read the list
+         * here, since reading can generate fatal errors.
+         */
+        cpt_prev_filename(fn, buf);
+        if (gmx_fexist(buf))
+        {
+            read_cpt_shard_list(buf, &cpt->nshard_prev, &cpt->shards_prev);
+        }
+    }
+#endif
+
+    return cpt;
+}
+
+int write_checkpoint_finish(t_checkpoint_pending *cpt, char *errmsg)
+{
+    t_fileio *ret;
+    int       rc = 0;
+
     /* we really, REALLY, want to make sure to physically write the checkpoint,
        and all the files it depends on, out to disk. Because we've
        opened the checkpoint with gmx_fio_open(), it's in our list
@@ -1627,7 +2074,8 @@ void write_checkpoint(const char *fn, gmx_bool bNumberAndKeep,
 
         if (getenv(GMX_IGNORE_FSYNC_FAILURE_ENV) == NULL)
         {
-            gmx_file(buf);
+            strcpy(errmsg, buf);
+            rc = -1;
         }
         else
         {
@@ -1635,23 +2083,24 @@ void write_checkpoint(const char *fn, gmx_bool bNumberAndKeep,
         }
     }
 
-    if (gmx_fio_close(fp) != 0)
+    if (gmx_fio_close(cpt->fp) != 0 && rc == 0)
     {
-        gmx_file("Cannot read/write checkpoint; corrupt file, or maybe you are out of disk space?");
+        strcpy(errmsg, "Cannot read/write checkpoint; corrupt file, or maybe you are out of disk space?");
+        rc = -1;
     }
 
     /* we don't move the checkpoint if the user specified they didn't want it,
        or if the fsyncs failed */
 #ifndef GMX_NO_RENAME
-    if (!bNumberAndKeep && !ret)
+    if (!cpt->bNumberAndKeep && !ret && rc == 0)
     {
+        const char  *fn = cpt->fn;
+        char         buf[1024];
+
         if (gmx_fexist(fn))
         {
             /* Rename the previous checkpoint file */
-            strcpy(buf, fn);
-            buf[strlen(fn) - strlen(ftp2ext(fn2ftp(fn))) - 1] = '\0';
-            strcat(buf, "_prev");
-            strcat(buf, fn+strlen(fn) - strlen(ftp2ext(fn2ftp(fn))) - 1);
+            cpt_prev_filename(fn, buf);
 #ifndef GMX_FAHCORE
             /* we copy here so that if something goes wrong between now and
              * the rename below, there's always a state.cpt.
@@ -1666,15 +2115,47 @@ void write_checkpoint(const char *fn, gmx_bool bNumberAndKeep,
             gmx_file_rename(fn, buf);
 #endif
         }
-        if (gmx_file_rename(fntemp, fn) != 0)
+        if (gmx_file_rename(cpt->fntemp, fn) != 0)
+        {
+            strcpy(errmsg, "Cannot rename checkpoint file; maybe you are out of disk space?");
+            rc = -1;
+        }
+        else
         {
-            gmx_file("Cannot rename checkpoint file; maybe you are out of disk space?");
+            /* The shards of the backup that we overwrote are not needed */
+            remove_cpt_shards(fn, cpt->nshard_prev, cpt->shards_prev,
+                              cpt->nshard, cpt->shards);
         }
     }
 #endif  /* GMX_NO_RENAME */
 
-    sfree(outputfiles);
-    sfree(fntemp);
+    done_cpt_shards(cpt->nshard_prev, cpt->shards_prev);
+    done_cpt_shards(cpt->nshard, cpt->shards);
+    sfree(cpt->fn);
+    sfree(cpt->fntemp);
+    sfree(cpt);
+
+    return rc;
+}
+
+void write_checkpoint(const char *fn, gmx_bool bNumberAndKeep,
+                      FILE *fplog, t_commrec *cr,
+                      int eIntegrator, int simulation_part,
+                      gmx_bool bExpanded, int elamstats,
+                      gmx_int64_t step, double t, t_state *state,
+                      int nshard, const int *shard_natoms)
+{
+    char errmsg[STRLEN];
+
+    if (write_checkpoint_finish(write_checkpoint_start(fn, bNumberAndKeep, fplog, cr,
+                                                       eIntegrator, simulation_part,
+                                                       bExpanded, elamstats,
+                                                       step, t, state,
+                                                       nshard, shard_natoms),
+                                errmsg) != 0)
+    {
+        gmx_file(errmsg);
+    }
 
 #ifdef GMX_FAHCORE
     /*code for alternate checkpointing scheme.  moved from top of loop over
@@ -1849,6 +2330,8 @@ static void read_checkpoint(const char *fn, FILE **pfplog,
     t_fileio            *chksum_file;
     FILE               * fplog = *pfplog;
     unsigned char        digest[16];
+    int                  nshard;
+    t_cpt_shard         *shards;
 #if !defined __native_client__ && !defined GMX_NATIVE_WINDOWS
     struct flock         fl; /* don't initialize here: the struct order is OS
                                 dependent! */
@@ -1873,7 +2356,12 @@ static void read_checkpoint(const char *fn, FILE **pfplog,
                   &nppnodes_f, dd_nc_f, &npmenodes_f,
                   &natoms, &ngtc, &nnhpres, &nhchainlength, &nlambda,
                   &fflags, &flags_eks, &flags_enh, &flags_dfh,
-                  &state->edsamstate.nED, &state->swapstate.eSwapCoords, NULL);
+                  &state->edsamstate.nED, &state->swapstate.eSwapCoords,
+                  &nshard, NULL);
+    if (do_cpt_shards(gmx_fio_getxdr(fp), TRUE, nshard, &shards, NULL) != 0)
+    {
+        cp_error();
+    }
 
     if (bAppendOutputFiles &&
         file_version >= 13 && double_prec != GMX_CPT_BUILD_DP)
@@ -2005,7 +2493,9 @@ static void read_checkpoint(const char *fn, FILE **pfplog,
                         cr, nppnodes_f, npmenodes_f, dd_nc, dd_nc_f);
         }
     }
-    ret             = do_cpt_state(gmx_fio_getxdr(fp), TRUE, fflags, state, NULL);
+    ret             = do_cpt_state(gmx_fio_getxdr(fp), TRUE,
+                                   nshard > 0 ? (fflags & ~CPT_SHARD_FLAGS) : fflags,
+                                   state, NULL);
     *init_fep_state = state->fep_state;  /* there should be a better way to do this than setting it here.
                                             Investigate for 5.0. */
     if (ret)
@@ -2080,6 +2570,12 @@ static void read_checkpoint(const char *fn, FILE **pfplog,
     sfree(buser);
     sfree(bhost);
 
+    if (nshard > 0)
+    {
+        read_cpt_shards(fn, *step, natoms, fflags, nshard, shards, state);
+    }
+    done_cpt_shards(nshard, shards);
+
     /* If the user wants to append to output files,
      * we use the file pointer positions of the output files stored
      * in the checkpoint file and truncate the files such that any frames
@@ -2259,7 +2755,8 @@ void load_checkpoint(const char *fn, FILE **fplog,
 
 static void read_checkpoint_data(t_fileio *fp, int *simulation_part,
                                  gmx_int64_t *step, double *t, t_state *state,
-                                 int *nfiles, gmx_file_position_t **outputfiles)
+                                 int *nfiles, gmx_file_position_t **outputfiles,
+                                 gmx_bool bReadShards)
 {
     int                  file_version;
     char                *version, *btime, *buser, *bhost, *fprog, *ftime;
@@ -2271,15 +2768,24 @@ static void read_checkpoint_data(t_fileio *fp, int *simulation_part,
     int                  nfiles_loc;
     gmx_file_position_t *files_loc = NULL;
     int                  ret;
+    int                  nshard;
+    t_cpt_shard         *shards;
 
     do_cpt_header(gmx_fio_getxdr(fp), TRUE, &file_version,
                   &version, &btime, &buser, &bhost, &double_prec, &fprog, &ftime,
                   &eIntegrator, simulation_part, step, t, &nppnodes, dd_nc, &npme,
                   &state->natoms, &state->ngtc, &state->nnhpres, &state->nhchainlength,
                   &(state->dfhist.nlambda), &state->flags, &flags_eks, &flags_enh, &flags_dfh,
-                  &state->edsamstate.nED, &state->swapstate.eSwapCoords, NULL);
+                  &state->edsamstate.nED, &state->swapstate.eSwapCoords,
+                  &nshard, NULL);
+    if (do_cpt_shards(gmx_fio_getxdr(fp), TRUE, nshard, &shards, NULL) != 0)
+    {
+        cp_error();
+    }
     ret =
-        do_cpt_state(gmx_fio_getxdr(fp), TRUE, state->flags, state, NULL);
+        do_cpt_state(gmx_fio_getxdr(fp), TRUE,
+                     nshard > 0 ? (state->flags & ~CPT_SHARD_FLAGS) : state->flags,
+                     state, NULL);
     if (ret)
     {
         cp_error();
@@ -2333,6 +2839,13 @@ static void read_checkpoint_data(t_fileio *fp, int *simulation_part,
         cp_error();
     }
 
+    if (nshard > 0 && bReadShards)
+    {
+        read_cpt_shards(gmx_fio_getname(fp), *step, state->natoms, state->flags,
+                        nshard, shards, state);
+    }
+    done_cpt_shards(nshard, shards);
+
     sfree(fprog);
     sfree(ftime);
     sfree(btime);
@@ -2347,7 +2860,7 @@ read_checkpoint_state(const char *fn, int *simulation_part,
     t_fileio *fp;
 
     fp = gmx_fio_open(fn, "r");
-    read_checkpoint_data(fp, simulation_part, step, t, state, NULL, NULL);
+    read_checkpoint_data(fp, simulation_part, step, t, state, NULL, NULL, TRUE);
     if (gmx_fio_close(fp) != 0)
     {
         gmx_file("Cannot read/write checkpoint; corrupt file, or maybe you are out of disk space?");
@@ -2367,7 +2880,7 @@ void read_checkpoint_trxframe(t_fileio *fp, t_trxframe *fr)
 
     init_state(&state, 0, 0, 0, 0, 0);
 
-    read_checkpoint_data(fp, &simulation_part, &step, &t, &state, NULL, NULL);
+    read_checkpoint_data(fp, &simulation_part, &step, &t, &state, NULL, NULL, TRUE);
 
     fr->natoms  = state.natoms;
     fr->bTitle  = FALSE;
@@ -2416,6 +2929,8 @@ void list_checkpoint(const char *fn, FILE *out)
     int                  ret;
     gmx_file_position_t *outputfiles;
     int                  nfiles;
+    int                  nshard;
+    t_cpt_shard         *shards;
 
     init_state(&state, -1, -1, -1, -1, 0);
 
@@ -2426,8 +2941,14 @@ void list_checkpoint(const char *fn, FILE *out)
                   &state.natoms, &state.ngtc, &state.nnhpres, &state.nhchainlength,
                   &(state.dfhist.nlambda), &state.flags,
                   &flags_eks, &flags_enh, &flags_dfh, &state.edsamstate.nED,
-                  &state.swapstate.eSwapCoords, out);
-    ret = do_cpt_state(gmx_fio_getxdr(fp), TRUE, state.flags, &state, out);
+                  &state.swapstate.eSwapCoords, &nshard, out);
+    ret = do_cpt_shards(gmx_fio_getxdr(fp), TRUE, nshard, &shards, out);
+    if (ret == 0)
+    {
+        ret = do_cpt_state(gmx_fio_getxdr(fp), TRUE,
+                           nshard > 0 ? (state.flags & ~CPT_SHARD_FLAGS) : state.flags,
+                           &state, out);
+    }
     if (ret)
     {
         cp_error();
@@ -2530,7 +3051,7 @@ gmx_bool read_checkpoint_simulation_part(const char *filename, int *simulation_p
             init_state(&state, 0, 0, 0, 0, 0);
 
             read_checkpoint_data(fp, simulation_part, &step, &t, &state,
-                                 &nfiles, &outputfiles);
+                                 &nfiles, &outputfiles, FALSE);
             if (gmx_fio_close(fp) != 0)
             {
                 gmx_file("Cannot read/write checkpoint; corrupt file, or maybe you are out of disk space?");
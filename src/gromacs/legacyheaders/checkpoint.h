@@ -53,13 +53,56 @@ extern "C" {
 /* Write a checkpoint to <fn>.cpt
  * Appends the _step<step>.cpt with bNumberAndKeep,
  * otherwise moves the previous <fn>.cpt to <fn>_prev.cpt
+ * With nshard > 0 the distributed state entries are not written,
+ * but the checkpoint lists the nshard shards with shard_natoms atoms
+ * that should have been written with write_checkpoint_shard().
+ * The shards of the replaced <fn>_prev.cpt are removed.
  */
 void write_checkpoint(const char *fn, gmx_bool bNumberAndKeep,
                       FILE *fplog, t_commrec *cr,
                       int eIntegrator, int simulation_part,
                       gmx_bool bExpanded, int elamstats,
                       gmx_int64_t step, double t,
-                      t_state *state);
+                      t_state *state,
+                      int nshard, const int *shard_natoms);
+
+/* Writes the distributed state entries (x, v, sd_X) of the nat atoms
+ * with global indices index in state_local to shard file shard
+ * of the nshard shards of checkpoint file fn for step.
+ * Each rank can write its own shard in parallel, the shards are synced
+ * to disk before returning. On reading the checkpoint, the shards are
+ * combined into the global state, so the run can continue with any
+ * number of ranks.
+ */
+void write_checkpoint_shard(const char *fn, int shard, int nshard,
+                            gmx_int64_t step, int natoms,
+                            int nat, int *index, t_state *state_local);
+
+/* A checkpoint that has been written, but not yet synced to disk */
+typedef struct t_checkpoint_pending t_checkpoint_pending;
+
+/* Does the first part of write_checkpoint(): writes the state and the
+ * current positions of the output files to a temporary file, and reads
+ * the shard list of the backup checkpoint that will be replaced.
+ * write_checkpoint_finish() should be called afterwards.
+ */
+t_checkpoint_pending *
+write_checkpoint_start(const char *fn, gmx_bool bNumberAndKeep,
+                       FILE *fplog, t_commrec *cr,
+                       int eIntegrator, int simulation_part,
+                       gmx_bool bExpanded, int elamstats,
+                       gmx_int64_t step, double t,
+                       t_state *state,
+                       int nshard, const int *shard_natoms);
+
+/* Completes a checkpoint started with write_checkpoint_start():
+ * syncs all output files to disk and moves the checkpoint file in place.
+ * Only touches files and does not generate fatal errors, so it can be
+ * called from a separate thread. Frees cpt.
+ * Returns 0 on success. On failure, an error message is stored in errmsg,
+ * which should have room for STRLEN characters.
+ */
+int write_checkpoint_finish(t_checkpoint_pending *cpt, char *errmsg);
 
 /* Loads a checkpoint from fn for run continuation.
  * Generates a fatal error on system size mismatch.
@@ -97,8 +97,10 @@ gmx_bool bshakef(FILE           *log,          /* Log file			*/
  */
 
 gmx_settledata_t settle_init(real mO, real mH, real invmO, real invmH,
-                             real dOH, real dHH);
-/* Initializes and returns a structure with SETTLE parameters */
+                             real dOH, real dHH, gmx_bool bUseSimd);
+/* Initializes and returns a structure with SETTLE parameters.
+ * With bUseSimd=FALSE the plain C kernels are used.
+ */
 
 void csettle(gmx_settledata_t    settled,
              int                 nsettle,          /* Number of settles            */
@@ -242,8 +244,11 @@ real lincs_rmsd(gmx_lincsdata_t lincsd, gmx_bool bSD2);
 
 gmx_lincsdata_t init_lincs(FILE *fplog, gmx_mtop_t *mtop,
                            int nflexcon_global, t_blocka *at2con,
-                           gmx_bool bPLINCS, int nIter, int nProjOrder);
-/* Initializes and returns the lincs data struct */
+                           gmx_bool bPLINCS, int nIter, int nProjOrder,
+                           gmx_bool bUseSimd);
+/* Initializes and returns the lincs data struct.
+ * With bUseSimd=FALSE the plain C kernels are used.
+ */
 
 void set_lincs(t_idef *idef, t_mdatoms *md,
                gmx_bool bDynamics, t_commrec *cr,
@@ -86,6 +86,7 @@ typedef struct {
     real             dekindl;         /* dEkin/dlambda at half step           */
     real             dekindl_old;     /* dEkin/dlambda at old half step       */
     t_cos_acc        cosacc;          /* Cosine acceleration data             */
+    gmx_bool         bUseSimd;        /* Use SIMD for the kinetic energy      */
 } gmx_ekindata_t;
 
 #define GID(igid, jgid, gnr) ((igid < jgid) ? (igid*gnr+jgid) : (jgid*gnr+igid))
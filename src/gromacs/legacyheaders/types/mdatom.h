@@ -59,7 +59,11 @@ typedef struct {
     int                    nChargePerturbed;
     int                    nTypePerturbed;
     gmx_bool               bOrires;
+    /* Are there virtual sites or shells in the system? */
+    gmx_bool               bVsitesOrShells;
     real                  *massA, *massB, *massT, *invmass;
+    /* invmass for each dimension, used in the SIMD update loops */
+    rvec                  *invMassPerDim;
     real                  *chargeA, *chargeB;
     real                  *sqrt_c6A, *sqrt_c6B;
     real                  *sigmaA, *sigmaB, *sigma3A, *sigma3B;
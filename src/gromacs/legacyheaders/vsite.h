@@ -64,6 +64,7 @@ typedef struct {
     gmx_vsite_thread_t *tdata;                /* Thread local vsites and work structs    */
     int                *th_ind;               /* Work array                              */
     int                 th_ind_nalloc;        /* Size of th_ind                          */
+    gmx_bool            bUseSimd;             /* Use the SIMD kernels, when supported    */
 } gmx_vsite_t;
 
 struct t_graph;
@@ -106,12 +107,13 @@ void spread_vsite_f(gmx_vsite_t *vsite,
  */
 
 gmx_vsite_t *init_vsite(gmx_mtop_t *mtop, t_commrec *cr,
-                        gmx_bool bSerial_NoPBC);
+                        gmx_bool bSerial_NoPBC, gmx_bool bUseSimd);
 /* Initialize the virtual site struct,
  * returns NULL when there are no virtual sites.
  * bSerial_NoPBC is to generate a simple vsite setup to be
  * used only serial (no MPI or thread parallelization) and without pbc;
  * this is useful for correction vsites of the initial configuration.
+ * With bUseSimd=FALSE the plain C kernels are used.
  */
 
 void split_vsites_over_threads(const t_ilist   *ilist,
@@ -40,6 +40,8 @@
 #include <math.h>
 #include <stdlib.h>
 
+#include <algorithm>
+
 #include "gromacs/domdec/domdec.h"
 #include "gromacs/fileio/gmxfio.h"
 #include "gromacs/legacyheaders/constr.h"
@@ -52,12 +54,30 @@
 #include "gromacs/math/vec.h"
 #include "gromacs/mdlib/bitmask.h"
 #include "gromacs/pbcutil/pbc.h"
+#include "gromacs/pbcutil/pbc-simd.h"
+#include "gromacs/simd/simd.h"
+#include "gromacs/simd/simd_math.h"
+#include "gromacs/simd/vector_operations.h"
 #include "gromacs/topology/block.h"
 #include "gromacs/topology/mtop_util.h"
 #include "gromacs/utility/fatalerror.h"
 #include "gromacs/utility/gmxomp.h"
 #include "gromacs/utility/smalloc.h"
 
+#ifdef GMX_SIMD_HAVE_REAL
+/* With SIMD the constraints are processed in blocks of the SIMD width.
+ * The constraint arrays are padded to a multiple of the SIMD width
+ * with dummy constraints with zero length and blc=0.
+ * The coupling matrix is then stored per block, see set_lincs_simd_layout.
+ */
+#define LINCS_SIMD
+#define LINCS_BLOCK_SIZE  GMX_SIMD_REAL_WIDTH
+#define LINCS_ALIGN_BYTES (GMX_SIMD_REAL_WIDTH*sizeof(real))
+#else
+#define LINCS_BLOCK_SIZE  1
+#define LINCS_ALIGN_BYTES 16
+#endif
+
 typedef struct {
     int    b0;         /* first constraint for this thread */
     int    b1;         /* b1-1 is the last constraint for this thread */
@@ -96,6 +116,14 @@ typedef struct gmx_lincsdata {
     real           *blmf;         /* matrix of mass factors for constraint connections */
     real           *blmf1;        /* as blmf, but with all masses 1 */
     real           *bllen;        /* the reference bond length */
+    gmx_bool        bUseSimd;     /* use the SIMD kernels, when supported */
+    int            *simd_blnr;    /* index into simd_blbnb and simd_blmf per SIMD block */
+    int            *simd_blbnb;   /* as blbnb, in SIMD block layout */
+    real           *simd_blmf;    /* as blmf, in SIMD block layout */
+    real           *simd_blmf1;   /* as blmf1, in SIMD block layout */
+    real           *simd_blcc;    /* temporary coupling coefficients in SIMD block layout */
+    int             simd_nblock_alloc; /* allocation size of simd_blnr */
+    int             simd_ncc_alloc;    /* allocation size of the SIMD block matrix */
     int             nth;          /* The number of threads doing LINCS */
     lincs_thread_t *th;           /* LINCS thread division */
     gmx_bitmask_t  *atf;          /* atom flags for thread parallelization */
@@ -129,7 +157,354 @@ real lincs_rmsd(struct gmx_lincsdata *lincsd, gmx_bool bSD2)
     }
 }
 
+#ifdef LINCS_SIMD
+
+/* Sets up the SIMD PBC data. pbc_dx_simd does not support screw PBC,
+ * in that case *pbc_screw is set and PBC is applied while gathering.
+ */
+static void lincs_set_pbc_simd(const t_pbc *pbc,
+                               pbc_simd_t *pbc_simd, const t_pbc **pbc_screw)
+{
+    if (pbc != NULL && pbc->ePBC == epbcSCREW)
+    {
+        set_pbc_simd(NULL, pbc_simd);
+        *pbc_screw = pbc;
+    }
+    else
+    {
+        set_pbc_simd(pbc, pbc_simd);
+        *pbc_screw = NULL;
+    }
+}
+
+/* Gathers the i-j distance vectors of the SIMD block of constraints
+ * starting at b into buf, x, y and z components consecutively.
+ * Only with pbc_screw!=NULL PBC is applied here.
+ */
+static gmx_inline void gather_dx_simd(int b, const int *bla, const rvec *x,
+                                      const t_pbc *pbc_screw, real *buf)
+{
+    int  s, d;
+    rvec dx;
+
+    for (s = 0; s < GMX_SIMD_REAL_WIDTH; s++)
+    {
+        if (pbc_screw != NULL)
+        {
+            pbc_dx_aiuc(pbc_screw, x[bla[2*(b + s)]], x[bla[2*(b + s) + 1]], dx);
+        }
+        else
+        {
+            rvec_sub(x[bla[2*(b + s)]], x[bla[2*(b + s) + 1]], dx);
+        }
+        for (d = 0; d < DIM; d++)
+        {
+            buf[d*GMX_SIMD_REAL_WIDTH + s] = dx[d];
+        }
+    }
+}
+
+/* Calculates the normalized i-j vectors r of x and the right-hand side
+ * blc*(r.dxp - bllen) of the matrix equation for constraints b0 to b1.
+ * With bllen=NULL xp contains derivatives, to which no PBC is applied.
+ */
+static void calc_dr_x_xp_simd(int b0, int b1, const int *bla,
+                              const rvec *x, const rvec *xp,
+                              const real *bllen, const real *blc,
+                              const pbc_simd_t *pbc_simd,
+                              const t_pbc *pbc_screw,
+                              rvec *r, real *rhs, real *sol)
+{
+    real            buf_array[DIM*GMX_SIMD_REAL_WIDTH + GMX_SIMD_REAL_WIDTH], *buf;
+    int             b, s, d;
+    gmx_simd_real_t min_S;
+    gmx_simd_real_t rx_S, ry_S, rz_S, rinv_S;
+    gmx_simd_real_t px_S, py_S, pz_S, ip_S;
+
+    buf   = gmx_simd_align_r(buf_array);
+    /* Padding constraints have zero length, they get r=0 */
+    min_S = gmx_simd_set1_r(GMX_FLOAT_MIN);
+
+    for (b = b0; b < b1; b += GMX_SIMD_REAL_WIDTH)
+    {
+        gather_dx_simd(b, bla, x, pbc_screw, buf);
+        rx_S   = gmx_simd_load_r(buf + 0*GMX_SIMD_REAL_WIDTH);
+        ry_S   = gmx_simd_load_r(buf + 1*GMX_SIMD_REAL_WIDTH);
+        rz_S   = gmx_simd_load_r(buf + 2*GMX_SIMD_REAL_WIDTH);
+        pbc_dx_simd(&rx_S, &ry_S, &rz_S, pbc_simd);
+
+        rinv_S = gmx_simd_invsqrt_r(gmx_simd_max_r(gmx_simd_norm2_r(rx_S, ry_S, rz_S), min_S));
+        rx_S   = gmx_simd_mul_r(rx_S, rinv_S);
+        ry_S   = gmx_simd_mul_r(ry_S, rinv_S);
+        rz_S   = gmx_simd_mul_r(rz_S, rinv_S);
+
+        gather_dx_simd(b, bla, xp, bllen != NULL ? pbc_screw : NULL, buf);
+        px_S   = gmx_simd_load_r(buf + 0*GMX_SIMD_REAL_WIDTH);
+        py_S   = gmx_simd_load_r(buf + 1*GMX_SIMD_REAL_WIDTH);
+        pz_S   = gmx_simd_load_r(buf + 2*GMX_SIMD_REAL_WIDTH);
+        if (bllen != NULL)
+        {
+            pbc_dx_simd(&px_S, &py_S, &pz_S, pbc_simd);
+        }
+
+        ip_S   = gmx_simd_iprod_r(rx_S, ry_S, rz_S, px_S, py_S, pz_S);
+        if (bllen != NULL)
+        {
+            ip_S = gmx_simd_sub_r(ip_S, gmx_simd_load_r(bllen + b));
+        }
+        ip_S   = gmx_simd_mul_r(gmx_simd_load_r(blc + b), ip_S);
+        gmx_simd_store_r(rhs + b, ip_S);
+        gmx_simd_store_r(sol + b, ip_S);
+
+        gmx_simd_store_r(buf + 0*GMX_SIMD_REAL_WIDTH, rx_S);
+        gmx_simd_store_r(buf + 1*GMX_SIMD_REAL_WIDTH, ry_S);
+        gmx_simd_store_r(buf + 2*GMX_SIMD_REAL_WIDTH, rz_S);
+        for (s = 0; s < GMX_SIMD_REAL_WIDTH; s++)
+        {
+            for (d = 0; d < DIM; d++)
+            {
+                r[b + s][d] = buf[d*GMX_SIMD_REAL_WIDTH + s];
+            }
+        }
+    }
+}
+
+/* Calculates the right-hand side of the centripetal correction
+ * for constraints b0 to b1 and checks for large rotations.
+ */
+static void calc_dist_iter_simd(int b0, int b1, const int *bla,
+                                const rvec *xp,
+                                const real *bllen, const real *blc,
+                                const pbc_simd_t *pbc_simd,
+                                const t_pbc *pbc_screw,
+                                real wfac, const int *nlocat,
+                                real *rhs, real *sol, int *warn)
+{
+    real            buf_array[DIM*GMX_SIMD_REAL_WIDTH + GMX_SIMD_REAL_WIDTH], *buf;
+    int             b, s;
+    gmx_simd_real_t two_S, zero_S, wfac_S;
+    gmx_simd_real_t dx_S, dy_S, dz_S, len_S, len2_S, dlen2_S, mvb_S;
+
+    buf    = gmx_simd_align_r(buf_array);
+    two_S  = gmx_simd_set1_r(2.0);
+    zero_S = gmx_simd_setzero_r();
+    wfac_S = gmx_simd_set1_r(wfac);
+
+    for (b = b0; b < b1; b += GMX_SIMD_REAL_WIDTH)
+    {
+        gather_dx_simd(b, bla, xp, pbc_screw, buf);
+        dx_S    = gmx_simd_load_r(buf + 0*GMX_SIMD_REAL_WIDTH);
+        dy_S    = gmx_simd_load_r(buf + 1*GMX_SIMD_REAL_WIDTH);
+        dz_S    = gmx_simd_load_r(buf + 2*GMX_SIMD_REAL_WIDTH);
+        pbc_dx_simd(&dx_S, &dy_S, &dz_S, pbc_simd);
+
+        len_S   = gmx_simd_load_r(bllen + b);
+        len2_S  = gmx_simd_mul_r(len_S, len_S);
+        dlen2_S = gmx_simd_fmsub_r(two_S, len2_S,
+                                   gmx_simd_norm2_r(dx_S, dy_S, dz_S));
+
+        /* Padding constraints have dlen2=0, so they never cause a warning */
+        if (gmx_simd_anytrue_b(gmx_simd_cmplt_r(dlen2_S, gmx_simd_mul_r(wfac_S, len2_S))))
+        {
+            gmx_simd_store_r(buf, dlen2_S);
+            for (s = 0; s < GMX_SIMD_REAL_WIDTH; s++)
+            {
+                if (buf[s] < wfac*bllen[b + s]*bllen[b + s] &&
+                    (nlocat == NULL || nlocat[b + s]))
+                {
+                    /* not race free - see detailed comment in caller */
+                    *warn = b + s;
+                }
+            }
+        }
+
+        /* With dlen2 <= 0 the correction is len, as in the plain C code */
+        mvb_S   = gmx_simd_sub_r(len_S, gmx_simd_sqrt_r(gmx_simd_max_r(dlen2_S, zero_S)));
+        mvb_S   = gmx_simd_mul_r(gmx_simd_load_r(blc + b), mvb_S);
+        gmx_simd_store_r(rhs + b, mvb_S);
+        gmx_simd_store_r(sol + b, mvb_S);
+    }
+}
+
+/* Computes the coupling coefficients, in SIMD block layout, of the
+ * constraints b0 to b1 from the normalized constraint vectors r.
+ */
+static void calc_blcc_simd(int b0, int b1,
+                           const int *simd_blnr, const int *simd_blbnb,
+                           const real *simd_blmf, const rvec *r,
+                           real *simd_blcc)
+{
+    real            buf_array[2*DIM*GMX_SIMD_REAL_WIDTH + GMX_SIMD_REAL_WIDTH];
+    real           *buf_b, *buf_n;
+    int             b, n, s, d;
+    gmx_simd_real_t rx_S, ry_S, rz_S, ip_S;
+
+    buf_b = gmx_simd_align_r(buf_array);
+    buf_n = buf_b + DIM*GMX_SIMD_REAL_WIDTH;
+
+    for (b = b0; b < b1; b += GMX_SIMD_REAL_WIDTH)
+    {
+        for (s = 0; s < GMX_SIMD_REAL_WIDTH; s++)
+        {
+            for (d = 0; d < DIM; d++)
+            {
+                buf_b[d*GMX_SIMD_REAL_WIDTH + s] = r[b + s][d];
+            }
+        }
+        rx_S = gmx_simd_load_r(buf_b + 0*GMX_SIMD_REAL_WIDTH);
+        ry_S = gmx_simd_load_r(buf_b + 1*GMX_SIMD_REAL_WIDTH);
+        rz_S = gmx_simd_load_r(buf_b + 2*GMX_SIMD_REAL_WIDTH);
+
+        for (n = simd_blnr[b/GMX_SIMD_REAL_WIDTH]; n < simd_blnr[b/GMX_SIMD_REAL_WIDTH + 1]; n += GMX_SIMD_REAL_WIDTH)
+        {
+            for (s = 0; s < GMX_SIMD_REAL_WIDTH; s++)
+            {
+                for (d = 0; d < DIM; d++)
+                {
+                    buf_n[d*GMX_SIMD_REAL_WIDTH + s] = r[simd_blbnb[n + s]][d];
+                }
+            }
+            ip_S = gmx_simd_iprod_r(rx_S, ry_S, rz_S,
+                                    gmx_simd_load_r(buf_n + 0*GMX_SIMD_REAL_WIDTH),
+                                    gmx_simd_load_r(buf_n + 1*GMX_SIMD_REAL_WIDTH),
+                                    gmx_simd_load_r(buf_n + 2*GMX_SIMD_REAL_WIDTH));
+            gmx_simd_store_r(simd_blcc + n, gmx_simd_mul_r(gmx_simd_load_r(simd_blmf + n), ip_S));
+        }
+    }
+}
+
+/* Does one LINCS matrix multiplication for constraints b0 to b1
+ * with the coupling matrix in SIMD block layout.
+ */
+static void lincs_matrix_mult_simd(int b0, int b1,
+                                   const int *simd_blnr, const int *simd_blbnb,
+                                   const real *simd_blcc,
+                                   const real *rhs1, real *rhs2, real *sol)
+{
+    real            buf_array[2*GMX_SIMD_REAL_WIDTH], *buf;
+    int             b, n, s;
+    gmx_simd_real_t mvb_S;
+
+    buf = gmx_simd_align_r(buf_array);
+
+    for (b = b0; b < b1; b += GMX_SIMD_REAL_WIDTH)
+    {
+        mvb_S = gmx_simd_setzero_r();
+        for (n = simd_blnr[b/GMX_SIMD_REAL_WIDTH]; n < simd_blnr[b/GMX_SIMD_REAL_WIDTH + 1]; n += GMX_SIMD_REAL_WIDTH)
+        {
+            for (s = 0; s < GMX_SIMD_REAL_WIDTH; s++)
+            {
+                buf[s] = rhs1[simd_blbnb[n + s]];
+            }
+            mvb_S = gmx_simd_fmadd_r(gmx_simd_load_r(simd_blcc + n), gmx_simd_load_r(buf), mvb_S);
+        }
+        gmx_simd_store_r(rhs2 + b, mvb_S);
+        gmx_simd_store_r(sol + b, gmx_simd_add_r(gmx_simd_load_r(sol + b), mvb_S));
+    }
+}
+
+/* Updates the atom vectors x for ncons constraints, given by index ind,
+ * or 0 to ncons-1 with ind=NULL. The constraint vectors are scaled
+ * in SIMD, the atom updates are done in order, as constraints in the same
+ * SIMD block can act on the same atom.
+ */
+static void lincs_update_atoms_simd(int ncons, const int *ind, const int *bla,
+                                    real prefac,
+                                    const real *fac, rvec *r,
+                                    const real *invmass,
+                                    rvec *x)
+{
+    real            buf_array[3*DIM*GMX_SIMD_REAL_WIDTH + GMX_SIMD_REAL_WIDTH];
+    real           *buf_r, *buf_i, *buf_j;
+    int             bi, b, s, d, i, j, nsimd;
+    real            mvb, im1, im2;
+    gmx_simd_real_t prefac_S, mvb_S, tx_S, ty_S, tz_S, im_S;
+
+    buf_r    = gmx_simd_align_r(buf_array);
+    buf_i    = buf_r + DIM*GMX_SIMD_REAL_WIDTH;
+    buf_j    = buf_i + DIM*GMX_SIMD_REAL_WIDTH;
+    prefac_S = gmx_simd_set1_r(prefac);
+
+    nsimd = (ncons/GMX_SIMD_REAL_WIDTH)*GMX_SIMD_REAL_WIDTH;
+    for (bi = 0; bi < nsimd; bi += GMX_SIMD_REAL_WIDTH)
+    {
+        /* Gather the constraint vectors, and the multipliers and inverse
+         * masses into the first elements of the update buffers.
+         */
+        for (s = 0; s < GMX_SIMD_REAL_WIDTH; s++)
+        {
+            b = (ind != NULL ? ind[bi + s] : bi + s);
+            for (d = 0; d < DIM; d++)
+            {
+                buf_r[d*GMX_SIMD_REAL_WIDTH + s] = r[b][d];
+            }
+            buf_i[s] = fac[b];
+            if (invmass != NULL)
+            {
+                buf_i[GMX_SIMD_REAL_WIDTH + s] = invmass[bla[2*b]];
+                buf_j[s]                       = invmass[bla[2*b + 1]];
+            }
+        }
+        mvb_S = gmx_simd_mul_r(prefac_S, gmx_simd_load_r(buf_i));
+        tx_S  = gmx_simd_mul_r(gmx_simd_load_r(buf_r + 0*GMX_SIMD_REAL_WIDTH), mvb_S);
+        ty_S  = gmx_simd_mul_r(gmx_simd_load_r(buf_r + 1*GMX_SIMD_REAL_WIDTH), mvb_S);
+        tz_S  = gmx_simd_mul_r(gmx_simd_load_r(buf_r + 2*GMX_SIMD_REAL_WIDTH), mvb_S);
+        if (invmass != NULL)
+        {
+            im_S = gmx_simd_load_r(buf_i + GMX_SIMD_REAL_WIDTH);
+            gmx_simd_store_r(buf_i + 0*GMX_SIMD_REAL_WIDTH, gmx_simd_mul_r(tx_S, im_S));
+            gmx_simd_store_r(buf_i + 1*GMX_SIMD_REAL_WIDTH, gmx_simd_mul_r(ty_S, im_S));
+            gmx_simd_store_r(buf_i + 2*GMX_SIMD_REAL_WIDTH, gmx_simd_mul_r(tz_S, im_S));
+            im_S = gmx_simd_load_r(buf_j);
+            gmx_simd_store_r(buf_j + 0*GMX_SIMD_REAL_WIDTH, gmx_simd_mul_r(tx_S, im_S));
+            gmx_simd_store_r(buf_j + 1*GMX_SIMD_REAL_WIDTH, gmx_simd_mul_r(ty_S, im_S));
+            gmx_simd_store_r(buf_j + 2*GMX_SIMD_REAL_WIDTH, gmx_simd_mul_r(tz_S, im_S));
+        }
+        else
+        {
+            gmx_simd_store_r(buf_i + 0*GMX_SIMD_REAL_WIDTH, tx_S);
+            gmx_simd_store_r(buf_i + 1*GMX_SIMD_REAL_WIDTH, ty_S);
+            gmx_simd_store_r(buf_i + 2*GMX_SIMD_REAL_WIDTH, tz_S);
+            gmx_simd_store_r(buf_j + 0*GMX_SIMD_REAL_WIDTH, tx_S);
+            gmx_simd_store_r(buf_j + 1*GMX_SIMD_REAL_WIDTH, ty_S);
+            gmx_simd_store_r(buf_j + 2*GMX_SIMD_REAL_WIDTH, tz_S);
+        }
+
+        /* Scatter the updates */
+        for (s = 0; s < GMX_SIMD_REAL_WIDTH; s++)
+        {
+            b = (ind != NULL ? ind[bi + s] : bi + s);
+            i = bla[2*b];
+            j = bla[2*b + 1];
+            for (d = 0; d < DIM; d++)
+            {
+                x[i][d] -= buf_i[d*GMX_SIMD_REAL_WIDTH + s];
+                x[j][d] += buf_j[d*GMX_SIMD_REAL_WIDTH + s];
+            }
+        }
+    }
+
+    /* The remaining constraints, less than a SIMD width */
+    for (bi = nsimd; bi < ncons; bi++)
+    {
+        b   = (ind != NULL ? ind[bi] : bi);
+        i   = bla[2*b];
+        j   = bla[2*b + 1];
+        mvb = prefac*fac[b];
+        im1 = (invmass != NULL ? invmass[i] : 1);
+        im2 = (invmass != NULL ? invmass[j] : 1);
+        for (d = 0; d < DIM; d++)
+        {
+            x[i][d] -= r[b][d]*mvb*im1;
+            x[j][d] += r[b][d]*mvb*im2;
+        }
+    }
+}
+
+#endif /* LINCS_SIMD */
+
 /* Do a set of nrec LINCS matrix multiplications.
+ * With SIMD, blcc should be in SIMD block layout.
  * This function will return with up to date thread-local
  * constraint data, without an OpenMP barrier.
  */
@@ -138,7 +513,7 @@ static void lincs_matrix_expand(const struct gmx_lincsdata *lincsd,
                                 const real *blcc,
                                 real *rhs1, real *rhs2, real *sol)
 {
-    int        nrec, rec, b, j, n, nr0, nr1;
+    int        nrec, rec, b, j, n, nr0, nr1, c, c0, cstride;
     real       mvb, *swap;
     int        ntriangle, tb, bits;
     const int *blnr     = lincsd->blnr, *blbnb = lincsd->blbnb;
@@ -150,16 +525,26 @@ static void lincs_matrix_expand(const struct gmx_lincsdata *lincsd,
     for (rec = 0; rec < nrec; rec++)
     {
 #pragma omp barrier
-        for (b = b0; b < b1; b++)
+#ifdef LINCS_SIMD
+        if (lincsd->bUseSimd)
         {
-            mvb = 0;
-            for (n = blnr[b]; n < blnr[b+1]; n++)
+            lincs_matrix_mult_simd(b0, b1, lincsd->simd_blnr, lincsd->simd_blbnb,
+                                   blcc, rhs1, rhs2, sol);
+        }
+        else
+#endif
+        {
+            for (b = b0; b < b1; b++)
             {
-                j   = blbnb[n];
-                mvb = mvb + blcc[n]*rhs1[j];
+                mvb = 0;
+                for (n = blnr[b]; n < blnr[b+1]; n++)
+                {
+                    j   = blbnb[n];
+                    mvb = mvb + blcc[n]*rhs1[j];
+                }
+                rhs2[b] = mvb;
+                sol[b]  = sol[b] + mvb;
             }
-            rhs2[b] = mvb;
-            sol[b]  = sol[b] + mvb;
         }
         swap = rhs1;
         rhs1 = rhs2;
@@ -197,12 +582,26 @@ static void lincs_matrix_expand(const struct gmx_lincsdata *lincsd,
                     mvb  = 0;
                     nr0  = blnr[b];
                     nr1  = blnr[b+1];
+                    /* Coupling n of b is stored at c0 + n*cstride */
+#ifdef LINCS_SIMD
+                    if (lincsd->bUseSimd)
+                    {
+                        c0      = lincsd->simd_blnr[b/GMX_SIMD_REAL_WIDTH] + b % GMX_SIMD_REAL_WIDTH;
+                        cstride = GMX_SIMD_REAL_WIDTH;
+                    }
+                    else
+#endif
+                    {
+                        c0      = nr0;
+                        cstride = 1;
+                    }
                     for (n = nr0; n < nr1; n++)
                     {
                         if (bits & (1<<(n-nr0)))
                         {
+                            c   = c0 + (n - nr0)*cstride;
                             j   = blbnb[n];
-                            mvb = mvb + blcc[n]*rhs1[j];
+                            mvb = mvb + blcc[c]*rhs1[j];
                         }
                     }
                     rhs2[b] = mvb;
@@ -327,6 +726,32 @@ static void lincs_update_atoms(struct gmx_lincsdata *li, int th,
                                const real *invmass,
                                rvec *x)
 {
+#ifdef LINCS_SIMD
+    if (li->bUseSimd)
+    {
+        if (li->nth == 1)
+        {
+            lincs_update_atoms_simd(li->nc, NULL, li->bla, prefac, fac, r, invmass, x);
+        }
+        else
+        {
+            lincs_update_atoms_simd(li->th[th].nind, li->th[th].ind,
+                                    li->bla, prefac, fac, r, invmass, x);
+
+            if (li->th[li->nth].nind > 0)
+            {
+#pragma omp barrier
+#pragma omp master
+                {
+                    lincs_update_atoms_simd(li->th[li->nth].nind,
+                                            li->th[li->nth].ind,
+                                            li->bla, prefac, fac, r, invmass, x);
+                }
+            }
+        }
+    }
+    else
+#endif
     if (li->nth == 1)
     {
         /* Single thread, we simply update for all constraints */
@@ -395,45 +820,66 @@ static void do_lincsp(rvec *x, rvec *f, rvec *fp, t_pbc *pbc,
     rhs2   = lincsd->tmp2;
     sol    = lincsd->tmp3;
 
-    /* Compute normalized i-j vectors */
-    if (pbc)
+#ifdef LINCS_SIMD
+    if (lincsd->bUseSimd)
     {
-        for (b = b0; b < b1; b++)
-        {
-            pbc_dx_aiuc(pbc, x[bla[2*b]], x[bla[2*b+1]], dx);
-            unitv(dx, r[b]);
-        }
+        pbc_simd_t   pbc_simd;
+        const t_pbc *pbc_screw;
+
+        /* Compute normalized i-j vectors and the right-hand side */
+        lincs_set_pbc_simd(pbc, &pbc_simd, &pbc_screw);
+        calc_dr_x_xp_simd(b0, b1, bla, x, f, NULL, blc,
+                          &pbc_simd, pbc_screw, r, rhs1, sol);
+
+        blcc = lincsd->simd_blcc;
+#pragma omp barrier
+        calc_blcc_simd(b0, b1, lincsd->simd_blnr, lincsd->simd_blbnb,
+                       econq != econqForce ? lincsd->simd_blmf : lincsd->simd_blmf1,
+                       r, blcc);
     }
     else
+#endif
     {
-        for (b = b0; b < b1; b++)
+        /* Compute normalized i-j vectors */
+        if (pbc)
         {
-            rvec_sub(x[bla[2*b]], x[bla[2*b+1]], dx);
-            unitv(dx, r[b]);
-        } /* 16 ncons flops */
-    }
+            for (b = b0; b < b1; b++)
+            {
+                pbc_dx_aiuc(pbc, x[bla[2*b]], x[bla[2*b+1]], dx);
+                unitv(dx, r[b]);
+            }
+        }
+        else
+        {
+            for (b = b0; b < b1; b++)
+            {
+                rvec_sub(x[bla[2*b]], x[bla[2*b+1]], dx);
+                unitv(dx, r[b]);
+            } /* 16 ncons flops */
+        }
 
 #pragma omp barrier
-    for (b = b0; b < b1; b++)
-    {
-        tmp0 = r[b][0];
-        tmp1 = r[b][1];
-        tmp2 = r[b][2];
-        i    = bla[2*b];
-        j    = bla[2*b+1];
-        for (n = blnr[b]; n < blnr[b+1]; n++)
-        {
-            k       = blbnb[n];
-            blcc[n] = blmf[n]*(tmp0*r[k][0] + tmp1*r[k][1] + tmp2*r[k][2]);
-        } /* 6 nr flops */
-        mvb = blc[b]*(tmp0*(f[i][0] - f[j][0]) +
-                      tmp1*(f[i][1] - f[j][1]) +
-                      tmp2*(f[i][2] - f[j][2]));
-        rhs1[b] = mvb;
-        sol[b]  = mvb;
-        /* 7 flops */
-    }
-    /* Together: 23*ncons + 6*nrtot flops */
+        for (b = b0; b < b1; b++)
+        {
+            tmp0 = r[b][0];
+            tmp1 = r[b][1];
+            tmp2 = r[b][2];
+            i    = bla[2*b];
+            j    = bla[2*b+1];
+            for (n = blnr[b]; n < blnr[b+1]; n++)
+            {
+                k       = blbnb[n];
+                blcc[n] = blmf[n]*(tmp0*r[k][0] + tmp1*r[k][1] + tmp2*r[k][2]);
+            } /* 6 nr flops */
+            mvb = blc[b]*(tmp0*(f[i][0] - f[j][0]) +
+                          tmp1*(f[i][1] - f[j][1]) +
+                          tmp2*(f[i][2] - f[j][2]));
+            rhs1[b] = mvb;
+            sol[b]  = mvb;
+            /* 7 flops */
+        }
+        /* Together: 23*ncons + 6*nrtot flops */
+    }
 
     lincs_matrix_expand(lincsd, b0, b1, blcc, rhs1, rhs2, sol);
     /* nrec*(ncons+2*nrtot) flops */
@@ -515,6 +961,10 @@ static void do_lincs(rvec *x, rvec *xp, matrix box, t_pbc *pbc,
     rvec    *r;
     real    *blc, *blmf, *bllen, *blcc, *rhs1, *rhs2, *sol, *blc_sol, *mlambda;
     int     *nlocat;
+#ifdef LINCS_SIMD
+    pbc_simd_t   pbc_simd;
+    const t_pbc *pbc_screw = NULL;
+#endif
 
     b0 = lincsd->th[th].b0;
     b1 = lincsd->th[th].b1;
@@ -542,6 +992,22 @@ static void do_lincs(rvec *x, rvec *xp, matrix box, t_pbc *pbc,
         nlocat = NULL;
     }
 
+#ifdef LINCS_SIMD
+    if (lincsd->bUseSimd)
+    {
+        lincs_set_pbc_simd(pbc, &pbc_simd, &pbc_screw);
+
+        /* Compute normalized i-j vectors and the right-hand side */
+        calc_dr_x_xp_simd(b0, b1, bla, x, xp, bllen, blc,
+                          &pbc_simd, pbc_screw, r, rhs1, sol);
+
+        blcc = lincsd->simd_blcc;
+#pragma omp barrier
+        calc_blcc_simd(b0, b1, lincsd->simd_blnr, lincsd->simd_blbnb,
+                       lincsd->simd_blmf, r, blcc);
+    }
+    else
+#endif
     if (pbc)
     {
         /* Compute normalized i-j vectors */
@@ -637,35 +1103,45 @@ static void do_lincs(rvec *x, rvec *xp, matrix box, t_pbc *pbc,
         }
 
 #pragma omp barrier
-        for (b = b0; b < b1; b++)
+#ifdef LINCS_SIMD
+        if (lincsd->bUseSimd)
         {
-            len = bllen[b];
-            if (pbc)
-            {
-                pbc_dx_aiuc(pbc, xp[bla[2*b]], xp[bla[2*b+1]], dx);
-            }
-            else
-            {
-                rvec_sub(xp[bla[2*b]], xp[bla[2*b+1]], dx);
-            }
-            len2  = len*len;
-            dlen2 = 2*len2 - norm2(dx);
-            if (dlen2 < wfac*len2 && (nlocat == NULL || nlocat[b]))
-            {
-                /* not race free - see detailed comment in caller */
-                *warn = b;
-            }
-            if (dlen2 > 0)
-            {
-                mvb = blc[b]*(len - dlen2*gmx_invsqrt(dlen2));
-            }
-            else
+            calc_dist_iter_simd(b0, b1, bla, xp, bllen, blc, &pbc_simd, pbc_screw,
+                                wfac, nlocat, rhs1, sol, warn);
+        }
+        else
+#endif
+        {
+            for (b = b0; b < b1; b++)
             {
-                mvb = blc[b]*len;
-            }
-            rhs1[b] = mvb;
-            sol[b]  = mvb;
-        } /* 20*ncons flops */
+                len = bllen[b];
+                if (pbc)
+                {
+                    pbc_dx_aiuc(pbc, xp[bla[2*b]], xp[bla[2*b+1]], dx);
+                }
+                else
+                {
+                    rvec_sub(xp[bla[2*b]], xp[bla[2*b+1]], dx);
+                }
+                len2  = len*len;
+                dlen2 = 2*len2 - norm2(dx);
+                if (dlen2 < wfac*len2 && (nlocat == NULL || nlocat[b]))
+                {
+                    /* not race free - see detailed comment in caller */
+                    *warn = b;
+                }
+                if (dlen2 > 0)
+                {
+                    mvb = blc[b]*(len - dlen2*gmx_invsqrt(dlen2));
+                }
+                else
+                {
+                    mvb = blc[b]*len;
+                }
+                rhs1[b] = mvb;
+                sol[b]  = mvb;
+            } /* 20*ncons flops */
+        }
 
         lincs_matrix_expand(lincsd, b0, b1, blcc, rhs1, rhs2, sol);
         /* nrec*(ncons+2*nrtot) flops */
@@ -744,6 +1220,84 @@ static void do_lincs(rvec *x, rvec *xp, matrix box, t_pbc *pbc,
      */
 }
 
+#ifdef LINCS_SIMD
+/* Sets up the coupling matrix index in SIMD block layout.
+ * Coupling n of constraint b in block k=b/GMX_SIMD_REAL_WIDTH is stored
+ * at simd_blnr[k] + n*GMX_SIMD_REAL_WIDTH + b % GMX_SIMD_REAL_WIDTH.
+ * All constraints in a block are padded to the maximum number of couplings
+ * in the block with a coupling to themselves, which gets coefficient 0.
+ */
+static void set_lincs_simd_layout(struct gmx_lincsdata *li)
+{
+    int nblock, k, s, b, n, nmax, c, ncc_simd;
+
+    nblock = (li->nc + GMX_SIMD_REAL_WIDTH - 1)/GMX_SIMD_REAL_WIDTH;
+    if (nblock + 1 > li->simd_nblock_alloc)
+    {
+        li->simd_nblock_alloc = over_alloc_dd(nblock + 1);
+        srenew(li->simd_blnr, li->simd_nblock_alloc);
+    }
+
+    li->simd_blnr[0] = 0;
+    for (k = 0; k < nblock; k++)
+    {
+        nmax = 0;
+        for (b = k*GMX_SIMD_REAL_WIDTH; b < (k + 1)*GMX_SIMD_REAL_WIDTH; b++)
+        {
+            nmax = std::max(nmax, li->blnr[b+1] - li->blnr[b]);
+        }
+        li->simd_blnr[k+1] = li->simd_blnr[k] + nmax*GMX_SIMD_REAL_WIDTH;
+    }
+
+    ncc_simd = li->simd_blnr[nblock];
+    if (ncc_simd > li->simd_ncc_alloc)
+    {
+        li->simd_ncc_alloc = over_alloc_dd(ncc_simd);
+        srenew(li->simd_blbnb, li->simd_ncc_alloc);
+        sfree_aligned(li->simd_blmf);
+        sfree_aligned(li->simd_blmf1);
+        sfree_aligned(li->simd_blcc);
+        snew_aligned(li->simd_blmf, li->simd_ncc_alloc, LINCS_ALIGN_BYTES);
+        snew_aligned(li->simd_blmf1, li->simd_ncc_alloc, LINCS_ALIGN_BYTES);
+        snew_aligned(li->simd_blcc, li->simd_ncc_alloc, LINCS_ALIGN_BYTES);
+    }
+
+    for (k = 0; k < nblock; k++)
+    {
+        for (s = 0; s < GMX_SIMD_REAL_WIDTH; s++)
+        {
+            b = k*GMX_SIMD_REAL_WIDTH + s;
+            for (c = li->simd_blnr[k] + s, n = li->blnr[b]; c < li->simd_blnr[k+1]; c += GMX_SIMD_REAL_WIDTH, n++)
+            {
+                li->simd_blbnb[c] = (n < li->blnr[b+1] ? li->blbnb[n] : b);
+            }
+        }
+    }
+}
+
+/* Copies the mass factors blmf and blmf1 into SIMD block layout,
+ * the padding couplings get 0.
+ */
+static void set_lincs_simd_matrix(struct gmx_lincsdata *li)
+{
+    int nblock, k, s, b, n, c;
+
+    nblock = (li->nc + GMX_SIMD_REAL_WIDTH - 1)/GMX_SIMD_REAL_WIDTH;
+    for (k = 0; k < nblock; k++)
+    {
+        for (s = 0; s < GMX_SIMD_REAL_WIDTH; s++)
+        {
+            b = k*GMX_SIMD_REAL_WIDTH + s;
+            for (c = li->simd_blnr[k] + s, n = li->blnr[b]; c < li->simd_blnr[k+1]; c += GMX_SIMD_REAL_WIDTH, n++)
+            {
+                li->simd_blmf[c]  = (n < li->blnr[b+1] ? li->blmf[n] : 0);
+                li->simd_blmf1[c] = (n < li->blnr[b+1] ? li->blmf1[n] : 0);
+            }
+        }
+    }
+}
+#endif
+
 void set_lincs_matrix(struct gmx_lincsdata *li, real *invmass, real lambda)
 {
     int        i, a1, a2, n, k, sign, center;
@@ -757,6 +1311,12 @@ void set_lincs_matrix(struct gmx_lincsdata *li, real *invmass, real lambda)
         li->blc[i]  = gmx_invsqrt(invmass[a1] + invmass[a2]);
         li->blc1[i] = invsqrt2;
     }
+    /* Zero the padding constraints, so they do not generate corrections */
+    for (i = li->nc; i < ((li->nc + LINCS_BLOCK_SIZE - 1)/LINCS_BLOCK_SIZE)*LINCS_BLOCK_SIZE; i++)
+    {
+        li->blc[i]  = 0;
+        li->blc1[i] = 0;
+    }
 
     /* Construct the coupling coefficient matrix blmf */
     li->ntriangle    = 0;
@@ -819,6 +1379,13 @@ void set_lincs_matrix(struct gmx_lincsdata *li, real *invmass, real lambda)
         }
     }
 
+#ifdef LINCS_SIMD
+    if (li->bUseSimd)
+    {
+        set_lincs_simd_matrix(li);
+    }
+#endif
+
     if (debug)
     {
         fprintf(debug, "Of the %d constraints %d participate in triangles\n",
@@ -933,7 +1500,8 @@ static int int_comp(const void *a, const void *b)
 
 gmx_lincsdata_t init_lincs(FILE *fplog, gmx_mtop_t *mtop,
                            int nflexcon_global, t_blocka *at2con,
-                           gmx_bool bPLINCS, int nIter, int nProjOrder)
+                           gmx_bool bPLINCS, int nIter, int nProjOrder,
+                           gmx_bool bUseSimd)
 {
     struct gmx_lincsdata *li;
     int                   mb;
@@ -955,6 +1523,8 @@ gmx_lincsdata_t init_lincs(FILE *fplog, gmx_mtop_t *mtop,
     li->nIter  = nIter;
     li->nOrder = nProjOrder;
 
+    li->bUseSimd = bUseSimd;
+
     li->ncg_triangle = 0;
     li->bCommIter    = FALSE;
     for (mb = 0; mb < mtop->nmolblock; mb++)
@@ -1037,7 +1607,7 @@ static void lincs_thread_setup(struct gmx_lincsdata *li, int natoms)
     lincs_thread_t *li_m;
     int             th;
     gmx_bitmask_t  *atf;
-    int             a;
+    int             a, nblock;
 
     if (natoms > li->atf_nalloc)
     {
@@ -1057,6 +1627,11 @@ static void lincs_thread_setup(struct gmx_lincsdata *li, int natoms)
         gmx_fatal(FARGS, "More than %d threads is not supported for LINCS.", BITMASK_SIZE);
     }
 
+    /* The constraints are divided equally over the threads,
+     * in blocks of LINCS_BLOCK_SIZE, so each thread starts at a SIMD block.
+     */
+    nblock = (li->nc + LINCS_BLOCK_SIZE - 1)/LINCS_BLOCK_SIZE;
+
     for (th = 0; th < li->nth; th++)
     {
         lincs_thread_t *li_th;
@@ -1064,9 +1639,8 @@ static void lincs_thread_setup(struct gmx_lincsdata *li, int natoms)
 
         li_th = &li->th[th];
 
-        /* The constraints are divided equally over the threads */
-        li_th->b0 = (li->nc* th   )/li->nth;
-        li_th->b1 = (li->nc*(th+1))/li->nth;
+        li_th->b0 = std::min(li->nc, ((nblock* th   )/li->nth)*LINCS_BLOCK_SIZE);
+        li_th->b1 = std::min(li->nc, ((nblock*(th+1))/li->nth)*LINCS_BLOCK_SIZE);
 
         /* For each atom set a flag for constraints from each */
         for (b = li_th->b0; b < li_th->b1; b++)
@@ -1219,19 +1793,30 @@ void set_lincs(t_idef *idef, t_mdatoms *md,
     if (idef->il[F_CONSTR].nr/3 > li->nc_alloc || li->nc_alloc == 0)
     {
         li->nc_alloc = over_alloc_dd(idef->il[F_CONSTR].nr/3);
+        /* Allocate whole SIMD blocks, so we can pad with dummy constraints */
+        li->nc_alloc = ((li->nc_alloc + LINCS_BLOCK_SIZE - 1)/LINCS_BLOCK_SIZE)*LINCS_BLOCK_SIZE;
         srenew(li->bllen0, li->nc_alloc);
         srenew(li->ddist, li->nc_alloc);
         srenew(li->bla, 2*li->nc_alloc);
-        srenew(li->blc, li->nc_alloc);
-        srenew(li->blc1, li->nc_alloc);
         srenew(li->blnr, li->nc_alloc+1);
-        srenew(li->bllen, li->nc_alloc);
         srenew(li->tmpv, li->nc_alloc);
-        srenew(li->tmp1, li->nc_alloc);
-        srenew(li->tmp2, li->nc_alloc);
-        srenew(li->tmp3, li->nc_alloc);
         srenew(li->tmp4, li->nc_alloc);
         srenew(li->mlambda, li->nc_alloc);
+        /* The arrays accessed with SIMD loads and stores need to be aligned.
+         * Their contents do not need to be preserved.
+         */
+        sfree_aligned(li->blc);
+        sfree_aligned(li->blc1);
+        sfree_aligned(li->bllen);
+        sfree_aligned(li->tmp1);
+        sfree_aligned(li->tmp2);
+        sfree_aligned(li->tmp3);
+        snew_aligned(li->blc, li->nc_alloc, LINCS_ALIGN_BYTES);
+        snew_aligned(li->blc1, li->nc_alloc, LINCS_ALIGN_BYTES);
+        snew_aligned(li->bllen, li->nc_alloc, LINCS_ALIGN_BYTES);
+        snew_aligned(li->tmp1, li->nc_alloc, LINCS_ALIGN_BYTES);
+        snew_aligned(li->tmp2, li->nc_alloc, LINCS_ALIGN_BYTES);
+        snew_aligned(li->tmp3, li->nc_alloc, LINCS_ALIGN_BYTES);
         if (li->ncg_triangle > 0)
         {
             /* This is allocating too much, but it is difficult to improve */
@@ -1313,6 +1898,20 @@ void set_lincs(t_idef *idef, t_mdatoms *md,
      */
     li->nc = con;
 
+    /* Pad the constraint arrays up to a whole SIMD block with dummy
+     * constraints between the same atom with zero length.
+     * blc and blc1 are set to zero for these in set_lincs_matrix.
+     */
+    for (i = li->nc; i < ((li->nc + LINCS_BLOCK_SIZE - 1)/LINCS_BLOCK_SIZE)*LINCS_BLOCK_SIZE; i++)
+    {
+        li->bllen0[i]  = 0;
+        li->ddist[i]   = 0;
+        li->bllen[i]   = 0;
+        li->bla[2*i]   = li->bla[0];
+        li->bla[2*i+1] = li->bla[0];
+        li->blnr[i+1]  = li->blnr[i];
+    }
+
     li->ncc = li->blnr[con];
     if (cr->dd == NULL)
     {
@@ -1329,6 +1928,13 @@ void set_lincs(t_idef *idef, t_mdatoms *md,
         srenew(li->tmpncc, li->ncc_alloc);
     }
 
+#ifdef LINCS_SIMD
+    if (li->bUseSimd)
+    {
+        set_lincs_simd_layout(li);
+    }
+#endif
+
     if (debug)
     {
         fprintf(debug, "Number of constraints is %d, couplings %d\n",
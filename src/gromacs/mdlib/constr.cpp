@@ -1026,7 +1026,8 @@ void set_constraints(struct gmx_constr *constr,
             settle_init(md->massT[iO], md->massT[iH],
                         md->invmass[iO], md->invmass[iH],
                         idef->iparams[settle->iatoms[0]].settle.doh,
-                        idef->iparams[settle->iatoms[0]].settle.dhh);
+                        idef->iparams[settle->iatoms[0]].settle.dhh,
+                        getenv("GMX_DISABLE_SIMD_KERNELS") == NULL);
     }
 
     /* Make a selection of the local atoms for essential dynamics */
@@ -1291,7 +1292,8 @@ gmx_constr_t init_constraints(FILE *fplog,
             constr->lincsd = init_lincs(fplog, mtop,
                                         constr->nflexcon, constr->at2con_mt,
                                         DOMAINDECOMP(cr) && cr->dd->bInterCGcons,
-                                        ir->nLincsIter, ir->nProjOrder);
+                                        ir->nLincsIter, ir->nProjOrder,
+                                        getenv("GMX_DISABLE_SIMD_KERNELS") == NULL);
         }
 
         if (ir->eConstrAlg == econtSHAKE)
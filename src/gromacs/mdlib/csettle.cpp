@@ -43,6 +43,10 @@
 #include "gromacs/math/vec.h"
 #include "gromacs/pbcutil/ishift.h"
 #include "gromacs/pbcutil/pbc.h"
+#include "gromacs/pbcutil/pbc-simd.h"
+#include "gromacs/simd/simd.h"
+#include "gromacs/simd/simd_math.h"
+#include "gromacs/simd/vector_operations.h"
 #include "gromacs/utility/fatalerror.h"
 #include "gromacs/utility/smalloc.h"
 
@@ -69,6 +73,7 @@ typedef struct gmx_settledata
 {
     settleparam_t massw;
     settleparam_t mass1;
+    gmx_bool      bUseSimd; /* Use the SIMD kernels, when supported */
 } t_gmx_settledata;
 
 
@@ -136,7 +141,7 @@ static void settleparam_init(settleparam_t *p,
 }
 
 gmx_settledata_t settle_init(real mO, real mH, real invmO, real invmH,
-                             real dOH, real dHH)
+                             real dOH, real dHH, gmx_bool bUseSimd)
 {
     gmx_settledata_t settled;
 
@@ -146,6 +151,8 @@ gmx_settledata_t settle_init(real mO, real mH, real invmO, real invmH,
 
     settleparam_init(&settled->mass1, 1.0, 1.0, 1.0, 1.0, dOH, dHH);
 
+    settled->bUseSimd = bUseSimd;
+
     return settled;
 }
 
@@ -166,6 +173,520 @@ static void check_cons(FILE *fp, char *title, real x[], int OW1, int HW2, int HW
 }
 #endif
 
+#ifdef GMX_SIMD_HAVE_REAL
+
+/* The SIMD SETTLE kernels below process GMX_SIMD_REAL_WIDTH waters at once.
+ * As in the SIMD bonded kernels, the coordinates are gathered into
+ * aligned, packed buffers and the corrections are scattered back.
+ * The remaining waters, less than the SIMD width, are left to the plain
+ * C loops. pbc_dx_simd does not support screw PBC.
+ */
+static gmx_bool settle_simd_supported(const t_pbc *pbc)
+{
+    return (pbc == NULL || pbc->ePBC != epbcSCREW);
+}
+
+/* Gather the coordinates of atoms a[] from x[] into SIMD-packed buf */
+static gmx_inline void
+settle_gather_rvec(const real *x, const int *a, real *buf)
+{
+    int s, m;
+
+    for (s = 0; s < GMX_SIMD_REAL_WIDTH; s++)
+    {
+        for (m = 0; m < DIM; m++)
+        {
+            buf[m*GMX_SIMD_REAL_WIDTH + s] = x[a[s]*DIM + m];
+        }
+    }
+}
+
+/* SIMD version of the SETTLE loop in csettle.
+ * Returns the number of settles processed, which is a multiple
+ * of the SIMD width.
+ */
+static int
+csettle_simd(const settleparam_t *p,
+             int nsettle, const t_iatom iatoms[],
+             const t_pbc *pbc,
+             const real b4[], real after[],
+             real invdts, real *v, int CalcVirAtomEnd,
+             real mOs, real mHs,
+             tensor vir_r_m_dr,
+             int *error)
+{
+    int             nsimd, i, s, m, d, d2;
+    int             ow1[GMX_SIMD_REAL_WIDTH], hw2[GMX_SIMD_REAL_WIDTH];
+    int             hw3[GMX_SIMD_REAL_WIDTH];
+    real            buf_array[(2*DIM*DIM + 2)*GMX_SIMD_REAL_WIDTH + GMX_SIMD_REAL_WIDTH];
+    real           *x_b4, *x_after, *dx_buf, *virfac, *ok;
+    gmx_bool        bVir;
+    pbc_simd_t      pbc_simd;
+    gmx_simd_real_t zero_S, one_S, minus_wh_S, ra_S, rb_S, rc_S, irc2_S, inv_ra_S;
+    gmx_simd_real_t mOs_S, mHs_S;
+    gmx_simd_real_t xO_S, yO_S, zO_S;
+    gmx_simd_real_t xb0, yb0, zb0, xc0, yc0, zc0;
+    gmx_simd_real_t doh2x, doh2y, doh2z, doh3x, doh3y, doh3z;
+    gmx_simd_real_t xa1, ya1, za1, xb1, yb1, zb1, xc1, yc1, zc1;
+    gmx_simd_real_t xakszd, yakszd, zakszd, xaksxd, yaksxd, zaksxd;
+    gmx_simd_real_t xaksyd, yaksyd, zaksyd, axlng, aylng, azlng;
+    gmx_simd_real_t trns11, trns21, trns31, trns12, trns22, trns32;
+    gmx_simd_real_t trns13, trns23, trns33;
+    gmx_simd_real_t xb0d, yb0d, xc0d, yc0d, za1d;
+    gmx_simd_real_t xb1d, yb1d, zb1d, xc1d, yc1d, zc1d;
+    gmx_simd_real_t sinphi, cosphi, sinpsi, cospsi, tmp, tmp2, t1, t2;
+    gmx_simd_real_t ya2d, xb2d, yb2d, yc2d;
+    gmx_simd_real_t alpa, beta, gama, al2be2, sinthe, costhe;
+    gmx_simd_real_t xa3d, ya3d, xb3d, yb3d, xc3d, yc3d;
+    gmx_simd_real_t da[DIM], db[DIM], dc[DIM];
+    gmx_simd_real_t rO[DIM], rb0[DIM], rc0[DIM];
+    gmx_simd_real_t vir_S[DIM][DIM];
+    gmx_simd_bool_t bOK;
+
+    nsimd = (nsettle/GMX_SIMD_REAL_WIDTH)*GMX_SIMD_REAL_WIDTH;
+
+    /* Ensure register memory alignment */
+    x_b4    = gmx_simd_align_r(buf_array);
+    x_after = x_b4 + DIM*DIM*GMX_SIMD_REAL_WIDTH;
+    virfac  = x_after + DIM*DIM*GMX_SIMD_REAL_WIDTH;
+    ok      = virfac + GMX_SIMD_REAL_WIDTH;
+    /* We store the displacements in the buffer of the new coordinates */
+    dx_buf  = x_after;
+
+    set_pbc_simd(pbc, &pbc_simd);
+
+    zero_S     = gmx_simd_setzero_r();
+    one_S      = gmx_simd_set1_r(1.0);
+    minus_wh_S = gmx_simd_set1_r(-p->wh);
+    ra_S       = gmx_simd_set1_r(p->ra);
+    rb_S       = gmx_simd_set1_r(p->rb);
+    rc_S       = gmx_simd_set1_r(p->rc);
+    irc2_S     = gmx_simd_set1_r(p->irc2);
+    inv_ra_S   = gmx_simd_set1_r(1.0/p->ra);
+
+    bVir = (CalcVirAtomEnd > 0);
+    for (d = 0; d < DIM; d++)
+    {
+        for (d2 = 0; d2 < DIM; d2++)
+        {
+            vir_S[d][d2] = zero_S;
+        }
+    }
+
+    for (i = 0; i < nsimd; i += GMX_SIMD_REAL_WIDTH)
+    {
+        for (s = 0; s < GMX_SIMD_REAL_WIDTH; s++)
+        {
+            ow1[s]    = iatoms[(i + s)*4 + 1];
+            hw2[s]    = iatoms[(i + s)*4 + 2];
+            hw3[s]    = iatoms[(i + s)*4 + 3];
+            virfac[s] = (ow1[s]*DIM < CalcVirAtomEnd ? 1 : 0);
+        }
+        settle_gather_rvec(b4, ow1, x_b4);
+        settle_gather_rvec(b4, hw2, x_b4 + DIM*GMX_SIMD_REAL_WIDTH);
+        settle_gather_rvec(b4, hw3, x_b4 + 2*DIM*GMX_SIMD_REAL_WIDTH);
+        settle_gather_rvec(after, ow1, x_after);
+        settle_gather_rvec(after, hw2, x_after + DIM*GMX_SIMD_REAL_WIDTH);
+        settle_gather_rvec(after, hw3, x_after + 2*DIM*GMX_SIMD_REAL_WIDTH);
+
+        /*    --- Step1  A1' ---      */
+        xO_S  = gmx_simd_load_r(x_b4 + 0*GMX_SIMD_REAL_WIDTH);
+        yO_S  = gmx_simd_load_r(x_b4 + 1*GMX_SIMD_REAL_WIDTH);
+        zO_S  = gmx_simd_load_r(x_b4 + 2*GMX_SIMD_REAL_WIDTH);
+        xb0   = gmx_simd_sub_r(gmx_simd_load_r(x_b4 + 3*GMX_SIMD_REAL_WIDTH), xO_S);
+        yb0   = gmx_simd_sub_r(gmx_simd_load_r(x_b4 + 4*GMX_SIMD_REAL_WIDTH), yO_S);
+        zb0   = gmx_simd_sub_r(gmx_simd_load_r(x_b4 + 5*GMX_SIMD_REAL_WIDTH), zO_S);
+        xc0   = gmx_simd_sub_r(gmx_simd_load_r(x_b4 + 6*GMX_SIMD_REAL_WIDTH), xO_S);
+        yc0   = gmx_simd_sub_r(gmx_simd_load_r(x_b4 + 7*GMX_SIMD_REAL_WIDTH), yO_S);
+        zc0   = gmx_simd_sub_r(gmx_simd_load_r(x_b4 + 8*GMX_SIMD_REAL_WIDTH), zO_S);
+        pbc_dx_simd(&xb0, &yb0, &zb0, &pbc_simd);
+        pbc_dx_simd(&xc0, &yc0, &zc0, &pbc_simd);
+
+        t1    = gmx_simd_load_r(x_after + 0*GMX_SIMD_REAL_WIDTH);
+        t2    = gmx_simd_load_r(x_after + 1*GMX_SIMD_REAL_WIDTH);
+        tmp   = gmx_simd_load_r(x_after + 2*GMX_SIMD_REAL_WIDTH);
+        doh2x = gmx_simd_sub_r(gmx_simd_load_r(x_after + 3*GMX_SIMD_REAL_WIDTH), t1);
+        doh2y = gmx_simd_sub_r(gmx_simd_load_r(x_after + 4*GMX_SIMD_REAL_WIDTH), t2);
+        doh2z = gmx_simd_sub_r(gmx_simd_load_r(x_after + 5*GMX_SIMD_REAL_WIDTH), tmp);
+        doh3x = gmx_simd_sub_r(gmx_simd_load_r(x_after + 6*GMX_SIMD_REAL_WIDTH), t1);
+        doh3y = gmx_simd_sub_r(gmx_simd_load_r(x_after + 7*GMX_SIMD_REAL_WIDTH), t2);
+        doh3z = gmx_simd_sub_r(gmx_simd_load_r(x_after + 8*GMX_SIMD_REAL_WIDTH), tmp);
+        pbc_dx_simd(&doh2x, &doh2y, &doh2z, &pbc_simd);
+        pbc_dx_simd(&doh3x, &doh3y, &doh3z, &pbc_simd);
+
+        /* As in the plain C code, we compute the center of mass
+         * from the O-H distances. We work with positions relative
+         * to the center of mass, so we don't need to shift the hydrogens.
+         */
+        xa1 = gmx_simd_mul_r(gmx_simd_add_r(doh2x, doh3x), minus_wh_S);
+        ya1 = gmx_simd_mul_r(gmx_simd_add_r(doh2y, doh3y), minus_wh_S);
+        za1 = gmx_simd_mul_r(gmx_simd_add_r(doh2z, doh3z), minus_wh_S);
+
+        xb1 = gmx_simd_add_r(doh2x, xa1);
+        yb1 = gmx_simd_add_r(doh2y, ya1);
+        zb1 = gmx_simd_add_r(doh2z, za1);
+        xc1 = gmx_simd_add_r(doh3x, xa1);
+        yc1 = gmx_simd_add_r(doh3y, ya1);
+        zc1 = gmx_simd_add_r(doh3z, za1);
+
+        gmx_simd_cprod_r(xb0, yb0, zb0, xc0, yc0, zc0,
+                         &xakszd, &yakszd, &zakszd);
+        gmx_simd_cprod_r(xa1, ya1, za1, xakszd, yakszd, zakszd,
+                         &xaksxd, &yaksxd, &zaksxd);
+        gmx_simd_cprod_r(xakszd, yakszd, zakszd, xaksxd, yaksxd, zaksxd,
+                         &xaksyd, &yaksyd, &zaksyd);
+
+        axlng  = gmx_simd_invsqrt_r(gmx_simd_norm2_r(xaksxd, yaksxd, zaksxd));
+        aylng  = gmx_simd_invsqrt_r(gmx_simd_norm2_r(xaksyd, yaksyd, zaksyd));
+        azlng  = gmx_simd_invsqrt_r(gmx_simd_norm2_r(xakszd, yakszd, zakszd));
+
+        trns11 = gmx_simd_mul_r(xaksxd, axlng);
+        trns21 = gmx_simd_mul_r(yaksxd, axlng);
+        trns31 = gmx_simd_mul_r(zaksxd, axlng);
+        trns12 = gmx_simd_mul_r(xaksyd, aylng);
+        trns22 = gmx_simd_mul_r(yaksyd, aylng);
+        trns32 = gmx_simd_mul_r(zaksyd, aylng);
+        trns13 = gmx_simd_mul_r(xakszd, azlng);
+        trns23 = gmx_simd_mul_r(yakszd, azlng);
+        trns33 = gmx_simd_mul_r(zakszd, azlng);
+
+        xb0d = gmx_simd_iprod_r(trns11, trns21, trns31, xb0, yb0, zb0);
+        yb0d = gmx_simd_iprod_r(trns12, trns22, trns32, xb0, yb0, zb0);
+        xc0d = gmx_simd_iprod_r(trns11, trns21, trns31, xc0, yc0, zc0);
+        yc0d = gmx_simd_iprod_r(trns12, trns22, trns32, xc0, yc0, zc0);
+        za1d = gmx_simd_iprod_r(trns13, trns23, trns33, xa1, ya1, za1);
+        xb1d = gmx_simd_iprod_r(trns11, trns21, trns31, xb1, yb1, zb1);
+        yb1d = gmx_simd_iprod_r(trns12, trns22, trns32, xb1, yb1, zb1);
+        zb1d = gmx_simd_iprod_r(trns13, trns23, trns33, xb1, yb1, zb1);
+        xc1d = gmx_simd_iprod_r(trns11, trns21, trns31, xc1, yc1, zc1);
+        yc1d = gmx_simd_iprod_r(trns12, trns22, trns32, xc1, yc1, zc1);
+        zc1d = gmx_simd_iprod_r(trns13, trns23, trns33, xc1, yc1, zc1);
+
+        /* Waters for which SETTLE fails are masked out with bOK.
+         * We replace their square root arguments by 1 to avoid NaNs.
+         */
+        sinphi = gmx_simd_mul_r(za1d, inv_ra_S);
+        tmp    = gmx_simd_fnmadd_r(sinphi, sinphi, one_S);
+        bOK    = gmx_simd_cmplt_r(zero_S, tmp);
+        tmp    = gmx_simd_blendv_r(one_S, tmp, bOK);
+        tmp2   = gmx_simd_invsqrt_r(tmp);
+        cosphi = gmx_simd_mul_r(tmp, tmp2);
+        sinpsi = gmx_simd_mul_r(gmx_simd_mul_r(gmx_simd_sub_r(zb1d, zc1d), irc2_S), tmp2);
+        tmp2   = gmx_simd_fnmadd_r(sinpsi, sinpsi, one_S);
+        bOK    = gmx_simd_and_b(bOK, gmx_simd_cmplt_r(zero_S, tmp2));
+        tmp2   = gmx_simd_blendv_r(one_S, tmp2, bOK);
+        cospsi = gmx_simd_mul_r(tmp2, gmx_simd_invsqrt_r(tmp2));
+
+        ya2d   = gmx_simd_mul_r(ra_S, cosphi);
+        xb2d   = gmx_simd_mul_r(gmx_simd_sub_r(zero_S, rc_S), cospsi);
+        t1     = gmx_simd_mul_r(gmx_simd_sub_r(zero_S, rb_S), cosphi);
+        t2     = gmx_simd_mul_r(gmx_simd_mul_r(rc_S, sinpsi), sinphi);
+        yb2d   = gmx_simd_sub_r(t1, t2);
+        yc2d   = gmx_simd_add_r(t1, t2);
+
+        /*     --- Step3  al,be,ga            --- */
+        alpa   = gmx_simd_mul_r(xb2d, gmx_simd_sub_r(xb0d, xc0d));
+        alpa   = gmx_simd_fmadd_r(yb0d, yb2d, alpa);
+        alpa   = gmx_simd_fmadd_r(yc0d, yc2d, alpa);
+        beta   = gmx_simd_mul_r(xb2d, gmx_simd_sub_r(yc0d, yb0d));
+        beta   = gmx_simd_fmadd_r(xb0d, yb2d, beta);
+        beta   = gmx_simd_fmadd_r(xc0d, yc2d, beta);
+        gama   = gmx_simd_mul_r(xb0d, yb1d);
+        gama   = gmx_simd_fnmadd_r(xb1d, yb0d, gama);
+        gama   = gmx_simd_fmadd_r(xc0d, yc1d, gama);
+        gama   = gmx_simd_fnmadd_r(xc1d, yc0d, gama);
+        al2be2 = gmx_simd_fmadd_r(alpa, alpa, gmx_simd_mul_r(beta, beta));
+        tmp2   = gmx_simd_fnmadd_r(gama, gama, al2be2);
+        sinthe = gmx_simd_fnmadd_r(beta, gmx_simd_sqrt_r(tmp2), gmx_simd_mul_r(alpa, gama));
+        sinthe = gmx_simd_mul_r(sinthe, gmx_simd_inv_r(al2be2));
+
+        /*  --- Step4  A3' --- */
+        costhe = gmx_simd_sqrt_r(gmx_simd_fnmadd_r(sinthe, sinthe, one_S));
+        xa3d   = gmx_simd_sub_r(zero_S, gmx_simd_mul_r(ya2d, sinthe));
+        ya3d   = gmx_simd_mul_r(ya2d, costhe);
+        xb3d   = gmx_simd_fnmadd_r(yb2d, sinthe, gmx_simd_mul_r(xb2d, costhe));
+        yb3d   = gmx_simd_fmadd_r(yb2d, costhe, gmx_simd_mul_r(xb2d, sinthe));
+        xc3d   = gmx_simd_sub_r(zero_S, gmx_simd_fmadd_r(yc2d, sinthe, gmx_simd_mul_r(xb2d, costhe)));
+        yc3d   = gmx_simd_fnmadd_r(xb2d, sinthe, gmx_simd_mul_r(yc2d, costhe));
+
+        /*    --- Step5  A3 --- */
+        /* We only need the displacements, za3d=za1d, zb3d=zb1d, zc3d=zc1d */
+        da[XX] = gmx_simd_sub_r(gmx_simd_iprod_r(trns11, trns12, trns13, xa3d, ya3d, za1d), xa1);
+        da[YY] = gmx_simd_sub_r(gmx_simd_iprod_r(trns21, trns22, trns23, xa3d, ya3d, za1d), ya1);
+        da[ZZ] = gmx_simd_sub_r(gmx_simd_iprod_r(trns31, trns32, trns33, xa3d, ya3d, za1d), za1);
+        db[XX] = gmx_simd_sub_r(gmx_simd_iprod_r(trns11, trns12, trns13, xb3d, yb3d, zb1d), xb1);
+        db[YY] = gmx_simd_sub_r(gmx_simd_iprod_r(trns21, trns22, trns23, xb3d, yb3d, zb1d), yb1);
+        db[ZZ] = gmx_simd_sub_r(gmx_simd_iprod_r(trns31, trns32, trns33, xb3d, yb3d, zb1d), zb1);
+        dc[XX] = gmx_simd_sub_r(gmx_simd_iprod_r(trns11, trns12, trns13, xc3d, yc3d, zc1d), xc1);
+        dc[YY] = gmx_simd_sub_r(gmx_simd_iprod_r(trns21, trns22, trns23, xc3d, yc3d, zc1d), yc1);
+        dc[ZZ] = gmx_simd_sub_r(gmx_simd_iprod_r(trns31, trns32, trns33, xc3d, yc3d, zc1d), zc1);
+
+        for (m = 0; m < DIM; m++)
+        {
+            da[m] = gmx_simd_blendzero_r(da[m], bOK);
+            db[m] = gmx_simd_blendzero_r(db[m], bOK);
+            dc[m] = gmx_simd_blendzero_r(dc[m], bOK);
+            gmx_simd_store_r(dx_buf + (0*DIM + m)*GMX_SIMD_REAL_WIDTH, da[m]);
+            gmx_simd_store_r(dx_buf + (1*DIM + m)*GMX_SIMD_REAL_WIDTH, db[m]);
+            gmx_simd_store_r(dx_buf + (2*DIM + m)*GMX_SIMD_REAL_WIDTH, dc[m]);
+        }
+        gmx_simd_store_r(ok, gmx_simd_blendzero_r(one_S, bOK));
+
+        if (bVir)
+        {
+            /* Only waters with ow1 < CalcVirAtomEnd contribute */
+            mOs_S   = gmx_simd_mul_r(gmx_simd_set1_r(mOs), gmx_simd_load_r(virfac));
+            mHs_S   = gmx_simd_mul_r(gmx_simd_set1_r(mHs), gmx_simd_load_r(virfac));
+            rO[XX]  = xO_S;
+            rO[YY]  = yO_S;
+            rO[ZZ]  = zO_S;
+            rb0[XX] = gmx_simd_add_r(xO_S, xb0);
+            rb0[YY] = gmx_simd_add_r(yO_S, yb0);
+            rb0[ZZ] = gmx_simd_add_r(zO_S, zb0);
+            rc0[XX] = gmx_simd_add_r(xO_S, xc0);
+            rc0[YY] = gmx_simd_add_r(yO_S, yc0);
+            rc0[ZZ] = gmx_simd_add_r(zO_S, zc0);
+            for (d2 = 0; d2 < DIM; d2++)
+            {
+                da[d2] = gmx_simd_mul_r(mOs_S, da[d2]);
+                db[d2] = gmx_simd_mul_r(mHs_S, db[d2]);
+                dc[d2] = gmx_simd_mul_r(mHs_S, dc[d2]);
+            }
+            for (d = 0; d < DIM; d++)
+            {
+                for (d2 = 0; d2 < DIM; d2++)
+                {
+                    vir_S[d][d2] = gmx_simd_fnmadd_r(rO[d],  da[d2], vir_S[d][d2]);
+                    vir_S[d][d2] = gmx_simd_fnmadd_r(rb0[d], db[d2], vir_S[d][d2]);
+                    vir_S[d][d2] = gmx_simd_fnmadd_r(rc0[d], dc[d2], vir_S[d][d2]);
+                }
+            }
+        }
+
+        /* Scatter the displacements back */
+        for (s = 0; s < GMX_SIMD_REAL_WIDTH; s++)
+        {
+            if (ok[s] == 0)
+            {
+                *error = i + s;
+                continue;
+            }
+            for (m = 0; m < DIM; m++)
+            {
+                after[ow1[s]*DIM + m] += dx_buf[(0*DIM + m)*GMX_SIMD_REAL_WIDTH + s];
+                after[hw2[s]*DIM + m] += dx_buf[(1*DIM + m)*GMX_SIMD_REAL_WIDTH + s];
+                after[hw3[s]*DIM + m] += dx_buf[(2*DIM + m)*GMX_SIMD_REAL_WIDTH + s];
+            }
+            if (v != NULL)
+            {
+                for (m = 0; m < DIM; m++)
+                {
+                    v[ow1[s]*DIM + m] += dx_buf[(0*DIM + m)*GMX_SIMD_REAL_WIDTH + s]*invdts;
+                    v[hw2[s]*DIM + m] += dx_buf[(1*DIM + m)*GMX_SIMD_REAL_WIDTH + s]*invdts;
+                    v[hw3[s]*DIM + m] += dx_buf[(2*DIM + m)*GMX_SIMD_REAL_WIDTH + s]*invdts;
+                }
+            }
+        }
+    }
+
+    if (bVir)
+    {
+        for (d = 0; d < DIM; d++)
+        {
+            for (d2 = 0; d2 < DIM; d2++)
+            {
+                vir_r_m_dr[d][d2] += gmx_simd_reduce_r(vir_S[d][d2]);
+            }
+        }
+    }
+
+    return nsimd;
+}
+
+/* SIMD version of the projection loop in settle_proj.
+ * Returns the number of settles processed, which is a multiple
+ * of the SIMD width.
+ */
+static int
+settle_proj_simd(const settleparam_t *p,
+                 int nsettle, const t_iatom iatoms[],
+                 const t_pbc *pbc,
+                 const rvec x[],
+                 const rvec *der, rvec *derp,
+                 int calcvir_atom_end, tensor vir_r_m_dder,
+                 real veta, real vscale_nhc)
+{
+    int             nsimd, i, s, m, d, d2;
+    int             ow1[GMX_SIMD_REAL_WIDTH], hw2[GMX_SIMD_REAL_WIDTH];
+    int             hw3[GMX_SIMD_REAL_WIDTH];
+    real            buf_array[(2*DIM*DIM + 1)*GMX_SIMD_REAL_WIDTH + GMX_SIMD_REAL_WIDTH];
+    real           *x_buf, *der_buf, *virfac;
+    gmx_bool        bVir;
+    pbc_simd_t      pbc_simd;
+    gmx_simd_real_t zero_S, veta_S, vscale_nhc_S, imO_S, imH_S, invdOH_S, invdHH_S;
+    gmx_simd_real_t invmat_S[DIM][DIM];
+    gmx_simd_real_t xa[DIM], xb[DIM], xc[DIM];
+    gmx_simd_real_t derma[DIM], dermb[DIM], dermc[DIM];
+    gmx_simd_real_t roh2[DIM], roh3[DIM], rhh[DIM];
+    gmx_simd_real_t dc_S[DIM], fcv[DIM], w_oh2, w_oh3, w_hh;
+    gmx_simd_real_t vir_S[DIM][DIM];
+
+    nsimd = (nsettle/GMX_SIMD_REAL_WIDTH)*GMX_SIMD_REAL_WIDTH;
+
+    /* Ensure register memory alignment */
+    x_buf   = gmx_simd_align_r(buf_array);
+    der_buf = x_buf + DIM*DIM*GMX_SIMD_REAL_WIDTH;
+    virfac  = der_buf + DIM*DIM*GMX_SIMD_REAL_WIDTH;
+
+    set_pbc_simd(pbc, &pbc_simd);
+
+    zero_S       = gmx_simd_setzero_r();
+    veta_S       = gmx_simd_set1_r(veta);
+    vscale_nhc_S = gmx_simd_set1_r(vscale_nhc);
+    imO_S        = gmx_simd_set1_r(p->imO);
+    imH_S        = gmx_simd_set1_r(p->imH);
+    invdOH_S     = gmx_simd_set1_r(p->invdOH);
+    invdHH_S     = gmx_simd_set1_r(p->invdHH);
+    /* We divide by vscale_nhc here, as done for fcv in the plain C code */
+    for (d = 0; d < DIM; d++)
+    {
+        for (d2 = 0; d2 < DIM; d2++)
+        {
+            invmat_S[d][d2] = gmx_simd_set1_r(p->invmat[d][d2]/vscale_nhc);
+            vir_S[d][d2]    = zero_S;
+        }
+    }
+
+    bVir = (calcvir_atom_end > 0);
+
+    for (i = 0; i < nsimd; i += GMX_SIMD_REAL_WIDTH)
+    {
+        for (s = 0; s < GMX_SIMD_REAL_WIDTH; s++)
+        {
+            ow1[s]    = iatoms[(i + s)*4 + 1];
+            hw2[s]    = iatoms[(i + s)*4 + 2];
+            hw3[s]    = iatoms[(i + s)*4 + 3];
+            virfac[s] = (ow1[s] < calcvir_atom_end ? 1 : 0);
+        }
+        settle_gather_rvec(x[0], ow1, x_buf);
+        settle_gather_rvec(x[0], hw2, x_buf + DIM*GMX_SIMD_REAL_WIDTH);
+        settle_gather_rvec(x[0], hw3, x_buf + 2*DIM*GMX_SIMD_REAL_WIDTH);
+        settle_gather_rvec(der[0], ow1, der_buf);
+        settle_gather_rvec(der[0], hw2, der_buf + DIM*GMX_SIMD_REAL_WIDTH);
+        settle_gather_rvec(der[0], hw3, der_buf + 2*DIM*GMX_SIMD_REAL_WIDTH);
+
+        for (m = 0; m < DIM; m++)
+        {
+            xa[m]    = gmx_simd_load_r(x_buf + (0*DIM + m)*GMX_SIMD_REAL_WIDTH);
+            xb[m]    = gmx_simd_load_r(x_buf + (1*DIM + m)*GMX_SIMD_REAL_WIDTH);
+            xc[m]    = gmx_simd_load_r(x_buf + (2*DIM + m)*GMX_SIMD_REAL_WIDTH);
+
+            /* in the velocity case, these are the velocities, so we
+               need to modify with the pressure control velocities! */
+            derma[m] = gmx_simd_mul_r(vscale_nhc_S, gmx_simd_load_r(der_buf + (0*DIM + m)*GMX_SIMD_REAL_WIDTH));
+            derma[m] = gmx_simd_fmadd_r(veta_S, xa[m], derma[m]);
+            dermb[m] = gmx_simd_mul_r(vscale_nhc_S, gmx_simd_load_r(der_buf + (1*DIM + m)*GMX_SIMD_REAL_WIDTH));
+            dermb[m] = gmx_simd_fmadd_r(veta_S, xb[m], dermb[m]);
+            dermc[m] = gmx_simd_mul_r(vscale_nhc_S, gmx_simd_load_r(der_buf + (2*DIM + m)*GMX_SIMD_REAL_WIDTH));
+            dermc[m] = gmx_simd_fmadd_r(veta_S, xc[m], dermc[m]);
+
+            roh2[m]  = gmx_simd_sub_r(xa[m], xb[m]);
+            roh3[m]  = gmx_simd_sub_r(xa[m], xc[m]);
+            rhh[m]   = gmx_simd_sub_r(xb[m], xc[m]);
+        }
+        pbc_dx_simd(&roh2[XX], &roh2[YY], &roh2[ZZ], &pbc_simd);
+        pbc_dx_simd(&roh3[XX], &roh3[YY], &roh3[ZZ], &pbc_simd);
+        pbc_dx_simd(&rhh[XX], &rhh[YY], &rhh[ZZ], &pbc_simd);
+
+        for (m = 0; m < DIM; m++)
+        {
+            roh2[m] = gmx_simd_mul_r(invdOH_S, roh2[m]);
+            roh3[m] = gmx_simd_mul_r(invdOH_S, roh3[m]);
+            rhh[m]  = gmx_simd_mul_r(invdHH_S, rhh[m]);
+        }
+
+        /* Determine the projections of der(modified) on the bonds */
+        dc_S[0] = gmx_simd_iprod_r(gmx_simd_sub_r(derma[XX], dermb[XX]),
+                                   gmx_simd_sub_r(derma[YY], dermb[YY]),
+                                   gmx_simd_sub_r(derma[ZZ], dermb[ZZ]),
+                                   roh2[XX], roh2[YY], roh2[ZZ]);
+        dc_S[1] = gmx_simd_iprod_r(gmx_simd_sub_r(derma[XX], dermc[XX]),
+                                   gmx_simd_sub_r(derma[YY], dermc[YY]),
+                                   gmx_simd_sub_r(derma[ZZ], dermc[ZZ]),
+                                   roh3[XX], roh3[YY], roh3[ZZ]);
+        dc_S[2] = gmx_simd_iprod_r(gmx_simd_sub_r(dermb[XX], dermc[XX]),
+                                   gmx_simd_sub_r(dermb[YY], dermc[YY]),
+                                   gmx_simd_sub_r(dermb[ZZ], dermc[ZZ]),
+                                   rhh[XX], rhh[YY], rhh[ZZ]);
+
+        /* Determine the correction for the three bonds */
+        for (d = 0; d < DIM; d++)
+        {
+            fcv[d] = gmx_simd_iprod_r(invmat_S[d][XX], invmat_S[d][YY], invmat_S[d][ZZ],
+                                      dc_S[0], dc_S[1], dc_S[2]);
+        }
+
+        /* Store the corrections for derp, reusing the x buffers */
+        for (m = 0; m < DIM; m++)
+        {
+            xa[m] = gmx_simd_fmadd_r(fcv[0], roh2[m], gmx_simd_mul_r(fcv[1], roh3[m]));
+            xb[m] = gmx_simd_fnmadd_r(fcv[0], roh2[m], gmx_simd_mul_r(fcv[2], rhh[m]));
+            xc[m] = gmx_simd_fnmadd_r(fcv[1], roh3[m], gmx_simd_fnmadd_r(fcv[2], rhh[m], zero_S));
+            gmx_simd_store_r(x_buf + (0*DIM + m)*GMX_SIMD_REAL_WIDTH, gmx_simd_mul_r(imO_S, xa[m]));
+            gmx_simd_store_r(x_buf + (1*DIM + m)*GMX_SIMD_REAL_WIDTH, gmx_simd_mul_r(imH_S, xb[m]));
+            gmx_simd_store_r(x_buf + (2*DIM + m)*GMX_SIMD_REAL_WIDTH, gmx_simd_mul_r(imH_S, xc[m]));
+        }
+
+        if (bVir)
+        {
+            /* Determining r \dot m der is easy,
+             * since fc contains the mass weighted corrections for der.
+             * Only waters with ow1 < calcvir_atom_end contribute.
+             */
+            w_oh2 = gmx_simd_mul_r(gmx_simd_load_r(virfac), fcv[0]);
+            w_oh3 = gmx_simd_mul_r(gmx_simd_load_r(virfac), fcv[1]);
+            w_hh  = gmx_simd_mul_r(gmx_simd_load_r(virfac), fcv[2]);
+            w_oh2 = gmx_simd_mul_r(gmx_simd_set1_r(p->dOH), w_oh2);
+            w_oh3 = gmx_simd_mul_r(gmx_simd_set1_r(p->dOH), w_oh3);
+            w_hh  = gmx_simd_mul_r(gmx_simd_set1_r(p->dHH), w_hh);
+            for (d = 0; d < DIM; d++)
+            {
+                for (d2 = 0; d2 < DIM; d2++)
+                {
+                    vir_S[d][d2] = gmx_simd_fmadd_r(gmx_simd_mul_r(roh2[d], roh2[d2]), w_oh2, vir_S[d][d2]);
+                    vir_S[d][d2] = gmx_simd_fmadd_r(gmx_simd_mul_r(roh3[d], roh3[d2]), w_oh3, vir_S[d][d2]);
+                    vir_S[d][d2] = gmx_simd_fmadd_r(gmx_simd_mul_r(rhh[d], rhh[d2]), w_hh, vir_S[d][d2]);
+                }
+            }
+        }
+
+        /* Subtract the corrections from derp */
+        for (s = 0; s < GMX_SIMD_REAL_WIDTH; s++)
+        {
+            for (m = 0; m < DIM; m++)
+            {
+                derp[ow1[s]][m] -= x_buf[(0*DIM + m)*GMX_SIMD_REAL_WIDTH + s];
+                derp[hw2[s]][m] -= x_buf[(1*DIM + m)*GMX_SIMD_REAL_WIDTH + s];
+                derp[hw3[s]][m] -= x_buf[(2*DIM + m)*GMX_SIMD_REAL_WIDTH + s];
+            }
+        }
+    }
+
+    if (bVir)
+    {
+        for (d = 0; d < DIM; d++)
+        {
+            for (d2 = 0; d2 < DIM; d2++)
+            {
+                vir_r_m_dder[d][d2] += gmx_simd_reduce_r(vir_S[d][d2]);
+            }
+        }
+    }
+
+    return nsimd;
+}
+
+#endif /* GMX_SIMD_HAVE_REAL */
 
 void settle_proj(gmx_settledata_t settled, int econq,
                  int nsettle, t_iatom iatoms[],
@@ -183,7 +704,7 @@ void settle_proj(gmx_settledata_t settled, int econq,
     settleparam_t *p;
     real           imO, imH, dOH, dHH, invdOH, invdHH;
     matrix         invmat;
-    int            i, m, m2, ow1, hw2, hw3;
+    int            i0, i, m, m2, ow1, hw2, hw3;
     rvec           roh2, roh3, rhh, dc, fc, fcv;
     rvec           derm[3];
     real           vscale_nhc, veta;
@@ -209,11 +730,21 @@ void settle_proj(gmx_settledata_t settled, int econq,
     veta       = vetavar->veta;
     vscale_nhc = vetavar->vscale_nhc[0]; /* assume the first temperature control group. */
 
+    i0 = 0;
+#ifdef GMX_SIMD_HAVE_REAL
+    if (settled->bUseSimd && settle_simd_supported(pbc))
+    {
+        i0 = settle_proj_simd(p, nsettle, iatoms, pbc, x, der, derp,
+                              calcvir_atom_end, vir_r_m_dder,
+                              veta, vscale_nhc);
+    }
+#endif
+
 #ifdef PRAGMAS
 #pragma ivdep
 #endif
 
-    for (i = 0; i < nsettle; i++)
+    for (i = i0; i < nsettle; i++)
     {
         ow1 = iatoms[i*4+1];
         hw2 = iatoms[i*4+2];
@@ -349,7 +880,7 @@ void csettle(gmx_settledata_t settled,
 
     gmx_bool bOK;
 
-    int      i, ow1, hw2, hw3;
+    int      i0, i, ow1, hw2, hw3;
 
     rvec     dx, sh_hw2 = {0, 0, 0}, sh_hw3 = {0, 0, 0};
     rvec     doh2, doh3;
@@ -370,10 +901,20 @@ void csettle(gmx_settledata_t settled,
     mHs    = p->mH / vetavar->rvscale;
     invdts = invdt / vetavar->rscale;
 
+    i0 = 0;
+#ifdef GMX_SIMD_HAVE_REAL
+    if (settled->bUseSimd && settle_simd_supported(pbc))
+    {
+        i0 = csettle_simd(p, nsettle, iatoms, pbc, b4, after,
+                          invdts, v, CalcVirAtomEnd, mOs, mHs,
+                          vir_r_m_dr, error);
+    }
+#endif
+
 #ifdef PRAGMAS
 #pragma ivdep
 #endif
-    for (i = 0; i < nsettle; ++i)
+    for (i = i0; i < nsettle; ++i)
     {
         bOK = TRUE;
         /*    --- Step1  A1' ---      */
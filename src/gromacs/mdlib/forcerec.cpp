@@ -1611,8 +1611,14 @@ static void pick_nbnxn_kernel_cpu(const t_inputrec gmx_unused *ir,
          * 10% with HT, 50% without HT. As we currently don't detect the actual
          * use of HT, use 4x8 to avoid a potential performance hit.
          * On Intel Haswell 4x8 is always faster.
+         * With 16-wide SIMD 4x16 calculates twice as many pairs as 2x(8+8),
+         * so there we keep 2x(8+8) as the default.
          */
+#if GMX_SIMD_REAL_WIDTH == 16
+        *kernel_type = nbnxnk4xN_SIMD_2xNN;
+#else
         *kernel_type = nbnxnk4xN_SIMD_4xN;
+#endif
 
 #ifndef GMX_SIMD_HAVE_FMA
         if (EEL_PME_EWALD(ir->coulombtype) ||
@@ -1695,6 +1701,8 @@ const char *lookup_nbnxn_kernel_name(int kernel_type)
             returnvalue = "AVX_256";
 #elif defined GMX_SIMD_X86_AVX2_256
             returnvalue = "AVX2_256";
+#elif defined GMX_SIMD_X86_AVX_512F
+            returnvalue = "AVX_512F";
 #else
             returnvalue = "SIMD";
 #endif
@@ -70,6 +70,11 @@ t_mdatoms *init_mdatoms(FILE *fp, gmx_mtop_t *mtop, gmx_bool bFreeEnergy)
             md->bVCMgrps = TRUE;
         }
 
+        if (atom->ptype == eptVSite || atom->ptype == eptShell)
+        {
+            md->bVsitesOrShells = TRUE;
+        }
+
         if (bFreeEnergy && PERTURBED(*atom))
         {
             md->nPerturbed++;
@@ -149,6 +154,7 @@ void atoms2md(gmx_mtop_t *mtop, t_inputrec *ir,
         }
         srenew(md->massT, md->nalloc);
         srenew(md->invmass, md->nalloc);
+        srenew(md->invMassPerDim, md->nalloc);
         srenew(md->chargeA, md->nalloc);
         if (bLJPME)
         {
@@ -233,7 +239,7 @@ void atoms2md(gmx_mtop_t *mtop, t_inputrec *ir,
 #pragma omp parallel for num_threads(nthreads) schedule(static)
     for (i = 0; i < md->nr; i++)
     {
-        int      g, ag;
+        int      g, ag, d;
         real     mA, mB, fac;
         real     c6, c12;
         t_atom  *atom;
@@ -318,6 +324,10 @@ void atoms2md(gmx_mtop_t *mtop, t_inputrec *ir,
         {
             md->invmass[i]    = 1.0/mA;
         }
+        for (d = 0; d < DIM; d++)
+        {
+            md->invMassPerDim[i][d] = md->invmass[i];
+        }
         md->chargeA[i]      = atom->q;
         md->typeA[i]        = atom->type;
         if (bLJPME)
@@ -427,7 +437,7 @@ void atoms2md(gmx_mtop_t *mtop, t_inputrec *ir,
 
 void update_mdatoms(t_mdatoms *md, real lambda)
 {
-    int    al, end;
+    int    al, end, d;
     real   L1 = 1.0-lambda;
 
     end = md->nr;
@@ -442,6 +452,10 @@ void update_mdatoms(t_mdatoms *md, real lambda)
                 if (md->invmass[al] > 1.1*ALMOST_ZERO)
                 {
                     md->invmass[al] = 1.0/md->massT[al];
+                    for (d = 0; d < DIM; d++)
+                    {
+                        md->invMassPerDim[al][d] = md->invmass[al];
+                    }
                 }
             }
         }
@@ -523,9 +523,11 @@ static void write_em_traj(FILE *fplog, t_commrec *cr,
         mdof_flags |= MDOF_IMD;
     }
 
+    wallcycle_start(mdoutf_get_wcycle(outf), ewcTRAJ);
     mdoutf_write_to_trajectory_files(fplog, cr, outf, mdof_flags,
                                      top_global, step, (double)step,
                                      &state->s, state_global, state->f, f_global);
+    wallcycle_stop(mdoutf_get_wcycle(outf), ewcTRAJ);
 
     if (confout != NULL && MASTER(cr))
     {
@@ -1832,8 +1834,10 @@ double do_lbfgs(FILE *fplog, t_commrec *cr,
             mdof_flags |= MDOF_IMD;
         }
 
+        wallcycle_start(mdoutf_get_wcycle(outf), ewcTRAJ);
         mdoutf_write_to_trajectory_files(fplog, cr, outf, mdof_flags,
                                          top_global, step, (real)step, state, state, f, f);
+        wallcycle_stop(mdoutf_get_wcycle(outf), ewcTRAJ);
 
         /* Do the linesearching in the direction dx[point][0..(n-1)] */
 
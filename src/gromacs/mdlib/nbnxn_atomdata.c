@@ -244,6 +244,23 @@ static void clear_nbat_real(int na, int nbatFormat, real *xnb, int a0)
                 }
             }
             break;
+        case nbatX16:
+            j = X16_IND_A(a0);
+            c = a0 & (PACK_X16-1);
+            for (a = 0; a < na; a++)
+            {
+                xnb[j+XX*PACK_X16] = 0;
+                xnb[j+YY*PACK_X16] = 0;
+                xnb[j+ZZ*PACK_X16] = 0;
+                j++;
+                c++;
+                if (c == PACK_X16)
+                {
+                    j += (DIM-1)*PACK_X16;
+                    c  = 0;
+                }
+            }
+            break;
     }
 }
 
@@ -362,6 +379,37 @@ void copy_rvec_to_nbat_real(const int *a, int na, int na_round,
                 }
             }
             break;
+        case nbatX16:
+            j = X16_IND_A(a0);
+            c = a0 & (PACK_X16 - 1);
+            for (i = 0; i < na; i++)
+            {
+                xnb[j+XX*PACK_X16] = x[a[i]][XX];
+                xnb[j+YY*PACK_X16] = x[a[i]][YY];
+                xnb[j+ZZ*PACK_X16] = x[a[i]][ZZ];
+                j++;
+                c++;
+                if (c == PACK_X16)
+                {
+                    j += (DIM-1)*PACK_X16;
+                    c  = 0;
+                }
+            }
+            /* Complete the partially filled last cell with particles far apart */
+            for (; i < na_round; i++)
+            {
+                xnb[j+XX*PACK_X16] = -NBAT_FAR_AWAY*(1 + cx);
+                xnb[j+YY*PACK_X16] = -NBAT_FAR_AWAY*(1 + cy);
+                xnb[j+ZZ*PACK_X16] = -NBAT_FAR_AWAY*(1 + cz + i);
+                j++;
+                c++;
+                if (c == PACK_X16)
+                {
+                    j += (DIM-1)*PACK_X16;
+                    c  = 0;
+                }
+            }
+            break;
         default:
             gmx_incons("Unsupported nbnxn_atomdata_t format");
     }
@@ -489,7 +537,11 @@ nbnxn_atomdata_init_simple_exclusion_masks(nbnxn_atomdata_t *nbat)
     snew_aligned(nbat->simd_exclusion_filter1, simd_excl_size,   NBNXN_MEM_ALIGN);
     snew_aligned(nbat->simd_exclusion_filter2, simd_excl_size*2, NBNXN_MEM_ALIGN);
 
-    for (j = 0; j < simd_excl_size; j++)
+    /* With 16-wide SIMD the 4x16 kernels convert their 64-bit masks
+     * directly to SIMD booleans, so we only set the 32 bits the 2x(N+N)
+     * kernels use and leave the remaining filter entries zero.
+     */
+    for (j = 0; j < min(simd_excl_size, 32); j++)
     {
         /* Set the consecutive bits for masking pair exclusions */
         nbat->simd_exclusion_filter1[j]       = (1U << j);
@@ -726,6 +778,9 @@ void nbnxn_atomdata_init(FILE *fp,
                 case 8:
                     nbat->XFormat = nbatX8;
                     break;
+                case 16:
+                    nbat->XFormat = nbatX16;
+                    break;
                 default:
                     gmx_incons("Unsupported packing width");
             }
@@ -857,6 +912,26 @@ static void copy_lj_to_nbat_lj_comb_x8(const real *ljparam_type,
     }
 }
 
+static void copy_lj_to_nbat_lj_comb_x16(const real *ljparam_type,
+                                        const int *type, int na,
+                                        real *ljparam_at)
+{
+    int is, k, i;
+
+    /* The LJ params follow the combination rule:
+     * copy the params for the type array to the atom array.
+     */
+    for (is = 0; is < na; is += PACK_X16)
+    {
+        for (k = 0; k < PACK_X16; k++)
+        {
+            i = is + k;
+            ljparam_at[is*2         +k] = ljparam_type[type[i]*2  ];
+            ljparam_at[is*2+PACK_X16+k] = ljparam_type[type[i]*2+1];
+        }
+    }
+}
+
 /* Sets the atom type in nbnxn_atomdata_t */
 static void nbnxn_atomdata_set_atomtypes(nbnxn_atomdata_t    *nbat,
                                          int                  ngrid,
@@ -914,6 +989,12 @@ static void nbnxn_atomdata_set_ljcombparams(nbnxn_atomdata_t    *nbat,
                                                nbat->type+ash, ncz*grid->na_sc,
                                                nbat->lj_comb+ash*2);
                 }
+                else if (nbat->XFormat == nbatX16)
+                {
+                    copy_lj_to_nbat_lj_comb_x16(nbat->nbfp_comb,
+                                                nbat->type+ash, ncz*grid->na_sc,
+                                                nbat->lj_comb+ash*2);
+                }
             }
         }
     }
@@ -1414,6 +1495,35 @@ nbnxn_atomdata_add_nbat_f_to_f_part(const nbnxn_search_t nbs,
                 }
             }
             break;
+        case nbatX16:
+            if (nfa == 1)
+            {
+                fnb = out[0].f;
+
+                for (a = a0; a < a1; a++)
+                {
+                    i = X16_IND_A(cell[a]);
+
+                    f[a][XX] += fnb[i+XX*PACK_X16];
+                    f[a][YY] += fnb[i+YY*PACK_X16];
+                    f[a][ZZ] += fnb[i+ZZ*PACK_X16];
+                }
+            }
+            else
+            {
+                for (a = a0; a < a1; a++)
+                {
+                    i = X16_IND_A(cell[a]);
+
+                    for (fa = 0; fa < nfa; fa++)
+                    {
+                        f[a][XX] += out[fa].f[i+XX*PACK_X16];
+                        f[a][YY] += out[fa].f[i+YY*PACK_X16];
+                        f[a][ZZ] += out[fa].f[i+ZZ*PACK_X16];
+                    }
+                }
+            }
+            break;
         default:
             gmx_incons("Unsupported nbnxn_atomdata_t format");
     }
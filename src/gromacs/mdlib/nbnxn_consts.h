@@ -53,7 +53,7 @@ extern "C" {
 #define NBNXN_GPU_NCLUSTER_PER_SUPERCLUSTER  GPU_NSUBCELL
 
 /* With CPU kernels the i-cluster size is always 4 atoms.
- * With x86 SIMD the j-cluster size can be 2, 4 or 8, otherwise 4.
+ * With x86 SIMD the j-cluster size can be 2, 4, 8 or 16, otherwise 4.
  */
 #define NBNXN_CPU_CLUSTER_I_SIZE       4
 
@@ -89,13 +89,16 @@ extern "C" {
 /* Size of packs of x, y or z with SSE/AVX packed coords/forces */
 #define PACK_X4      4
 #define PACK_X8      8
-/* Strides for a pack of 4 and 8 coordinates/forces */
+#define PACK_X16     16
+/* Strides for a pack of 4, 8 and 16 coordinates/forces */
 #define STRIDE_P4    (DIM*PACK_X4)
 #define STRIDE_P8    (DIM*PACK_X8)
+#define STRIDE_P16   (DIM*PACK_X16)
 
 /* Index of atom a into the SSE/AVX coordinate/force array */
 #define X4_IND_A(a)  (STRIDE_P4*((a) >> 2) + ((a) & (PACK_X4 - 1)))
 #define X8_IND_A(a)  (STRIDE_P8*((a) >> 3) + ((a) & (PACK_X8 - 1)))
+#define X16_IND_A(a) (STRIDE_P16*((a) >> 4) + ((a) & (PACK_X16 - 1)))
 
 #ifdef __IN_OPENCL_KERNEL__
 #define CONSTANT_ADDRESS_SPACE __constant
@@ -144,7 +144,7 @@ VerletKernelTypeDict = {
     '4xn' : {
         'Define' : 'GMX_NBNXN_SIMD_4XN',
         'WidthSetup' : (''),
-        'WidthCheck' : ('#if !(GMX_SIMD_REAL_WIDTH == 2 || GMX_SIMD_REAL_WIDTH == 4 || GMX_SIMD_REAL_WIDTH == 8)\n' \
+        'WidthCheck' : ('#if !(GMX_SIMD_REAL_WIDTH == 2 || GMX_SIMD_REAL_WIDTH == 4 || GMX_SIMD_REAL_WIDTH == 8 || GMX_SIMD_REAL_WIDTH == 16)\n' \
                         '#error "unsupported SIMD width"\n' \
                         '#endif\n'),
         'UnrollSize' : 1,
@@ -69,7 +69,7 @@ prepare_table_load_buffer(const int gmx_unused *array)
 
 #else /* GMX_SIMD_REFERENCE */
 
-#if defined  GMX_TARGET_X86 && !defined GMX_SIMD_X86_MIC
+#if defined  GMX_TARGET_X86 && !(defined GMX_SIMD_X86_MIC || defined GMX_SIMD_X86_AVX_512F)
 /* Include x86 SSE2 compatible SIMD functions */
 
 /* Set the stride for the lookup of the two LJ parameters from their
@@ -110,7 +110,7 @@ prepare_table_load_buffer(int gmx_unused *array)
 #endif
 #endif /* GMX_DOUBLE */
 
-#else  /* GMX_TARGET_X86 && !GMX_SIMD_X86_MIC */
+#else  /* GMX_TARGET_X86 && !(GMX_SIMD_X86_MIC || GMX_SIMD_X86_AVX_512F) */
 
 #if GMX_SIMD_REAL_WIDTH > 4
 /* For width>4 we use unaligned loads. And thus we can use the minimal stride */
@@ -132,7 +132,15 @@ static const int nbfp_stride = GMX_SIMD_REAL_WIDTH;
 #include "gromacs/mdlib/nbnxn_kernels/nbnxn_kernel_simd_utils_x86_mic.h"
 #endif
 
-#endif /* GMX_TARGET_X86 && !GMX_SIMD_X86_MIC */
+#ifdef GMX_SIMD_X86_AVX_512F
+#ifdef GMX_DOUBLE
+#include "gromacs/mdlib/nbnxn_kernels/nbnxn_kernel_simd_utils_x86_512d.h"
+#else
+#include "gromacs/mdlib/nbnxn_kernels/nbnxn_kernel_simd_utils_x86_512s.h"
+#endif
+#endif
+
+#endif /* GMX_TARGET_X86 && !(GMX_SIMD_X86_MIC || GMX_SIMD_X86_AVX_512F) */
 
 #endif /* GMX_SIMD_REFERENCE */
 
@@ -0,0 +1,249 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2014,2015, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+#ifndef _nbnxn_kernel_simd_utils_x86_512d_h_
+#define _nbnxn_kernel_simd_utils_x86_512d_h_
+
+/* This files contains all functions/macros for the SIMD kernels
+ * which have explicit dependencies on the j-cluster size and/or SIMD-width.
+ * The functionality which depends on the j-cluster size is:
+ *   LJ-parameter lookup
+ *   force table lookup
+ *   energy group pair energy storage
+ *
+ * With 8-wide double precision AVX-512F SIMD both the 4xN kernels,
+ * with a 4x8 cluster setup, and the 2xNN kernels, with a 4x4 cluster
+ * setup, are supported. The two halves of a register are handled as
+ * 256-bit AVX registers.
+ */
+
+typedef gmx_simd_int32_t      gmx_exclfilter;
+static const int filter_stride = GMX_SIMD_INT32_WIDTH/GMX_SIMD_REAL_WIDTH;
+
+/* Half-width SIMD real type */
+typedef __m256d gmx_mm_hpr;
+
+/* Half-width SIMD operations */
+
+/* Load reals at half-width aligned pointer b into half-width SIMD register a */
+static gmx_inline void gmx_simdcall
+gmx_load_hpr(gmx_mm_hpr *a, const real *b)
+{
+    *a = _mm256_load_pd(b);
+}
+
+/* Set all entries in half-width SIMD register *a to b */
+static gmx_inline void gmx_simdcall
+gmx_set1_hpr(gmx_mm_hpr *a, real b)
+{
+    *a = _mm256_set1_pd(b);
+}
+
+/* Combine two half-width registers into a full-width register */
+static gmx_inline __m512d gmx_simdcall
+gmx_2_m256d_to_m512d(__m256d lo, __m256d hi)
+{
+    return _mm512_maskz_insertf64x4(0xFF, _mm512_castpd256_pd512(lo), hi, 0x1);
+}
+
+/* Extract the high half of a full-width register */
+static gmx_inline __m256d gmx_simdcall
+gmx_m512d_high_to_m256d(__m512d a)
+{
+    return _mm512_maskz_extractf64x4_pd(0xF, a, 0x1);
+}
+
+/* Load one real at b and one real at b+1 into halves of a, respectively */
+static gmx_inline void gmx_simdcall
+gmx_load1p1_pr(gmx_simd_double_t *a, const real *b)
+{
+    *a = _mm512_mask_broadcastsd_pd(_mm512_set1_pd(b[0]), (__mmask8)0xF0,
+                                    _mm_load_sd(b + 1));
+}
+
+/* Load reals at half-width aligned pointer b into two halves of a */
+static gmx_inline void gmx_simdcall
+gmx_loaddh_pr(gmx_simd_double_t *a, const real *b)
+{
+    *a = _mm512_maskz_broadcast_f64x4(0xFF, _mm256_load_pd(b));
+}
+
+/* Store half-width SIMD register b into half width aligned memory a */
+static gmx_inline void gmx_simdcall
+gmx_store_hpr(real *a, gmx_mm_hpr b)
+{
+    _mm256_store_pd(a, b);
+}
+
+#define gmx_add_hpr _mm256_add_pd
+#define gmx_sub_hpr _mm256_sub_pd
+
+/* Sum over 4 half SIMD registers */
+static gmx_inline gmx_mm_hpr gmx_simdcall
+gmx_sum4_hpr(gmx_simd_double_t a, gmx_simd_double_t b)
+{
+    a = _mm512_add_pd(a, b);
+    return _mm256_add_pd(gmx_mm512_castpd512_pd256(a), gmx_m512d_high_to_m256d(a));
+}
+
+/* Sum the elements within each input register and return the sums */
+static gmx_inline __m256d gmx_simdcall
+gmx_mm_transpose_sum4_pr(gmx_simd_double_t in0, gmx_simd_double_t in1,
+                         gmx_simd_double_t in2, gmx_simd_double_t in3)
+{
+    __m256d s0, s1, s2, s3;
+
+    s0 = _mm256_add_pd(gmx_mm512_castpd512_pd256(in0), gmx_m512d_high_to_m256d(in0));
+    s1 = _mm256_add_pd(gmx_mm512_castpd512_pd256(in1), gmx_m512d_high_to_m256d(in1));
+    s2 = _mm256_add_pd(gmx_mm512_castpd512_pd256(in2), gmx_m512d_high_to_m256d(in2));
+    s3 = _mm256_add_pd(gmx_mm512_castpd512_pd256(in3), gmx_m512d_high_to_m256d(in3));
+
+    /* Same transpose-sum as for 256-bit AVX on s0, s1, s2, s3 */
+    s0 = _mm256_hadd_pd(s0, s1);
+    s2 = _mm256_hadd_pd(s2, s3);
+
+    return _mm256_add_pd(_mm256_permute2f128_pd(s0, s2, 0x20),
+                         _mm256_permute2f128_pd(s0, s2, 0x31));
+}
+
+/* Sum the elements of halfs of each input register and return the sums */
+static gmx_inline __m256d gmx_simdcall
+gmx_mm_transpose_sum4h_pr(gmx_simd_double_t a, gmx_simd_double_t b)
+{
+    __m256d s0, s1;
+
+    /* s0 = a.lo[0,1], a.hi[0,1], a.lo[2,3], a.hi[2,3] pair sums */
+    s0 = _mm256_hadd_pd(gmx_mm512_castpd512_pd256(a), gmx_m512d_high_to_m256d(a));
+    s1 = _mm256_hadd_pd(gmx_mm512_castpd512_pd256(b), gmx_m512d_high_to_m256d(b));
+
+    return _mm256_add_pd(_mm256_permute2f128_pd(s0, s1, 0x20),
+                         _mm256_permute2f128_pd(s0, s1, 0x31));
+}
+
+static gmx_inline void gmx_simdcall
+gmx_pr_to_2hpr(gmx_simd_double_t a, gmx_mm_hpr *b, gmx_mm_hpr *c)
+{
+    *b = gmx_mm512_castpd512_pd256(a);
+    *c = gmx_m512d_high_to_m256d(a);
+}
+
+static gmx_inline void gmx_simdcall
+gmx_2hpr_to_pr(gmx_mm_hpr a, gmx_mm_hpr b, gmx_simd_double_t *c)
+{
+    *c = gmx_2_m256d_to_m512d(a, b);
+}
+
+/* Gather 8 doubles at base+idx. The unmasked gather intrinsic merges into
+ * an undefined register, so we pass an explicit zero source and full mask.
+ */
+#define gmx_gather_pr(idx, base) _mm512_mask_i32gather_pd(_mm512_setzero_pd(), 0xFF, idx, base, sizeof(double))
+
+/* Align a stack-based thread-local working array. The gather
+ * instructions make the work-array unnecessary for table loads.
+ */
+static gmx_inline int *
+prepare_table_load_buffer(const int gmx_unused *array)
+{
+    return NULL;
+}
+
+/* With hardware gather we use the plain F and V tables */
+static gmx_inline void gmx_simdcall
+load_table_f(const real *tab_coul_F, gmx_simd_int32_t ti_S, int gmx_unused *ti,
+             gmx_simd_double_t *ctab0_S, gmx_simd_double_t *ctab1_S)
+{
+    *ctab0_S = gmx_gather_pr(ti_S, tab_coul_F);
+    *ctab1_S = gmx_gather_pr(ti_S, tab_coul_F + 1);
+    *ctab1_S = gmx_simd_sub_r(*ctab1_S, *ctab0_S);
+}
+
+static gmx_inline void gmx_simdcall
+load_table_f_v(const real *tab_coul_F, const real *tab_coul_V,
+               gmx_simd_int32_t ti_S, int *ti,
+               gmx_simd_double_t *ctab0_S, gmx_simd_double_t *ctab1_S,
+               gmx_simd_double_t *ctabv_S)
+{
+    load_table_f(tab_coul_F, ti_S, ti, ctab0_S, ctab1_S);
+    *ctabv_S = gmx_gather_pr(ti_S, tab_coul_V);
+}
+
+#if UNROLLJ == 8
+/* Load the LJ parameters of the 8 j-atoms for i-atom parameter array nbfp */
+static gmx_inline void gmx_simdcall
+load_lj_pair_params(const real *nbfp, const int *type, int aj,
+                    gmx_simd_double_t *c6_S, gmx_simd_double_t *c12_S)
+{
+    __m256i idx;
+
+    idx    = _mm256_mullo_epi32(_mm256_loadu_si256((const __m256i *)(type + aj)),
+                                _mm256_set1_epi32(nbfp_stride));
+    *c6_S  = gmx_gather_pr(idx, nbfp);
+    *c12_S = gmx_gather_pr(idx, nbfp + 1);
+}
+#endif
+
+#if UNROLLJ == 4
+/* Load the LJ parameters of the 4 j-atoms for i-atom parameter arrays
+ * nbfp0 and nbfp1, into the low and high halves of c6_S and c12_S.
+ */
+static gmx_inline void gmx_simdcall
+load_lj_pair_params2(const real *nbfp0, const real *nbfp1,
+                     const int *type, int aj,
+                     gmx_simd_double_t *c6_S, gmx_simd_double_t *c12_S)
+{
+    __m128i idx;
+
+    idx    = _mm_mullo_epi32(_mm_loadu_si128((const __m128i *)(type + aj)),
+                             _mm_set1_epi32(nbfp_stride));
+    *c6_S  = gmx_2_m256d_to_m512d(_mm256_i32gather_pd(nbfp0, idx, sizeof(double)),
+                                  _mm256_i32gather_pd(nbfp1, idx, sizeof(double)));
+    *c12_S = gmx_2_m256d_to_m512d(_mm256_i32gather_pd(nbfp0 + 1, idx, sizeof(double)),
+                                  _mm256_i32gather_pd(nbfp1 + 1, idx, sizeof(double)));
+}
+#endif
+
+/* Code for handling loading exclusions and converting them into
+   interactions. The integer type for double is 256 bits wide. */
+#define gmx_load1_exclfilter      _mm256_set1_epi32
+#define gmx_load_exclusion_filter gmx_simd_load_i
+
+static gmx_inline __mmask8 gmx_simdcall
+gmx_checkbitmask_pb(gmx_exclfilter m0, gmx_exclfilter m1)
+{
+    return (__mmask8)_mm512_mask_test_epi32_mask(0xFF,
+                                                 _mm512_castsi256_si512(m0),
+                                                 _mm512_castsi256_si512(m1));
+}
+
+#endif /* _nbnxn_kernel_simd_utils_x86_512d_h_ */
@@ -0,0 +1,257 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2014,2015, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+#ifndef _nbnxn_kernel_simd_utils_x86_512s_h_
+#define _nbnxn_kernel_simd_utils_x86_512s_h_
+
+/* This files contains all functions/macros for the SIMD kernels
+ * which have explicit dependencies on the j-cluster size and/or SIMD-width.
+ * The functionality which depends on the j-cluster size is:
+ *   LJ-parameter lookup
+ *   force table lookup
+ *   energy group pair energy storage
+ *
+ * With 16-wide AVX-512F SIMD the 4xN kernels use a 4x16 cluster setup
+ * and the 2xNN kernels a 4x8 cluster setup. For the latter the two halves
+ * of a register are handled as 256-bit AVX registers.
+ */
+
+typedef gmx_simd_int32_t      gmx_exclfilter;
+static const int filter_stride = GMX_SIMD_INT32_WIDTH/GMX_SIMD_REAL_WIDTH;
+
+/* Half-width SIMD real type */
+typedef __m256 gmx_mm_hpr;
+
+/* Half-width SIMD operations */
+
+/* Load reals at half-width aligned pointer b into half-width SIMD register a */
+static gmx_inline void gmx_simdcall
+gmx_load_hpr(gmx_mm_hpr *a, const real *b)
+{
+    *a = _mm256_load_ps(b);
+}
+
+/* Set all entries in half-width SIMD register *a to b */
+static gmx_inline void gmx_simdcall
+gmx_set1_hpr(gmx_mm_hpr *a, real b)
+{
+    *a = _mm256_set1_ps(b);
+}
+
+/* Combine two half-width registers into a full-width register */
+static gmx_inline __m512 gmx_simdcall
+gmx_2_m256_to_m512(__m256 lo, __m256 hi)
+{
+    return _mm512_castpd_ps(_mm512_maskz_insertf64x4(0xFF, _mm512_castpd256_pd512(_mm256_castps_pd(lo)),
+                                                     _mm256_castps_pd(hi), 0x1));
+}
+
+/* Extract the high half of a full-width register */
+static gmx_inline __m256 gmx_simdcall
+gmx_m512_high_to_m256(__m512 a)
+{
+    return _mm256_castpd_ps(_mm512_maskz_extractf64x4_pd(0xF, _mm512_castps_pd(a), 0x1));
+}
+
+/* Load one real at b and one real at b+1 into halves of a, respectively */
+static gmx_inline void gmx_simdcall
+gmx_load1p1_pr(gmx_simd_float_t *a, const real *b)
+{
+    *a = _mm512_mask_broadcastss_ps(_mm512_set1_ps(b[0]), _mm512_int2mask(0xFF00),
+                                    _mm_load_ss(b + 1));
+}
+
+/* Load reals at half-width aligned pointer b into two halves of a */
+static gmx_inline void gmx_simdcall
+gmx_loaddh_pr(gmx_simd_float_t *a, const real *b)
+{
+    *a = _mm512_castpd_ps(_mm512_maskz_broadcast_f64x4(0xFF, _mm256_castps_pd(_mm256_load_ps(b))));
+}
+
+/* Store half-width SIMD register b into half width aligned memory a */
+static gmx_inline void gmx_simdcall
+gmx_store_hpr(real *a, gmx_mm_hpr b)
+{
+    _mm256_store_ps(a, b);
+}
+
+#define gmx_add_hpr _mm256_add_ps
+#define gmx_sub_hpr _mm256_sub_ps
+
+/* Sum over 4 half SIMD registers */
+static gmx_inline gmx_mm_hpr gmx_simdcall
+gmx_sum4_hpr(gmx_simd_float_t a, gmx_simd_float_t b)
+{
+    a = _mm512_add_ps(a, b);
+    return _mm256_add_ps(gmx_mm512_castps512_ps256(a), gmx_m512_high_to_m256(a));
+}
+
+/* Sum the elements of halfs of each input register and store sums in out */
+static gmx_inline __m128 gmx_simdcall
+gmx_mm_transpose_sum4h_pr(gmx_simd_float_t a, gmx_simd_float_t b)
+{
+    __m256 s0, s1;
+    __m128 lo, hi;
+
+    /* Same transpose-sum as for 256-bit AVX on a.lo, a.hi, b.lo, b.hi */
+    s0 = _mm256_hadd_ps(gmx_mm512_castps512_ps256(a), gmx_m512_high_to_m256(a));
+    s1 = _mm256_hadd_ps(gmx_mm512_castps512_ps256(b), gmx_m512_high_to_m256(b));
+    s0 = _mm256_hadd_ps(s0, s1);
+    lo = _mm256_castps256_ps128(s0);
+    hi = _mm256_extractf128_ps(s0, 0x1);
+    return _mm_add_ps(lo, hi);
+}
+
+static gmx_inline void gmx_simdcall
+gmx_pr_to_2hpr(gmx_simd_float_t a, gmx_mm_hpr *b, gmx_mm_hpr *c)
+{
+    *b = gmx_mm512_castps512_ps256(a);
+    *c = gmx_m512_high_to_m256(a);
+}
+
+static gmx_inline void gmx_simdcall
+gmx_2hpr_to_pr(gmx_mm_hpr a, gmx_mm_hpr b, gmx_simd_float_t *c)
+{
+    *c = gmx_2_m256_to_m512(a, b);
+}
+
+/* Gather 16 floats at base+idx. The unmasked gather intrinsic merges into
+ * an undefined register, so we pass an explicit zero source and full mask.
+ */
+#define gmx_gather_pr(idx, base) _mm512_mask_i32gather_ps(_mm512_setzero_ps(), 0xFFFF, idx, base, sizeof(float))
+
+/* Align a stack-based thread-local working array. The gather
+ * instructions make the work-array unnecessary for table loads.
+ */
+static gmx_inline int *
+prepare_table_load_buffer(const int gmx_unused *array)
+{
+    return NULL;
+}
+
+/* With hardware gather, loading F and F+1 separately for all 16 elements
+ * is as fast as any FDV0 layout, so we use the plain F and V tables.
+ */
+static gmx_inline void gmx_simdcall
+load_table_f(const real *tab_coul_F, gmx_simd_int32_t ti_S, int gmx_unused *ti,
+             gmx_simd_float_t *ctab0_S, gmx_simd_float_t *ctab1_S)
+{
+    *ctab0_S = gmx_gather_pr(ti_S, tab_coul_F);
+    *ctab1_S = gmx_gather_pr(ti_S, tab_coul_F + 1);
+    *ctab1_S = gmx_simd_sub_r(*ctab1_S, *ctab0_S);
+}
+
+static gmx_inline void gmx_simdcall
+load_table_f_v(const real *tab_coul_F, const real *tab_coul_V,
+               gmx_simd_int32_t ti_S, int *ti,
+               gmx_simd_float_t *ctab0_S, gmx_simd_float_t *ctab1_S,
+               gmx_simd_float_t *ctabv_S)
+{
+    load_table_f(tab_coul_F, ti_S, ti, ctab0_S, ctab1_S);
+    *ctabv_S = gmx_gather_pr(ti_S, tab_coul_V);
+}
+
+#if UNROLLJ == 16
+/* Sum the elements within each input register and store the sums in out */
+static gmx_inline __m128 gmx_simdcall
+gmx_mm_transpose_sum4_pr(gmx_simd_float_t in0, gmx_simd_float_t in1,
+                         gmx_simd_float_t in2, gmx_simd_float_t in3)
+{
+    __m256 s0, s1, s2, s3;
+    __m128 lo, hi;
+
+    s0 = _mm256_add_ps(gmx_mm512_castps512_ps256(in0), gmx_m512_high_to_m256(in0));
+    s1 = _mm256_add_ps(gmx_mm512_castps512_ps256(in1), gmx_m512_high_to_m256(in1));
+    s2 = _mm256_add_ps(gmx_mm512_castps512_ps256(in2), gmx_m512_high_to_m256(in2));
+    s3 = _mm256_add_ps(gmx_mm512_castps512_ps256(in3), gmx_m512_high_to_m256(in3));
+
+    /* Same transpose-sum as for 256-bit AVX */
+    s0 = _mm256_hadd_ps(s0, s1);
+    s2 = _mm256_hadd_ps(s2, s3);
+    s0 = _mm256_hadd_ps(s0, s2);
+    lo = _mm256_castps256_ps128(s0);
+    hi = _mm256_extractf128_ps(s0, 0x1);
+    return _mm_add_ps(lo, hi);
+}
+
+/* Load the LJ parameters of the 16 j-atoms for i-atom parameter array nbfp */
+static gmx_inline void gmx_simdcall
+load_lj_pair_params(const real *nbfp, const int *type, int aj,
+                    gmx_simd_float_t *c6_S, gmx_simd_float_t *c12_S)
+{
+    __m512i idx;
+
+    idx    = _mm512_mullo_epi32(_mm512_loadu_si512(type + aj),
+                                _mm512_set1_epi32(nbfp_stride));
+    *c6_S  = gmx_gather_pr(idx, nbfp);
+    *c12_S = gmx_gather_pr(idx, nbfp + 1);
+}
+#endif
+
+#if UNROLLJ == 8
+/* Load the LJ parameters of the 8 j-atoms for i-atom parameter arrays
+ * nbfp0 and nbfp1, into the low and high halves of c6_S and c12_S.
+ */
+static gmx_inline void gmx_simdcall
+load_lj_pair_params2(const real *nbfp0, const real *nbfp1,
+                     const int *type, int aj,
+                     gmx_simd_float_t *c6_S, gmx_simd_float_t *c12_S)
+{
+    __m256i idx0, idx1;
+    __m512i idx;
+    __m512  tmp0, tmp1;
+
+    idx0 = _mm256_mullo_epi32(_mm256_loadu_si256((const __m256i *)(type + aj)),
+                              _mm256_set1_epi32(nbfp_stride));
+    idx1 = _mm256_add_epi32(idx0, _mm256_set1_epi32(1));
+    /* Indices for c6 in the low half, c12 in the high half */
+    idx  = _mm512_maskz_inserti64x4(0xFF, _mm512_castsi256_si512(idx0), idx1, 0x1);
+
+    tmp0 = gmx_gather_pr(idx, nbfp0);
+    tmp1 = gmx_gather_pr(idx, nbfp1);
+
+    *c6_S  = gmx_2_m256_to_m512(gmx_mm512_castps512_ps256(tmp0),
+                                gmx_mm512_castps512_ps256(tmp1));
+    *c12_S = gmx_2_m256_to_m512(gmx_m512_high_to_m256(tmp0),
+                                gmx_m512_high_to_m256(tmp1));
+}
+#endif
+
+/* Code for handling loading exclusions and converting them into
+   interactions. */
+#define gmx_load1_exclfilter      _mm512_set1_epi32
+#define gmx_load_exclusion_filter gmx_simd_load_i
+#define gmx_checkbitmask_pb       _mm512_test_epi32_mask
+
+#endif /* _nbnxn_kernel_simd_utils_x86_512s_h_ */
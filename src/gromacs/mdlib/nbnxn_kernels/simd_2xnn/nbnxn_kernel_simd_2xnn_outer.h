@@ -601,7 +601,7 @@
 #define CALC_COULOMB
 #define HALF_LJ
 #define CHECK_EXCLS
-            while (cjind < cjind1 && nbl->cj[cjind].excl != NBNXN_INTERACTION_MASK_ALL)
+            while (cjind < cjind1 && nbl->cj[cjind].excl != NBNXN_CJ_EXCL_MASK_ALL)
             {
 #include "gromacs/mdlib/nbnxn_kernels/simd_2xnn/nbnxn_kernel_simd_2xnn_inner.h"
                 cjind++;
@@ -619,7 +619,7 @@
             /* Coulomb: all i-atoms, LJ: all i-atoms */
 #define CALC_COULOMB
 #define CHECK_EXCLS
-            while (cjind < cjind1 && nbl->cj[cjind].excl != NBNXN_INTERACTION_MASK_ALL)
+            while (cjind < cjind1 && nbl->cj[cjind].excl != NBNXN_CJ_EXCL_MASK_ALL)
             {
 #include "gromacs/mdlib/nbnxn_kernels/simd_2xnn/nbnxn_kernel_simd_2xnn_inner.h"
                 cjind++;
@@ -635,7 +635,7 @@
         {
             /* Coulomb: none, LJ: all i-atoms */
 #define CHECK_EXCLS
-            while (cjind < cjind1 && nbl->cj[cjind].excl != NBNXN_INTERACTION_MASK_ALL)
+            while (cjind < cjind1 && nbl->cj[cjind].excl != NBNXN_CJ_EXCL_MASK_ALL)
             {
 #include "gromacs/mdlib/nbnxn_kernels/simd_2xnn/nbnxn_kernel_simd_2xnn_inner.h"
                 cjind++;
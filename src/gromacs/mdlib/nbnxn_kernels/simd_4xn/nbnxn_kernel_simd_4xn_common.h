@@ -60,7 +60,7 @@
 #include "gromacs/mdlib/nbnxn_kernels/nbnxn_kernel_simd_utils.h"
 
 static gmx_inline void gmx_simdcall
-gmx_load_simd_4xn_interactions(int                        excl,
+gmx_load_simd_4xn_interactions(nbnxn_excl_mask_t          excl,
                                gmx_exclfilter gmx_unused  filter_S0,
                                gmx_exclfilter gmx_unused  filter_S1,
                                gmx_exclfilter gmx_unused  filter_S2,
@@ -71,7 +71,13 @@ gmx_load_simd_4xn_interactions(int                        excl,
                                gmx_simd_bool_t           *interact_S2,
                                gmx_simd_bool_t           *interact_S3)
 {
-#if defined GMX_SIMD_X86_SSE2_OR_HIGHER || defined GMX_SIMD_REFERENCE
+#if defined GMX_SIMD_X86_AVX_512F && UNROLLJ == 16
+    /* With 4x16 each row of 16 interaction bits is a SIMD boolean */
+    *interact_S0  = _mm512_int2mask((int)((excl >> (0 * UNROLLJ)) & 0xFFFF));
+    *interact_S1  = _mm512_int2mask((int)((excl >> (1 * UNROLLJ)) & 0xFFFF));
+    *interact_S2  = _mm512_int2mask((int)((excl >> (2 * UNROLLJ)) & 0xFFFF));
+    *interact_S3  = _mm512_int2mask((int)((excl >> (3 * UNROLLJ)) & 0xFFFF));
+#elif defined GMX_SIMD_X86_SSE2_OR_HIGHER || defined GMX_SIMD_REFERENCE
     /* Load integer interaction mask */
     gmx_exclfilter mask_pr_S = gmx_load1_exclfilter(excl);
     *interact_S0  = gmx_checkbitmask_pb(mask_pr_S, filter_S0);
@@ -341,6 +341,15 @@
 #ifdef CHECK_EXCLS
 #ifdef EXCL_FORCES
     /* Only remove the (sub-)diagonal to avoid double counting */
+#if 4*UNROLLI == UNROLLJ
+    if (cj == (ci_sh>>2))
+    {
+        wco_S0  = gmx_simd_and_b(wco_S0, diagonal_mask_S0);
+        wco_S1  = gmx_simd_and_b(wco_S1, diagonal_mask_S1);
+        wco_S2  = gmx_simd_and_b(wco_S2, diagonal_mask_S2);
+        wco_S3  = gmx_simd_and_b(wco_S3, diagonal_mask_S3);
+    }
+#else
 #if UNROLLJ == UNROLLI
     if (cj == ci_sh)
     {
@@ -382,6 +391,7 @@
     }
 #endif
 #endif
+#endif
 #else /* EXCL_FORCES */
       /* No exclusion forces: remove all excluded atom pairs from the list */
     wco_S0      = gmx_simd_and_b(wco_S0, interact_S0);
@@ -81,7 +81,7 @@
 #endif
 
     gmx_simd_real_t  diagonal_jmi_S;
-#if UNROLLI == UNROLLJ
+#if UNROLLI == UNROLLJ || 4*UNROLLI == UNROLLJ
     gmx_simd_bool_t  diagonal_mask_S0, diagonal_mask_S1, diagonal_mask_S2, diagonal_mask_S3;
 #else
     gmx_simd_bool_t  diagonal_mask0_S0, diagonal_mask0_S1, diagonal_mask0_S2, diagonal_mask0_S3;
@@ -241,6 +241,9 @@
     diagonal_jmi_S    = gmx_simd_sub_r(diagonal_jmi_S, one_S);
     diagonal_mask1_S3 = gmx_simd_cmplt_r(zero_S, diagonal_jmi_S);
 #endif
+    /* With 4*UNROLLI == UNROLLJ the diagonal masks depend on the position
+     * of the i-cluster within the j-cluster and are set per i-cluster.
+     */
 #endif
 
     /* Load masks for topology exclusion masking. filter_stride is
@@ -426,10 +429,18 @@
         scix             = sci*DIM;
         sci2             = sci*2;
 #else
+#if UNROLLJ == 8
         sci              = (ci>>1)*STRIDE;
         scix             = sci*DIM + (ci & 1)*(STRIDE>>1);
         sci2             = sci*2 + (ci & 1)*(STRIDE>>1);
         sci             += (ci & 1)*(STRIDE>>1);
+#endif
+#if UNROLLJ == 16
+        sci              = (ci>>2)*STRIDE;
+        scix             = sci*DIM + (ci & 3)*(STRIDE>>2);
+        sci2             = sci*2 + (ci & 3)*(STRIDE>>2);
+        sci             += (ci & 3)*(STRIDE>>2);
+#endif
 #endif
 
         /* We have 5 LJ/C combinations, but use only three inner loops,
@@ -470,6 +481,9 @@
 #endif
 #if UNROLLJ == 8
         if (do_self && l_cj[nbln->cj_ind_start].cj == (ci_sh>>1))
+#endif
+#if UNROLLJ == 16
+        if (do_self && l_cj[nbln->cj_ind_start].cj == (ci_sh>>2))
 #endif
         {
             if (do_coul)
@@ -527,6 +541,19 @@
         }
 #endif
 
+#if 4*UNROLLI == UNROLLJ
+        /* Load j-i for the first i of this i-cluster within the j-cluster */
+        diagonal_jmi_S   = gmx_simd_sub_r(gmx_simd_load_r(nbat->simd_4xn_diagonal_j_minus_i),
+                                          gmx_simd_set1_r((real)((ci & 3)*UNROLLI)));
+        diagonal_mask_S0 = gmx_simd_cmplt_r(zero_S, diagonal_jmi_S);
+        diagonal_jmi_S   = gmx_simd_sub_r(diagonal_jmi_S, one_S);
+        diagonal_mask_S1 = gmx_simd_cmplt_r(zero_S, diagonal_jmi_S);
+        diagonal_jmi_S   = gmx_simd_sub_r(diagonal_jmi_S, one_S);
+        diagonal_mask_S2 = gmx_simd_cmplt_r(zero_S, diagonal_jmi_S);
+        diagonal_jmi_S   = gmx_simd_sub_r(diagonal_jmi_S, one_S);
+        diagonal_mask_S3 = gmx_simd_cmplt_r(zero_S, diagonal_jmi_S);
+#endif
+
         /* Load i atom data */
         sciy             = scix + STRIDE;
         sciz             = sciy + STRIDE;
@@ -625,7 +652,7 @@
 #define CALC_COULOMB
 #define HALF_LJ
 #define CHECK_EXCLS
-            while (cjind < cjind1 && nbl->cj[cjind].excl != NBNXN_INTERACTION_MASK_ALL)
+            while (cjind < cjind1 && nbl->cj[cjind].excl != NBNXN_CJ_EXCL_MASK_ALL)
             {
 #include "gromacs/mdlib/nbnxn_kernels/simd_4xn/nbnxn_kernel_simd_4xn_inner.h"
                 cjind++;
@@ -643,7 +670,7 @@
             /* Coulomb: all i-atoms, LJ: all i-atoms */
 #define CALC_COULOMB
 #define CHECK_EXCLS
-            while (cjind < cjind1 && nbl->cj[cjind].excl != NBNXN_INTERACTION_MASK_ALL)
+            while (cjind < cjind1 && nbl->cj[cjind].excl != NBNXN_CJ_EXCL_MASK_ALL)
             {
 #include "gromacs/mdlib/nbnxn_kernels/simd_4xn/nbnxn_kernel_simd_4xn_inner.h"
                 cjind++;
@@ -659,7 +686,7 @@
         {
             /* Coulomb: none, LJ: all i-atoms */
 #define CHECK_EXCLS
-            while (cjind < cjind1 && nbl->cj[cjind].excl != NBNXN_INTERACTION_MASK_ALL)
+            while (cjind < cjind1 && nbl->cj[cjind].excl != NBNXN_CJ_EXCL_MASK_ALL)
             {
 #include "gromacs/mdlib/nbnxn_kernels/simd_4xn/nbnxn_kernel_simd_4xn_inner.h"
                 cjind++;
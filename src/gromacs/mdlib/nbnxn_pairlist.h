@@ -79,16 +79,28 @@ typedef void nbnxn_alloc_t (void **ptr, size_t nbytes);
  */
 typedef void nbnxn_free_t (void *ptr);
 
+/* The type for the cluster-pair interaction bits of nbnxn_cj_t.
+ * 4x16 cluster pairs, used with AVX-512F in single precision,
+ * need 64 bits, all other CPU setups fit in 32 bits.
+ */
+#if defined GMX_SIMD_X86_AVX_512F && !defined GMX_DOUBLE && !defined __IN_OPENCL_KERNEL__
+typedef gmx_uint64_t nbnxn_excl_mask_t;
+#else
+typedef unsigned int nbnxn_excl_mask_t;
+#endif
+/* Mask with all interaction bits set */
+#define NBNXN_CJ_EXCL_MASK_ALL  (~((nbnxn_excl_mask_t)0))
+
 /* This is the actual cluster-pair list j-entry.
  * cj is the j-cluster.
  * The interaction bits in excl are indexed i-major, j-minor.
  * The cj entries are sorted such that ones with exclusions come first.
- * This means that once a full mask (=NBNXN_INTERACTION_MASK_ALL)
+ * This means that once a full mask (=NBNXN_CJ_EXCL_MASK_ALL)
  * is found, all subsequent j-entries in the i-entry also have full masks.
  */
 typedef struct {
-    int          cj;    /* The j-cluster                    */
-    unsigned int excl;  /* The exclusion (interaction) bits */
+    int               cj;    /* The j-cluster                    */
+    nbnxn_excl_mask_t excl;  /* The exclusion (interaction) bits */
 } nbnxn_cj_t;
 
 /* In nbnxn_ci_t the integer shift contains the shift in the lower 7 bits.
@@ -186,7 +198,7 @@ typedef struct {
 } nbnxn_pairlist_set_t;
 
 enum {
-    nbatXYZ, nbatXYZQ, nbatX4, nbatX8
+    nbatXYZ, nbatXYZQ, nbatX4, nbatX8, nbatX16
 };
 
 typedef struct {
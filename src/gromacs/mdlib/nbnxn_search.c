@@ -107,6 +107,13 @@
 #define X_IND_CI_J8(ci)  (((ci)>>1)*STRIDE_P8 + ((ci) & 1)*(PACK_X8>>1))
 #define X_IND_CJ_J8(cj)  ((cj)*STRIDE_P8)
 
+/* 4x16 list, pack=16: i-cluster size is a quarter of the packing width */
+/* i-cluster to j-cluster conversion */
+#define CI_TO_CJ_J16(ci)  ((ci)>>2)
+/* cluster index to coordinate array index conversion */
+#define X_IND_CI_J16(ci)  (((ci)>>2)*STRIDE_P16 + ((ci) & 3)*(PACK_X16>>2))
+#define X_IND_CJ_J16(cj)  ((cj)*STRIDE_P16)
+
 /* The j-cluster size is matched to the SIMD width */
 #if GMX_SIMD_REAL_WIDTH == 2
 #define CI_TO_CJ_SIMD_4XN(ci)  CI_TO_CJ_J2(ci)
@@ -128,6 +135,10 @@
 #define X_IND_CJ_SIMD_2XNN(cj) X_IND_CJ_J4(cj)
 #else
 #if GMX_SIMD_REAL_WIDTH == 16
+#define CI_TO_CJ_SIMD_4XN(ci)  CI_TO_CJ_J16(ci)
+#define X_IND_CI_SIMD_4XN(ci)  X_IND_CI_J16(ci)
+#define X_IND_CJ_SIMD_4XN(cj)  X_IND_CJ_J16(cj)
+/* Half SIMD with j-cluster size */
 #define CI_TO_CJ_SIMD_2XNN(ci) CI_TO_CJ_J8(ci)
 #define X_IND_CI_SIMD_2XNN(ci) X_IND_CI_J8(ci)
 #define X_IND_CJ_SIMD_2XNN(cj) X_IND_CJ_J8(cj)
@@ -293,6 +304,7 @@ static int ci_to_cj(int na_cj_2log, int ci)
         case 2: return ci;     break;
         case 1: return (ci<<1); break;
         case 3: return (ci>>1); break;
+        case 4: return (ci>>2); break;
     }
 
     return 0;
@@ -838,6 +850,36 @@ static void calc_bounding_box_x_x8(int na, const real *x, nbnxn_bb_t *bb)
     bb->upper[BB_Z] = R2F_U(zh);
 }
 
+/* Packed coordinates, bb order xyz0 */
+static void calc_bounding_box_x_x16(int na, const real *x, nbnxn_bb_t *bb)
+{
+    int  j;
+    real xl, xh, yl, yh, zl, zh;
+
+    xl = x[XX*PACK_X16];
+    xh = x[XX*PACK_X16];
+    yl = x[YY*PACK_X16];
+    yh = x[YY*PACK_X16];
+    zl = x[ZZ*PACK_X16];
+    zh = x[ZZ*PACK_X16];
+    for (j = 1; j < na; j++)
+    {
+        xl = min(xl, x[j+XX*PACK_X16]);
+        xh = max(xh, x[j+XX*PACK_X16]);
+        yl = min(yl, x[j+YY*PACK_X16]);
+        yh = max(yh, x[j+YY*PACK_X16]);
+        zl = min(zl, x[j+ZZ*PACK_X16]);
+        zh = max(zh, x[j+ZZ*PACK_X16]);
+    }
+    /* Note: possible double to float conversion here */
+    bb->lower[BB_X] = R2F_D(xl);
+    bb->lower[BB_Y] = R2F_D(yl);
+    bb->lower[BB_Z] = R2F_D(zl);
+    bb->upper[BB_X] = R2F_U(xh);
+    bb->upper[BB_Y] = R2F_U(yh);
+    bb->upper[BB_Z] = R2F_U(zh);
+}
+
 /* Packed coordinates, bb order xyz0 */
 static void calc_bounding_box_x_x4_halves(int na, const real *x,
                                           nbnxn_bb_t *bb, nbnxn_bb_t *bbj)
@@ -1005,6 +1047,40 @@ static void combine_bounding_box_pairs(nbnxn_grid_t *grid, const nbnxn_bb_t *bb)
 }
 
 
+/* Combines quadruplets of consecutive bounding boxes, used with 4x16 */
+static void combine_bounding_box_quads(nbnxn_grid_t *grid, const nbnxn_bb_t *bb)
+{
+    int    i, j, sc4, nc, c4, c, c_end;
+
+    for (i = 0; i < grid->ncx*grid->ncy; i++)
+    {
+        /* Starting bb in a column is expected to be 4-aligned */
+        sc4 = grid->cxy_ind[i]>>2;
+        /* The number of filled bbs, the last quadruplet can be partial */
+        nc  = (grid->cxy_na[i]+3)>>2;
+        for (c4 = sc4; c4 < sc4 + ((nc+3)>>2); c4++)
+        {
+            c_end = min(c4*4 + 4, grid->cxy_ind[i] + nc);
+            for (j = 0; j < NNBSBB_C; j++)
+            {
+                grid->bbj[c4].lower[j] = bb[c4*4].lower[j];
+                grid->bbj[c4].upper[j] = bb[c4*4].upper[j];
+            }
+            for (c = c4*4 + 1; c < c_end; c++)
+            {
+                for (j = 0; j < NNBSBB_C; j++)
+                {
+                    grid->bbj[c4].lower[j] = min(grid->bbj[c4].lower[j],
+                                                 bb[c].lower[j]);
+                    grid->bbj[c4].upper[j] = max(grid->bbj[c4].upper[j],
+                                                 bb[c].upper[j]);
+                }
+            }
+        }
+    }
+}
+
+
 /* Prints the average bb size, used for debug output */
 static void print_bbsizes_simple(FILE                *fp,
                                  const nbnxn_grid_t  *grid)
@@ -1237,6 +1313,14 @@ void fill_cell(const nbnxn_search_t nbs,
 
         calc_bounding_box_x_x8(na, nbat->x+X8_IND_A(a0), bb_ptr);
     }
+    else if (nbat->XFormat == nbatX16)
+    {
+        /* Store the bounding boxes as xyz.xyz. */
+        offset = (a0 - grid->cell0*grid->na_sc) >> grid->na_c_2log;
+        bb_ptr = grid->bb + offset;
+
+        calc_bounding_box_x_x16(na, nbat->x+X16_IND_A(a0), bb_ptr);
+    }
 #ifdef NBNXN_BBXXXX
     else if (!grid->bSimple)
     {
@@ -1631,6 +1715,11 @@ static void calc_cell_indices(const nbnxn_search_t nbs,
             /* Make the number of cell a multiple of 2 */
             ncz = (ncz + 1) & ~1;
         }
+        else if (nbat->XFormat == nbatX16)
+        {
+            /* Make the number of cell a multiple of 4 */
+            ncz = (ncz + 3) & ~3;
+        }
         grid->cxy_ind[i+1] = grid->cxy_ind[i] + ncz;
         /* Clear cxy_na, so we can reuse the array below */
         grid->cxy_na[i] = 0;
@@ -1725,6 +1814,10 @@ static void calc_cell_indices(const nbnxn_search_t nbs,
     {
         combine_bounding_box_pairs(grid, grid->bb);
     }
+    else if (grid->bSimple && nbat->XFormat == nbatX16)
+    {
+        combine_bounding_box_quads(grid, grid->bb);
+    }
 
     if (!grid->bSimple)
     {
@@ -1986,6 +2079,11 @@ void nbnxn_grid_add_simple(nbnxn_search_t    nbs,
                         calc_bounding_box_x_x8(na, nbat->x+X8_IND_A(tx*NBNXN_CPU_CLUSTER_I_SIZE),
                                                bb+tx);
                         break;
+                    case nbatX16:
+                        /* PACK_X16>NBNXN_CPU_CLUSTER_I_SIZE, as for X8 */
+                        calc_bounding_box_x_x16(na, nbat->x+X16_IND_A(tx*NBNXN_CPU_CLUSTER_I_SIZE),
+                                                bb+tx);
+                        break;
                     default:
                         calc_bounding_box(na, nbat->xstride,
                                           nbat->x+tx*NBNXN_CPU_CLUSTER_I_SIZE*nbat->xstride,
@@ -2009,6 +2107,10 @@ void nbnxn_grid_add_simple(nbnxn_search_t    nbs,
     {
         combine_bounding_box_pairs(grid, grid->bb_simple);
     }
+    else if (grid->bSimple && nbat->XFormat == nbatX16)
+    {
+        combine_bounding_box_quads(grid, grid->bb_simple);
+    }
 }
 
 void nbnxn_get_ncells(nbnxn_search_t nbs, int *ncx, int *ncy)
@@ -2637,7 +2739,7 @@ static void print_nblist_statistics_simple(FILE *fp, const nbnxn_pairlist_t *nbl
 
         j = nbl->ci[i].cj_ind_start;
         while (j < nbl->ci[i].cj_ind_end &&
-               nbl->cj[j].excl != NBNXN_INTERACTION_MASK_ALL)
+               nbl->cj[j].excl != NBNXN_CJ_EXCL_MASK_ALL)
         {
             npexcl++;
             j++;
@@ -2778,31 +2880,57 @@ static void set_self_and_newton_excls_supersub(nbnxn_pairlist_t *nbl,
 }
 
 /* Returns a diagonal or off-diagonal interaction mask for plain C lists */
-static unsigned int get_imask(gmx_bool rdiag, int ci, int cj)
+static nbnxn_excl_mask_t get_imask(gmx_bool rdiag, int ci, int cj)
 {
-    return (rdiag && ci == cj ? NBNXN_INTERACTION_MASK_DIAG : NBNXN_INTERACTION_MASK_ALL);
+    return (rdiag && ci == cj ? NBNXN_INTERACTION_MASK_DIAG : NBNXN_CJ_EXCL_MASK_ALL);
 }
 
 /* Returns a diagonal or off-diagonal interaction mask for cj-size=2 */
-static unsigned int get_imask_simd_j2(gmx_bool rdiag, int ci, int cj)
+static nbnxn_excl_mask_t get_imask_simd_j2(gmx_bool rdiag, int ci, int cj)
 {
     return (rdiag && ci*2 == cj ? NBNXN_INTERACTION_MASK_DIAG_J2_0 :
             (rdiag && ci*2+1 == cj ? NBNXN_INTERACTION_MASK_DIAG_J2_1 :
-             NBNXN_INTERACTION_MASK_ALL));
+             NBNXN_CJ_EXCL_MASK_ALL));
 }
 
 /* Returns a diagonal or off-diagonal interaction mask for cj-size=4 */
-static unsigned int get_imask_simd_j4(gmx_bool rdiag, int ci, int cj)
+static nbnxn_excl_mask_t get_imask_simd_j4(gmx_bool rdiag, int ci, int cj)
 {
-    return (rdiag && ci == cj ? NBNXN_INTERACTION_MASK_DIAG : NBNXN_INTERACTION_MASK_ALL);
+    return (rdiag && ci == cj ? NBNXN_INTERACTION_MASK_DIAG : NBNXN_CJ_EXCL_MASK_ALL);
 }
 
 /* Returns a diagonal or off-diagonal interaction mask for cj-size=8 */
-static unsigned int get_imask_simd_j8(gmx_bool rdiag, int ci, int cj)
+static nbnxn_excl_mask_t get_imask_simd_j8(gmx_bool rdiag, int ci, int cj)
 {
     return (rdiag && ci == cj*2 ? NBNXN_INTERACTION_MASK_DIAG_J8_0 :
             (rdiag && ci == cj*2+1 ? NBNXN_INTERACTION_MASK_DIAG_J8_1 :
-             NBNXN_INTERACTION_MASK_ALL));
+             NBNXN_CJ_EXCL_MASK_ALL));
+}
+
+/* Returns a diagonal or off-diagonal interaction mask for cj-size=16.
+ * On the diagonal, i-atom i of i-cluster ci only interacts with j-atoms
+ * j > (ci & 3)*NBNXN_CPU_CLUSTER_I_SIZE + i.
+ */
+static nbnxn_excl_mask_t get_imask_simd_j16(gmx_bool rdiag, int ci, int cj)
+{
+    nbnxn_excl_mask_t imask;
+    int               i, j;
+
+    if (!(rdiag && ci == cj*4 + (ci & 3)))
+    {
+        return NBNXN_CJ_EXCL_MASK_ALL;
+    }
+
+    imask = 0;
+    for (i = 0; i < NBNXN_CPU_CLUSTER_I_SIZE; i++)
+    {
+        for (j = (ci & 3)*NBNXN_CPU_CLUSTER_I_SIZE + i + 1; j < 16; j++)
+        {
+            imask |= ((nbnxn_excl_mask_t)1) << (i*16 + j);
+        }
+    }
+
+    return imask;
 }
 
 #ifdef GMX_NBNXN_SIMD
@@ -2817,6 +2945,7 @@ static unsigned int get_imask_simd_j8(gmx_bool rdiag, int ci, int cj)
 #define get_imask_simd_2xnn get_imask_simd_j4
 #endif
 #if GMX_SIMD_REAL_WIDTH == 16
+#define get_imask_simd_4xn  get_imask_simd_j16
 #define get_imask_simd_2xnn get_imask_simd_j8
 #endif
 #endif
@@ -3255,7 +3384,7 @@ static void set_ci_top_excls(const nbnxn_search_t nbs,
                         inner_i = i  - (si << na_ci_2log);
                         inner_e = ge - (se << na_cj_2log);
 
-                        nbl->cj[found].excl &= ~(1U<<((inner_i<<na_cj_2log) + inner_e));
+                        nbl->cj[found].excl &= ~(((nbnxn_excl_mask_t)1)<<((inner_i<<na_cj_2log) + inner_e));
                     }
                 }
             }
@@ -3401,12 +3530,20 @@ static void make_fep_list(const nbnxn_search_t    nbs,
                 }
                 else
                 {
-                    cjr    = cja - (gridj->cell0>>1);
-                    /* Combine two ci fep masks/energrp */
-                    fep_cj = gridj->fep[cjr*2] + (gridj->fep[cjr*2+1] << gridj->na_c);
-                    if (ngid > 1)
+                    int ratio, k;
+
+                    /* Combine two or four ci fep masks/energrp */
+                    ratio  = gridj->na_cj/gridj->na_c;
+                    cjr    = cja - gridj->cell0/ratio;
+                    fep_cj = 0;
+                    gid_cj = 0;
+                    for (k = 0; k < ratio; k++)
                     {
-                        gid_cj = nbat->energrp[cja*2] + (nbat->energrp[cja*2+1] << (gridj->na_c*egp_shift));
+                        fep_cj += gridj->fep[cjr*ratio+k] << (k*gridj->na_c);
+                        if (ngid > 1)
+                        {
+                            gid_cj += nbat->energrp[cja*ratio+k] << (k*gridj->na_c*egp_shift);
+                        }
                     }
                 }
 
@@ -3452,7 +3589,7 @@ static void make_fep_list(const nbnxn_search_t    nbs,
                              * but we need to avoid 0/0, as perturbed atoms
                              * can be on top of each other.
                              */
-                            nbl->cj[cj_ind].excl &= ~(1U << (i*nbl->na_cj + j));
+                            nbl->cj[cj_ind].excl &= ~(((nbnxn_excl_mask_t)1) << (i*nbl->na_cj + j));
                         }
                     }
                 }
@@ -3870,18 +4007,18 @@ static void sort_cj_excl(nbnxn_cj_t *cj, int ncj,
     jnew = 0;
     for (j = 0; j < ncj; j++)
     {
-        if (cj[j].excl != NBNXN_INTERACTION_MASK_ALL)
+        if (cj[j].excl != NBNXN_CJ_EXCL_MASK_ALL)
         {
             work->cj[jnew++] = cj[j];
         }
     }
     /* Check if there are exclusions at all or not just the first entry */
     if (!((jnew == 0) ||
-          (jnew == 1 && cj[0].excl != NBNXN_INTERACTION_MASK_ALL)))
+          (jnew == 1 && cj[0].excl != NBNXN_CJ_EXCL_MASK_ALL)))
     {
         for (j = 0; j < ncj; j++)
         {
-            if (cj[j].excl == NBNXN_INTERACTION_MASK_ALL)
+            if (cj[j].excl == NBNXN_CJ_EXCL_MASK_ALL)
             {
                 work->cj[jnew++] = cj[j];
             }
@@ -4418,9 +4555,9 @@ static void print_nblist_ci_cj(FILE *fp, const nbnxn_pairlist_t *nbl)
 
         for (j = nbl->ci[i].cj_ind_start; j < nbl->ci[i].cj_ind_end; j++)
         {
-            fprintf(fp, "  cj %5d  imask %x\n",
+            fprintf(fp, "  cj %5d  imask %llx\n",
                     nbl->cj[j].cj,
-                    nbl->cj[j].excl);
+                    (unsigned long long)nbl->cj[j].excl);
         }
     }
 }
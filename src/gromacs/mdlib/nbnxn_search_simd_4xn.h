@@ -111,7 +111,16 @@ make_cluster_list_simd_4xn(const nbnxn_grid_t *gridj,
 
     /* cppcheck-suppress selfAssignment . selfAssignment for width 4.*/
     cjf = CI_TO_CJ_SIMD_4XN(cjf);
+#if GMX_SIMD_REAL_WIDTH == 16
+    /* The search can return a cjl that is one cluster beyond the last
+     * cluster in range. With four i-clusters per j-cluster, rounding
+     * cjl+1 down could then skip the j-cluster of the last cluster
+     * in range, so here we use the j-cluster containing cjl.
+     */
+    cjl = CI_TO_CJ_SIMD_4XN(cjl);
+#else
     cjl = CI_TO_CJ_SIMD_4XN(cjl+1) - 1;
+#endif
 
     work = nbl->work->x_ci_simd_4xn;
 
@@ -59,6 +59,10 @@
 #define GMX_NBNXN_SIMD
 #endif
 
+#ifdef GMX_SIMD_X86_AVX_512F
+#define GMX_NBNXN_SIMD
+#endif
+
 /* MIC for double is implemented in the SIMD module but so far missing in
    mdlib/nbnxn_kernels/nbnxn_kernel_simd_utils_x86_mic.h */
 #if defined GMX_SIMD_X86_MIC && !defined GMX_DOUBLE
@@ -67,11 +71,15 @@
 
 #ifdef GMX_NBNXN_SIMD
 /* The nbnxn SIMD 4xN and 2x(N+N) kernels can be added independently.
+ * With 16-way SIMD the 4xN kernels use a 4x16 setup, which is only
+ * implemented for AVX-512F in single precision.
  * Currently the 2xNN SIMD kernels only make sense with:
  *  8-way SIMD: 4x4 setup, works with AVX-256 in single precision
- * 16-way SIMD: 4x8 setup, works with Intel MIC in single precision
+ *              and AVX-512F in double precision
+ * 16-way SIMD: 4x8 setup, works with Intel MIC and AVX-512F in single precision
  */
-#if GMX_SIMD_REAL_WIDTH == 2 || GMX_SIMD_REAL_WIDTH == 4 || GMX_SIMD_REAL_WIDTH == 8
+#if GMX_SIMD_REAL_WIDTH == 2 || GMX_SIMD_REAL_WIDTH == 4 || GMX_SIMD_REAL_WIDTH == 8 || \
+    (GMX_SIMD_REAL_WIDTH == 16 && defined GMX_SIMD_X86_AVX_512F)
 #define GMX_NBNXN_SIMD_4XN
 #endif
 #if GMX_SIMD_REAL_WIDTH == 8 || GMX_SIMD_REAL_WIDTH == 16
@@ -0,0 +1,421 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2015, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+#include "gmxpre.h"
+
+#include "config.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "gromacs/legacyheaders/constr.h"
+#include "gromacs/legacyheaders/gmx_omp_nthreads.h"
+#include "gromacs/legacyheaders/nrnb.h"
+#include "gromacs/legacyheaders/types/commrec.h"
+#include "gromacs/legacyheaders/types/inputrec.h"
+#include "gromacs/legacyheaders/types/mdatom.h"
+#include "gromacs/math/vec.h"
+#include "gromacs/pbcutil/pbc.h"
+#include "gromacs/random/random.h"
+#include "gromacs/topology/topology.h"
+#include "gromacs/utility/smalloc.h"
+
+#include "testutils/testasserts.h"
+
+namespace
+{
+
+//! Number of chains of 4 atoms with 3 constraints each
+const int  c_numChains = 5;
+//! Number of rigid constraint triangles
+const int  c_numTriangles = 2;
+//! Number of atoms, the number of constraints is not a multiple of the SIMD width
+const int  c_numAtoms = c_numChains*4 + c_numTriangles*3 + 5;
+//! Constraint length in the chains
+const real c_dChain = 0.15;
+//! Short and long constraint lengths of the triangles
+const real c_dTriangle[2] = { 0.1, 0.1633 };
+//! Constraint length of the star of four constraints around one atom
+const real c_dStar = 0.109;
+//! Maximum displacement of each coordinate of the updated positions
+const real c_maxDisplacement = 0.01;
+//! Time step
+const real c_dt = 0.002;
+
+/*! \brief Test fixture for comparing the SIMD and plain C LINCS kernels
+ *
+ * The system consists of chains, triangles and a star of constraints,
+ * so blocks of constraints have different numbers of couplings
+ * and the last block is padded with dummy constraints.
+ */
+class LincsTest : public ::testing::TestWithParam<int>
+{
+    public:
+        LincsTest() : mtop_(), idef_(), at2con_(), nflexcon_(0), bUsePbc_(false),
+                      ir_(), md_(), cr_(), pbc_()
+        {
+            snew(mtop_.moltype, 1);
+            snew(mtop_.molblock, 1);
+            mtop_.nmoltype               = 1;
+            mtop_.nmolblock              = 1;
+            mtop_.molblock[0].type       = 0;
+            mtop_.molblock[0].nmol       = 1;
+            mtop_.molblock[0].natoms_mol = c_numAtoms;
+            mtop_.natoms                 = c_numAtoms;
+
+            ir_.efep           = efepNO;
+            ir_.eI             = eiMD;
+            ir_.delta_t        = c_dt;
+            ir_.LincsWarnAngle = 30;
+            ir_.nLincsIter     = 1;
+            ir_.nProjOrder     = 4;
+
+            init_nrnb(&nrnb_);
+        }
+
+        ~LincsTest()
+        {
+            sfree(at2con_.index);
+            sfree(at2con_.a);
+            sfree(mtop_.moltype);
+            sfree(mtop_.molblock);
+        }
+
+        //! Adds a constraint of type \p type between atoms \p a1 and \p a2
+        void addConstraint(int type, int a1, int a2)
+        {
+            iatoms_.push_back(type);
+            iatoms_.push_back(a1);
+            iatoms_.push_back(a2);
+        }
+
+        //! Generates the topology, masses, positions and velocities
+        void generateSystem(bool bUsePbc)
+        {
+            matrix    box = {{1.9, 0, 0}, {0, 1.8, 0}, {0, 0, 1.7}};
+            gmx_rng_t rng = gmx_rng_init(4321);
+            rvec     *x;
+            int       a = 0;
+
+            iparams_.resize(4);
+            iparams_[0].constr.dA = iparams_[0].constr.dB = c_dChain;
+            iparams_[1].constr.dA = iparams_[1].constr.dB = c_dTriangle[0];
+            iparams_[2].constr.dA = iparams_[2].constr.dB = c_dTriangle[1];
+            iparams_[3].constr.dA = iparams_[3].constr.dB = c_dStar;
+
+            x_.resize(c_numAtoms*DIM);
+            x = asRvecArray(&x_);
+            for (int c = 0; c < c_numChains; c++, a += 4)
+            {
+                for (int d = 0; d < DIM; d++)
+                {
+                    x[a][d] = gmx_rng_uniform_real(rng)*box[d][d];
+                }
+                for (int i = 1; i < 4; i++)
+                {
+                    addRandomVector(rng, x[a + i - 1], c_dChain, x[a + i]);
+                    addConstraint(0, a + i - 1, a + i);
+                }
+            }
+            for (int t = 0; t < c_numTriangles; t++, a += 3)
+            {
+                rvec e1, e2, tmp;
+
+                for (int d = 0; d < DIM; d++)
+                {
+                    x[a][d] = gmx_rng_uniform_real(rng)*box[d][d];
+                    e1[d]   = gmx_rng_uniform_real(rng) - 0.5;
+                    e2[d]   = gmx_rng_uniform_real(rng) - 0.5;
+                }
+                unitv(e1, e1);
+                cprod(e1, e2, tmp);
+                cprod(tmp, e1, e2);
+                unitv(e2, e2);
+                real sinHalf = 0.5*c_dTriangle[1]/c_dTriangle[0];
+                real cosHalf = std::sqrt(1 - sinHalf*sinHalf);
+                for (int d = 0; d < DIM; d++)
+                {
+                    x[a + 1][d] = x[a][d] + c_dTriangle[0]*( sinHalf*e1[d] + cosHalf*e2[d]);
+                    x[a + 2][d] = x[a][d] + c_dTriangle[0]*(-sinHalf*e1[d] + cosHalf*e2[d]);
+                }
+                addConstraint(1, a, a + 1);
+                addConstraint(1, a, a + 2);
+                addConstraint(2, a + 1, a + 2);
+            }
+            /* Put the star at the corner of the box */
+            clear_rvec(x[a]);
+            for (int i = 1; i < 5; i++)
+            {
+                addRandomVector(rng, x[a], c_dStar, x[a + i]);
+                addConstraint(3, a, a + i);
+            }
+
+            xprime_.resize(x_.size());
+            v_.resize(x_.size());
+            for (size_t j = 0; j < x_.size(); j++)
+            {
+                xprime_[j] = x_[j] + 2*c_maxDisplacement*(gmx_rng_uniform_real(rng) - 0.5);
+                v_[j]      = 2*(gmx_rng_uniform_real(rng) - 0.5);
+            }
+            invmass_.resize(c_numAtoms);
+            for (int i = 0; i < c_numAtoms; i++)
+            {
+                invmass_[i] = 1/(1 + 15*gmx_rng_uniform_real(rng));
+            }
+            gmx_rng_destroy(rng);
+
+            if (bUsePbc)
+            {
+                /* Put the atoms, separately for x and xprime, in the box,
+                 * so some molecules are split over periodic images.
+                 */
+                put_atoms_in_box(epbcXYZ, box, c_numAtoms, asRvecArray(&x_));
+                put_atoms_in_box(epbcXYZ, box, c_numAtoms, asRvecArray(&xprime_));
+                set_pbc(&pbc_, epbcXYZ, box);
+            }
+            copy_mat(box, box_);
+            bUsePbc_ = bUsePbc;
+
+            t_ilist *il = &mtop_.moltype[0].ilist[F_CONSTR];
+            il->nr      = iatoms_.size();
+            il->iatoms  = &iatoms_[0];
+            idef_.il[F_CONSTR]     = *il;
+            idef_.iparams          = &iparams_[0];
+            mtop_.ffparams.iparams = &iparams_[0];
+            at2con_                = make_at2con(0, c_numAtoms, mtop_.moltype[0].ilist,
+                                                 &iparams_[0], TRUE, &nflexcon_);
+
+            md_.nr      = c_numAtoms;
+            md_.homenr  = c_numAtoms;
+            md_.invmass = &invmass_[0];
+        }
+
+        //! Sets \p xj to \p xi plus a vector of length \p length in a random direction
+        static void addRandomVector(gmx_rng_t rng, const rvec xi, real length, rvec xj)
+        {
+            rvec dx;
+
+            for (int d = 0; d < DIM; d++)
+            {
+                dx[d] = gmx_rng_uniform_real(rng) - 0.5;
+            }
+            unitv(dx, dx);
+            for (int d = 0; d < DIM; d++)
+            {
+                xj[d] = xi[d] + length*dx[d];
+            }
+        }
+
+        //! Returns a vector of DIM*n reals as an rvec array
+        static rvec *asRvecArray(std::vector<real> *x)
+        {
+            return reinterpret_cast<rvec *>(&(*x)[0]);
+        }
+
+        //! Returns the PBC struct to pass to LINCS
+        t_pbc *pbc()
+        {
+            return (bUsePbc_ ? &pbc_ : NULL);
+        }
+
+        //! Returns LINCS data set up for the system using the given kernels
+        gmx_lincsdata_t initLincs(bool bUseSimd)
+        {
+            gmx_lincsdata_t lincsd;
+
+            /* The thread count is read by init_lincs */
+            gmx_omp_nthreads_set(emntLINCS, GetParam());
+            lincsd = init_lincs(NULL, &mtop_, nflexcon_, &at2con_, FALSE,
+                                ir_.nLincsIter, ir_.nProjOrder, bUseSimd);
+            set_lincs(&idef_, &md_, TRUE, &cr_, lincsd);
+
+            return lincsd;
+        }
+
+        //! Returns the largest absolute value in \p x
+        static real maxAbs(const std::vector<real> &x)
+        {
+            real magnitude = 0;
+            for (size_t j = 0; j < x.size(); j++)
+            {
+                magnitude = std::max(magnitude, std::abs(x[j]));
+            }
+            return magnitude;
+        }
+
+        //! Compares two sets of vectors with a tolerance relative to the largest value
+        static void compareVectors(const std::vector<real> &ref,
+                                   const std::vector<real> &test,
+                                   real                     relTolerance)
+        {
+            gmx::test::FloatingPointTolerance tolerance =
+                gmx::test::relativeToleranceAsFloatingPoint(maxAbs(ref), relTolerance);
+            for (size_t j = 0; j < ref.size(); j++)
+            {
+                EXPECT_REAL_EQ_TOL(ref[j], test[j], tolerance)
+                << "atom " << j/DIM << " dimension " << j % DIM;
+            }
+        }
+
+        //! Compares two tensors with a tolerance relative to the largest element of \p ref
+        static void compareTensors(const tensor ref, const tensor test,
+                                   real relTolerance)
+        {
+            real magnitude = 0;
+            for (int d = 0; d < DIM; d++)
+            {
+                for (int d2 = 0; d2 < DIM; d2++)
+                {
+                    magnitude = std::max(magnitude, std::abs(ref[d][d2]));
+                }
+            }
+            EXPECT_GT(magnitude, 0);
+            gmx::test::FloatingPointTolerance tolerance =
+                gmx::test::relativeToleranceAsFloatingPoint(magnitude, relTolerance);
+            for (int d = 0; d < DIM; d++)
+            {
+                for (int d2 = 0; d2 < DIM; d2++)
+                {
+                    EXPECT_REAL_EQ_TOL(ref[d][d2], test[d][d2], tolerance)
+                    << "virial element " << d << " " << d2;
+                }
+            }
+        }
+
+        //! Constrains the coordinates with both kernels and compares the results
+        void runConstrainCoordinates()
+        {
+            std::vector<real> xprimeRef(xprime_), xprimeSimd(xprime_);
+            std::vector<real> vRef(v_), vSimd(v_);
+            tensor            virRef, virSimd;
+            gmx_lincsdata_t   lincsdRef, lincsdSimd;
+            int               warncount = 0;
+
+            lincsdRef  = initLincs(false);
+            lincsdSimd = initLincs(true);
+
+            clear_mat(virRef);
+            clear_mat(virSimd);
+            EXPECT_TRUE(constrain_lincs(NULL, FALSE, FALSE, &ir_, 0, lincsdRef, &md_, &cr_,
+                                        asRvecArray(&x_), asRvecArray(&xprimeRef), NULL,
+                                        box_, pbc(), 0, NULL, 1/c_dt, asRvecArray(&vRef),
+                                        TRUE, virRef, econqCoord, &nrnb_, -1, &warncount));
+            EXPECT_TRUE(constrain_lincs(NULL, FALSE, FALSE, &ir_, 0, lincsdSimd, &md_, &cr_,
+                                        asRvecArray(&x_), asRvecArray(&xprimeSimd), NULL,
+                                        box_, pbc(), 0, NULL, 1/c_dt, asRvecArray(&vSimd),
+                                        TRUE, virSimd, econqCoord, &nrnb_, -1, &warncount));
+
+            compareVectors(xprimeRef, xprimeSimd, 1e-5);
+            compareVectors(vRef, vSimd, 1e-4);
+            compareTensors(virRef, virSimd, 1e-4);
+        }
+
+        //! Projects out the constraint components of the velocities or forces with both kernels
+        void runProject(int econq)
+        {
+            std::vector<real> vRef(v_), vSimd(v_);
+            gmx_lincsdata_t   lincsdRef, lincsdSimd;
+
+            lincsdRef  = initLincs(false);
+            lincsdSimd = initLincs(true);
+
+            /* As in constrain(), the vectors are corrected in place */
+            constrain_lincs(NULL, FALSE, FALSE, &ir_, 0, lincsdRef, &md_, &cr_,
+                            asRvecArray(&x_), asRvecArray(&vRef), asRvecArray(&vRef),
+                            box_, pbc(), 0, NULL, 0, NULL,
+                            FALSE, NULL, econq, &nrnb_, -1, NULL);
+            constrain_lincs(NULL, FALSE, FALSE, &ir_, 0, lincsdSimd, &md_, &cr_,
+                            asRvecArray(&x_), asRvecArray(&vSimd), asRvecArray(&vSimd),
+                            box_, pbc(), 0, NULL, 0, NULL,
+                            FALSE, NULL, econq, &nrnb_, -1, NULL);
+
+            compareVectors(vRef, vSimd, 1e-5);
+        }
+
+        gmx_mtop_t             mtop_;
+        t_idef                 idef_;
+        std::vector<t_iparams> iparams_;
+        std::vector<t_iatom>   iatoms_;
+        t_blocka               at2con_;
+        int                    nflexcon_;
+        std::vector<real>      invmass_;
+        std::vector<real>      x_;
+        std::vector<real>      xprime_;
+        std::vector<real>      v_;
+        matrix                 box_;
+        bool                   bUsePbc_;
+        t_inputrec             ir_;
+        t_mdatoms              md_;
+        t_commrec              cr_;
+        t_pbc                  pbc_;
+        t_nrnb                 nrnb_;
+};
+
+TEST_P(LincsTest, ConstrainCoordinatesMatchesPlainCWithoutPbc)
+{
+    generateSystem(false);
+    runConstrainCoordinates();
+}
+
+TEST_P(LincsTest, ConstrainCoordinatesMatchesPlainCWithPbc)
+{
+    generateSystem(true);
+    runConstrainCoordinates();
+}
+
+TEST_P(LincsTest, ProjectVelocitiesMatchesPlainC)
+{
+    generateSystem(true);
+    runProject(econqVeloc);
+}
+
+TEST_P(LincsTest, ProjectForcesMatchesPlainC)
+{
+    generateSystem(false);
+    runProject(econqForce);
+}
+
+/* With more than one thread, each thread starts at a SIMD block,
+ * so, depending on the SIMD width, some threads get no constraints.
+ */
+#ifdef GMX_OPENMP
+INSTANTIATE_TEST_CASE_P(WithThreads, LincsTest, ::testing::Values(1, 2, 4));
+#else
+INSTANTIATE_TEST_CASE_P(WithThreads, LincsTest, ::testing::Values(1));
+#endif
+
+} // namespace
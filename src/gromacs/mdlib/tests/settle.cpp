@@ -0,0 +1,328 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2015, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+#include "gmxpre.h"
+
+#include <cmath>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "gromacs/legacyheaders/constr.h"
+#include "gromacs/legacyheaders/types/simple.h"
+#include "gromacs/legacyheaders/types/state.h"
+#include "gromacs/math/vec.h"
+#include "gromacs/pbcutil/pbc.h"
+#include "gromacs/random/random.h"
+#include "gromacs/utility/smalloc.h"
+
+#include "testutils/testasserts.h"
+
+#include "simdtestutils.h"
+
+namespace gmx
+{
+namespace test
+{
+namespace
+{
+
+//! Number of waters, chosen not to be a multiple of the SIMD width
+const int  c_numSettles = 19;
+//! Stride of the settle iatoms: type, O, H, H
+const int  c_settleStride = 4;
+//! Oxygen mass
+const real c_mO  = 15.9994;
+//! Hydrogen mass
+const real c_mH  = 1.008;
+//! O-H distance of SPC water
+const real c_dOH = 0.1;
+//! H-H distance of SPC water
+const real c_dHH = 0.1633;
+//! Maximum displacement of each coordinate of the updated positions
+const real c_maxDisplacement = 0.01;
+
+/*! \brief Test fixture for comparing the SIMD and plain C SETTLE kernels
+ *
+ * The waters are stored in the order O H H, with random orientations
+ * and positions. The updated positions, to be constrained, are
+ * the starting positions with a random displacement.
+ */
+class SettleTest : public ::testing::Test
+{
+    public:
+        SettleTest() : settledSimd_(NULL), settledRef_(NULL)
+        {
+            vetavar_.veta       = 0.1;
+            vetavar_.rscale     = 1.02;
+            vetavar_.vscale     = 1.01;
+            vetavar_.rvscale    = 0.99;
+            vetavar_.alpha      = 1;
+            vscaleNhc_          = 0.98;
+            vetavar_.vscale_nhc = &vscaleNhc_;
+        }
+
+        void SetUp()
+        {
+            settledSimd_ = settle_init(c_mO, c_mH, 1/c_mO, 1/c_mH, c_dOH, c_dHH, TRUE);
+            settledRef_  = settle_init(c_mO, c_mH, 1/c_mO, 1/c_mH, c_dOH, c_dHH, FALSE);
+
+            iatoms_.resize(c_numSettles*c_settleStride);
+            for (int i = 0; i < c_numSettles; i++)
+            {
+                iatoms_[i*c_settleStride] = 0;
+                for (int a = 0; a < 3; a++)
+                {
+                    iatoms_[i*c_settleStride + 1 + a] = i*3 + a;
+                }
+            }
+        }
+
+        void TearDown()
+        {
+            sfree(settledSimd_);
+            sfree(settledRef_);
+        }
+
+        //! Generates the starting and updated positions and the velocities
+        void generateSystem(PbcType pbcType)
+        {
+            matrix    box;
+            gmx_rng_t rng = gmx_rng_init(1234);
+
+            setTestBox(pbcType, box);
+
+            x_.resize(c_numSettles*3*DIM);
+            xprime_.resize(c_numSettles*3*DIM);
+            v_.resize(c_numSettles*3*DIM);
+            for (int i = 0; i < c_numSettles; i++)
+            {
+                rvec xO, e1, e2, tmp;
+
+                randomPositionInBox(rng, box, xO);
+                randomUnitVector(rng, e1);
+                randomUnitVector(rng, e2);
+                /* Put one water at the corner of the box */
+                if (i == 2)
+                {
+                    clear_rvec(xO);
+                }
+                /* Construct two orthonormal vectors in the water plane */
+                cprod(e1, e2, tmp);
+                cprod(tmp, e1, e2);
+                unitv(e2, e2);
+
+                real sinHalf = 0.5*c_dHH/c_dOH;
+                real cosHalf = std::sqrt(1 - sinHalf*sinHalf);
+                for (int d = 0; d < DIM; d++)
+                {
+                    x_[(i*3    )*DIM + d] = xO[d];
+                    x_[(i*3 + 1)*DIM + d] = xO[d] + c_dOH*( sinHalf*e1[d] + cosHalf*e2[d]);
+                    x_[(i*3 + 2)*DIM + d] = xO[d] + c_dOH*(-sinHalf*e1[d] + cosHalf*e2[d]);
+                }
+            }
+            for (size_t j = 0; j < x_.size(); j++)
+            {
+                xprime_[j] = x_[j] + 2*c_maxDisplacement*(gmx_rng_uniform_real(rng) - 0.5);
+                v_[j]      = 2*(gmx_rng_uniform_real(rng) - 0.5);
+            }
+            gmx_rng_destroy(rng);
+
+            /* Put the atoms, separately for x and xprime, in the box,
+             * so some waters are split over periodic images.
+             */
+            putAtomsInBox(pbcType, box, &x_);
+            putAtomsInBox(pbcType, box, &xprime_);
+            set_pbc(&pbc_, ePBCFromPbcType(pbcType), box);
+            pbcType_ = pbcType;
+        }
+
+        //! Moves the oxygen of water \p i out of the plane of its starting position
+        void makeSettleFail(int i)
+        {
+            rvec *x = asRvecArray(&x_);
+            rvec  b0, c0, n;
+
+            rvec_sub(x[i*3 + 1], x[i*3], b0);
+            rvec_sub(x[i*3 + 2], x[i*3], c0);
+            cprod(b0, c0, n);
+            unitv(n, n);
+            svmul(0.2, n, n);
+            rvec_inc(asRvecArray(&xprime_)[i*3], n);
+        }
+
+        //! Returns the PBC struct to pass to the kernels
+        const t_pbc *pbc() const
+        {
+            return (pbcType_ == ePbcTypeNone ? NULL : &pbc_);
+        }
+
+        //! Runs csettle with both kernels and compares the results
+        void runCsettle(int calcvirAtomEnd, int expectedError)
+        {
+            std::vector<real> xprimeRef(xprime_), xprimeSimd(xprime_);
+            std::vector<real> vRef(v_), vSimd(v_);
+            tensor                 virRef, virSimd;
+            int                    errorRef, errorSimd;
+
+            clear_mat(virRef);
+            clear_mat(virSimd);
+            csettle(settledRef_, c_numSettles, &iatoms_[0], pbc(),
+                    &x_[0], &xprimeRef[0], 1/c_dt, &vRef[0], calcvirAtomEnd,
+                    virRef, &errorRef, &vetavar_);
+            csettle(settledSimd_, c_numSettles, &iatoms_[0], pbc(),
+                    &x_[0], &xprimeSimd[0], 1/c_dt, &vSimd[0], calcvirAtomEnd,
+                    virSimd, &errorSimd, &vetavar_);
+
+            EXPECT_EQ(expectedError, errorRef);
+            EXPECT_EQ(expectedError, errorSimd);
+            compareVectors(xprimeRef, xprimeSimd, maxAbs(xprimeRef), 1e-5);
+            compareVectors(vRef, vSimd, maxAbs(vRef), 1e-4);
+            if (calcvirAtomEnd > 0)
+            {
+                /* The virial sums terms x*m*dx which mostly cancel */
+                compareTensors(virRef, virSimd,
+                               maxAbs(x_)*c_mO*c_maxDisplacement, 1e-5);
+            }
+        }
+
+        //! Runs settle_proj with both kernels and compares the results
+        void runSettleProj(int calcvirAtomEnd)
+        {
+            std::vector<real> vRef(v_), vSimd(v_);
+            tensor                 virRef, virSimd;
+
+            /* As in constrain(), the velocities are corrected in place */
+            clear_mat(virRef);
+            clear_mat(virSimd);
+            settle_proj(settledRef_, econqVeloc, c_numSettles, &iatoms_[0], pbc(),
+                        asRvecArray(&x_), asRvecArray(&vRef), asRvecArray(&vRef),
+                        calcvirAtomEnd, virRef, &vetavar_);
+            settle_proj(settledSimd_, econqVeloc, c_numSettles, &iatoms_[0], pbc(),
+                        asRvecArray(&x_), asRvecArray(&vSimd), asRvecArray(&vSimd),
+                        calcvirAtomEnd, virSimd, &vetavar_);
+
+            compareVectors(vRef, vSimd, maxAbs(vRef), 1e-5);
+            if (calcvirAtomEnd > 0)
+            {
+                compareTensors(virRef, virSimd, 0, 1e-4);
+            }
+        }
+
+        //! Time step
+        static const real c_dt;
+
+        gmx_settledata_t       settledSimd_;
+        gmx_settledata_t       settledRef_;
+        std::vector<t_iatom>   iatoms_;
+        std::vector<real> x_;
+        std::vector<real> xprime_;
+        std::vector<real> v_;
+        PbcType                pbcType_;
+        t_pbc                  pbc_;
+        t_vetavars             vetavar_;
+        double                 vscaleNhc_;
+};
+
+const real SettleTest::c_dt = 0.002;
+
+/* The virial is computed for the first 5 waters only, so the virial
+ * end falls in the middle of a SIMD batch for SIMD widths 2, 4 and 8.
+ */
+TEST_F(SettleTest, CsettleMatchesPlainCWithoutPbc)
+{
+    generateSystem(ePbcTypeNone);
+    runCsettle(5*3, -1);
+}
+
+TEST_F(SettleTest, CsettleMatchesPlainCWithRectangularPbc)
+{
+    generateSystem(ePbcTypeRectangular);
+    runCsettle(5*3, -1);
+}
+
+TEST_F(SettleTest, CsettleMatchesPlainCWithTriclinicPbc)
+{
+    generateSystem(ePbcTypeTriclinic);
+    runCsettle(5*3, -1);
+}
+
+TEST_F(SettleTest, CsettleMatchesPlainCWithoutVirial)
+{
+    generateSystem(ePbcTypeRectangular);
+    runCsettle(0, -1);
+}
+
+/* Water 1 is handled by SIMD with any SIMD width > 1, the last water
+ * is always in the plain C remainder, which overrides the error index.
+ */
+TEST_F(SettleTest, CsettleReportsErrorInSimdBatch)
+{
+    generateSystem(ePbcTypeNone);
+    makeSettleFail(1);
+    runCsettle(5*3, 1);
+}
+
+TEST_F(SettleTest, CsettleReportsLastError)
+{
+    generateSystem(ePbcTypeNone);
+    makeSettleFail(1);
+    makeSettleFail(c_numSettles - 1);
+    runCsettle(5*3, c_numSettles - 1);
+}
+
+/* settle_proj compares the oxygen atom index with DIM times the virial
+ * atom end, so this also ends the virial at the 5th water.
+ */
+TEST_F(SettleTest, SettleProjMatchesPlainCWithoutPbc)
+{
+    generateSystem(ePbcTypeNone);
+    runSettleProj(5);
+}
+
+TEST_F(SettleTest, SettleProjMatchesPlainCWithRectangularPbc)
+{
+    generateSystem(ePbcTypeRectangular);
+    runSettleProj(5);
+}
+
+TEST_F(SettleTest, SettleProjMatchesPlainCWithTriclinicPbc)
+{
+    generateSystem(ePbcTypeTriclinic);
+    runSettleProj(5);
+}
+
+} // namespace
+} // namespace test
+} // namespace gmx
@@ -0,0 +1,166 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2015, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+/*! \internal \file
+ * \brief
+ * Implements the helper routines for the SIMD mdlib kernel tests.
+ *
+ * \ingroup module_mdlib
+ */
+#include "gmxpre.h"
+
+#include "simdtestutils.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include <gtest/gtest.h>
+
+#include "gromacs/legacyheaders/types/enums.h"
+#include "gromacs/math/vec.h"
+#include "gromacs/pbcutil/pbc.h"
+
+#include "testutils/testasserts.h"
+
+namespace gmx
+{
+namespace test
+{
+
+int ePBCFromPbcType(PbcType pbcType)
+{
+    return (pbcType == ePbcTypeNone ? epbcNONE : epbcXYZ);
+}
+
+void setTestBox(PbcType pbcType, matrix box)
+{
+    clear_mat(box);
+    box[XX][XX] = 2.0;
+    box[YY][YY] = 1.9;
+    box[ZZ][ZZ] = 1.8;
+    if (pbcType == ePbcTypeTriclinic)
+    {
+        box[YY][XX] = 0.6;
+        box[ZZ][XX] = -0.5;
+        box[ZZ][YY] = 0.4;
+    }
+}
+
+rvec *asRvecArray(std::vector<real> *x)
+{
+    return reinterpret_cast<rvec *>(&(*x)[0]);
+}
+
+void randomPositionInBox(gmx_rng_t rng, const matrix box, rvec x)
+{
+    for (int d = 0; d < DIM; d++)
+    {
+        x[d] = gmx_rng_uniform_real(rng)*box[d][d];
+    }
+}
+
+void randomUnitVector(gmx_rng_t rng, rvec v)
+{
+    for (int d = 0; d < DIM; d++)
+    {
+        v[d] = gmx_rng_uniform_real(rng) - 0.5;
+    }
+    unitv(v, v);
+}
+
+void putAtomsInBox(PbcType pbcType, const matrix box, std::vector<real> *x)
+{
+    if (pbcType != ePbcTypeNone)
+    {
+        matrix boxCopy;
+
+        copy_mat(box, boxCopy);
+        put_atoms_in_box(epbcXYZ, boxCopy, x->size()/DIM, asRvecArray(x));
+    }
+}
+
+real maxAbs(const std::vector<real> &x)
+{
+    real magnitude = 0;
+    for (size_t j = 0; j < x.size(); j++)
+    {
+        magnitude = std::max(magnitude, std::abs(x[j]));
+    }
+    return magnitude;
+}
+
+void compareVectors(const std::vector<real> &ref,
+                    const std::vector<real> &test,
+                    real magnitude, real relTolerance)
+{
+    FloatingPointTolerance tolerance =
+        relativeToleranceAsFloatingPoint(magnitude, relTolerance);
+    ASSERT_EQ(ref.size(), test.size());
+    for (size_t j = 0; j < ref.size(); j++)
+    {
+        EXPECT_REAL_EQ_TOL(ref[j], test[j], tolerance)
+        << "index " << j/DIM << " dimension " << j % DIM;
+    }
+}
+
+void compareTensors(const tensor ref, const tensor test,
+                    real magnitude, real relTolerance)
+{
+    real maxElement = 0;
+    for (int d = 0; d < DIM; d++)
+    {
+        for (int d2 = 0; d2 < DIM; d2++)
+        {
+            maxElement = std::max(maxElement, std::abs(ref[d][d2]));
+        }
+    }
+    EXPECT_GT(maxElement, 0);
+    if (magnitude <= 0)
+    {
+        magnitude = maxElement;
+    }
+    FloatingPointTolerance tolerance =
+        relativeToleranceAsFloatingPoint(magnitude, relTolerance);
+    for (int d = 0; d < DIM; d++)
+    {
+        for (int d2 = 0; d2 < DIM; d2++)
+        {
+            EXPECT_REAL_EQ_TOL(ref[d][d2], test[d][d2], tolerance)
+            << "tensor element " << d << " " << d2;
+        }
+    }
+}
+
+} // namespace test
+} // namespace gmx
@@ -0,0 +1,103 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2015, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+/*! \internal \file
+ * \brief
+ * Helper routines for tests comparing SIMD and plain C mdlib kernels.
+ *
+ * The helpers generate random atom geometries in a, possibly triclinic,
+ * periodic box and compare the results of the two kernels.
+ *
+ * \ingroup module_mdlib
+ */
+#ifndef GMX_MDLIB_TESTS_SIMDTESTUTILS_H
+#define GMX_MDLIB_TESTS_SIMDTESTUTILS_H
+
+#include <vector>
+
+#include "gromacs/math/vectypes.h"
+#include "gromacs/random/random.h"
+#include "gromacs/utility/real.h"
+
+namespace gmx
+{
+namespace test
+{
+
+//! Which periodic boundary conditions to use
+enum PbcType
+{
+    ePbcTypeNone, ePbcTypeRectangular, ePbcTypeTriclinic
+};
+
+//! Returns the PBC type to pass to the mdlib code for \p pbcType
+int ePBCFromPbcType(PbcType pbcType);
+
+//! Sets \p box to the test box, which has off-diagonal elements with triclinic PBC
+void setTestBox(PbcType pbcType, matrix box);
+
+//! Returns a vector of DIM*n reals as an rvec array
+rvec *asRvecArray(std::vector<real> *x);
+
+//! Returns a random position in the rectangular part of \p box
+void randomPositionInBox(gmx_rng_t rng, const matrix box, rvec x);
+
+//! Returns a random unit vector
+void randomUnitVector(gmx_rng_t rng, rvec v);
+
+/*! \brief Puts the atoms in \p x in the box with PBC
+ *
+ * With random positions, this splits some molecules over periodic images.
+ */
+void putAtomsInBox(PbcType pbcType, const matrix box, std::vector<real> *x);
+
+//! Returns the largest absolute value in \p x
+real maxAbs(const std::vector<real> &x);
+
+//! Compares two sets of vectors with a tolerance relative to \p magnitude
+void compareVectors(const std::vector<real> &ref,
+                    const std::vector<real> &test,
+                    real magnitude, real relTolerance);
+
+/*! \brief Compares two tensors with a tolerance relative to \p magnitude
+ *
+ * A non-positive \p magnitude uses the largest element of \p ref.
+ */
+void compareTensors(const tensor ref, const tensor test,
+                    real magnitude, real relTolerance);
+
+} // namespace test
+} // namespace gmx
+
+#endif
@@ -0,0 +1,269 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2015, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+/*! \internal \file
+ * \brief
+ * Tests for the SIMD update and kinetic energy kernels.
+ *
+ * \ingroup module_mdlib
+ */
+#include "gmxpre.h"
+
+#include "gromacs/mdlib/update_internal.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "gromacs/math/vec.h"
+#include "gromacs/random/random.h"
+
+#include "testutils/testasserts.h"
+
+namespace
+{
+
+//! Number of atoms, chosen not to be a multiple of the SIMD width
+const int  c_numAtoms = 37;
+//! First atom to update, so the SIMD blocks start at an unaligned atom
+const int  c_start    = 2;
+//! Time step
+const real c_dt       = 0.002;
+
+/*! \brief Test fixture for comparing the SIMD and plain C update kernels
+ *
+ * The SIMD kernels are selected with bUseSimd, without SIMD support
+ * both kernels run the same plain C code.
+ */
+class UpdateTest : public ::testing::Test
+{
+    public:
+        UpdateTest()
+        {
+            gmx_rng_t rng = gmx_rng_init(1234);
+
+            invMassPerDim_.resize(c_numAtoms*DIM);
+            x_.resize(c_numAtoms*DIM);
+            v_.resize(c_numAtoms*DIM);
+            f_.resize(c_numAtoms*DIM);
+            massT_.resize(c_numAtoms);
+            for (int i = 0; i < c_numAtoms; i++)
+            {
+                massT_[i] = 1 + 20*gmx_rng_uniform_real(rng);
+                for (int d = 0; d < DIM; d++)
+                {
+                    invMassPerDim_[i*DIM + d] = 1/massT_[i];
+                    x_[i*DIM + d]             = 3*gmx_rng_uniform_real(rng);
+                    v_[i*DIM + d]             = 2*(gmx_rng_uniform_real(rng) - 0.5);
+                    f_[i*DIM + d]             = 1000*(gmx_rng_uniform_real(rng) - 0.5);
+                }
+            }
+            /* Global atom indices as with domain decomposition */
+            for (int i = 0; i < c_numAtoms; i++)
+            {
+                gatindex_.push_back((i*7) % c_numAtoms + 100);
+            }
+            gmx_rng_destroy(rng);
+        }
+
+        //! Returns a vector of DIM*n reals as an rvec array
+        static rvec *asRvecArray(std::vector<real> *x)
+        {
+            return reinterpret_cast<rvec *>(&(*x)[0]);
+        }
+
+        //! Returns a vector of DIM*n reals as a const rvec array
+        static const rvec *asRvecArray(const std::vector<real> &x)
+        {
+            return reinterpret_cast<const rvec *>(&x[0]);
+        }
+
+        //! Compares two sets of vectors with a tolerance relative to the largest value
+        static void compareVectors(const std::vector<real> &ref,
+                                   const std::vector<real> &test,
+                                   real                     relTolerance)
+        {
+            real magnitude = 0;
+            for (size_t j = 0; j < ref.size(); j++)
+            {
+                magnitude = std::max(magnitude, std::abs(ref[j]));
+            }
+            gmx::test::FloatingPointTolerance tolerance =
+                gmx::test::relativeToleranceAsFloatingPoint(magnitude, relTolerance);
+            for (size_t j = 0; j < ref.size(); j++)
+            {
+                EXPECT_REAL_EQ_TOL(ref[j], test[j], tolerance)
+                << "atom " << j/DIM << " dimension " << j % DIM;
+            }
+        }
+
+        //! Runs the leap-frog kernel with and without SIMD and compares the results
+        void runUpdateMd(real lg)
+        {
+            std::vector<real> xprimeRef(x_.size(), -1), xprimeSimd(x_.size(), -1);
+            std::vector<real> vRef(v_), vSimd(v_);
+
+            update_md_uniform(c_start, c_numAtoms, c_dt, lg,
+                              asRvecArray(invMassPerDim_), asRvecArray(x_),
+                              asRvecArray(&xprimeRef), asRvecArray(&vRef),
+                              asRvecArray(f_), FALSE);
+            update_md_uniform(c_start, c_numAtoms, c_dt, lg,
+                              asRvecArray(invMassPerDim_), asRvecArray(x_),
+                              asRvecArray(&xprimeSimd), asRvecArray(&vSimd),
+                              asRvecArray(f_), TRUE);
+
+            compareVectors(xprimeRef, xprimeSimd, 1e-6);
+            compareVectors(vRef, vSimd, 1e-6);
+            /* Atoms before start should not be touched */
+            for (int j = 0; j < c_start*DIM; j++)
+            {
+                EXPECT_EQ(-1, xprimeSimd[j]);
+                EXPECT_EQ(v_[j], vSimd[j]);
+            }
+        }
+
+        /*! \brief Runs the SD1 kernel with and without SIMD and compares the results
+         *
+         * With \p bFrictionNoiseOnly the kernel updates xprime in place,
+         * so xprime is initialized with a first half update.
+         */
+        void runUpdateSd1(gmx_bool bFrictionNoiseOnly, const int *gatindex)
+        {
+            const real        em   = 0.95;
+            const real        sigV = 0.7;
+            std::vector<real> xprimeRef(x_), xprimeSimd;
+            std::vector<real> vRef(v_), vSimd;
+
+            if (bFrictionNoiseOnly)
+            {
+                /* The first half without friction and noise, as in the MD code */
+                update_md_uniform(c_start, c_numAtoms, c_dt, 1,
+                                  asRvecArray(invMassPerDim_), asRvecArray(x_),
+                                  asRvecArray(&xprimeRef), asRvecArray(&vRef),
+                                  asRvecArray(f_), FALSE);
+            }
+            xprimeSimd = xprimeRef;
+            vSimd      = vRef;
+
+            update_sd1_uniform(c_start, c_numAtoms, c_dt, em, sigV,
+                               asRvecArray(invMassPerDim_), asRvecArray(x_),
+                               asRvecArray(&xprimeRef), asRvecArray(&vRef),
+                               asRvecArray(f_), bFrictionNoiseOnly,
+                               21, 1993, gatindex, FALSE);
+            update_sd1_uniform(c_start, c_numAtoms, c_dt, em, sigV,
+                               asRvecArray(invMassPerDim_), asRvecArray(x_),
+                               asRvecArray(&xprimeSimd), asRvecArray(&vSimd),
+                               asRvecArray(f_), bFrictionNoiseOnly,
+                               21, 1993, gatindex, TRUE);
+
+            compareVectors(xprimeRef, xprimeSimd, 1e-6);
+            compareVectors(vRef, vSimd, 1e-5);
+        }
+
+        std::vector<real> invMassPerDim_;
+        std::vector<real> x_;
+        std::vector<real> v_;
+        std::vector<real> f_;
+        std::vector<real> massT_;
+        std::vector<int>  gatindex_;
+};
+
+TEST_F(UpdateTest, MdMatchesPlainC)
+{
+    runUpdateMd(0.97);
+}
+
+TEST_F(UpdateTest, Sd1FirstHalfMatchesPlainC)
+{
+    runUpdateMd(1);
+}
+
+TEST_F(UpdateTest, Sd1MatchesPlainC)
+{
+    runUpdateSd1(FALSE, NULL);
+}
+
+TEST_F(UpdateTest, Sd1SecondHalfMatchesPlainC)
+{
+    runUpdateSd1(TRUE, NULL);
+}
+
+TEST_F(UpdateTest, Sd1SecondHalfMatchesPlainCWithGlobalIndices)
+{
+    runUpdateSd1(TRUE, &gatindex_[0]);
+}
+
+TEST_F(UpdateTest, KineticEnergyMatchesPlainC)
+{
+    const rvec u = {0.1, -0.2, 0.05};
+    matrix     ekinRef, ekinSimd;
+    real       maxElement = 0;
+
+    /* The kernels add to the tensor */
+    for (int d = 0; d < DIM; d++)
+    {
+        for (int m = 0; m < DIM; m++)
+        {
+            ekinRef[d][m]  = 1 + d + m;
+            ekinSimd[d][m] = 1 + d + m;
+        }
+    }
+    calc_ke_uniform(c_start, c_numAtoms, asRvecArray(v_), &massT_[0], u,
+                    ekinRef, FALSE);
+    calc_ke_uniform(c_start, c_numAtoms, asRvecArray(v_), &massT_[0], u,
+                    ekinSimd, TRUE);
+
+    for (int d = 0; d < DIM; d++)
+    {
+        for (int m = 0; m < DIM; m++)
+        {
+            maxElement = std::max(maxElement, std::abs(ekinRef[d][m]));
+        }
+    }
+    gmx::test::FloatingPointTolerance tolerance =
+        gmx::test::relativeToleranceAsFloatingPoint(maxElement, 1e-5);
+    for (int d = 0; d < DIM; d++)
+    {
+        for (int m = 0; m < DIM; m++)
+        {
+            EXPECT_REAL_EQ_TOL(ekinRef[d][m], ekinSimd[d][m], tolerance)
+            << "tensor element " << d << " " << m;
+            EXPECT_REAL_EQ_TOL(ekinSimd[d][m], ekinSimd[m][d], tolerance);
+        }
+    }
+}
+
+} // namespace
@@ -0,0 +1,397 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2015, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+#include "gmxpre.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "gromacs/legacyheaders/nrnb.h"
+#include "gromacs/legacyheaders/typedefs.h"
+#include "gromacs/legacyheaders/types/commrec.h"
+#include "gromacs/legacyheaders/types/ifunc.h"
+#include "gromacs/legacyheaders/vsite.h"
+#include "gromacs/math/vec.h"
+#include "gromacs/pbcutil/ishift.h"
+#include "gromacs/random/random.h"
+#include "gromacs/topology/topology.h"
+#include "gromacs/utility/gmxassert.h"
+#include "gromacs/utility/smalloc.h"
+
+#include "testutils/testasserts.h"
+
+#include "simdtestutils.h"
+
+namespace gmx
+{
+namespace test
+{
+namespace
+{
+
+//! Number of vsites, chosen not to be a multiple of the SIMD width
+const int  c_numVsites = 19;
+//! Number of parameter types, chosen so each SIMD batch mixes types
+const int  c_numVsiteTypes = 3;
+//! Distance of the constructing atoms to the first constructing atom
+const real c_bondLength = 0.12;
+//! Time step for computing the vsite velocities
+const real c_dt = 0.002;
+
+/*! \brief Test fixture for comparing the SIMD and plain C vsite kernels
+ *
+ * The test parameter is the vsite function type. Each vsite has its own
+ * constructing atoms, with random positions and orientations, stored
+ * after the vsite atom in the iatom order.
+ */
+class VsiteTest : public ::testing::TestWithParam<int>
+{
+    public:
+        VsiteTest() : ftype_(GetParam()), pbcType_(ePbcTypeNone)
+        {
+            nra_ = interaction_function[ftype_].nratoms;
+            clear_mat(box_);
+        }
+
+        void SetUp()
+        {
+            real a = 0, b = 0, c = 0;
+            switch (ftype_)
+            {
+                case F_VSITE3:
+                    a = 0.3;
+                    b = 0.2;
+                    break;
+                case F_VSITE3FD:
+                    a = 0.4;
+                    b = 0.05;
+                    break;
+                case F_VSITE3OUT:
+                    a = 0.3;
+                    b = 0.3;
+                    c = 1.5;
+                    break;
+                case F_VSITE4FDN:
+                    a = 0.9;
+                    b = 0.8;
+                    c = 0.05;
+                    break;
+                default:
+                    GMX_RELEASE_ASSERT(false, "Vsite type without SIMD kernel");
+            }
+            /* Each type has different parameters, so the SIMD kernels
+             * need to gather the parameters per vsite.
+             */
+            iparams_.resize(c_numVsiteTypes);
+            for (int t = 0; t < c_numVsiteTypes; t++)
+            {
+                iparams_[t].vsite.a = a*(1 + 0.3*t);
+                iparams_[t].vsite.b = b*(1 - 0.2*t);
+                iparams_[t].vsite.c = c*(1 + 0.5*t);
+            }
+
+            for (int i = 0; i < c_numVsites; i++)
+            {
+                iatoms_.push_back(i % c_numVsiteTypes);
+                for (int k = 0; k < nra_; k++)
+                {
+                    iatoms_.push_back(i*nra_ + k);
+                }
+            }
+
+            initTopology();
+            vsiteSimd_ = init_vsite(&mtop_, NULL, TRUE, TRUE);
+            vsiteRef_  = init_vsite(&mtop_, NULL, TRUE, FALSE);
+            GMX_RELEASE_ASSERT(vsiteSimd_ != NULL && vsiteRef_ != NULL,
+                               "The topology should have vsites");
+
+            snew(cr_, 1);
+            init_nrnb(&nrnb_);
+        }
+
+        void TearDown()
+        {
+            freeVsite(vsiteSimd_);
+            freeVsite(vsiteRef_);
+            sfree(cr_);
+        }
+
+        /*! \brief Sets up a topology with a single molecule with all vsites
+         *
+         * Each atom is a charge group, so each vsite uses its own pbc.
+         */
+        void initTopology()
+        {
+            int natoms = c_numVsites*nra_;
+
+            cgIndex_.resize(natoms + 1);
+            for (int a = 0; a <= natoms; a++)
+            {
+                cgIndex_[a] = a;
+            }
+            std::memset(&moltype_, 0, sizeof(moltype_));
+            moltype_.atoms.nr             = natoms;
+            moltype_.cgs.nr               = natoms;
+            moltype_.cgs.index            = &cgIndex_[0];
+            moltype_.ilist[ftype_].nr     = iatoms_.size();
+            moltype_.ilist[ftype_].iatoms = &iatoms_[0];
+
+            std::memset(&molblock_, 0, sizeof(molblock_));
+            molblock_.type       = 0;
+            molblock_.nmol       = 1;
+            molblock_.natoms_mol = natoms;
+
+            std::memset(&mtop_, 0, sizeof(mtop_));
+            mtop_.nmoltype  = 1;
+            mtop_.moltype   = &moltype_;
+            mtop_.nmolblock = 1;
+            mtop_.molblock  = &molblock_;
+            mtop_.natoms    = natoms;
+        }
+
+        //! Frees a serial vsite setup from init_vsite()
+        static void freeVsite(gmx_vsite_t *vsite)
+        {
+            sfree(vsite->tdata);
+            sfree(vsite);
+        }
+
+        //! Generates the coordinates, velocities and forces
+        void generateSystem(PbcType pbcType)
+        {
+            gmx_rng_t rng = gmx_rng_init(4321);
+
+            setTestBox(pbcType, box_);
+
+            x_.resize(c_numVsites*nra_*DIM);
+            v_.resize(c_numVsites*nra_*DIM);
+            f_.resize(c_numVsites*nra_*DIM);
+            for (int i = 0; i < c_numVsites; i++)
+            {
+                rvec *x = asRvecArray(&x_) + i*nra_;
+                rvec  dx;
+
+                /* The first constructing atom and the other constructing
+                 * atoms at a fixed distance in random directions.
+                 * The vsite starts at a random position close by,
+                 * as its old position would be in a simulation.
+                 */
+                randomPositionInBox(rng, box_, x[1]);
+                /* Put one vsite in the first SIMD batch at the corner */
+                if (i == 1)
+                {
+                    clear_rvec(x[1]);
+                }
+                for (int d = 0; d < DIM; d++)
+                {
+                    x[0][d] = x[1][d] + 0.4*c_bondLength*(gmx_rng_uniform_real(rng) - 0.5);
+                }
+                for (int k = 2; k < nra_; k++)
+                {
+                    randomUnitVector(rng, dx);
+                    for (int d = 0; d < DIM; d++)
+                    {
+                        x[k][d] = x[1][d] + c_bondLength*dx[d];
+                    }
+                }
+            }
+            for (size_t j = 0; j < v_.size(); j++)
+            {
+                v_[j] = 2*(gmx_rng_uniform_real(rng) - 0.5);
+                f_[j] = 200*(gmx_rng_uniform_real(rng) - 0.5);
+            }
+            gmx_rng_destroy(rng);
+
+            /* Some vsite groups will be split over periodic images */
+            putAtomsInBox(pbcType, box_, &x_);
+            pbcType_ = pbcType;
+
+            std::memset(&idef_, 0, sizeof(idef_));
+            idef_.iparams           = &iparams_[0];
+            idef_.il[ftype_].nr     = iatoms_.size();
+            idef_.il[ftype_].iatoms = &iatoms_[0];
+        }
+
+        /*! \brief Makes the first batch depend on vsites within the batch
+         *
+         * Vsite 1 is constructed from vsite 0 and vsite 0 from vsite 2,
+         * so the construction and spreading order matters.
+         */
+        void makeBatchDependent()
+        {
+            iatoms_[1*(1 + nra_) + 2] = iatoms_[0*(1 + nra_) + 1];
+            iatoms_[0*(1 + nra_) + 3] = iatoms_[2*(1 + nra_) + 1];
+        }
+
+        //! Returns the PBC type to pass to the vsite code
+        int ePBC() const
+        {
+            return ePBCFromPbcType(pbcType_);
+        }
+
+        //! Constructs the vsites with \p vsite in \p x and \p v
+        void construct(gmx_vsite_t *vsite, std::vector<real> *x, std::vector<real> *v)
+        {
+            construct_vsites(vsite, asRvecArray(x), c_dt, asRvecArray(v),
+                             idef_.iparams, idef_.il, ePBC(), TRUE, NULL, box_);
+        }
+
+        //! Runs the vsite construction with both kernels and compares the results
+        void runConstruct()
+        {
+            std::vector<real> xRef(x_), xSimd(x_);
+            std::vector<real> vRef(v_), vSimd(v_);
+
+            construct(vsiteRef_, &xRef, &vRef);
+            construct(vsiteSimd_, &xSimd, &vSimd);
+
+            compareVectors(xRef, xSimd, maxAbs(xRef), 1e-5);
+            compareVectors(vRef, vSimd, maxAbs(vRef), 1e-4);
+        }
+
+        //! Runs the force spreading with both kernels and compares the results
+        void runSpread()
+        {
+            std::vector<real> x(x_), v(v_);
+            std::vector<real> fRef(f_), fSimd(f_);
+            std::vector<real> fshiftRef(SHIFTS*DIM), fshiftSimd(SHIFTS*DIM);
+
+            /* Spread from constructed vsites, as done in mdrun */
+            construct(vsiteRef_, &x, &v);
+
+            spread_vsite_f(vsiteRef_, asRvecArray(&x), asRvecArray(&fRef),
+                           asRvecArray(&fshiftRef), FALSE, NULL, &nrnb_, &idef_,
+                           ePBC(), TRUE, NULL, box_, cr_);
+            spread_vsite_f(vsiteSimd_, asRvecArray(&x), asRvecArray(&fSimd),
+                           asRvecArray(&fshiftSimd), FALSE, NULL, &nrnb_, &idef_,
+                           ePBC(), TRUE, NULL, box_, cr_);
+
+            compareVectors(fRef, fSimd, maxAbs(f_), 1e-5);
+            compareVectors(fshiftRef, fshiftSimd, maxAbs(f_), 1e-5);
+            if (pbcType_ != ePbcTypeNone)
+            {
+                /* Check that some vsites were split over periodic images */
+                real fshiftNonCentral = 0;
+                for (int j = 0; j < SHIFTS*DIM; j++)
+                {
+                    if (j/DIM != CENTRAL)
+                    {
+                        fshiftNonCentral = std::max(fshiftNonCentral, std::abs(fshiftRef[j]));
+                    }
+                }
+                EXPECT_GT(fshiftNonCentral, 0);
+            }
+        }
+
+        int                    ftype_;
+        int                    nra_;
+        PbcType                pbcType_;
+        matrix                 box_;
+        gmx_vsite_t           *vsiteSimd_;
+        gmx_vsite_t           *vsiteRef_;
+        std::vector<t_iparams> iparams_;
+        std::vector<t_iatom>   iatoms_;
+        std::vector<int>       cgIndex_;
+        gmx_moltype_t          moltype_;
+        gmx_molblock_t         molblock_;
+        gmx_mtop_t             mtop_;
+        t_idef                 idef_;
+        t_commrec             *cr_;
+        t_nrnb                 nrnb_;
+        std::vector<real>      x_;
+        std::vector<real>      v_;
+        std::vector<real>      f_;
+};
+
+TEST_P(VsiteTest, ConstructMatchesPlainCWithoutPbc)
+{
+    generateSystem(ePbcTypeNone);
+    runConstruct();
+}
+
+TEST_P(VsiteTest, ConstructMatchesPlainCWithRectangularPbc)
+{
+    generateSystem(ePbcTypeRectangular);
+    runConstruct();
+}
+
+TEST_P(VsiteTest, ConstructMatchesPlainCWithTriclinicPbc)
+{
+    generateSystem(ePbcTypeTriclinic);
+    runConstruct();
+}
+
+TEST_P(VsiteTest, ConstructMatchesPlainCWithDependentBatch)
+{
+    makeBatchDependent();
+    generateSystem(ePbcTypeTriclinic);
+    runConstruct();
+}
+
+TEST_P(VsiteTest, SpreadMatchesPlainCWithoutPbc)
+{
+    generateSystem(ePbcTypeNone);
+    runSpread();
+}
+
+TEST_P(VsiteTest, SpreadMatchesPlainCWithRectangularPbc)
+{
+    generateSystem(ePbcTypeRectangular);
+    runSpread();
+}
+
+TEST_P(VsiteTest, SpreadMatchesPlainCWithTriclinicPbc)
+{
+    generateSystem(ePbcTypeTriclinic);
+    runSpread();
+}
+
+TEST_P(VsiteTest, SpreadMatchesPlainCWithDependentBatch)
+{
+    makeBatchDependent();
+    generateSystem(ePbcTypeTriclinic);
+    runSpread();
+}
+
+INSTANTIATE_TEST_CASE_P(SimdVsiteTypes,
+                        VsiteTest, ::testing::Values(F_VSITE3, F_VSITE3FD,
+                                                     F_VSITE3OUT, F_VSITE4FDN));
+
+} // namespace
+} // namespace test
+} // namespace gmx
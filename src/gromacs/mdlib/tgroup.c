@@ -40,6 +40,7 @@
 #include "gromacs/legacyheaders/tgroup.h"
 
 #include <math.h>
+#include <stdlib.h>
 
 #include "gromacs/legacyheaders/gmx_omp_nthreads.h"
 #include "gromacs/legacyheaders/macros.h"
@@ -107,6 +108,8 @@ void init_ekindata(FILE gmx_unused *log, gmx_mtop_t *mtop, t_grpopts *opts,
      */
     ekind->bNEMD = (opts->ngacc > 1 || norm(opts->acc[0]) > 0);
 
+    ekind->bUseSimd = (getenv("GMX_DISABLE_SIMD_KERNELS") == NULL);
+
     ekind->ngtc = opts->ngtc;
     snew(ekind->tcstat, opts->ngtc);
     init_grptcstat(opts->ngtc, ekind->tcstat);
@@ -40,6 +40,7 @@
 
 #include <math.h>
 #include <stdio.h>
+#include <stdlib.h>
 
 #include <algorithm>
 
@@ -63,11 +64,15 @@
 #include "gromacs/pbcutil/pbc.h"
 #include "gromacs/pulling/pull.h"
 #include "gromacs/random/random.h"
+#include "gromacs/simd/simd.h"
+#include "gromacs/simd/simd_math.h"
 #include "gromacs/timing/wallcycle.h"
 #include "gromacs/utility/futil.h"
 #include "gromacs/utility/gmxomp.h"
 #include "gromacs/utility/smalloc.h"
 
+#include "update_internal.h"
+
 /*For debugging, start at v(-dt/2) for velolcity verlet -- uncomment next line */
 /*#define STARTFROMDT2*/
 
@@ -104,6 +109,8 @@ typedef struct {
 typedef struct gmx_update
 {
     gmx_stochd_t *sd;
+    /* Use SIMD kernels for the uniform update cases */
+    gmx_bool      bUseSimd;
     /* xprime for constraint algorithms */
     rvec         *xp;
     int           xp_nalloc;
@@ -114,17 +121,78 @@ typedef struct gmx_update
 } t_gmx_update;
 
 
+void update_md_uniform(int start, int nrend, real dt, real lg,
+                       const rvec invMassPerDim[],
+                       const rvec x[], rvec xprime[], rvec v[],
+                       const rvec f[], gmx_bool bUseSimd)
+{
+    /* The x, y and z components of all atoms are processed as flat arrays */
+    const real     *im  = invMassPerDim[0];
+    const real     *xr  = x[0];
+    real           *xpr = xprime[0];
+    real           *vr  = v[0];
+    const real     *fr  = f[0];
+    int             i, iend;
+
+    i    = start*DIM;
+    iend = nrend*DIM;
+#ifdef GMX_SIMD_HAVE_REAL
+    if (bUseSimd)
+    {
+        gmx_simd_real_t dt_S, lg_S, v_S;
+
+        dt_S = gmx_simd_set1_r(dt);
+        lg_S = gmx_simd_set1_r(lg);
+
+        for (; i + GMX_SIMD_REAL_WIDTH <= iend; i += GMX_SIMD_REAL_WIDTH)
+        {
+            v_S = gmx_simd_mul_r(lg_S, gmx_simd_loadu_r(vr + i));
+            v_S = gmx_simd_fmadd_r(gmx_simd_mul_r(gmx_simd_loadu_r(fr + i),
+                                                  gmx_simd_loadu_r(im + i)),
+                                   dt_S, v_S);
+            gmx_simd_storeu_r(vr + i, v_S);
+            gmx_simd_storeu_r(xpr + i, gmx_simd_fmadd_r(v_S, dt_S, gmx_simd_loadu_r(xr + i)));
+        }
+#ifdef GMX_SIMD_HAVE_LOADN
+        /* Handle the remaining less than a SIMD width of elements with
+         * masked loads and stores, which do not touch memory beyond iend.
+         */
+        if (i < iend)
+        {
+            int n = iend - i;
+
+            v_S = gmx_simd_mul_r(lg_S, gmx_simd_loadn_r(vr + i, n));
+            v_S = gmx_simd_fmadd_r(gmx_simd_mul_r(gmx_simd_loadn_r(fr + i, n),
+                                                  gmx_simd_loadn_r(im + i, n)),
+                                   dt_S, v_S);
+            gmx_simd_storen_r(vr + i, v_S, n);
+            gmx_simd_storen_r(xpr + i, gmx_simd_fmadd_r(v_S, dt_S, gmx_simd_loadn_r(xr + i, n)), n);
+            i = iend;
+        }
+#endif
+    }
+#endif
+    for (; i < iend; i++)
+    {
+        real vn = lg*vr[i] + fr[i]*im[i]*dt;
+
+        vr[i]  = vn;
+        xpr[i] = xr[i] + vn*dt;
+    }
+}
+
 static void do_update_md(int start, int nrend, double dt,
                          t_grp_tcstat *tcstat,
                          double nh_vxi[],
                          gmx_bool bNEMD, t_grp_acc *gstat, rvec accel[],
                          ivec nFreeze[],
-                         real invmass[],
+                         real invmass[], rvec invMassPerDim[],
+                         gmx_bool bVsitesOrShells,
                          unsigned short ptype[], unsigned short cFREEZE[],
                          unsigned short cACC[], unsigned short cTC[],
                          rvec x[], rvec xprime[], rvec v[],
                          rvec f[], matrix M,
-                         gmx_bool bNH, gmx_bool bPR)
+                         gmx_bool bNH, gmx_bool bPR, gmx_bool bUseSimd)
 {
     double imass, w_dt;
     int    gf = 0, ga = 0, gt = 0;
@@ -225,6 +293,14 @@ static void do_update_md(int start, int nrend, double dt,
             }
         }
     }
+    else if (cTC == NULL && !bVsitesOrShells)
+    {
+        /* Plain update with Berendsen/v-rescale coupling
+         * of a single T-coupling group.
+         */
+        update_md_uniform(start, nrend, dt, tcstat[0].lambda,
+                          invMassPerDim, x, xprime, v, f, bUseSimd);
+    }
     else
     {
         /* Plain update with Berendsen/v-rescale coupling */
@@ -561,23 +637,128 @@ gmx_update_t init_update(t_inputrec *ir)
         upd->sd    = init_stochd(ir);
     }
 
+    upd->bUseSimd  = (getenv("GMX_DISABLE_SIMD_KERNELS") == NULL);
+
     upd->xp        = NULL;
     upd->xp_nalloc = 0;
 
     return upd;
 }
 
+void update_sd1_uniform(int start, int nrend, real dt,
+                        real em, real sigV,
+                        const rvec invMassPerDim[],
+                        const rvec x[], rvec xprime[], rvec v[],
+                        const rvec f[],
+                        gmx_bool bFrictionNoiseOnly,
+                        gmx_int64_t step, int seed, const int *gatindex,
+                        gmx_bool bUseSimd)
+{
+    const real     *im  = invMassPerDim[0];
+    const real     *xr  = x[0];
+    real           *xpr = xprime[0];
+    real           *vr  = v[0];
+    const real     *fr  = f[0];
+    int             n, d, i;
+    real            rnd[DIM], sd_V, vn, vnew;
+
+    n = start;
+#ifdef GMX_SIMD_HAVE_REAL
+    if (bUseSimd)
+    {
+        real            rnd_array[DIM*GMX_SIMD_REAL_WIDTH + GMX_SIMD_REAL_WIDTH], *rnd_S;
+        int             s;
+        gmx_simd_real_t dt_S, halfdt_S, em_S, sigV_S;
+        gmx_simd_real_t im_S, sdV_S, vn_S, v_S;
+
+        rnd_S    = gmx_simd_align_r(rnd_array);
+
+        dt_S     = gmx_simd_set1_r(dt);
+        halfdt_S = gmx_simd_set1_r(0.5*dt);
+        em_S     = gmx_simd_set1_r(em);
+        sigV_S   = gmx_simd_set1_r(sigV);
+
+        /* Process blocks of SIMD width atoms, i.e. DIM SIMD registers */
+        for (; n + GMX_SIMD_REAL_WIDTH <= nrend; n += GMX_SIMD_REAL_WIDTH)
+        {
+            for (s = 0; s < GMX_SIMD_REAL_WIDTH; s++)
+            {
+                gmx_rng_cycle_3gaussian_table(step, gatindex ? gatindex[n + s] : n + s,
+                                              seed, RND_SEED_UPDATE, rnd_S + s*DIM);
+            }
+
+            for (d = 0; d < DIM; d++)
+            {
+                i     = n*DIM + d*GMX_SIMD_REAL_WIDTH;
+                im_S  = gmx_simd_loadu_r(im + i);
+                sdV_S = gmx_simd_mul_r(gmx_simd_mul_r(gmx_simd_sqrt_r(im_S), sigV_S),
+                                       gmx_simd_load_r(rnd_S + d*GMX_SIMD_REAL_WIDTH));
+                vn_S  = gmx_simd_loadu_r(vr + i);
+                if (bFrictionNoiseOnly)
+                {
+                    v_S = gmx_simd_fmadd_r(vn_S, em_S, sdV_S);
+                    /* Add the friction and noise contribution only */
+                    gmx_simd_storeu_r(xpr + i,
+                                      gmx_simd_fmadd_r(gmx_simd_sub_r(v_S, vn_S), halfdt_S,
+                                                       gmx_simd_loadu_r(xpr + i)));
+                }
+                else
+                {
+                    vn_S = gmx_simd_fmadd_r(gmx_simd_mul_r(im_S, gmx_simd_loadu_r(fr + i)),
+                                            dt_S, vn_S);
+                    v_S  = gmx_simd_fmadd_r(vn_S, em_S, sdV_S);
+                    /* Here we include half of the friction+noise
+                     * update of v into the integration of x.
+                     */
+                    gmx_simd_storeu_r(xpr + i,
+                                      gmx_simd_fmadd_r(gmx_simd_add_r(vn_S, v_S), halfdt_S,
+                                                       gmx_simd_loadu_r(xr + i)));
+                }
+                gmx_simd_storeu_r(vr + i, v_S);
+            }
+        }
+    }
+#endif
+
+    for (; n < nrend; n++)
+    {
+        gmx_rng_cycle_3gaussian_table(step, gatindex ? gatindex[n] : n,
+                                      seed, RND_SEED_UPDATE, rnd);
+
+        for (d = 0; d < DIM; d++)
+        {
+            i    = n*DIM + d;
+            sd_V = sqrt(im[i])*sigV*rnd[d];
+            vn   = vr[i];
+            if (bFrictionNoiseOnly)
+            {
+                vnew    = vn*em + sd_V;
+                xpr[i] += 0.5*(vnew - vn)*dt;
+            }
+            else
+            {
+                vn     = vn + im[i]*fr[i]*dt;
+                vnew   = vn*em + sd_V;
+                xpr[i] = xr[i] + 0.5*(vn + vnew)*dt;
+            }
+            vr[i] = vnew;
+        }
+    }
+}
+
 static void do_update_sd1(gmx_stochd_t *sd,
                           int start, int nrend, double dt,
                           rvec accel[], ivec nFreeze[],
-                          real invmass[], unsigned short ptype[],
+                          real invmass[], rvec invMassPerDim[],
+                          gmx_bool bVsitesOrShells, unsigned short ptype[],
                           unsigned short cFREEZE[], unsigned short cACC[],
                           unsigned short cTC[],
                           rvec x[], rvec xprime[], rvec v[], rvec f[],
                           int ngtc, real ref_t[],
                           gmx_bool bDoConstr,
                           gmx_bool bFirstHalfConstr,
-                          gmx_int64_t step, int seed, int* gatindex)
+                          gmx_int64_t step, int seed, int* gatindex,
+                          gmx_bool bUseSimd)
 {
     gmx_sd_const_t *sdc;
     gmx_sd_sigma_t *sig;
@@ -596,6 +777,26 @@ static void do_update_sd1(gmx_stochd_t *sd,
         sig[n].V  = sqrt(kT*(1 - sdc[n].em*sdc[n].em));
     }
 
+    if (cFREEZE == NULL && cACC == NULL && cTC == NULL && !bVsitesOrShells &&
+        !nFreeze[0][XX] && !nFreeze[0][YY] && !nFreeze[0][ZZ] &&
+        norm2(accel[0]) == 0)
+    {
+        if (bDoConstr && bFirstHalfConstr)
+        {
+            /* First update without friction and noise */
+            update_md_uniform(start, nrend, dt, 1,
+                              invMassPerDim, x, xprime, v, f, bUseSimd);
+        }
+        else
+        {
+            update_sd1_uniform(start, nrend, dt, sdc[0].em, sig[0].V,
+                               invMassPerDim, x, xprime, v, f,
+                               bDoConstr, step, seed, gatindex, bUseSimd);
+        }
+
+        return;
+    }
+
     if (!bDoConstr)
     {
         for (n = start; n < nrend; n++)
@@ -953,6 +1154,93 @@ static void dump_it_all(FILE gmx_unused *fp, const char gmx_unused *title,
 #endif
 }
 
+void calc_ke_uniform(int start, int end, const rvec v[],
+                     const real massT[], const rvec u, matrix ekin,
+                     gmx_bool bUseSimd)
+{
+    int  n, d, m;
+    rvec v_corrt;
+    real hm;
+
+    n = start;
+#ifdef GMX_SIMD_HAVE_REAL
+    if (bUseSimd)
+    {
+        real            buf_array[DIM*GMX_SIMD_REAL_WIDTH + GMX_SIMD_REAL_WIDTH], *buf;
+        int             s;
+        real            e;
+        gmx_simd_real_t half_S, hm_S, hmv_S;
+        gmx_simd_real_t u_S[DIM], v_S[DIM], ekin_S[DIM][DIM];
+
+        buf    = gmx_simd_align_r(buf_array);
+        half_S = gmx_simd_set1_r(0.5);
+        for (d = 0; d < DIM; d++)
+        {
+            u_S[d] = gmx_simd_set1_r(u[d]);
+            for (m = d; m < DIM; m++)
+            {
+                ekin_S[d][m] = gmx_simd_setzero_r();
+            }
+        }
+
+        for (; n + GMX_SIMD_REAL_WIDTH <= end; n += GMX_SIMD_REAL_WIDTH)
+        {
+            for (s = 0; s < GMX_SIMD_REAL_WIDTH; s++)
+            {
+                for (d = 0; d < DIM; d++)
+                {
+                    buf[d*GMX_SIMD_REAL_WIDTH + s] = v[n + s][d];
+                }
+            }
+            hm_S = gmx_simd_mul_r(half_S, gmx_simd_loadu_r(massT + n));
+            for (d = 0; d < DIM; d++)
+            {
+                v_S[d] = gmx_simd_sub_r(gmx_simd_load_r(buf + d*GMX_SIMD_REAL_WIDTH), u_S[d]);
+            }
+            /* The tensor is symmetric, we only compute the upper half */
+            for (d = 0; d < DIM; d++)
+            {
+                hmv_S = gmx_simd_mul_r(hm_S, v_S[d]);
+                for (m = d; m < DIM; m++)
+                {
+                    ekin_S[d][m] = gmx_simd_fmadd_r(hmv_S, v_S[m], ekin_S[d][m]);
+                }
+            }
+        }
+
+        for (d = 0; d < DIM; d++)
+        {
+            for (m = d; m < DIM; m++)
+            {
+                e           = gmx_simd_reduce_r(ekin_S[d][m]);
+                ekin[d][m] += e;
+                if (m != d)
+                {
+                    ekin[m][d] += e;
+                }
+            }
+        }
+    }
+#endif
+
+    for (; n < end; n++)
+    {
+        hm   = 0.5*massT[n];
+
+        for (d = 0; (d < DIM); d++)
+        {
+            v_corrt[d]  = v[n][d]  - u[d];
+        }
+        for (d = 0; (d < DIM); d++)
+        {
+            for (m = 0; (m < DIM); m++)
+            {
+                ekin[m][d] += hm*v_corrt[m]*v_corrt[d];
+            }
+        }
+    }
+}
+
 static void calc_ke_part_normal(rvec v[], t_grpopts *opts, t_mdatoms *md,
                                 gmx_ekindata_t *ekind, t_nrnb *nrnb, gmx_bool bEkinAveVel,
                                 gmx_bool bSaveEkinOld)
@@ -1022,6 +1310,12 @@ static void calc_ke_part_normal(rvec v[], t_grpopts *opts, t_mdatoms *md,
 
         ga = 0;
         gt = 0;
+        if (md->cACC == NULL && md->cTC == NULL && md->nMassPerturbed == 0)
+        {
+            calc_ke_uniform(start_t, end_t, v, md->massT,
+                            grpstat[0].u, ekin_sum[0], ekind->bUseSimd);
+            continue;
+        }
         for (n = start_t; n < end_t; n++)
         {
             if (md->cACC)
@@ -1667,13 +1961,15 @@ void update_constraints(FILE             *fplog,
             do_update_sd1(upd->sd,
                           start_th, end_th, dt,
                           inputrec->opts.acc, inputrec->opts.nFreeze,
-                          md->invmass, md->ptype,
+                          md->invmass, md->invMassPerDim,
+                          md->bVsitesOrShells, md->ptype,
                           md->cFREEZE, md->cACC, md->cTC,
                           state->x, xprime, state->v, force,
                           inputrec->opts.ngtc, inputrec->opts.ref_t,
                           bDoConstr, FALSE,
                           step, inputrec->ld_seed,
-                          DOMAINDECOMP(cr) ? cr->dd->gatindex : NULL);
+                          DOMAINDECOMP(cr) ? cr->dd->gatindex : NULL,
+                          upd->bUseSimd);
         }
         inc_nrnb(nrnb, eNR_UPDATE, homenr);
         wallcycle_stop(wcycle, ewcUPDATE);
@@ -1987,10 +2283,11 @@ void update_coords(FILE             *fplog,
                                  ekind->tcstat, state->nosehoover_vxi,
                                  ekind->bNEMD, ekind->grpstat, inputrec->opts.acc,
                                  inputrec->opts.nFreeze,
-                                 md->invmass, md->ptype,
+                                 md->invmass, md->invMassPerDim,
+                                 md->bVsitesOrShells, md->ptype,
                                  md->cFREEZE, md->cACC, md->cTC,
                                  state->x, xprime, state->v, force, M,
-                                 bNH, bPR);
+                                 bNH, bPR, upd->bUseSimd);
                 }
                 else
                 {
@@ -2009,12 +2306,14 @@ void update_coords(FILE             *fplog,
                 do_update_sd1(upd->sd,
                               start_th, end_th, dt,
                               inputrec->opts.acc, inputrec->opts.nFreeze,
-                              md->invmass, md->ptype,
+                              md->invmass, md->invMassPerDim,
+                              md->bVsitesOrShells, md->ptype,
                               md->cFREEZE, md->cACC, md->cTC,
                               state->x, xprime, state->v, force,
                               inputrec->opts.ngtc, inputrec->opts.ref_t,
                               bDoConstr, TRUE,
-                              step, inputrec->ld_seed, DOMAINDECOMP(cr) ? cr->dd->gatindex : NULL);
+                              step, inputrec->ld_seed, DOMAINDECOMP(cr) ? cr->dd->gatindex : NULL,
+                              upd->bUseSimd);
                 break;
             case (eiSD2):
                 /* The SD2 update is always done in 2 parts,
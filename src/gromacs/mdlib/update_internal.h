@@ -0,0 +1,83 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2015, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+#ifndef GMX_MDLIB_UPDATE_INTERNAL_H
+#define GMX_MDLIB_UPDATE_INTERNAL_H
+
+#include "gromacs/math/vectypes.h"
+#include "gromacs/utility/basedefinitions.h"
+#include "gromacs/utility/real.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* The update and kinetic energy kernels for systems with a single
+ * T-coupling group, no acceleration, no freeze groups and no virtual sites
+ * or shells. With bUseSimd the atoms are processed in SIMD blocks when
+ * SIMD is supported, the remaining atoms are always processed with plain C.
+ * These are only exported for testing.
+ */
+
+void update_md_uniform(int start, int nrend, real dt, real lg,
+                       const rvec invMassPerDim[],
+                       const rvec x[], rvec xprime[], rvec v[],
+                       const rvec f[], gmx_bool bUseSimd);
+/* Leap-frog update of atoms start to nrend with velocity scaling factor lg */
+
+void update_sd1_uniform(int start, int nrend, real dt,
+                        real em, real sigV,
+                        const rvec invMassPerDim[],
+                        const rvec x[], rvec xprime[], rvec v[],
+                        const rvec f[],
+                        gmx_bool bFrictionNoiseOnly,
+                        gmx_int64_t step, int seed, const int *gatindex,
+                        gmx_bool bUseSimd);
+/* SD1 update of atoms start to nrend. With bFrictionNoiseOnly only
+ * the friction and noise are applied, this is the second half
+ * of the SD1 update with constraints.
+ */
+
+void calc_ke_uniform(int start, int end, const rvec v[],
+                     const real massT[], const rvec u, matrix ekin,
+                     gmx_bool bUseSimd);
+/* Adds the kinetic energy tensor of atoms start to end, with velocities
+ * relative to u, to ekin.
+ */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
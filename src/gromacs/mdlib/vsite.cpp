@@ -52,7 +52,11 @@
 #include "gromacs/math/vec.h"
 #include "gromacs/pbcutil/ishift.h"
 #include "gromacs/pbcutil/mshift.h"
+#include "gromacs/pbcutil/pbc-simd.h"
 #include "gromacs/pbcutil/pbc.h"
+#include "gromacs/simd/simd.h"
+#include "gromacs/simd/simd_math.h"
+#include "gromacs/simd/vector_operations.h"
 #include "gromacs/topology/mtop_util.h"
 #include "gromacs/utility/gmxomp.h"
 #include "gromacs/utility/smalloc.h"
@@ -309,6 +313,204 @@ static int constr_vsiten(t_iatom *ia, t_iparams ip[],
 }
 
 
+#ifdef GMX_SIMD_HAVE_REAL
+
+/* Returns whether vsites of type ftype have a SIMD construction and
+ * spreading kernel.
+ */
+static gmx_bool vsite_type_has_simd(int ftype)
+{
+    return (ftype == F_VSITE3 || ftype == F_VSITE3FD ||
+            ftype == F_VSITE3OUT || ftype == F_VSITE4FDN);
+}
+
+/* Returns whether none of the GMX_SIMD_REAL_WIDTH vsites starting at ia
+ * is a constructing atom of another vsite in this batch, in which case
+ * the batch can be processed in one go.
+ */
+static gmx_bool vsite_batch_is_independent(const t_iatom *ia, int inc)
+{
+    int s, t, k;
+
+    for (s = 0; s < GMX_SIMD_REAL_WIDTH; s++)
+    {
+        for (t = 0; t < GMX_SIMD_REAL_WIDTH; t++)
+        {
+            for (k = 2; k < inc; k++)
+            {
+                if (ia[t*inc + k] == ia[s*inc + 1])
+                {
+                    return FALSE;
+                }
+            }
+        }
+    }
+
+    return TRUE;
+}
+
+/* Loads the vsite parameters a, b and c of the batch starting at ia */
+static gmx_inline void
+load_vsite_params_simd(const t_iatom *ia, int inc, const t_iparams ip[],
+                       real *buf,
+                       gmx_simd_real_t *a_S, gmx_simd_real_t *b_S,
+                       gmx_simd_real_t *c_S)
+{
+    int s;
+
+    for (s = 0; s < GMX_SIMD_REAL_WIDTH; s++)
+    {
+        buf[                      s] = ip[ia[s*inc]].vsite.a;
+        buf[  GMX_SIMD_REAL_WIDTH + s] = ip[ia[s*inc]].vsite.b;
+        buf[2*GMX_SIMD_REAL_WIDTH + s] = ip[ia[s*inc]].vsite.c;
+    }
+    *a_S = gmx_simd_load_r(buf);
+    *b_S = gmx_simd_load_r(buf + GMX_SIMD_REAL_WIDTH);
+    *c_S = gmx_simd_load_r(buf + 2*GMX_SIMD_REAL_WIDTH);
+}
+
+/* Loads the distance vectors x[ia[o1]] - x[ia[o0]] of the batch starting
+ * at ia, corrected for PBC when pbc_simd!=NULL. When shift!=NULL,
+ * the shift vectors are stored in shift, x, y and z components consecutively.
+ */
+static gmx_inline void
+load_vsite_dx_simd(const t_iatom *ia, int inc, int o1, int o0,
+                   const rvec x[], const pbc_simd_t *pbc_simd,
+                   real *buf, real *shift,
+                   gmx_simd_real_t *dx_S, gmx_simd_real_t *dy_S,
+                   gmx_simd_real_t *dz_S)
+{
+    gmx_simd_real_t sx_S, sy_S, sz_S;
+    int             s, d;
+
+    for (s = 0; s < GMX_SIMD_REAL_WIDTH; s++)
+    {
+        for (d = 0; d < DIM; d++)
+        {
+            buf[d*GMX_SIMD_REAL_WIDTH + s] =
+                x[ia[s*inc + o1]][d] - x[ia[s*inc + o0]][d];
+        }
+    }
+    *dx_S = gmx_simd_load_r(buf);
+    *dy_S = gmx_simd_load_r(buf + GMX_SIMD_REAL_WIDTH);
+    *dz_S = gmx_simd_load_r(buf + 2*GMX_SIMD_REAL_WIDTH);
+
+    if (shift != NULL)
+    {
+        pbc_dx_shift_simd(dx_S, dy_S, dz_S, &sx_S, &sy_S, &sz_S, pbc_simd);
+        gmx_simd_store_r(shift, sx_S);
+        gmx_simd_store_r(shift + GMX_SIMD_REAL_WIDTH, sy_S);
+        gmx_simd_store_r(shift + 2*GMX_SIMD_REAL_WIDTH, sz_S);
+    }
+    else if (pbc_simd != NULL)
+    {
+        pbc_dx_simd(dx_S, dy_S, dz_S, pbc_simd);
+    }
+}
+
+/* Constructs the GMX_SIMD_REAL_WIDTH vsites of type ftype starting at ia.
+ * As with bPBCAll in construct_vsites_thread, each vsite is put
+ * in the periodic image closest to its old position.
+ */
+static void constr_vsite_batch_simd(int ftype, const t_iatom *ia,
+                                    const t_iparams ip[],
+                                    rvec x[], rvec *v, real inv_dt,
+                                    const pbc_simd_t *pbc_simd)
+{
+    real            buf_array[3*GMX_SIMD_REAL_WIDTH + GMX_SIMD_REAL_WIDTH], *buf;
+    int             inc, s, d, av;
+    gmx_simd_real_t a_S, b_S, c_S, w_S;
+    gmx_simd_real_t xij_S, yij_S, zij_S;
+    gmx_simd_real_t xik_S, yik_S, zik_S;
+    gmx_simd_real_t xil_S, yil_S, zil_S;
+    gmx_simd_real_t tx_S, ty_S, tz_S;
+    gmx_simd_real_t dx_S, dy_S, dz_S;
+
+    buf = gmx_simd_align_r(buf_array);
+    inc = 1 + interaction_function[ftype].nratoms;
+
+    load_vsite_params_simd(ia, inc, ip, buf, &a_S, &b_S, &c_S);
+
+    /* Compute the displacement d from constructing atom i to the vsite */
+    switch (ftype)
+    {
+        case F_VSITE3:
+            load_vsite_dx_simd(ia, inc, 3, 2, x, pbc_simd, buf, NULL, &xij_S, &yij_S, &zij_S);
+            load_vsite_dx_simd(ia, inc, 4, 2, x, pbc_simd, buf, NULL, &xik_S, &yik_S, &zik_S);
+            dx_S = gmx_simd_fmadd_r(b_S, xik_S, gmx_simd_mul_r(a_S, xij_S));
+            dy_S = gmx_simd_fmadd_r(b_S, yik_S, gmx_simd_mul_r(a_S, yij_S));
+            dz_S = gmx_simd_fmadd_r(b_S, zik_S, gmx_simd_mul_r(a_S, zij_S));
+            break;
+        case F_VSITE3FD:
+            /* Here xik is the j-k vector and t goes from i to a point on the line jk */
+            load_vsite_dx_simd(ia, inc, 3, 2, x, pbc_simd, buf, NULL, &xij_S, &yij_S, &zij_S);
+            load_vsite_dx_simd(ia, inc, 4, 3, x, pbc_simd, buf, NULL, &xik_S, &yik_S, &zik_S);
+            tx_S = gmx_simd_fmadd_r(a_S, xik_S, xij_S);
+            ty_S = gmx_simd_fmadd_r(a_S, yik_S, yij_S);
+            tz_S = gmx_simd_fmadd_r(a_S, zik_S, zij_S);
+            w_S  = gmx_simd_mul_r(b_S, gmx_simd_invsqrt_r(gmx_simd_norm2_r(tx_S, ty_S, tz_S)));
+            dx_S = gmx_simd_mul_r(w_S, tx_S);
+            dy_S = gmx_simd_mul_r(w_S, ty_S);
+            dz_S = gmx_simd_mul_r(w_S, tz_S);
+            break;
+        case F_VSITE3OUT:
+            load_vsite_dx_simd(ia, inc, 3, 2, x, pbc_simd, buf, NULL, &xij_S, &yij_S, &zij_S);
+            load_vsite_dx_simd(ia, inc, 4, 2, x, pbc_simd, buf, NULL, &xik_S, &yik_S, &zik_S);
+            gmx_simd_cprod_r(xij_S, yij_S, zij_S, xik_S, yik_S, zik_S, &tx_S, &ty_S, &tz_S);
+            dx_S = gmx_simd_fmadd_r(c_S, tx_S, gmx_simd_fmadd_r(b_S, xik_S, gmx_simd_mul_r(a_S, xij_S)));
+            dy_S = gmx_simd_fmadd_r(c_S, ty_S, gmx_simd_fmadd_r(b_S, yik_S, gmx_simd_mul_r(a_S, yij_S)));
+            dz_S = gmx_simd_fmadd_r(c_S, tz_S, gmx_simd_fmadd_r(b_S, zik_S, gmx_simd_mul_r(a_S, zij_S)));
+            break;
+        case F_VSITE4FDN:
+            load_vsite_dx_simd(ia, inc, 3, 2, x, pbc_simd, buf, NULL, &xij_S, &yij_S, &zij_S);
+            load_vsite_dx_simd(ia, inc, 4, 2, x, pbc_simd, buf, NULL, &xik_S, &yik_S, &zik_S);
+            load_vsite_dx_simd(ia, inc, 5, 2, x, pbc_simd, buf, NULL, &xil_S, &yil_S, &zil_S);
+            /* Store rja in ik and rjb in il, t is rm */
+            xik_S = gmx_simd_fmsub_r(a_S, xik_S, xij_S);
+            yik_S = gmx_simd_fmsub_r(a_S, yik_S, yij_S);
+            zik_S = gmx_simd_fmsub_r(a_S, zik_S, zij_S);
+            xil_S = gmx_simd_fmsub_r(b_S, xil_S, xij_S);
+            yil_S = gmx_simd_fmsub_r(b_S, yil_S, yij_S);
+            zil_S = gmx_simd_fmsub_r(b_S, zil_S, zij_S);
+            gmx_simd_cprod_r(xik_S, yik_S, zik_S, xil_S, yil_S, zil_S, &tx_S, &ty_S, &tz_S);
+            w_S  = gmx_simd_mul_r(c_S, gmx_simd_invsqrt_r(gmx_simd_norm2_r(tx_S, ty_S, tz_S)));
+            dx_S = gmx_simd_mul_r(w_S, tx_S);
+            dy_S = gmx_simd_mul_r(w_S, ty_S);
+            dz_S = gmx_simd_mul_r(w_S, tz_S);
+            break;
+        default:
+            gmx_fatal(FARGS, "No SIMD kernel for vsite type %d in %s, line %d",
+                      ftype, __FILE__, __LINE__);
+    }
+
+    /* Add the vector from the old vsite position to atom i,
+     * the result, corrected for PBC, is the vsite displacement.
+     */
+    load_vsite_dx_simd(ia, inc, 2, 1, x, NULL, buf, NULL, &tx_S, &ty_S, &tz_S);
+    dx_S = gmx_simd_add_r(dx_S, tx_S);
+    dy_S = gmx_simd_add_r(dy_S, ty_S);
+    dz_S = gmx_simd_add_r(dz_S, tz_S);
+    pbc_dx_simd(&dx_S, &dy_S, &dz_S, pbc_simd);
+    gmx_simd_store_r(buf, dx_S);
+    gmx_simd_store_r(buf + GMX_SIMD_REAL_WIDTH, dy_S);
+    gmx_simd_store_r(buf + 2*GMX_SIMD_REAL_WIDTH, dz_S);
+
+    for (s = 0; s < GMX_SIMD_REAL_WIDTH; s++)
+    {
+        av = ia[s*inc + 1];
+        for (d = 0; d < DIM; d++)
+        {
+            x[av][d] += buf[d*GMX_SIMD_REAL_WIDTH + s];
+            if (v != NULL)
+            {
+                v[av][d] = buf[d*GMX_SIMD_REAL_WIDTH + s]*inv_dt;
+            }
+        }
+    }
+}
+
+#endif /* GMX_SIMD_HAVE_REAL */
+
 void construct_vsites_thread(gmx_vsite_t *vsite,
                              rvec x[],
                              real dt, rvec *v,
@@ -323,6 +525,10 @@ void construct_vsites_thread(gmx_vsite_t *vsite,
     t_iatom   *ia;
     t_pbc     *pbc_null2;
     int       *vsite_pbc, ishift;
+#ifdef GMX_SIMD_HAVE_REAL
+    gmx_bool   bSimd;
+    pbc_simd_t pbc_simd;
+#endif
 
     if (v != NULL)
     {
@@ -335,6 +541,14 @@ void construct_vsites_thread(gmx_vsite_t *vsite,
 
     bPBCAll = (pbc_null != NULL && !vsite->bHaveChargeGroups);
 
+#ifdef GMX_SIMD_HAVE_REAL
+    /* The SIMD kernels do not support charge groups and screw PBC */
+    bSimd = (vsite->bUseSimd &&
+             (pbc_null == NULL ||
+              (bPBCAll && pbc_null->ePBC != epbcSCREW)));
+    set_pbc_simd(pbc_null, &pbc_simd);
+#endif
+
     pbc_null2 = NULL;
     vsite_pbc = NULL;
     for (ftype = 0; (ftype < F_NRE); ftype++)
@@ -358,6 +572,18 @@ void construct_vsites_thread(gmx_vsite_t *vsite,
 
             for (i = 0; i < nr; )
             {
+#ifdef GMX_SIMD_HAVE_REAL
+                if (bSimd && vsite_type_has_simd(ftype) &&
+                    i + GMX_SIMD_REAL_WIDTH*inc <= nr &&
+                    vsite_batch_is_independent(ia, inc))
+                {
+                    constr_vsite_batch_simd(ftype, ia, ip, x, v, inv_dt, &pbc_simd);
+
+                    i  += GMX_SIMD_REAL_WIDTH*inc;
+                    ia += GMX_SIMD_REAL_WIDTH*inc;
+                    continue;
+                }
+#endif
                 tp   = ia[0];
 
                 /* The vsite and constructing atoms */
@@ -1303,6 +1529,263 @@ static int vsite_count(const t_ilist *ilist, int ftype)
     }
 }
 
+#ifdef GMX_SIMD_HAVE_REAL
+
+/* Returns the shift index for SIMD lane s from a shift buffer */
+static gmx_inline int vsite_shift_index(const real *shift, int s)
+{
+    return XYZ2IS((int)shift[s],
+                  (int)shift[GMX_SIMD_REAL_WIDTH + s],
+                  (int)shift[2*GMX_SIMD_REAL_WIDTH + s]);
+}
+
+/* Spreads the forces of the GMX_SIMD_REAL_WIDTH vsites of type ftype
+ * starting at ia over their constructing atoms. The forces are computed
+ * in SIMD and added to the atoms in the same order as the scalar code.
+ * pbc should be NULL or equal to what pbc_simd was set with,
+ * the graph and virial correction are not supported.
+ */
+static void spread_vsite_batch_simd(int ftype, const t_iatom *ia,
+                                    const t_iparams ip[],
+                                    const rvec x[], rvec f[], rvec *fshift,
+                                    const t_pbc *pbc, const pbc_simd_t *pbc_simd)
+{
+    real             buf_array[(3 + 4*DIM + 4*DIM)*GMX_SIMD_REAL_WIDTH + GMX_SIMD_REAL_WIDTH];
+    real            *buf, *fbuf, *sh[4];
+    gmx_bool         bShift;
+    int              nc, inc, s, d, k, is[4], av;
+    gmx_simd_real_t  a_S, b_S, c_S, w_S;
+    gmx_simd_real_t  fvx_S, fvy_S, fvz_S;
+    gmx_simd_real_t  xij_S, yij_S, zij_S;
+    gmx_simd_real_t  xik_S, yik_S, zik_S;
+    gmx_simd_real_t  xil_S, yil_S, zil_S;
+    gmx_simd_real_t  tx_S, ty_S, tz_S;
+    gmx_simd_real_t  rx_S, ry_S, rz_S;
+    gmx_simd_real_t  fjx_S, fjy_S, fjz_S;
+    gmx_simd_real_t  fkx_S, fky_S, fkz_S;
+    gmx_simd_real_t  flx_S, fly_S, flz_S;
+    rvec             fv, fi, fj, fk, fl;
+
+    buf    = gmx_simd_align_r(buf_array);
+    /* fbuf stores fi, fj, fk and fl, after that we store the shifts
+     * of the vsite and of the other constructing atoms, when needed.
+     */
+    fbuf   = buf + 3*GMX_SIMD_REAL_WIDTH;
+    /* The number of constructing atoms */
+    nc     = interaction_function[ftype].nratoms - 1;
+    inc    = 2 + nc;
+    bShift = (fshift != NULL && pbc != NULL);
+    for (k = 0; k < 4; k++)
+    {
+        sh[k] = bShift ? fbuf + (4 + k)*DIM*GMX_SIMD_REAL_WIDTH : NULL;
+    }
+
+    load_vsite_params_simd(ia, inc, ip, buf, &a_S, &b_S, &c_S);
+    /* Load the forces on the vsites */
+    for (s = 0; s < GMX_SIMD_REAL_WIDTH; s++)
+    {
+        for (d = 0; d < DIM; d++)
+        {
+            buf[d*GMX_SIMD_REAL_WIDTH + s] = f[ia[s*inc + 1]][d];
+        }
+    }
+    fvx_S = gmx_simd_load_r(buf);
+    fvy_S = gmx_simd_load_r(buf + GMX_SIMD_REAL_WIDTH);
+    fvz_S = gmx_simd_load_r(buf + 2*GMX_SIMD_REAL_WIDTH);
+
+    flx_S = gmx_simd_setzero_r();
+    fly_S = gmx_simd_setzero_r();
+    flz_S = gmx_simd_setzero_r();
+
+    switch (ftype)
+    {
+        case F_VSITE3:
+            /* The scalar code uses the shifts of i w.r.t. the other atoms */
+            if (bShift)
+            {
+                load_vsite_dx_simd(ia, inc, 2, 1, x, pbc_simd, buf, sh[0], &tx_S, &ty_S, &tz_S);
+                load_vsite_dx_simd(ia, inc, 2, 3, x, pbc_simd, buf, sh[1], &tx_S, &ty_S, &tz_S);
+                load_vsite_dx_simd(ia, inc, 2, 4, x, pbc_simd, buf, sh[2], &tx_S, &ty_S, &tz_S);
+            }
+            fjx_S = gmx_simd_mul_r(a_S, fvx_S);
+            fjy_S = gmx_simd_mul_r(a_S, fvy_S);
+            fjz_S = gmx_simd_mul_r(a_S, fvz_S);
+            fkx_S = gmx_simd_mul_r(b_S, fvx_S);
+            fky_S = gmx_simd_mul_r(b_S, fvy_S);
+            fkz_S = gmx_simd_mul_r(b_S, fvz_S);
+            break;
+        case F_VSITE3FD:
+            /* Here xik is the j-k vector and t goes from i to a point on the line jk */
+            load_vsite_dx_simd(ia, inc, 3, 2, x, pbc_simd, buf, sh[1], &xij_S, &yij_S, &zij_S);
+            load_vsite_dx_simd(ia, inc, 4, 3, x, pbc_simd, buf, sh[2], &xik_S, &yik_S, &zik_S);
+            tx_S  = gmx_simd_fmadd_r(a_S, xik_S, xij_S);
+            ty_S  = gmx_simd_fmadd_r(a_S, yik_S, yij_S);
+            tz_S  = gmx_simd_fmadd_r(a_S, zik_S, zij_S);
+            w_S   = gmx_simd_invsqrt_r(gmx_simd_norm2_r(tx_S, ty_S, tz_S));
+            /* r = b/|t| (fv - t (t.fv)/|t|^2) */
+            rx_S  = gmx_simd_mul_r(gmx_simd_mul_r(w_S, w_S),
+                                   gmx_simd_iprod_r(tx_S, ty_S, tz_S, fvx_S, fvy_S, fvz_S));
+            w_S   = gmx_simd_mul_r(b_S, w_S);
+            fkx_S = gmx_simd_mul_r(w_S, gmx_simd_fnmadd_r(rx_S, tx_S, fvx_S));
+            fky_S = gmx_simd_mul_r(w_S, gmx_simd_fnmadd_r(rx_S, ty_S, fvy_S));
+            fkz_S = gmx_simd_mul_r(w_S, gmx_simd_fnmadd_r(rx_S, tz_S, fvz_S));
+            /* fj = (1 - a) r, fk = a r */
+            fjx_S = gmx_simd_fnmadd_r(a_S, fkx_S, fkx_S);
+            fjy_S = gmx_simd_fnmadd_r(a_S, fky_S, fky_S);
+            fjz_S = gmx_simd_fnmadd_r(a_S, fkz_S, fkz_S);
+            fkx_S = gmx_simd_mul_r(a_S, fkx_S);
+            fky_S = gmx_simd_mul_r(a_S, fky_S);
+            fkz_S = gmx_simd_mul_r(a_S, fkz_S);
+            break;
+        case F_VSITE3OUT:
+            load_vsite_dx_simd(ia, inc, 3, 2, x, pbc_simd, buf, sh[1], &xij_S, &yij_S, &zij_S);
+            load_vsite_dx_simd(ia, inc, 4, 2, x, pbc_simd, buf, sh[2], &xik_S, &yik_S, &zik_S);
+            rx_S  = gmx_simd_mul_r(c_S, fvx_S);
+            ry_S  = gmx_simd_mul_r(c_S, fvy_S);
+            rz_S  = gmx_simd_mul_r(c_S, fvz_S);
+            /* fj = a fv + xik x c fv, fk = b fv - xij x c fv */
+            gmx_simd_cprod_r(xik_S, yik_S, zik_S, rx_S, ry_S, rz_S, &tx_S, &ty_S, &tz_S);
+            fjx_S = gmx_simd_fmadd_r(a_S, fvx_S, tx_S);
+            fjy_S = gmx_simd_fmadd_r(a_S, fvy_S, ty_S);
+            fjz_S = gmx_simd_fmadd_r(a_S, fvz_S, tz_S);
+            gmx_simd_cprod_r(xij_S, yij_S, zij_S, rx_S, ry_S, rz_S, &tx_S, &ty_S, &tz_S);
+            fkx_S = gmx_simd_fmsub_r(b_S, fvx_S, tx_S);
+            fky_S = gmx_simd_fmsub_r(b_S, fvy_S, ty_S);
+            fkz_S = gmx_simd_fmsub_r(b_S, fvz_S, tz_S);
+            break;
+        case F_VSITE4FDN:
+            load_vsite_dx_simd(ia, inc, 3, 2, x, pbc_simd, buf, sh[1], &xij_S, &yij_S, &zij_S);
+            load_vsite_dx_simd(ia, inc, 4, 2, x, pbc_simd, buf, sh[2], &xik_S, &yik_S, &zik_S);
+            load_vsite_dx_simd(ia, inc, 5, 2, x, pbc_simd, buf, sh[3], &xil_S, &yil_S, &zil_S);
+            /* Store rja in ik, rjb in il and rab = rjb - rja in ij */
+            xik_S = gmx_simd_fmsub_r(a_S, xik_S, xij_S);
+            yik_S = gmx_simd_fmsub_r(a_S, yik_S, yij_S);
+            zik_S = gmx_simd_fmsub_r(a_S, zik_S, zij_S);
+            xil_S = gmx_simd_fmsub_r(b_S, xil_S, xij_S);
+            yil_S = gmx_simd_fmsub_r(b_S, yil_S, yij_S);
+            zil_S = gmx_simd_fmsub_r(b_S, zil_S, zij_S);
+            xij_S = gmx_simd_sub_r(xil_S, xik_S);
+            yij_S = gmx_simd_sub_r(yil_S, yik_S);
+            zij_S = gmx_simd_sub_r(zil_S, zik_S);
+            /* rm = rja x rjb, cf = c/|rm| fv stored in fl, w = (rm.cf)/|rm|^2 */
+            gmx_simd_cprod_r(xik_S, yik_S, zik_S, xil_S, yil_S, zil_S, &rx_S, &ry_S, &rz_S);
+            w_S   = gmx_simd_invsqrt_r(gmx_simd_norm2_r(rx_S, ry_S, rz_S));
+            tx_S  = gmx_simd_mul_r(c_S, w_S);
+            flx_S = gmx_simd_mul_r(tx_S, fvx_S);
+            fly_S = gmx_simd_mul_r(tx_S, fvy_S);
+            flz_S = gmx_simd_mul_r(tx_S, fvz_S);
+            w_S   = gmx_simd_mul_r(gmx_simd_mul_r(w_S, w_S),
+                                   gmx_simd_iprod_r(rx_S, ry_S, rz_S, flx_S, fly_S, flz_S));
+            /* fj = cf x rab - w rm x rab */
+            gmx_simd_cprod_r(flx_S, fly_S, flz_S, xij_S, yij_S, zij_S, &fjx_S, &fjy_S, &fjz_S);
+            gmx_simd_cprod_r(rx_S, ry_S, rz_S, xij_S, yij_S, zij_S, &tx_S, &ty_S, &tz_S);
+            fjx_S = gmx_simd_fnmadd_r(w_S, tx_S, fjx_S);
+            fjy_S = gmx_simd_fnmadd_r(w_S, ty_S, fjy_S);
+            fjz_S = gmx_simd_fnmadd_r(w_S, tz_S, fjz_S);
+            /* fk = a (rjb x cf - w rjb x rm) = a rjb x (cf - w rm) */
+            tx_S  = gmx_simd_fnmadd_r(w_S, rx_S, flx_S);
+            ty_S  = gmx_simd_fnmadd_r(w_S, ry_S, fly_S);
+            tz_S  = gmx_simd_fnmadd_r(w_S, rz_S, flz_S);
+            gmx_simd_cprod_r(xil_S, yil_S, zil_S, tx_S, ty_S, tz_S, &fkx_S, &fky_S, &fkz_S);
+            fkx_S = gmx_simd_mul_r(a_S, fkx_S);
+            fky_S = gmx_simd_mul_r(a_S, fky_S);
+            fkz_S = gmx_simd_mul_r(a_S, fkz_S);
+            /* fl = b (cf - w rm) x rja */
+            gmx_simd_cprod_r(tx_S, ty_S, tz_S, xik_S, yik_S, zik_S, &flx_S, &fly_S, &flz_S);
+            flx_S = gmx_simd_mul_r(b_S, flx_S);
+            fly_S = gmx_simd_mul_r(b_S, fly_S);
+            flz_S = gmx_simd_mul_r(b_S, flz_S);
+            break;
+        default:
+            gmx_fatal(FARGS, "No SIMD kernel for vsite type %d in %s, line %d",
+                      ftype, __FILE__, __LINE__);
+    }
+
+    if (bShift && ftype != F_VSITE3)
+    {
+        load_vsite_dx_simd(ia, inc, 1, 2, x, pbc_simd, buf, sh[0], &tx_S, &ty_S, &tz_S);
+    }
+
+    /* fi = fv - fj - fk - fl */
+    gmx_simd_store_r(fbuf,                         gmx_simd_sub_r(gmx_simd_sub_r(fvx_S, fjx_S), gmx_simd_add_r(fkx_S, flx_S)));
+    gmx_simd_store_r(fbuf +    GMX_SIMD_REAL_WIDTH, gmx_simd_sub_r(gmx_simd_sub_r(fvy_S, fjy_S), gmx_simd_add_r(fky_S, fly_S)));
+    gmx_simd_store_r(fbuf +  2*GMX_SIMD_REAL_WIDTH, gmx_simd_sub_r(gmx_simd_sub_r(fvz_S, fjz_S), gmx_simd_add_r(fkz_S, flz_S)));
+    gmx_simd_store_r(fbuf +  3*GMX_SIMD_REAL_WIDTH, fjx_S);
+    gmx_simd_store_r(fbuf +  4*GMX_SIMD_REAL_WIDTH, fjy_S);
+    gmx_simd_store_r(fbuf +  5*GMX_SIMD_REAL_WIDTH, fjz_S);
+    gmx_simd_store_r(fbuf +  6*GMX_SIMD_REAL_WIDTH, fkx_S);
+    gmx_simd_store_r(fbuf +  7*GMX_SIMD_REAL_WIDTH, fky_S);
+    gmx_simd_store_r(fbuf +  8*GMX_SIMD_REAL_WIDTH, fkz_S);
+    gmx_simd_store_r(fbuf +  9*GMX_SIMD_REAL_WIDTH, flx_S);
+    gmx_simd_store_r(fbuf + 10*GMX_SIMD_REAL_WIDTH, fly_S);
+    gmx_simd_store_r(fbuf + 11*GMX_SIMD_REAL_WIDTH, flz_S);
+
+    for (s = 0; s < GMX_SIMD_REAL_WIDTH; s++)
+    {
+        av = ia[s*inc + 1];
+        for (d = 0; d < DIM; d++)
+        {
+            fv[d] = f[av][d];
+            fi[d] = fbuf[(    d)*GMX_SIMD_REAL_WIDTH + s];
+            fj[d] = fbuf[(  DIM + d)*GMX_SIMD_REAL_WIDTH + s];
+            fk[d] = fbuf[(2*DIM + d)*GMX_SIMD_REAL_WIDTH + s];
+            fl[d] = fbuf[(3*DIM + d)*GMX_SIMD_REAL_WIDTH + s];
+        }
+        rvec_inc(f[ia[s*inc + 2]], fi);
+        rvec_inc(f[ia[s*inc + 3]], fj);
+        rvec_inc(f[ia[s*inc + 4]], fk);
+        if (nc == 4)
+        {
+            rvec_inc(f[ia[s*inc + 5]], fl);
+        }
+        clear_rvec(f[av]);
+
+        if (bShift)
+        {
+            /* is[0] is the shift of the vsite, is[1..nc-1] the shifts
+             * of the other constructing atoms as in the scalar code.
+             */
+            for (k = 0; k < nc; k++)
+            {
+                is[k] = vsite_shift_index(sh[k], s);
+            }
+            if (is[0] != CENTRAL || is[1] != CENTRAL || is[2] != CENTRAL ||
+                (nc == 4 && is[3] != CENTRAL))
+            {
+                switch (ftype)
+                {
+                    case F_VSITE3:
+                        rvec_inc(fshift[is[0]], fv);
+                        rvec_dec(fshift[CENTRAL], fi);
+                        rvec_dec(fshift[is[1]], fj);
+                        rvec_dec(fshift[is[2]], fk);
+                        break;
+                    case F_VSITE3FD:
+                        /* The shifts are of j-i and k-j, fj + fk = r */
+                        rvec_dec(fshift[is[0]], fv);
+                        rvec_inc(fshift[CENTRAL], fi);
+                        rvec_dec(fshift[CENTRAL], fk);
+                        rvec_inc(fshift[is[1]], fj);
+                        rvec_inc(fshift[is[1]], fk);
+                        rvec_inc(fshift[is[2]], fk);
+                        break;
+                    default:
+                        rvec_dec(fshift[is[0]], fv);
+                        rvec_inc(fshift[CENTRAL], fi);
+                        rvec_inc(fshift[is[1]], fj);
+                        rvec_inc(fshift[is[2]], fk);
+                        if (nc == 4)
+                        {
+                            rvec_inc(fshift[is[3]], fl);
+                        }
+                }
+            }
+        }
+    }
+}
+
+#endif /* GMX_SIMD_HAVE_REAL */
+
 static void spread_vsite_f_thread(gmx_vsite_t *vsite,
                                   rvec x[], rvec f[], rvec *fshift,
                                   gmx_bool VirCorr, matrix dxdf,
@@ -1315,6 +1798,10 @@ static void spread_vsite_f_thread(gmx_vsite_t *vsite,
     t_iatom   *ia;
     t_pbc     *pbc_null2;
     int       *vsite_pbc;
+#ifdef GMX_SIMD_HAVE_REAL
+    gmx_bool   bSimd;
+    pbc_simd_t pbc_simd;
+#endif
 
     if (VirCorr)
     {
@@ -1323,6 +1810,16 @@ static void spread_vsite_f_thread(gmx_vsite_t *vsite,
 
     bPBCAll = (pbc_null != NULL && !vsite->bHaveChargeGroups);
 
+#ifdef GMX_SIMD_HAVE_REAL
+    /* The SIMD kernels do not support charge groups, screw PBC,
+     * graph based shifts and the virial correction.
+     */
+    bSimd = (vsite->bUseSimd && g == NULL && !VirCorr &&
+             (pbc_null == NULL ||
+              (bPBCAll && pbc_null->ePBC != epbcSCREW)));
+    set_pbc_simd(pbc_null, &pbc_simd);
+#endif
+
     /* this loop goes backwards to be able to build *
      * higher type vsites from lower types         */
     pbc_null2 = NULL;
@@ -1348,6 +1845,19 @@ static void spread_vsite_f_thread(gmx_vsite_t *vsite,
 
             for (i = 0; i < nr; )
             {
+#ifdef GMX_SIMD_HAVE_REAL
+                if (bSimd && vsite_type_has_simd(ftype) &&
+                    i + GMX_SIMD_REAL_WIDTH*inc <= nr &&
+                    vsite_batch_is_independent(ia, inc))
+                {
+                    spread_vsite_batch_simd(ftype, ia, ip, x, f, fshift,
+                                            pbc_null, &pbc_simd);
+
+                    i  += GMX_SIMD_REAL_WIDTH*inc;
+                    ia += GMX_SIMD_REAL_WIDTH*inc;
+                    continue;
+                }
+#endif
                 if (vsite_pbc != NULL)
                 {
                     if (vsite_pbc[i/(1+nra)] > -2)
@@ -1747,7 +2257,7 @@ static int **get_vsite_pbc(t_iparams *iparams, t_ilist *ilist,
 
 
 gmx_vsite_t *init_vsite(gmx_mtop_t *mtop, t_commrec *cr,
-                        gmx_bool bSerial_NoPBC)
+                        gmx_bool bSerial_NoPBC, gmx_bool bUseSimd)
 {
     int            nvsite, i;
     int           *a2cg;
@@ -1806,15 +2316,16 @@ gmx_vsite_t *init_vsite(gmx_mtop_t *mtop, t_commrec *cr,
     {
         vsite->nthreads = gmx_omp_nthreads_get(emntVSITE);
     }
-    if (!bSerial_NoPBC)
-    {
-        /* We need one extra thread data structure for the overlap vsites */
-        snew(vsite->tdata, vsite->nthreads+1);
-    }
+    /* We need one extra thread data structure for the overlap vsites.
+     * The serial setup also uses the first one for spreading the forces.
+     */
+    snew(vsite->tdata, vsite->nthreads+1);
 
     vsite->th_ind        = NULL;
     vsite->th_ind_nalloc = 0;
 
+    vsite->bUseSimd      = bUseSimd;
+
     return vsite;
 }
 
@@ -52,6 +52,8 @@ extern "C" {
 #define RND_SEED_ANDERSEN  4 /**< For Andersen thermostat */
 #define RND_SEED_TPI       5 /**< For test particle insertion */
 #define RND_SEED_EXPANDED  6 /**< For expanded emseble methods */
+#define RND_SEED_FREEVOLUME 7 /**< For gmx freevolume probe insertion */
+#define RND_SEED_COVAR     8 /**< For gmx covar subspace iteration */
 
 /*! \brief Abstract datatype for a random number generator
  *
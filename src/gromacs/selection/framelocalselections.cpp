@@ -0,0 +1,127 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2014, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+/*! \internal \file
+ * \brief
+ * Implements gmx::FrameLocalSelections.
+ *
+ * \ingroup module_selection
+ */
+#include "gmxpre.h"
+
+#include "framelocalselections.h"
+
+#include <vector>
+
+#include "gromacs/selection/selection.h"
+#include "gromacs/selection/selectioncollection.h"
+#include "gromacs/utility/uniqueptr.h"
+
+#include "selectioncollection-impl.h"
+
+namespace gmx
+{
+
+/********************************************************************
+ * FrameLocalSelections::Impl
+ */
+
+/*! \internal \brief
+ * Private implementation class for FrameLocalSelections.
+ *
+ * \ingroup module_selection
+ */
+class FrameLocalSelections::Impl
+{
+    public:
+        //! Initializes the copies from the selections in \p sc.
+        explicit Impl(const gmx_ana_selcollection_t &sc);
+
+        //! Selections in the collection, indexed as \a copies_.
+        const SelectionDataList &sources_;
+        //! Frame-local copies of the selections in \a sources_.
+        SelectionDataList        copies_;
+};
+
+FrameLocalSelections::Impl::Impl(const gmx_ana_selcollection_t &sc)
+    : sources_(sc.sel)
+{
+    copies_.reserve(sources_.size());
+    SelectionDataList::const_iterator i;
+    for (i = sources_.begin(); i != sources_.end(); ++i)
+    {
+        copies_.push_back(SelectionDataPointer(new internal::SelectionData(**i)));
+    }
+}
+
+/********************************************************************
+ * FrameLocalSelections
+ */
+
+FrameLocalSelections::FrameLocalSelections(const SelectionCollection &selections)
+    : impl_(new Impl(selections.impl_->sc_))
+{
+}
+
+
+FrameLocalSelections::~FrameLocalSelections()
+{
+}
+
+
+void
+FrameLocalSelections::copyFrom()
+{
+    for (size_t i = 0; i < impl_->sources_.size(); ++i)
+    {
+        impl_->copies_[i]->copyFrameData(*impl_->sources_[i]);
+    }
+}
+
+
+Selection
+FrameLocalSelections::localSelection(const Selection &selection) const
+{
+    // There are typically only a few selections, so a linear search suffices.
+    for (size_t i = 0; i < impl_->sources_.size(); ++i)
+    {
+        if (selection == Selection(impl_->sources_[i].get()))
+        {
+            return Selection(impl_->copies_[i].get());
+        }
+    }
+    return selection;
+}
+
+} // namespace gmx
@@ -0,0 +1,111 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2014, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+/*! \libinternal \file
+ * \brief
+ * Declares gmx::FrameLocalSelections.
+ *
+ * \inlibraryapi
+ * \ingroup module_selection
+ */
+#ifndef GMX_SELECTION_FRAMELOCALSELECTIONS_H
+#define GMX_SELECTION_FRAMELOCALSELECTIONS_H
+
+#include "gromacs/utility/classhelpers.h"
+
+namespace gmx
+{
+
+class Selection;
+class SelectionCollection;
+
+/*! \libinternal \brief
+ * Frame-local copies of the evaluated selections in a collection.
+ *
+ * SelectionCollection can only evaluate one frame at a time, and the results
+ * are stored in the Selection objects themselves.  To analyze several frames
+ * concurrently, the selections are evaluated serially, and the evaluated
+ * state is then copied into an object of this class for each frame in
+ * progress.  localSelection() maps a selection in the collection to its copy.
+ *
+ * The copies share the evaluation trees with the original selections, and
+ * cannot be evaluated themselves.  The collection must outlive this object.
+ *
+ * \inlibraryapi
+ * \ingroup module_selection
+ */
+class FrameLocalSelections
+{
+    public:
+        /*! \brief
+         * Creates copies of all selections in a collection.
+         *
+         * \param[in] selections  Compiled selection collection.
+         * \throws    std::bad_alloc if out of memory.
+         *
+         * The copies are initialized to the current state of \p selections.
+         */
+        explicit FrameLocalSelections(const SelectionCollection &selections);
+        ~FrameLocalSelections();
+
+        /*! \brief
+         * Copies the current evaluated state of all selections.
+         *
+         * \throws    std::bad_alloc if out of memory.
+         *
+         * Should be called after SelectionCollection::evaluate() for the
+         * collection passed to the constructor.
+         */
+        void copyFrom();
+        /*! \brief
+         * Returns the frame-local copy of a selection.
+         *
+         * \param[in] selection  Selection from the collection passed to the
+         *      constructor.
+         * \returns   Frame-local copy of \p selection, or \p selection itself
+         *      if it does not belong to the collection.
+         *
+         * Does not throw.
+         */
+        Selection localSelection(const Selection &selection) const;
+
+    private:
+        class Impl;
+
+        PrivateImplPointer<Impl> impl_;
+};
+
+} // namespace gmx
+
+#endif
@@ -47,6 +47,21 @@
  *     grids for short cutoffs with very inhomogeneous particle distributions
  *     without a memory cost.
  *
+ * The grid is stored in a compressed format: the reference positions are
+ * sorted by grid cell into flat coordinate arrays, with each cell padded to
+ * the SIMD width, and an index array gives the start of each cell.  The
+ * distances from a test position to all positions in a cell are computed in
+ * one batch with SIMD.
+ *
+ * With a buffer (AnalysisNeighborhood::setBuffer()), the cells are searched
+ * up to the cutoff plus the buffer, and the assignment of reference positions
+ * to cells is kept from one initSearch() call to the next as long as no
+ * reference position has moved more than half the buffer from where it was
+ * when the grid was built.  Only the coordinates in the grid are then
+ * updated, similar to the Verlet buffer in mdrun.  The box may change
+ * (e.g., with pressure coupling) as long as the change is small compared to
+ * the other half of the buffer.
+ *
  * \author Teemu Murtola <teemu.murtola@gmail.com>
  * \ingroup module_selection
  */
@@ -66,6 +81,7 @@
 #include "gromacs/math/vec.h"
 #include "gromacs/pbcutil/pbc.h"
 #include "gromacs/selection/position.h"
+#include "gromacs/simd/simd.h"
 #include "gromacs/topology/block.h"
 #include "gromacs/utility/arrayref.h"
 #include "gromacs/utility/exceptions.h"
@@ -79,6 +95,23 @@ namespace gmx
 namespace
 {
 
+#ifdef GMX_SIMD_HAVE_REAL
+//! Number of positions that each grid cell is padded to.
+const int c_cellPadding = GMX_SIMD_REAL_WIDTH;
+#else
+//! Number of positions that each grid cell is padded to.
+const int c_cellPadding = 1;
+#endif
+//! Alignment (in bytes) of the grid coordinate arrays.
+const int c_cellAlignment = 64;
+/*! \brief
+ * Coordinate used for the padding positions in the grid cells.
+ *
+ * Large enough that padding positions are never within the cutoff, but small
+ * enough that the squared distance does not overflow.
+ */
+const real c_paddingCoordinate = 1e10;
+
 /*! \brief
  * Computes the bounding box for a set of positions.
  *
@@ -124,9 +157,8 @@ class AnalysisNeighborhoodSearchImpl
         typedef AnalysisNeighborhoodPairSearch::ImplPointer
             PairSearchImplPointer;
         typedef std::vector<PairSearchImplPointer> PairSearchList;
-        typedef std::vector<std::vector<int> > CellList;
 
-        explicit AnalysisNeighborhoodSearchImpl(real cutoff);
+        AnalysisNeighborhoodSearchImpl(real cutoff, real buffer);
         ~AnalysisNeighborhoodSearchImpl();
 
         /*! \brief
@@ -151,6 +183,20 @@ class AnalysisNeighborhoodSearchImpl
         real cutoffSquared() const { return cutoff2_; }
         bool usesGridSearch() const { return bGrid_; }
 
+        /*! \brief
+         * Computes the distances from a position to all positions in a cell.
+         *
+         * \param[in]  ci    Index of the grid cell.
+         * \param[in]  x     Position, mapped to the grid with
+         *     mapPointToGridCell().
+         * \param[in]  shift Periodic shift to add to distance vectors.
+         * \param[out] r2    Squared distances to the positions in the cell,
+         *     in the order of \p cellRefIndex_.  Must be aligned to
+         *     \ref c_cellAlignment and have room for the padded cell size.
+         */
+        void computeCellDistances(int ci, const rvec x, const rvec shift,
+                                  real *r2) const;
+
     private:
         /*! \brief
          * Checks the efficiency and possibility of doing grid-based searching.
@@ -185,6 +231,26 @@ class AnalysisNeighborhoodSearchImpl
          */
         bool initGrid(const t_pbc &pbc, int posCount, const rvec x[],
                       bool bUseBoundingBox, bool bForce);
+        /*! \brief
+         * Updates the grid coordinates if the grid from the previous call
+         * can be reused.
+         *
+         * \param[in] posCount Number of positions in \p x.
+         * \param[in] x        New reference positions.
+         * \param[in] bUseBoundingBox  Whether the grid should use the
+         *     bounding box.
+         * \returns   `false` if the grid needs to be rebuilt.
+         *
+         * The grid can be reused if it was built with a buffer for the same
+         * number of positions and the same settings, the box has changed by
+         * at most a quarter of the buffer (summed over the box components,
+         * as the change counts both for the test and the reference
+         * positions), and no position has moved more than half the buffer
+         * since.  If `false` is returned, the grid coordinates may have been
+         * partially modified.
+         */
+        bool updateBufferedGrid(int posCount, const rvec x[],
+                                bool bUseBoundingBox);
         /*! \brief
          * Maps a point into a grid cell.
          *
@@ -205,16 +271,26 @@ class AnalysisNeighborhoodSearchImpl
          */
         int getGridCellIndex(const ivec cell) const;
         /*! \brief
-         * Adds an index into a grid cell.
+         * Calculates linear index of the grid cell for a point.
          *
-         * \param[in]  cell Fractional cell coordinates into which \p i should
+         * \param[in]  cell Fractional cell coordinates of the point.
+         * \returns    Linear index of the cell into which the point should
          *     be added.
-         * \param[in]  i    Index to add.
          *
          * \p cell should satisfy the conditions that \p mapPointToGridCell()
          * produces.
          */
-        void addToGridCell(const rvec cell, int i);
+        int getGridCellIndexForPoint(const rvec cell) const;
+        /*! \brief
+         * Puts the reference positions on the grid.
+         *
+         * \param[in] posCount Number of positions in \p x.
+         * \param[in] x        Reference positions.
+         *
+         * Sorts the positions by cell into \p cellRefIndex_ and the
+         * coordinate arrays, and sets up \p cellIndex_.
+         */
+        void fillGrid(int posCount, const rvec x[]);
         /*! \brief
          * Initializes a cell pair loop for a dimension.
          *
@@ -264,6 +340,10 @@ class AnalysisNeighborhoodSearchImpl
         real                    cutoff_;
         //! The cutoff squared.
         real                    cutoff2_;
+        //! Buffer added to the cutoff for grid searching (zero if not used).
+        real                    buffer_;
+        //! The cutoff plus the buffer, used to find the cells to search.
+        real                    searchRange_;
         //! Whether to do searching in XY plane only.
         bool                    bXY_;
 
@@ -311,8 +391,44 @@ class AnalysisNeighborhoodSearchImpl
         real                    cellShiftYX_;
         //! Number of cells along each dimension.
         ivec                    ncelldim_;
-        //! Data structure to hold the grid cell contents.
-        CellList                cells_;
+        //! Whether the current grid was built with a buffer and can be reused.
+        bool                    bBufferedGridValid_;
+        //! Whether the bounding box was used for the buffered grid.
+        bool                    bBufferedGridUseBoundingBox_;
+        //! Reference positions when the buffered grid was built.
+        rvec                   *xbuffered_;
+        //! Allocation count for \p xbuffered_.
+        int                     xbuffered_nalloc_;
+        //! PBC type for which the buffered grid was built.
+        int                     gridEPBC_;
+        //! Box for which the buffered grid was built.
+        matrix                  gridBox_;
+        //! Slot in the grid arrays for each reference position.
+        std::vector<int>        refSlot_;
+        /*! \brief
+         * Start of each grid cell in \p cellRefIndex_ and the coordinate
+         * arrays.
+         *
+         * Has one more element than there are cells; each cell is padded to
+         * a multiple of \ref c_cellPadding positions.
+         */
+        std::vector<int>        cellIndex_;
+        //! Number of actual (non-padding) positions in each grid cell.
+        std::vector<int>        cellRefCount_;
+        //! Largest padded size of any grid cell.
+        int                     maxCellSize_;
+        //! Reference position index for each slot in the grid (-1 for padding).
+        std::vector<int>        cellRefIndex_;
+        //! Grid cell index for each reference position (temporary storage).
+        std::vector<int>        refCell_;
+        //! In-unit-cell reference X coordinates, sorted by grid cell.
+        real                   *cellX_;
+        //! In-unit-cell reference Y coordinates, sorted by grid cell.
+        real                   *cellY_;
+        //! In-unit-cell reference Z coordinates, sorted by grid cell.
+        real                   *cellZ_;
+        //! Allocation count for the coordinate arrays.
+        int                     cellNalloc_;
 
         tMPI::mutex             createPairSearchMutex_;
         PairSearchList          pairSearchList_;
@@ -335,8 +451,14 @@ class AnalysisNeighborhoodPairSearchImpl
             clear_rvec(testcell_);
             clear_ivec(currCell_);
             clear_ivec(cellBound_);
+            r2_       = NULL;
+            r2Nalloc_ = 0;
             reset(-1);
         }
+        ~AnalysisNeighborhoodPairSearchImpl()
+        {
+            sfree_aligned(r2_);
+        }
 
         //! Initializes a search to find reference positions neighboring \p x.
         void startSearch(const AnalysisNeighborhoodPositions &positions);
@@ -347,6 +469,10 @@ class AnalysisNeighborhoodPairSearchImpl
         void initFoundPair(AnalysisNeighborhoodPair *pair) const;
         //! Advances to the next test position, skipping any remaining pairs.
         void nextTestPosition();
+        //! Returns the number of elements in the test position array.
+        int testPositionCount() const { return testPositions_.size(); }
+        //! Returns the index of the currently active test position.
+        int testIndex() const { return testIndex_; }
 
     private:
         //! Clears the loop indices.
@@ -382,6 +508,10 @@ class AnalysisNeighborhoodPairSearchImpl
         ivec                                    cellBound_;
         //! Stores the index within the current cell during pair loops.
         int                                     prevcai_;
+        //! Distances to the positions in the current cell during pair loops.
+        real                                   *r2_;
+        //! Allocation count for \p r2_.
+        int                                     r2Nalloc_;
 
         GMX_DISALLOW_COPY_AND_ASSIGN(AnalysisNeighborhoodPairSearchImpl);
 };
@@ -390,10 +520,12 @@ class AnalysisNeighborhoodPairSearchImpl
  * AnalysisNeighborhoodSearchImpl
  */
 
-AnalysisNeighborhoodSearchImpl::AnalysisNeighborhoodSearchImpl(real cutoff)
+AnalysisNeighborhoodSearchImpl::AnalysisNeighborhoodSearchImpl(real cutoff,
+                                                               real buffer)
 {
     bTryGrid_       = true;
     cutoff_         = cutoff;
+    buffer_         = 0.0;
     if (cutoff_ <= 0)
     {
         cutoff_     = cutoff2_ = GMX_REAL_MAX;
@@ -402,7 +534,12 @@ AnalysisNeighborhoodSearchImpl::AnalysisNeighborhoodSearchImpl(real cutoff)
     else
     {
         cutoff2_        = sqr(cutoff_);
+        if (buffer > 0)
+        {
+            buffer_     = buffer;
+        }
     }
+    searchRange_    = cutoff_ + buffer_;
     bXY_             = false;
     nref_            = 0;
     xref_            = NULL;
@@ -421,6 +558,17 @@ AnalysisNeighborhoodSearchImpl::AnalysisNeighborhoodSearchImpl(real cutoff)
     clear_rvec(cellSize_);
     clear_rvec(invCellSize_);
     clear_ivec(ncelldim_);
+    bBufferedGridValid_          = false;
+    bBufferedGridUseBoundingBox_ = false;
+    xbuffered_                   = NULL;
+    xbuffered_nalloc_            = 0;
+    gridEPBC_                    = epbcNONE;
+    clear_mat(gridBox_);
+    maxCellSize_    = 0;
+    cellX_          = NULL;
+    cellY_          = NULL;
+    cellZ_          = NULL;
+    cellNalloc_     = 0;
 }
 
 AnalysisNeighborhoodSearchImpl::~AnalysisNeighborhoodSearchImpl()
@@ -432,6 +580,10 @@ AnalysisNeighborhoodSearchImpl::~AnalysisNeighborhoodSearchImpl()
                            "Dangling AnalysisNeighborhoodPairSearch reference");
     }
     sfree(xref_alloc_);
+    sfree(xbuffered_);
+    sfree_aligned(cellX_);
+    sfree_aligned(cellY_);
+    sfree_aligned(cellZ_);
 }
 
 AnalysisNeighborhoodSearchImpl::PairSearchImplPointer
@@ -459,7 +611,7 @@ bool AnalysisNeighborhoodSearchImpl::checkGridSearchEfficiency(bool bForce)
     ivec  range;
     for (int dd = 0; dd < DIM; ++dd)
     {
-        range[dd] = static_cast<int>(ceil(cutoff_ * invCellSize_[dd]));
+        range[dd] = static_cast<int>(ceil(searchRange_ * invCellSize_[dd]));
     }
 
     // Calculate the fraction of cell pairs that need to be searched,
@@ -579,16 +731,12 @@ bool AnalysisNeighborhoodSearchImpl::initGridCells(
     {
         return false;
     }
-    // Never decrease the size of the cell vector to avoid reallocating
-    // memory for the nested vectors.  The actual size of the vector is not
-    // used outside this function.
-    if (cells_.size() < static_cast<size_t>(totalCellCount))
+    // Never decrease the size of the cell vectors; only the first
+    // totalCellCount cells are used.
+    if (cellRefCount_.size() < static_cast<size_t>(totalCellCount))
     {
-        cells_.resize(totalCellCount);
-    }
-    for (int ci = 0; ci < totalCellCount; ++ci)
-    {
-        cells_[ci].clear();
+        cellIndex_.resize(totalCellCount + 1);
+        cellRefCount_.resize(totalCellCount);
     }
     return true;
 }
@@ -722,7 +870,7 @@ int AnalysisNeighborhoodSearchImpl::getGridCellIndex(const ivec cell) const
            + cell[ZZ] * ncelldim_[XX] * ncelldim_[YY];
 }
 
-void AnalysisNeighborhoodSearchImpl::addToGridCell(const rvec cell, int i)
+int AnalysisNeighborhoodSearchImpl::getGridCellIndexForPoint(const rvec cell) const
 {
     ivec icell;
     for (int dd = 0; dd < DIM; ++dd)
@@ -742,15 +890,202 @@ void AnalysisNeighborhoodSearchImpl::addToGridCell(const rvec cell, int i)
         }
         icell[dd] = cellIndex;
     }
-    const int ci = getGridCellIndex(icell);
-    cells_[ci].push_back(i);
+    return getGridCellIndex(icell);
+}
+
+void AnalysisNeighborhoodSearchImpl::fillGrid(int posCount, const rvec x[])
+{
+    const int cellCount = ncelldim_[XX] * ncelldim_[YY] * ncelldim_[ZZ];
+
+    // Count the positions in each cell.
+    if (xref_nalloc_ < posCount)
+    {
+        srenew(xref_alloc_, posCount);
+        xref_nalloc_ = posCount;
+    }
+    refCell_.resize(posCount);
+    refSlot_.resize(posCount);
+    std::fill(cellRefCount_.begin(), cellRefCount_.begin() + cellCount, 0);
+    for (int i = 0; i < posCount; ++i)
+    {
+        rvec refcell;
+        mapPointToGridCell(x[i], refcell, xref_alloc_[i]);
+        refCell_[i] = getGridCellIndexForPoint(refcell);
+        ++cellRefCount_[refCell_[i]];
+    }
+
+    // Compute the padded cell starts.
+    maxCellSize_ = 0;
+    cellIndex_[0] = 0;
+    for (int ci = 0; ci < cellCount; ++ci)
+    {
+        const int paddedSize
+            = (cellRefCount_[ci] + c_cellPadding - 1) / c_cellPadding * c_cellPadding;
+        cellIndex_[ci + 1] = cellIndex_[ci] + paddedSize;
+        maxCellSize_       = std::max(maxCellSize_, paddedSize);
+    }
+    const int totalSize = cellIndex_[cellCount];
+    if (cellNalloc_ < totalSize)
+    {
+        sfree_aligned(cellX_);
+        sfree_aligned(cellY_);
+        sfree_aligned(cellZ_);
+        cellNalloc_ = over_alloc_large(totalSize);
+        snew_aligned(cellX_, cellNalloc_, c_cellAlignment);
+        snew_aligned(cellY_, cellNalloc_, c_cellAlignment);
+        snew_aligned(cellZ_, cellNalloc_, c_cellAlignment);
+    }
+    cellRefIndex_.resize(totalSize);
+
+    // Put the positions into the cells.  The positions are processed in
+    // order, so the indices within each cell are ascending, as required for
+    // the exclusion handling.
+    for (int ci = 0; ci < cellCount; ++ci)
+    {
+        cellRefCount_[ci] = 0;
+    }
+    for (int i = 0; i < posCount; ++i)
+    {
+        const int ci   = refCell_[i];
+        const int slot = cellIndex_[ci] + cellRefCount_[ci];
+        refSlot_[i]         = slot;
+        cellRefIndex_[slot] = i;
+        cellX_[slot]        = xref_alloc_[i][XX];
+        cellY_[slot]        = xref_alloc_[i][YY];
+        cellZ_[slot]        = xref_alloc_[i][ZZ];
+        ++cellRefCount_[ci];
+    }
+    for (int ci = 0; ci < cellCount; ++ci)
+    {
+        for (int slot = cellIndex_[ci] + cellRefCount_[ci];
+             slot < cellIndex_[ci + 1]; ++slot)
+        {
+            cellRefIndex_[slot] = -1;
+            cellX_[slot]        = c_paddingCoordinate;
+            cellY_[slot]        = c_paddingCoordinate;
+            cellZ_[slot]        = c_paddingCoordinate;
+        }
+    }
+}
+
+bool AnalysisNeighborhoodSearchImpl::updateBufferedGrid(
+        int posCount, const rvec x[], bool bUseBoundingBox)
+{
+    if (!bBufferedGridValid_ || posCount != nref_
+        || bUseBoundingBox != bBufferedGridUseBoundingBox_
+        || pbc_.ePBC != gridEPBC_)
+    {
+        return false;
+    }
+    // The grid geometry is kept from the box it was built for, but test
+    // positions are put into the unit cell and the cells are shifted using
+    // the current box.  Both can put a position off its grid cell by the
+    // change in the box, which must then fit in the half of the buffer that
+    // is not used for the displacements.
+    matrix boxChange;
+    real   boxChangeSum = 0.0;
+    for (int dd = 0; dd < DIM; ++dd)
+    {
+        for (int d = 0; d < DIM; ++d)
+        {
+            boxChange[dd][d] = pbc_.box[dd][d] - gridBox_[dd][d];
+            boxChangeSum    += std::fabs(boxChange[dd][d]);
+        }
+    }
+    if (2*boxChangeSum > 0.5 * buffer_)
+    {
+        return false;
+    }
+    const real maxDisplacement2 = sqr(0.5 * buffer_);
+    for (int i = 0; i < posCount; ++i)
+    {
+        rvec dx;
+        if (pbc_.ePBC != epbcNONE)
+        {
+            pbc_dx(&pbc_, x[i], xbuffered_[i], dx);
+        }
+        else
+        {
+            rvec_sub(x[i], xbuffered_[i], dx);
+        }
+        // Move the position on the grid from where it was put when the
+        // grid was built, so that it stays in the same cell image.
+        // The image is the same number of box vectors from the position
+        // as when the grid was built, so it moves with the box.
+        if (boxChangeSum > 0)
+        {
+            rvec imageShift;
+            rvec_add(xref_alloc_[i], gridOrigin_, imageShift);
+            rvec_dec(imageShift, xbuffered_[i]);
+            for (int dd = DIM - 1; dd >= 0; --dd)
+            {
+                if (bGridPBC_[dd] && gridBox_[dd][dd] > 0)
+                {
+                    const real n = std::floor(imageShift[dd]/gridBox_[dd][dd] + 0.5);
+                    for (int d = 0; d <= dd; ++d)
+                    {
+                        imageShift[d] -= n * gridBox_[dd][d];
+                        dx[d]         += n * boxChange[dd][d];
+                    }
+                }
+            }
+        }
+        if (norm2(dx) > maxDisplacement2)
+        {
+            return false;
+        }
+        const int slot = refSlot_[i];
+        cellX_[slot] = xref_alloc_[i][XX] + dx[XX];
+        cellY_[slot] = xref_alloc_[i][YY] + dx[YY];
+        cellZ_[slot] = xref_alloc_[i][ZZ] + dx[ZZ];
+    }
+    return true;
+}
+
+void AnalysisNeighborhoodSearchImpl::computeCellDistances(
+        int ci, const rvec x, const rvec shift, real *r2) const
+{
+    const int start = cellIndex_[ci];
+    const int end   = cellIndex_[ci + 1];
+#ifdef GMX_SIMD_HAVE_REAL
+    const gmx_simd_real_t tx = gmx_simd_set1_r(x[XX]);
+    const gmx_simd_real_t ty = gmx_simd_set1_r(x[YY]);
+    const gmx_simd_real_t tz = gmx_simd_set1_r(x[ZZ]);
+    const gmx_simd_real_t sx = gmx_simd_set1_r(shift[XX]);
+    const gmx_simd_real_t sy = gmx_simd_set1_r(shift[YY]);
+    const gmx_simd_real_t sz = gmx_simd_set1_r(shift[ZZ]);
+    for (int i = start; i < end; i += GMX_SIMD_REAL_WIDTH)
+    {
+        const gmx_simd_real_t dx
+            = gmx_simd_add_r(gmx_simd_sub_r(tx, gmx_simd_load_r(cellX_ + i)), sx);
+        const gmx_simd_real_t dy
+            = gmx_simd_add_r(gmx_simd_sub_r(ty, gmx_simd_load_r(cellY_ + i)), sy);
+        gmx_simd_real_t       d2
+            = gmx_simd_fmadd_r(dy, dy, gmx_simd_mul_r(dx, dx));
+        if (!bXY_)
+        {
+            const gmx_simd_real_t dz
+                = gmx_simd_add_r(gmx_simd_sub_r(tz, gmx_simd_load_r(cellZ_ + i)), sz);
+            d2 = gmx_simd_fmadd_r(dz, dz, d2);
+        }
+        gmx_simd_store_r(r2 + i - start, d2);
+    }
+#else
+    for (int i = start; i < end; ++i)
+    {
+        const real dx = x[XX] - cellX_[i] + shift[XX];
+        const real dy = x[YY] - cellY_[i] + shift[YY];
+        const real dz = x[ZZ] - cellZ_[i] + shift[ZZ];
+        r2[i - start] = bXY_ ? dx*dx + dy*dy : dx*dx + dy*dy + dz*dz;
+    }
+#endif
 }
 
 void AnalysisNeighborhoodSearchImpl::initCellRange(
         const rvec centerCell, ivec currCell, ivec upperBound, int dim) const
 {
     // TODO: Prune off cells that are completely outside the cutoff.
-    const real range       = cutoff_ * invCellSize_[dim];
+    const real range       = searchRange_ * invCellSize_[dim];
     real       startOffset = centerCell[dim] - range;
     real       endOffset   = centerCell[dim] + range;
     if (bTric_)
@@ -881,6 +1216,10 @@ void AnalysisNeighborhoodSearchImpl::init(
 {
     GMX_RELEASE_ASSERT(positions.index_ == -1,
                        "Individual indexed positions not supported as reference");
+    if (bXY != bXY_)
+    {
+        bBufferedGridValid_ = false;
+    }
     bXY_ = bXY;
     if (bXY_ && pbc != NULL && pbc->ePBC != epbcNONE)
     {
@@ -912,35 +1251,42 @@ void AnalysisNeighborhoodSearchImpl::init(
         pbc_.ePBC = epbcNONE;
         clear_mat(pbc_.box);
     }
-    nref_ = positions.count_;
+    bool bReuseGrid = false;
     if (mode == AnalysisNeighborhood::eSearchMode_Simple)
     {
         bGrid_ = false;
     }
     else if (bTryGrid_)
     {
-        bGrid_ = initGrid(pbc_, positions.count_, positions.x_, bUseBoundingBox,
-                          mode == AnalysisNeighborhood::eSearchMode_Grid);
+        bReuseGrid = updateBufferedGrid(positions.count_, positions.x_,
+                                        bUseBoundingBox);
+        if (!bReuseGrid)
+        {
+            bGrid_ = initGrid(pbc_, positions.count_, positions.x_, bUseBoundingBox,
+                              mode == AnalysisNeighborhood::eSearchMode_Grid);
+        }
     }
-    if (bGrid_)
+    nref_ = positions.count_;
+    xref_ = positions.x_;
+    if (bGrid_ && !bReuseGrid)
     {
-        if (xref_nalloc_ < nref_)
+        fillGrid(nref_, positions.x_);
+    }
+    bBufferedGridValid_ = (bGrid_ && buffer_ > 0);
+    if (bBufferedGridValid_ && !bReuseGrid)
+    {
+        if (xbuffered_nalloc_ < nref_)
         {
-            srenew(xref_alloc_, nref_);
-            xref_nalloc_ = nref_;
+            srenew(xbuffered_, nref_);
+            xbuffered_nalloc_ = nref_;
         }
-        xref_ = xref_alloc_;
-
         for (int i = 0; i < nref_; ++i)
         {
-            rvec refcell;
-            mapPointToGridCell(positions.x_[i], refcell, xref_alloc_[i]);
-            addToGridCell(refcell, i);
+            copy_rvec(positions.x_[i], xbuffered_[i]);
         }
-    }
-    else
-    {
-        xref_ = positions.x_;
+        gridEPBC_                    = pbc_.ePBC;
+        copy_mat(pbc_.box, gridBox_);
+        bBufferedGridUseBoundingBox_ = bUseBoundingBox;
     }
     excls_           = excls;
     refExclusionIds_ = NULL;
@@ -965,6 +1311,12 @@ void AnalysisNeighborhoodPairSearchImpl::reset(int testIndex)
     {
         if (search_.bGrid_)
         {
+            if (r2Nalloc_ < search_.maxCellSize_)
+            {
+                sfree_aligned(r2_);
+                r2Nalloc_ = search_.maxCellSize_;
+                snew_aligned(r2_, r2Nalloc_, c_cellAlignment);
+            }
             search_.mapPointToGridCell(testPositions_[testIndex], testcell_, xtest_);
             search_.initCellRange(testcell_, currCell_, cellBound_, ZZ);
             search_.initCellRange(testcell_, currCell_, cellBound_, YY);
@@ -1055,22 +1407,24 @@ bool AnalysisNeighborhoodPairSearchImpl::searchNext(Action action)
             do
             {
                 rvec      shift;
-                const int ci       = search_.shiftCell(currCell_, shift);
-                const int cellSize = static_cast<int>(search_.cells_[ci].size());
+                const int ci        = search_.shiftCell(currCell_, shift);
+                const int cellStart = search_.cellIndex_[ci];
+                const int cellSize  = search_.cellRefCount_[ci];
+                // The distances are computed for the whole cell when
+                // entering it, and kept in r2_ when the loop is resumed
+                // within the cell.
+                if (cai == 0 && cellSize > 0)
+                {
+                    search_.computeCellDistances(ci, xtest_, shift, r2_);
+                }
                 for (; cai < cellSize; ++cai)
                 {
-                    const int i = search_.cells_[ci][cai];
+                    const int i = search_.cellRefIndex_[cellStart + cai];
                     if (isExcluded(i))
                     {
                         continue;
                     }
-                    rvec       dx;
-                    rvec_sub(xtest_, search_.xref_[i], dx);
-                    rvec_add(dx, shift, dx);
-                    const real r2
-                        = search_.bXY_
-                            ? dx[XX]*dx[XX] + dx[YY]*dx[YY]
-                            : norm2(dx);
+                    const real r2 = r2_[cai];
                     if (r2 <= search_.cutoff2_)
                     {
                         if (action(i, r2))
@@ -1184,6 +1538,12 @@ class MindistAction
         {
         }
 
+        //! Copies the action, the copy writes to the same output locations.
+        MindistAction(const MindistAction &other)
+            : closestPoint_(other.closestPoint_), minDist2_(other.minDist2_)
+        {
+        }
+
         //! Processes a neighbor to find the nearest point.
         bool operator()(int i, real r2)
         {
@@ -1202,6 +1562,58 @@ class MindistAction
         GMX_DISALLOW_ASSIGN(MindistAction);
 };
 
+/*! \brief
+ * Search action to find the minimum distance for each test position.
+ *
+ * Used as the action for AnalysisNeighborhoodPairSearchImpl::searchNext() to
+ * find the nearest neighbor of all test positions in a single search.
+ *
+ * With this action, AnalysisNeighborhoodPairSearchImpl::searchNext() always
+ * returns false.  The squared minimum distance for each test position is put
+ * into the array passed into the constructor, which the caller must
+ * initialize.
+ */
+class MindistPerPositionAction
+{
+    public:
+        /*! \brief
+         * Initializes the action with a given output location.
+         *
+         * \param[in]  pairSearch Pair search that calls this action.
+         * \param[out] minDist2   Minimum distance squared for each test
+         *     position.
+         */
+        MindistPerPositionAction(
+                const internal::AnalysisNeighborhoodPairSearchImpl &pairSearch,
+                real                                               *minDist2)
+            : pairSearch_(pairSearch), minDist2_(minDist2)
+        {
+        }
+
+        //! Copies the action, the copy writes to the same output location.
+        MindistPerPositionAction(const MindistPerPositionAction &other)
+            : pairSearch_(other.pairSearch_), minDist2_(other.minDist2_)
+        {
+        }
+
+        //! Processes a neighbor to find the nearest point.
+        bool operator()(int /*i*/, real r2)
+        {
+            real &minDist2 = minDist2_[pairSearch_.testIndex()];
+            if (r2 < minDist2)
+            {
+                minDist2 = r2;
+            }
+            return false;
+        }
+
+    private:
+        const internal::AnalysisNeighborhoodPairSearchImpl &pairSearch_;
+        real                                               *minDist2_;
+
+        GMX_DISALLOW_ASSIGN(MindistPerPositionAction);
+};
+
 }   // namespace
 
 /********************************************************************
@@ -1215,7 +1627,7 @@ class AnalysisNeighborhood::Impl
         typedef std::vector<SearchImplPointer> SearchList;
 
         Impl()
-            : cutoff_(0), excls_(NULL), mode_(eSearchMode_Automatic),
+            : cutoff_(0), buffer_(0), excls_(NULL), mode_(eSearchMode_Automatic),
               bUseBoundingBox_(true), bXY_(false)
         {
         }
@@ -1234,6 +1646,7 @@ class AnalysisNeighborhood::Impl
         tMPI::mutex             createSearchMutex_;
         SearchList              searchList_;
         real                    cutoff_;
+        real                    buffer_;
         const t_blocka         *excls_;
         SearchMode              mode_;
         bool                    bUseBoundingBox_;
@@ -1254,7 +1667,7 @@ AnalysisNeighborhood::Impl::getSearch()
             return *i;
         }
     }
-    SearchImplPointer search(new internal::AnalysisNeighborhoodSearchImpl(cutoff_));
+    SearchImplPointer search(new internal::AnalysisNeighborhoodSearchImpl(cutoff_, buffer_));
     searchList_.push_back(search);
     return search;
 }
@@ -1279,6 +1692,13 @@ void AnalysisNeighborhood::setCutoff(real cutoff)
     impl_->cutoff_ = cutoff;
 }
 
+void AnalysisNeighborhood::setBuffer(real buffer)
+{
+    GMX_RELEASE_ASSERT(impl_->searchList_.empty(),
+                       "Changing the buffer after initSearch() not currently supported");
+    impl_->buffer_ = buffer;
+}
+
 void AnalysisNeighborhood::setUseBoundingBox(bool bUseBoundingBox)
 {
     impl_->bUseBoundingBox_ = bUseBoundingBox;
@@ -1364,6 +1784,27 @@ real AnalysisNeighborhoodSearch::minimumDistance(
     return sqrt(minDist2);
 }
 
+void AnalysisNeighborhoodSearch::minimumDistances(
+        const AnalysisNeighborhoodPositions &positions,
+        ArrayRef<real>                       distances) const
+{
+    GMX_RELEASE_ASSERT(impl_, "Accessing an invalid search object");
+    internal::AnalysisNeighborhoodPairSearchImpl pairSearch(*impl_);
+    pairSearch.startSearch(positions);
+    GMX_RELEASE_ASSERT(static_cast<int>(distances.size()) >= pairSearch.testPositionCount(),
+                       "Output array does not match the number of test positions");
+    const int firstIndex = pairSearch.testIndex();
+    const int count      = pairSearch.testPositionCount();
+    std::fill(distances.begin() + firstIndex, distances.begin() + count,
+              impl_->cutoffSquared());
+    MindistPerPositionAction action(pairSearch, distances.data());
+    (void)pairSearch.searchNext(action);
+    for (int i = firstIndex; i < count; ++i)
+    {
+        distances[i] = sqrt(distances[i]);
+    }
+}
+
 AnalysisNeighborhoodPair
 AnalysisNeighborhoodSearch::nearestPoint(
         const AnalysisNeighborhoodPositions &positions) const
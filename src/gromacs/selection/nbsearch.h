@@ -222,6 +222,32 @@ class AnalysisNeighborhood
          * Does not throw.
          */
         void setCutoff(real cutoff);
+        /*! \brief
+         * Sets a buffer for reusing the search grid between searches.
+         *
+         * \param[in]  buffer Buffer distance (<=0 stands for no buffer).
+         *
+         * With a buffer, grid searching considers grid cells up to the
+         * cutoff plus \p buffer, and initSearch() keeps the grid from the
+         * previous call if no reference position has moved more than half
+         * the buffer since the grid was built, the number of reference
+         * positions is unchanged, and the box has changed by at most a
+         * quarter of the buffer (summed over all box components).
+         * Only the coordinates are then updated, and distances are still
+         * checked against the cutoff.
+         * This is useful for analyzing trajectories with frequent output,
+         * where gridding the reference positions for every frame would
+         * otherwise dominate.  The searched positions do not need to be the
+         * same between calls for the results to be correct, but the grid is
+         * only reused when they are nearly the same.
+         *
+         * Currently, can only be called before the first call to initSearch().
+         * If this method is not called, the grid is rebuilt for every
+         * initSearch() call.
+         *
+         * Does not throw.
+         */
+        void setBuffer(real buffer);
         /*! \brief
          * Sets the search to prefer a grid that covers the bounding box of
          * reference positions.
@@ -468,6 +494,25 @@ class AnalysisNeighborhoodSearch
          *     cutoff.
          */
         real minimumDistance(const AnalysisNeighborhoodPositions &positions) const;
+        /*! \brief
+         * Calculates the minimum distance from the reference points for
+         * each test position.
+         *
+         * \param[in]  positions  Set of test positions to use.
+         * \param[out] distances  For each test position, the distance to the
+         *     nearest reference position, or the cutoff value if there are
+         *     no reference positions within the cutoff.
+         *     Should have one element for each position in the array passed
+         *     to the \p positions constructor.
+         *
+         * Gives the same result as calling minimumDistance() separately for
+         * each position, but processes all the positions in a single search,
+         * so that the per-search setup is done only once.
+         * If AnalysisNeighborhoodPositions::selectSingleFromArray() has been
+         * called, only the selected element of \p distances is set.
+         */
+        void minimumDistances(const AnalysisNeighborhoodPositions &positions,
+                              ArrayRef<real>                       distances) const;
         /*! \brief
          * Finds the closest reference point.
          *
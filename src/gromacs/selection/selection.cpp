@@ -43,6 +43,9 @@
 
 #include "selection.h"
 
+#include <cstring>
+
+#include <algorithm>
 #include <string>
 
 #include "gromacs/selection/nbsearch.h"
@@ -50,6 +53,7 @@
 #include "gromacs/topology/topology.h"
 #include "gromacs/utility/exceptions.h"
 #include "gromacs/utility/gmxassert.h"
+#include "gromacs/utility/smalloc.h"
 #include "gromacs/utility/stringutil.h"
 
 #include "selelem.h"
@@ -112,6 +116,27 @@ SelectionData::SelectionData(SelectionTreeElement *elem,
 }
 
 
+SelectionData::SelectionData(const SelectionData &other)
+    : name_(other.name_), selectionText_(other.selectionText_),
+      posMass_(other.posMass_), posCharge_(other.posCharge_),
+      flags_(other.flags_), rootElement_(other.rootElement_),
+      coveredFractionType_(other.coveredFractionType_),
+      coveredFraction_(other.coveredFraction_),
+      averageCoveredFraction_(other.averageCoveredFraction_),
+      bDynamic_(other.bDynamic_),
+      bDynamicCoveredFraction_(other.bDynamicCoveredFraction_)
+{
+    const gmx_ana_pos_t &src = other.rawPositions_;
+    // Reserve for the maximal selection to avoid reallocation during the
+    // per-frame copies.
+    gmx_ana_pos_reserve_for_append(&rawPositions_,
+                                   std::max(src.count(), src.m.b.nr),
+                                   std::max(src.m.mapb.nra, src.m.b.nra),
+                                   src.v != NULL, src.f != NULL);
+    copyFrameData(other);
+}
+
+
 SelectionData::~SelectionData()
 {
 }
@@ -246,6 +271,52 @@ SelectionData::restoreOriginalPositions(const t_topology *top)
     }
 }
 
+
+void
+SelectionData::copyFrameData(const SelectionData &source)
+{
+    const gmx_ana_pos_t &src    = source.rawPositions_;
+    gmx_ana_pos_t       &dest   = rawPositions_;
+    const int            count  = src.count();
+    const int            natoms = src.m.mapb.nra;
+
+    gmx_ana_pos_reserve(&dest, count, 0);
+    gmx_ana_indexmap_reserve(&dest.m, count, 0);
+    if (dest.m.mapb.nalloc_a < natoms)
+    {
+        srenew(dest.m.mapb.a, natoms);
+        dest.m.mapb.nalloc_a = natoms;
+    }
+    std::memcpy(dest.x, src.x, count*sizeof(*dest.x));
+    if (src.v != NULL)
+    {
+        gmx_ana_pos_reserve_velocities(&dest);
+        std::memcpy(dest.v, src.v, count*sizeof(*dest.v));
+    }
+    if (src.f != NULL)
+    {
+        gmx_ana_pos_reserve_forces(&dest);
+        std::memcpy(dest.f, src.f, count*sizeof(*dest.f));
+    }
+    // The atoms in src.m.mapb.a may point to memory in the evaluation tree
+    // that is overwritten for the next frame, so they are always copied.
+    dest.m.type      = src.m.type;
+    dest.m.bStatic   = src.m.bStatic;
+    dest.m.mapb.nr   = count;
+    dest.m.mapb.nra  = natoms;
+    std::memcpy(dest.m.mapb.index, src.m.mapb.index,
+                (count+1)*sizeof(*dest.m.mapb.index));
+    if (natoms > 0)
+    {
+        std::memcpy(dest.m.mapb.a, src.m.mapb.a, natoms*sizeof(*dest.m.mapb.a));
+    }
+    std::memcpy(dest.m.refid, src.m.refid, count*sizeof(*dest.m.refid));
+    std::memcpy(dest.m.mapid, src.m.mapid, count*sizeof(*dest.m.mapid));
+    posMass_         = source.posMass_;
+    posCharge_       = source.posCharge_;
+    coveredFraction_ = source.coveredFraction_;
+}
+
 }   // namespace internal
 
 /********************************************************************
@@ -93,6 +93,20 @@ class SelectionData
          * \throws    std::bad_alloc if out of memory.
          */
         SelectionData(SelectionTreeElement *elem, const char *selstr);
+        /*! \brief
+         * Creates a frame-local copy of another selection.
+         *
+         * \param[in] other  Selection to copy.
+         * \throws    std::bad_alloc if out of memory.
+         *
+         * The copy shares the evaluation tree with \p other, but has its own
+         * storage for the evaluated positions, sized for the maximal
+         * selection.  It cannot be evaluated itself; copyFrameData() is used
+         * to update it after \p other has been evaluated for a frame.
+         *
+         * Used by FrameLocalSelections.
+         */
+        SelectionData(const SelectionData &other);
         ~SelectionData();
 
         //! Returns the name for this selection.
@@ -184,6 +198,19 @@ class SelectionData
          * Called by SelectionEvaluator::evaluateFinal().
          */
         void restoreOriginalPositions(const t_topology *top);
+        /*! \brief
+         * Copies the evaluated state for the current frame from another selection.
+         *
+         * \param[in] source  Selection to copy the state from.
+         * \throws    std::bad_alloc if out of memory.
+         *
+         * \p source should be the selection this object was copied from.
+         * Memory is only allocated if the positions in \p source do not fit
+         * into what was reserved earlier.
+         *
+         * Used by FrameLocalSelections.
+         */
+        void copyFrameData(const SelectionData &source);
 
     private:
         //! Name of the selection.
@@ -219,7 +246,7 @@ class SelectionData
          */
         friend class gmx::SelectionPosition;
 
-        GMX_DISALLOW_COPY_AND_ASSIGN(SelectionData);
+        GMX_DISALLOW_ASSIGN(SelectionData);
 };
 
 }   // namespace internal
@@ -367,6 +367,10 @@ class SelectionCollection
          * Needed for the evaluator to freely modify the collection.
          */
         friend class SelectionEvaluator;
+        /*! \brief
+         * Needed for copying the evaluated selections.
+         */
+        friend class FrameLocalSelections;
 };
 
 } // namespace gmx
@@ -276,10 +276,8 @@ evaluate_distance(t_topology * /* top */, t_trxframe * /* fr */, t_pbc * /* pbc
     t_methoddata_distance *d = static_cast<t_methoddata_distance *>(data);
 
     out->nr = pos->count();
-    for (int i = 0; i < pos->count(); ++i)
-    {
-        out->u.r[i] = d->nbsearch.minimumDistance(pos->x[i]);
-    }
+    d->nbsearch.minimumDistances(gmx::AnalysisNeighborhoodPositions(pos->x, pos->count()),
+                                 gmx::arrayRefFromArray(out->u.r, pos->count()));
 }
 
 /*!
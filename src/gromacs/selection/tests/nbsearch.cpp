@@ -149,6 +149,8 @@ class NeighborhoodSearchTestData
         void generateRandomPosition(rvec x);
         void generateRandomRefPositions(int count);
         void generateRandomTestPositions(int count);
+        void displaceRefPositions(real maxDisplacement);
+        void scaleBoxAndRefPositions(real factor);
         void computeReferences(t_pbc *pbc)
         {
             computeReferencesInternal(pbc, false);
@@ -240,6 +242,29 @@ void NeighborhoodSearchTestData::generateRandomTestPositions(int count)
     }
 }
 
+void NeighborhoodSearchTestData::displaceRefPositions(real maxDisplacement)
+{
+    for (int i = 0; i < refPosCount_; ++i)
+    {
+        for (int d = 0; d < DIM; ++d)
+        {
+            refPos_[i][d] += maxDisplacement * (2 * gmx_rng_uniform_real(rng_) - 1);
+        }
+    }
+}
+
+void NeighborhoodSearchTestData::scaleBoxAndRefPositions(real factor)
+{
+    for (int d = 0; d < DIM; ++d)
+    {
+        svmul(factor, box_[d], box_[d]);
+    }
+    for (int i = 0; i < refPosCount_; ++i)
+    {
+        svmul(factor, refPos_[i], refPos_[i]);
+    }
+}
+
 void NeighborhoodSearchTestData::computeReferencesInternal(t_pbc *pbc, bool bXY)
 {
     real cutoff = cutoff_;
@@ -431,6 +456,16 @@ void NeighborhoodSearchTest::testMinimumDistance(
         EXPECT_REAL_EQ_TOL(refDist, search->minimumDistance(i->x),
                            gmx::test::ulpTolerance(20));
     }
+
+    std::vector<real> distances(data.testPositions_.size());
+    search->minimumDistances(data.testPositions(),
+                             gmx::arrayRefFromVector<real>(distances.begin(), distances.end()));
+    for (size_t j = 0; j < data.testPositions_.size(); ++j)
+    {
+        EXPECT_REAL_EQ_TOL(data.testPositions_[j].refMinDist, distances[j],
+                           gmx::test::ulpTolerance(20))
+        << "Test position " << j;
+    }
 }
 
 void NeighborhoodSearchTest::testNearestPoint(
@@ -885,6 +920,100 @@ TEST_F(NeighborhoodSearchTest, GridSearchXYBox)
     testPairSearch(&search, data);
 }
 
+TEST_F(NeighborhoodSearchTest, GridSearchBuffered)
+{
+    NeighborhoodSearchTestData data(12345, 1.0);
+    data.box_[XX][XX] = 10.0;
+    data.box_[YY][YY] = 5.0;
+    data.box_[ZZ][ZZ] = 7.0;
+    data.generateRandomRefPositions(1000);
+    data.generateRandomTestPositions(100);
+    set_pbc(&data.pbc_, epbcXYZ, data.box_);
+    data.computeReferences(&data.pbc_);
+
+    nb_.setCutoff(data.cutoff_);
+    nb_.setBuffer(0.2);
+    nb_.setMode(gmx::AnalysisNeighborhood::eSearchMode_Grid);
+    {
+        gmx::AnalysisNeighborhoodSearch search =
+            nb_.initSearch(&data.pbc_, data.refPositions());
+        ASSERT_EQ(gmx::AnalysisNeighborhood::eSearchMode_Grid, search.mode());
+        testPairSearch(&search, data);
+    }
+    // Moves that keep the grid.
+    for (int frame = 0; frame < 3; ++frame)
+    {
+        data.displaceRefPositions(0.02);
+        data.computeReferences(&data.pbc_);
+        gmx::AnalysisNeighborhoodSearch search =
+            nb_.initSearch(&data.pbc_, data.refPositions());
+        testMinimumDistance(&search, data);
+        testPairSearch(&search, data);
+    }
+    // A move that requires rebuilding the grid.
+    data.displaceRefPositions(0.5);
+    data.computeReferences(&data.pbc_);
+    {
+        gmx::AnalysisNeighborhoodSearch search =
+            nb_.initSearch(&data.pbc_, data.refPositions());
+        testMinimumDistance(&search, data);
+        testPairSearch(&search, data);
+    }
+}
+
+TEST_F(NeighborhoodSearchTest, GridSearchBufferedWithChangingBox)
+{
+    NeighborhoodSearchTestData data(12345, 1.0);
+    data.box_[XX][XX] = 10.0;
+    data.box_[YY][XX] = 1.5;
+    data.box_[YY][YY] = 5.0;
+    data.box_[ZZ][XX] = -1.0;
+    data.box_[ZZ][YY] = 1.0;
+    data.box_[ZZ][ZZ] = 7.0;
+    data.generateRandomRefPositions(1000);
+    data.generateRandomTestPositions(100);
+    // Put some positions in other periodic images, as in trajectories
+    // where molecules are kept whole.
+    for (int i = 0; i < data.refPosCount_; i += 7)
+    {
+        rvec_dec(data.refPos_[i], data.box_[i % DIM]);
+    }
+    set_pbc(&data.pbc_, epbcXYZ, data.box_);
+    data.computeReferences(&data.pbc_);
+
+    nb_.setCutoff(data.cutoff_);
+    nb_.setBuffer(0.2);
+    nb_.setMode(gmx::AnalysisNeighborhood::eSearchMode_Grid);
+    {
+        gmx::AnalysisNeighborhoodSearch search =
+            nb_.initSearch(&data.pbc_, data.refPositions());
+        ASSERT_EQ(gmx::AnalysisNeighborhood::eSearchMode_Grid, search.mode());
+        testPairSearch(&search, data);
+    }
+    // Small box changes, as with pressure coupling, that keep the grid.
+    for (int frame = 0; frame < 3; ++frame)
+    {
+        data.scaleBoxAndRefPositions(1.0005);
+        data.displaceRefPositions(0.01);
+        set_pbc(&data.pbc_, epbcXYZ, data.box_);
+        data.computeReferences(&data.pbc_);
+        gmx::AnalysisNeighborhoodSearch search =
+            nb_.initSearch(&data.pbc_, data.refPositions());
+        testMinimumDistance(&search, data);
+        testPairSearch(&search, data);
+    }
+    // A box change that requires rebuilding the grid.
+    data.scaleBoxAndRefPositions(1.02);
+    set_pbc(&data.pbc_, epbcXYZ, data.box_);
+    data.computeReferences(&data.pbc_);
+    {
+        gmx::AnalysisNeighborhoodSearch search =
+            nb_.initSearch(&data.pbc_, data.refPositions());
+        testMinimumDistance(&search, data);
+        testPairSearch(&search, data);
+    }
+}
+
 TEST_F(NeighborhoodSearchTest, HandlesConcurrentSearches)
 {
     const NeighborhoodSearchTestData &data = TrivialTestData::get();
@@ -48,6 +48,7 @@
 #include "gromacs/fileio/trx.h"
 #include "gromacs/options/basicoptions.h"
 #include "gromacs/options/options.h"
+#include "gromacs/selection/framelocalselections.h"
 #include "gromacs/selection/indexutil.h"
 #include "gromacs/selection/selection.h"
 #include "gromacs/topology/topology.h"
@@ -618,6 +619,49 @@ TEST_F(SelectionCollectionTest, HandlesFramesWithTooSmallAtomSubsets3)
 // TODO: Tests for more evaluation errors
 
 
+/********************************************************************
+ * Tests for frame-local copies of selections
+ */
+
+TEST_F(SelectionCollectionTest, CopiesDynamicSelectionsToFrameLocalCopies)
+{
+    ASSERT_NO_THROW_GMX(sel_ = sc_.parseFromString("x < 2"));
+    ASSERT_NO_FATAL_FAILURE(loadTopology("simple.gro"));
+    ASSERT_NO_THROW_GMX(sc_.compile());
+    ASSERT_EQ(1U, sel_.size());
+    gmx::FrameLocalSelections local(sc_);
+    gmx::Selection            copy = local.localSelection(sel_[0]);
+    EXPECT_TRUE(copy != sel_[0]);
+
+    ASSERT_NO_THROW_GMX(sc_.evaluate(frame_, NULL));
+    ASSERT_NO_THROW_GMX(local.copyFrom());
+    ASSERT_EQ(4, sel_[0].atomCount());
+    ASSERT_EQ(4, copy.atomCount());
+    for (int i = 0; i < 4; ++i)
+    {
+        EXPECT_EQ(i, copy.atomIndices()[i]);
+    }
+
+    // Evaluating the next frame should not change the copy.
+    for (int i = 0; i < frame_->natoms; ++i)
+    {
+        frame_->x[i][XX] -= 1.0;
+    }
+    ASSERT_NO_THROW_GMX(sc_.evaluate(frame_, NULL));
+    EXPECT_EQ(8, sel_[0].atomCount());
+    ASSERT_EQ(4, copy.atomCount());
+    EXPECT_EQ(3, copy.atomIndices()[3]);
+    EXPECT_FLOAT_EQ(1.0, copy.position(0).x()[XX]);
+
+    ASSERT_NO_THROW_GMX(local.copyFrom());
+    ASSERT_EQ(8, copy.atomCount());
+    for (int i = 0; i < 8; ++i)
+    {
+        EXPECT_EQ(i, copy.atomIndices()[i]);
+    }
+}
+
+
 /********************************************************************
  * Tests for selection keywords
  */
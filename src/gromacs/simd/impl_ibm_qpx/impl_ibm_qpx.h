@@ -54,6 +54,7 @@
 #define GMX_SIMD_HAVE_HARDWARE
 #undef  GMX_SIMD_HAVE_STOREU
 #undef  GMX_SIMD_HAVE_STOREU
+#undef  GMX_SIMD_HAVE_LOADN
 #undef  GMX_SIMD_HAVE_LOGICAL
 #define GMX_SIMD_HAVE_FMA
 #undef  GMX_SIMD_HAVE_FRACTION
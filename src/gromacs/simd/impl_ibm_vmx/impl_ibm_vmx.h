@@ -55,6 +55,7 @@
 #define GMX_SIMD_HAVE_HARDWARE
 #undef  GMX_SIMD_HAVE_LOADU
 #undef  GMX_SIMD_HAVE_STOREU
+#undef  GMX_SIMD_HAVE_LOADN
 #define GMX_SIMD_HAVE_LOGICAL
 /* VMX only provides fmadd/fnmadd (our definitions), but not fmsub/fnmsub.
  * However, fnmadd is what we need for 1/sqrt(x).
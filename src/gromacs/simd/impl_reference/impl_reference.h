@@ -80,6 +80,13 @@
 /*! \brief Defined if the SIMD implementation supports unaligned stores. */
 #define GMX_SIMD_HAVE_STOREU
 
+/*! \brief Defined if the SIMD implementation supports partial (masked) loads and stores.
+ *
+ * This provides \ref gmx_simd_loadn_f and \ref gmx_simd_storen_f, which only
+ * access the first n elements, for handling the tails of arrays.
+ */
+#define GMX_SIMD_HAVE_LOADN
+
 /*! \brief Defined if SIMD implementation has logical operations on floating-point data. */
 #define GMX_SIMD_HAVE_LOGICAL
 
@@ -362,6 +369,49 @@ gmx_simd_store_f(float *m, gmx_simd_float_t a)
  */
 #define gmx_simd_storeu_f gmx_simd_store_f
 
+/*! \brief Load the first n elements of a SIMD float from unaligned memory.
+ *
+ * Available with \ref GMX_SIMD_HAVE_LOADN. Memory beyond element n is not
+ * accessed and the remaining SIMD elements are set to zero, so this can be
+ * used for the tail of an array whose length is not a multiple of the width.
+ *
+ * \param m Pointer to memory, no alignment requirement.
+ * \param n Number of elements to load, 0 <= n <= \ref GMX_SIMD_FLOAT_WIDTH.
+ * \return SIMD variable with data loaded.
+ */
+static gmx_inline gmx_simd_float_t
+gmx_simd_loadn_f(const float *m, int n)
+{
+    gmx_simd_float_t  a;
+    int               i;
+
+    for (i = 0; i < GMX_SIMD_FLOAT_WIDTH; i++)
+    {
+        a.r[i] = (i < n) ? m[i] : 0.0f;
+    }
+    return a;
+}
+
+/*! \brief Store the first n elements of a SIMD float to unaligned memory.
+ *
+ * Available with \ref GMX_SIMD_HAVE_LOADN. Memory beyond element n is not
+ * accessed.
+ *
+ * \param[out] m Pointer to memory, no alignment requirement.
+ * \param a SIMD variable to store.
+ * \param n Number of elements to store, 0 <= n <= \ref GMX_SIMD_FLOAT_WIDTH.
+ */
+static gmx_inline void
+gmx_simd_storen_f(float *m, gmx_simd_float_t a, int n)
+{
+    int i;
+
+    for (i = 0; i < n; i++)
+    {
+        m[i] = a.r[i];
+    }
+}
+
 /*! \}
  *
  * \name SIMD implementation load/store operations for double precision floating point
@@ -468,6 +518,38 @@ gmx_simd_store_d(double *m, gmx_simd_double_t a)
  */
 #define gmx_simd_storeu_d gmx_simd_store_d
 
+/*! \brief Load the first n elements of a SIMD double from unaligned memory.
+ *
+ * \copydetails gmx_simd_loadn_f
+ */
+static gmx_inline gmx_simd_double_t
+gmx_simd_loadn_d(const double *m, int n)
+{
+    gmx_simd_double_t  a;
+    int                i;
+
+    for (i = 0; i < GMX_SIMD_DOUBLE_WIDTH; i++)
+    {
+        a.r[i] = (i < n) ? m[i] : 0.0;
+    }
+    return a;
+}
+
+/*! \brief Store the first n elements of a SIMD double to unaligned memory.
+ *
+ * \copydetails gmx_simd_storen_f
+ */
+static gmx_inline void
+gmx_simd_storen_d(double *m, gmx_simd_double_t a, int n)
+{
+    int i;
+
+    for (i = 0; i < n; i++)
+    {
+        m[i] = a.r[i];
+    }
+}
+
 /*! \}
  *
  * \name SIMD implementation load/store operations for integers (corresponding to float)
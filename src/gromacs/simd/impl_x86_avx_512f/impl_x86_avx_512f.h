@@ -0,0 +1,596 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2014,2015, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+
+#ifndef GMX_SIMD_IMPL_X86_AVX_512F_H
+#define GMX_SIMD_IMPL_X86_AVX_512F_H
+
+#include "config.h"
+
+#include <math.h>
+
+#include <immintrin.h>
+
+/* x86 512-bit AVX-512F SIMD instruction wrappers
+ *
+ * Please see documentation in gromacs/simd/simd.h for defines.
+ *
+ * Only the AVX-512 foundation instructions are used, so this works on
+ * both Xeon Phi (Knights Landing) and Xeon (Skylake-SP and later).
+ * Booleans are stored in the opmask registers, which means that blends
+ * and masked-out operations are single instructions. The integer type
+ * corresponding to double, as well as SIMD4, use 256/128-bit AVX2 and
+ * FMA instructions, which all AVX-512F hardware supports.
+ *
+ * GCC implements the unmasked forms of many AVX-512 intrinsics by
+ * merging into _mm512_undefined_*(), which triggers -Wmaybe-uninitialized
+ * once the intrinsic is inlined. We use the zero-masking forms with all
+ * mask bits set instead; these compile to the same unmasked instructions.
+ * The same holds for the casts from 512-bit to 256/128-bit registers, which
+ * GCC implements as extracts of the low part, so we use the zero-masked
+ * extracts below for those.
+ */
+#define gmx_mm512_castps512_ps256(a) _mm256_castpd_ps(_mm512_maskz_extractf64x4_pd(0xF, _mm512_castps_pd(a), 0x0))
+#define gmx_mm512_castpd512_pd256(a) _mm512_maskz_extractf64x4_pd(0xF, a, 0x0)
+#define gmx_mm512_castsi512_si256(a) _mm512_maskz_extracti64x4_epi64(0xF, a, 0x0)
+#define gmx_mm512_castps512_ps128(a) _mm512_maskz_extractf32x4_ps(0xF, a, 0x0)
+#define gmx_mm512_castsi512_si128(a) _mm512_maskz_extracti32x4_epi32(0xF, a, 0x0)
+/* The capabilities form a superset of AVX2_256, but the 256-bit group
+ * kernels use the SIMD module math functions at the native SIMD width,
+ * so we do not claim AVX_256_OR_HIGHER. Those kernels are not used with
+ * AVX-512F, the Verlet scheme kernels are.
+ */
+#define GMX_SIMD_X86_SSE2_OR_HIGHER
+#define GMX_SIMD_X86_SSE4_1_OR_HIGHER
+#define GMX_SIMD_X86_AVX_512F_OR_HIGHER
+
+/* Capability definitions for 512-bit AVX-512F */
+#define GMX_SIMD_HAVE_FLOAT
+#define GMX_SIMD_HAVE_DOUBLE
+#define GMX_SIMD_HAVE_SIMD_HARDWARE
+#define GMX_SIMD_HAVE_LOADU
+#define GMX_SIMD_HAVE_STOREU
+#define GMX_SIMD_HAVE_LOADN
+#define GMX_SIMD_HAVE_LOGICAL
+#define GMX_SIMD_HAVE_FMA
+#undef  GMX_SIMD_HAVE_FRACTION
+#define GMX_SIMD_HAVE_FINT32
+#define GMX_SIMD_HAVE_FINT32_EXTRACT     /* Emulated */
+#define GMX_SIMD_HAVE_FINT32_LOGICAL
+#define GMX_SIMD_HAVE_FINT32_ARITHMETICS
+#define GMX_SIMD_HAVE_DINT32
+#define GMX_SIMD_HAVE_DINT32_EXTRACT     /* Emulated, dint uses 256-bit SIMD */
+#define GMX_SIMD_HAVE_DINT32_LOGICAL
+#define GMX_SIMD_HAVE_DINT32_ARITHMETICS
+#define GMX_SIMD4_HAVE_FLOAT
+#define GMX_SIMD4_HAVE_DOUBLE
+
+/* Implementation details */
+#define GMX_SIMD_FLOAT_WIDTH        16
+#define GMX_SIMD_DOUBLE_WIDTH        8
+#define GMX_SIMD_FINT32_WIDTH       16
+#define GMX_SIMD_DINT32_WIDTH        8
+#ifdef __AVX512ER__
+/* Xeon Phi has 28-bit lookups in the exponential & reciprocal extension */
+#define GMX_SIMD_RSQRT_BITS         28
+#define GMX_SIMD_RCP_BITS           28
+#else
+#define GMX_SIMD_RSQRT_BITS         14
+#define GMX_SIMD_RCP_BITS           14
+#endif
+
+/****************************************************
+ *      SINGLE PRECISION SIMD IMPLEMENTATION        *
+ ****************************************************/
+#define gmx_simd_float_t           __m512
+#define gmx_simd_load_f            _mm512_load_ps
+#define gmx_simd_load1_f(m)        _mm512_set1_ps(*(m))
+#define gmx_simd_set1_f            _mm512_set1_ps
+#define gmx_simd_store_f           _mm512_store_ps
+#define gmx_simd_loadu_f           _mm512_loadu_ps
+#define gmx_simd_storeu_f          _mm512_storeu_ps
+#define gmx_simd_setzero_f         _mm512_setzero_ps
+#define gmx_simd_add_f             _mm512_add_ps
+#define gmx_simd_sub_f             _mm512_sub_ps
+#define gmx_simd_mul_f             _mm512_mul_ps
+#define gmx_simd_fmadd_f           _mm512_fmadd_ps
+#define gmx_simd_fmsub_f           _mm512_fmsub_ps
+#define gmx_simd_fnmadd_f          _mm512_fnmadd_ps
+#define gmx_simd_fnmsub_f          _mm512_fnmsub_ps
+/* AVX-512F only has logical operations on integers, AVX-512DQ adds float */
+#define gmx_simd_and_f(a, b)       _mm512_castsi512_ps(_mm512_and_epi32(_mm512_castps_si512(a), _mm512_castps_si512(b)))
+#define gmx_simd_andnot_f(a, b)    _mm512_castsi512_ps(_mm512_maskz_andnot_epi32(0xFFFF, _mm512_castps_si512(a), _mm512_castps_si512(b)))
+#define gmx_simd_or_f(a, b)        _mm512_castsi512_ps(_mm512_or_epi32(_mm512_castps_si512(a), _mm512_castps_si512(b)))
+#define gmx_simd_xor_f(a, b)       _mm512_castsi512_ps(_mm512_xor_epi32(_mm512_castps_si512(a), _mm512_castps_si512(b)))
+#ifdef __AVX512ER__
+#define gmx_simd_rsqrt_f(x)        _mm512_maskz_rsqrt28_ps(0xFFFF, x)
+#define gmx_simd_rcp_f(x)          _mm512_maskz_rcp28_ps(0xFFFF, x)
+#else
+#define gmx_simd_rsqrt_f(x)        _mm512_maskz_rsqrt14_ps(0xFFFF, x)
+#define gmx_simd_rcp_f(x)          _mm512_maskz_rcp14_ps(0xFFFF, x)
+#endif
+#define gmx_simd_fabs_f(x)         gmx_simd_andnot_f(_mm512_set1_ps(GMX_FLOAT_NEGZERO), x)
+#define gmx_simd_fneg_f(x)         gmx_simd_xor_f(x, _mm512_set1_ps(GMX_FLOAT_NEGZERO))
+#define gmx_simd_max_f(a, b)       _mm512_maskz_max_ps(0xFFFF, a, b)
+#define gmx_simd_min_f(a, b)       _mm512_maskz_min_ps(0xFFFF, a, b)
+#define gmx_simd_round_f(x)        _mm512_maskz_roundscale_ps(0xFFFF, x, _MM_FROUND_TO_NEAREST_INT)
+#define gmx_simd_trunc_f(x)        _mm512_maskz_roundscale_ps(0xFFFF, x, _MM_FROUND_TO_ZERO)
+#define gmx_simd_fraction_f(x)     _mm512_sub_ps(x, gmx_simd_trunc_f(x))
+#define gmx_simd_get_exponent_f(x) _mm512_maskz_getexp_ps(0xFFFF, x)
+#define gmx_simd_get_mantissa_f(x) _mm512_maskz_getmant_ps(0xFFFF, x, _MM_MANT_NORM_1_2, _MM_MANT_SIGN_zero)
+#define gmx_simd_set_exponent_f    gmx_simd_set_exponent_f_avx_512f
+/* integer datatype corresponding to float: gmx_simd_fint32_t */
+#define gmx_simd_fint32_t          __m512i
+#define gmx_simd_load_fi(m)        _mm512_load_si512((void const *)(m))
+#define gmx_simd_set1_fi           _mm512_set1_epi32
+#define gmx_simd_store_fi(m, x)    _mm512_store_si512((void *)(m), x)
+#define gmx_simd_loadu_fi(m)       _mm512_loadu_si512((void const *)(m))
+#define gmx_simd_storeu_fi(m, x)   _mm512_storeu_si512((void *)(m), x)
+#define gmx_simd_extract_fi        gmx_simd_extract_fi_avx_512f
+#define gmx_simd_setzero_fi        _mm512_setzero_si512
+#define gmx_simd_cvt_f2i(x)        _mm512_maskz_cvtps_epi32(0xFFFF, x)
+#define gmx_simd_cvtt_f2i(x)       _mm512_maskz_cvttps_epi32(0xFFFF, x)
+#define gmx_simd_cvt_i2f(x)        _mm512_maskz_cvtepi32_ps(0xFFFF, x)
+/* Integer logical ops on gmx_simd_fint32_t */
+#define gmx_simd_slli_fi(x, i)     _mm512_maskz_slli_epi32(0xFFFF, x, i)
+#define gmx_simd_srli_fi(x, i)     _mm512_maskz_srli_epi32(0xFFFF, x, i)
+#define gmx_simd_and_fi            _mm512_and_epi32
+#define gmx_simd_andnot_fi(a, b)   _mm512_maskz_andnot_epi32(0xFFFF, a, b)
+#define gmx_simd_or_fi             _mm512_or_epi32
+#define gmx_simd_xor_fi            _mm512_xor_epi32
+/* Integer arithmetic ops on gmx_simd_fint32_t */
+#define gmx_simd_add_fi            _mm512_add_epi32
+#define gmx_simd_sub_fi            _mm512_sub_epi32
+#define gmx_simd_mul_fi            _mm512_mullo_epi32
+/* Boolean & comparison operations on gmx_simd_float_t */
+#define gmx_simd_fbool_t           __mmask16
+#define gmx_simd_cmpeq_f(a, b)     _mm512_cmp_ps_mask(a, b, _CMP_EQ_OQ)
+#define gmx_simd_cmplt_f(a, b)     _mm512_cmp_ps_mask(a, b, _CMP_LT_OQ)
+#define gmx_simd_cmple_f(a, b)     _mm512_cmp_ps_mask(a, b, _CMP_LE_OQ)
+#define gmx_simd_and_fb            _mm512_kand
+#define gmx_simd_or_fb             _mm512_kor
+#define gmx_simd_anytrue_fb        _mm512_mask2int
+#define gmx_simd_blendzero_f(a, sel)    _mm512_maskz_mov_ps(sel, a)
+#define gmx_simd_blendnotzero_f(a, sel) _mm512_maskz_mov_ps(_mm512_knot(sel), a)
+#define gmx_simd_blendv_f(a, b, sel)    _mm512_mask_blend_ps(sel, a, b)
+#define gmx_simd_reduce_f          gmx_simd_reduce_f_avx_512f
+/* Boolean & comparison operations on gmx_simd_fint32_t */
+#define gmx_simd_fibool_t          __mmask16
+#define gmx_simd_cmpeq_fi(a, b)    _mm512_cmpeq_epi32_mask(a, b)
+#define gmx_simd_cmplt_fi(a, b)    _mm512_cmplt_epi32_mask(a, b)
+#define gmx_simd_and_fib           _mm512_kand
+#define gmx_simd_or_fib            _mm512_kor
+#define gmx_simd_anytrue_fib       _mm512_mask2int
+#define gmx_simd_blendzero_fi(a, sel)    _mm512_maskz_mov_epi32(sel, a)
+#define gmx_simd_blendnotzero_fi(a, sel) _mm512_maskz_mov_epi32(_mm512_knot(sel), a)
+#define gmx_simd_blendv_fi(a, b, sel)    _mm512_mask_blend_epi32(sel, a, b)
+/* Conversions between different booleans */
+#define gmx_simd_cvt_fb2fib(x)     (x)
+#define gmx_simd_cvt_fib2fb(x)     (x)
+
+/****************************************************
+ *      DOUBLE PRECISION SIMD IMPLEMENTATION        *
+ ****************************************************/
+#define gmx_simd_double_t          __m512d
+#define gmx_simd_load_d            _mm512_load_pd
+#define gmx_simd_load1_d(m)        _mm512_set1_pd(*(m))
+#define gmx_simd_set1_d            _mm512_set1_pd
+#define gmx_simd_store_d           _mm512_store_pd
+#define gmx_simd_loadu_d           _mm512_loadu_pd
+#define gmx_simd_storeu_d          _mm512_storeu_pd
+#define gmx_simd_setzero_d         _mm512_setzero_pd
+#define gmx_simd_add_d             _mm512_add_pd
+#define gmx_simd_sub_d             _mm512_sub_pd
+#define gmx_simd_mul_d             _mm512_mul_pd
+#define gmx_simd_fmadd_d           _mm512_fmadd_pd
+#define gmx_simd_fmsub_d           _mm512_fmsub_pd
+#define gmx_simd_fnmadd_d          _mm512_fnmadd_pd
+#define gmx_simd_fnmsub_d          _mm512_fnmsub_pd
+#define gmx_simd_and_d(a, b)       _mm512_castsi512_pd(_mm512_and_epi64(_mm512_castpd_si512(a), _mm512_castpd_si512(b)))
+#define gmx_simd_andnot_d(a, b)    _mm512_castsi512_pd(_mm512_maskz_andnot_epi64(0xFF, _mm512_castpd_si512(a), _mm512_castpd_si512(b)))
+#define gmx_simd_or_d(a, b)        _mm512_castsi512_pd(_mm512_or_epi64(_mm512_castpd_si512(a), _mm512_castpd_si512(b)))
+#define gmx_simd_xor_d(a, b)       _mm512_castsi512_pd(_mm512_xor_epi64(_mm512_castpd_si512(a), _mm512_castpd_si512(b)))
+#ifdef __AVX512ER__
+#define gmx_simd_rsqrt_d(x)        _mm512_maskz_rsqrt28_pd(0xFF, x)
+#define gmx_simd_rcp_d(x)          _mm512_maskz_rcp28_pd(0xFF, x)
+#else
+#define gmx_simd_rsqrt_d(x)        _mm512_maskz_rsqrt14_pd(0xFF, x)
+#define gmx_simd_rcp_d(x)          _mm512_maskz_rcp14_pd(0xFF, x)
+#endif
+#define gmx_simd_fabs_d(x)         gmx_simd_andnot_d(_mm512_set1_pd(GMX_DOUBLE_NEGZERO), x)
+#define gmx_simd_fneg_d(x)         gmx_simd_xor_d(x, _mm512_set1_pd(GMX_DOUBLE_NEGZERO))
+#define gmx_simd_max_d(a, b)       _mm512_maskz_max_pd(0xFF, a, b)
+#define gmx_simd_min_d(a, b)       _mm512_maskz_min_pd(0xFF, a, b)
+#define gmx_simd_round_d(x)        _mm512_maskz_roundscale_pd(0xFF, x, _MM_FROUND_TO_NEAREST_INT)
+#define gmx_simd_trunc_d(x)        _mm512_maskz_roundscale_pd(0xFF, x, _MM_FROUND_TO_ZERO)
+#define gmx_simd_fraction_d(x)     _mm512_sub_pd(x, gmx_simd_trunc_d(x))
+#define gmx_simd_get_exponent_d(x) _mm512_maskz_getexp_pd(0xFF, x)
+#define gmx_simd_get_mantissa_d(x) _mm512_maskz_getmant_pd(0xFF, x, _MM_MANT_NORM_1_2, _MM_MANT_SIGN_zero)
+#define gmx_simd_set_exponent_d    gmx_simd_set_exponent_d_avx_512f
+/* integer datatype corresponding to double: gmx_simd_dint32_t */
+#define gmx_simd_dint32_t          __m256i
+#define gmx_simd_load_di(m)        _mm256_load_si256((__m256i const *)(m))
+#define gmx_simd_set1_di           _mm256_set1_epi32
+#define gmx_simd_store_di(m, x)    _mm256_store_si256((__m256i *)(m), x)
+#define gmx_simd_loadu_di(m)       _mm256_loadu_si256((__m256i const *)(m))
+#define gmx_simd_storeu_di(m, x)   _mm256_storeu_si256((__m256i *)(m), x)
+#define gmx_simd_extract_di        gmx_simd_extract_di_avx_512f
+#define gmx_simd_setzero_di        _mm256_setzero_si256
+#define gmx_simd_cvt_d2i(x)        _mm512_maskz_cvtpd_epi32(0xFF, x)
+#define gmx_simd_cvtt_d2i(x)       _mm512_maskz_cvttpd_epi32(0xFF, x)
+#define gmx_simd_cvt_i2d(x)        _mm512_maskz_cvtepi32_pd(0xFF, x)
+/* Integer logical ops on gmx_simd_dint32_t */
+#define gmx_simd_slli_di           _mm256_slli_epi32
+#define gmx_simd_srli_di           _mm256_srli_epi32
+#define gmx_simd_and_di            _mm256_and_si256
+#define gmx_simd_andnot_di         _mm256_andnot_si256
+#define gmx_simd_or_di             _mm256_or_si256
+#define gmx_simd_xor_di            _mm256_xor_si256
+/* Integer arithmetic ops on gmx_simd_dint32_t */
+#define gmx_simd_add_di            _mm256_add_epi32
+#define gmx_simd_sub_di            _mm256_sub_epi32
+#define gmx_simd_mul_di            _mm256_mullo_epi32
+/* Boolean & comparison operations on gmx_simd_double_t */
+#define gmx_simd_dbool_t           __mmask8
+#define gmx_simd_cmpeq_d(a, b)     _mm512_cmp_pd_mask(a, b, _CMP_EQ_OQ)
+#define gmx_simd_cmplt_d(a, b)     _mm512_cmp_pd_mask(a, b, _CMP_LT_OQ)
+#define gmx_simd_cmple_d(a, b)     _mm512_cmp_pd_mask(a, b, _CMP_LE_OQ)
+/* AVX-512F has no 8-bit mask instructions, but the compiler handles these */
+#define gmx_simd_and_db(a, b)      ((__mmask8)((a) & (b)))
+#define gmx_simd_or_db(a, b)       ((__mmask8)((a) | (b)))
+#define gmx_simd_anytrue_db(x)     ((int)(x))
+#define gmx_simd_blendzero_d(a, sel)    _mm512_maskz_mov_pd(sel, a)
+#define gmx_simd_blendnotzero_d(a, sel) _mm512_maskz_mov_pd((__mmask8)(~(sel)), a)
+#define gmx_simd_blendv_d(a, b, sel)    _mm512_mask_blend_pd(sel, a, b)
+#define gmx_simd_reduce_d          gmx_simd_reduce_d_avx_512f
+/* Boolean & comparison operations on gmx_simd_dint32_t */
+#define gmx_simd_dibool_t          __m256i
+#define gmx_simd_cmpeq_di          _mm256_cmpeq_epi32
+#define gmx_simd_cmplt_di(a, b)    _mm256_cmpgt_epi32(b, a)
+#define gmx_simd_and_dib           _mm256_and_si256
+#define gmx_simd_or_dib            _mm256_or_si256
+#define gmx_simd_anytrue_dib       _mm256_movemask_epi8
+#define gmx_simd_blendzero_di      _mm256_and_si256
+#define gmx_simd_blendnotzero_di(a, sel) _mm256_andnot_si256(sel, a)
+#define gmx_simd_blendv_di         _mm256_blendv_epi8
+/* Conversions between different booleans */
+#define gmx_simd_cvt_db2dib        gmx_simd_cvt_db2dib_avx_512f
+#define gmx_simd_cvt_dib2db        gmx_simd_cvt_dib2db_avx_512f
+/* Float/double conversion */
+#define gmx_simd_cvt_f2dd          gmx_simd_cvt_f2dd_avx_512f
+#define gmx_simd_cvt_dd2f          gmx_simd_cvt_dd2f_avx_512f
+
+/****************************************************
+ *      SINGLE PRECISION SIMD4 IMPLEMENTATION       *
+ ****************************************************/
+#define gmx_simd4_float_t          __m128
+#define gmx_simd4_load_f           _mm_load_ps
+#define gmx_simd4_load1_f          _mm_broadcast_ss
+#define gmx_simd4_set1_f           _mm_set1_ps
+#define gmx_simd4_store_f          _mm_store_ps
+#define gmx_simd4_loadu_f          _mm_loadu_ps
+#define gmx_simd4_storeu_f         _mm_storeu_ps
+#define gmx_simd4_setzero_f        _mm_setzero_ps
+#define gmx_simd4_add_f            _mm_add_ps
+#define gmx_simd4_sub_f            _mm_sub_ps
+#define gmx_simd4_mul_f            _mm_mul_ps
+#define gmx_simd4_fmadd_f          _mm_fmadd_ps
+#define gmx_simd4_fmsub_f          _mm_fmsub_ps
+#define gmx_simd4_fnmadd_f         _mm_fnmadd_ps
+#define gmx_simd4_fnmsub_f         _mm_fnmsub_ps
+#define gmx_simd4_and_f            _mm_and_ps
+#define gmx_simd4_andnot_f         _mm_andnot_ps
+#define gmx_simd4_or_f             _mm_or_ps
+#define gmx_simd4_xor_f            _mm_xor_ps
+#define gmx_simd4_rsqrt_f          gmx_simd4_rsqrt_f_avx_512f
+#define gmx_simd4_fabs_f(x)        _mm_andnot_ps(_mm_set1_ps(GMX_FLOAT_NEGZERO), x)
+#define gmx_simd4_fneg_f(x)        _mm_xor_ps(x, _mm_set1_ps(GMX_FLOAT_NEGZERO))
+#define gmx_simd4_max_f            _mm_max_ps
+#define gmx_simd4_min_f            _mm_min_ps
+#define gmx_simd4_round_f(x)       _mm_round_ps(x, _MM_FROUND_NINT)
+#define gmx_simd4_trunc_f(x)       _mm_round_ps(x, _MM_FROUND_TRUNC)
+#define gmx_simd4_dotproduct3_f    gmx_simd4_dotproduct3_f_avx_512f
+#define gmx_simd4_fbool_t          __m128
+#define gmx_simd4_cmpeq_f          _mm_cmpeq_ps
+#define gmx_simd4_cmplt_f          _mm_cmplt_ps
+#define gmx_simd4_cmple_f          _mm_cmple_ps
+#define gmx_simd4_and_fb           _mm_and_ps
+#define gmx_simd4_or_fb            _mm_or_ps
+#define gmx_simd4_anytrue_fb       _mm_movemask_ps
+#define gmx_simd4_blendzero_f      _mm_and_ps
+#define gmx_simd4_blendnotzero_f(a, sel)  _mm_andnot_ps(sel, a)
+#define gmx_simd4_blendv_f         _mm_blendv_ps
+#define gmx_simd4_reduce_f         gmx_simd4_reduce_f_avx_512f
+
+/****************************************************
+ *      DOUBLE PRECISION SIMD4 IMPLEMENTATION       *
+ ****************************************************/
+#define gmx_simd4_double_t          __m256d
+#define gmx_simd4_load_d            _mm256_load_pd
+#define gmx_simd4_load1_d           _mm256_broadcast_sd
+#define gmx_simd4_set1_d            _mm256_set1_pd
+#define gmx_simd4_store_d           _mm256_store_pd
+#define gmx_simd4_loadu_d           _mm256_loadu_pd
+#define gmx_simd4_storeu_d          _mm256_storeu_pd
+#define gmx_simd4_setzero_d         _mm256_setzero_pd
+#define gmx_simd4_add_d             _mm256_add_pd
+#define gmx_simd4_sub_d             _mm256_sub_pd
+#define gmx_simd4_mul_d             _mm256_mul_pd
+#define gmx_simd4_fmadd_d           _mm256_fmadd_pd
+#define gmx_simd4_fmsub_d           _mm256_fmsub_pd
+#define gmx_simd4_fnmadd_d          _mm256_fnmadd_pd
+#define gmx_simd4_fnmsub_d          _mm256_fnmsub_pd
+#define gmx_simd4_and_d             _mm256_and_pd
+#define gmx_simd4_andnot_d          _mm256_andnot_pd
+#define gmx_simd4_or_d              _mm256_or_pd
+#define gmx_simd4_xor_d             _mm256_xor_pd
+#define gmx_simd4_rsqrt_d           gmx_simd4_rsqrt_d_avx_512f
+#define gmx_simd4_fabs_d(x)         _mm256_andnot_pd(_mm256_set1_pd(GMX_DOUBLE_NEGZERO), x)
+#define gmx_simd4_fneg_d(x)         _mm256_xor_pd(x, _mm256_set1_pd(GMX_DOUBLE_NEGZERO))
+#define gmx_simd4_max_d             _mm256_max_pd
+#define gmx_simd4_min_d             _mm256_min_pd
+#define gmx_simd4_round_d(x)        _mm256_round_pd(x, _MM_FROUND_NINT)
+#define gmx_simd4_trunc_d(x)        _mm256_round_pd(x, _MM_FROUND_TRUNC)
+#define gmx_simd4_dotproduct3_d     gmx_simd4_dotproduct3_d_avx_512f
+#define gmx_simd4_dbool_t           __m256d
+#define gmx_simd4_cmpeq_d(a, b)     _mm256_cmp_pd(a, b, _CMP_EQ_OQ)
+#define gmx_simd4_cmplt_d(a, b)     _mm256_cmp_pd(a, b, _CMP_LT_OQ)
+#define gmx_simd4_cmple_d(a, b)     _mm256_cmp_pd(a, b, _CMP_LE_OQ)
+#define gmx_simd4_and_db            _mm256_and_pd
+#define gmx_simd4_or_db             _mm256_or_pd
+#define gmx_simd4_anytrue_db        _mm256_movemask_pd
+#define gmx_simd4_blendzero_d       _mm256_and_pd
+#define gmx_simd4_blendnotzero_d(a, sel)  _mm256_andnot_pd(sel, a)
+#define gmx_simd4_blendv_d          _mm256_blendv_pd
+#define gmx_simd4_reduce_d          gmx_simd4_reduce_d_avx_512f
+/* SIMD4 float/double conversion */
+#define gmx_simd4_cvt_f2d           _mm256_cvtps_pd
+#define gmx_simd4_cvt_d2f           _mm256_cvtpd_ps
+
+/* Masked loads and stores of the first n (0<=n<=width) elements.
+ * These do not touch memory beyond element n, and the remaining
+ * elements are zeroed on load, so they can be used for the tails
+ * of arrays whose length is not a multiple of the SIMD width.
+ */
+#define gmx_simd_loadn_f(m, n)      _mm512_maskz_loadu_ps(gmx_simd_nmask_avx_512f(n), m)
+#define gmx_simd_storen_f(m, a, n)  _mm512_mask_storeu_ps(m, gmx_simd_nmask_avx_512f(n), a)
+#define gmx_simd_loadn_d(m, n)      _mm512_maskz_loadu_pd((__mmask8)gmx_simd_nmask_avx_512f(n), m)
+#define gmx_simd_storen_d(m, a, n)  _mm512_mask_storeu_pd(m, (__mmask8)gmx_simd_nmask_avx_512f(n), a)
+
+/*********************************************************
+ * SIMD SINGLE PRECISION IMPLEMENTATION HELPER FUNCTIONS *
+ *********************************************************/
+static gmx_inline __m512 gmx_simdcall
+gmx_simd_set_exponent_f_avx_512f(__m512 a)
+{
+    const __m512i expbias      = _mm512_set1_epi32(127);
+    __m512i       iexp         = gmx_simd_cvt_f2i(a);
+
+    iexp = gmx_simd_slli_fi(_mm512_add_epi32(iexp, expbias), 23);
+    return _mm512_castsi512_ps(iexp);
+}
+
+static gmx_inline __mmask16 gmx_simdcall
+gmx_simd_nmask_avx_512f(int n)
+{
+    return _mm512_int2mask((1 << n) - 1);
+}
+
+static gmx_inline float gmx_simdcall
+gmx_simd_reduce_f_avx_512f(__m512 a)
+{
+    __m256 t0;
+    __m128 t1;
+
+    t0 = _mm256_add_ps(gmx_mm512_castps512_ps256(a),
+                       _mm256_castpd_ps(_mm512_maskz_extractf64x4_pd(0xF, _mm512_castps_pd(a), 0x1)));
+    t1 = _mm_add_ps(_mm256_castps256_ps128(t0), _mm256_extractf128_ps(t0, 0x1));
+    t1 = _mm_add_ps(t1, _mm_permute_ps(t1, _MM_SHUFFLE(1, 0, 3, 2)));
+    t1 = _mm_add_ss(t1, _mm_permute_ps(t1, _MM_SHUFFLE(0, 3, 2, 1)));
+    return _mm_cvtss_f32(t1);
+}
+
+static gmx_inline gmx_int32_t gmx_simdcall
+gmx_simd_extract_fi_avx_512f(__m512i a, int index)
+{
+    /* Move the requested element to position 0 of the lowest lane */
+    a = _mm512_maskz_permutexvar_epi32(0xFFFF, _mm512_set1_epi32(index), a);
+    return _mm_cvtsi128_si32(gmx_mm512_castsi512_si128(a));
+}
+
+/*********************************************************
+ * SIMD DOUBLE PRECISION IMPLEMENTATION HELPER FUNCTIONS *
+ *********************************************************/
+static gmx_inline __m512d gmx_simdcall
+gmx_simd_set_exponent_d_avx_512f(__m512d a)
+{
+    const __m512i expbias      = _mm512_set1_epi64(1023LL);
+    __m512i       iexp         = _mm512_maskz_cvtepi32_epi64(0xFF, gmx_simd_cvt_d2i(a));
+
+    iexp = _mm512_maskz_slli_epi64(0xFF, _mm512_add_epi64(iexp, expbias), 52);
+    return _mm512_castsi512_pd(iexp);
+}
+
+static gmx_inline double gmx_simdcall
+gmx_simd_reduce_d_avx_512f(__m512d a)
+{
+    __m256d t0;
+    __m128d t1;
+
+    t0 = _mm256_add_pd(gmx_mm512_castpd512_pd256(a), _mm512_maskz_extractf64x4_pd(0xF, a, 0x1));
+    t1 = _mm_add_pd(_mm256_castpd256_pd128(t0), _mm256_extractf128_pd(t0, 0x1));
+    t1 = _mm_add_sd(t1, _mm_permute_pd(t1, 0x1));
+    return _mm_cvtsd_f64(t1);
+}
+
+static gmx_inline gmx_int32_t gmx_simdcall
+gmx_simd_extract_di_avx_512f(__m256i a, int index)
+{
+    a = _mm256_permutevar8x32_epi32(a, _mm256_set1_epi32(index));
+    return _mm_cvtsi128_si32(_mm256_castsi256_si128(a));
+}
+
+static gmx_inline __m256i gmx_simdcall
+gmx_simd_cvt_db2dib_avx_512f(__mmask8 a)
+{
+    return gmx_mm512_castsi512_si256(_mm512_maskz_set1_epi32((__mmask16)a, -1));
+}
+
+static gmx_inline __mmask8 gmx_simdcall
+gmx_simd_cvt_dib2db_avx_512f(__m256i a)
+{
+    /* Only the lower 8 mask bits correspond to the 256-bit argument */
+    return (__mmask8)_mm512_mask_test_epi32_mask(_mm512_int2mask(0xFF),
+                                                 _mm512_castsi256_si512(a),
+                                                 _mm512_castsi256_si512(a));
+}
+
+static gmx_inline void gmx_simdcall
+gmx_simd_cvt_f2dd_avx_512f(__m512 f, __m512d *d0, __m512d *d1)
+{
+    *d0 = _mm512_maskz_cvtps_pd(0xFF, gmx_mm512_castps512_ps256(f));
+    *d1 = _mm512_maskz_cvtps_pd(0xFF, _mm256_castpd_ps(_mm512_maskz_extractf64x4_pd(0xF, _mm512_castps_pd(f), 0x1)));
+}
+
+static gmx_inline __m512 gmx_simdcall
+gmx_simd_cvt_dd2f_avx_512f(__m512d d0, __m512d d1)
+{
+    __m256 f0 = _mm512_maskz_cvtpd_ps(0xFF, d0);
+    __m256 f1 = _mm512_maskz_cvtpd_ps(0xFF, d1);
+    return _mm512_castpd_ps(_mm512_maskz_insertf64x4(0xFF, _mm512_castpd256_pd512(_mm256_castps_pd(f0)),
+                                                     _mm256_castps_pd(f1), 0x1));
+}
+
+/*********************************************************
+ * SIMD4 IMPLEMENTATION HELPER FUNCTIONS                 *
+ *********************************************************/
+/* Use the 14-bit AVX-512F lookup also for SIMD4, since the number of
+ * Newton-Raphson iterations is set by GMX_SIMD_RSQRT_BITS. The mask
+ * restricts the operation to the elements we use, so the undefined
+ * upper elements of the cast argument are never read.
+ */
+static gmx_inline __m128 gmx_simdcall
+gmx_simd4_rsqrt_f_avx_512f(__m128 x)
+{
+#ifdef __AVX512ER__
+    return gmx_mm512_castps512_ps128(_mm512_maskz_rsqrt28_ps(0xF, _mm512_castps128_ps512(x)));
+#else
+    return gmx_mm512_castps512_ps128(_mm512_maskz_rsqrt14_ps(0xF, _mm512_castps128_ps512(x)));
+#endif
+}
+
+static gmx_inline __m256d gmx_simdcall
+gmx_simd4_rsqrt_d_avx_512f(__m256d x)
+{
+#ifdef __AVX512ER__
+    return gmx_mm512_castpd512_pd256(_mm512_maskz_rsqrt28_pd(0xF, _mm512_castpd256_pd512(x)));
+#else
+    return gmx_mm512_castpd512_pd256(_mm512_maskz_rsqrt14_pd(0xF, _mm512_castpd256_pd512(x)));
+#endif
+}
+
+static gmx_inline float gmx_simdcall
+gmx_simd4_reduce_f_avx_512f(__m128 a)
+{
+    float f;
+    a = _mm_hadd_ps(a, a);
+    a = _mm_hadd_ps(a, a);
+    _mm_store_ss(&f, a);
+    return f;
+}
+
+static gmx_inline float gmx_simdcall
+gmx_simd4_dotproduct3_f_avx_512f(__m128 a, __m128 b)
+{
+    float  f;
+    __m128 c;
+    a = _mm_mul_ps(a, b);
+    c = _mm_add_ps(a, _mm_permute_ps(a, _MM_SHUFFLE(0, 3, 2, 1)));
+    c = _mm_add_ps(c, _mm_permute_ps(a, _MM_SHUFFLE(1, 0, 3, 2)));
+    _mm_store_ss(&f, c);
+    return f;
+}
+
+static gmx_inline double gmx_simdcall
+gmx_simd4_reduce_d_avx_512f(__m256d a)
+{
+    double  d;
+    __m128d a0, a1;
+    a  = _mm256_hadd_pd(a, a);
+    a0 = _mm256_castpd256_pd128(a);
+    a1 = _mm256_extractf128_pd(a, 0x1);
+    a0 = _mm_add_sd(a0, a1);
+    _mm_store_sd(&d, a0);
+    return d;
+}
+
+static gmx_inline double gmx_simdcall
+gmx_simd4_dotproduct3_d_avx_512f(__m256d a, __m256d b)
+{
+    double  d;
+    __m128d tmp1, tmp2;
+    a    = _mm256_mul_pd(a, b);
+    tmp1 = _mm256_castpd256_pd128(a);
+    tmp2 = _mm256_extractf128_pd(a, 0x1);
+
+    tmp1 = _mm_add_pd(tmp1, _mm_permute_pd(tmp1, _MM_SHUFFLE2(0, 1)));
+    tmp1 = _mm_add_pd(tmp1, tmp2);
+    _mm_store_sd(&d, tmp1);
+    return d;
+}
+
+/* Function to check whether SIMD operations have resulted in overflow */
+static int
+gmx_simd_check_and_reset_overflow(void)
+{
+    int MXCSR;
+    int sse_overflow;
+
+    MXCSR = _mm_getcsr();
+    /* The overflow flag is bit 3 in the register */
+    if (MXCSR & 0x0008)
+    {
+        sse_overflow = 1;
+        /* Set the overflow flag to zero */
+        MXCSR = MXCSR & 0xFFF7;
+        _mm_setcsr(MXCSR);
+    }
+    else
+    {
+        sse_overflow = 0;
+    }
+    return sse_overflow;
+}
+
+#endif /* GMX_SIMD_IMPL_X86_AVX_512F_H */
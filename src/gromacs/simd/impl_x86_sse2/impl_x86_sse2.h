@@ -56,6 +56,7 @@
 #define GMX_SIMD_HAVE_HARDWARE
 #define GMX_SIMD_HAVE_LOADU
 #define GMX_SIMD_HAVE_STOREU
+#undef  GMX_SIMD_HAVE_LOADN
 #define GMX_SIMD_HAVE_LOGICAL
 #undef  GMX_SIMD_HAVE_FMA
 #undef  GMX_SIMD_HAVE_FRACTION
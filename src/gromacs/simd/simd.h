@@ -113,6 +113,8 @@ static gmx_inline double * gmx_simd4_align_d(double *p);
  */
 #if defined GMX_SIMD_X86_MIC
 #    include "impl_intel_mic/impl_intel_mic.h"
+#elif defined GMX_SIMD_X86_AVX_512F
+#    include "impl_x86_avx_512f/impl_x86_avx_512f.h"
 #elif defined GMX_SIMD_X86_AVX2_256
 #    include "impl_x86_avx2_256/impl_x86_avx2_256.h"
 #elif defined GMX_SIMD_X86_AVX_256
@@ -338,6 +340,8 @@ gmx_simd4_align_d(double *p)
 #    define gmx_simd_store_r                 gmx_simd_store_d
 #    define gmx_simd_loadu_r                 gmx_simd_loadu_d
 #    define gmx_simd_storeu_r                gmx_simd_storeu_d
+#    define gmx_simd_loadn_r                 gmx_simd_loadn_d
+#    define gmx_simd_storen_r                gmx_simd_storen_d
 #    define gmx_simd_setzero_r               gmx_simd_setzero_d
 #    define gmx_simd_add_r                   gmx_simd_add_d
 #    define gmx_simd_sub_r                   gmx_simd_sub_d
@@ -545,6 +549,7 @@ gmx_simd4_align_d(double *p)
  *
  *  \note Unaligned load/stores are only available when
  *  \ref GMX_SIMD_HAVE_LOADU and \ref GMX_SIMD_HAVE_STOREU are set, respectively.
+ *  Partial loads/stores are only available when \ref GMX_SIMD_HAVE_LOADN is set.
  *  \{
  */
 
@@ -602,6 +607,24 @@ gmx_simd4_align_d(double *p)
  */
 #    define gmx_simd_storeu_r                gmx_simd_storeu_f
 
+/*! \brief Load the first n values from unaligned memory to \ref gmx_simd_real_t, zero the rest.
+ *
+ * If GMX_DOUBLE is defined, this will be aliased to \ref gmx_simd_loadn_d,
+ * otherwise \ref gmx_simd_loadn_f.
+ *
+ * \copydetails gmx_simd_loadn_f
+ */
+#    define gmx_simd_loadn_r                 gmx_simd_loadn_f
+
+/*! \brief Store the first n values from \ref gmx_simd_real_t to unaligned memory.
+ *
+ * If GMX_DOUBLE is defined, this will be aliased to \ref gmx_simd_storen_d,
+ * otherwise \ref gmx_simd_storen_f.
+ *
+ * \copydetails gmx_simd_storen_f
+ */
+#    define gmx_simd_storen_r                gmx_simd_storen_f
+
 /*! \brief Set all elements in \ref gmx_simd_real_t to 0.0.
  *
  * If GMX_DOUBLE is defined, this will be aliased to \ref gmx_simd_setzero_d,
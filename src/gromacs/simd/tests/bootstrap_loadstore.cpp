@@ -179,6 +179,51 @@ TEST(SimdBootstrapTest, gmxSimdStoreUR)
     }
 }
 #    endif
+
+#    ifdef GMX_SIMD_HAVE_LOADN
+TEST(SimdBootstrapTest, gmxSimdLoadNStoreNR)
+{
+    /* Use an unaligned offset and check every partial length, that the
+     * loaded elements beyond n are zero and that the store leaves the
+     * memory beyond element n alone.
+     */
+    std::vector<real> src(GMX_SIMD_REAL_WIDTH*3);
+    std::vector<real> dst(GMX_SIMD_REAL_WIDTH*3);
+    real              mem[GMX_SIMD_REAL_WIDTH*2];
+    real             *pMem = gmx_simd_align_r(mem);
+    real             *pSrc = &src[1];
+    real             *pDst = &dst[1];
+
+    for (int n = 0; n <= GMX_SIMD_REAL_WIDTH; n++)
+    {
+        for (int i = 0; i < GMX_SIMD_REAL_WIDTH*3; i++)
+        {
+            src[i] =  1+i;
+            dst[i] = -1-i;
+        }
+
+        gmx_simd_real_t v = gmx_simd_loadn_r(pSrc, n);
+        gmx_simd_storen_r(pDst, v, n);
+        gmx_simd_store_r(pMem, v);
+
+        for (int i = 0; i < GMX_SIMD_REAL_WIDTH; i++)
+        {
+            EXPECT_EQ(i < n ? pSrc[i] : 0, pMem[i]) << "Partial load wrong for element " << i << " with n = " << n;
+        }
+        for (int i = 0; i < GMX_SIMD_REAL_WIDTH*3; i++)
+        {
+            if (&dst[0]+i >= pDst && &dst[0]+i < pDst+n)
+            {
+                EXPECT_EQ(src[i], dst[i]) << "Partial store wrong for i = " << i << " with n = " << n;
+            }
+            else
+            {
+                EXPECT_EQ((real)(-1-i), dst[i]) << "Side effect on destination memory, i = " << i << " with n = " << n;
+            }
+        }
+    }
+}
+#    endif
 #endif
 
 #ifdef GMX_SIMD_HAVE_INT32
@@ -46,6 +46,7 @@
 #include <utility>
 
 #include "gromacs/analysisdata/analysisdata.h"
+#include "gromacs/selection/framelocalselections.h"
 #include "gromacs/selection/selection.h"
 #include "gromacs/utility/exceptions.h"
 #include "gromacs/utility/gmxassert.h"
@@ -120,13 +121,15 @@ class TrajectoryAnalysisModuleData::Impl
         HandleContainer            handles_;
         //! Stores thread-local selections.
         const SelectionCollection &selections_;
+        //! Frame-local selections for parallel analysis, or NULL.
+        const FrameLocalSelections *frameSelections_;
 };
 
 TrajectoryAnalysisModuleData::Impl::Impl(
         TrajectoryAnalysisModule          *module,
         const AnalysisDataParallelOptions &opt,
         const SelectionCollection         &selections)
-    : selections_(selections)
+    : selections_(selections), frameSelections_(NULL)
 {
     TrajectoryAnalysisModule::Impl::AnalysisDatasetContainer::const_iterator i;
     for (i = module->impl_->analysisDatasets_.begin();
@@ -202,11 +205,22 @@ TrajectoryAnalysisModuleData::dataHandle(const AnalysisData &data)
 
 Selection TrajectoryAnalysisModuleData::parallelSelection(const Selection &selection)
 {
-    // TODO: Implement properly.
+    if (impl_->frameSelections_ != NULL)
+    {
+        return impl_->frameSelections_->localSelection(selection);
+    }
     return selection;
 }
 
 
+void
+TrajectoryAnalysisModuleData::setFrameLocalSelections(
+        const FrameLocalSelections *selections)
+{
+    impl_->frameSelections_ = selections;
+}
+
+
 SelectionList
 TrajectoryAnalysisModuleData::parallelSelections(const SelectionList &selections)
 {
@@ -62,6 +62,7 @@ class AbstractAnalysisData;
 class AnalysisData;
 class AnalysisDataHandle;
 class AnalysisDataParallelOptions;
+class FrameLocalSelections;
 class Options;
 class SelectionCollection;
 class TopologyInformation;
@@ -141,6 +142,22 @@ class TrajectoryAnalysisModuleData
          */
         SelectionList parallelSelections(const SelectionList &selections);
 
+        /*! \brief
+         * Sets the frame-local selections returned by parallelSelection().
+         *
+         * \param[in] selections  Frame-local copies of the selections for
+         *      the frame that is analyzed next (can be NULL).
+         *
+         * This method is called by the framework before analyzeFrame() when
+         * several frames are analyzed in parallel; it should not be called
+         * from analysis modules.
+         * If \p selections is NULL (the default), parallelSelection()
+         * returns the selections from the global collection.
+         *
+         * Does not throw.
+         */
+        void setFrameLocalSelections(const FrameLocalSelections *selections);
+
     protected:
         /*! \brief
          * Initializes thread-local storage for data handles and selections.
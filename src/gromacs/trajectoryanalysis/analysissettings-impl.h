@@ -58,7 +58,7 @@ class TrajectoryAnalysisSettings::Impl
 {
     public:
         //! Initializes the default values for the settings object.
-        Impl() : flags(0), frflags(0), bRmPBC(true), bPBC(true) {}
+        Impl() : flags(0), frflags(0), bRmPBC(true), bPBC(true), nthreads(1) {}
 
         //! Global time unit setting for the analysis module.
         TimeUnitManager          timeUnitManager;
@@ -73,6 +73,8 @@ class TrajectoryAnalysisSettings::Impl
         bool                 bRmPBC;
         //! Whether to pass PBC information to the analysis module.
         bool                 bPBC;
+        //! Number of threads to use for analyzing frames in parallel.
+        int                  nthreads;
 };
 
 } // namespace gmx
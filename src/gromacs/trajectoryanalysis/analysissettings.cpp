@@ -120,6 +120,13 @@ TrajectoryAnalysisSettings::frflags() const
 }
 
 
+int
+TrajectoryAnalysisSettings::frameThreadCount() const
+{
+    return impl_->nthreads;
+}
+
+
 void
 TrajectoryAnalysisSettings::setFlags(unsigned long flags)
 {
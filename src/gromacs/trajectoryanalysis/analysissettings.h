@@ -115,6 +115,17 @@ class TrajectoryAnalysisSettings
              * \see setRmPBC()
              */
             efNoUserRmPBC    = 1<<5,
+            /*! \brief
+             * Allows analyzing multiple frames in parallel.
+             *
+             * If this flag is specified, the user can request (with \c -nt)
+             * that TrajectoryAnalysisModule::analyzeFrame() is called
+             * concurrently for different frames from multiple threads.
+             * The module should then only access thread-local data, as well
+             * as selections and data handles obtained through
+             * TrajectoryAnalysisModuleData, in analyzeFrame().
+             */
+            efAllowFrameParallel = 1<<6,
         };
 
         //! Initializes default settings.
@@ -150,6 +161,16 @@ class TrajectoryAnalysisSettings
         bool hasRmPBC() const;
         //! Returns the currently set frame flags.
         int frflags() const;
+        /*! \brief
+         * Returns the number of threads that analyze frames concurrently.
+         *
+         * Is always one unless \ref efAllowFrameParallel is set, and the
+         * user-provided value is available from
+         * TrajectoryAnalysisModule::initAnalysis() on.
+         * Modules that use OpenMP within analyzeFrame() should divide the
+         * available threads by this count.
+         */
+        int frameThreadCount() const;
 
         /*! \brief
          * Sets flags.
@@ -61,6 +61,7 @@
 #include "gromacs/utility/file.h"
 #include "gromacs/utility/gmxassert.h"
 
+#include "parallelrunner.h"
 #include "runnercommon.h"
 
 namespace gmx
@@ -202,31 +203,55 @@ TrajectoryAnalysisCommandLineRunner::run(int argc, char *argv[])
     t_pbc *ppbc = settings.hasPBC() ? &pbc : NULL;
 
     int    nframes = 0;
-    AnalysisDataParallelOptions         dataOptions;
-    TrajectoryAnalysisModuleDataPointer pdata(
-            module->startFrames(dataOptions, selections));
-    do
+    if (common.threadCount() > 1)
     {
-        common.initFrame();
-        t_trxframe &frame = common.frame();
-        if (ppbc != NULL)
+        TrajectoryAnalysisParallelRunner parallelRunner(module, selections,
+                                                        common.threadCount());
+        do
         {
-            set_pbc(ppbc, topology.ePBC(), frame.box);
-        }
+            common.initFrame();
+            t_trxframe &frame = common.frame();
+            if (ppbc != NULL)
+            {
+                set_pbc(ppbc, topology.ePBC(), frame.box);
+            }
 
-        selections.evaluate(&frame, ppbc);
-        module->analyzeFrame(nframes, frame, ppbc, pdata.get());
-        module->finishFrameSerial(nframes);
+            selections.evaluate(&frame, ppbc);
+            parallelRunner.analyzeFrame(nframes, frame, ppbc);
 
-        ++nframes;
+            ++nframes;
+        }
+        while (common.readNextFrame());
+        parallelRunner.finish();
     }
-    while (common.readNextFrame());
-    module->finishFrames(pdata.get());
-    if (pdata.get() != NULL)
+    else
     {
-        pdata->finish();
+        AnalysisDataParallelOptions         dataOptions;
+        TrajectoryAnalysisModuleDataPointer pdata(
+                module->startFrames(dataOptions, selections));
+        do
+        {
+            common.initFrame();
+            t_trxframe &frame = common.frame();
+            if (ppbc != NULL)
+            {
+                set_pbc(ppbc, topology.ePBC(), frame.box);
+            }
+
+            selections.evaluate(&frame, ppbc);
+            module->analyzeFrame(nframes, frame, ppbc, pdata.get());
+            module->finishFrameSerial(nframes);
+
+            ++nframes;
+        }
+        while (common.readNextFrame());
+        module->finishFrames(pdata.get());
+        if (pdata.get() != NULL)
+        {
+            pdata->finish();
+        }
+        pdata.reset();
     }
-    pdata.reset();
 
     if (common.hasTrajectory())
     {
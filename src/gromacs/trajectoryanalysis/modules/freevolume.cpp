@@ -43,6 +43,7 @@
 
 #include "freevolume.h"
 
+#include <algorithm>
 #include <string>
 
 #include "gromacs/analysisdata/analysisdata.h"
@@ -64,6 +65,7 @@
 #include "gromacs/trajectoryanalysis/analysissettings.h"
 #include "gromacs/utility/arrayref.h"
 #include "gromacs/utility/exceptions.h"
+#include "gromacs/utility/gmxomp.h"
 
 namespace gmx
 {
@@ -74,6 +76,16 @@ namespace analysismodules
 namespace
 {
 
+//! Number of probe insertions that are searched together.
+const int c_insertionBatchSize = 1024;
+/*! \brief
+ * Buffer (in nm) for reusing the search grid of the atoms between frames.
+ *
+ * Atoms move less than half of this between closely spaced frames, in which
+ * case only the grid coordinates need to be updated.
+ */
+const real c_gridBuffer = 0.1;
+
 /*! \brief
  * Class used to compute free volume in a simulations box.
  *
@@ -88,9 +100,6 @@ class FreeVolume : public TrajectoryAnalysisModule
         //! Constructor
         FreeVolume();
 
-        //! Destructor
-        virtual ~FreeVolume();
-
         //! Set the options and setting
         virtual void initOptions(Options                    *options,
                                  TrajectoryAnalysisSettings *settings);
@@ -110,6 +119,19 @@ class FreeVolume : public TrajectoryAnalysisModule
         virtual void writeOutput();
 
     private:
+        /*! \brief
+         * Returns the number of insertions in a range that find free volume.
+         *
+         * The random positions for insertion \p i are generated from the
+         * frame number and \p i only, so the outcome does not depend on how
+         * the insertions are split into ranges.
+         * \p end - \p start must not exceed c_insertionBatchSize, and
+         * \p start must be even.
+         */
+        int countFreeInsertions(const AnalysisNeighborhoodSearch &nbsearch,
+                                const Selection &sel, const matrix box,
+                                int frnr, int start, int end) const;
+
         std::string                       fnFreevol_;
         Selection                         sel_;
         AnalysisData                      data_;
@@ -119,7 +141,6 @@ class FreeVolume : public TrajectoryAnalysisModule
         double                            mtot_;
         double                            cutoff_;
         double                            probeRadius_;
-        gmx_rng_t                         rng_;
         int                               seed_, ninsert_;
         AnalysisNeighborhood              nb_;
         //! The van der Waals radius per atom
@@ -140,7 +161,6 @@ FreeVolume::FreeVolume()
     data_.setColumnCount(0, 2);
     // Tell the analysis framework that this component exists
     registerAnalysisDataset(&data_, "freevolume");
-    rng_         = NULL;
     nmol_        = 0;
     mtot_        = 0;
     cutoff_      = 0;
@@ -150,17 +170,6 @@ FreeVolume::FreeVolume()
 }
 
 
-FreeVolume::~FreeVolume()
-{
-    // Destroy C structures where there is no automatic memory release
-    // C++ takes care of memory in classes (hopefully)
-    if (NULL != rng_)
-    {
-        gmx_rng_destroy(rng_);
-    }
-}
-
-
 void
 FreeVolume::initOptions(Options                    *options,
                         TrajectoryAnalysisSettings *settings)
@@ -188,7 +197,9 @@ FreeVolume::initOptions(Options                    *options,
         "to get a converged result. About 1000/nm^3 yields an overall",
         "standard deviation that is determined by the fluctuations in",
         "the trajectory rather than by the fluctuations due to the",
-        "random numbers.[PAR]",
+        "random numbers.",
+        "The probe positions depend only on the seed and the frame number,",
+        "so results are reproducible independent of the number of threads.[PAR]",
         "The results are critically dependent on the van der Waals radii;",
         "we recommend to use the values due to Bondi (1964).[PAR]",
         "The Fractional Free Volume (FFV) that some authors like to use",
@@ -312,6 +323,13 @@ FreeVolume::initAnalysis(const TrajectoryAnalysisSettings &settings,
         fprintf(stderr, "Could not determine VDW radius for %d particles. These were set to zero.\n", nnovdw);
     }
 
+    // Generate a seed if none was given; the random numbers for the
+    // insertions are generated per frame from this seed
+    if (seed_ == -1)
+    {
+        seed_ = static_cast<int>(gmx_rng_make_seed());
+    }
+
     // Print parameters to output. Maybe should make dependent on
     // verbosity flag?
     printf("cutoff       = %g nm\n", cutoff_);
@@ -319,11 +337,9 @@ FreeVolume::initAnalysis(const TrajectoryAnalysisSettings &settings,
     printf("seed         = %d\n", seed_);
     printf("ninsert      = %d probes per nm^3\n", ninsert_);
 
-    // Initiate the random number generator
-    rng_ = gmx_rng_init(seed_);
-
     // Initiate the neighborsearching code
     nb_.setCutoff(cutoff_);
+    nb_.setBuffer(c_gridBuffer);
 }
 
 void
@@ -345,41 +361,21 @@ FreeVolume::analyzeFrame(int frnr, const t_trxframe &fr, t_pbc *pbc,
     // Use neighborsearching tools!
     AnalysisNeighborhoodSearch nbsearch = nb_.initSearch(pbc, sel);
 
-    // Then loop over insertions
-    int NinsTot = 0;
-    for (int i = 0; (i < Ninsert); i++)
+    // Then loop over batches of insertions; each batch is searched with a
+    // single pair search
+    const int nbatch   = (Ninsert + c_insertionBatchSize - 1)/c_insertionBatchSize;
+    const int nthreads = std::max(1, std::min(gmx_omp_get_max_threads(), nbatch));
+    int       NinsTot  = 0;
+#pragma omp parallel for num_threads(nthreads) schedule(dynamic) reduction(+:NinsTot)
+    for (int b = 0; b < nbatch; b++)
     {
-        rvec rand, ins, dx;
-
-        for (int m = 0; (m < DIM); m++)
+        try
         {
-            // Generate random number between 0 and 1
-            rand[m] = gmx_rng_uniform_real(rng_);
-        }
-        // Generate random 3D position within the box
-        mvmul(fr.box, rand, ins);
-
-        // Find the first reference position within the cutoff.
-        bool                           bOverlap = false;
-        AnalysisNeighborhoodPair       pair;
-        AnalysisNeighborhoodPairSearch pairSearch = nbsearch.startPairSearch(ins);
-        while (!bOverlap && pairSearch.findNextPair(&pair))
-        {
-            int jp = pair.refIndex();
-            // Compute distance vector to first atom in the neighborlist
-            pbc_dx(pbc, ins, sel.position(jp).x(), dx);
-
-            // See whether the distance is smaller than allowed
-            bOverlap = (norm(dx) <
-                        probeRadius_+vdw_radius_[sel.position(jp).refId()]);
-
-        }
-
-        if (!bOverlap)
-        {
-            // We found some free volume!
-            NinsTot++;
+            const int start = b*c_insertionBatchSize;
+            const int end   = std::min(start + c_insertionBatchSize, Ninsert);
+            NinsTot += countFreeInsertions(nbsearch, sel, fr.box, frnr, start, end);
         }
+        GMX_CATCH_ALL_AND_EXIT_WITH_FATAL_ERROR;
     }
     // Compute total free volume for this frame
     double frac = 0;
@@ -397,6 +393,52 @@ FreeVolume::analyzeFrame(int frnr, const t_trxframe &fr, t_pbc *pbc,
 }
 
 
+int
+FreeVolume::countFreeInsertions(const AnalysisNeighborhoodSearch &nbsearch,
+                                const Selection &sel, const matrix box,
+                                int frnr, int start, int end) const
+{
+    GMX_ASSERT(end - start <= c_insertionBatchSize && start % 2 == 0,
+               "Invalid insertion range");
+    // Three uniform random numbers are needed per insertion, and each
+    // counter value gives two, so an even start maps to a whole counter.
+    double rand[3*c_insertionBatchSize + 1];
+    rvec   ins[c_insertionBatchSize];
+    const int n = end - start;
+    for (int c = 0; 2*c < 3*n; c++)
+    {
+        gmx_rng_cycle_2uniform(frnr, 3*start/2 + c, seed_, RND_SEED_FREEVOLUME,
+                               &rand[2*c]);
+    }
+    for (int i = 0; i < n; i++)
+    {
+        // Generate random 3D position within the box
+        rvec frac;
+        frac[XX] = rand[3*i];
+        frac[YY] = rand[3*i + 1];
+        frac[ZZ] = rand[3*i + 2];
+        mvmul(box, frac, ins[i]);
+    }
+
+    // An insertion overlaps if any reference position is closer than the
+    // sum of the radii; the remaining pairs of that insertion are skipped.
+    int                            nfree = n;
+    AnalysisNeighborhoodPair       pair;
+    AnalysisNeighborhoodPairSearch pairSearch
+        = nbsearch.startPairSearch(AnalysisNeighborhoodPositions(ins, n));
+    while (pairSearch.findNextPair(&pair))
+    {
+        const real r = probeRadius_
+            + vdw_radius_[sel.position(pair.refIndex()).refId()];
+        if (pair.distance2() < r*r)
+        {
+            nfree--;
+            pairSearch.skipRemainingPairsForTestPosition();
+        }
+    }
+    return nfree;
+}
+
 void
 FreeVolume::finishAnalysis(int /* nframes */)
 {
@@ -177,7 +177,7 @@ PairDistance::PairDistance()
 
 
 void
-PairDistance::initOptions(Options *options, TrajectoryAnalysisSettings * /*settings*/)
+PairDistance::initOptions(Options *options, TrajectoryAnalysisSettings *settings)
 {
     static const char *const desc[] = {
         "[THISMODULE] calculates pairwise distances between one reference",
@@ -236,6 +236,8 @@ PairDistance::initOptions(Options *options, TrajectoryAnalysisSettings * /*setti
                            .description("Reference positions to calculate distances from"));
     options->addOption(SelectionOption("sel").storeVector(&sel_).required().multiValue()
                            .description("Positions to calculate distances for"));
+
+    settings->setFlag(TrajectoryAnalysisSettings::efAllowFrameParallel);
 }
 
 //! Helper function to initialize the grouping for a selection.
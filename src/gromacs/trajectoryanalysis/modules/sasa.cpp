@@ -71,6 +71,7 @@
 #include "gromacs/trajectoryanalysis/analysissettings.h"
 #include "gromacs/utility/exceptions.h"
 #include "gromacs/utility/futil.h"
+#include "gromacs/utility/gmxomp.h"
 #include "gromacs/utility/scoped_cptr.h"
 #include "gromacs/utility/smalloc.h"
 #include "gromacs/utility/stringutil.h"
@@ -286,6 +287,7 @@ class Sasa : public TrajectoryAnalysisModule
 {
     public:
         Sasa();
+        virtual ~Sasa();
 
         virtual void initOptions(Options                    *options,
                                  TrajectoryAnalysisSettings *settings);
@@ -387,13 +389,28 @@ class Sasa : public TrajectoryAnalysisModule
          * Empty if the free energy output has not been requested.
          */
         std::vector<real>       dgsFactor_;
+        /*! \brief
+         * Dots on the unit sphere, shared by all frames.
+         *
+         * Created in initAnalysis() and only read in analyzeFrame(), so that
+         * frames can be analyzed in parallel.
+         */
+        t_nsc_unitsphere       *unitsphere_;
+        /*! \brief
+         * Number of OpenMP threads for each nsc_dclm_pbc() call.
+         *
+         * With -nt, the OpenMP threads are divided between the frames that
+         * are analyzed concurrently.
+         */
+        int                     nscThreads_;
 
         // Copy and assign disallowed by base.
 };
 
 Sasa::Sasa()
     : TrajectoryAnalysisModule(SasaInfo::name, SasaInfo::shortDescription),
-      solsize_(0.14), ndots_(24), dgsDefault_(0), bIncludeSolute_(true), top_(NULL)
+      solsize_(0.14), ndots_(24), dgsDefault_(0), bIncludeSolute_(true), top_(NULL),
+      unitsphere_(NULL), nscThreads_(1)
 {
     //minarea_ = 0.5;
     registerAnalysisDataset(&area_, "area");
@@ -403,6 +420,11 @@ Sasa::Sasa()
     registerAnalysisDataset(&volume_, "volume");
 }
 
+Sasa::~Sasa()
+{
+    nsc_done_unitsphere(unitsphere_);
+}
+
 void
 Sasa::initOptions(Options *options, TrajectoryAnalysisSettings *settings)
 {
@@ -489,6 +511,7 @@ Sasa::initOptions(Options *options, TrajectoryAnalysisSettings *settings)
 
     // Atom names etc. are required for the VdW radii lookup.
     settings->setFlag(TrajectoryAnalysisSettings::efRequireTop);
+    settings->setFlag(TrajectoryAnalysisSettings::efAllowFrameParallel);
 }
 
 void
@@ -513,6 +536,12 @@ Sasa::initAnalysis(const TrajectoryAnalysisSettings &settings,
         ndots_ = 20;
         fprintf(stderr, "Ndots too small, setting it to %d\n", ndots_);
     }
+    unitsphere_ = nsc_init_unitsphere(ndots_);
+    if (unitsphere_ == NULL)
+    {
+        GMX_THROW(InternalError("Could not generate the dots on the unit sphere"));
+    }
+    nscThreads_ = std::max(gmx_omp_get_max_threads()/settings.frameThreadCount(), 1);
 
     please_cite(stderr, "Eisenhaber95");
     //if ((top.ePBC() != epbcXYZ) || (TRICLINIC(fr.box)))
@@ -908,11 +937,11 @@ Sasa::analyzeFrame(int frnr, const t_trxframe &fr, t_pbc *pbc,
     real *area = NULL, *surfacedots = NULL;
     int   nsurfacedots;
     int   retval = nsc_dclm_pbc(surfaceSel.coordinates().data(), &radii_[0],
-                                frameData.index_.size(), ndots_, flag, &totarea,
+                                frameData.index_.size(), unitsphere_, flag, &totarea,
                                 &area, &totvolume, &surfacedots, &nsurfacedots,
                                 &frameData.index_[0],
                                 pbc != NULL ? pbc->ePBC : epbcNONE,
-                                pbc != NULL ? pbc->box : NULL);
+                                pbc != NULL ? pbc->box : NULL, nscThreads_);
     // Unpack the atomwise areas into the frameData.atomAreas_ array for easier
     // indexing in the case of dynamic surfaceSel.
     if (area != NULL)
@@ -49,6 +49,10 @@
 #include "gromacs/legacyheaders/macros.h"
 #include "gromacs/math/vec.h"
 #include "gromacs/pbcutil/pbc.h"
+#include "gromacs/selection/nbsearch.h"
+#include "gromacs/simd/simd.h"
+#include "gromacs/utility/exceptions.h"
+#include "gromacs/utility/gmxomp.h"
 #include "gromacs/utility/smalloc.h"
 
 #define TEST_NSC 0
@@ -60,10 +64,12 @@
 #define UNSP_ICO_DOD      9
 #define UNSP_ICO_ARC     10
 
-real   *xpunsp = NULL;
-real    del_cube;
-int     n_dot, ico_cube, last_n_dot = 0, last_densit = 0, last_unsp = 0;
-int     last_cubus = 0;
+#ifdef GMX_SIMD_HAVE_REAL
+/* Number of unit sphere dots that are tested at once for occlusion */
+#define NSC_DOT_PADDING  GMX_SIMD_REAL_WIDTH
+#else
+#define NSC_DOT_PADDING  1
+#endif
 
 #define FOURPI (4.*M_PI)
 #define TORAD(A)     ((A)*0.017453293)
@@ -122,12 +128,14 @@ real safe_asin(real f)
 
 
 /* routines for dot distributions on the surface of the unit sphere */
-real rg, rh;
+#define ICO_RH  (sqrt(1.-2.*cos(TORAD(72.)))/(1.-cos(TORAD(72.))))
+#define ICO_RG  (cos(TORAD(72.))/(1.-cos(TORAD(72.))))
 
 void icosaeder_vertices(real *xus)
 {
-    rh = sqrt(1.-2.*cos(TORAD(72.)))/(1.-cos(TORAD(72.)));
-    rg = cos(TORAD(72.))/(1.-cos(TORAD(72.)));
+    const real rh = ICO_RH;
+    const real rg = ICO_RG;
+
     /* icosaeder vertices */
     xus[ 0] = 0.;                  xus[ 1] = 0.;                  xus[ 2] = 1.;
     xus[ 3] = rh*cos(TORAD(72.));  xus[ 4] = rh*sin(TORAD(72.));  xus[ 5] = rg;
@@ -184,7 +192,7 @@ void divarc(real x1, real y1, real z1,
     *xr = x/dd; *yr = y/dd; *zr = z/dd;
 }
 
-int ico_dot_arc(int densit)   /* densit...required dots per unit sphere */
+int ico_dot_arc(int densit, real **xpunsp) /* densit...required dots per unit sphere */
 {
     /* dot distribution on a unit sphere based on an icosaeder *
      * great circle average refining of icosahedral face       */
@@ -194,6 +202,8 @@ int ico_dot_arc(int densit)   /* densit...required dots per unit sphere */
     real  xij, yij, zij, xji, yji, zji, xik, yik, zik, xki, yki, zki,
           xjk, yjk, zjk, xkj, ykj, zkj;
     real *xus = NULL;
+    int   n_dot;
+    const real rh = ICO_RH;
 
     /* calculate tessalation level */
     a     = sqrt((((real) densit)-2.)/10.);
@@ -206,7 +216,7 @@ int ico_dot_arc(int densit)   /* densit...required dots per unit sphere */
     }
 
     snew(xus, 3*n_dot);
-    xpunsp = xus;
+    *xpunsp = xus;
     icosaeder_vertices(xus);
 
     if (tess > 1)
@@ -320,7 +330,7 @@ int ico_dot_arc(int densit)   /* densit...required dots per unit sphere */
     return n_dot;
 }                           /* end of routine ico_dot_arc */
 
-int ico_dot_dod(int densit) /* densit...required dots per unit sphere */
+int ico_dot_dod(int densit, real **xpunsp) /* densit...required dots per unit sphere */
 {
     /* dot distribution on a unit sphere based on an icosaeder *
      * great circle average refining of icosahedral face       */
@@ -330,6 +340,8 @@ int ico_dot_dod(int densit) /* densit...required dots per unit sphere */
     real  xij, yij, zij, xji, yji, zji, xik, yik, zik, xki, yki, zki,
           xjk, yjk, zjk, xkj, ykj, zkj;
     real *xus = NULL;
+    int   n_dot;
+    const real rh = ICO_RH;
     /* calculate tesselation level */
     a     = sqrt((((real) densit)-2.)/30.);
     tess  = std::max((int) ceil(a), 1);
@@ -341,7 +353,7 @@ int ico_dot_dod(int densit) /* densit...required dots per unit sphere */
     }
 
     snew(xus, 3*n_dot);
-    xpunsp = xus;
+    *xpunsp = xus;
     icosaeder_vertices(xus);
 
     tn = 12;
@@ -528,30 +540,25 @@ int unsp_type(int densit)
     }
 }
 
-int make_unsp(int densit, int mode, int * num_dot, int cubus)
+int make_unsp(int densit, int mode, int * num_dot, real **xpunsp, int cubus)
 {
     int  *ico_wk, *ico_pt;
-    int   ndot, ico_cube_cb, i, j, k, l, ijk, tn, tl, tl2;
-    real *xus;
+    int   ndot, ico_cube, ico_cube_cb, i, j, k, l, ijk, tn, tl, tl2;
+    real *xus, del_cube;
     int  *work;
     real  x, y, z;
 
-    if (xpunsp)
-    {
-        free(xpunsp);
-    }
-
     k = 1; if (mode < 0)
     {
         k = 0; mode = -mode;
     }
     if (mode == UNSP_ICO_ARC)
     {
-        ndot = ico_dot_arc(densit);
+        ndot = ico_dot_arc(densit, xpunsp);
     }
     else if (mode == UNSP_ICO_DOD)
     {
-        ndot = ico_dot_dod(densit);
+        ndot = ico_dot_dod(densit, xpunsp);
     }
     else
     {
@@ -559,14 +566,12 @@ int make_unsp(int densit, int mode, int * num_dot, int cubus)
         return 1;
     }
 
-    last_n_dot = ndot; last_densit = densit; last_unsp = mode;
     *num_dot   = ndot; if (k)
     {
         return 0;
     }
 
     /* in the following the dots of the unit sphere may be resorted */
-    last_unsp = -last_unsp;
 
     /* determine distribution of points in elementary cubes */
     if (cubus)
@@ -575,7 +580,6 @@ int make_unsp(int densit, int mode, int * num_dot, int cubus)
     }
     else
     {
-        last_cubus = 0;
         i          = 1;
         while (i*i*i*2 < ndot)
         {
@@ -586,7 +590,7 @@ int make_unsp(int densit, int mode, int * num_dot, int cubus)
     ico_cube_cb = ico_cube*ico_cube*ico_cube;
     del_cube    = 2./((real)ico_cube);
     snew(work, ndot);
-    xus = xpunsp;
+    xus = *xpunsp;
     for (l = 0; l < ndot; l++)
     {
         i = std::max((int) floor((1.+xus[3*l])/del_cube), 0);
@@ -651,479 +655,389 @@ int make_unsp(int densit, int mode, int * num_dot, int cubus)
 }
 
 
-typedef struct _stwknb {
-    real x;
-    real y;
-    real z;
-    real dot;
-} Neighb;
+/*! \brief
+ * Dots on the unit sphere, see nsc_init_unitsphere().
+ *
+ * The coordinates are stored as separate arrays, padded with zeros to a
+ * multiple of the SIMD width and aligned.
+ * The contents are not modified after creation, so one distribution can be
+ * used by several concurrent calls to nsc_dclm_pbc().
+ */
+struct t_nsc_unitsphere
+{
+    int   ndot;
+    real *ux, *uy, *uz;
+};
 
-int nsc_dclm_pbc(const rvec *coords, real *radius, int nat,
-                 int  densit, int mode,
-                 real *value_of_area, real **at_area,
-                 real *value_of_vol,
-                 real **lidots, int *nu_dots,
-                 atom_id index[], int ePBC, matrix box)
+t_nsc_unitsphere *nsc_init_unitsphere(int densit)
 {
-    int         iat, i, ii, iii, ix, iy, iz, ixe, ixs, iye, iys, ize, izs, i_ac;
-    int         jat, j, jj, jjj, jx, jy, jz;
-    int         distribution;
-    int         l;
-    int         maxnei, nnei, last, maxdots = 0;
-    int        *wkdot = NULL, *wkbox = NULL, *wkat1 = NULL, *wkatm = NULL;
-    Neighb     *wknb, *ctnb;
-    int         iii1, iii2, iiat, lfnr = 0, i_at, j_at;
-    real        dx, dy, dz, dd, ai, aisq, ajsq, aj, as, a;
-    real        xi, yi, zi, xs = 0., ys = 0., zs = 0.;
-    real        dotarea, area, vol = 0.;
-    real       *xus, *dots = NULL, *atom_area = NULL;
-    int         nxbox, nybox, nzbox, nxy, nxyz;
-    real        xmin = 0, ymin = 0, zmin = 0, xmax, ymax, zmax, ra2max, d;
-    const real *pco;
-    /* Added DvdS 2006-07-19 */
-    t_pbc       pbc;
-    rvec        ddx, *x = NULL;
-    int         iat_xx;
+    t_nsc_unitsphere *unitsphere;
+    real             *xus = NULL;
+    int               ndot, ndotPadded, l;
 
-    distribution = unsp_type(densit);
-    if (distribution != -last_unsp || last_cubus != 4 ||
-        (densit != last_densit && densit != last_n_dot))
+    if (make_unsp(densit, -unsp_type(densit), &ndot, &xus, 4))
     {
-        if (make_unsp(densit, (-distribution), &n_dot, 4))
-        {
-            return 1;
-        }
+        sfree(xus);
+        return NULL;
     }
-    xus = xpunsp;
 
-    dotarea = FOURPI/(real) n_dot;
-    area    = 0.;
-
-    if (debug)
+    snew(unitsphere, 1);
+    unitsphere->ndot = ndot;
+    ndotPadded       = ((ndot + NSC_DOT_PADDING - 1)/NSC_DOT_PADDING)*NSC_DOT_PADDING;
+    snew_aligned(unitsphere->ux, ndotPadded, 64);
+    snew_aligned(unitsphere->uy, ndotPadded, 64);
+    snew_aligned(unitsphere->uz, ndotPadded, 64);
+    for (l = 0; l < ndot; l++)
     {
-        fprintf(debug, "nsc_dclm: n_dot=%5d %9.3f\n", n_dot, dotarea);
+        unitsphere->ux[l] = xus[3*l];
+        unitsphere->uy[l] = xus[1+3*l];
+        unitsphere->uz[l] = xus[2+3*l];
     }
+    sfree(xus);
 
-    /* start with neighbour list */
-    /* calculate neighbour list with the box algorithm */
-    if (nat == 0)
-    {
-        WARNING("nsc_dclm: no surface atoms selected");
-        return 1;
-    }
-    if (mode & FLAG_VOLUME)
+    return unitsphere;
+}
+
+void nsc_done_unitsphere(t_nsc_unitsphere *unitsphere)
+{
+    if (unitsphere == NULL)
     {
-        vol = 0.;
+        return;
     }
-    if (mode & FLAG_DOTS)
+    sfree_aligned(unitsphere->ux);
+    sfree_aligned(unitsphere->uy);
+    sfree_aligned(unitsphere->uz);
+    sfree(unitsphere);
+}
+
+/*! \brief
+ * Per-thread neighbor list, dot flags and accumulators for nsc_dclm_pbc().
+ *
+ * The neighbors of the current atom are stored as separate coordinate
+ * arrays to allow testing several dots against a neighbor at once with SIMD.
+ */
+typedef struct {
+    int   nnei_nalloc;
+    real *nbx, *nby, *nbz; /* distance vectors to the neighbors */
+    real *nbdot;           /* reference dot products */
+    real *accessible;      /* 1 for accessible dots, 0 for buried; aligned */
+    real  area;
+    real  vol;
+    int   ndots, dots_nalloc;
+    real *dots;
+} t_nsc_work;
+
+/*! \brief
+ * Marks the dots on the unit sphere around an atom that are not buried.
+ *
+ * Dot l is buried by neighbor j if its projection on the distance vector to
+ * j is larger than the reference dot product of j.
+ * \p ux, \p uy and \p uz hold the unit sphere dots, padded with zeros to a
+ * multiple of the SIMD width and aligned.
+ * Returns the number of accessible dots.
+ */
+static int nsc_check_dots(const real *ux, const real *uy, const real *uz,
+                          int ndot, const t_nsc_work *w, int nnei)
+{
+    real *accessible = w->accessible;
+    int   i_ac, j, l;
+
+    if (nnei == 0)
     {
-        maxdots = (3*n_dot*nat)/10;
-        /* should be set to NULL on first user call */
-        if (dots == NULL)
+        for (l = 0; l < ndot; l++)
         {
-            snew(dots, maxdots);
+            accessible[l] = 1;
         }
-        else
+        return ndot;
+    }
+#ifdef GMX_SIMD_HAVE_REAL
+    const gmx_simd_real_t one  = gmx_simd_set1_r(1.0);
+    const gmx_simd_real_t zero = gmx_simd_setzero_r();
+    for (l = 0; l < ndot; l += GMX_SIMD_REAL_WIDTH)
+    {
+        const gmx_simd_real_t x = gmx_simd_load_r(ux + l);
+        const gmx_simd_real_t y = gmx_simd_load_r(uy + l);
+        const gmx_simd_real_t z = gmx_simd_load_r(uz + l);
+        gmx_simd_bool_t       bAccessible = gmx_simd_cmple_r(zero, one);
+        /* Stop as soon as all the dots in the batch are buried */
+        for (j = 0; j < nnei && gmx_simd_anytrue_b(bAccessible); j++)
         {
-            srenew(dots, maxdots);
+            gmx_simd_real_t d;
+            d           = gmx_simd_mul_r(x, gmx_simd_set1_r(w->nbx[j]));
+            d           = gmx_simd_fmadd_r(y, gmx_simd_set1_r(w->nby[j]), d);
+            d           = gmx_simd_fmadd_r(z, gmx_simd_set1_r(w->nbz[j]), d);
+            bAccessible = gmx_simd_and_b(bAccessible,
+                                         gmx_simd_cmple_r(d, gmx_simd_set1_r(w->nbdot[j])));
         }
-
-        lfnr = 0;
+        gmx_simd_store_r(accessible + l, gmx_simd_blendzero_r(one, bAccessible));
     }
-    if (mode & FLAG_ATOM_AREA)
+#else
     {
-        /* should be set to NULL on first user call */
-        if (atom_area == NULL)
+        int last = 0;
+        for (l = 0; l < ndot; l++)
         {
-            snew(atom_area, nat);
+            accessible[l] = 0;
+            /* The neighbor that buried the previous dot is tried first */
+            if (ux[l]*w->nbx[last] + uy[l]*w->nby[last] + uz[l]*w->nbz[last]
+                <= w->nbdot[last])
+            {
+                for (j = 0; j < nnei; j++)
+                {
+                    if (ux[l]*w->nbx[j] + uy[l]*w->nby[j] + uz[l]*w->nbz[j]
+                        > w->nbdot[j])
+                    {
+                        last = j;
+                        break;
+                    }
+                }
+                if (j >= nnei)
+                {
+                    accessible[l] = 1;
+                }
+            }
         }
-        else
+    }
+#endif
+    i_ac = 0;
+    for (l = 0; l < ndot; l++)
+    {
+        if (accessible[l] != 0)
         {
-            srenew(atom_area, nat);
+            i_ac++;
         }
     }
+    return i_ac;
+}
 
-    /* Compute minimum size for grid cells */
-    ra2max = radius[index[0]];
-    for (iat_xx = 1; (iat_xx < nat); iat_xx++)
+int nsc_dclm_pbc(const rvec *coords, real *radius, int nat,
+                 const t_nsc_unitsphere *unitsphere, int mode,
+                 real *value_of_area, real **at_area,
+                 real *value_of_vol,
+                 real **lidots, int *nu_dots,
+                 atom_id index[], int ePBC, matrix box, int nthreads)
+{
+    int         iat_xx, i;
+    int         thread, ndotPadded, lfnr = 0;
+    t_nsc_work *work;
+    const int   n_dot = unitsphere->ndot;
+    const real *ux    = unitsphere->ux;
+    const real *uy    = unitsphere->uy;
+    const real *uz    = unitsphere->uz;
+    real        dotarea, area, vol = 0.;
+    real        xs = 0., ys = 0., zs = 0.;
+    real       *dots = NULL, *atom_area = NULL;
+    real        ra2max;
+    t_pbc       pbc;
+    rvec       *x;
+
+    dotarea = FOURPI/(real) n_dot;
+    area    = 0.;
+
+    if (debug)
     {
-        iat    = index[iat_xx];
-        ra2max = std::max(ra2max, radius[iat]);
+        fprintf(debug, "nsc_dclm: n_dot=%5d %9.3f\n", n_dot, dotarea);
     }
-    ra2max = 2*ra2max;
 
-    /* Added DvdS 2006-07-19 */
-    /* Updated 2008-10-09 */
-    if (box)
+    if (nat == 0)
     {
-        set_pbc(&pbc, ePBC, box);
-        snew(x, nat);
-        for (i = 0; (i < nat); i++)
-        {
-            iat  = index[0];
-            copy_rvec(coords[iat], x[i]);
-        }
-        put_atoms_in_triclinic_unitcell(ecenterTRIC, box, nat, x);
-        nxbox = std::max(1, static_cast<int>(floor(norm(box[XX])/ra2max)));
-        nybox = std::max(1, static_cast<int>(floor(norm(box[YY])/ra2max)));
-        nzbox = std::max(1, static_cast<int>(floor(norm(box[ZZ])/ra2max)));
-        if (debug)
-        {
-            fprintf(debug, "nbox = %d, %d, %d\n", nxbox, nybox, nzbox);
-        }
+        WARNING("nsc_dclm: no surface atoms selected");
+        return 1;
     }
-    else
+    if (mode & FLAG_ATOM_AREA)
     {
-        /* dimensions of atomic set, cell edge is 2*ra_max */
-        iat    = index[0];
-        xmin   = coords[iat][XX]; xmax = xmin; xs = xmin;
-        ymin   = coords[iat][YY]; ymax = ymin; ys = ymin;
-        zmin   = coords[iat][ZZ]; zmax = zmin; zs = zmin;
+        snew(atom_area, nat);
+    }
 
-        for (iat_xx = 1; (iat_xx < nat); iat_xx++)
-        {
-            iat  = index[iat_xx];
-            pco  = coords[iat];
-            xmin = std::min(xmin, *pco);     xmax = std::max(xmax, *pco);
-            ymin = std::min(ymin, *(pco+1)); ymax = std::max(ymax, *(pco+1));
-            zmin = std::min(zmin, *(pco+2)); zmax = std::max(zmax, *(pco+2));
-            xs   = xs+ *pco; ys = ys+ *(pco+1); zs = zs+ *(pco+2);
-        }
-        xs = xs/ (real) nat;
-        ys = ys/ (real) nat;
-        zs = zs/ (real) nat;
-        if (debug)
-        {
-            fprintf(debug, "nsc_dclm: n_dot=%5d ra2max=%9.3f %9.3f\n", n_dot, ra2max, dotarea);
-        }
+    ndotPadded = ((n_dot + NSC_DOT_PADDING - 1)/NSC_DOT_PADDING)*NSC_DOT_PADDING;
 
-        d    = xmax-xmin; nxbox = (int)std::max<real>(ceil(d/ra2max), 1.);
-        d    = (((real)nxbox)*ra2max-d)/2.;
-        xmin = xmin-d;
-        d    = ymax-ymin; nybox = (int)std::max<real>(ceil(d/ra2max), 1.);
-        d    = (((real)nybox)*ra2max-d)/2.;
-        ymin = ymin-d;
-        d    = zmax-zmin; nzbox = (int)std::max<real>(ceil(d/ra2max), 1.);
-        d    = (((real)nzbox)*ra2max-d)/2.;
-        zmin = zmin-d;
+    /* Two atoms can only overlap within twice the largest radius */
+    snew(x, nat);
+    ra2max = radius[index[0]];
+    for (iat_xx = 0; iat_xx < nat; iat_xx++)
+    {
+        ra2max = std::max(ra2max, radius[index[iat_xx]]);
+        copy_rvec(coords[index[iat_xx]], x[iat_xx]);
     }
-    /* Help variables */
-    nxy  = nxbox*nybox;
-    nxyz = nxy*nzbox;
-
-    /* box number of atoms */
-    snew(wkatm, nat);
-    snew(wkat1, nat);
-    snew(wkdot, n_dot);
-    snew(wkbox, nxyz+1);
+    ra2max = 2*ra2max;
 
     if (box)
     {
-        matrix box_1;
-        rvec   x_1;
-        int    ix, iy, iz;
-        m_inv(box, box_1);
-        for (i = 0; (i < nat); i++)
-        {
-            mvmul(box_1, x[i], x_1);
-            ix = ((int)floor(x_1[XX]*nxbox) + 2*nxbox) % nxbox;
-            iy = ((int)floor(x_1[YY]*nybox) + 2*nybox) % nybox;
-            iz = ((int)floor(x_1[ZZ]*nzbox) + 2*nzbox) % nzbox;
-            j  =  ix + iy*nxbox + iz*nxbox*nybox;
-            if (debug)
-            {
-                fprintf(debug, "Atom %d cell index %d. x = (%8.3f,%8.3f,%8.3f) fc = (%8.3f,%8.3f,%8.3f)\n",
-                        i, j, x[i][XX], x[i][YY], x[i][ZZ], x_1[XX], x_1[YY], x_1[ZZ]);
-            }
-            range_check(j, 0, nxyz);
-            wkat1[i] = j;
-            wkbox[j]++;
-        }
+        set_pbc(&pbc, ePBC, box);
     }
     else
     {
-        /* Put the atoms in their boxes */
-        for (iat_xx = 0; (iat_xx < nat); iat_xx++)
+        /* The volume is computed relative to the center of the atoms */
+        for (iat_xx = 0; iat_xx < nat; iat_xx++)
         {
-            iat           = index[iat_xx];
-            pco           = coords[iat];
-            i             = (int)std::max<real>(floor((pco[XX]-xmin)/ra2max), 0.0);
-            i             = std::min(i, nxbox-1);
-            j             = (int)std::max<real>(floor((pco[YY]-ymin)/ra2max), 0.0);
-            j             = std::min(j, nybox-1);
-            l             = (int)std::max<real>(floor((pco[ZZ]-zmin)/ra2max), 0.0);
-            l             = std::min(l, nzbox-1);
-            i             = i+j*nxbox+l*nxy;
-            wkat1[iat_xx] = i;
-            wkbox[i]++;
+            xs += x[iat_xx][XX];
+            ys += x[iat_xx][YY];
+            zs += x[iat_xx][ZZ];
         }
+        xs = xs/(real) nat;
+        ys = ys/(real) nat;
+        zs = zs/(real) nat;
     }
-
-    /* sorting of atoms in accordance with box numbers */
-    j = wkbox[0];
-    for (i = 1; i < nxyz; i++)
-    {
-        j = std::max(wkbox[i], j);
-    }
-    for (i = 1; i <= nxyz; i++)
+    if (debug)
     {
-        wkbox[i] += wkbox[i-1];
+        fprintf(debug, "nsc_dclm: n_dot=%5d ra2max=%9.3f %9.3f\n", n_dot, ra2max, dotarea);
     }
 
-    /* maxnei = (int) floor(ra2max*ra2max*ra2max*0.5); */
-    maxnei = std::min(nat, 27*j);
-    snew(wknb, maxnei);
-    for (iat_xx = 0; iat_xx < nat; iat_xx++)
-    {
-        iat = index[iat_xx];
-        range_check(wkat1[iat_xx], 0, nxyz);
-        wkatm[--wkbox[wkat1[iat_xx]]] = iat_xx;
-        if (debug)
-        {
-            fprintf(debug, "atom %5d on place %5d\n", iat, wkbox[wkat1[iat_xx]]);
-        }
-    }
+    gmx::AnalysisNeighborhood       nb;
+    nb.setCutoff(ra2max);
+    gmx::AnalysisNeighborhoodSearch search
+        = nb.initSearch(box ? &pbc : NULL,
+                        gmx::AnalysisNeighborhoodPositions(x, nat));
 
-    if (debug)
+    /* Each thread handles a contiguous range of atoms, such that the dots
+     * come out in atom order and the sums do not depend on scheduling.
+     * The caller sets the thread count, since several frames may be
+     * processed concurrently.
+     */
+    nthreads = std::max(std::min(nthreads, nat), 1);
+    snew(work, nthreads);
+    for (thread = 0; thread < nthreads; thread++)
     {
-        fprintf(debug, "nsc_dclm: n_dot=%5d ra2max=%9.3f %9.3f\n",
-                n_dot, ra2max, dotarea);
-        fprintf(debug, "neighbour list calculated/box(xyz):%d %d %d\n",
-                nxbox, nybox, nzbox);
-
-        for (i = 0; i < nxyz; i++)
-        {
-            fprintf(debug, "box %6d : atoms %4d-%4d    %5d\n",
-                    i, wkbox[i], wkbox[i+1]-1, wkbox[i+1]-wkbox[i]);
-        }
-        for (i = 0; i < nat; i++)
-        {
-            fprintf(debug, "list place %5d by atom %7d\n", i, index[wkatm[i]]);
-        }
+        snew_aligned(work[thread].accessible, ndotPadded, 64);
     }
 
-    /* calculate surface for all atoms, step cube-wise */
-    for (iz = 0; iz < nzbox; iz++)
+#pragma omp parallel num_threads(nthreads)
     {
-        iii = iz*nxy;
-        if (box)
+        try
         {
-            izs = iz-1;
-            ize = std::min(iz+2, izs+nzbox);
-        }
-        else
-        {
-            izs = std::max(iz-1, 0);
-            ize = std::min(iz+2, nzbox);
-        }
-        for (iy = 0; iy < nybox; iy++)
-        {
-            ii = iy*nxbox+iii;
-            if (box)
-            {
-                iys = iy-1;
-                iye = std::min(iy+2, iys+nybox);
-            }
-            else
+            t_nsc_work *w     = &work[gmx_omp_get_thread_num()];
+            const int   start = (gmx_omp_get_thread_num()*nat)/nthreads;
+            const int   end   = ((gmx_omp_get_thread_num() + 1)*nat)/nthreads;
+            int         iat, jat, i_at, j_at, i_ac, nnei, l;
+            real        ai, aisq, aj, as, a, dd, xi, yi, zi, dx, dy, dz;
+            rvec        ddx;
+
+            gmx::AnalysisNeighborhoodPairSearch pairSearch
+                = search.startPairSearch(
+                            gmx::AnalysisNeighborhoodPositions(x + start, end - start));
+            gmx::AnalysisNeighborhoodPair       pair;
+            bool                                bPair = pairSearch.findNextPair(&pair);
+
+            for (iat = start; iat < end; iat++)
             {
-                iys = std::max(iy-1, 0);
-                iye = std::min(iy+2, nybox);
-            }
-            for (ix = 0; ix < nxbox; ix++)
-            {
-                i    = ii+ix;
-                iii1 = wkbox[i];
-                iii2 = wkbox[i+1];
-                if (iii1 >= iii2)
-                {
-                    continue;
-                }
-                if (box)
+                i_at = index[iat];
+                ai   = radius[i_at];
+                aisq = ai*ai;
+                xi   = coords[i_at][XX];
+                yi   = coords[i_at][YY];
+                zi   = coords[i_at][ZZ];
+
+                /* The pairs come grouped by test position */
+                nnei = 0;
+                for (; bPair && start + pair.testIndex() == iat;
+                     bPair = pairSearch.findNextPair(&pair))
                 {
-                    ixs = ix-1;
-                    ixe = std::min(ix+2, ixs+nxbox);
-                }
-                else
-                {
-                    ixs = std::max(ix-1, 0);
-                    ixe = std::min(ix+2, nxbox);
-                }
-                iiat = 0;
-                /* make intermediate atom list */
-                for (jz = izs; jz < ize; jz++)
-                {
-                    jjj = ((jz+nzbox) % nzbox)*nxy;
-                    for (jy = iys; jy < iye; jy++)
+                    jat  = pair.refIndex();
+                    j_at = index[jat];
+                    if (j_at == i_at)
                     {
-                        jj = ((jy+nybox) % nybox)*nxbox+jjj;
-                        for (jx = ixs; jx < ixe; jx++)
-                        {
-                            j = jj+((jx+nxbox) % nxbox);
-                            for (jat = wkbox[j]; jat < wkbox[j+1]; jat++)
-                            {
-                                range_check(wkatm[jat], 0, nat);
-                                range_check(iiat, 0, nat);
-                                wkat1[iiat] = wkatm[jat];
-                                iiat++;
-                            } /* end of cycle "jat" */
-                        }     /* end of cycle "jx" */
-                    }         /* end of cycle "jy" */
-                }             /* end of cycle "jz" */
-                for (iat = iii1; iat < iii2; iat++)
-                {
-                    i_at = index[wkatm[iat]];
-                    ai   = radius[i_at];
-                    aisq = ai*ai;
-                    pco  = coords[i_at];
-                    xi   = pco[XX]; yi = pco[YY]; zi = pco[ZZ];
-                    for (i = 0; i < n_dot; i++)
-                    {
-                        wkdot[i] = 0;
+                        continue;
                     }
-
-                    ctnb = wknb; nnei = 0;
-                    for (j = 0; j < iiat; j++)
+                    aj = radius[j_at];
+                    if (box)
                     {
-                        j_at = index[wkat1[j]];
-                        if (j_at == i_at)
-                        {
-                            continue;
-                        }
-
-                        aj   = radius[j_at];
-                        ajsq = aj*aj;
-                        pco  = coords[j_at];
-
-                        /* Added DvdS 2006-07-19 */
-                        if (box)
-                        {
-                            /*rvec xxi;
-
-                               xxi[XX] = xi;
-                               xxi[YY] = yi;
-                               xxi[ZZ] = zi;
-                               pbc_dx(&pbc,pco,xxi,ddx);*/
-                            pbc_dx(&pbc, coords[j_at], coords[i_at], ddx);
-                            dx = ddx[XX];
-                            dy = ddx[YY];
-                            dz = ddx[ZZ];
-                        }
-                        else
-                        {
-                            dx = pco[XX]-xi;
-                            dy = pco[YY]-yi;
-                            dz = pco[ZZ]-zi;
-                        }
-                        dd = dx*dx+dy*dy+dz*dz;
-                        as = ai+aj;
-                        if (dd > as*as)
-                        {
-                            continue;
-                        }
-                        nnei++;
-                        ctnb->x   = dx;
-                        ctnb->y   = dy;
-                        ctnb->z   = dz;
-                        ctnb->dot = (dd+aisq-ajsq)/(2.*ai); /* reference dot product */
-                        ctnb++;
+                        pbc_dx(&pbc, coords[j_at], coords[i_at], ddx);
                     }
-
-                    /* check points on accessibility */
-                    if (nnei)
+                    else
                     {
-                        last = 0; i_ac = 0;
-                        for (l = 0; l < n_dot; l++)
-                        {
-                            if (xus[3*l]*(wknb+last)->x+
-                                xus[1+3*l]*(wknb+last)->y+
-                                xus[2+3*l]*(wknb+last)->z <= (wknb+last)->dot)
-                            {
-                                for (j = 0; j < nnei; j++)
-                                {
-                                    if (xus[3*l]*(wknb+j)->x+xus[1+3*l]*(wknb+j)->y+
-                                        xus[2+3*l]*(wknb+j)->z > (wknb+j)->dot)
-                                    {
-                                        last = j;
-                                        break;
-                                    }
-                                }
-                                if (j >= nnei)
-                                {
-                                    i_ac++;
-                                    wkdot[l] = 1;
-                                }
-                            } /* end of cycle j */
-                        }     /* end of cycle l */
+                        rvec_sub(coords[j_at], coords[i_at], ddx);
                     }
-                    else
+                    dd = norm2(ddx);
+                    as = ai + aj;
+                    if (dd > as*as)
                     {
-                        i_ac  = n_dot;
-                        for (l = 0; l < n_dot; l++)
-                        {
-                            wkdot[l] = 1;
-                        }
+                        continue;
                     }
-
-                    if (debug)
+                    if (nnei >= w->nnei_nalloc)
                     {
-                        fprintf(debug, "i_ac=%d, dotarea=%8.3f, aisq=%8.3f\n",
-                                i_ac, dotarea, aisq);
+                        w->nnei_nalloc = over_alloc_large(nnei + 1);
+                        srenew(w->nbx, w->nnei_nalloc);
+                        srenew(w->nby, w->nnei_nalloc);
+                        srenew(w->nbz, w->nnei_nalloc);
+                        srenew(w->nbdot, w->nnei_nalloc);
                     }
+                    w->nbx[nnei]   = ddx[XX];
+                    w->nby[nnei]   = ddx[YY];
+                    w->nbz[nnei]   = ddx[ZZ];
+                    w->nbdot[nnei] = (dd + aisq - aj*aj)/(2.*ai); /* reference dot product */
+                    nnei++;
+                }
 
-                    a    = aisq*dotarea* (real) i_ac;
-                    area = area + a;
-                    if (mode & FLAG_ATOM_AREA)
+                /* check points on accessibility */
+                i_ac = nsc_check_dots(ux, uy, uz, n_dot, w, nnei);
+
+                a        = aisq*dotarea* (real) i_ac;
+                w->area += a;
+                if (mode & FLAG_ATOM_AREA)
+                {
+                    atom_area[iat] = a;
+                }
+                if (mode & FLAG_DOTS)
+                {
+                    if (3*(w->ndots + i_ac) > w->dots_nalloc)
                     {
-                        range_check(wkatm[iat], 0, nat);
-                        atom_area[wkatm[iat]] = a;
+                        w->dots_nalloc = over_alloc_large(3*(w->ndots + i_ac));
+                        srenew(w->dots, w->dots_nalloc);
                     }
-                    if (mode & FLAG_DOTS)
+                    for (l = 0; l < n_dot; l++)
                     {
-                        for (l = 0; l < n_dot; l++)
+                        if (w->accessible[l] != 0)
                         {
-                            if (wkdot[l])
-                            {
-                                lfnr++;
-                                if (maxdots <= 3*lfnr+1)
-                                {
-                                    maxdots = maxdots+n_dot*3;
-                                    srenew(dots, maxdots);
-                                }
-                                dots[3*lfnr-3] = ai*xus[3*l]+xi;
-                                dots[3*lfnr-2] = ai*xus[1+3*l]+yi;
-                                dots[3*lfnr-1] = ai*xus[2+3*l]+zi;
-                            }
+                            w->dots[3*w->ndots]   = ai*ux[l] + xi;
+                            w->dots[3*w->ndots+1] = ai*uy[l] + yi;
+                            w->dots[3*w->ndots+2] = ai*uz[l] + zi;
+                            w->ndots++;
                         }
                     }
-                    if (mode & FLAG_VOLUME)
+                }
+                if (mode & FLAG_VOLUME)
+                {
+                    dx = 0.; dy = 0.; dz = 0.;
+                    for (l = 0; l < n_dot; l++)
                     {
-                        dx = 0.; dy = 0.; dz = 0.;
-                        for (l = 0; l < n_dot; l++)
-                        {
-                            if (wkdot[l])
-                            {
-                                dx = dx+xus[3*l];
-                                dy = dy+xus[1+3*l];
-                                dz = dz+xus[2+3*l];
-                            }
-                        }
-                        vol = vol+aisq*(dx*(xi-xs)+dy*(yi-ys)+dz*(zi-zs)+ai* (real) i_ac);
+                        dx += w->accessible[l]*ux[l];
+                        dy += w->accessible[l]*uy[l];
+                        dz += w->accessible[l]*uz[l];
                     }
+                    w->vol += aisq*(dx*(xi-xs)+dy*(yi-ys)+dz*(zi-zs)+ai* (real) i_ac);
+                }
+            }
+        }
+        GMX_CATCH_ALL_AND_EXIT_WITH_FATAL_ERROR;
+    }
 
-                } /* end of cycle "iat" */
-            }     /* end of cycle "ix" */
-        }         /* end of cycle "iy" */
-    }             /* end of cycle "iz" */
-
-    sfree(wkatm);
-    sfree(wkat1);
-    sfree(wkdot);
-    sfree(wkbox);
-    sfree(wknb);
-    if (box)
+    /* Reduce over the threads */
+    for (thread = 0; thread < nthreads; thread++)
     {
-        sfree(x);
+        area += work[thread].area;
+        vol  += work[thread].vol;
+        lfnr += work[thread].ndots;
     }
+    if (mode & FLAG_DOTS)
+    {
+        snew(dots, std::max(3*lfnr, 1));
+        for (thread = 0, i = 0; thread < nthreads; thread++)
+        {
+            memcpy(dots + i, work[thread].dots, 3*work[thread].ndots*sizeof(*dots));
+            i += 3*work[thread].ndots;
+        }
+    }
+    for (thread = 0; thread < nthreads; thread++)
+    {
+        sfree(work[thread].nbx);
+        sfree(work[thread].nby);
+        sfree(work[thread].nbz);
+        sfree(work[thread].nbdot);
+        sfree_aligned(work[thread].accessible);
+        sfree(work[thread].dots);
+    }
+    sfree(work);
+    sfree(x);
+
     if (mode & FLAG_VOLUME)
     {
         vol           = vol*FOURPI/(3.* (real) n_dot);
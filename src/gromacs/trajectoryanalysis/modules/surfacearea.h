@@ -48,12 +48,27 @@ extern "C"
 {
 #endif
 
+/*! \brief
+ * Dot distribution on the unit sphere used by nsc_dclm_pbc().
+ */
+typedef struct t_nsc_unitsphere t_nsc_unitsphere;
+
+/*! \brief
+ * Creates a dot distribution with at least \p densit dots on the unit sphere.
+ *
+ * Returns NULL on failure.  The distribution is not modified by
+ * nsc_dclm_pbc(), so it can be created once and shared between threads.
+ */
+t_nsc_unitsphere *nsc_init_unitsphere(int densit);
+//! Frees a dot distribution created with nsc_init_unitsphere().
+void nsc_done_unitsphere(t_nsc_unitsphere *unitsphere);
+
 int nsc_dclm_pbc(const rvec *coords, real *radius, int nat,
-                 int  densit, int mode,
+                 const t_nsc_unitsphere *unitsphere, int mode,
                  real *value_of_area, real **at_area,
                  real *value_of_vol,
                  real **lidots, int *nu_dots,
-                 atom_id index[], int ePBC, matrix box);
+                 atom_id index[], int ePBC, matrix box, int nthreads);
 
 /*
     User notes :
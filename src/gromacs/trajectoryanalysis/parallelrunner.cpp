@@ -0,0 +1,401 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2014, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+/*! \internal \file
+ * \brief
+ * Implements gmx::TrajectoryAnalysisParallelRunner.
+ *
+ * \ingroup module_trajectoryanalysis
+ */
+#include "gmxpre.h"
+
+#include "parallelrunner.h"
+
+#include <cstring>
+
+#include <algorithm>
+#include <vector>
+
+#include <boost/exception_ptr.hpp>
+
+#include "thread_mpi/mutex.h"
+#include "thread_mpi/threads.h"
+
+#include "gromacs/analysisdata/paralleloptions.h"
+#include "gromacs/fileio/trx.h"
+#include "gromacs/pbcutil/pbc.h"
+#include "gromacs/selection/framelocalselections.h"
+#include "gromacs/trajectoryanalysis/analysismodule.h"
+#include "gromacs/utility/exceptions.h"
+#include "gromacs/utility/gmxassert.h"
+#include "gromacs/utility/smalloc.h"
+#include "gromacs/utility/uniqueptr.h"
+
+namespace gmx
+{
+
+namespace
+{
+
+/*! \internal \brief
+ * Copies a coordinate array, reallocating the destination if necessary.
+ *
+ * \param[in,out] dest    Destination array.
+ * \param[in,out] nalloc  Number of elements allocated for \p dest.
+ * \param[in]     src     Source array (can be NULL).
+ * \param[in]     n       Number of elements to copy.
+ * \returns       \p dest, or NULL if \p src is NULL.
+ */
+rvec *copyFrameArray(rvec **dest, int *nalloc, const rvec *src, int n)
+{
+    if (src == NULL)
+    {
+        return NULL;
+    }
+    if (*nalloc < n)
+    {
+        srenew(*dest, n);
+        *nalloc = n;
+    }
+    std::memcpy(*dest, src, n*sizeof(**dest));
+    return *dest;
+}
+
+}   // namespace
+
+/********************************************************************
+ * TrajectoryAnalysisParallelRunner::Impl
+ */
+
+class TrajectoryAnalysisParallelRunner::Impl
+{
+    public:
+        class Worker;
+
+        //! Smart pointer type for managing a worker.
+        typedef gmx_unique_ptr<Worker>::type WorkerPointer;
+
+        Impl(TrajectoryAnalysisModule  *module,
+             const SelectionCollection &selections,
+             int                        nthreads);
+        ~Impl();
+
+        /*! \brief
+         * Waits until \p worker has finished its frame, and retires the frame.
+         *
+         * If analyzing the frame threw an exception, it is rethrown here
+         * instead of finishing the frame.
+         */
+        void retireFrame(Worker *worker);
+        //! Stops and joins all worker threads.
+        void stopThreads();
+
+        //! Module to run.
+        TrajectoryAnalysisModule   *module_;
+        //! Worker threads, with frame \c i analyzed by worker \c i%size().
+        std::vector<WorkerPointer>  workers_;
+        //! Number of frames passed to analyzeFrame().
+        int                         frameCount_;
+        //! Whether threads have been started (and not yet stopped).
+        bool                        bThreadsRunning_;
+        //! Set to make the worker threads exit.
+        bool                        bStop_;
+        //! Protects the state of all workers and \a bStop_.
+        tMPI::mutex                 mutex_;
+        //! Signaled when a worker finishes a frame.
+        tMPI_Thread_cond_t          frameDone_;
+};
+
+/*! \internal \brief
+ * State for a single worker thread.
+ *
+ * All fields except \a bHasFrame_ are only accessed by the main thread when
+ * \a bHasFrame_ is false, and by the worker thread when it is true.
+ *
+ * \ingroup module_trajectoryanalysis
+ */
+class TrajectoryAnalysisParallelRunner::Impl::Worker
+{
+    public:
+        Worker(Impl *parent, const SelectionCollection &selections);
+        ~Worker();
+
+        //! Copies \p fr and \p pbc into the buffers of this worker.
+        void setFrame(int frnr, const t_trxframe &fr, const t_pbc *pbc);
+        //! Main loop for the worker thread.
+        void run();
+
+        //! Thread entry point for tMPI_Thread_create().
+        static void *threadMain(void *arg)
+        {
+            static_cast<Worker *>(arg)->run();
+            return NULL;
+        }
+
+        //! Runner that owns this worker.
+        Impl                               &parent_;
+        //! Thread handle.
+        tMPI_Thread_t                       thread_;
+        //! Signaled when the main thread has assigned a frame.
+        tMPI_Thread_cond_t                  frameAvailable_;
+        //! Whether a frame has been assigned and not yet analyzed.
+        bool                                bHasFrame_;
+        //! Exception thrown while analyzing the frame, rethrown on retirement.
+        boost::exception_ptr                exception_;
+        //! Index of the last frame assigned to this worker, or -1 if none.
+        int                                 frameIndex_;
+        //! Copy of the frame to analyze.
+        t_trxframe                          frame_;
+        //! Copy of the PBC information for \a frame_.
+        t_pbc                               pbc_;
+        //! Whether \a pbc_ is valid.
+        bool                                bPBC_;
+        //! Buffers for the coordinates, velocities, and forces in \a frame_.
+        rvec                               *x_, *v_, *f_;
+        //! Allocation sizes for \a x_, \a v_, and \a f_.
+        int                                 nallocX_, nallocV_, nallocF_;
+        //! Selections evaluated for \a frame_.
+        FrameLocalSelections                selections_;
+        //! Thread-local data for the analysis module.
+        TrajectoryAnalysisModuleDataPointer pdata_;
+};
+
+TrajectoryAnalysisParallelRunner::Impl::Worker::Worker(
+        Impl *parent, const SelectionCollection &selections)
+    : parent_(*parent), bHasFrame_(false), frameIndex_(-1), bPBC_(false),
+      x_(NULL), v_(NULL), f_(NULL), nallocX_(0), nallocV_(0), nallocF_(0),
+      selections_(selections)
+{
+    std::memset(&frame_, 0, sizeof(frame_));
+    tMPI_Thread_cond_init(&frameAvailable_);
+}
+
+TrajectoryAnalysisParallelRunner::Impl::Worker::~Worker()
+{
+    tMPI_Thread_cond_destroy(&frameAvailable_);
+    sfree(x_);
+    sfree(v_);
+    sfree(f_);
+}
+
+void
+TrajectoryAnalysisParallelRunner::Impl::Worker::setFrame(
+        int frnr, const t_trxframe &fr, const t_pbc *pbc)
+{
+    frameIndex_ = frnr;
+    frame_      = fr;
+    frame_.x    = copyFrameArray(&x_, &nallocX_, fr.x, fr.natoms);
+    frame_.v    = copyFrameArray(&v_, &nallocV_, fr.v, fr.natoms);
+    frame_.f    = copyFrameArray(&f_, &nallocF_, fr.f, fr.natoms);
+    bPBC_       = (pbc != NULL);
+    if (bPBC_)
+    {
+        pbc_ = *pbc;
+    }
+    selections_.copyFrom();
+}
+
+void
+TrajectoryAnalysisParallelRunner::Impl::Worker::run()
+{
+    parent_.mutex_.lock();
+    while (true)
+    {
+        while (!bHasFrame_ && !parent_.bStop_)
+        {
+            tMPI_Thread_cond_wait(&frameAvailable_,
+                                  parent_.mutex_.native_handle());
+        }
+        if (!bHasFrame_)
+        {
+            break;
+        }
+        parent_.mutex_.unlock();
+        // Exceptions cannot be propagated out of the thread, so they are
+        // stored and rethrown in the main thread when the frame is retired.
+        try
+        {
+            parent_.module_->analyzeFrame(frameIndex_, frame_,
+                                          bPBC_ ? &pbc_ : NULL, pdata_.get());
+        }
+        catch (...)
+        {
+            exception_ = boost::current_exception();
+        }
+        parent_.mutex_.lock();
+        bHasFrame_ = false;
+        tMPI_Thread_cond_broadcast(&parent_.frameDone_);
+    }
+    parent_.mutex_.unlock();
+}
+
+TrajectoryAnalysisParallelRunner::Impl::Impl(
+        TrajectoryAnalysisModule  *module,
+        const SelectionCollection &selections,
+        int                        nthreads)
+    : module_(module), frameCount_(0), bThreadsRunning_(false), bStop_(false)
+{
+    GMX_RELEASE_ASSERT(nthreads > 0, "Invalid number of threads");
+    tMPI_Thread_cond_init(&frameDone_);
+    AnalysisDataParallelOptions dataOptions(nthreads);
+    workers_.reserve(nthreads);
+    for (int i = 0; i < nthreads; ++i)
+    {
+        WorkerPointer worker(new Worker(this, selections));
+        worker->pdata_ = module->startFrames(dataOptions, selections);
+        if (worker->pdata_)
+        {
+            worker->pdata_->setFrameLocalSelections(&worker->selections_);
+        }
+        workers_.push_back(move(worker));
+    }
+    bThreadsRunning_ = true;
+    for (size_t i = 0; i < workers_.size(); ++i)
+    {
+        if (tMPI_Thread_create(&workers_[i]->thread_, &Worker::threadMain,
+                               workers_[i].get()) != 0)
+        {
+            // Only the threads created so far should be joined.
+            workers_.resize(i);
+            stopThreads();
+            GMX_THROW(InternalError("Could not create threads for parallel analysis"));
+        }
+    }
+}
+
+TrajectoryAnalysisParallelRunner::Impl::~Impl()
+{
+    stopThreads();
+    tMPI_Thread_cond_destroy(&frameDone_);
+}
+
+void
+TrajectoryAnalysisParallelRunner::Impl::retireFrame(Worker *worker)
+{
+    {
+        tMPI::lock_guard<tMPI::mutex> lock(mutex_);
+        while (worker->bHasFrame_)
+        {
+            tMPI_Thread_cond_wait(&frameDone_, mutex_.native_handle());
+        }
+    }
+    if (worker->frameIndex_ >= 0)
+    {
+        const int frameIndex = worker->frameIndex_;
+        worker->frameIndex_ = -1;
+        if (worker->exception_)
+        {
+            boost::exception_ptr ex = worker->exception_;
+            worker->exception_ = boost::exception_ptr();
+            rethrow_exception(ex);
+        }
+        module_->finishFrameSerial(frameIndex);
+    }
+}
+
+void
+TrajectoryAnalysisParallelRunner::Impl::stopThreads()
+{
+    if (!bThreadsRunning_)
+    {
+        return;
+    }
+    {
+        tMPI::lock_guard<tMPI::mutex> lock(mutex_);
+        bStop_ = true;
+        for (size_t i = 0; i < workers_.size(); ++i)
+        {
+            tMPI_Thread_cond_signal(&workers_[i]->frameAvailable_);
+        }
+    }
+    for (size_t i = 0; i < workers_.size(); ++i)
+    {
+        tMPI_Thread_join(workers_[i]->thread_, NULL);
+    }
+    bThreadsRunning_ = false;
+}
+
+/********************************************************************
+ * TrajectoryAnalysisParallelRunner
+ */
+
+TrajectoryAnalysisParallelRunner::TrajectoryAnalysisParallelRunner(
+        TrajectoryAnalysisModule  *module,
+        const SelectionCollection &selections,
+        int                        nthreads)
+    : impl_(new Impl(module, selections, nthreads))
+{
+}
+
+TrajectoryAnalysisParallelRunner::~TrajectoryAnalysisParallelRunner()
+{
+}
+
+void
+TrajectoryAnalysisParallelRunner::analyzeFrame(
+        int frnr, const t_trxframe &fr, const t_pbc *pbc)
+{
+    GMX_RELEASE_ASSERT(frnr == impl_->frameCount_, "Frames passed out of order");
+    Impl::Worker *worker = impl_->workers_[frnr % impl_->workers_.size()].get();
+    impl_->retireFrame(worker);
+    worker->setFrame(frnr, fr, pbc);
+    ++impl_->frameCount_;
+    tMPI::lock_guard<tMPI::mutex> lock(impl_->mutex_);
+    worker->bHasFrame_ = true;
+    tMPI_Thread_cond_signal(&worker->frameAvailable_);
+}
+
+void
+TrajectoryAnalysisParallelRunner::finish()
+{
+    const int nworkers   = impl_->workers_.size();
+    const int firstFrame = std::max(impl_->frameCount_ - nworkers, 0);
+    for (int frnr = firstFrame; frnr < impl_->frameCount_; ++frnr)
+    {
+        impl_->retireFrame(impl_->workers_[frnr % nworkers].get());
+    }
+    impl_->stopThreads();
+    for (int i = 0; i < nworkers; ++i)
+    {
+        TrajectoryAnalysisModuleDataPointer &pdata = impl_->workers_[i]->pdata_;
+        impl_->module_->finishFrames(pdata.get());
+        if (pdata)
+        {
+            pdata->finish();
+        }
+        pdata.reset();
+    }
+}
+
+} // namespace gmx
@@ -0,0 +1,141 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2014, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+/*! \internal \file
+ * \brief
+ * Declares gmx::TrajectoryAnalysisParallelRunner.
+ *
+ * \ingroup module_trajectoryanalysis
+ */
+#ifndef GMX_TRAJECTORYANALYSIS_PARALLELRUNNER_H
+#define GMX_TRAJECTORYANALYSIS_PARALLELRUNNER_H
+
+#include "gromacs/utility/classhelpers.h"
+
+struct t_pbc;
+struct t_trxframe;
+
+namespace gmx
+{
+
+class SelectionCollection;
+class TrajectoryAnalysisModule;
+
+/*! \internal
+ * \brief
+ * Analyzes multiple trajectory frames concurrently in worker threads.
+ *
+ * Frames are read and selections are evaluated by the caller, which then
+ * passes each frame to analyzeFrame().  This copies the frame and the
+ * evaluated selections into a buffer owned by a worker thread, and the worker
+ * calls TrajectoryAnalysisModule::analyzeFrame() with its own
+ * TrajectoryAnalysisModuleData object, while the caller proceeds to read the
+ * next frame.
+ *
+ * Frame \c i is always analyzed by worker \c i%nthreads, and the caller
+ * retires frames in order with TrajectoryAnalysisModule::finishFrameSerial()
+ * before reusing a worker.  Thus, at most \c nthreads frames are in progress
+ * at any time, which matches the parallelization factor passed to the
+ * analysis data objects, and AnalysisDataStorage puts the out-of-order frames
+ * back into order.
+ *
+ * An exception thrown by TrajectoryAnalysisModule::analyzeFrame() in a worker
+ * is rethrown in the calling thread when the frame would be retired, i.e.,
+ * from a later analyzeFrame() call or from finish().
+ *
+ * \ingroup module_trajectoryanalysis
+ */
+class TrajectoryAnalysisParallelRunner
+{
+    public:
+        /*! \brief
+         * Starts worker threads for analysis.
+         *
+         * \param     module     Analysis module to run.
+         * \param[in] selections Compiled selection collection used for
+         *      evaluating the selections.
+         * \param[in] nthreads   Number of worker threads.
+         * \throws    std::bad_alloc if out of memory.
+         * \throws    unspecified Any exception thrown by
+         *      TrajectoryAnalysisModule::startFrames().
+         *
+         * Calls TrajectoryAnalysisModule::startFrames() once for each thread.
+         */
+        TrajectoryAnalysisParallelRunner(TrajectoryAnalysisModule  *module,
+                                         const SelectionCollection &selections,
+                                         int                        nthreads);
+        /*! \brief
+         * Stops the worker threads.
+         *
+         * If finish() has not been called, waits for the frames in progress,
+         * but does not finish them.
+         */
+        ~TrajectoryAnalysisParallelRunner();
+
+        /*! \brief
+         * Starts analysis of a frame.
+         *
+         * \param[in] frnr  Index of the frame (consecutive, starting at zero).
+         * \param[in] fr    Frame to analyze.
+         * \param[in] pbc   PBC information for \p fr (can be NULL).
+         * \throws    std::bad_alloc if out of memory.
+         * \throws    unspecified Any exception thrown by
+         *      TrajectoryAnalysisModule::finishFrameSerial(), or by
+         *      TrajectoryAnalysisModule::analyzeFrame() for an earlier frame.
+         *
+         * The selections should have been evaluated for \p fr.
+         * \p fr and \p pbc are copied, and can be modified after the call
+         * returns.  May block until a worker thread is available.
+         */
+        void analyzeFrame(int frnr, const t_trxframe &fr, const t_pbc *pbc);
+        /*! \brief
+         * Waits for all frames to be analyzed and finishes the analysis.
+         *
+         * \throws    unspecified Any exception thrown by
+         *      TrajectoryAnalysisModule::analyzeFrame(),
+         *      TrajectoryAnalysisModule::finishFrameSerial(),
+         *      TrajectoryAnalysisModule::finishFrames(), or
+         *      TrajectoryAnalysisModuleData::finish().
+         */
+        void finish();
+
+    private:
+        class Impl;
+
+        PrivateImplPointer<Impl> impl_;
+};
+
+} // namespace gmx
+
+#endif
@@ -213,6 +213,12 @@ TrajectoryAnalysisRunnerCommon::initOptions(Options *options)
                                .description("Use periodic boundary conditions for distance calculation"));
     }
 
+    if (settings.hasFlag(TrajectoryAnalysisSettings::efAllowFrameParallel))
+    {
+        options->addOption(IntegerOption("nt").store(&settings.impl_->nthreads)
+                               .description("Number of threads for analyzing frames in parallel"));
+    }
+
     options->addOption(SelectionFileOption("sf"));
 }
 
@@ -234,6 +240,10 @@ TrajectoryAnalysisRunnerCommon::optionsFinished(Options *options)
     {
         GMX_THROW(InconsistentInputError("No trajectory or topology provided, nothing to do!"));
     }
+    if (impl_->settings_.impl_->nthreads < 1)
+    {
+        GMX_THROW(InvalidInputError("Number of threads must be positive"));
+    }
 
     if (options->isSet("b"))
     {
@@ -428,6 +438,13 @@ TrajectoryAnalysisRunnerCommon::initFrame()
 }
 
 
+int
+TrajectoryAnalysisRunnerCommon::threadCount() const
+{
+    return impl_->settings_.impl_->nthreads;
+}
+
+
 bool
 TrajectoryAnalysisRunnerCommon::hasTrajectory() const
 {
@@ -116,6 +116,13 @@ class TrajectoryAnalysisRunnerCommon
          */
         void initFrame();
 
+        /*! \brief
+         * Returns the number of threads to use for analyzing frames.
+         *
+         * Always one unless the module has specified
+         * TrajectoryAnalysisSettings::efAllowFrameParallel.
+         */
+        int threadCount() const;
         //! Returns true if input data comes from a trajectory.
         bool hasTrajectory() const;
         //! Returns the topology information object.
@@ -96,4 +96,18 @@ TEST_F(DistanceModuleTest, HandlesDynamicSelections)
     runTest(CommandLine(cmdline));
 }
 
+TEST_F(DistanceModuleTest, HandlesFrameParallelAnalysis)
+{
+    const char *const cmdline[] = {
+        "distance",
+        "-select", "atomname S1 S2",
+        "resindex 1 to 4 and atomname CB merge resindex 2 to 5 and atomname CB",
+        "-len", "2", "-binw", "0.5",
+        "-nt", "2"
+    };
+    setTopology("simple.gro");
+    setTrajectory("simple.gro");
+    runTest(CommandLine(cmdline));
+}
+
 } // namespace
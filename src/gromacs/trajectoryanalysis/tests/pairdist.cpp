@@ -163,4 +163,19 @@ TEST_F(PairDistanceModuleTest, ComputesGroupedMaxDistanceWithCutoff)
     runTest(CommandLine(cmdline));
 }
 
+TEST_F(PairDistanceModuleTest, HandlesFrameParallelAnalysis)
+{
+    const char *const cmdline[] = {
+        "pairdist",
+        "-ref", "resindex 1 to 2", "-refgrouping", "res",
+        "-sel", "resindex 3 to 5", "-selgrouping", "res",
+        "-cutoff", "2.5",
+        "-nt", "2"
+    };
+    setTopology("simple.gro");
+    setTrajectory("simple.gro");
+    setOutputFileNoTest("-o", "xvg");
+    runTest(CommandLine(cmdline));
+}
+
 } // namespace
@@ -0,0 +1,229 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2015, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+/*! \internal \file
+ * \brief
+ * Tests for gmx::TrajectoryAnalysisParallelRunner.
+ *
+ * \ingroup module_trajectoryanalysis
+ */
+#include "gmxpre.h"
+
+#include "gromacs/trajectoryanalysis/parallelrunner.h"
+
+#include <cstring>
+
+#include <vector>
+
+#include <boost/shared_ptr.hpp>
+#include <gtest/gtest.h>
+
+#include "thread_mpi/mutex.h"
+#include "thread_mpi/threads.h"
+
+#include "gromacs/analysisdata/analysisdata.h"
+#include "gromacs/analysisdata/dataframe.h"
+#include "gromacs/analysisdata/datamodule.h"
+#include "gromacs/fileio/trx.h"
+#include "gromacs/selection/selectioncollection.h"
+#include "gromacs/trajectoryanalysis/analysismodule.h"
+#include "gromacs/utility/exceptions.h"
+
+#include "testutils/testasserts.h"
+
+namespace
+{
+
+/*! \internal \brief
+ * Analysis data module that records the order in which frames are notified.
+ *
+ * \ingroup module_trajectoryanalysis
+ */
+class FrameOrderRecorder : public gmx::AnalysisDataModuleSerial
+{
+    public:
+        virtual int flags() const { return 0; }
+
+        virtual void dataStarted(gmx::AbstractAnalysisData * /*data*/) {}
+        virtual void frameStarted(const gmx::AnalysisDataFrameHeader &header)
+        {
+            frames_.push_back(header.index());
+        }
+        virtual void pointsAdded(const gmx::AnalysisDataPointSetRef & /*points*/) {}
+        virtual void frameFinished(const gmx::AnalysisDataFrameHeader & /*header*/) {}
+        virtual void dataFinished() {}
+
+        //! Frame indices in the order they were started.
+        std::vector<int> frames_;
+};
+
+/*! \internal \brief
+ * Analysis module for testing the parallel runner.
+ *
+ * Each frame adds its index into a dataset.  The analysis of frame zero can be
+ * made to wait until a given number of other frames have been analyzed, and
+ * the analysis of one frame can be made to throw.
+ *
+ * \ingroup module_trajectoryanalysis
+ */
+class ParallelTestModule : public gmx::TrajectoryAnalysisModule
+{
+    public:
+        ParallelTestModule(int framesToWaitFor, int throwFrame)
+            : TrajectoryAnalysisModule("paralleltest", "Parallel test module"),
+              recorder_(new FrameOrderRecorder), framesToWaitFor_(framesToWaitFor),
+              throwFrame_(throwFrame)
+        {
+            tMPI_Thread_cond_init(&frameAnalyzed_);
+            data_.setColumnCount(0, 1);
+            data_.addModule(recorder_);
+            registerAnalysisDataset(&data_, "frames");
+        }
+        ~ParallelTestModule()
+        {
+            tMPI_Thread_cond_destroy(&frameAnalyzed_);
+        }
+
+        virtual void initOptions(gmx::Options                    * /*options*/,
+                                 gmx::TrajectoryAnalysisSettings * /*settings*/) {}
+        virtual void initAnalysis(const gmx::TrajectoryAnalysisSettings & /*settings*/,
+                                  const gmx::TopologyInformation        & /*top*/) {}
+        virtual void analyzeFrame(int frnr, const t_trxframe &fr, t_pbc * /*pbc*/,
+                                  gmx::TrajectoryAnalysisModuleData *pdata)
+        {
+            if (frnr == throwFrame_)
+            {
+                GMX_THROW(gmx::InvalidInputError("Test error in analyzeFrame()"));
+            }
+            if (frnr == 0)
+            {
+                tMPI::lock_guard<tMPI::mutex> lock(mutex_);
+                while (static_cast<int>(analyzedFrames_.size()) < framesToWaitFor_)
+                {
+                    tMPI_Thread_cond_wait(&frameAnalyzed_, mutex_.native_handle());
+                }
+            }
+            gmx::AnalysisDataHandle dh = pdata->dataHandle(data_);
+            dh.startFrame(frnr, fr.time);
+            dh.setPoint(0, frnr);
+            dh.finishFrame();
+            tMPI::lock_guard<tMPI::mutex> lock(mutex_);
+            analyzedFrames_.push_back(frnr);
+            tMPI_Thread_cond_broadcast(&frameAnalyzed_);
+        }
+        virtual void finishAnalysis(int /*nframes*/) {}
+        virtual void writeOutput() {}
+
+        //! Recorder attached to the dataset.
+        boost::shared_ptr<FrameOrderRecorder> recorder_;
+        //! Frame indices in the order analyzeFrame() completed.
+        std::vector<int>                      analyzedFrames_;
+
+    private:
+        gmx::AnalysisData                     data_;
+        int                                   framesToWaitFor_;
+        int                                   throwFrame_;
+        tMPI::mutex                           mutex_;
+        tMPI_Thread_cond_t                    frameAnalyzed_;
+};
+
+/*! \internal \brief
+ * Test fixture for gmx::TrajectoryAnalysisParallelRunner.
+ *
+ * \ingroup module_trajectoryanalysis
+ */
+class ParallelRunnerTest : public ::testing::Test
+{
+    public:
+        ParallelRunnerTest()
+        {
+            std::memset(&frame_, 0, sizeof(frame_));
+        }
+
+        //! Passes \p count empty frames to \p runner and finishes it.
+        void runFrames(gmx::TrajectoryAnalysisParallelRunner *runner, int count)
+        {
+            for (int i = 0; i < count; ++i)
+            {
+                frame_.time = i;
+                runner->analyzeFrame(i, frame_, NULL);
+            }
+            runner->finish();
+        }
+
+        gmx::SelectionCollection selections_;
+        t_trxframe               frame_;
+};
+
+TEST_F(ParallelRunnerTest, RetiresFramesInOrderWithMultipleFramesInFlight)
+{
+    const int          nthreads = 3;
+    const int          nframes  = 10;
+    // Frame zero finishes only after the next two frames have been analyzed.
+    ParallelTestModule module(nthreads - 1, -1);
+    {
+        gmx::TrajectoryAnalysisParallelRunner runner(&module, selections_, nthreads);
+        ASSERT_NO_THROW_GMX(runFrames(&runner, nframes));
+    }
+    ASSERT_EQ(nframes, static_cast<int>(module.analyzedFrames_.size()));
+    EXPECT_NE(0, module.analyzedFrames_[0]);
+    EXPECT_NE(0, module.analyzedFrames_[1]);
+    ASSERT_EQ(nframes, static_cast<int>(module.recorder_->frames_.size()));
+    for (int i = 0; i < nframes; ++i)
+    {
+        EXPECT_EQ(i, module.recorder_->frames_[i]);
+    }
+}
+
+TEST_F(ParallelRunnerTest, PropagatesExceptionsFromWorkers)
+{
+    ParallelTestModule module(0, 2);
+    {
+        gmx::TrajectoryAnalysisParallelRunner runner(&module, selections_, 2);
+        EXPECT_THROW_GMX(runFrames(&runner, 6), gmx::InvalidInputError);
+    }
+    // The frames before the failing one have been retired.
+    ASSERT_EQ(2U, module.recorder_->frames_.size());
+    EXPECT_EQ(0, module.recorder_->frames_[0]);
+    EXPECT_EQ(1, module.recorder_->frames_[1]);
+}
+
+TEST_F(ParallelRunnerTest, PropagatesExceptionsFromLastFrames)
+{
+    ParallelTestModule module(0, 3);
+    gmx::TrajectoryAnalysisParallelRunner runner(&module, selections_, 3);
+    EXPECT_THROW_GMX(runFrames(&runner, 4), gmx::InvalidInputError);
+}
+
+} // namespace
@@ -161,4 +161,24 @@ TEST_F(SasaModuleTest, HandlesDynamicCalculationGroup)
     runTest(CommandLine(cmdline));
 }
 
+TEST_F(SasaModuleTest, HandlesFrameParallelAnalysis)
+{
+    const char *const cmdline[] = {
+        "sasa",
+        "-surface", "all",
+        "-output", "resname RA",
+        "-nt", "2"
+    };
+    setTopology("simple.gro");
+    setTrajectory("simple.gro");
+    setOutputFileNoTest("-o", "xvg");
+    setOutputFileNoTest("-or", "xvg");
+    setOutputFileNoTest("-oa", "xvg");
+    setOutputFileNoTest("-tv", "xvg");
+    excludeDataset("dgsolv");
+    setDatasetTolerance("area", gmx::test::ulpTolerance(8));
+    setDatasetTolerance("volume", gmx::test::ulpTolerance(8));
+    runTest(CommandLine(cmdline));
+}
+
 } // namespace
@@ -84,6 +84,21 @@ TEST_F(SelectModuleTest, BasicTest)
     runTest(CommandLine(cmdline));
 }
 
+TEST_F(SelectModuleTest, HandlesFrameParallelAnalysis)
+{
+    const char *const cmdline[] = {
+        "select",
+        "-select", "resname CO2 and x < 1", "not resname CO2 and y < 0.5 and z < 0.5",
+        "-nt", "3"
+    };
+    setTopology("freevolume.tpr");
+    setTrajectory("freevolume.xtc");
+    setOutputFile("-oi", "index.dat");
+    includeDataset("size");
+    includeDataset("index");
+    runTest(CommandLine(cmdline));
+}
+
 TEST_F(SelectModuleTest, HandlesPDBOutputWithNonPDBInput)
 {
     const char *const cmdline[] = {
@@ -51,6 +51,7 @@
 #include "gromacs/random/random.h"
 #include "gromacs/utility/arrayref.h"
 #include "gromacs/utility/gmxassert.h"
+#include "gromacs/utility/gmxomp.h"
 #include "gromacs/utility/smalloc.h"
 
 #include "testutils/refdata.h"
@@ -161,9 +162,15 @@ class SurfaceAreaTest : public ::testing::Test
             dotCount_ = 0;
             sfree(dots_);
             dots_     = NULL;
-            ASSERT_EQ(0, nsc_dclm_pbc(x_, &radius_[0], index_.size(), ndots, flags,
-                                      &area_, &atomArea_, &volume_, &dots_, &dotCount_,
-                                      &index_[0], epbcXYZ, bPBC ? box_ : NULL));
+            t_nsc_unitsphere *unitsphere = nsc_init_unitsphere(ndots);
+            ASSERT_TRUE(unitsphere != NULL);
+            const int         rc         =
+                nsc_dclm_pbc(x_, &radius_[0], index_.size(), unitsphere, flags,
+                             &area_, &atomArea_, &volume_, &dots_, &dotCount_,
+                             &index_[0], epbcXYZ, bPBC ? box_ : NULL,
+                             gmx_omp_get_max_threads());
+            nsc_done_unitsphere(unitsphere);
+            ASSERT_EQ(0, rc);
         }
         real resultArea() const { return area_; }
         real resultVolume() const { return volume_; }
@@ -60,7 +60,7 @@
  */
 #if (defined GMX_SIMD_X86_SSE2) || (defined GMX_SIMD_X86_SSE4_1) || \
     (defined GMX_SIMD_X86_AVX_128_FMA) || (defined GMX_SIMD_X86_AVX_256) || \
-    (defined GMX_SIMD_X86_AVX2_256)
+    (defined GMX_SIMD_X86_AVX2_256) || (defined GMX_SIMD_X86_AVX_512F)
 #    include <xmmintrin.h>
 #endif
 #else
@@ -150,7 +150,7 @@ static gmx_inline void gmx_pause()
      */
 #if ((defined GMX_SIMD_X86_SSE2) || (defined GMX_SIMD_X86_SSE4_1) || \
     (defined GMX_SIMD_X86_AVX_128_FMA) || (defined GMX_SIMD_X86_AVX_256) || \
-    (defined GMX_SIMD_X86_AVX2_256)) && !defined(__MINGW32__)
+    (defined GMX_SIMD_X86_AVX2_256) || (defined GMX_SIMD_X86_AVX_512F)) && !defined(__MINGW32__)
     /* Replace with tbb::internal::atomic_backoff when/if we use TBB */
     _mm_pause();
 #elif defined __MIC__
@@ -1559,7 +1559,8 @@ int mdrunner(gmx_hw_opt_t *hw_opt,
         mdatoms = init_mdatoms(fplog, mtop, inputrec->efep != efepNO);
 
         /* Initialize the virtual site communication */
-        vsite = init_vsite(mtop, cr, FALSE);
+        vsite = init_vsite(mtop, cr, FALSE,
+                           getenv("GMX_DISABLE_SIMD_KERNELS") == NULL);
 
         calc_shifts(box, fr->shift_vec);
 
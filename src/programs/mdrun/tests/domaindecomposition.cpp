@@ -0,0 +1,162 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2015, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+/*! \internal \file
+ * \brief
+ * Tests for collecting vectors with domain decomposition
+ *
+ * \ingroup module_mdrun
+ */
+#include "gmxpre.h"
+
+#include "config.h"
+
+#include <stdlib.h>
+
+#include <cmath>
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include "gromacs/fileio/tpxio.h"
+#include "gromacs/fileio/trnio.h"
+#include "gromacs/legacyheaders/typedefs.h"
+#include "gromacs/topology/topology.h"
+#include "gromacs/utility/smalloc.h"
+#include "programs/mdrun/mdrun_main.h"
+
+#include "testutils/cmdlinetest.h"
+
+#include "moduletest.h"
+
+namespace
+{
+
+/* The hierarchical collection is only used with more than 4 DD ranks,
+ * so we need thread-MPI to start enough ranks within one test binary.
+ * Note that thread-MPI can only start multiple ranks once per process,
+ * so we check the collected vectors against the input instead of
+ * against a second run.
+ */
+#if defined GMX_THREAD_MPI && !defined GMX_NATIVE_WINDOWS
+
+//! Test fixture for collecting vectors over domain decomposition ranks
+typedef gmx::test::MdrunTestFixture DomainDecompositionCollect;
+
+/* Without constraints and COM motion removal the start state is not
+ * modified, so the coordinates and velocities at step 0 should be
+ * identical to those in the run input file, in the original atom order.
+ */
+TEST_F(DomainDecompositionCollect, HierarchicalReproducesInputState)
+{
+    runner_.useStringAsMdpFile("integrator = md\n"
+                               "nsteps = 0\n"
+                               "nstxout = 1\n"
+                               "nstvout = 1\n"
+                               "define = -DFLEXIBLE\n"
+                               "comm-mode = none\n"
+                               "gen-vel = yes\n"
+                               "gen-temp = 300\n"
+                               "gen-seed = 1993\n"
+                               "cutoff-scheme = Verlet\n"
+                               "coulombtype = reaction-field\n"
+                               "rcoulomb = 0.6\n"
+                               "rvdw = 0.6\n");
+    runner_.useTopGroAndNdxFromDatabase("spc216");
+    ASSERT_EQ(0, runner_.callGrompp());
+
+    std::string deffnm = fileManager_.getTemporaryFilePath("collect");
+
+    ::gmx::test::CommandLine caller;
+    caller.append("mdrun");
+    caller.addOption("-s", runner_.tprFileName_);
+    caller.addOption("-deffnm", deffnm);
+    caller.addOption("-ntmpi", 8);
+    caller.addOption("-ntomp", 1);
+    caller.append("-dd");
+    caller.append("2");
+    caller.append("2");
+    caller.append("2");
+    caller.addOption("-dlb", "no");
+
+    setenv("GMX_DD_COLLECT_HIERARCHICAL", "1", 1);
+    int rc = gmx_mdrun(caller.argc(), caller.argv());
+    unsetenv("GMX_DD_COLLECT_HIERARCHICAL");
+    ASSERT_EQ(0, rc);
+
+    t_tpxheader header;
+    t_inputrec  ir;
+    gmx_mtop_t  mtop;
+    matrix      box;
+    int         version, generation, natoms, natoms_trr, step;
+    real        t, lambda;
+    rvec       *x_tpx, *v_tpx, *x_trr, *v_trr;
+
+    read_tpxheader(runner_.tprFileName_.c_str(), &header, FALSE, &version, &generation);
+    natoms = header.natoms;
+    snew(x_tpx, natoms);
+    snew(v_tpx, natoms);
+    snew(x_trr, natoms);
+    snew(v_trr, natoms);
+    read_tpx(runner_.tprFileName_.c_str(), &ir, box, &natoms, x_tpx, v_tpx, NULL, &mtop);
+    read_trn((deffnm + ".trr").c_str(), &step, &t, &lambda, box, &natoms_trr,
+             x_trr, v_trr, NULL);
+
+    /* mdrun puts the atoms in the (rectangular) box, so we compare
+     * the coordinates modulo the box and the velocities exactly.
+     */
+    ASSERT_EQ(natoms, natoms_trr);
+    for (int i = 0; i < natoms; i++)
+    {
+        for (int d = 0; d < DIM; d++)
+        {
+            real dx = x_trr[i][d] - x_tpx[i][d];
+
+            dx -= box[d][d]*std::floor(dx/box[d][d] + 0.5);
+            EXPECT_NEAR(0, dx, 1e-5) << "atom " << i;
+            EXPECT_EQ(v_tpx[i][d], v_trr[i][d]) << "atom " << i;
+        }
+    }
+
+    sfree(x_tpx);
+    sfree(v_tpx);
+    sfree(x_trr);
+    sfree(v_trr);
+    done_inputrec(&ir);
+    done_mtop(&mtop, TRUE);
+}
+
+#endif
+
+} // namespace